@@ -28,7 +28,6 @@
 #include <generic/apt/resolver_manager.h>
 
 #include <generic/problemresolver/exceptions.h>
-#include <generic/problemresolver/solution.h>
 
 #include <generic/util/util.h>
 
@@ -38,8 +37,6 @@
 #include <cwidget/widgets/text_layout.h>
 #include <cwidget/toplevel.h>
 
-#include <apt-pkg/pkgsystem.h>
-
 #include <string>
 #include <vector>
 
@@ -50,10 +47,6 @@ namespace cwidget
   using namespace widgets;
 }
 
-typedef generic_solution<aptitude_universe> aptitude_solution;
-typedef generic_choice<aptitude_universe> choice;
-typedef generic_choice_set<aptitude_universe> choice_set;
-
 /** A simple indicator, usually placed at the bottom of the screen,
  *  that describes the current state of the problem resolver.  Hidden
  *  if no problem resolver is active.
@@ -63,10 +56,23 @@ typedef generic_choice_set<aptitude_universe> choice_set;
  */
 class broken_indicator : public cw::text_layout
 {
-  aptitude_solution last_sol;
+  /** Records whether the fields below describe the text that is
+   *  currently displayed.
+   */
+  bool last_valid : 1;
 
-  /** Records whether the last solution is the "keep-all" one. */
-  bool last_sol_is_keep_all : 1;
+  /** The selected solution at the time of the last update. */
+  int last_selected_solution;
+
+  /** The number of generated solutions at the time of the last
+   *  update.
+   */
+  int last_generated_solutions;
+
+  /** The summary of the selected solution at the time of the last
+   *  update.
+   */
+  resolver_manager::solution_summary last_summary;
 
   /** Records whether we had generated all solutions at the time of
    *  the last update.
@@ -78,6 +84,11 @@ class broken_indicator : public cw::text_layout
    */
   bool last_background_active : 1;
 
+  /** Records whether an update has been posted to the main thread
+   *  and hasn't run yet.
+   */
+  bool update_pending : 1;
+
   /** Tracks the phase of the visual "spinner". */
   int spin_count;
 
@@ -91,7 +102,7 @@ class broken_indicator : public cw::text_layout
 
 protected:
   broken_indicator()
-    :spin_count(0)
+    :last_valid(false), update_pending(false), spin_count(0)
   {
     if(resman != NULL)
       resman->state_changed.connect(sigc::mem_fun(*this, &broken_indicator::post_update));
@@ -202,6 +213,7 @@ private:
 
     void dispatch()
     {
+      b->update_pending = false;
       b->update();
     }
   };
@@ -210,9 +222,18 @@ private:
    *  selected_signal_changed signal might theoretically run from a
    *  background thread.  (at the moment it shouldn't, but this will
    *  help avoid nasty surprises)
+   *
+   *  The resolver manager can change state several times in a row
+   *  (e.g., when a resolver is discarded and recreated); all the
+   *  changes that arrive before the update runs are handled by a
+   *  single update.
    */
   void post_update()
   {
+    if(update_pending)
+      return;
+
+    update_pending = true;
     cw::toplevel::post_event(new update_event(this));
   }
 public:
@@ -231,7 +252,7 @@ public:
     if(resman == NULL || !resman->resolver_exists())
       {
 	set_fragment(cw::fragf(""));
-	last_sol.nullify();
+	last_valid = false;
 	hide();
 	return;
       }
@@ -241,7 +262,7 @@ public:
     if(aptcfg->FindI(PACKAGE "::ProblemResolver::StepLimit", 5000) <= 0)
       {
 	set_fragment(cw::text_fragment(_("Dependency resolution disabled.")));
-	last_sol.nullify();
+	last_valid = false;
 	show();
 	return;
       }
@@ -252,7 +273,7 @@ public:
     if(state.solutions_exhausted && state.generated_solutions == 0)
       {
 	set_fragment(cw::fragf(_("Unable to resolve dependencies.")));
-	last_sol.nullify();
+	last_valid = false;
 	show();
 	return;
       }
@@ -263,7 +284,7 @@ public:
 	if(state.background_thread_aborted)
 	  {
 	    set_fragment(cw::fragf(_("Fatal error in resolver")));
-	    last_sol.nullify();
+	    last_valid = false;
 	    show();
 	    return;
 	  }
@@ -287,76 +308,33 @@ public:
 	set_fragment(cw::sequence_fragment(cw::fragment_columns(columns),
 					   key_hint_fragment(state),
 					   NULL));
-	last_sol.nullify();
+	last_valid = false;
 	show();
 	return;
       }
 
-    aptitude_solution sol = resman->get_solution(state.selected_solution, 0);
-
-    // This test always fails the first time update() is called, since
-    // sol is never NULL and last_sol is initialized to NULL.
-    if(sol == last_sol && state.solutions_exhausted == last_complete &&
-       // If there's an active thread we need to redraw the widget to
-       // include the spinner.
+    // Everything that is displayed below comes from the snapshot, so
+    // if none of it changed there's nothing to redraw.
+    //
+    // If there's an active thread we need to redraw the widget to
+    // include the spinner.
+    if(last_valid &&
+       state.selected_solution == last_selected_solution &&
+       state.generated_solutions == last_generated_solutions &&
+       state.selected_summary == last_summary &&
+       state.solutions_exhausted == last_complete &&
        !last_background_active &&
        state.background_thread_active == last_background_active)
       return;
 
-    last_sol = sol;
+    last_valid = true;
+    last_selected_solution = state.selected_solution;
+    last_generated_solutions = state.generated_solutions;
+    last_summary = state.selected_summary;
     last_complete = state.solutions_exhausted;
     last_background_active = state.background_thread_active;
-    last_sol_is_keep_all = resman->get_is_keep_all_solution(state.selected_solution, 0);
-
-    if(sol.get_choices().size() == 0)
-      {
-	set_fragment(cw::fragf("%s", _("Internal error: unexpected null solution.")));
-	show();
-	return;
-      }
 
-    int install_count=0, remove_count=0, keep_count=0, upgrade_count=0, downgrade_count=0;
-
-    for(choice_set::const_iterator i = sol.get_choices().begin();
-	i != sol.get_choices().end(); ++i)
-      {
-	// Ignore broken recommendations for now.
-	if(i->get_type() != choice::install_version)
-	  continue;
-
-	pkgCache::PkgIterator pkg = i->get_ver().get_pkg();
-	pkgCache::VerIterator curver=pkg.CurrentVer();
-	pkgCache::VerIterator instver=(*apt_cache_file)[pkg].InstVerIter(*apt_cache_file);
-	pkgCache::VerIterator newver = i->get_ver().get_ver();
-
-	// If not, we have a problem.
-	eassert(instver!=newver);
-
-	if(newver == curver)
-	  ++keep_count;
-	else if(curver.end())
-	  ++install_count;
-	else if(newver.end())
-	  ++remove_count;
-	else
-	  {
-	    int cmp=_system->VS->CmpVersion(curver.VerStr(),
-					    newver.VerStr());
-
-	    // The versions shouldn't be equal -- otherwise
-	    // something is majorly wrong.
-	    // eassert(cmp!=0);
-	    //
-	    // The above is not true: consider, eg, the case of a
-	    // locally compiled package and a standard package.
-
-	    /** \todo indicate "sidegrades" separately? */
-	    if(cmp<=0)
-	      ++upgrade_count;
-	    else if(cmp>0)
-	      ++downgrade_count;
-	  }
-      }
+    const resolver_manager::solution_summary &summary = state.selected_summary;
 
     vector<cw::fragment *> fragments;
 
@@ -367,59 +345,59 @@ public:
     fragments.push_back(cw::fragf("%s ", countstr.c_str()));
 
 
-    if(last_sol_is_keep_all)
+    if(summary.is_keep_all)
       fragments.push_back(cw::text_fragment(_("Suggest keeping all packages at their current version.")));
     else
       {
 	vector<cw::fragment *> suggestions;
 
-	if(install_count>0)
+	if(summary.install_count>0)
 	  {
 	    cw::fragment *install_count_fragment =
 	      cw::text_fragment(ssprintf(ngettext("%d install",
 						  "%d installs",
-						  install_count),
-					 install_count));
+						  summary.install_count),
+					 summary.install_count));
 	    suggestions.push_back(install_count_fragment);
 	  }
 
-	if(remove_count>0)
+	if(summary.remove_count>0)
 	  {
 	    cw::fragment *remove_count_fragment =
 	      cw::text_fragment(ssprintf(ngettext("%d removal",
 						  "%d removals",
-						  remove_count),
-					 remove_count));
+						  summary.remove_count),
+					 summary.remove_count));
 	    suggestions.push_back(remove_count_fragment);
 	  }
 
-	if(keep_count>0)
+	if(summary.keep_count>0)
 	  {
 	    cw::fragment *keep_count_fragment =
 	      cw::text_fragment(ssprintf(ngettext("%d keep",
 						  "%d keeps",
-						  keep_count),
-					 keep_count));
+						  summary.keep_count),
+					 summary.keep_count));
 	    suggestions.push_back(keep_count_fragment);
 	  }
 
-	if(upgrade_count>0)
+	if(summary.upgrade_count>0)
 	  {
 	    cw::fragment *upgrade_count_fragment =
 	      cw::text_fragment(ssprintf(ngettext("%d upgrade",
 						  "%d upgrades",
-						  upgrade_count),
-					 upgrade_count));
+						  summary.upgrade_count),
+					 summary.upgrade_count));
 	    suggestions.push_back(upgrade_count_fragment);
 	  }
 
-	if(downgrade_count>0)
+	if(summary.downgrade_count>0)
 	  {
 	    cw::fragment *downgrade_count_fragment =
 	      cw::text_fragment(ssprintf(ngettext("%d downgrade",
 						  "%d downgrades",
-						  downgrade_count),
-					 downgrade_count));
+						  summary.downgrade_count),
+					 summary.downgrade_count));
 
 	    suggestions.push_back(downgrade_count_fragment);
 	  }
@@ -24,6 +24,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <cwidget/generic/util/transcode.h>
 
 namespace cw = cwidget;
@@ -451,6 +453,60 @@ bool cmdline_applyaction(cmdline_pkgaction_type action,
   return true;
 }
 
+void cmdline_find_pattern_matches(const std::vector<std::string> &args,
+				  cmdline_pattern_matches &matches)
+{
+  using namespace aptitude::matching;
+
+  std::vector<std::string> texts;
+  std::vector<cw::util::ref_ptr<pattern> > patterns;
+  for(std::vector<std::string>::const_iterator it = args.begin();
+      it != args.end(); ++it)
+    {
+      if(task_list->find(*it) != task_list->end())
+	continue;
+
+      cmdline_version_source source;
+      string package, sourcestr;
+      if(!cmdline_parse_source(*it, source, package, sourcestr, true) ||
+	 !is_pattern(package) ||
+	 matches.find(package) != matches.end())
+	continue;
+
+      cw::util::ref_ptr<pattern> p(parse(package, false, true));
+      if(!p.valid())
+	continue;
+
+      matches[package];
+      texts.push_back(package);
+      patterns.push_back(p);
+    }
+
+  if(patterns.empty())
+    return;
+
+  // Find every package that matches any of the patterns in one pass
+  // over the cache, then sort them out by testing only those
+  // packages against each pattern.
+  cw::util::ref_ptr<search_cache> search_info(search_cache::create());
+  std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > > found;
+  search(patterns.size() == 1
+	   ? patterns.front()
+	   : pattern::make_or(patterns.begin(), patterns.end()),
+	 search_info, found,
+	 *apt_cache_file,
+	 *apt_package_records);
+
+  for(std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > >::const_iterator
+	it = found.begin(); it != found.end(); ++it)
+    for(std::vector<cw::util::ref_ptr<pattern> >::size_type i = 0;
+	i < patterns.size(); ++i)
+      if(patterns.size() == 1 ||
+	 has_match(patterns[i], it->first, search_info,
+		   *apt_cache_file, *apt_package_records))
+	matches[texts[i]].push_back(it->first);
+}
+
 bool cmdline_applyaction(string s,
 			 std::set<pkgCache::PkgIterator> &seen_virtual_packages,
 			 cmdline_pkgaction_type action,
@@ -459,7 +515,8 @@ bool cmdline_applyaction(string s,
 			 int verbose,
 			 pkgPolicy &policy, bool arch_only,
 			 bool allow_auto,
-                         const shared_ptr<terminal_metrics> &term_metrics)
+                         const shared_ptr<terminal_metrics> &term_metrics,
+			 const cmdline_pattern_matches *pattern_matches)
 {
   using namespace aptitude::matching;
 
@@ -477,14 +534,17 @@ bool cmdline_applyaction(string s,
       printf(_("Note: selecting the task \"%s: %s\" for installation\n"),
 	     s.c_str(), t.shortdesc.c_str());
 
-      for(pkgCache::PkgIterator pkg=(*apt_cache_file)->PkgBegin();
-	  !pkg.end(); ++pkg)
-	{
-	  std::set<std::string> *tasks = get_tasks(pkg);
+      // Clean up and signal once, after every package is marked.
+      aptitudeDepCache::action_group group(*apt_cache_file, NULL);
 
-	  for(std::set<std::string>::iterator i = tasks->begin();
-	      i!=tasks->end(); ++i)
-	    if(*i==s)
+      task_id id;
+      if(find_task_id(s, id))
+	for(pkgCache::PkgIterator pkg=(*apt_cache_file)->PkgBegin();
+	    !pkg.end(); ++pkg)
+	  {
+	    const task_id_range tasks = get_task_ids(pkg);
+
+	    if(std::binary_search(tasks.first, tasks.second, id))
 	      rval=cmdline_applyaction(action, pkg,
 				       seen_virtual_packages,
 				       to_install, to_hold, to_remove, to_purge,
@@ -493,7 +553,7 @@ bool cmdline_applyaction(string s,
 				       policy, arch_only,
 				       allow_auto,
                                        term_metrics) && rval;
-	}
+	  }
 
       // break out.
       return rval;
@@ -603,22 +663,46 @@ bool cmdline_applyaction(string s,
     }
   else
     {
-      cw::util::ref_ptr<pattern> p(parse(package.c_str()));
-      if(!p.valid())
+      const pkgvector *matched = NULL;
+      if(pattern_matches != NULL)
 	{
-	  _error->DumpErrors();
-	  return false;
+	  cmdline_pattern_matches::const_iterator found =
+	    pattern_matches->find(package);
+	  if(found != pattern_matches->end())
+	    matched = &found->second;
 	}
 
-      std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > > matches;
-      cw::util::ref_ptr<search_cache> search_info(search_cache::create());
-      search(p, search_info, matches,
-	     *apt_cache_file,
-	     *apt_package_records);
-      for(std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > >::const_iterator
-	    it = matches.begin(); it != matches.end(); ++it)
+      pkgvector searched;
+      if(matched == NULL)
 	{
-	  if(!cmdline_applyaction(action, it->first,
+	  cw::util::ref_ptr<pattern> p(parse(package.c_str()));
+	  if(!p.valid())
+	    {
+	      _error->DumpErrors();
+	      return false;
+	    }
+
+	  std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > > matches;
+	  cw::util::ref_ptr<search_cache> search_info(search_cache::create());
+	  search(p, search_info, matches,
+		 *apt_cache_file,
+		 *apt_package_records);
+
+	  for(std::vector<std::pair<pkgCache::PkgIterator, cw::util::ref_ptr<structural_match> > >::const_iterator
+		it = matches.begin(); it != matches.end(); ++it)
+	    searched.push_back(it->first);
+
+	  matched = &searched;
+	}
+
+      // A pattern can match thousands of packages; don't clean up
+      // and signal after marking each one.
+      aptitudeDepCache::action_group group(*apt_cache_file, NULL);
+
+      for(pkgvector::const_iterator it = matched->begin();
+	  it != matched->end(); ++it)
+	{
+	  if(!cmdline_applyaction(action, *it,
 				  seen_virtual_packages,
 				  to_install, to_hold, to_remove, to_purge,
 				  verbose, source,
@@ -732,6 +816,8 @@ void cmdline_parse_action(string s,
       return;
     }
 
+  aptitudeDepCache::action_group group(*apt_cache_file, NULL);
+
   while(loc<s.size())
     {
       while(loc<s.size() && isspace(s[loc]))
@@ -27,6 +27,8 @@
 // System includes:
 #include <boost/shared_ptr.hpp>
 
+#include <map>
+
 
 /** \file cmdline_action.h
  */
@@ -113,6 +115,26 @@ bool cmdline_applyaction(cmdline_pkgaction_type action,
 			 bool allow_auto,
                          const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term);
 
+/** \brief The packages matched by each pattern given on the command
+ *  line, indexed by the text of the pattern.
+ */
+typedef std::map<std::string, pkgvector> cmdline_pattern_matches;
+
+/** \brief Find the packages matched by the patterns among the given
+ *  command-line arguments.
+ *
+ *  The cache is scanned once for all the patterns together, instead
+ *  of once for each of them.  Arguments that are package names or
+ *  tasks, or that can't be parsed, are skipped; cmdline_applyaction()
+ *  handles them (and reports their errors) as usual.
+ *
+ *  \param args     The arguments, without any action suffix.
+ *  \param matches  Where to store the packages matched by each
+ *                  pattern.
+ */
+void cmdline_find_pattern_matches(const std::vector<std::string> &args,
+				  cmdline_pattern_matches &matches);
+
 /** \brief Apply the given command-line action to the given package,
  *  updating the command-line state appropriately.
  *
@@ -163,6 +185,10 @@ bool cmdline_applyaction(cmdline_pkgaction_type action,
  *
  *  \param allow_auto If \b false, auto-installation of dependencies
  *  will be disabled regardless of the value of Auto-Install.
+ *
+ *  \param pattern_matches If not \b NULL, the matches of patterns
+ *  found by cmdline_find_pattern_matches(); s is only searched for
+ *  if it is a pattern that isn't listed here.
  */
 bool cmdline_applyaction(string s,
 			 std::set<pkgCache::PkgIterator> &seen_virtual_packages,
@@ -172,7 +198,8 @@ bool cmdline_applyaction(string s,
 			 int verbose,
 			 pkgPolicy &policy, bool arch_only,
 			 bool allow_auto,
-                         const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term);
+                         const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term,
+			 const cmdline_pattern_matches *pattern_matches = NULL);
 
 /** \brief Parses a list of actions and executes them.
  *
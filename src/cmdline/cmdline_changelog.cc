@@ -29,6 +29,7 @@
 #include <aptitude.h>
 
 #include <generic/apt/apt.h>
+#include <generic/apt/changelog_parse.h>
 #include <generic/apt/config_signal.h>
 #include <generic/apt/download_queue.h>
 #include <generic/apt/pkg_changelog.h>
@@ -36,6 +37,7 @@
 // System includes:
 #include <apt-pkg/error.h>
 #include <apt-pkg/metaindex.h>
+#include <apt-pkg/pkgrecords.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/sourcelist.h>
 #include <apt-pkg/srcrecords.h>
@@ -147,19 +149,71 @@ void set_name(temp::name n, temp::name *target)
     }
   };
 
+  /** \brief A changelog that was asked for on the command line. */
+  class changelog_job
+  {
+  public:
+    /** \brief The argument naming the package. */
+    std::string input;
+
+    /** \brief The changelogs that might be the one that was asked
+     *  for, in the order in which they are tried.
+     */
+    std::vector<shared_ptr<aptitude::apt::changelog_info> > candidates;
+
+    /** \brief If not empty, only the entries newer than this source
+     *  version are displayed.
+     */
+    std::string current_source_version;
+
+    /** \brief The downloaded changelog, or an invalid name if none
+     *  of the candidates could be downloaded.
+     */
+    temp::name filename;
+
+    /** \brief \b true once the changelog has been downloaded or
+     *  every candidate has failed.
+     */
+    bool finished;
+
+    explicit changelog_job(const std::string &_input)
+      : input(_input), finished(false)
+    {
+    }
+
+    void add_candidate(const shared_ptr<aptitude::apt::changelog_info> &info)
+    {
+      // changelog_info::create() returns an invalid pointer for
+      // versions that aren't available from any archive.
+      if(info.get() != NULL)
+	candidates.push_back(info);
+    }
+  };
+
+  void start_changelog_download(const shared_ptr<changelog_job> &job,
+				std::vector<shared_ptr<aptitude::apt::changelog_info> >::size_type candidate,
+				const shared_ptr<terminal_metrics> &term_metrics);
+
   class changelog_download_callbacks : public single_download_progress
   {
-    // Where to store the changelog file, if any.
-    temp::name &out_changelog_file;
+    shared_ptr<changelog_job> job;
+
+    // The index of the candidate being downloaded.
+    std::vector<shared_ptr<aptitude::apt::changelog_info> >::size_type candidate;
+
+    shared_ptr<terminal_metrics> term_metrics;
 
   public:
-    changelog_download_callbacks(temp::name &_out_changelog_file,
-				 const std::string &short_description,
-                                 const shared_ptr<terminal_metrics> &term_metrics)
-      : single_download_progress(short_description,
+    changelog_download_callbacks(const shared_ptr<changelog_job> &_job,
+				 std::vector<shared_ptr<aptitude::apt::changelog_info> >::size_type _candidate,
+                                 const shared_ptr<terminal_metrics> &_term_metrics)
+      : single_download_progress((boost::format("Changelog of %s")
+				  % _job->candidates[_candidate]->get_display_name()).str(),
 				 aptcfg->FindI("Quiet", 0) > 0,
-                                 term_metrics),
-	out_changelog_file(_out_changelog_file)
+                                 _term_metrics),
+	job(_job),
+	candidate(_candidate),
+	term_metrics(_term_metrics)
     {
     }
 
@@ -167,7 +221,8 @@ void set_name(temp::name n, temp::name *target)
     {
       single_download_progress::success(name);
 
-      out_changelog_file = name;
+      job->filename = name;
+      job->finished = true;
 
       aptitude::cmdline::exit_main();
     }
@@ -179,31 +234,27 @@ void set_name(temp::name n, temp::name *target)
       _error->Error(_("Changelog download failed: %s"), msg.c_str());
       _error->DumpErrors();
 
-      out_changelog_file = temp::name();
-      aptitude::cmdline::exit_main();
+      if(candidate + 1 < job->candidates.size())
+	start_changelog_download(job, candidate + 1, term_metrics);
+      else
+	{
+	  job->finished = true;
+	  aptitude::cmdline::exit_main();
+	}
     }
   };
 
-  void get_changelog(const pkgCache::VerIterator &ver,
-		     temp::name &out_changelog_file,
-                     const shared_ptr<terminal_metrics> &term_metrics)
+  void start_changelog_download(const shared_ptr<changelog_job> &job,
+				std::vector<shared_ptr<aptitude::apt::changelog_info> >::size_type candidate,
+				const shared_ptr<terminal_metrics> &term_metrics)
   {
-    const std::string short_description =
-      (boost::format("Changelog of %s") % ver.ParentPkg().Name()).str();
-
-    boost::shared_ptr<changelog_download_callbacks>
-      callbacks = boost::make_shared<changelog_download_callbacks>(boost::ref(out_changelog_file),
-								   short_description,
-                                                                   term_metrics);
-
-    get_changelog(aptitude::apt::changelog_info::create(ver),
-		  callbacks,
+    get_changelog(job->candidates[candidate],
+		  boost::make_shared<changelog_download_callbacks>(job, candidate, term_metrics),
 		  aptitude::cmdline::post_thunk);
-
-    aptitude::cmdline::main_loop();
   }
 
-  /** \brief download a source package's changelog.
+  /** \brief Add the changelog of a source package to the candidates
+   *  of a job.
    *
    *  \param srcpkg the source package name
    *  \param ver the version of the source package
@@ -211,43 +262,24 @@ void set_name(temp::name n, temp::name *target)
    *  \param name the name of the package that the user provided
    *              (e.g., the binary package that the changelog command
    *               was executed on)
-   *  \param out_changelog_file  Where to store the resulting file.
-   *
-   *  This routine exits once the download is complete.
    */
-  void get_changelog_from_source(const std::string &srcpkg,
+  void add_changelog_from_source(changelog_job &job,
+				 const std::string &srcpkg,
 				 const std::string &ver,
 				 const std::string &section,
-				 const std::string &name,
-				 temp::name &out_changelog_file,
-                                 const shared_ptr<terminal_metrics> &term_metrics)
+				 const std::string &name)
   {
-    const std::string short_description =
-      (boost::format("Changelog of %s") % name).str();
-
-    boost::shared_ptr<changelog_download_callbacks>
-      callbacks = boost::make_shared<changelog_download_callbacks>(boost::ref(out_changelog_file),
-								   short_description,
-                                                                   term_metrics);
-
-    boost::shared_ptr<aptitude::apt::changelog_info>
-      info = aptitude::apt::changelog_info::create(srcpkg, ver, section, name);
-
-    get_changelog(info,
-		  callbacks,
-		  aptitude::cmdline::post_thunk);
-
-    aptitude::cmdline::main_loop();
+    job.add_candidate(aptitude::apt::changelog_info::create(srcpkg, ver, section, name));
   }
 
 
 /** Try to find a particular package version without knowing the
- *  section that it occurs in.  The resulting name will be invalid if
- *  no changelog could be found.
+ *  section that it occurs in.  Each guess becomes a candidate of the
+ *  job, to be tried if the previous one can't be downloaded.
  */
-temp::name changelog_by_version(const std::string &pkg,
-				const std::string &ver,
-                                const shared_ptr<terminal_metrics> &term_metrics)
+void add_changelog_by_version(changelog_job &job,
+			      const std::string &pkg,
+			      const std::string &ver)
 {
   // Try forcing the particular version that was
   // selected, using various sections.  FIXME: relies
@@ -255,26 +287,15 @@ temp::name changelog_by_version(const std::string &pkg,
   // works; in particular, that it only cares whether
   // "section" has a first component.
 
-  temp::name rval;
-
-  get_changelog_from_source(pkg, ver, "", pkg, rval, term_metrics);
-
-  if(!rval.valid())
-    {
-      get_changelog_from_source(pkg, ver, "contrib/foo", pkg, rval, term_metrics);
-    }
-
-  if(!rval.valid())
-    {
-      get_changelog_from_source(pkg, ver, "non-free/foo", pkg, rval, term_metrics);
-    }
-
-  return rval;
+  add_changelog_from_source(job, pkg, ver, "", pkg);
+  add_changelog_from_source(job, pkg, ver, "contrib/foo", pkg);
+  add_changelog_from_source(job, pkg, ver, "non-free/foo", pkg);
 }
 }
 
 void do_cmdline_changelog(const vector<string> &packages,
-                          const shared_ptr<terminal_metrics> &term_metrics)
+                          const shared_ptr<terminal_metrics> &term_metrics,
+                          bool only_new)
 {
   const char *pager="/usr/bin/sensible-pager";
 
@@ -290,6 +311,11 @@ void do_cmdline_changelog(const vector<string> &packages,
 
   string default_release = aptcfg->Find("APT::Default-Release");
 
+  // Work out which changelogs to fetch for every package first, so
+  // that they can all be downloaded at once; the download queue
+  // limits how many are fetched from each host at a time.
+  vector<shared_ptr<changelog_job> > jobs;
+
   for(vector<string>::const_iterator i=packages.begin(); i!=packages.end(); ++i)
     {
       // We need to do this because some code (see above) checks
@@ -314,7 +340,21 @@ void do_cmdline_changelog(const vector<string> &packages,
 
       pkgCache::PkgIterator pkg=(*apt_cache_file)->FindPkg(package);
 
-      temp::name filename;
+      shared_ptr<changelog_job> job = boost::make_shared<changelog_job>(input);
+
+      // The source version of the installed package, if only the
+      // entries newer than it should be shown.
+      string &current_source_version = job->current_source_version;
+      if(only_new && !pkg.end() && !pkg.CurrentVer().end() &&
+	 apt_package_records != NULL)
+	{
+	  pkgRecords::Parser &rec =
+	    apt_package_records->Lookup(pkg.CurrentVer().FileList());
+
+	  current_source_version = rec.SourceVer();
+	  if(current_source_version.empty())
+	    current_source_version = pkg.CurrentVer().VerStr();
+	}
 
       // For real packages/versions, we can do a sanity check on the
       // version and warn the user if it looks like it doesn't have a
@@ -352,12 +392,11 @@ void do_cmdline_changelog(const vector<string> &packages,
 	  // use an explicit version.
 	  if(p.valid())
 	    {
-	      get_changelog_from_source(p.get_package(),
+	      add_changelog_from_source(*job,
+					p.get_package(),
 					p.get_version(),
 					p.get_section(),
-					pkg.Name(),
-					filename,
-                                        term_metrics);
+					pkg.Name());
 	    }
 	  else
 	    {
@@ -366,13 +405,13 @@ void do_cmdline_changelog(const vector<string> &packages,
 	      if(ver.end())
                 {
                   if(source == cmdline_version_version)
-                    filename = changelog_by_version(package, sourcestr, term_metrics);
+                    add_changelog_by_version(*job, package, sourcestr);
                   // If we don't even have a version string, leave
-                  // filename blank; we'll fail below.
+                  // the job without candidates; we'll fail below.
                 }
 	      else
 		{
-		  get_changelog(ver, filename, term_metrics);
+		  job->add_candidate(aptitude::apt::changelog_info::create(ver));
 		}
 	    }
 	}
@@ -385,12 +424,11 @@ void do_cmdline_changelog(const vector<string> &packages,
 
 	  if(p.valid())
 	    {
-	      get_changelog_from_source(p.get_package(),
+	      add_changelog_from_source(*job,
+					p.get_package(),
 					p.get_version(),
 					p.get_section(),
-					p.get_package(),
-					filename,
-                                        term_metrics);
+					p.get_package());
 	    }
 	  else
 	    {
@@ -415,23 +453,59 @@ void do_cmdline_changelog(const vector<string> &packages,
 		  break;
 
 		case cmdline_version_version:
-		  filename = changelog_by_version(package, sourcestr, term_metrics);
+		  add_changelog_by_version(*job, package, sourcestr);
 		  break;
 		}
 	    }
 	}
 
-      if(!filename.valid())
-	_error->Error(_("Couldn't find a changelog for %s"), input.c_str());
+      if(job->candidates.empty())
+	job->finished = true;
+      else
+	start_changelog_download(job, 0, term_metrics);
+
+      jobs.push_back(job);
+    }
+
+  // Show the changelogs in the order they were asked for, each one
+  // as soon as it and the ones before it have arrived.  Downloads
+  // that finish while the pager is running wait in the main loop's
+  // queue.
+  for(vector<shared_ptr<changelog_job> >::const_iterator it = jobs.begin();
+      it != jobs.end(); ++it)
+    {
+      changelog_job &job(**it);
+
+      while(!job.finished)
+	aptitude::cmdline::main_loop();
+
+      _error->DumpErrors();
+
+      if(!job.filename.valid())
+	_error->Error(_("Couldn't find a changelog for %s"), job.input.c_str());
       else
-	// Run the user's pager.
-	system((string(pager) + " " + filename.get_name()).c_str());
+	{
+	  temp::name filename = job.filename;
+
+	  if(!job.current_source_version.empty())
+	    {
+	      // Fall back to the whole changelog if the new entries
+	      // can't be picked out of it.
+	      temp::name new_entries =
+		aptitude::apt::extract_changelog_newer_than(filename,
+							    job.current_source_version);
+	      if(new_entries.valid())
+		filename = new_entries;
+	    }
+
+	  // Run the user's pager.
+	  system((string(pager) + " " + filename.get_name()).c_str());
+	}
     }
 
   _error->DumpErrors();
 }
 
-// TODO: fetch them all in one go.
 int cmdline_changelog(int argc, char *argv[])
 {
   shared_ptr<terminal_io> term = create_terminal();
@@ -40,10 +40,17 @@ namespace aptitude
 /** \brief Display the changelog of each of the given package specifiers.
  *
  *  The specifiers are literal package names, with optional version/archive
- *  descriptors.  DumpErrors() is called after each changelog is displayed.
+ *  descriptors.  The changelogs are all downloaded at once, and each
+ *  is displayed, in the order given, as soon as it has arrived.
+ *  DumpErrors() is called after each changelog is displayed.
+ *
+ *  If only_new is \b true, only the entries that are newer than the
+ *  installed version of each package are displayed (the whole
+ *  changelog is shown for packages that are not installed).
  */
 void do_cmdline_changelog(const std::vector<std::string> &packages,
-                          const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term_metrics);
+                          const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term_metrics,
+                          bool only_new = false);
 
 int cmdline_changelog(int argc, char *argv[]);
 
@@ -32,14 +32,20 @@
 
 // System includes:
 #include <apt-pkg/acquire.h>
-#include <apt-pkg/clean.h>
+#include <apt-pkg/aptconfiguration.h>
 #include <apt-pkg/error.h>
+#include <apt-pkg/pkgcache.h>
 #include <apt-pkg/strutl.h>
 
+#include <boost/unordered_set.hpp>
+
 #include <iostream>
 
+#include <dirent.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -93,34 +99,150 @@ int cmdline_clean(int argc, char *argv[], bool simulate)
   return rval;
 }
 
-// Shamelessly stolen from apt-get:
-class LogCleaner : public pkgArchiveCleaner
+namespace
 {
-  bool simulate;
+  /** \brief Deletes the archives in a directory that can't be
+   *  downloaded any more.
+   *
+   *  This makes the same decisions as apt's pkgArchiveCleaner, but
+   *  it indexes the downloadable versions once, by the name of the
+   *  file each one would be downloaded to, instead of looking up the
+   *  package and walking its versions for every file.  Files are
+   *  only stat()ed when they are about to be deleted.
+   */
+  class archive_cleaner
+  {
+    bool simulate;
 
-  long total_size;
+    long total_size;
 
-protected:
-  virtual void Erase(const char *File,string Pkg,string Ver,struct stat &St) 
-  {
-    printf(_("Del %s %s [%sB]\n"),
-	   Pkg.c_str(),
-	   Ver.c_str(),
-	   SizeToStr(St.st_size).c_str());
-
-    if (!simulate)
-      {
-	if(unlink(File)==0)
-	  total_size+=St.st_size;
-      }
-    else
-      total_size+=St.st_size;
-  };
-public:
-  LogCleaner(bool _simulate):simulate(_simulate), total_size(0) { }
+    std::string native_arch;
+
+    /** \brief "package_version_architecture" for each version
+     *  that can be downloaded.
+     *
+     *  None of these fields can contain an underscore, so the keys
+     *  can't collide.
+     */
+    boost::unordered_set<std::string> fetchable;
 
-  long get_total_size() {return total_size;}
-};
+    static std::string make_key(const std::string &pkg,
+				const std::string &ver,
+				const std::string &arch)
+    {
+      std::string rval(pkg);
+      rval += '_';
+      rval += ver;
+      rval += '_';
+      rval += arch;
+      return rval;
+    }
+
+    void erase(const std::string &path,
+	       const std::string &pkg,
+	       const std::string &ver,
+	       const struct stat &st)
+    {
+      printf(_("Del %s %s [%sB]\n"),
+	     pkg.c_str(),
+	     ver.c_str(),
+	     SizeToStr(st.st_size).c_str());
+
+      if (!simulate)
+	{
+	  if(unlink(path.c_str())==0)
+	    total_size+=st.st_size;
+	}
+      else
+	total_size+=st.st_size;
+    }
+
+  public:
+    archive_cleaner(bool _simulate, pkgCache &cache)
+      : simulate(_simulate), total_size(0),
+	native_arch(_config->Find("APT::Architecture"))
+    {
+      const bool clean_installed = _config->FindB("APT::Clean-Installed", true);
+
+      for(pkgCache::PkgIterator p = cache.PkgBegin(); !p.end(); ++p)
+	for(pkgCache::VerIterator v = p.VersionList(); !v.end(); ++v)
+	  for(pkgCache::VerFileIterator vf = v.FileList(); !vf.end(); ++vf)
+	    {
+	      if(clean_installed &&
+		 (vf.File()->Flags & pkgCache::Flag::NotSource) != 0)
+		continue;
+
+	      fetchable.insert(make_key(p.Name(), v.VerStr(), p.Arch()));
+	      break;
+	    }
+    }
+
+    /** \brief Delete the archives in the given directory that can't
+     *  be downloaded any more.
+     *
+     *  \return \b false if the directory couldn't be read.
+     */
+    bool go(const std::string &dir)
+    {
+      DIR *d = opendir(dir.c_str());
+      if(d == NULL)
+	return _error->Errno("opendir", _("Unable to read %s"), dir.c_str());
+
+      // readdir() fills its buffer with one getdents() call for many
+      // entries, so this makes far fewer system calls than there are
+      // files.
+      for(struct dirent *ent = readdir(d); ent != NULL; ent = readdir(d))
+	{
+	  const char * const name = ent->d_name;
+	  if(strcmp(name, "lock") == 0 ||
+	     strcmp(name, "partial") == 0 ||
+	     strcmp(name, ".") == 0 ||
+	     strcmp(name, "..") == 0)
+	    continue;
+
+	  // The file name is package_version_architecture.deb.
+	  const char * const ver_start = strchr(name, '_');
+	  if(ver_start == NULL)
+	    continue;
+	  const char * const arch_start = strchr(ver_start + 1, '_');
+	  if(arch_start == NULL)
+	    continue;
+	  const char * const arch_end = strchr(arch_start + 1, '.');
+	  if(arch_end == NULL)
+	    continue;
+
+	  const std::string pkg = DeQuoteString(std::string(name, ver_start - name));
+	  const std::string ver = DeQuoteString(std::string(ver_start + 1, arch_start - ver_start - 1));
+	  const std::string arch = DeQuoteString(std::string(arch_start + 1, arch_end - arch_start - 1));
+
+	  // Leave the archives of unconfigured architectures alone.
+	  if(!APT::Configuration::checkArchitecture(arch))
+	    continue;
+
+	  // Architecture-independent versions belong to the native
+	  // package.
+	  if(fetchable.find(make_key(pkg, ver, arch == "all" ? native_arch : arch)) != fetchable.end())
+	    continue;
+
+	  const std::string path = dir + name;
+	  struct stat st;
+	  if(stat(path.c_str(), &st) != 0)
+	    {
+	      _error->Errno("stat", _("Unable to stat %s."), path.c_str());
+	      closedir(d);
+	      return false;
+	    }
+
+	  erase(path, pkg, ver, st);
+	}
+
+      closedir(d);
+      return true;
+    }
+
+    long get_total_size() const {return total_size;}
+  };
+}
 
 int cmdline_autoclean(int argc, char *argv[], bool simulate)
 {
@@ -159,10 +281,10 @@ int cmdline_autoclean(int argc, char *argv[], bool simulate)
       return -1;
     }
 
-  LogCleaner cleaner(simulate);
+  archive_cleaner cleaner(simulate, *apt_cache_file);
   int rval=0;
-  if(!(cleaner.Go(archivedir, *apt_cache_file) &&
-       cleaner.Go(archivedir+"partial/", *apt_cache_file)) ||
+  if(!(cleaner.go(archivedir) &&
+       cleaner.go(archivedir+"partial/")) ||
      _error->PendingError())
     rval=-1;
 
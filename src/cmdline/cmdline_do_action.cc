@@ -35,6 +35,8 @@
 #include <generic/apt/config_signal.h>
 #include <generic/apt/download_install_manager.h>
 
+#include <generic/util/timings.h>
+
 #include <aptitude.h>
 
 
@@ -43,8 +45,12 @@
 #include <apt-pkg/error.h>
 #include <apt-pkg/policy.h>
 #include <apt-pkg/progress.h>
+#include <apt-pkg/strutl.h>
 
 #include <stdio.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -60,6 +66,27 @@ namespace
   {
     k(f(aptcfg->FindI("APT::Status-Fd", -1)));
   }
+
+  /** \brief Drop this process, and the download methods it will
+   *  start, to the lowest CPU and I/O priority.
+   *
+   *  Failures are ignored; the download just runs at the normal
+   *  priority.
+   */
+  void lower_priority()
+  {
+    setpriority(PRIO_PROCESS, 0, 19);
+
+#ifdef SYS_ioprio_set
+    // From linux/ioprio.h, which isn't exported to userspace.
+    const int ioprio_who_process = 1;
+    const int ioprio_class_idle = 3;
+    const int ioprio_class_shift = 13;
+
+    syscall(SYS_ioprio_set, ioprio_who_process, 0,
+	    ioprio_class_idle << ioprio_class_shift);
+#endif
+  }
 }
 
 /** \brief Used to track whether an upgrade is being performed, and if
@@ -122,6 +149,30 @@ int cmdline_do_action(int argc, char *argv[],
       if(resolver_mode == resolver_mode_default)
 	resolver_mode = resolver_mode_full;
     }
+  else if(!strcasecmp(argv[0], "prefetch-upgrades"))
+    {
+      // Fetch what a safe-upgrade would install, without asking and
+      // without getting in the way of anything else on the system.
+      // Interrupted downloads are resumed from the partial directory
+      // the next time.
+      if(argc != 1)
+	{
+	  fprintf(stderr, _("E: The prefetch-upgrades command takes no arguments\n"));
+	  return -1;
+	}
+
+      default_action = cmdline_upgrade;
+      upgrade_mode = safe_upgrade;
+      if(resolver_mode == resolver_mode_default)
+	resolver_mode = resolver_mode_safe;
+
+      download_only = true;
+      assume_yes = true;
+      always_prompt = false;
+      visual_preview = false;
+
+      lower_priority();
+    }
   else if(!strcasecmp(argv[0], "safe-upgrade") ||
 	  !strcasecmp(argv[0], "upgrade"))
     {
@@ -222,6 +273,9 @@ int cmdline_do_action(int argc, char *argv[],
   // TODO: look for filenames and call dpkg directly if that's the case.
 
   {
+    // Declared first so that it includes the work done when the
+    // action group is closed.
+    aptitude::util::phase_timer timer("build-selections");
     aptitudeDepCache::action_group group(*apt_cache_file, NULL);
 
   // If keep-all is the argument, we expect no patterns and keep all
@@ -311,6 +365,16 @@ int cmdline_do_action(int argc, char *argv[],
       // Conflicts too.
       const bool do_autoinstall = (resolver_mode != resolver_mode_safe) && aptcfg->FindB(PACKAGE "::Auto-Install", true);
       const int num_passes = do_autoinstall ? 2 : 1;
+
+      // Search for all the patterns at once, and only once: the
+      // second pass reuses the packages found here.
+      std::vector<std::string> targets;
+      for(std::vector<action_pair>::const_iterator it = actions.begin();
+	  it != actions.end(); ++it)
+	targets.push_back(it->second);
+      cmdline_pattern_matches pattern_matches;
+      cmdline_find_pattern_matches(targets, pattern_matches);
+
       std::set<pkgCache::PkgIterator> seen_virtual_packages;
       for(int pass = 0; pass < num_passes; ++pass)
 	{
@@ -328,7 +392,7 @@ int cmdline_do_action(int argc, char *argv[],
 	      cmdline_applyaction(it->second, seen_virtual_packages, it->first,
 				  to_install, to_hold, to_remove, to_purge,
 				  verbose, policy, arch_only, pass > 0,
-                                  term);
+                                  term, &pattern_matches);
 	    }
 	}
     }
@@ -395,6 +459,15 @@ int cmdline_do_action(int argc, char *argv[],
 	(cmdline_do_download(&m, verbose, term, term, term, term)
          == download_manager::success ? 0 : -1);
 
+      const aptitude::apt::delta_download_statistics &deltas =
+	m.get_delta_statistics();
+      if(deltas.get_num_rebuilt() > 0)
+	printf(ngettext("%d archive (%sB) was rebuilt from a delta instead of being downloaded.\n",
+			"%d archives (%sB) were rebuilt from deltas instead of being downloaded.\n",
+			deltas.get_num_rebuilt()),
+	       deltas.get_num_rebuilt(),
+	       SizeToStr(deltas.get_rebuilt_bytes()).c_str());
+
       if(_error->PendingError())
 	rval = -1;
 
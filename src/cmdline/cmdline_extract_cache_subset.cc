@@ -103,9 +103,10 @@ namespace aptitude
 
 		  ref_ptr<pattern> p = parse(arg);
 
-		  if(p.valid())
+		  if(!p.valid())
 		    {
 		      _error->DumpErrors();
+		      ok = false;
 		    }
 		  else
 		    {
@@ -81,6 +81,9 @@ int cmdline_forget_new(int argc, char *argv[],
 
   if(simulate)
     printf(_("Would forget what packages are new\n"));
+  else if((*apt_cache_file)->get_new_package_count() == 0)
+    // Nothing would change, so leave the state files alone.
+    ;
   else
     {
       (*apt_cache_file)->forget_new(NULL);
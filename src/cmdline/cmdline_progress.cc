@@ -32,6 +32,8 @@
 
 #include <generic/controllers/acquire_download_progress.h>
 
+#include <generic/util/throttle.h>
+
 
 // System includes:
 #include <sigc++/adaptors/bind.h>
@@ -41,6 +43,7 @@
 using aptitude::cmdline::download_status_display;
 using aptitude::controllers::acquire_download_progress;
 using aptitude::controllers::create_acquire_download_progress;
+using aptitude::util::create_throttle;
 using boost::shared_ptr;
 
 namespace aptitude
@@ -75,7 +78,8 @@ namespace aptitude
                                          display_messages);
 
       const shared_ptr<acquire_download_progress> controller =
-        create_acquire_download_progress(log, download_progress);
+        create_acquire_download_progress(log, download_progress,
+                                         create_throttle());
 
       return std::make_pair(log, controller);
     }
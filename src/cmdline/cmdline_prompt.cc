@@ -25,6 +25,7 @@
 
 #include "cmdline_action.h"
 #include "cmdline_changelog.h"
+#include "cmdline_main_loop.h"
 #include "cmdline_resolver.h"
 #include "cmdline_show.h"
 #include "cmdline_show_broken.h"
@@ -37,10 +38,12 @@
 #include <generic/apt/config_signal.h>
 #include <generic/apt/download_signal_log.h>
 #include <generic/apt/infer_reason.h>
+#include <generic/apt/pkg_changelog.h>
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 
+#include <generic/util/timings.h>
 #include <generic/util/util.h>
 
 // System includes:
@@ -93,13 +96,13 @@ static bool get_fetchinfo(fetchinfo &f)
   return true;
 }
 
-static string reason_string_list(set<reason> &reasons)
+static string reason_string_list(const vector<reason> &reasons)
 {
-  set<reason>::iterator prev=reasons.end();
+  vector<reason>::const_iterator prev=reasons.end();
   string s;
 
   bool first=true;
-  for(set<reason>::iterator why=reasons.begin();
+  for(vector<reason>::const_iterator why=reasons.begin();
       why!=reasons.end(); prev=why++)
     {
       // Filter duplicates.
@@ -261,6 +264,10 @@ static void cmdline_show_instinfo(pkgvector &items,
   sort(items.begin(), items.end(), pkg_name_lt());
   strvector output;
 
+  vector<vector<reason> > reasons;
+  if(showdeps)
+    infer_reasons(items, reasons);
+
   for(pkgvector::iterator i=items.begin(); i!=items.end(); ++i)
     {
       std::string tags;
@@ -362,11 +369,7 @@ static void cmdline_show_instinfo(pkgvector &items,
 	}
 
       if(showdeps)
-	{
-	  set<reason> reasons;
-	  infer_reason(*i, reasons);
-	  s+=reason_string_list(reasons);
-	}
+	s+=reason_string_list(reasons[i - items.begin()]);
 
       if(showwhy)
 	{
@@ -599,6 +602,67 @@ static bool prompt_trust(const shared_ptr<terminal_metrics> &term_metrics)
   return true;
 }
 
+/** Flag every package that might be an unsatisfied recommendation
+ *  or suggestion of a package being installed: the targets of
+ *  Recommends and Suggests of the versions to be installed whose OR
+ *  groups aren't satisfied, and the providers of those targets.
+ *
+ *  package_recommended() and package_suggested() walk all the
+ *  reverse dependencies of a package, which is far too slow to do for
+ *  every uninstalled package in the archive; this narrows them down
+ *  to the few that can pass those tests.
+ */
+static void find_recommendation_candidates(std::vector<bool> &candidates)
+{
+  candidates.assign((*apt_cache_file)->Head().PackageCount, false);
+
+  for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+      !pkg.end(); ++pkg)
+    {
+      pkgDepCache::StateCache &state = (*apt_cache_file)[pkg];
+      if(!state.Install())
+	continue;
+
+      pkgCache::VerIterator instver = state.InstVerIter(*apt_cache_file);
+      if(instver.end())
+	continue;
+
+      for(pkgCache::DepIterator dep = instver.DependsList(); !dep.end(); )
+	{
+	  pkgCache::DepIterator start, end;
+	  dep.GlobOr(start, end);
+
+	  if(start->Type != pkgCache::Dep::Recommends &&
+	     start->Type != pkgCache::Dep::Suggests)
+	    continue;
+
+	  bool satisfied = false;
+	  for(pkgCache::DepIterator d = start; ; ++d)
+	    {
+	      if((*apt_cache_file)[d] & pkgDepCache::DepGInstall)
+		satisfied = true;
+	      if(d == end)
+		break;
+	    }
+
+	  if(satisfied)
+	    continue;
+
+	  for(pkgCache::DepIterator d = start; ; ++d)
+	    {
+	      const pkgCache::PkgIterator target = d.TargetPkg();
+	      candidates[target->ID] = true;
+	      for(pkgCache::PrvIterator prv = target.ProvidesList();
+		  !prv.end(); ++prv)
+		candidates[prv.OwnerPkg()->ID] = true;
+
+	      if(d == end)
+		break;
+	    }
+	}
+    }
+}
+
 /** Displays a preview of the stuff to be done -- like apt-get, it collects
  *  all the "stuff to install" in one place.
  *
@@ -614,6 +678,8 @@ bool cmdline_show_preview(bool as_upgrade, pkgset &to_install,
 			  int verbose,
                           const shared_ptr<terminal_metrics> &term_metrics)
 {
+  aptitude::util::phase_timer timer("preview");
+
   const int quiet = aptcfg->FindI("Quiet", 0);
 
   pkgvector lists[num_pkg_action_states];
@@ -621,6 +687,14 @@ bool cmdline_show_preview(bool as_upgrade, pkgset &to_install,
   pkgvector extra_install, extra_remove;
   unsigned long Upgrade=0, Downgrade=0, Install=0, ReInstall=0;
 
+  // Recommendations are only listed with quiet == 0, suggestions only
+  // with verbose > 0; don't look for them otherwise.
+  const bool show_recommended = quiet == 0;
+  const bool show_suggested = verbose > 0;
+  std::vector<bool> recommendation_candidates;
+  if(show_recommended || show_suggested)
+    find_recommendation_candidates(recommendation_candidates);
+
   for(pkgCache::PkgIterator pkg=(*apt_cache_file)->PkgBegin();
       !pkg.end(); ++pkg)
     {
@@ -651,11 +725,16 @@ bool cmdline_show_preview(bool as_upgrade, pkgset &to_install,
 	    extra_remove.push_back(pkg);
 	  break;
 	case pkg_unchanged:
-	  if(pkg.CurrentVer().end())
+	  if(pkg.CurrentVer().end() &&
+	     (show_recommended || show_suggested) &&
+	     recommendation_candidates[pkg->ID])
 	    {
 	      if(package_recommended(pkg))
-		recommended.push_back(pkg);
-	      else if(package_suggested(pkg))
+		{
+		  if(show_recommended)
+		    recommended.push_back(pkg);
+		}
+	      else if(show_suggested && package_suggested(pkg))
 		suggested.push_back(pkg);
 	    }
 	default:
@@ -702,13 +781,13 @@ bool cmdline_show_preview(bool as_upgrade, pkgset &to_install,
 	}
     }
 
-  if(quiet == 0 && !recommended.empty())
+  if(!recommended.empty())
     {
       printf(_("The following packages are RECOMMENDED but will NOT be installed:\n"));
       cmdline_show_instinfo(recommended, verbose, showvers, showdeps, showsize, false, showwhy, term_metrics);
     }
 
-  if(verbose>0 && !suggested.empty())
+  if(!suggested.empty())
     {
       printf(_("The following packages are SUGGESTED but will NOT be installed:\n"));
       cmdline_show_instinfo(suggested, verbose, showvers, showdeps, showsize, false, showwhy, term_metrics);
@@ -787,7 +866,7 @@ static void cmdline_parse_changelog(string response, const shared_ptr<terminal_m
   if(packages.empty())
     printf(_("No packages found -- enter the package names on the line after 'c'.\n"));
   else
-    do_cmdline_changelog(packages, term_metrics);
+    do_cmdline_changelog(packages, term_metrics, true);
 
   prompt_string(_("Press Return to continue."));
 }
@@ -922,6 +1001,86 @@ static void prompt_help(ostream &out,
   delete f;
 }
 
+/** Print the planned actions one package per line, in the form
+ *  "action package version", or "action package old-version
+ *  new-version" for upgrades and downgrades.  Unlike
+ *  cmdline_show_preview(), nothing is laid out to fit the terminal.
+ */
+void cmdline_show_compact_preview()
+{
+  for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+      !pkg.end(); ++pkg)
+    {
+      const char *action;
+      switch(find_pkg_state(pkg, *apt_cache_file, true))
+	{
+	case pkg_auto_install:
+	case pkg_install:
+	  action = "install";
+	  break;
+	case pkg_upgrade:
+	  action = "upgrade";
+	  break;
+	case pkg_downgrade:
+	  action = "downgrade";
+	  break;
+	case pkg_reinstall:
+	  action = "reinstall";
+	  break;
+	case pkg_unused_remove:
+	case pkg_auto_remove:
+	case pkg_remove:
+	  action = ((*apt_cache_file)[pkg].iFlags & pkgDepCache::Purge)
+	    ? "purge" : "remove";
+	  break;
+	case pkg_unconfigured:
+	  action = "configure";
+	  break;
+	default:
+	  continue;
+	}
+
+      const pkgCache::VerIterator current = pkg.CurrentVer();
+      const pkgCache::VerIterator inst =
+	(*apt_cache_file)[pkg].InstVerIter(*apt_cache_file);
+
+      printf("%s %s", action, pkg.Name());
+      if(!current.end())
+	printf(" %s", current.VerStr());
+      if(!inst.end() && inst != current)
+	printf(" %s", inst.VerStr());
+      printf("\n");
+    }
+}
+
+/** The batch replacement for cmdline_do_prompt(): resolve any broken
+ *  dependencies with the first solution found, print the plan in
+ *  compact form and go ahead without asking.
+ */
+static bool cmdline_do_batch_prompt(pkgset &to_install,
+				    pkgset &to_hold,
+				    pkgset &to_remove,
+				    pkgset &to_purge,
+				    bool force_no_change,
+				    const shared_ptr<terminal_metrics> &term_metrics)
+{
+  if((*apt_cache_file)->BrokenCount() > 0 &&
+     aptitude::cmdline::batch_resolve_deps(to_install, to_hold,
+					   to_remove, to_purge,
+					   force_no_change,
+					   term_metrics) != aptitude::cmdline::resolver_success)
+    {
+      show_broken();
+      return false;
+    }
+
+  cmdline_show_compact_preview();
+
+  // Removing essential packages and installing untrusted ones still
+  // need an explicit answer.
+  return prompt_essential(term_metrics) && prompt_trust(term_metrics);
+}
+
 bool cmdline_do_prompt(bool as_upgrade,
 		       pkgset &to_install,
 		       pkgset &to_hold,
@@ -951,6 +1110,10 @@ bool cmdline_do_prompt(bool as_upgrade,
   // becomes available for future breakage.
   bool use_internal_resolver = true;
 
+  if(aptcfg->FindB(PACKAGE "::CmdLine::Batch", false))
+    return cmdline_do_batch_prompt(to_install, to_hold, to_remove, to_purge,
+				   force_no_change, term_metrics);
+
   while(!exit)
     {
       bool have_broken = false;
@@ -1029,6 +1192,10 @@ bool cmdline_do_prompt(bool as_upgrade,
 	{
 	  bool valid_response=false;
 
+	  // Fetch the new changelogs while the user reads the
+	  // preview, so that 'c' can show them right away.
+	  aptitude::apt::prefetch_upgrade_changelogs(&aptitude::cmdline::post_thunk);
+
 	  if(have_broken)
 	    {
 	      if(first)
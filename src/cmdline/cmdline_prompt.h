@@ -91,6 +91,13 @@ bool cmdline_show_preview(bool as_upgrade, pkgset &to_install,
 			  int verbose,
                           const boost::shared_ptr<aptitude::cmdline::terminal_metrics> &term_metrics);
 
+/** Print the planned actions in a compact, line-oriented form.
+ *
+ *  This is what cmdline_do_prompt() shows instead of the full
+ *  preview when Aptitude::CmdLine::Batch is set.
+ */
+void cmdline_show_compact_preview();
+
 /** Prompt for a single line of input from the user.
  *
  *  \param prompt a message to display before reading input.
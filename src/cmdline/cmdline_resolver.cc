@@ -37,8 +37,11 @@
 #include <generic/apt/aptitude_resolver_universe.h>
 #include <generic/apt/config_signal.h>
 #include <generic/apt/resolver_manager.h>
+#include <generic/apt/resolver_plan.h>
 #include <generic/problemresolver/exceptions.h>
 #include <generic/problemresolver/solution.h>
+#include <generic/util/run_metrics.h>
+#include <generic/util/timings.h>
 #include <generic/util/util.h>
 
 
@@ -159,6 +162,118 @@ void cmdline_dump_resolver()
     }
 }
 
+/** \brief Apply the command-line time limit to the resolver. */
+static void set_cmdline_time_limit()
+{
+  const int default_limit = aptcfg->FindI(PACKAGE "::ProblemResolver::TimeLimit", 0);
+  resman->set_time_limit(aptcfg->FindI(PACKAGE "::CmdLine::Resolver-Time-Limit",
+				       default_limit));
+}
+
+/** \brief Apply the command-line solution overlap limit to the
+ *  resolver.
+ */
+static void set_cmdline_max_solution_overlap()
+{
+  const int default_overlap = aptcfg->FindI(PACKAGE "::ProblemResolver::Max-Solution-Overlap", 100);
+  resman->set_max_solution_overlap(aptcfg->FindI(PACKAGE "::CmdLine::Resolver-Max-Solution-Overlap",
+						 default_overlap));
+}
+
+/** \brief Compute the fingerprint that resolver plans are saved and
+ *  loaded under, or an empty string if plans aren't being used.
+ *
+ *  \param context  How the resolver is about to be run.
+ */
+static std::string get_resolver_plan_fingerprint(const std::string &context)
+{
+  if(aptcfg->Find(PACKAGE "::CmdLine::Export-Resolver-Plan", "").empty() &&
+     aptcfg->Find(PACKAGE "::CmdLine::Import-Resolver-Plan", "").empty())
+    return std::string();
+
+  return aptitude::apt::get_resolver_plan_fingerprint(*apt_cache_file, context);
+}
+
+/** \brief The context for plans computed by cmdline_resolve_deps()
+ *  and batch_resolve_deps().
+ *
+ *  If force_no_change is set, the resolver is told to avoid changing
+ *  the packages named on the command line, so they're part of the
+ *  problem being solved.
+ */
+static std::string get_install_plan_context(const pkgset &to_install,
+					    const pkgset &to_hold,
+					    const pkgset &to_remove,
+					    const pkgset &to_purge,
+					    bool force_no_change)
+{
+  std::string rval("install");
+  if(!force_no_change)
+    return rval;
+
+  std::vector<std::string> names;
+  const pkgset *sets[4]={&to_install, &to_hold, &to_remove, &to_purge};
+  for(int i=0; i<4; ++i)
+    for(pkgset::const_iterator p=sets[i]->begin(); p!=sets[i]->end(); ++p)
+      names.push_back(p->FullName(false));
+
+  std::sort(names.begin(), names.end());
+  for(std::vector<std::string>::const_iterator it = names.begin();
+      it != names.end(); ++it)
+    rval += " " + *it;
+
+  return rval;
+}
+
+/** \brief Apply the plan given with --import-resolver-plan, if it was
+ *  saved for the problem with the given fingerprint.
+ *
+ *  \return \b true if the plan was applied, in which case there's no
+ *  need to run the resolver.
+ */
+static bool apply_imported_resolver_plan(const std::string &fingerprint)
+{
+  const std::string path = aptcfg->Find(PACKAGE "::CmdLine::Import-Resolver-Plan", "");
+  if(path.empty())
+    return false;
+
+  aptitude::apt::resolver_plan plan;
+  if(!plan.load(path, fingerprint))
+    {
+      cout << cw::util::ssprintf(_("The resolver plan in %s was not saved for this system's state; searching for a solution instead."),
+				 path.c_str())
+	   << endl;
+      return false;
+    }
+
+  if(!(*apt_cache_file)->apply_resolver_plan(plan, NULL))
+    {
+      _error->DumpErrors();
+      cout << cw::util::ssprintf(_("Unable to apply the resolver plan in %s; searching for a solution instead."),
+				 path.c_str())
+	   << endl;
+      return false;
+    }
+
+  cout << cw::util::ssprintf(_("Applied the resolver plan in %s."), path.c_str())
+       << endl;
+  return true;
+}
+
+/** \brief Save the given solution to the file given with
+ *  --export-resolver-plan.
+ */
+static void export_resolver_plan(const std::string &fingerprint,
+				 const aptitude_solution &sol)
+{
+  const std::string path = aptcfg->Find(PACKAGE "::CmdLine::Export-Resolver-Plan", "");
+  if(path.empty())
+    return;
+
+  if(!aptitude::apt::resolver_plan(sol).save(path, fingerprint))
+    _error->Error(_("Unable to write the resolver plan to %s"), path.c_str());
+}
+
 static void setup_resolver(pkgset &to_install,
 			   pkgset &to_hold,
 			   pkgset &to_remove,
@@ -763,6 +878,12 @@ public:
 static aptitude_solution wait_for_solution(cwidget::threads::box<cmdline_resolver_continuation::resolver_result> &retbox,
 					   cmdline_spinner &spin)
 {
+  aptitude::util::phase_timer timer("resolver");
+
+  const resolver_manager::state state_before = resman->state_snapshot();
+  const std::size_t steps_before = state_before.steps_processed;
+  const std::size_t dropped_before = state_before.steps_dropped;
+
   cmdline_resolver_continuation::resolver_result res;
   bool done = false;
   // The number of milliseconds to step per display.
@@ -795,6 +916,37 @@ static aptitude_solution wait_for_solution(cwidget::threads::box<cmdline_resolve
 	}
     } while(!done);
 
+  if(aptcfg->FindB(PACKAGE "::CmdLine::Show-Resolver-Stats", false))
+    resman->dump_statistics(std::cout);
+
+  // A resolver that was replaced during the search starts counting
+  // from zero again.
+  const resolver_manager::state state_after = resman->state_snapshot();
+  const std::size_t steps_after = state_after.steps_processed;
+  aptitude::util::record_resolver_search(steps_after >= steps_before
+					 ? steps_after - steps_before
+					 : steps_after,
+					 !res.out_of_time &&
+					 !res.out_of_solutions &&
+					 !res.aborted);
+
+  // Let the user know when the limit on the open queue might have
+  // cost them the answer they would otherwise have gotten.
+  const std::size_t dropped = state_after.steps_dropped >= dropped_before
+    ? state_after.steps_dropped - dropped_before
+    : state_after.steps_dropped;
+  if(dropped > 0 && !res.out_of_time && !res.aborted)
+    {
+      if(res.out_of_solutions)
+	std::cout << ssprintf(_("The resolver discarded %zd unexplored alternatives to stay within %s::ProblemResolver::Max-Open-Steps, so there might be a solution that it did not find."),
+			      dropped, PACKAGE)
+		  << std::endl;
+      else
+	std::cout << ssprintf(_("The resolver discarded %zd unexplored alternatives to stay within %s::ProblemResolver::Max-Open-Steps, so the following solution might not be the best one."),
+			      dropped, PACKAGE)
+		  << std::endl;
+    }
+
   if(res.out_of_time)
     throw NoMoreTime();
   else if(res.out_of_solutions)
@@ -838,6 +990,8 @@ aptitude_solution calculate_current_solution(bool suppress_message,
 
   cwidget::threads::box<cmdline_resolver_continuation::resolver_result> retbox;
 
+  set_cmdline_time_limit();
+  set_cmdline_max_solution_overlap();
   resman->get_solution_background(resman->generated_solution_count(),
 				  step_limit,
 				  boost::make_shared<cmdline_resolver_continuation>(boost::ref(retbox)),
@@ -859,9 +1013,26 @@ cmdline_resolve_deps(pkgset &to_install,
                      const shared_ptr<terminal_metrics> &term_metrics)
 {
   bool story_is_default = aptcfg->FindB(PACKAGE "::CmdLine::Resolver-Show-Steps", false);
+  bool tried_resolver_plan = false;
 
   while(!show_broken())
     {
+      // Computed before anything is changed, so that it describes
+      // the problem and not its solution.
+      const std::string plan_fingerprint =
+	get_resolver_plan_fingerprint(get_install_plan_context(to_install, to_hold,
+							       to_remove, to_purge,
+							       force_no_change));
+
+      // Only the problem the user started with can have a saved
+      // plan.
+      if(!tried_resolver_plan)
+	{
+	  tried_resolver_plan = true;
+	  if(apply_imported_resolver_plan(plan_fingerprint))
+	    continue;
+	}
+
       setup_resolver(to_install, to_hold, to_remove, to_purge,
 		     force_no_change);
       aptitude_solution lastsol;
@@ -926,8 +1097,12 @@ cmdline_resolve_deps(pkgset &to_install,
 		switch(toupper(response[loc]))
 		  {
 		  case 'Y':
-		    (*apt_cache_file)->apply_solution(calculate_current_solution(true, term_metrics), NULL);
-		    modified_pkgs=true;
+		    {
+		      const aptitude_solution accepted = calculate_current_solution(true, term_metrics);
+		      export_resolver_plan(plan_fingerprint, accepted);
+		      (*apt_cache_file)->apply_solution(accepted, NULL);
+		      modified_pkgs=true;
+		    }
 		    break;
 		  case 'N':
 		    {
@@ -1164,12 +1339,19 @@ namespace aptitude
       if(!resman->resolver_exists())
 	return true;
 
+      const std::string plan_fingerprint =
+	get_resolver_plan_fingerprint(cw::util::ssprintf("safe-upgrade %d %d",
+							 no_new_installs, no_new_upgrades));
+      if(apply_imported_resolver_plan(plan_fingerprint))
+	return true;
+
       cmdline_dump_resolver();
 
       try
 	{
 	  cwidget::threads::box<cmdline_resolver_continuation::resolver_result> retbox;
 
+	  set_cmdline_time_limit();
 	  resman->safe_resolve_deps_background(no_new_installs, no_new_upgrades,
 					       boost::make_shared<cmdline_resolver_continuation>(boost::ref(retbox)),
 					       cmdline_resolver_trampoline);
@@ -1183,6 +1365,7 @@ namespace aptitude
 	  if(show_story)
 	    show_resolver_actions(sol, term_metrics);
 
+	  export_resolver_plan(plan_fingerprint, sol);
 	  (*apt_cache_file)->apply_solution(sol, NULL);
 	}
       // If anything goes wrong, we give up (silently if verbosity is disabled).
@@ -1211,5 +1394,52 @@ namespace aptitude
 
       return true;
     }
+
+    cmdline_resolver_result batch_resolve_deps(pkgset &to_install,
+					       pkgset &to_hold,
+					       pkgset &to_remove,
+					       pkgset &to_purge,
+					       bool force_no_change,
+					       const shared_ptr<terminal_metrics> &term_metrics)
+    {
+      const std::string plan_fingerprint =
+	get_resolver_plan_fingerprint(get_install_plan_context(to_install, to_hold,
+							       to_remove, to_purge,
+							       force_no_change));
+      if(apply_imported_resolver_plan(plan_fingerprint))
+	return resolver_success;
+
+      setup_resolver(to_install, to_hold, to_remove, to_purge,
+		     force_no_change);
+
+      try
+	{
+	  const aptitude_solution sol = calculate_current_solution(false, term_metrics);
+	  export_resolver_plan(plan_fingerprint, sol);
+	  (*apt_cache_file)->apply_solution(sol, NULL);
+	}
+      catch(NoMoreTime)
+	{
+	  std::cout << _("No solution found within the allotted time.") << std::endl;
+	  return resolver_incomplete;
+	}
+      catch(NoMoreSolutions)
+	{
+	  std::cout << _("Unable to resolve dependencies!  Giving up...") << std::endl;
+	  return resolver_incomplete;
+	}
+      catch(const CmdlineSearchDisabledException &e)
+	{
+	  std::cout << e.errmsg();
+	  return resolver_incomplete;
+	}
+      catch(const cw::util::Exception &e)
+	{
+	  std::cout << e.errmsg() << std::endl;
+	  return resolver_incomplete;
+	}
+
+      return resolver_success;
+    }
   }
 }
@@ -165,6 +165,25 @@ namespace aptitude
 			   bool no_new_upgrades,
 			   bool show_story,
                            const boost::shared_ptr<terminal_metrics> &term_metrics);
+
+    /** \brief Resolve dependencies without asking the user anything.
+     *
+     *  The first solution the resolver finds is applied.  Unlike
+     *  cmdline_resolve_deps(), running out of time is not an
+     *  invitation to try harder: the search gives up as soon as
+     *  Aptitude::CmdLine::Resolver-Time-Limit runs out.
+     *
+     *  The parameters are as for cmdline_resolve_deps().
+     *
+     *  \return resolver_success if a solution was applied, or
+     *  resolver_incomplete otherwise.
+     */
+    cmdline_resolver_result batch_resolve_deps(pkgset &to_install,
+					       pkgset &to_hold,
+					       pkgset &to_remove,
+					       pkgset &to_purge,
+					       bool force_no_change,
+					       const boost::shared_ptr<terminal_metrics> &term_metrics);
   }
 }
 
@@ -25,6 +25,7 @@
 #include "cmdline_common.h"
 #include "cmdline_progress_display.h"
 #include "cmdline_search_progress.h"
+#include "cmdline_tab_separated.h"
 #include "cmdline_util.h"
 #include "terminal.h"
 #include "text_progress.h"
@@ -38,9 +39,11 @@
 
 #include <generic/apt/apt.h>
 #include <generic/apt/matching/match.h>
+#include <generic/apt/matching/match_profile.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 #include <generic/apt/matching/serialize.h>
+#include <generic/apt/record_prefetch.h>
 #include <generic/util/progress_info.h>
 #include <generic/util/throttle.h>
 #include <generic/views/progress.h>
@@ -87,13 +90,181 @@ using namespace cwidget::config;
 
 namespace
 {
+  /** \brief How search results are printed. */
+  enum output_style
+    {
+      /** \brief Lay the display format out in columns. */
+      output_columns,
+      /** \brief Print the display format without padding
+       *  (--disable-columns).
+       */
+      output_no_columns,
+      /** \brief Print a fixed set of tab-separated fields. */
+      output_tab_separated
+    };
+
+  void print_search_result(const pkgCache::PkgIterator &pkg,
+                           const ref_ptr<structural_match> &match,
+                           const column_definition_list &columns,
+                           int format_width,
+                           const unsigned int screen_width,
+                           output_style style,
+                           terminal_output &output)
+  {
+    if(style == output_tab_separated)
+      {
+        aptitude::cmdline::print_package_tab_separated(pkg);
+        return;
+      }
+
+    column_parameters *p =
+      new aptitude::cmdline::search_result_column_parameters(match);
+    pkg_item::pkg_columnizer columnizer(pkg,
+                                        pkg.VersionList(),
+                                        columns,
+                                        0);
+    if(style == output_no_columns)
+      output.write_text(aptitude::cmdline::de_columnize(columns, columnizer, *p) + L'\n');
+    else
+      output.write_text(columnizer.layout_columns(format_width == -1 ? screen_width : format_width,
+                                                  *p) + L'\n');
+
+    // Note that this deletes the whole result, so we can't re-use
+    // the list.
+    delete p;
+  }
+
+  /** \return \b true if printing a result will read its package
+   *  record.
+   */
+  bool output_reads_records(const column_definition_list &columns,
+                            output_style style)
+  {
+    if(style == output_tab_separated)
+      return true;
+
+    for(column_definition_list::const_iterator it = columns.begin();
+        it != columns.end(); ++it)
+      if(it->type == column_definition::COLUMN_GENERATED &&
+         (it->ival == pkg_item::pkg_columnizer::description ||
+          it->ival == pkg_item::pkg_columnizer::maintainer))
+        return true;
+
+    return false;
+  }
+
+  /** \brief Prints each batch of search results as it arrives,
+   *  skipping packages that an earlier pattern already printed.
+   */
+  class search_result_printer
+  {
+    const column_definition_list &columns;
+    int format_width;
+    unsigned int screen_width;
+    output_style style;
+    terminal_output &output;
+
+    std::vector<bool> printed;
+
+  public:
+    search_result_printer(const column_definition_list &_columns,
+                          int _format_width,
+                          unsigned int _screen_width,
+                          output_style _style,
+                          terminal_output &_output)
+      : columns(_columns),
+        format_width(_format_width),
+        screen_width(_screen_width),
+        style(_style),
+        output(_output),
+        printed((*apt_cache_file)->Head().PackageCount, false)
+    {
+    }
+
+    bool print_batch(const search_result_batch &batch)
+    {
+      for(search_result_batch::const_iterator it = batch.begin();
+          it != batch.end(); ++it)
+        {
+          if(printed[it->first->ID])
+            continue;
+          printed[it->first->ID] = true;
+
+          print_search_result(it->first, it->second,
+                              columns, format_width, screen_width,
+                              style, output);
+        }
+
+      // Let whatever is reading the output start on this batch
+      // while the next one is found.
+      output.flush();
+
+      return true;
+    }
+  };
+
+  /** \brief Print the work done by each node of the given patterns
+   *  (--explain).
+   */
+  void print_explanation(const std::vector<ref_ptr<pattern> > &patterns,
+                         const match_profile &profile)
+  {
+    for(std::vector<ref_ptr<pattern> >::const_iterator pIt = patterns.begin();
+        pIt != patterns.end(); ++pIt)
+      printf("\n%s", profile.format(*pIt).c_str());
+  }
+
+  /** \brief Print the packages matching any of the given patterns in
+   *  the order they are found, without waiting for the whole search
+   *  to finish.
+   *
+   *  No progress is displayed, since it would be interleaved with
+   *  the results.
+   */
+  int do_stream_search_packages(const std::vector<ref_ptr<pattern> > &patterns,
+                                const column_definition_list &columns,
+                                int format_width,
+                                const unsigned int screen_width,
+                                output_style style,
+                                bool debug,
+                                bool explain,
+                                const shared_ptr<terminal_output> &term_output)
+  {
+    search_result_printer printer(columns, format_width, screen_width,
+                                  style, *term_output);
+
+    match_profile profile;
+    ref_ptr<search_cache> search_info(search_cache::create());
+    if(explain)
+      search_info->set_profile(&profile);
+
+    for(std::vector<ref_ptr<pattern> >::const_iterator pIt = patterns.begin();
+        pIt != patterns.end(); ++pIt)
+      search_incremental(*pIt,
+                         search_info,
+                         sigc::mem_fun(printer,
+                                       &search_result_printer::print_batch),
+                         *apt_cache_file,
+                         *apt_package_records,
+                         64,
+                         debug);
+
+    _error->DumpErrors();
+
+    if(explain)
+      print_explanation(patterns, profile);
+
+    return 0;
+  }
+
   int do_search_packages(const std::vector<ref_ptr<pattern> > &patterns,
                          pkg_sortpolicy *sort_policy,
                          const column_definition_list &columns,
                          int format_width,
                          const unsigned int screen_width,
-                         bool disable_columns,
+                         output_style style,
                          bool debug,
+                         bool explain,
                          const shared_ptr<terminal_locale> &term_locale,
                          const shared_ptr<terminal_metrics> &term_metrics,
                          const shared_ptr<terminal_output> &term_output)
@@ -107,7 +278,11 @@ namespace
       create_throttle();
 
     results_list output;
+    match_profile profile;
     ref_ptr<search_cache> search_info(search_cache::create());
+    if(explain)
+      search_info->set_profile(&profile);
+
     for(std::vector<ref_ptr<pattern> >::const_iterator pIt = patterns.begin();
         pIt != patterns.end(); ++pIt)
       {
@@ -131,32 +306,57 @@ namespace
 
     _error->DumpErrors();
 
-    std::sort(output.begin(), output.end(),
-              aptitude::cmdline::package_results_lt(sort_policy));
-    output.erase(std::unique(output.begin(), output.end(),
-                             aptitude::cmdline::package_results_eq(sort_policy)),
-                 output.end());
+    // Sort on keys computed once per package, comparing candidate
+    // versions as package_results_lt does.
+    {
+      std::vector<pkg_sortpolicy::item> items;
+      items.reserve(output.size());
+      for(results_list::const_iterator it = output.begin(); it != output.end(); ++it)
+        items.push_back(pkg_sortpolicy::item(it->first,
+                                             (*apt_cache_file)[it->first].CandidateVerIter(*apt_cache_file)));
+
+      std::vector<std::size_t> order;
+      pkg_sort_keys(sort_policy, items).get_unique_order(order);
+
+      results_list sorted;
+      sorted.reserve(order.size());
+      for(std::vector<std::size_t>::const_iterator it = order.begin();
+          it != order.end(); ++it)
+        sorted.push_back(output[*it]);
+
+      output.swap(sorted);
+    }
 
-    for(results_list::const_iterator it = output.begin(); it != output.end(); ++it)
+    if(output_reads_records(columns, style))
       {
-        column_parameters *p =
-          new aptitude::cmdline::search_result_column_parameters(it->second);
-        pkg_item::pkg_columnizer columnizer(it->first,
-                                            it->first.VersionList(),
-                                            columns,
-                                            0);
-        if(disable_columns)
-          printf("%ls\n", aptitude::cmdline::de_columnize(columns, columnizer, *p).c_str());
-        else
-          printf("%ls\n",
-                 columnizer.layout_columns(format_width == -1 ? screen_width : format_width,
-                                           *p).c_str());
-
-        // Note that this deletes the whole result, so we can't re-use
-        // the list.
-        delete p;
+        // Read the records that will be displayed in one pass,
+        // rather than seeking for each row.
+        std::vector<pkgCache::VerIterator> versions;
+        for(results_list::const_iterator it = output.begin(); it != output.end(); ++it)
+          {
+            if(style == output_tab_separated)
+              {
+                pkgCache::VerIterator ver = it->first.CurrentVer();
+                if(ver.end())
+                  ver = (*apt_cache_file)[it->first].CandidateVerIter(*apt_cache_file);
+                versions.push_back(ver);
+              }
+            else
+              versions.push_back(it->first.VersionList());
+          }
+
+        aptitude::apt::prefetch_version_records(versions, false, true);
       }
 
+    for(results_list::const_iterator it = output.begin(); it != output.end(); ++it)
+      print_search_result(it->first, it->second,
+                          columns, format_width, screen_width,
+                          style, *term_output);
+    term_output->flush();
+
+    if(explain)
+      print_explanation(patterns, profile);
+
     return 0;
   }
 }
@@ -172,9 +372,13 @@ int cmdline_search(int argc, char *argv[], const char *status_fname,
 
   pkg_item::pkg_columnizer::setup_columns();
 
-  pkg_sortpolicy *s=parse_sortpolicy(sort);
+  // "none" asks for the results in the order they're found, which
+  // lets them be printed as soon as they're found.
+  const bool unsorted = (strcasecmp(sort.c_str(), "none") == 0);
+
+  pkg_sortpolicy *s = unsorted ? NULL : parse_sortpolicy(sort);
 
-  if(!s)
+  if(!unsorted && !s)
     {
       _error->DumpErrors();
       return -1;
@@ -244,13 +448,32 @@ int cmdline_search(int argc, char *argv[], const char *status_fname,
       matchers.push_back(m);
     }
 
+  output_style style = output_columns;
+  if(aptitude::cmdline::tab_separated_output_enabled())
+    style = output_tab_separated;
+  else if(disable_columns)
+    style = output_no_columns;
+
+  const bool explain = aptcfg->FindB(PACKAGE "::CmdLine::Explain-Search", false);
+
+  if(unsorted)
+    return do_stream_search_packages(matchers,
+                                     *columns,
+                                     real_width,
+                                     screen_width,
+                                     style,
+                                     debug,
+                                     explain,
+                                     term);
+
   return do_search_packages(matchers,
                             s,
                             *columns,
                             real_width,
                             screen_width,
-                            disable_columns,
+                            style,
                             debug,
+                            explain,
                             term,
                             term,
                             term);
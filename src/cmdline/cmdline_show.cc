@@ -25,6 +25,7 @@
 #include <desc_render.h>
 
 #include "cmdline_common.h"
+#include "cmdline_tab_separated.h"
 #include "cmdline_util.h"
 #include "terminal.h"
 #include "text_progress.h"
@@ -34,6 +35,7 @@
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
+#include <generic/apt/record_prefetch.h>
 
 
 // System includes:
@@ -372,6 +374,12 @@ static cwidget::fragment *state_fragment(pkgCache::PkgIterator pkg, pkgCache::Ve
 static void show_package(pkgCache::PkgIterator pkg, int verbose,
                          const shared_ptr<terminal_metrics> &term_metrics)
 {
+  if(aptitude::cmdline::tab_separated_output_enabled())
+    {
+      aptitude::cmdline::print_package_tab_separated(pkg);
+      return;
+    }
+
   vector<cw::fragment *> fragments;
 
   fragments.push_back(cw::fragf("%s%s%n", _("Package: "), pkg.Name()));
@@ -409,7 +417,7 @@ cw::fragment *version_file_fragment(const pkgCache::VerIterator &ver,
   if(!estate.forbidver.empty())
     fragments.push_back(cw::fragf("%s: %s%n",
 			      _("Forbidden version"),
-			      estate.forbidver.c_str()));
+			      estate.forbidver.get().c_str()));
 
   if(!pkg.CurrentVer().end())
     fragments.push_back(cw::fragf("%s: %s%n", _("Automatically installed"),
@@ -492,7 +500,18 @@ cw::fragment *version_file_fragment(const pkgCache::VerIterator &ver,
 static void show_version(pkgCache::VerIterator ver, int verbose,
                          const shared_ptr<terminal_metrics> &term_metrics)
 {
-  if(ver.FileList().end())
+  if(aptitude::cmdline::tab_separated_output_enabled())
+    {
+      // Print the raw record instead, one field per line.
+      for(pkgCache::VerFileIterator vf = ver.FileList(); !vf.end(); ++vf)
+	{
+	  aptitude::cmdline::print_record_tab_separated(ver, vf);
+
+	  if(verbose < 2)
+	    break;
+	}
+    }
+  else if(ver.FileList().end())
     {
       cw::fragment *f=version_file_fragment(ver, ver.FileList(), verbose);
 
@@ -519,13 +538,17 @@ static void show_version(pkgCache::VerIterator ver, int verbose,
     }
 }
 
+/** \brief Find the versions of a package that "show" will display.
+ *
+ *  If this returns no versions, the package itself is displayed.
+ */
 static
-bool do_cmdline_show_target(const pkgCache::PkgIterator &pkg,
-			    cmdline_version_source source,
-			    const string &sourcestr,
-			    int verbose,
-			    bool has_explicit_source,
-                            const shared_ptr<terminal_metrics> &term_metrics)
+void find_versions_to_show(const pkgCache::PkgIterator &pkg,
+			   cmdline_version_source source,
+			   const string &sourcestr,
+			   int verbose,
+			   bool has_explicit_source,
+			   std::vector<pkgCache::VerIterator> &output)
 {
   if(verbose == 0 || has_explicit_source)
     {
@@ -539,15 +562,25 @@ bool do_cmdline_show_target(const pkgCache::PkgIterator &pkg,
 	ver = pkg.VersionList();
 
       if(!ver.end())
-	show_version(ver, verbose, term_metrics);
-      else
-	show_package(pkg, verbose, term_metrics);
+	output.push_back(ver);
     }
-  else if(!pkg.VersionList().end())
-    for(pkgCache::VerIterator ver=pkg.VersionList(); !ver.end(); ++ver)
-      show_version(ver, verbose, term_metrics);
   else
+    for(pkgCache::VerIterator ver=pkg.VersionList(); !ver.end(); ++ver)
+      output.push_back(ver);
+}
+
+static
+bool do_cmdline_show_target(const pkgCache::PkgIterator &pkg,
+			    const std::vector<pkgCache::VerIterator> &versions,
+			    int verbose,
+                            const shared_ptr<terminal_metrics> &term_metrics)
+{
+  if(versions.empty())
     show_package(pkg, verbose, term_metrics);
+  else
+    for(std::vector<pkgCache::VerIterator>::const_iterator it = versions.begin();
+	it != versions.end(); ++it)
+      show_version(*it, verbose, term_metrics);
 
   return true;
 }
@@ -585,12 +618,14 @@ bool do_cmdline_show(string s, int verbose, const shared_ptr<terminal_metrics> &
     }
 
   if(!is_pattern && !pkg.end())
-    return do_cmdline_show_target(pkg,
-                                  source,
-                                  sourcestr,
-                                  verbose,
-                                  has_explicit_source,
-                                  term_metrics);
+    {
+      std::vector<pkgCache::VerIterator> versions;
+      find_versions_to_show(pkg, source, sourcestr,
+			    verbose, has_explicit_source,
+			    versions);
+
+      return do_cmdline_show_target(pkg, versions, verbose, term_metrics);
+    }
   else if(is_pattern)
     {
       using namespace aptitude::matching;
@@ -611,14 +646,28 @@ bool do_cmdline_show(string s, int verbose, const shared_ptr<terminal_metrics> &
 	     *apt_cache_file,
 	     *apt_package_records);
 
-      for(std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > >::const_iterator
-	    it = matches.begin(); it != matches.end(); ++it)
+      // Pick all the versions up front, so that their records can
+      // be read in one pass instead of in the order of the matches.
+      std::vector<std::vector<pkgCache::VerIterator> > versions(matches.size());
+      std::vector<pkgCache::VerIterator> all_versions;
+      for(std::size_t i = 0; i < matches.size(); ++i)
+	{
+	  find_versions_to_show(matches[i].first, source, sourcestr,
+				verbose, has_explicit_source,
+				versions[i]);
+	  all_versions.insert(all_versions.end(),
+			      versions[i].begin(), versions[i].end());
+	}
+
+      aptitude::apt::prefetch_version_records(all_versions,
+					      verbose >= 2,
+					      true);
+
+      for(std::size_t i = 0; i < matches.size(); ++i)
 	{
-	  if(!do_cmdline_show_target(it->first,
-                                     source,
-                                     sourcestr,
-                                     verbose,
-                                     has_explicit_source,
+	  if(!do_cmdline_show_target(matches[i].first,
+				     versions[i],
+				     verbose,
                                      term_metrics))
 	    return false;
 	}
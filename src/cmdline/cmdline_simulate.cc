@@ -23,6 +23,7 @@
 
 #include "cmdline_common.h"
 #include "cmdline_prompt.h"
+#include "cmdline_tab_separated.h"
 #include "terminal.h"
 
 #include <aptitude.h>
@@ -33,12 +34,76 @@
 // System includes:
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/error.h>
+#include <apt-pkg/packagemanager.h>
 
 #include <stdio.h>
 
+using aptitude::cmdline::print_fields_tab_separated;
+using aptitude::cmdline::tab_separated_output_enabled;
 using aptitude::cmdline::terminal_metrics;
 using boost::shared_ptr;
 
+namespace
+{
+  /** \brief A package manager that prints each step of the
+   *  installation, in the order dpkg would be run, instead of doing
+   *  it.
+   *
+   *  Unlike pkgSimulate, this doesn't keep a second dependency cache
+   *  to check the steps against; it only reports the order that
+   *  pkgPackageManager chose.
+   */
+  class plan_printer : public pkgPackageManager
+  {
+    const bool tab_separated;
+
+    void print_step(const char *action,
+		    pkgCache::PkgIterator pkg,
+		    pkgCache::VerIterator ver)
+    {
+      const char *arch = ver.end() ? NULL : ver.Arch();
+      const char *version = ver.end() ? "" : ver.VerStr();
+
+      if(tab_separated)
+	{
+	  std::vector<std::string> fields;
+	  fields.push_back(action);
+	  fields.push_back(pkg.Name());
+	  fields.push_back(arch == NULL ? "" : arch);
+	  fields.push_back(version);
+	  print_fields_tab_separated(fields);
+	}
+      else
+	printf("%s %s %s\n", action, pkg.Name(), version);
+    }
+
+  protected:
+    bool Install(PkgIterator pkg, std::string)
+    {
+      print_step("unpack", pkg, Cache[pkg].InstVerIter(Cache));
+      return true;
+    }
+
+    bool Configure(PkgIterator pkg)
+    {
+      print_step("configure", pkg, Cache[pkg].InstVerIter(Cache));
+      return true;
+    }
+
+    bool Remove(PkgIterator pkg, bool purge)
+    {
+      print_step(purge ? "purge" : "remove", pkg, pkg.CurrentVer());
+      return true;
+    }
+
+  public:
+    plan_printer(pkgDepCache *cache, bool _tab_separated)
+      : pkgPackageManager(cache), tab_separated(_tab_separated)
+    {
+    }
+  };
+}
+
 int cmdline_simulate(bool as_upgrade,
 		     pkgset &to_install, pkgset &to_hold, pkgset &to_remove,
 		     pkgset &to_purge,
@@ -61,12 +126,33 @@ int cmdline_simulate(bool as_upgrade,
       return 0;
     }
 
-  if(verbose==0)
+  // In batch mode, print the order of the steps whatever the
+  // verbosity; nothing is looked up in the archives or the package
+  // records.
+  const bool batch = aptcfg->FindB(PACKAGE "::CmdLine::Batch", false);
+
+  if(verbose==0 && !batch)
     {
       printf(_("Would download/install/remove packages.\n"));
       return 0;
     }
 
+  if(batch)
+    {
+      plan_printer PM(*apt_cache_file, tab_separated_output_enabled());
+      const pkgPackageManager::OrderResult Res = PM.DoInstall();
+
+      if(Res == pkgPackageManager::Failed)
+	return -1;
+      else if(Res != pkgPackageManager::Completed)
+	{
+	  _error->Error(_("Internal Error, Ordering didn't finish"));
+	  return -1;
+	}
+      else
+	return 0;
+    }
+
   pkgSimulate PM(*apt_cache_file);
   pkgPackageManager::OrderResult Res=PM.DoInstall();
 
@@ -0,0 +1,251 @@
+/** \file cmdline_tab_separated.cc */
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+// Local includes:
+#include "cmdline_tab_separated.h"
+
+#include <aptitude.h>
+
+#include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+
+// System includes:
+#include <apt-pkg/pkgrecords.h>
+
+#include <cwidget/generic/util/transcode.h>
+
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace aptitude
+{
+  namespace cmdline
+  {
+    namespace
+    {
+      const char *state_name(const pkgCache::PkgIterator &pkg)
+      {
+        switch(pkg->CurrentState)
+          {
+          case pkgCache::State::NotInstalled:
+            return "not-installed";
+          case pkgCache::State::UnPacked:
+            return "unpacked";
+          case pkgCache::State::HalfConfigured:
+            return "half-configured";
+          case pkgCache::State::HalfInstalled:
+            return "half-installed";
+          case pkgCache::State::ConfigFiles:
+            return "config-files";
+          case pkgCache::State::Installed:
+            return "installed";
+          case pkgCache::State::TriggersAwaited:
+            return "triggers-awaited";
+          case pkgCache::State::TriggersPending:
+            return "triggers-pending";
+          default:
+            return "unknown";
+          }
+      }
+
+      const char *yes_no(bool b)
+      {
+        return b ? "yes" : "no";
+      }
+
+      const char *or_empty(const char *s)
+      {
+        return s == NULL ? "" : s;
+      }
+
+      // Escape a field value and append it to a line, followed by a
+      // tab.
+      void append_tab_separated_field(std::string &line,
+                                      const char *begin,
+                                      const char *end)
+      {
+        for(const char *c = begin; c != end; ++c)
+          switch(*c)
+            {
+            case '\t':
+              line += "\\t";
+              break;
+            case '\n':
+              line += "\\n";
+              break;
+            case '\\':
+              line += "\\\\";
+              break;
+            default:
+              line += *c;
+              break;
+            }
+
+        line += '\t';
+      }
+
+      void append_tab_separated_field(std::string &line, const char *value)
+      {
+        append_tab_separated_field(line, value, value + strlen(value));
+      }
+
+      // Replace the tab after the last field with a newline and
+      // write the line out.
+      void print_line(std::string &line)
+      {
+        if(!line.empty())
+          line[line.size() - 1] = '\n';
+        fwrite(line.data(), 1, line.size(), stdout);
+      }
+    }
+
+    bool tab_separated_output_enabled()
+    {
+      return aptcfg->FindB(PACKAGE "::CmdLine::Tab-Separated", false);
+    }
+
+    void print_package_tab_separated(const pkgCache::PkgIterator &pkg)
+    {
+      pkgDepCache::StateCache &state = (*apt_cache_file)[pkg];
+      const pkgCache::VerIterator current = pkg.CurrentVer();
+      const pkgCache::VerIterator candidate =
+        state.CandidateVerIter(*apt_cache_file);
+      // Describe the installed version if there is one, since that's
+      // what the package is on this system.
+      const pkgCache::VerIterator described =
+        !current.end() ? current : candidate;
+
+      std::string line;
+      append_tab_separated_field(line, pkg.Name());
+      append_tab_separated_field(line,
+                                 described.end() ? "" : or_empty(const_cast<pkgCache::VerIterator &>(described).Arch()));
+      append_tab_separated_field(line, state_name(pkg));
+      append_tab_separated_field(line,
+                                 yes_no(!current.end() &&
+                                        (state.Flags & pkgCache::Flag::Auto)));
+      append_tab_separated_field(line, current.end() ? "" : current.VerStr());
+      append_tab_separated_field(line, candidate.end() ? "" : candidate.VerStr());
+      append_tab_separated_field(line,
+                                 described.end() ? "" : or_empty(described.Section()));
+      if(described.end())
+        append_tab_separated_field(line, "");
+      else
+        append_tab_separated_field(line,
+                                   cwidget::util::transcode(get_short_description(described,
+                                                                                  apt_package_records)).c_str());
+
+      print_line(line);
+    }
+
+    void print_version_tab_separated(const pkgCache::VerIterator &ver)
+    {
+      pkgCache::VerIterator &mver = const_cast<pkgCache::VerIterator &>(ver);
+      const pkgCache::PkgIterator pkg = mver.ParentPkg();
+      const pkgCache::VerIterator candidate =
+        (*apt_cache_file)[pkg].CandidateVerIter(*apt_cache_file);
+
+      std::string archives;
+      for(pkgCache::VerFileIterator vf = mver.FileList(); !vf.end(); ++vf)
+        {
+          const char * const archive = vf.File().Archive();
+          if(archive == NULL)
+            continue;
+
+          if(!archives.empty())
+            archives += ',';
+          archives += archive;
+        }
+
+      std::string line;
+      append_tab_separated_field(line, pkg.Name());
+      append_tab_separated_field(line, or_empty(mver.Arch()));
+      append_tab_separated_field(line, mver.VerStr());
+      append_tab_separated_field(line, yes_no(pkg.CurrentVer() == ver));
+      append_tab_separated_field(line, yes_no(candidate == ver));
+      append_tab_separated_field(line, or_empty(mver.PriorityType()));
+      append_tab_separated_field(line, or_empty(mver.Section()));
+      append_tab_separated_field(line, archives.c_str());
+
+      print_line(line);
+    }
+
+    void print_fields_tab_separated(const std::vector<std::string> &fields)
+    {
+      std::string line;
+      for(std::vector<std::string>::const_iterator it = fields.begin();
+          it != fields.end(); ++it)
+        append_tab_separated_field(line, it->data(), it->data() + it->size());
+
+      print_line(line);
+    }
+
+    void print_record_tab_separated(const pkgCache::VerIterator &ver,
+                                    const pkgCache::VerFileIterator &vf)
+    {
+      pkgCache::VerIterator &mver = const_cast<pkgCache::VerIterator &>(ver);
+
+      std::string prefix;
+      append_tab_separated_field(prefix, mver.ParentPkg().Name());
+      append_tab_separated_field(prefix, or_empty(mver.Arch()));
+      append_tab_separated_field(prefix, mver.VerStr());
+
+      const char *start = NULL, *stop = NULL;
+      apt_package_records->Lookup(vf).GetRec(start, stop);
+      if(start == NULL)
+        return;
+
+      // Walk over the record one field at a time.  A field runs up
+      // to the first newline that isn't followed by a continuation
+      // line.
+      const char *field = start;
+      while(field < stop && *field != '\n')
+        {
+          const char *field_end = field;
+          while(field_end < stop)
+            {
+              if(*field_end == '\n' &&
+                 (field_end + 1 == stop ||
+                  (field_end[1] != ' ' && field_end[1] != '\t')))
+                break;
+              ++field_end;
+            }
+
+          const char *colon = field;
+          while(colon < field_end && *colon != ':')
+            ++colon;
+
+          if(colon < field_end)
+            {
+              const char *value = colon + 1;
+              while(value < field_end && (*value == ' ' || *value == '\t'))
+                ++value;
+
+              std::string line(prefix);
+              append_tab_separated_field(line, field, colon);
+              append_tab_separated_field(line, value, field_end);
+              print_line(line);
+            }
+
+          field = field_end + 1;
+        }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/** \file cmdline_tab_separated.h */  // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_CMDLINE_TAB_SEPARATED_H
+#define APTITUDE_CMDLINE_TAB_SEPARATED_H
+
+// System includes:
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+#include <vector>
+
+/** \brief Output of "search", "show" and "versions" for scripts.
+ *
+ *  When Aptitude::CmdLine::Tab-Separated is set, these commands print
+ *  one line per result with tab-separated fields, in a fixed order
+ *  that doesn't depend on the display format, the terminal width or
+ *  the locale.  The fields are read straight from the package cache
+ *  and records; no fragments or columns are laid out.
+ *
+ *  Tabs, newlines and backslashes in field values are written as
+ *  "\t", "\n" and "\\", so every result is exactly one line.
+ */
+
+namespace aptitude
+{
+  namespace cmdline
+  {
+    /** \return \b true if tab-separated output was requested. */
+    bool tab_separated_output_enabled();
+
+    /** \brief Print one line describing a package.
+     *
+     *  The fields are: name, architecture, current state,
+     *  whether it was automatically installed ("yes" or "no"),
+     *  installed version, candidate version, section and short
+     *  description.  Missing values are empty.
+     */
+    void print_package_tab_separated(const pkgCache::PkgIterator &pkg);
+
+    /** \brief Print one line describing a version.
+     *
+     *  The fields are: package name, architecture, version, whether
+     *  it is installed ("yes" or "no"), whether it is the candidate
+     *  ("yes" or "no"), priority, section, and the archives it is
+     *  available from, separated by commas.
+     */
+    void print_version_tab_separated(const pkgCache::VerIterator &ver);
+
+    /** \brief Print one line holding the given fields, escaped as
+     *  described above.
+     */
+    void print_fields_tab_separated(const std::vector<std::string> &fields);
+
+    /** \brief Print the package record of a version as found in one
+     *  index file.
+     *
+     *  Each field of the record becomes one line holding the package
+     *  name, architecture, version, field name and field value.
+     *  Continuation lines are kept in the value, joined by "\n".
+     */
+    void print_record_tab_separated(const pkgCache::VerIterator &ver,
+                                    const pkgCache::VerFileIterator &vf);
+  }
+}
+
+#endif // APTITUDE_CMDLINE_TAB_SEPARATED_H
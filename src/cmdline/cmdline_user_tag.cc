@@ -51,27 +51,33 @@ namespace aptitude
     {
       enum user_tag_action { action_add, action_remove };
 
+      // Apply the action to all the packages at once, so that it
+      // takes a single pass over the cache state.
       void do_user_tag(user_tag_action act,
 		       const std::string &tag,
-		       const pkgCache::PkgIterator &pkg,
+		       const std::vector<pkgCache::PkgIterator> &pkgs,
 		       int verbose)
       {
 	switch(act)
 	  {
 	  case action_add:
 	    if(verbose > 0)
+	      for(std::vector<pkgCache::PkgIterator>::const_iterator it =
+		    pkgs.begin(); it != pkgs.end(); ++it)
 				// Sometimes also "user-tag" is used!
-	      printf(_("Adding user tag \"%s\" to the package \"%s\".\n"),
-		     tag.c_str(), pkg.Name());
+		printf(_("Adding user tag \"%s\" to the package \"%s\".\n"),
+		       tag.c_str(), it->Name());
 
-	    (*apt_cache_file)->attach_user_tag(pkg, tag, NULL);
+	    (*apt_cache_file)->attach_user_tag(pkgs, tag, NULL);
 	    break;
 	  case action_remove:
 	    if(verbose > 0)
-	      printf(_("Removing user tag \"%s\" from the package \"%s\".\n"),
-		     tag.c_str(), pkg.Name());
+	      for(std::vector<pkgCache::PkgIterator>::const_iterator it =
+		    pkgs.begin(); it != pkgs.end(); ++it)
+		printf(_("Removing user tag \"%s\" from the package \"%s\".\n"),
+		       tag.c_str(), it->Name());
 
-	    (*apt_cache_file)->detach_user_tag(pkg, tag, NULL);
+	    (*apt_cache_file)->detach_user_tag(pkgs, tag, NULL);
 	    break;
 	  default:
 	    fprintf(stderr, "Internal error: bad user tag action %d.", act);
@@ -118,6 +124,7 @@ namespace aptitude
 
       std::string tag(argv[1]);
 
+      std::vector<pkgCache::PkgIterator> pkgs;
       bool all_ok = true;
       for(int i = 2; i < argc; ++i)
 	{
@@ -131,7 +138,7 @@ namespace aptitude
 		  all_ok = false;
 		}
 	      else
-		do_user_tag(action, tag, pkg, verbose);
+		pkgs.push_back(pkg);
 	    }
 	  else
 	    {
@@ -156,11 +163,13 @@ namespace aptitude
 
 		  for(std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > >::const_iterator
 			it = matches.begin(); it != matches.end(); ++it)
-		    do_user_tag(action, tag, it->first, verbose);
+		    pkgs.push_back(it->first);
 		}
 	    }
 	}
 
+      do_user_tag(action, tag, pkgs, verbose);
+
       shared_ptr<OpProgress> text_progress = make_text_progress(false, term, term, term);
       if(!(*apt_cache_file)->save_selection_list(*text_progress))
 	return 1;
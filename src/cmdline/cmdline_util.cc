@@ -39,6 +39,7 @@
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 
+#include <generic/util/timings.h>
 
 // System includes:
 #include <apt-pkg/error.h>
@@ -215,7 +216,8 @@ pkgCache::VerIterator cmdline_find_ver(pkgCache::PkgIterator pkg,
 bool cmdline_parse_source(const string &input,
 			  cmdline_version_source &source,
 			  string &package,
-			  string &sourcestr)
+			  string &sourcestr,
+			  bool quiet)
 {
   string scratch=input;
 
@@ -236,7 +238,8 @@ bool cmdline_parse_source(const string &input,
     {
       if(source==cmdline_version_archive)
 	{
-	  printf(_("You cannot specify both an archive and a version for a package\n"));
+	  if(!quiet)
+	    printf(_("You cannot specify both an archive and a version for a package\n"));
 	  return false;
 	}
 
@@ -465,7 +468,11 @@ download_manager::result cmdline_do_download(download_manager *m,
 
   do
     {
-      pkgAcquire::RunResult download_res = m->do_download();
+      pkgAcquire::RunResult download_res;
+      {
+        aptitude::util::phase_timer timer("download");
+        download_res = m->do_download();
+      }
       m->finish(download_res, progress.get(),
 		sigc::bind(sigc::ptr_fun(&assign<download_manager::result>),
 			   &finish_res));
@@ -711,24 +718,33 @@ namespace aptitude
     void apply_user_tags(const std::vector<tag_application> &user_tags)
     {
       using namespace matching;
-      cwidget::util::ref_ptr<search_cache> search_info(search_cache::create());
-      for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
-	  !pkg.end(); ++pkg)
+      using cwidget::util::ref_ptr;
+
+      // Each application is made to all of its packages at once.
+      // They are made in order, so a pattern sees the tags applied
+      // before it.
+      for(std::vector<tag_application>::const_iterator it =
+	    user_tags.begin(); it != user_tags.end(); ++it)
 	{
-	  for(std::vector<tag_application>::const_iterator it = 
-		user_tags.begin(); it != user_tags.end(); ++it)
+	  std::vector<pkgCache::PkgIterator> pkgs;
+	  if(it->get_pattern().valid())
 	    {
-	      bool applicable = false;
-	      if(it->get_pattern().valid())
-		{
-		  if(matching::get_match(it->get_pattern(),
-					 pkg,
-					 search_info,
-					 *apt_cache_file,
-					 *apt_package_records).valid())
-		    applicable = true;
-		}
-	      else
+	      // Use a new cache each time, since the earlier
+	      // applications might have changed which packages match.
+	      std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > matches;
+	      search(it->get_pattern(), search_cache::create(),
+		     matches,
+		     *apt_cache_file,
+		     *apt_package_records);
+
+	      for(std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > >::const_iterator
+		    m_it = matches.begin(); m_it != matches.end(); ++m_it)
+		pkgs.push_back(m_it->first);
+	    }
+	  else
+	    {
+	      for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+		  !pkg.end(); ++pkg)
 		{
 		  const pkgDepCache::StateCache &state = (*apt_cache_file)[pkg];
 		  // Perhaps we should somehow filter out automatic
@@ -737,17 +753,14 @@ namespace aptitude
 		  // Instead we just add the tag to all packages that
 		  // are being modified.
 		  if(!state.Keep())
-		    applicable = true;
-		}
-
-	      if(applicable)
-		{
-		  if(it->get_is_add())
-		    (*apt_cache_file)->attach_user_tag(pkg, it->get_tag(), NULL);
-		  else
-		    (*apt_cache_file)->detach_user_tag(pkg, it->get_tag(), NULL);
+		    pkgs.push_back(pkg);
 		}
 	    }
+
+	  if(it->get_is_add())
+	    (*apt_cache_file)->attach_user_tag(pkgs, it->get_tag(), NULL);
+	  else
+	    (*apt_cache_file)->detach_user_tag(pkgs, it->get_tag(), NULL);
 	}
     }
 
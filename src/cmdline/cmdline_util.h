@@ -86,13 +86,16 @@ void ui_solution_screen();
  *  \param package will be set to the package name/pattern
  *  \param sourcestr will be set to the string associated with the source,
  *                   if any
+ *  \param quiet if \b true, no message is printed when the input
+ *               can't be parsed
  *
  *  \return \b true if the source was successfully parsed.
  */
 bool cmdline_parse_source(const string &input,
 			  cmdline_version_source &source,
 			  string &package,
-			  string &sourcestr);
+			  string &sourcestr,
+			  bool quiet = false);
 
 /** Run the given download and post-download commands using the
  *  standard command-line UI.  Runs the preparation routine, the
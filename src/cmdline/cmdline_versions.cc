@@ -23,16 +23,20 @@
 
 #include "cmdline_progress_display.h"
 #include "cmdline_search_progress.h"
+#include "cmdline_tab_separated.h"
 #include "cmdline_util.h"
 #include "terminal.h"
 
 #include <aptitude.h>
 #include <pkg_ver_item.h>
 #include <load_sortpolicy.h>
+#include <pkg_sortpolicy.h>
 
+#include <generic/apt/apt.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 #include <generic/apt/matching/serialize.h>
+#include <generic/apt/record_prefetch.h>
 #include <generic/util/progress_info.h>
 #include <generic/util/throttle.h>
 #include <generic/views/progress.h>
@@ -66,8 +70,6 @@ using aptitude::cmdline::terminal_io;
 using aptitude::cmdline::terminal_locale;
 using aptitude::cmdline::terminal_metrics;
 using aptitude::cmdline::terminal_output;
-using aptitude::cmdline::version_results_eq;
-using aptitude::cmdline::version_results_lt;
 using aptitude::matching::serialize_pattern;
 using aptitude::util::create_throttle;
 using aptitude::util::progress_info;
@@ -219,7 +221,8 @@ namespace
                                int format_width,
                                const unsigned int screen_width,
                                bool disable_columns,
-                               bool show_package_names)
+                               bool show_package_names,
+                               terminal_output &term_output)
   {
     for(std::vector<std::pair<pkgCache::VerIterator, cw::util::ref_ptr<m::structural_match> > >::const_iterator it = output.begin();
         it != output.end(); ++it)
@@ -230,11 +233,10 @@ namespace
                                       columns,
                                       0);
         if(disable_columns)
-          printf("%ls\n", aptitude::cmdline::de_columnize(columns, columnizer, *p).c_str());
+          term_output.write_text(aptitude::cmdline::de_columnize(columns, columnizer, *p) + L'\n');
         else
-          printf("%ls\n",
-                 columnizer.layout_columns(format_width == -1 ? screen_width : format_width,
-                                           *p).c_str());
+          term_output.write_text(columnizer.layout_columns(format_width == -1 ? screen_width : format_width,
+                                                           *p) + L'\n');
       }
   }
 
@@ -391,12 +393,57 @@ namespace
     // don't have to sort lots of little lists later.  The code below
     // very carefully builds a list of the versions of each package in
     // a stable way, so the versions will continue to be in order.
-    std::sort(output.begin(), output.end(), version_results_lt(sort_policy));
-    output.erase(std::unique(output.begin(), output.end(), version_results_eq(sort_policy)),
-                 output.end());
+    //
+    // The sort runs over the indices of the results, using keys
+    // computed once per version, and the results are permuted
+    // afterwards, so that the sorting threads never copy the match
+    // objects: their reference counts aren't thread-safe.
+    {
+      std::vector<pkg_sortpolicy::item> items;
+      items.reserve(output.size());
+      for(results_list::const_iterator it = output.begin(); it != output.end(); ++it)
+        items.push_back(pkg_sortpolicy::item(it->first.ParentPkg(), it->first));
+
+      std::vector<std::size_t> order;
+      pkg_sort_keys(sort_policy, items)
+        .get_unique_order(order, aptcfg->FindI(PACKAGE "::Search::Threads", 1));
+
+      results_list sorted;
+      sorted.reserve(order.size());
+      for(std::vector<std::size_t>::const_iterator it = order.begin();
+          it != order.end(); ++it)
+        sorted.push_back(output[*it]);
+
+      output.swap(sorted);
+    }
+
+    if(aptitude::cmdline::tab_separated_output_enabled())
+      {
+        // Every line names its package, so there's nothing to group.
+        for(results_list::const_iterator it = output.begin();
+            it != output.end(); ++it)
+          aptitude::cmdline::print_version_tab_separated(it->first);
+
+        delete group_by_policy;
+        return return_value;
+      }
 
     if(group_by_policy != NULL)
       {
+        if(group_by == group_by_source_package ||
+           group_by == group_by_source_version)
+          {
+            // Grouping by source reads the record of every version;
+            // fetch them in file order first.
+            std::vector<pkgCache::VerIterator> versions;
+            versions.reserve(output.size());
+            for(results_list::const_iterator it = output.begin();
+                it != output.end(); ++it)
+              versions.push_back(it->first);
+
+            aptitude::apt::prefetch_version_records(versions, false, false);
+          }
+
         typedef boost::unordered_map<std::string, boost::shared_ptr<results_list> >
           results_by_group_map;
 
@@ -447,8 +494,8 @@ namespace
             it != by_groups_list.end(); ++it)
           {
             if(it != by_groups_list.begin())
-              printf("\n");
-            printf("%s\n", group_by_policy->format_header(it->first).c_str());
+              term_output->write_text(L"\n");
+            term_output->write_text(cw::util::transcode(group_by_policy->format_header(it->first)) + L'\n');
             // No need to sort the versions in this list since we
             // sorted them above.
             show_version_match_list(*it->second,
@@ -456,7 +503,8 @@ namespace
                                     format_width,
                                     screen_width,
                                     disable_columns,
-                                    do_show_package_names);
+                                    do_show_package_names,
+                                    *term_output);
           }
       }
     else
@@ -465,7 +513,10 @@ namespace
                               format_width,
                               screen_width,
                               disable_columns,
-                              do_show_package_names);
+                              do_show_package_names,
+                              *term_output);
+
+    term_output->flush();
 
     return return_value;
   }
@@ -40,7 +40,6 @@
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 
-#include <generic/util/immset.h>
 #include <generic/util/util.h>
 
 // System includes:
@@ -109,6 +108,52 @@ namespace aptitude
 {
   namespace why
   {
+    // The actions taken by every node of a search, stored as a tree
+    // of parent links.  A successor only appends one link, instead of
+    // copying the whole history of its parent; the history is
+    // rebuilt when it's actually needed.
+    class action_chain
+    {
+      struct link
+      {
+	action act;
+	// The index of the previous link, or -1 at the root.
+	int parent;
+
+	link(const action &_act, int _parent)
+	  : act(_act), parent(_parent)
+	{
+	}
+      };
+
+      std::vector<link> links;
+
+    public:
+      /** \brief Add a link after the given link.
+       *
+       *  \return the index of the new link.
+       */
+      int add(int parent, const action &act)
+      {
+	links.push_back(link(act, parent));
+	return links.size() - 1;
+      }
+
+      /** \brief Retrieve the actions that lead to the given link.
+       *
+       *  \param last   the final link, or -1 for an empty history.
+       *  \param output a vector whose contents are replaced with the
+       *                actions, starting with the last one the search
+       *                took (the order of action::operator<).
+       */
+      void get_actions(int last, std::vector<action> &output) const
+      {
+	output.clear();
+	for(int i = last; i != -1; i = links[i].parent)
+	  output.push_back(links[i].act);
+      }
+    };
+
     // Represents a full forward or reverse justification for the
     // installation of the given package/version.  The justification
     // may terminate on either a package version, a provided package
@@ -116,17 +161,32 @@ namespace aptitude
     class justification
     {
       target the_target;
-      imm::set<action> actions;
+      action_chain *chain;
+      // The last action taken to reach this node, or -1 if this is
+      // the root.
+      int last_action;
+      int num_actions;
 
       justification(const target &_the_target,
-		    const imm::set<action> &_actions)
-	: the_target(_the_target), actions(_actions)
+		    action_chain *_chain,
+		    int _last_action,
+		    int _num_actions)
+	: the_target(_the_target),
+	  chain(_chain),
+	  last_action(_last_action),
+	  num_actions(_num_actions)
       {
       }
     public:
-      // Create a node with an empty history rooted at the given target.
-      justification(const target &_the_target)
-	: the_target(_the_target)
+      // Create a node with an empty history rooted at the given
+      // target; the histories of its successors are stored in the
+      // given chain.
+      justification(const target &_the_target,
+		    action_chain *_chain)
+	: the_target(_the_target),
+	  chain(_chain),
+	  last_action(-1),
+	  num_actions(0)
       {
       }
 
@@ -135,9 +195,15 @@ namespace aptitude
 	return the_target;
       }
 
-      const imm::set<action> &get_actions() const
+      // Returns true if no actions were taken to reach this node.
+      bool is_root() const
+      {
+	return last_action == -1;
+      }
+
+      void get_actions(std::vector<action> &output) const
       {
-	return actions;
+	chain->get_actions(last_action, output);
       }
 
       // Generate all the successors of this node (Q: could I lift
@@ -155,19 +221,17 @@ namespace aptitude
       justification successor(const target &new_target,
 			      const pkgCache::DepIterator &dep) const
       {
-	imm::set<action> new_actions(actions);
-	new_actions.insert(action(dep, new_actions.size()));
-
-	return justification(new_target, new_actions);
+	return justification(new_target, chain,
+			     chain->add(last_action, action(dep, num_actions)),
+			     num_actions + 1);
       }
 
       justification successor(const target &new_target,
 			      const pkgCache::PrvIterator &prv) const
       {
-	imm::set<action> new_actions(actions);
-	new_actions.insert(action(prv, new_actions.size()));
-
-	return justification(new_target, new_actions);
+	return justification(new_target, chain,
+			     chain->add(last_action, action(prv, num_actions)),
+			     num_actions + 1);
       }
 
       cwidget::fragment *description() const;
@@ -341,12 +405,12 @@ namespace aptitude
     }
 
     cw::fragment *justification_description(const target &t,
-                                            const imm::set<action> &actions)
+                                            const std::vector<action> &actions)
     {
       std::vector<cw::fragment *> rval;
       rval.push_back(cw::fragf("%F\n", t.description()));
       std::vector<cw::fragment *> col1_entries, col2_entries, col3_entries;
-      for(imm::set<action>::const_iterator it = actions.begin();
+      for(std::vector<action>::const_iterator it = actions.begin();
 	  it != actions.end(); ++it)
 	{
 	  col1_entries.push_back(cw::hardwrapbox(cw::fragf("%F | \n", it->description_column1_fragment())));
@@ -368,6 +432,8 @@ namespace aptitude
 
     cw::fragment *justification::description() const
     {
+      std::vector<action> actions;
+      get_actions(actions);
       return justification_description(the_target, actions);
     }
 
@@ -594,20 +660,75 @@ namespace aptitude
 
     namespace
     {
+  /** \brief Remembers which versions match the leaf patterns.
+   *
+   *  find_best_justification() runs up to eighteen searches with the
+   *  same leaves, and most packages near the goal are visited by
+   *  every one of them.  Matching a version against the patterns is
+   *  by far the most expensive part of visiting it, so the result is
+   *  computed once and shared by all the searches.
+   */
+  class leaf_matches
+  {
+    std::vector<cwidget::util::ref_ptr<pattern> > leaves;
+
+    cwidget::util::ref_ptr<search_cache> search_info;
+
+    // Indexed by version ID: 0 if the version hasn't been tested
+    // yet, 1 if it matches no leaf, and 2 if it matches one.
+    std::vector<unsigned char> results;
+
+  public:
+    leaf_matches(const std::vector<cwidget::util::ref_ptr<pattern> > &_leaves)
+      : leaves(_leaves),
+	search_info(aptitude::matching::search_cache::create()),
+	results((*apt_cache_file)->Head().VersionCount, 0)
+    {
+    }
+
+    /** \return \b true if the given version matches any leaf. */
+    bool matches(const pkgCache::PkgIterator &pkg,
+		 const pkgCache::VerIterator &ver)
+    {
+      unsigned char &result = results[ver->ID];
+
+      if(result == 0)
+	{
+	  result = 1;
+	  for(std::vector<cwidget::util::ref_ptr<pattern> >::const_iterator it = leaves.begin();
+	      it != leaves.end(); ++it)
+	    if(has_match(*it, pkg, ver,
+			 search_info,
+			 *apt_cache_file,
+			 *apt_package_records))
+	      {
+		result = 2;
+		break;
+	      }
+	}
+
+      return result == 2;
+    }
+  };
+
   class justification_search
   {
     // The central queue.  Nodes are inserted at the back and removed
     // from the front.
     std::deque<justification> q;
 
-    std::vector<cwidget::util::ref_ptr<pattern> > leaves;
-
-    cwidget::util::ref_ptr<search_cache> search_info;
+    shared_ptr<leaf_matches> leaves;
 
     search_params params;
 
-    // Array of flags indicating which packages have been visited.
-    bool *seen_packages;
+    // The histories of every node that has been queued.  Shared
+    // with any copies of this search, since nodes in the queue point
+    // into it.
+    shared_ptr<action_chain> chain;
+
+    // Flags indicating which packages have been visited, indexed by
+    // package ID.
+    std::vector<bool> seen_packages;
 
     // Used for debug output.
     bool first_iteration;
@@ -633,61 +754,19 @@ namespace aptitude
      *                or the inst ver, and whether to consider
      *                suggests/recommends to be important.
      */
-    justification_search(const std::vector<cwidget::util::ref_ptr<pattern> > &_leaves,
+    justification_search(const shared_ptr<leaf_matches> &_leaves,
 			 const target &root,
 			 const search_params &_params,
 			 int _verbosity)
       : leaves(_leaves),
-	search_info(aptitude::matching::search_cache::create()),
 	params(_params),
-	seen_packages(NULL),
+	chain(make_shared<action_chain>()),
+	seen_packages((*apt_cache_file)->Head().PackageCount, false),
 	first_iteration(true),
 	verbosity(_verbosity)
     {
       // Prime the pump.
-      q.push_back(justification(root));
-    }
-
-    justification_search(const justification_search &other)
-      : q(other.q),
-	leaves(other.leaves),
-	params(other.params),
-	first_iteration(other.first_iteration),
-	verbosity(other.verbosity)
-    {
-      if(other.seen_packages == NULL)
-	seen_packages = NULL;
-      else
-	{
-	  int count = (*apt_cache_file)->Head().PackageCount;
-	  seen_packages = new bool[count];
-	  for(int i = 0; i < count; ++i)
-	    seen_packages[i] = other.seen_packages[i];
-	}
-    }
-
-    justification_search &operator=(const justification_search &other)
-    {
-      q = other.q;
-      leaves = other.leaves;
-      params = other.params;
-      if(other.seen_packages == NULL)
-	seen_packages = NULL;
-      else
-	{
-	  int count = (*apt_cache_file)->Head().PackageCount;
-	  seen_packages = new bool[count];
-	  for(int i = 0; i < count; ++i)
-	    seen_packages[i] = other.seen_packages[i];
-	}
-      first_iteration = other.first_iteration;
-      verbosity = other.verbosity;
-      return *this;
-    }
-
-    ~justification_search()
-    {
-      delete[] seen_packages;
+      q.push_back(justification(root, chain.get()));
     }
 
     /** \brief Compute the next output of this search.
@@ -712,14 +791,6 @@ namespace aptitude
       std::vector<action> tmp;
       bool reached_leaf = false;
 
-      if(seen_packages == NULL)
-	{
-	  int count = (*apt_cache_file)->Head().PackageCount;
-	  seen_packages = new bool[count];
-	  for(int i = 0; i < count; ++i)
-	    seen_packages[i] = false;
-	}
-
       if(first_iteration)
 	{
           if(callbacks_bare != NULL)
@@ -738,20 +809,21 @@ namespace aptitude
 
 
           if(callbacks_bare != NULL)
-            callbacks_bare->start_target(front.get_target(),
-                                         front.get_actions());
+	    {
+	      front.get_actions(tmp);
+	      callbacks_bare->start_target(front.get_target(), tmp);
+	    }
 
 	  // If we visited this package already, skip it.  Otherwise,
 	  // flag it as visited.
 	  pkgCache::PkgIterator frontpkg = front.get_target().get_visited_package();
 	  int frontid = frontpkg->ID;
-	  bool &package_is_seen = seen_packages[frontid];
-	  if(package_is_seen)
+	  if(seen_packages[frontid])
 	    continue;
 	  // Don't flag the starting package as "seen", since we want
 	  // to be able to find self-loops.
-	  if(!front.get_actions().empty())
-	    package_is_seen = true;
+	  if(!front.is_root())
+	    seen_packages[frontid] = true;
 
 	  // If we've stepped at least once, test whether the front
 	  // node is a leaf; if it is, return it and quit.
@@ -762,23 +834,10 @@ namespace aptitude
 	  // even if the target of the search matches a leaf pattern,
 	  // we'll keep looking past it).
 	  pkgCache::VerIterator frontver = params.selected_version(frontpkg);
-	  if(!frontver.end() && !front.get_actions().empty())
-	    for(std::vector<ref_ptr<pattern> >::const_iterator it = leaves.begin();
-		!reached_leaf && it != leaves.end(); ++it)
-	      {
-		if(get_match((*it),
-			     frontpkg, frontver,
-			     search_info,
-			     *apt_cache_file,
-			     *apt_package_records).valid())
-		  reached_leaf = true;
-	      }
+	  if(!frontver.end() && !front.is_root())
+	    reached_leaf = leaves->matches(frontpkg, frontver);
 	  if(reached_leaf)
-	    {
-	      tmp.insert(tmp.begin(),
-			 front.get_actions().begin(),
-			 front.get_actions().end());
-	    }
+	    front.get_actions(tmp);
 	  else
 	    // Since this isn't a leaf, stick its successors on the
 	    // queue and carry on.
@@ -788,6 +847,9 @@ namespace aptitude
                                       callbacks);
 	}
 
+      if(!reached_leaf)
+	tmp.clear();
+
       output.swap(tmp);
       return reached_leaf;
     }
@@ -801,7 +863,8 @@ namespace aptitude
                             const boost::shared_ptr<why_callbacks> &callbacks,
 			    std::vector<std::vector<action> > &output)
     {
-      justification_search search(leaves, target, params, 0);
+      justification_search search(make_shared<leaf_matches>(leaves),
+				  target, params, 0);
 
       std::vector<std::vector<action> > rval;
       std::vector<action> tmp;
@@ -926,13 +989,16 @@ namespace aptitude
       std::set<std::vector<action> > seen_results;
       std::vector<action> results;
 
+      const shared_ptr<leaf_matches> matches =
+	make_shared<leaf_matches>(leaves);
+
       for(std::vector<search_params>::const_iterator it = searches.begin();
 	  it != searches.end(); ++it)
 	{
 	  if(!output.empty() && !find_all)
 	    return;
 
-	  justification_search search(leaves, goal, *it, verbosity);
+	  justification_search search(matches, goal, *it, verbosity);
 
 	  while(search.next(results, callbacks))
 	    {
@@ -1140,7 +1206,7 @@ namespace aptitude
         }
 
         void start_target(const target &target,
-                          const imm::set<action> &actions)
+                          const std::vector<action> &actions)
         {
           if(verbosity > 1)
             {
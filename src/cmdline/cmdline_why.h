@@ -27,8 +27,6 @@
 #include <generic/apt/aptcache.h>
 #include <generic/apt/matching/pattern.h>
 
-#include <generic/util/immset.h>
-
 
 // System includes:
 #include <apt-pkg/depcache.h>
@@ -483,7 +481,7 @@ namespace aptitude
        *  target.
        */
       virtual void start_target(const target &t,
-                                const imm::set<action> &actions) = 0;
+                                const std::vector<action> &actions) = 0;
     };
 
     /** \brief Create a why_callbacks object suitable for use in the
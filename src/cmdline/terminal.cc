@@ -35,7 +35,9 @@
 
 #include <iostream>
 
+#include <stdio.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 
 using boost::make_shared;
 using boost::shared_ptr;
@@ -58,7 +60,20 @@ namespace aptitude
       // memory barriers.
       class terminal_impl : public terminal_io
       {
+        // Text that has been written but not sent to standard output
+        // yet.  It is converted to the locale's encoding all at once
+        // when it is sent.
+        std::wstring pending;
+
+        // Cached result of isatty(1); it's consulted on each write.
+        bool is_a_terminal;
+
+        void write_pending();
+
       public:
+        terminal_impl();
+        ~terminal_impl();
+
         bool output_is_a_terminal();
         void write_text(const std::wstring &msg);
         void move_to_beginning_of_line();
@@ -68,29 +83,65 @@ namespace aptitude
         int wcwidth(wchar_t ch);
       };
 
+      // When the output isn't a terminal, send it on once this much
+      // text is waiting.
+      const std::wstring::size_type max_pending = 64 * 1024;
+
+      terminal_impl::terminal_impl()
+        : is_a_terminal(isatty(1))
+      {
+      }
+
+      terminal_impl::~terminal_impl()
+      {
+        flush();
+      }
+
+      void terminal_impl::write_pending()
+      {
+        if(pending.empty())
+          return;
+
+        const std::string encoded(transcode(pending));
+        fwrite(encoded.data(), 1, encoded.size(), stdout);
+        pending.clear();
+      }
+
       bool terminal_impl::output_is_a_terminal()
       {
-        return isatty(1);
+        return is_a_terminal;
       }
 
       void terminal_impl::write_text(const std::wstring &msg)
       {
-        std::cout << transcode(msg);
+        pending += msg;
+
+        // A terminal shows each line as soon as it is complete;
+        // anything else only needs to see the text eventually.
+        if(is_a_terminal)
+          {
+            if(msg.find(L'\n') != std::wstring::npos)
+              flush();
+          }
+        else if(pending.size() >= max_pending)
+          write_pending();
       }
 
       void terminal_impl::move_to_beginning_of_line()
       {
-        std::cout << '\r';
+        pending += L'\r';
       }
 
       void terminal_impl::flush()
       {
-        std::cout << std::flush;
+        write_pending();
+        fflush(stdout);
       }
 
       std::wstring terminal_impl::prompt_for_input(const std::wstring &msg)
       {
-        std::cout << transcode(msg) << std::flush;
+        pending += msg;
+        flush();
 
         std::string rval;
         char buf[1024];
@@ -67,7 +67,13 @@ namespace aptitude
        */
       virtual bool output_is_a_terminal() = 0;
 
-      /** \brief Write some text to the terminal. */
+      /** \brief Write some text to the terminal.
+       *
+       *  The text may be held back until the end of the line, or
+       *  (if the output isn't a terminal) until a large amount of it
+       *  has accumulated.  Call flush() before writing to standard
+       *  output by any other means.
+       */
       virtual void write_text(const std::wstring &msg) = 0;
 
       /** \brief Return the cursor to the beginning of the current
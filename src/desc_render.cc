@@ -32,6 +32,11 @@
 #include <cwidget/generic/util/transcode.h>
 #include <cwidget/config/colors.h>
 
+#include <sigc++/functors/ptr_fun.h>
+
+#include <list>
+#include <map>
+
 using namespace std;
 
 namespace cw = cwidget;
@@ -87,6 +92,85 @@ namespace aptitude
   {
     return make_desc_fragment(elements, 0);
   }
+
+  namespace
+  {
+    /** \brief How many descriptions to keep; this should be more
+     *  than fit on one screen.
+     *
+     *  Descriptions are only parsed when they are first displayed, so
+     *  the ones that were prefetched but never shown just hold their
+     *  text.
+     */
+    const std::size_t max_cached_descriptions = 256;
+
+    typedef std::list<std::pair<unsigned long, lazy_description> >
+    description_lru;
+
+    /** \brief The cached descriptions, most recently used first. */
+    description_lru cached_descriptions;
+    /** \brief The entry of each cached version, by version ID. */
+    std::map<unsigned long, description_lru::iterator> cached_description_index;
+
+    void clear_description_cache()
+    {
+      cached_descriptions.clear();
+      cached_description_index.clear();
+    }
+
+    /** \brief Look up a version's description, reading it if needed,
+     *  and make it the most recently used one.
+     */
+    lazy_description &find_description(const pkgCache::VerIterator &ver)
+    {
+      static bool connected = false;
+      if(!connected)
+	{
+	  // Version IDs and records don't survive a reload.
+	  cache_closed.connect(sigc::ptr_fun(&clear_description_cache));
+	  connected = true;
+	}
+
+      const unsigned long id = ver->ID;
+      std::map<unsigned long, description_lru::iterator>::iterator found =
+	cached_description_index.find(id);
+      if(found != cached_description_index.end())
+	{
+	  cached_descriptions.splice(cached_descriptions.begin(),
+				     cached_descriptions, found->second);
+	  return found->second->second;
+	}
+
+      cached_descriptions.push_front(std::make_pair(id, lazy_description()));
+      cached_descriptions.front().second =
+	lazy_description(get_long_description(ver, apt_package_records));
+      cached_description_index[id] = cached_descriptions.begin();
+
+      if(cached_descriptions.size() > max_cached_descriptions)
+	{
+	  cached_description_index.erase(cached_descriptions.back().first);
+	  cached_descriptions.pop_back();
+	}
+
+      return cached_descriptions.front().second;
+    }
+  }
+
+  void get_parsed_long_description(const pkgCache::VerIterator &ver,
+				   std::vector<description_element_ref> &elements)
+  {
+    if(ver.end() || apt_package_records == NULL)
+      elements.clear();
+    else
+      elements = find_description(ver).get_elements();
+  }
+
+  void prefetch_long_description(const pkgCache::VerIterator &ver)
+  {
+    if(!ver.end() && apt_package_records != NULL &&
+       cached_description_index.find(ver->ID) == cached_description_index.end())
+      find_description(ver);
+  }
 }
 
 cw::fragment *make_desc_fragment(const wstring &desc)
@@ -136,7 +220,7 @@ cw::fragment *make_tags_fragment(const pkgCache::PkgIterator &pkg)
     }
 
   typedef aptitudeDepCache::user_tag user_tag;
-  const set<user_tag> &user_tags((*apt_cache_file)->get_ext_state(pkg).user_tags);
+  const set<user_tag> &user_tags((*apt_cache_file)->get_ext_state(pkg).user_tags.get());
   if(!user_tags.empty())
     {
       vector<cw::fragment *> tags;
@@ -44,6 +44,26 @@ namespace aptitude
    *  \param elements   the list of description elements to be rendered.
    */
   cwidget::fragment *make_desc_fragment(const std::vector<description_element_ref> &elements);
+
+  /** \brief Retrieve the parsed long description of a version.
+   *
+   *  The descriptions of the most recently used versions are kept
+   *  until the cache is closed, so showing the same version again
+   *  doesn't read its record or parse its description.
+   *
+   *  \param ver            the version whose description should be
+   *                        retrieved.
+   *  \param[out] elements  the parsed description.
+   */
+  void get_parsed_long_description(const pkgCache::VerIterator &ver,
+				   std::vector<description_element_ref> &elements);
+
+  /** \brief Read the long description of a version into the cache
+   *  used by get_parsed_long_description(), if it isn't there already.
+   *
+   *  The description is parsed when it is first retrieved.
+   */
+  void prefetch_long_description(const pkgCache::VerIterator &ver);
 }
 
 /** Parses the given description string according to the standard
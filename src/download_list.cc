@@ -68,6 +68,11 @@ download_list::workerinf::workerinf(const string &_msg, unsigned long _current,
 {
 }
 
+download_list::msg::msg(const wstring &_text, msg_type _type)
+  :text(_text), type(_type)
+{
+}
+
 // Unfortunately the cancel_slot is necessary so we know we've cancelled..
 static cw::widget_ref download_summary(const download_list_ref &l,
 				       bool failed,
@@ -132,7 +137,7 @@ static cw::widget_ref download_summary(const download_list_ref &l,
 				 
 
 download_list::download_list(bool _display_messages, bool _display_cumulative_progress)
-  :start(0), sticky_end(true), was_cancelled(false), failed(false),
+  :msgs_width(0), start(0), sticky_end(true), was_cancelled(false), failed(false),
    display_messages(_display_messages),
 
    display_cumulative_progress(_display_cumulative_progress), startx(0),
@@ -168,12 +173,18 @@ void download_list::paint(const cw::style &st)
   const cw::style progress_style = st + cw::get_style("DownloadProgress");
   getmaxyx(height, width);
 
+  // Look the styles up once rather than once per line.
+  cw::style msg_styles[num_msg_types];
+  msg_styles[msg_hit] = st + cw::get_style("DownloadHit");
+  msg_styles[msg_done] = progress_style;
+  msg_styles[msg_error] = st + cw::get_style("Error");
+
   // Display the completed items
   while(y<height-1 && where<msgs.size())
     {
-      const cw::style msg_style = st + msgs[where].second;
-      const wstring disp(msgs[where].first,
-			 min<wstring::size_type>(startx, msgs[where].first.size()));
+      const cw::style &msg_style = msg_styles[msgs[where].type];
+      const wstring disp(msgs[where].text,
+			 min<wstring::size_type>(startx, msgs[where].text.size()));
 
       show_string_as_progbar(0, y, disp,
 			     msg_style, msg_style,
@@ -282,10 +293,8 @@ void download_list::update_workers(pkgAcquire *Owner)
 {
   cw::widget_ref tmpref(this);
 
-  int width,height;
-  getmaxyx(height, width);
-
-  workers.erase(workers.begin(), workers.end());
+  const workerlist::size_type old_num_workers = workers.size();
+  workers.clear();
 
   // FIXME: do "something" if there are no active workers
   pkgAcquire::Worker *serf=Owner->WorkersBegin();
@@ -294,11 +303,7 @@ void download_list::update_workers(pkgAcquire *Owner)
       if(!serf->CurrentItem)
 	{
 	  if(!serf->Status.empty())
-	    {
-	      workers.push_back(workerinf(serf->Status, 0, 1));
-	      if(get_visible())
-		cw::toplevel::queuelayout();
-	    }
+	    workers.push_back(workerinf(serf->Status, 0, 1));
 	}
       else
 	{
@@ -321,16 +326,25 @@ void download_list::update_workers(pkgAcquire *Owner)
 	  workers.push_back(workerinf(output,
 				      serf->CurrentSize,
 				      serf->TotalSize));
-	  if(get_visible())
-	    cw::toplevel::queuelayout();
 	}
 
       serf=Owner->WorkerStep(serf);
     }
 
+  // The size of the list only changes when workers come and go;
+  // otherwise redrawing it is enough.
+  if(workers.size() != old_num_workers && get_visible())
+    cw::toplevel::queuelayout();
+
   sync_top();
 }
 
+void download_list::add_msg(const string &text, msg_type type)
+{
+  msgs.push_back(msg(cw::util::transcode(text), type));
+  msgs_width = max(msgs_width, msgs.back().text.size());
+}
+
 void download_list::MediaChange(string media, string drive,
 				download_signal_log &manager,
 				const sigc::slot1<void, bool> &k)
@@ -358,8 +372,7 @@ void download_list::IMSHit(pkgAcquire::ItemDesc &itmdesc,
 
   if(display_messages)
     {
-      msgs.push_back(msg(cw::util::transcode(itmdesc.Description + " " + _("[Hit]")),
-			 cw::get_style("DownloadHit")));
+      add_msg(itmdesc.Description + " " + _("[Hit]"), msg_hit);
 
       sync_top();
 
@@ -380,8 +393,7 @@ void download_list::Done(pkgAcquire::ItemDesc &itmdesc,
 
   if(display_messages)
     {
-      msgs.push_back(msg(cw::util::transcode(itmdesc.Description + " " + _("[Downloaded]")),
-			 cw::get_style("DownloadProgress")));
+      add_msg(itmdesc.Description + " " + _("[Downloaded]"), msg_done);
 
       sync_top();
 
@@ -402,16 +414,13 @@ void download_list::Fail(pkgAcquire::ItemDesc &itmdesc,
 
       // ???
       if(itmdesc.Owner->Status==pkgAcquire::Item::StatDone)
-	msgs.push_back(msg(cw::util::transcode(itmdesc.Description + " " + _("[IGNORED]")),
-			   cw::get_style("DownloadHit")));
+	add_msg(itmdesc.Description + " " + _("[IGNORED]"), msg_hit);
       else
 	{
 	  failed=true;
 
-	  msgs.push_back(msg(cw::util::transcode(itmdesc.Description + " " + _("[ERROR]")),
-			     cw::get_style("Error")));
-	  msgs.push_back(msg(cw::util::transcode(" " + itmdesc.Owner->ErrorText),
-			     cw::get_style("Error")));
+	  add_msg(itmdesc.Description + " " + _("[ERROR]"), msg_error);
+	  add_msg(" " + itmdesc.Owner->ErrorText, msg_error);
 	}
 
       sync_top();
@@ -428,6 +437,7 @@ void download_list::Start(download_signal_log &manager)
   // Delete stuff from previous runs (eg, for multiple CDs)
   workers.erase(workers.begin(), workers.end());
   msgs.erase(msgs.begin(), msgs.end());
+  msgs_width = 0;
 }
 
 void download_list::Stop(download_signal_log &manager, const sigc::slot0<void> &k)
@@ -480,8 +490,9 @@ void download_list::Pulse(pkgAcquire *Owner, download_signal_log &manager,
 
   update_workers(Owner);
 
+  // update_workers() asked for a new layout if the list changed size.
   if(get_visible())
-    cw::toplevel::queuelayout(); // Force an update
+    cw::toplevel::update();
 
   if(was_cancelled)
     k(false);
@@ -609,8 +620,7 @@ void download_list::shift_right()
   wstring::size_type maxx=0;
 
   if(display_messages)
-    for(vector<wstring>::size_type n=0; n<msgs.size(); ++n)
-      maxx=max<int>(maxx, msgs[n].first.size());
+    maxx=msgs_width;
 
   for(vector<wstring>::size_type n=0; n<workers.size(); ++n)
     maxx=max<int>(maxx, workers[n].msg.size());
@@ -54,9 +54,22 @@ class download_list:public cwidget::widgets::widget
     workerinf(const std::string &_msg, unsigned long _current, unsigned long _total);
   };
 
-  typedef std::pair<std::wstring, cwidget::style> msg;
+  /** \brief The kinds of messages that are displayed; each kind is
+   *  drawn in its own style.
+   */
+  enum msg_type {msg_hit, msg_done, msg_error, num_msg_types};
+
+  // A line of the list of completed items.  Only the kind of the
+  // message is stored, rather than its style, since there can be
+  // thousands of them.
+  struct msg
+  {
+    std::wstring text;
+    msg_type type;
+
+    msg(const std::wstring &_text, msg_type _type);
+  };
 
-  // Contains strings paired with attributes.
   typedef std::vector<msg> msglist;
 
   // Contains strings paired with the current and total sizes associated
@@ -66,6 +79,11 @@ class download_list:public cwidget::widgets::widget
   msglist msgs;
   workerlist workers;
 
+  // The length of the longest message in msgs, kept up to date as
+  // messages are added so that scrolling right doesn't have to scan
+  // the whole list.
+  std::wstring::size_type msgs_width;
+
   // Where in the list we are (can be >msgs.size() -- that would mean we're
   // viewing the currently progressing downloads)
   unsigned int start;
@@ -112,6 +130,9 @@ class download_list:public cwidget::widgets::widget
   // Updates the set of displayed progress bars.
   void update_workers(pkgAcquire *Owner);
 
+  // Appends a line to the list of completed items.
+  void add_msg(const std::string &text, msg_type type);
+
   // Syncs the current location in the list which is displayed
   void sync_top();
 
@@ -356,6 +356,8 @@ bool hier_editor::handle_key(const cw::config::key &k)
 	  for(vector<hier_item *>::iterator i=items.begin();
 	      i!=items.end(); ++i)
 	    (*i)->commit();
+
+	  get_user_pkg_hier()->invalidate_index();
 	}
 
       hide();
@@ -369,6 +371,8 @@ bool hier_editor::handle_key(const cw::config::key &k)
 	  for(vector<hier_item *>::iterator i=items.begin();
 	      i!=items.end(); ++i)
 	    (*i)->commit();
+
+	  get_user_pkg_hier()->invalidate_index();
 	}
 
       commit_changes();
@@ -26,6 +26,7 @@
 
 #include "aptitude_resolver_universe.h"
 #include "config_signal.h"
+#include "config_snapshot.h"
 #include "download_queue.h"
 #include "pkg_hier.h"
 #include "resolver_manager.h"
@@ -34,9 +35,11 @@
 #include "tasks.h"
 
 #include <cwidget/generic/util/eassert.h>
+#include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/generic/util/transcode.h>
 
 #include <generic/util/file_cache.h>
+#include <generic/util/timings.h>
 #include <generic/util/util.h>
 
 #include <generic/util/undo.h>
@@ -49,6 +52,8 @@
 #include <apt-pkg/sourcelist.h>
 #include <apt-pkg/version.h>
 
+#include <boost/unordered_map.hpp>
+
 #include <fstream>
 
 #include <signal.h>
@@ -68,6 +73,39 @@ static interesting_state *cached_deps_interesting = NULL;
 // pointer in the following table is set to 1 when a result is cached:
 static pkgCache::Dependency **cached_surrounding_or = NULL;
 
+// The Conflicts and Breaks that target each package, used by
+// is_conflicted() to avoid scanning every reverse dependency.  The
+// dependencies targeting the package with ID n are
+// rev_conflicts[rev_conflicts_start[n]] up to (but not including)
+// rev_conflicts[rev_conflicts_start[n + 1]].
+static unsigned long *rev_conflicts_start = NULL;
+static pkgCache::Dependency **rev_conflicts = NULL;
+
+// Memoization of package_suggested() and package_recommended(),
+// indexed by package ID.  Entries are dropped when the state of a
+// package they depend on changes.
+enum memoized_flag {flag_uncached = 0, flag_false, flag_true};
+static memoized_flag *cached_package_suggested = NULL;
+static memoized_flag *cached_package_recommended = NULL;
+
+// Set when a package state change begins and cleared when the set of
+// packages it touched has been used to invalidate the tables above.
+// A change that's never followed by that set throws away the whole
+// tables the next time they're consulted.
+static bool recommendation_memoization_stale = false;
+
+// Memoization of package_trusted(), indexed by version ID.  Whether a
+// version is trusted only depends on the sources it comes from, so
+// this is kept until the cache is closed.
+static memoized_flag *cached_package_trusted = NULL;
+
+// Wide copies of the package names and version strings, indexed by
+// ID, and of other strings of the cache, indexed by their address.
+// An empty string hasn't been converted yet.
+static std::vector<std::wstring> *wide_full_names = NULL;
+static std::vector<std::wstring> *wide_version_strings = NULL;
+static boost::unordered_map<const char *, std::wstring> *wide_cache_strings = NULL;
+
 pkg_hier *user_pkg_hier=NULL;
 
 string *pendingerr=NULL;
@@ -97,6 +135,46 @@ static void reset_surrounding_or_memoization()
   cached_surrounding_or = NULL;
 }
 
+static void reset_rev_conflicts_index()
+{
+  delete[] rev_conflicts_start;
+  rev_conflicts_start = NULL;
+  delete[] rev_conflicts;
+  rev_conflicts = NULL;
+}
+
+static void reset_recommendation_memoization()
+{
+  delete[] cached_package_suggested;
+  cached_package_suggested = NULL;
+  delete[] cached_package_recommended;
+  cached_package_recommended = NULL;
+  recommendation_memoization_stale = false;
+}
+
+static void reset_trust_memoization()
+{
+  delete[] cached_package_trusted;
+  cached_package_trusted = NULL;
+}
+
+static void reset_wide_strings()
+{
+  delete wide_full_names;
+  wide_full_names = NULL;
+
+  delete wide_version_strings;
+  wide_version_strings = NULL;
+
+  delete wide_cache_strings;
+  wide_cache_strings = NULL;
+}
+
+// Connected to the signals of each newly loaded cache; defined next to
+// package_suggested().
+static void note_recommendation_memoization_stale();
+static void invalidate_recommendation_memoization(const std::set<pkgCache::PkgIterator> *changed);
+
 static void reload_user_pkg_hier()
 {
   delete user_pkg_hier;
@@ -120,8 +198,14 @@ bool get_apt_knows_about_rootdir()
   return apt_knows_about_rootdir;
 }
 
+bool apt_low_memory_mode()
+{
+  return aptcfg->FindB(PACKAGE "::Low-Memory", false);
+}
+
 void apt_preinit(const char *rootdir)
 {
+  aptitude::util::phase_timer timer("apt-preinit");
   logging::LoggerPtr logger(Loggers::getAptitudeAptGlobals());
 
   // The old name for the recommends-should-be-automatically-installed
@@ -209,6 +293,8 @@ void apt_preinit(const char *rootdir)
     }
 
   aptcfg=new signalling_config(user_config, _config, theme_config);
+  aptcfg->changed.connect(sigc::ptr_fun(&aptitude::apt::invalidate_config_snapshot));
+  aptitude::apt::invalidate_config_snapshot();
 
   // If the user has a Recommends-Important setting and has allowed us
   // to read it by seting Ignore-Recommends-Important to false,
@@ -235,6 +321,14 @@ void apt_preinit(const char *rootdir)
 
   cache_closed.connect(sigc::ptr_fun(&reset_surrounding_or_memoization));
 
+  cache_closed.connect(sigc::ptr_fun(&reset_rev_conflicts_index));
+
+  cache_closed.connect(sigc::ptr_fun(&reset_recommendation_memoization));
+
+  cache_closed.connect(sigc::ptr_fun(&reset_trust_memoization));
+
+  cache_closed.connect(sigc::ptr_fun(&reset_wide_strings));
+
   apt_dumpcfg(PACKAGE);
 
   apt_undos=new undo_list;
@@ -410,6 +504,8 @@ void apt_load_cache(OpProgress *progress_bar, bool do_initselections,
 
   LOG_INFO(logger, "Loading apt cache.");
 
+  aptitude::util::phase_timer timer("load-cache");
+
   aptitudeCacheFile *new_file=new aptitudeCacheFile;
 
   LOG_TRACE(logger, "Reading the sources list.");
@@ -427,10 +523,14 @@ void apt_load_cache(OpProgress *progress_bar, bool do_initselections,
 
   LOG_TRACE(logger, "Opening the apt cache.");
 
-  bool open_failed=!new_file->Open(*progress_bar, do_initselections,
-				   (getuid() == 0) && !simulate,
-				   status_fname)
-    || _error->PendingError();
+  bool open_failed;
+  {
+    aptitude::util::phase_timer open_timer("open-cache");
+    open_failed=!new_file->Open(*progress_bar, do_initselections,
+				(getuid() == 0) && !simulate,
+				status_fname)
+      || _error->PendingError();
+  }
 
   if(open_failed && getuid() == 0)
     {
@@ -464,6 +564,9 @@ void apt_load_cache(OpProgress *progress_bar, bool do_initselections,
 
   apt_cache_file=new_file;
 
+  (*apt_cache_file)->pre_package_state_changed.connect(sigc::ptr_fun(&note_recommendation_memoization_stale));
+  (*apt_cache_file)->package_states_changed.connect(sigc::ptr_fun(&invalidate_recommendation_memoization));
+
   // *If we were loading the global list of states*, dump immediate
   // changes back to it.  This reduces the chance that the user will
   // ^C and lose important changes (like the new dselect states of
@@ -480,14 +583,30 @@ void apt_load_cache(OpProgress *progress_bar, bool do_initselections,
   // Um, good time to clear our undo info.
   apt_undos->clear_items();
 
+  // The limits are read here rather than in apt_preinit(), so that
+  // they can be set from the command line.
+  const int undo_memory_limit = aptcfg->FindI(PACKAGE "::Undo-Memory-Limit", 8192);
+  apt_undos->set_memory_limit(undo_memory_limit > 0
+			      ? static_cast<std::size_t>(undo_memory_limit) * 1024
+			      : 0);
+  const int undo_max_items = aptcfg->FindI(PACKAGE "::Undo-Max-Items",
+					   apt_low_memory_mode() ? 1 : 0);
+  apt_undos->set_max_items(undo_max_items > 0 ? undo_max_items : 0);
+
   LOG_TRACE(logger, "Loading task information.");
-  load_tasks(*progress_bar);
+  {
+    aptitude::util::phase_timer tasks_timer("load-tasks");
+    load_tasks(*progress_bar);
+  }
   LOG_TRACE(logger, "Loading tags.");
+  {
+    aptitude::util::phase_timer tags_timer("load-tags");
 #ifndef HAVE_EPT
-  load_tags(*progress_bar);
+    load_tags();
 #else
-  aptitude::apt::load_tags();
+    aptitude::apt::load_tags();
 #endif
+  }
 
   if(user_pkg_hier)
     {
@@ -511,11 +630,17 @@ void apt_load_cache(OpProgress *progress_bar, bool do_initselections,
 	aptcfg->FindI(PACKAGE "::UI::DownloadCache::MemorySize", 512 * 1024);
       const int download_cache_disk_size   =
 	aptcfg->FindI(PACKAGE "::UI::DownloadCache::DiskSize", 10 * 1024 * 1024);
+      const int download_cache_compression_level =
+	aptcfg->FindI(PACKAGE "::UI::DownloadCache::CompressionLevel", 1);
+      const std::string download_cache_shared_directory =
+	aptcfg->Find(PACKAGE "::UI::DownloadCache::SharedDirectory", "");
       try
 	{
 	  download_cache = aptitude::util::file_cache::create(download_cache_file_name,
 							      download_cache_memory_size,
-							      download_cache_disk_size);
+							      download_cache_disk_size,
+							      download_cache_compression_level,
+							      download_cache_shared_directory);
 	}
       catch(cwidget::util::Exception &ex)
 	{
@@ -594,11 +719,17 @@ pkg_action_state find_pkg_state(pkgCache::PkgIterator pkg,
                                 bool ignore_broken)
 {
   aptitudeDepCache::StateCache &state = cache[pkg];
-  aptitudeDepCache::aptitude_state &extstate = cache.get_ext_state(pkg);
 
   if(state.InstBroken() && !ignore_broken)
     return pkg_broken;
-  else if(state.Delete())
+
+  int cached;
+  if(cache.get_cached_action_state(pkg, cached))
+    return static_cast<pkg_action_state>(cached);
+
+  aptitudeDepCache::aptitude_state &extstate = cache.get_ext_state(pkg);
+
+  if(state.Delete())
     {
       if(extstate.remove_reason==aptitudeDepCache::manual)
 	return pkg_remove;
@@ -750,103 +881,232 @@ void surrounding_or(pkgCache::DepIterator dep,
     }
 }
 
-bool package_suggested(const pkgCache::PkgIterator &pkg)
+static bool internal_package_suggested(const pkgCache::PkgIterator &pkg)
 {
   pkgDepCache::StateCache &state=(*apt_cache_file)[pkg];
   pkgCache::VerIterator candver=state.CandidateVerIter(*apt_cache_file);
 
-  for(rev_dep_iterator d(pkg); !d.end(); ++d)
-    if((*d)->Type==pkgCache::Dep::Suggests)
-      {
-	bool satisfied=false;
+  for(rev_dep_iterator d(pkg, rev_dep_type_mask(pkgCache::Dep::Suggests));
+      !d.end(); ++d)
+    {
+      bool satisfied=false;
 
-	pkgCache::DepIterator start,end;
+      pkgCache::DepIterator start,end;
 
-	surrounding_or(*d, start, end);
+      surrounding_or(*d, start, end);
 
-	while(start!=end)
-	  {
-	    if(((*apt_cache_file)[start])&pkgDepCache::DepGInstall)
-	      {
-		satisfied=true;
-		break;
-	      }
+      while(start!=end)
+	{
+	  if(((*apt_cache_file)[start])&pkgDepCache::DepGInstall)
+	    {
+	      satisfied=true;
+	      break;
+	    }
 
-	    ++start;
-	  }
+	  ++start;
+	}
 
-	if(!satisfied)
-	  {
-	    // Check whether the package doing the depending is going
-	    // to be installed.
-	    pkgCache::PkgIterator depender=(*d).ParentPkg();
-	    pkgDepCache::StateCache &depstate=(*apt_cache_file)[depender];
-	    pkgCache::VerIterator depinstver=depstate.InstVerIter(*apt_cache_file);
-
-	    if(depender.CurrentVer().end() &&
-	       depstate.Install() &&
-	       !depinstver.end() &&
-	       !candver.end() &&
-	       _system->VS->CheckDep(candver.VerStr(),
-				     (*d)->CompareOp, (*d).TargetVer()))
-	      {
-		if((*d).ParentVer()==depinstver)
-		  return true;
-	      }
-	  }
-      }
+      if(!satisfied)
+	{
+	  // Check whether the package doing the depending is going
+	  // to be installed.
+	  pkgCache::PkgIterator depender=(*d).ParentPkg();
+	  pkgDepCache::StateCache &depstate=(*apt_cache_file)[depender];
+	  pkgCache::VerIterator depinstver=depstate.InstVerIter(*apt_cache_file);
+
+	  if(depender.CurrentVer().end() &&
+	     depstate.Install() &&
+	     !depinstver.end() &&
+	     !candver.end() &&
+	     _system->VS->CheckDep(candver.VerStr(),
+				   (*d)->CompareOp, (*d).TargetVer()))
+	    {
+	      if((*d).ParentVer()==depinstver)
+		return true;
+	    }
+	}
+    }
 
   return false;
 }
 
-bool package_recommended(const pkgCache::PkgIterator &pkg)
+static bool internal_package_recommended(const pkgCache::PkgIterator &pkg)
 {
   pkgDepCache::StateCache &state=(*apt_cache_file)[pkg];
   pkgCache::VerIterator candver=state.CandidateVerIter(*apt_cache_file);
 
-  for(rev_dep_iterator d(pkg); !d.end(); ++d)
-    if((*d)->Type==pkgCache::Dep::Recommends)
-      {
-	bool satisfied=false;
+  for(rev_dep_iterator d(pkg, rev_dep_type_mask(pkgCache::Dep::Recommends));
+      !d.end(); ++d)
+    {
+      bool satisfied=false;
 
-	pkgCache::DepIterator start,end;
+      pkgCache::DepIterator start,end;
 
-	surrounding_or(*d, start, end);
+      surrounding_or(*d, start, end);
 
-	while(start!=end)
-	  {
-	    if(((*apt_cache_file)[start])&pkgDepCache::DepGInstall)
-	      {
-		satisfied=true;
-		break;
-	      }
+      while(start!=end)
+	{
+	  if(((*apt_cache_file)[start])&pkgDepCache::DepGInstall)
+	    {
+	      satisfied=true;
+	      break;
+	    }
 
-	    ++start;
-	  }
+	  ++start;
+	}
 
-	if(!satisfied)
-	  {
-	    // Check whether the package doing the depending is going
-	    // to be installed or upgraded.
-	    pkgCache::PkgIterator depender=(*d).ParentPkg();
-	    pkgDepCache::StateCache &depstate=(*apt_cache_file)[depender];
-	    pkgCache::VerIterator depinstver=depstate.InstVerIter(*apt_cache_file);
-
-	    if(depstate.Install() &&
-	       !candver.end() &&
-	       _system->VS->CheckDep(candver.VerStr(),
-				     (*d)->CompareOp, (*d).TargetVer()))
-	      {
-		if((*d).ParentVer()==depinstver)
-		  return true;
-	      }
-	  }
-      }
+      if(!satisfied)
+	{
+	  // Check whether the package doing the depending is going
+	  // to be installed or upgraded.
+	  pkgCache::PkgIterator depender=(*d).ParentPkg();
+	  pkgDepCache::StateCache &depstate=(*apt_cache_file)[depender];
+	  pkgCache::VerIterator depinstver=depstate.InstVerIter(*apt_cache_file);
+
+	  if(depstate.Install() &&
+	     !candver.end() &&
+	     _system->VS->CheckDep(candver.VerStr(),
+				   (*d)->CompareOp, (*d).TargetVer()))
+	    {
+	      if((*d).ParentVer()==depinstver)
+		return true;
+	    }
+	}
+    }
 
   return false;
 }
 
-bool package_trusted(const pkgCache::VerIterator &ver)
+/** \return the memoized entry for pkg in the given table, creating
+ *  the table if it doesn't exist yet.
+ */
+static memoized_flag &recommendation_memo_entry(memoized_flag *&table,
+						const pkgCache::PkgIterator &pkg)
+{
+  if(recommendation_memoization_stale)
+    reset_recommendation_memoization();
+
+  if(table == NULL)
+    {
+      const unsigned long count = (*apt_cache_file)->Head().PackageCount;
+      table = new memoized_flag[count];
+      for(unsigned long i = 0; i < count; ++i)
+	table[i] = flag_uncached;
+    }
+
+  return table[pkg->ID];
+}
+
+bool package_suggested(const pkgCache::PkgIterator &pkg)
+{
+  memoized_flag &cached = recommendation_memo_entry(cached_package_suggested, pkg);
+  if(cached == flag_uncached)
+    cached = internal_package_suggested(pkg) ? flag_true : flag_false;
+
+  return cached == flag_true;
+}
+
+bool package_recommended(const pkgCache::PkgIterator &pkg)
+{
+  memoized_flag &cached = recommendation_memo_entry(cached_package_recommended, pkg);
+  if(cached == flag_uncached)
+    cached = internal_package_recommended(pkg) ? flag_true : flag_false;
+
+  return cached == flag_true;
+}
+
+/** Forget the memoized recommendation state of a package. */
+static void forget_recommendation_state(const pkgCache::PkgIterator &pkg)
+{
+  if(cached_package_suggested != NULL)
+    cached_package_suggested[pkg->ID] = flag_uncached;
+  if(cached_package_recommended != NULL)
+    cached_package_recommended[pkg->ID] = flag_uncached;
+}
+
+/** Forget the memoized recommendation state of every package that a
+ *  member of dep's OR group might refer to, either directly or
+ *  through a Provides.
+ */
+static void forget_or_group_targets(const pkgCache::DepIterator &dep)
+{
+  pkgCache::DepIterator start, end;
+  surrounding_or(dep, start, end);
+
+  while(start != end)
+    {
+      pkgCache::PkgIterator target = start.TargetPkg();
+      forget_recommendation_state(target);
+
+      for(pkgCache::PrvIterator prv = target.ProvidesList();
+	  !prv.end(); ++prv)
+	forget_recommendation_state(prv.OwnerPkg());
+
+      ++start;
+    }
+}
+
+static bool is_recommendation(const pkgCache::DepIterator &dep)
+{
+  return
+    dep->Type == pkgCache::Dep::Recommends ||
+    dep->Type == pkgCache::Dep::Suggests;
+}
+
+static void note_recommendation_memoization_stale()
+{
+  if(cached_package_suggested != NULL || cached_package_recommended != NULL)
+    recommendation_memoization_stale = true;
+}
+
+/** Drop the memoized results that the given state changes might
+ *  affect.
+ *
+ *  Whether a package is suggested or recommended depends on its own
+ *  candidate version, on the state of the packages that suggest or
+ *  recommend it, and on whether the OR groups of those dependencies
+ *  are satisfied.  So a change to a package invalidates the package
+ *  itself, the targets of its own Recommends and Suggests, and the
+ *  targets of every Recommends or Suggests OR group that it appears
+ *  in.
+ */
+static void invalidate_recommendation_memoization(const std::set<pkgCache::PkgIterator> *changed)
+{
+  if(cached_package_suggested == NULL && cached_package_recommended == NULL)
+    {
+      recommendation_memoization_stale = false;
+      return;
+    }
+
+  // Past a certain point it's cheaper to start from scratch.
+  if(changed == NULL ||
+     changed->size() * 16 > (*apt_cache_file)->Head().PackageCount)
+    {
+      reset_recommendation_memoization();
+      return;
+    }
+
+  for(std::set<pkgCache::PkgIterator>::const_iterator it = changed->begin();
+      it != changed->end(); ++it)
+    {
+      const pkgCache::PkgIterator &pkg = *it;
+
+      forget_recommendation_state(pkg);
+
+      for(pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver)
+	for(pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep)
+	  if(is_recommendation(dep))
+	    forget_or_group_targets(dep);
+
+      for(rev_dep_iterator d(pkg); !d.end(); ++d)
+	if(is_recommendation(*d))
+	  forget_or_group_targets(*d);
+    }
+
+  recommendation_memoization_stale = false;
+}
+
+static bool internal_package_trusted(const pkgCache::VerIterator &ver)
 {
   for(pkgCache::VerFileIterator i = ver.FileList(); !i.end(); ++i)
     {
@@ -863,6 +1123,59 @@ bool package_trusted(const pkgCache::VerIterator &ver)
   return false;
 }
 
+bool package_trusted(const pkgCache::VerIterator &ver)
+{
+  if(cached_package_trusted == NULL)
+    {
+      const unsigned long count = (*apt_cache_file)->Head().VersionCount;
+      cached_package_trusted = new memoized_flag[count];
+      for(unsigned long i = 0; i < count; ++i)
+	cached_package_trusted[i] = flag_uncached;
+    }
+
+  memoized_flag &cached = cached_package_trusted[ver->ID];
+  if(cached == flag_uncached)
+    cached = internal_package_trusted(ver) ? flag_true : flag_false;
+
+  return cached == flag_true;
+}
+
+const std::wstring &get_wide_full_name(const pkgCache::PkgIterator &pkg)
+{
+  if(wide_full_names == NULL)
+    wide_full_names = new std::vector<std::wstring>((*apt_cache_file)->Head().PackageCount);
+
+  std::wstring &rval = (*wide_full_names)[pkg->ID];
+  if(rval.empty())
+    rval = cw::util::transcode(pkg.FullName(true));
+
+  return rval;
+}
+
+const std::wstring &get_wide_version_string(const pkgCache::VerIterator &ver)
+{
+  if(wide_version_strings == NULL)
+    wide_version_strings = new std::vector<std::wstring>((*apt_cache_file)->Head().VersionCount);
+
+  std::wstring &rval = (*wide_version_strings)[ver->ID];
+  if(rval.empty())
+    rval = cw::util::transcode(ver.VerStr());
+
+  return rval;
+}
+
+const std::wstring &get_wide_cache_string(const char *s)
+{
+  if(wide_cache_strings == NULL)
+    wide_cache_strings = new boost::unordered_map<const char *, std::wstring>;
+
+  std::wstring &rval = (*wide_cache_strings)[s];
+  if(rval.empty())
+    rval = cw::util::transcode(s);
+
+  return rval;
+}
+
 pkgCache::VerIterator install_version(const pkgCache::PkgIterator &pkg,
 				      aptitudeDepCache &cache)
 {
@@ -885,6 +1198,78 @@ pkgCache::VerIterator install_version(const pkgCache::PkgIterator &pkg,
     }
 }
 
+static bool is_conflict_or_break(const pkgCache::DepIterator &dep)
+{
+  return
+    dep->Type == pkgCache::Dep::Conflicts ||
+    dep->Type == pkgCache::Dep::DpkgBreaks;
+}
+
+/** Build the index of reverse conflicts, if it doesn't exist yet. */
+static void build_rev_conflicts_index(aptitudeDepCache &cache)
+{
+  if(rev_conflicts_start != NULL)
+    return;
+
+  const unsigned long package_count = cache.Head().PackageCount;
+
+  // Count the conflicts on each package, turn the counts into the
+  // start of each package's range, and then fill the ranges in.
+  unsigned long *start = new unsigned long[package_count + 1];
+  for(unsigned long i = 0; i <= package_count; ++i)
+    start[i] = 0;
+
+  for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+    for(pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver)
+      for(pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep)
+	if(is_conflict_or_break(dep))
+	  ++start[dep.TargetPkg()->ID + 1];
+
+  for(unsigned long i = 0; i < package_count; ++i)
+    start[i + 1] += start[i];
+
+  pkgCache::Dependency **deps = new pkgCache::Dependency *[start[package_count]];
+  unsigned long *next = new unsigned long[package_count];
+  for(unsigned long i = 0; i < package_count; ++i)
+    next[i] = start[i];
+
+  for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+    for(pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver)
+      for(pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep)
+	if(is_conflict_or_break(dep))
+	  deps[next[dep.TargetPkg()->ID]++] = &*dep;
+
+  delete[] next;
+
+  rev_conflicts_start = start;
+  rev_conflicts = deps;
+}
+
+/** \return a Conflicts or Breaks on target that matches target_ver
+ *  and is declared by the to-be-installed version of a package other
+ *  than parentPkg.
+ */
+static pkgCache::DepIterator find_rev_conflict(const pkgCache::PkgIterator &target,
+					       const pkgCache::PkgIterator &parentPkg,
+					       const char *target_ver,
+					       aptitudeDepCache &cache)
+{
+  for(unsigned long i = rev_conflicts_start[target->ID];
+      i < rev_conflicts_start[target->ID + 1]; ++i)
+    {
+      pkgCache::DepIterator dep(cache, rev_conflicts[i]);
+
+      if(dep.ParentPkg() != parentPkg &&
+	 install_version(dep.ParentPkg(), cache) == dep.ParentVer() &&
+	 _system->VS->CheckDep(target_ver,
+			       dep->CompareOp,
+			       dep.TargetVer()))
+	return dep;
+    }
+
+  return pkgCache::DepIterator(cache, 0, (pkgCache::Version *)0);
+}
+
 pkgCache::DepIterator is_conflicted(const pkgCache::VerIterator &ver,
 				    aptitudeDepCache &cache)
 {
@@ -922,42 +1307,23 @@ pkgCache::DepIterator is_conflicted(const pkgCache::VerIterator &ver,
     }
 
   // Look for reverse conflicts:
+  build_rev_conflicts_index(cache);
 
   // Look for direct reverse conflicts:
-  for(pkgCache::DepIterator dep = parentPkg.RevDependsList();
-      !dep.end(); ++dep)
-    {
-      if(dep->Type == pkgCache::Dep::Conflicts ||
-	 dep->Type == pkgCache::Dep::DpkgBreaks)
-	{
-	  if(dep.ParentPkg() != parentPkg &&
-	     install_version(dep.ParentPkg(), cache) == dep.ParentVer() &&
-	     _system->VS->CheckDep(ver.VerStr(),
-				   dep->CompareOp,
-				   dep.TargetVer()))
-	    return dep;
-	}
-    }
+  pkgCache::DepIterator rev_conflict =
+    find_rev_conflict(parentPkg, parentPkg, ver.VerStr(), cache);
+  if(!rev_conflict.end())
+    return rev_conflict;
 
   // Look for indirect reverse conflicts: that is, things that
   // conflict with a package that this version provides.
   for(pkgCache::PrvIterator prv = ver.ProvidesList();
       !prv.end(); ++prv)
     {
-      for(pkgCache::DepIterator dep = prv.ParentPkg().RevDependsList();
-	  !dep.end(); ++dep)
-	{
-	  if(dep->Type == pkgCache::Dep::Conflicts ||
-	     dep->Type == pkgCache::Dep::DpkgBreaks)
-	    {
-	      if(dep.ParentPkg() != parentPkg &&
-		 install_version(dep.ParentPkg(), cache) == dep.ParentVer() &&
-		 _system->VS->CheckDep(prv.ProvideVersion(),
-				       dep->CompareOp,
-				       dep.TargetVer()))
-		return dep;
-	    }
-	}
+      rev_conflict = find_rev_conflict(prv.ParentPkg(), parentPkg,
+				       prv.ProvideVersion(), cache);
+      if(!rev_conflict.end())
+	return rev_conflict;
     }
 
   return pkgCache::DepIterator(cache, 0, (pkgCache::Version *)0);
@@ -1110,7 +1476,7 @@ static bool internal_is_interesting_dep(const pkgCache::DepIterator &d,
   else if(const_cast<pkgCache::DepIterator &>(d).IsCritical())
     return true;
   else if(d->Type != pkgCache::Dep::Recommends ||
-	  !aptcfg->FindB("Apt::Install-Recommends", true))
+	  !aptitude::apt::get_config_snapshot().install_recommends)
     return false;
   else
     {
@@ -1344,5 +1710,37 @@ namespace aptitude
 
       return top_sections;
     }
+
+    std::string get_cache_fingerprint(aptitudeDepCache &cache)
+    {
+      const std::string cache_file = _config->FindFile("Dir::Cache::pkgcache");
+      struct stat buf;
+
+      if(cache_file.empty() || stat(cache_file.c_str(), &buf) != 0)
+	return std::string();
+
+      // If the cache file can't be written (e.g., when aptitude runs
+      // as an ordinary user), apt rebuilds the cache in memory after
+      // dpkg changes the status file, and the file on disk no longer
+      // describes the loaded cache.  Include the status file so that
+      // derived data is invalidated in that case too.
+      const std::string status_file = _config->FindFile("Dir::State::status");
+      struct stat status_buf;
+
+      if(status_file.empty() || stat(status_file.c_str(), &status_buf) != 0)
+	{
+	  status_buf.st_size = 0;
+	  status_buf.st_mtime = 0;
+	}
+
+      return cwidget::util::ssprintf("%s %lu %lu %lu %lu %lu %lu",
+				     cache_file.c_str(),
+				     (unsigned long) buf.st_size,
+				     (unsigned long) buf.st_mtime,
+				     (unsigned long) status_buf.st_size,
+				     (unsigned long) status_buf.st_mtime,
+				     (unsigned long) cache.Head().PackageCount,
+				     (unsigned long) cache.Head().VersionCount);
+    }
   }
 }
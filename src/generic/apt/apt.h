@@ -106,6 +106,17 @@ void apt_shutdown();
  */
 bool get_apt_knows_about_rootdir();
 
+/** \return \b true if Aptitude::Low-Memory is set.
+ *
+ *  In low-memory mode, the defaults of the options that trade memory
+ *  for speed or convenience are lowered: the resolver keeps a smaller
+ *  search graph and computes no solutions ahead of time, only one
+ *  undo level is kept, and the debtags database and the task
+ *  descriptions are never loaded.  Options that are set explicitly
+ *  still override these defaults.
+ */
+bool apt_low_memory_mode();
+
 /** If the cache is closed, open it; otherwise do nothing.
  *
  *  \param progress_bar a progress bar with which to display the
@@ -213,6 +224,9 @@ const int num_pkg_action_states=12;
  *  \param ignore_broken  Never return pkg_broken; instead
  *                        return whatever status the package
  *                        would have if it wasn't broken.
+ *
+ *  Outside of an action group the state is read from a table that
+ *  the cache rebuilds at the end of each group.
  */
 pkg_action_state find_pkg_state(pkgCache::PkgIterator pkg,
 				aptitudeDepCache &cache,
@@ -254,14 +268,43 @@ bool package_suggested(const pkgCache::PkgIterator &pkg);
 
 /** \return true if pkg is recommended by another package which will
  *  be installed or upgraded.
+ *
+ *  Both this and package_suggested() remember their results until a
+ *  package state change that could affect them.
  */
 bool package_recommended(const pkgCache::PkgIterator &pkg);
 
 /** \return true if the given package version is available solely from
  * a "trusted" source.
+ *
+ *  The result is remembered until the cache is closed, so this is
+ *  cheap to call each time a version is displayed.
  */
 bool package_trusted(const pkgCache::VerIterator &ver);
 
+/** \brief Wide versions of the strings of the package cache that are
+ *  displayed most often.
+ *
+ *  Each string is converted the first time it is requested and kept
+ *  until the cache is closed, so displaying a package doesn't need to
+ *  convert its name and versions each time.  These should only be
+ *  called from the main thread.
+ */
+// @{
+
+/** \return pkg.FullName(true) as a wide string. */
+const std::wstring &get_wide_full_name(const pkgCache::PkgIterator &pkg);
+
+/** \return ver.VerStr() as a wide string. */
+const std::wstring &get_wide_version_string(const pkgCache::VerIterator &ver);
+
+/** \return the given string, which must be stored in the package
+ *  cache (e.g., a section name), as a wide string.
+ */
+const std::wstring &get_wide_cache_string(const char *s);
+
+// @}
+
 /** \return the package version that is to be installed for the given
  *  package, or an invalid iterator if the package will be removed or
  *  will not be installed.
@@ -449,6 +492,20 @@ namespace aptitude
      *  or a builtin list of defaults.
      */
     const std::vector<std::string> get_top_sections(const bool cached=true);
+
+    /** \brief Compute a string that identifies the contents of the
+     *  package cache.
+     *
+     *  The string depends on the cache file and on dpkg's status
+     *  file.  Data that is derived from the cache and stored on disk
+     *  can record this string, and be ignored if it doesn't match the
+     *  string of the cache that is currently loaded; see
+     *  cache_artifact.h.
+     *
+     *  \return the fingerprint, or an empty string if the cache file
+     *  can't be found (e.g., because the cache was built in memory).
+     */
+    std::string get_cache_fingerprint(aptitudeDepCache &cache);
   }
 }
 
@@ -23,9 +23,12 @@
 #include <loggers.h>
 
 #include "apt.h"
+#include "aptitude_resolver_dep_table.h"
 #include "aptitude_resolver_universe.h"
 #include "aptitudepolicy.h"
 #include "config_signal.h"
+#include "config_snapshot.h"
+#include "resolver_plan.h"
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
@@ -43,11 +46,14 @@
 #include <apt-pkg/policy.h>
 #include <apt-pkg/version.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include <cwidget/generic/util/eassert.h>
@@ -71,27 +77,47 @@ class aptitudeDepCache::apt_undoer:public undoable
 // Of course, there's always the danger that this won't properly restore the
 // cache state, so I'll have to revert to the original method..
 {
+  // One of these is kept for every package changed by every undoable
+  // action, so the fields are ordered and sized to pack tightly; the
+  // narrow types match the ones in StateCache.
   PkgIterator pkg;
-  int prev_mode;  // One of Delete,Keep,Install
-  int prev_iflags, prev_flags;
+  interned_version prev_forbidver;
+  aptitudeDepCache *owner;
+
   changed_reason prev_removereason;
   pkgCache::State::PkgSelectedState prev_selection_state;
 
-  string prev_forbidver;
-
-  aptitudeDepCache *owner;
+  unsigned short prev_iflags;
+  unsigned char prev_flags;
+  unsigned char prev_mode;  // One of Delete,Keep,Install
 public:
   apt_undoer(PkgIterator _pkg, int _prev_mode, int _prev_flags, int _prev_iflags,
 	     changed_reason _prev_removereason,
 	     pkgCache::State::PkgSelectedState _prev_selection_state,
-	     string _prev_forbidver,
+	     interned_version _prev_forbidver,
 	     aptitudeDepCache *_owner)
-    :pkg(_pkg), prev_mode(_prev_mode), prev_iflags(_prev_iflags), prev_flags(_prev_flags),
+    :pkg(_pkg),
+     prev_forbidver(_prev_forbidver),
+     owner(_owner),
      prev_removereason(_prev_removereason),
      prev_selection_state(_prev_selection_state),
-     prev_forbidver(_prev_forbidver),
-     owner(_owner)
+     prev_iflags(_prev_iflags), prev_flags(_prev_flags), prev_mode(_prev_mode)
+  {
+  }
+
+  std::size_t memory_size() const
+  {
+    return sizeof(*this);
+  }
+
+  // This restores everything about the package that any other
+  // apt_undoer could, so it makes a newer one for the same package
+  // redundant.
+  bool supersedes(const undoable &newer) const
   {
+    const apt_undoer *other = dynamic_cast<const apt_undoer *>(&newer);
+
+    return other != NULL && other->owner == owner && other->pkg == pkg;
   }
 
   void undo()
@@ -143,6 +169,11 @@ public:
     return packages.empty();
   }
 
+  std::size_t memory_size() const
+  {
+    return sizeof(*this) + packages.capacity() * sizeof(pkgCache::PkgIterator);
+  }
+
   void undo()
   {
     for(vector<pkgCache::PkgIterator>::iterator i=packages.begin(); i!=packages.end(); i++)
@@ -192,9 +223,15 @@ aptitudeDepCache::action_group::~action_group()
 
 aptitudeDepCache::aptitudeDepCache(pkgCache *Cache, Policy *Plcy)
   :pkgDepCache(Cache, Plcy), dirty(false), read_only(true),
-   package_states(NULL), lock(-1), group_level(0),
-   new_package_count(0), records(NULL)
+   package_states(NULL), user_tag_packages_stale(true),
+   lock(-1), group_level(0),
+   new_package_count(0), records(NULL),
+   state_generation(1), action_states_generation(0),
+   resolver_dep_table(NULL),
+   account(sigc::mem_fun(*this, &aptitudeDepCache::account_memory))
 {
+  pre_package_state_changed.connect(sigc::mem_fun(*this, &aptitudeDepCache::bump_state_generation));
+
   // When the "install recommended packages" flag changes, collect garbage.
 #if 0
   aptcfg->connect("Apt::Install-Recommends",
@@ -223,12 +260,61 @@ bool aptitudeDepCache::Init(OpProgress *Prog, bool WithLock, bool do_initselecti
 aptitudeDepCache::~aptitudeDepCache()
 {
   delete records;
+  delete resolver_dep_table;
   delete[] package_states;
 
   if(lock!=-1)
     close(lock);
 }
 
+void aptitudeDepCache::build_resolver_dep_table()
+{
+  if(resolver_dep_table == NULL)
+    resolver_dep_table = new aptitude_resolver_dep_table(*this);
+}
+
+void aptitudeDepCache::account_memory(aptitude::util::memory_report &report)
+{
+  using aptitude::util::node_memory_usage;
+  using aptitude::util::vector_memory_usage;
+
+  const unsigned long num_packages = Head().PackageCount;
+  const unsigned long num_deps = Head().DependsCount;
+
+  // pkgDepCache's tables are allocated to the size of the cache, like
+  // ours.
+  std::size_t states =
+    num_packages * sizeof(StateCache) +
+    num_deps * sizeof(unsigned char) +
+    vector_memory_usage(action_states) +
+    vector_memory_usage(user_tags) +
+    node_memory_usage(user_tags_index) +
+    vector_memory_usage(user_tag_packages);
+  if(package_states != NULL)
+    states += num_packages * sizeof(aptitude_state);
+  for(std::vector<std::string>::const_iterator it = user_tags.begin();
+      it != user_tags.end(); ++it)
+    states += it->capacity();
+  for(std::vector<std::set<unsigned long> >::const_iterator it =
+	user_tag_packages.begin(); it != user_tag_packages.end(); ++it)
+    states += node_memory_usage(*it);
+  report.add("package states", states);
+
+  std::size_t snapshots = 0;
+  if(backup_state.PkgState != NULL)
+    snapshots += num_packages * sizeof(StateCache);
+  if(backup_state.DepState != NULL)
+    snapshots += num_deps * sizeof(unsigned char);
+  if(backup_state.AptitudeState != NULL)
+    snapshots += num_packages * sizeof(aptitude_state);
+  {
+    cwidget::threads::mutex::lock l(state_snapshot_mutex);
+    if(state_snapshot.get() != NULL)
+      snapshots += state_snapshot->memory_usage();
+  }
+  report.add("package state snapshots", snapshots);
+}
+
 void aptitudeDepCache::set_read_only(bool new_read_only)
 {
   read_only = new_read_only;
@@ -294,6 +380,33 @@ namespace
 	  }
       }
   }
+
+  /** \brief Read the next data.size() bytes of fd and compare them
+   *  to data.
+   *
+   *  \return \b true if fd contained exactly those bytes.
+   */
+  bool next_bytes_match(int fd, const std::string &data)
+  {
+    char buf[4096];
+    std::string::size_type matched = 0;
+
+    while(matched < data.size())
+      {
+	const std::string::size_type wanted =
+	  std::min<std::string::size_type>(sizeof(buf), data.size() - matched);
+	const ssize_t amt = read(fd, buf, wanted);
+
+	if(amt < 0 && errno == EINTR)
+	  continue;
+	else if(amt <= 0 || memcmp(buf, data.data() + matched, amt) != 0)
+	  return false;
+
+	matched += amt;
+      }
+
+    return true;
+  }
 }
 
 void aptitudeDepCache::parse_user_tags(std::set<user_tag> &tags,
@@ -347,11 +460,13 @@ bool aptitudeDepCache::build_selection_list(OpProgress &Prog, bool WithLock,
   delete package_states;
   package_states=new aptitude_state[Head().PackageCount];
   user_tags.clear();
+  user_tag_packages.clear();
+  user_tag_packages_stale = true;
   for(unsigned int i=0; i<Head().PackageCount; i++)
     {
       package_states[i].new_package=true;
       package_states[i].reinstall=false;
-      package_states[i].user_tags.clear();
+      package_states[i].user_tags = interned_user_tags();
       package_states[i].remove_reason=manual;
       package_states[i].selection_state = pkgCache::State::Unknown;
       package_states[i].previously_auto_package = false;
@@ -467,8 +582,11 @@ bool aptitudeDepCache::build_selection_list(OpProgress &Prog, bool WithLock,
 	      {
 		const char *start, *end;
 		if(section.Find("User-Tags", start, end))
-		  parse_user_tags(pkg_state.user_tags, start, end,
-				  package_name);
+		  {
+		    std::set<user_tag> tags;
+		    parse_user_tags(tags, start, end, package_name);
+		    pkg_state.user_tags = tags;
+		  }
 	      }
 
 	      if(do_dselect && pkg->SelectedState != last_dselect_state)
@@ -540,7 +658,7 @@ bool aptitudeDepCache::build_selection_list(OpProgress &Prog, bool WithLock,
 	  if(!estate.candver.empty())
 	    {
 	      for(pkgCache::VerIterator ver=i.VersionList(); !ver.end(); ++ver)
-		if(ver.VerStr()==estate.candver &&
+		if(ver.VerStr()==estate.candver.get() &&
 		   (ver.Downloadable() ||
 		    (ver == ver.ParentPkg().CurrentVer() &&
 		     ver.ParentPkg()->CurrentState != pkgCache::State::ConfigFiles)))
@@ -594,6 +712,8 @@ bool aptitudeDepCache::build_selection_list(OpProgress &Prog, bool WithLock,
   Prog.OverallProgress(Head().PackageCount, Head().PackageCount, 1, _("Initializing package states"));
 
   duplicate_cache(&backup_state);
+  rebuild_action_states();
+  publish_state_snapshot();
 
   if(aptcfg->FindB(PACKAGE "::Auto-Upgrade", false) && do_initselections)
     mark_all_upgradable(aptcfg->FindB(PACKAGE "::Auto-Install", true),
@@ -755,6 +875,23 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
       int num=0;
       prog.OverallProgress(0, Head().PackageCount, 1, _("Writing extended state information"));
 
+      // Writing each stanza as it is generated costs a system call
+      // per package, so collect them and write them out in blocks.
+      const std::string::size_type block_size = 64 * 1024;
+      std::string block;
+      block.reserve(block_size + 1024);
+
+      // Often nothing in the pkgstates file changed (for instance, if
+      // only an automatic flag was modified, which goes to the apt
+      // state file).  Compare what we write with the current file as
+      // we go; if they are identical, the current file is left in
+      // place, which spares the filesystem a rename and the flush of
+      // the new file that usually comes with it.
+      int oldstate = -1;
+      if(!status_fname)
+	oldstate = open(statefile.c_str(), O_RDONLY);
+      bool unchanged = (oldstate != -1);
+
       for(PkgIterator i=PkgBegin(); !i.end(); i++)
 	if(!i.VersionList().end())
 	  {
@@ -762,7 +899,7 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
 	    aptitude_state &estate=get_ext_state(i);
 
 	    string forbidstr=!estate.forbidver.empty()
-	      ? "ForbidVer: "+estate.forbidver+"\n":"";
+	      ? "ForbidVer: "+estate.forbidver.get()+"\n":"";
 
 	    bool upgrade=(!i.CurrentVer().end()) && state.Install();
 	    string upgradestr=upgrade ? "Upgrade: yes\n" : "";
@@ -777,8 +914,8 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
 	    if(state.Install() &&
 	       !estate.candver.empty() &&
 	       (GetCandidateVer(i).end() ||
-		GetCandidateVer(i).VerStr() != estate.candver))
-	      tailstr = "Version: " + estate.candver + "\n";
+		GetCandidateVer(i).VerStr() != estate.candver.get()))
+	      tailstr = "Version: " + estate.candver.get() + "\n";
 
 	    // Build the list of usertags for this package.
 	    std::string user_tags;
@@ -789,10 +926,11 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
 		// Put the usertags in sorted order so we get
 		// predictable outputs.
 		std::vector<std::string> tmp;
-		tmp.reserve(estate.user_tags.size());
+		const std::set<user_tag> &tags(estate.user_tags.get());
+		tmp.reserve(tags.size());
 
 		for(std::set<user_tag>::const_iterator it
-		      = estate.user_tags.begin(); it != estate.user_tags.end(); ++it)
+		      = tags.begin(); it != tags.end(); ++it)
 		  tmp.push_back(deref_user_tag(*it));
 
 		std::sort(tmp.begin(), tmp.end());
@@ -849,20 +987,46 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
 				      user_tags.c_str(),
 				      tailstr.c_str()));
 
-	    if(newstate.Failed() || !newstate.Write(line.c_str(), line.size()))
+	    block += line;
+
+	    if(block.size() >= block_size && unchanged)
+	      unchanged = next_bytes_match(oldstate, block);
+
+	    if(block.size() >= block_size &&
+	       (newstate.Failed() || !newstate.Write(block.c_str(), block.size())))
 	      {
 		_error->Error(_("Couldn't write state file"));
 		newstate.Close();
+		if(oldstate != -1)
+		  close(oldstate);
 
 		if(!status_fname)
 		  unlink((statefile+".new").c_str());
 		return false;
 	      }
 
+	    if(block.size() >= block_size)
+	      block.clear();
+
 	    num++;
 	    prog.OverallProgress(num, Head().PackageCount, 1, _("Writing extended state information"));
 	  }
 
+      // Any error here is caught by the check below.
+      if(!block.empty() && !newstate.Failed())
+	newstate.Write(block.c_str(), block.size());
+
+      if(unchanged)
+	{
+	  char c;
+	  // The old file must also end here.
+	  unchanged = next_bytes_match(oldstate, block) &&
+	    read(oldstate, &c, 1) == 0;
+	}
+
+      if(oldstate != -1)
+	close(oldstate);
+
       prog.OverallProgress(Head().PackageCount, Head().PackageCount, 1, _("Writing extended state information"));
 
       if(newstate.Failed())
@@ -880,7 +1044,9 @@ bool aptitudeDepCache::save_selection_list(OpProgress &prog,
       newstate.Close();
       // FIXME!  This potentially breaks badly on NFS.. (?) -- actually, it
       //       wouldn't be harmful; you'd just get gratuitous errors..
-      if(!status_fname)
+      if(unchanged)
+	unlink((statefile+".new").c_str());
+      else if(!status_fname)
 	{
 	  string oldstr(statefile + ".old"), newstr(statefile + ".new");
 
@@ -945,6 +1111,12 @@ void aptitudeDepCache::forget_new(undoable **undoer)
       return;
     }
 
+  // Nothing to forget: don't snapshot the cache or make the UI
+  // rebuild itself.  This is the usual case after an update with
+  // Forget-New-On-Update, or a second forget-new.
+  if(new_package_count == 0)
+    return;
+
   forget_undoer *undo=undoer?new forget_undoer(this):NULL;
 
   for(pkgCache::PkgIterator i=PkgBegin(); !i.end(); i++)
@@ -1131,7 +1303,7 @@ void aptitudeDepCache::internal_mark_install(const PkgIterator &Pkg,
 
   get_ext_state(Pkg).selection_state=pkgCache::State::Install;
   get_ext_state(Pkg).reinstall=ReInstall;
-  get_ext_state(Pkg).forbidver="";
+  get_ext_state(Pkg).forbidver=interned_version();
 }
 
 void aptitudeDepCache::mark_delete(const PkgIterator &Pkg,
@@ -1267,9 +1439,9 @@ void aptitudeDepCache::set_candidate_version(const VerIterator &ver,
       aptitude_state &estate = get_ext_state(ver.ParentPkg());
 
       if(ver!=GetCandidateVer(ver.ParentPkg()))
-	estate.candver=ver.VerStr();
+	estate.candver=std::string(ver.VerStr());
       else
-	estate.candver="";
+	estate.candver=interned_version();
 
       estate.selection_state = pkgCache::State::Install;
 
@@ -1305,7 +1477,7 @@ void aptitudeDepCache::forbid_upgrade(const PkgIterator &pkg,
 
   aptitude_state &estate=get_ext_state(pkg);
 
-  if(verstr!=estate.forbidver)
+  if(verstr!=estate.forbidver.get())
     {
       action_group group(*this, undo);
 
@@ -1374,40 +1546,40 @@ namespace
   class attach_user_tag_undoer : public undoable
   {
     aptitudeDepCache *parent;
-    pkgCache::PkgIterator pkg;
+    std::vector<pkgCache::PkgIterator> pkgs;
     std::string tag;
 
   public:
     attach_user_tag_undoer(aptitudeDepCache *_parent,
-		      const pkgCache::PkgIterator &_pkg,
-		      const std::string &_tag)
-      : parent(_parent), pkg(_pkg), tag(_tag)
+			   const std::vector<pkgCache::PkgIterator> &_pkgs,
+			   const std::string &_tag)
+      : parent(_parent), pkgs(_pkgs), tag(_tag)
     {
     }
 
     void undo()
     {
-      parent->detach_user_tag(pkg, tag, NULL);
+      parent->detach_user_tag(pkgs, tag, NULL);
     }
   };
 
   class detach_user_tag_undoer : public undoable
   {
     aptitudeDepCache *parent;
-    pkgCache::PkgIterator pkg;
+    std::vector<pkgCache::PkgIterator> pkgs;
     std::string tag;
 
   public:
     detach_user_tag_undoer(aptitudeDepCache *_parent,
-			   const pkgCache::PkgIterator &_pkg,
+			   const std::vector<pkgCache::PkgIterator> &_pkgs,
 			   const std::string &_tag)
-      : parent(_parent), pkg(_pkg), tag(_tag)
+      : parent(_parent), pkgs(_pkgs), tag(_tag)
     {
     }
 
     void undo()
     {
-      parent->attach_user_tag(pkg, tag, NULL);
+      parent->attach_user_tag(pkgs, tag, NULL);
     }
   };
 }
@@ -1415,6 +1587,20 @@ namespace
 void aptitudeDepCache::attach_user_tag(const PkgIterator &pkg,
 				       const std::string &tag,
 				       undo_group *undo)
+{
+  attach_user_tag(std::vector<PkgIterator>(1, pkg), tag, undo);
+}
+
+void aptitudeDepCache::detach_user_tag(const PkgIterator &pkg,
+				       const std::string &tag,
+				       undo_group *undo)
+{
+  detach_user_tag(std::vector<PkgIterator>(1, pkg), tag, undo);
+}
+
+void aptitudeDepCache::attach_user_tag(const std::vector<PkgIterator> &pkgs,
+				       const std::string &tag,
+				       undo_group *undo)
 {
   if(read_only && !read_only_permission())
     {
@@ -1433,20 +1619,36 @@ void aptitudeDepCache::attach_user_tag(const PkgIterator &pkg,
       user_tags.push_back(tag);
       std::pair<index_ref, bool> tmp(user_tags_index.insert(std::make_pair(tag, loc)));
       found = tmp.first;
+
+      if(!user_tag_packages_stale)
+	user_tag_packages.push_back(std::set<unsigned long>());
     }
 
-  std::pair<std::set<user_tag>::const_iterator, bool> insert_result =
-    get_ext_state(pkg).user_tags.insert(user_tag(found->second));
+  const user_tag new_tag(found->second);
+  std::vector<PkgIterator> changed;
+  for(std::vector<PkgIterator>::const_iterator it = pkgs.begin();
+      it != pkgs.end(); ++it)
+    {
+      aptitude_state &estate = get_ext_state(*it);
+      std::set<user_tag> tags(estate.user_tags.get());
+      if(tags.insert(new_tag).second)
+	{
+	  estate.user_tags = tags;
+	  changed.push_back(*it);
+	  if(!user_tag_packages_stale)
+	    user_tag_packages[found->second].insert((*it)->ID);
+	}
+    }
 
-  if(insert_result.second)
+  if(!changed.empty())
     {
       dirty = true;
       if(undo != NULL)
-	undo->add_item(new attach_user_tag_undoer(this, pkg, tag));
+	undo->add_item(new attach_user_tag_undoer(this, changed, tag));
     }
 }
 
-void aptitudeDepCache::detach_user_tag(const PkgIterator &pkg,
+void aptitudeDepCache::detach_user_tag(const std::vector<PkgIterator> &pkgs,
 				       const std::string &tag,
 				       undo_group *undo)
 {
@@ -1463,15 +1665,50 @@ void aptitudeDepCache::detach_user_tag(const PkgIterator &pkg,
   if(found == user_tags_index.end())
     return;
 
-  std::set<user_tag>::size_type num_erased =
-    get_ext_state(pkg).user_tags.erase(user_tag(found->second));
+  const user_tag old_tag(found->second);
+  std::vector<PkgIterator> changed;
+  for(std::vector<PkgIterator>::const_iterator it = pkgs.begin();
+      it != pkgs.end(); ++it)
+    {
+      aptitude_state &estate = get_ext_state(*it);
+      std::set<user_tag> tags(estate.user_tags.get());
+      if(tags.erase(old_tag) > 0)
+	{
+	  estate.user_tags = tags;
+	  changed.push_back(*it);
+	  if(!user_tag_packages_stale)
+	    user_tag_packages[found->second].erase((*it)->ID);
+	}
+    }
 
-  if(num_erased > 0)
+  if(!changed.empty())
     {
       dirty = true;
       if(undo != NULL)
-	undo->add_item(new detach_user_tag_undoer(this, pkg, tag));
+	undo->add_item(new detach_user_tag_undoer(this, changed, tag));
+    }
+}
+
+const std::set<unsigned long> &
+aptitudeDepCache::get_user_tag_packages(const user_tag &tag)
+{
+  if(user_tag_packages_stale)
+    {
+      user_tag_packages.clear();
+      user_tag_packages.resize(user_tags.size());
+
+      for(PkgIterator pkg = PkgBegin(); !pkg.end(); ++pkg)
+	{
+	  const std::set<user_tag> &tags(get_ext_state(pkg).user_tags.get());
+	  for(std::set<user_tag>::const_iterator it = tags.begin();
+	      it != tags.end(); ++it)
+	    user_tag_packages[it->tag_num].insert(pkg->ID);
+	}
+
+      user_tag_packages_stale = false;
     }
+
+  return user_tag_packages[tag.tag_num];
 }
 
 bool aptitudeDepCache::all_upgrade(bool with_autoinst, undo_group *undo)
@@ -1620,11 +1857,8 @@ void aptitudeDepCache::duplicate_cache(apt_state_snapshot *target)
 
   memcpy(target->PkgState, PkgState, sizeof(StateCache)*Head().PackageCount);
   memcpy(target->DepState, DepState, sizeof(char)*Head().DependsCount);
-  // memcpy doesn't work here because the aptitude_state structure
-  // contains a std::string.  (would it be worthwhile/possible to
-  // change things so that it doesn't?)
-  for(unsigned int i=0; i<Head().PackageCount; ++i)
-    target->AptitudeState[i]=package_states[i];
+  // This is safe because the strings in aptitude_state are interned.
+  memcpy(target->AptitudeState, package_states, sizeof(aptitude_state)*Head().PackageCount);
 
   target->iUsrSize=iUsrSize;
   target->iDownloadSize=iDownloadSize;
@@ -1636,12 +1870,15 @@ void aptitudeDepCache::duplicate_cache(apt_state_snapshot *target)
 }
 
 // Helpers for aptitudeDepCache::sweep().
+//
+// Sets of packages are stored as bitmaps indexed by package ID, since
+// they are probed once for each reverse dependency that is visited.
 namespace
 {
   // Remove reverse dependencies of the given version from the set of
   // reinstated packages.  All the packages in the set are assumed to
   // be installed at their current version when checking dependencies.
-  void remove_reverse_current_versions(std::set<pkgCache::PkgIterator> &reinstated,
+  void remove_reverse_current_versions(std::vector<bool> &reinstated,
 				       pkgCache::VerIterator bad_ver)
   {
     logging::LoggerPtr logger(Loggers::getAptitudeAptCache());
@@ -1657,7 +1894,7 @@ namespace
 	  continue;
 
 	// Skip packages that aren't in the reinstate set.
-	if(reinstated.find(dep.ParentPkg()) == reinstated.end())
+	if(!reinstated[dep.ParentPkg()->ID])
 	  continue;
 
 	if((dep->Type == pkgCache::Dep::Depends ||
@@ -1672,7 +1909,7 @@ namespace
 		      << " due to its dependency on "
 		      << bad_ver.ParentPkg().FullName(false)
 		      << " " << bad_ver.VerStr());
-	    reinstated.erase(dep.ParentPkg());
+	    reinstated[dep.ParentPkg()->ID] = false;
 	    remove_reverse_current_versions(reinstated, dep.ParentVer());
 	  }
       }
@@ -1688,7 +1925,7 @@ namespace
 	    continue;
 
 	  // Skip packages that aren't in the reinstate set.
-	  if(reinstated.find(dep.ParentPkg()) == reinstated.end())
+	  if(!reinstated[dep.ParentPkg()->ID])
 	    continue;
 
 	  if((dep->Type == pkgCache::Dep::Depends ||
@@ -1705,7 +1942,7 @@ namespace
 			<< " " << bad_ver.VerStr()
 			<< " via the virtual package "
 			<< prv.ParentPkg().Name());
-	      reinstated.erase(dep.ParentPkg());
+	      reinstated[dep.ParentPkg()->ID] = false;
 	      remove_reverse_current_versions(reinstated, dep.ParentVer());
 	    }
 	}
@@ -1716,13 +1953,13 @@ namespace
   // "reinstated" to the not-orphaned set.  (the condition on
   // reinstated is so we don't pick the wrong branch of an OR)
   void trace_not_orphaned(const pkgCache::PkgIterator &notOrphan,
-			  const std::set<pkgCache::PkgIterator> &reinstated,
+			  const std::vector<bool> &reinstated,
 			  pkgDepCache &cache,
-			  std::set<pkgCache::PkgIterator> &not_orphaned)
+			  std::vector<bool> &not_orphaned)
   {
     logging::LoggerPtr logger(Loggers::getAptitudeAptCache());
 
-    if(not_orphaned.find(notOrphan) != not_orphaned.end())
+    if(not_orphaned[notOrphan->ID])
       {
 	LOG_TRACE(logger, "Ignoring " << notOrphan.FullName(false)
 		  << ": it was already visited.");
@@ -1740,7 +1977,7 @@ namespace
 	return;
       }
 
-    if(reinstated.find(notOrphan) == reinstated.end())
+    if(!reinstated[notOrphan->ID])
       {
 	LOG_DEBUG(logger, "Treating the package "
 		  << notOrphan.FullName(false)
@@ -1751,7 +1988,7 @@ namespace
     LOG_DEBUG(logger, "The package " << notOrphan.FullName(false)
 	      << " is not an orphan.");
 
-    not_orphaned.insert(notOrphan);
+    not_orphaned[notOrphan->ID] = true;
     for(pkgCache::DepIterator dep = notOrphan.CurrentVer().DependsList();
 	!dep.end(); ++dep)
       {
@@ -1795,9 +2032,9 @@ namespace
   // because any strong dependencies on stuff that was thrown out
   // would also have been thrown out.
   void find_not_orphaned(const pkgCache::PkgIterator &maybeOrphan,
-			 const std::set<pkgCache::PkgIterator> &reinstated,
+			 const std::vector<bool> &reinstated,
 			 pkgDepCache &cache,
-			 std::set<pkgCache::PkgIterator> &not_orphaned)
+			 std::vector<bool> &not_orphaned)
   {
     logging::LoggerPtr logger(Loggers::getAptitudeAptCache());
 
@@ -1863,7 +2100,12 @@ void aptitudeDepCache::sweep()
   // being installed by this solution!
   //
   // See Debian bugs #522881 and #524667.
-  std::set<pkgCache::PkgIterator> reinstated, reinstated_bad;
+  //
+  // Membership in "reinstated" is tested with the bitmap; the list
+  // keeps the candidates in ID order so we can visit them without
+  // scanning the whole cache again.
+  std::vector<bool> reinstated(Head().PackageCount, false);
+  std::vector<pkgCache::PkgIterator> reinstated_candidates, reinstated_bad;
 
   // Suppress intermediate removals.
   //
@@ -1924,7 +2166,7 @@ void aptitudeDepCache::sweep()
 			<< conflict.ParentPkg().FullName(false)
 			<< " and " << conflict.TargetPkg().FullName(false));
 
-	      reinstated_bad.insert(pkg);
+	      reinstated_bad.push_back(pkg);
 	    }
 	  else
 	    {
@@ -1932,31 +2174,37 @@ void aptitudeDepCache::sweep()
 			<< pkg.FullName(false) << " for reinstatement.");
 
 
-	      reinstated.insert(pkg);
+	      reinstated[pkg->ID] = true;
+	      reinstated_candidates.push_back(pkg);
 	    }
 	}
     }
 
   // Remove packages that transitively depend on a package in
   // reinstated_bad from reinstated.
-  for(std::set<pkgCache::PkgIterator>::const_iterator it =
+  for(std::vector<pkgCache::PkgIterator>::const_iterator it =
 	reinstated_bad.begin(); it != reinstated_bad.end(); ++it)
     remove_reverse_current_versions(reinstated, it->CurrentVer());
 
   // Figure out which reinstated packages aren't orphaned.
-  std::set<pkgCache::PkgIterator> not_orphaned;
-  for(std::set<pkgCache::PkgIterator>::const_iterator it =
-	reinstated.begin(); it != reinstated.end(); ++it)
-    find_not_orphaned(*it,
-		      reinstated,
-		      *this,
-		      not_orphaned);
-
-  // The ones that survived should be reinstated:
-  for(std::set<pkgCache::PkgIterator>::const_iterator it =
-	not_orphaned.begin(); it != not_orphaned.end(); ++it)
+  std::vector<bool> not_orphaned(Head().PackageCount, false);
+  for(std::vector<pkgCache::PkgIterator>::const_iterator it =
+	reinstated_candidates.begin(); it != reinstated_candidates.end(); ++it)
+    if(reinstated[(*it)->ID])
+      find_not_orphaned(*it,
+			reinstated,
+			*this,
+			not_orphaned);
+
+  // The ones that survived should be reinstated.  Only candidates
+  // can be marked as not orphaned, so this finds all of them.
+  for(std::vector<pkgCache::PkgIterator>::const_iterator it =
+	reinstated_candidates.begin(); it != reinstated_candidates.end(); ++it)
     {
       pkgCache::PkgIterator pkg(*it);
+      if(!not_orphaned[pkg->ID])
+	continue;
+
       LOG_INFO(logger, "aptitudeDepCache::sweep(): reinstating "
 	       << pkg.FullName(false));
       MarkKeep(pkg, false, false);
@@ -1990,6 +2238,8 @@ void aptitudeDepCache::end_action_group(undo_group *undo)
       cleanup_after_change(undo, &changed_packages);
 
       duplicate_cache(&backup_state);
+      rebuild_action_states();
+      publish_state_snapshot();
 
       package_state_changed();
       package_states_changed(&changed_packages);
@@ -1998,6 +2248,37 @@ void aptitudeDepCache::end_action_group(undo_group *undo)
   group_level--;
 }
 
+void aptitudeDepCache::rebuild_action_states()
+{
+  // Make sure find_pkg_state() doesn't consult the table while it's
+  // being filled in.
+  action_states_generation = 0;
+
+  action_states.resize(Head().PackageCount);
+  for(PkgIterator pkg = PkgBegin(); !pkg.end(); ++pkg)
+    action_states[pkg->ID] = find_pkg_state(pkg, *this, true);
+
+  action_states_generation = state_generation;
+}
+
+void aptitudeDepCache::publish_state_snapshot()
+{
+  // Only this thread replaces the snapshot, so it can be read
+  // without the lock; the lock just keeps readers from seeing the
+  // pointer half-written.
+  aptitude::apt::package_state_snapshot_ptr snapshot =
+    aptitude::apt::package_state_snapshot::create(*this, state_snapshot);
+
+  cwidget::threads::mutex::lock l(state_snapshot_mutex);
+  state_snapshot = snapshot;
+}
+
+aptitude::apt::package_state_snapshot_ptr aptitudeDepCache::get_state_snapshot() const
+{
+  cwidget::threads::mutex::lock l(state_snapshot_mutex);
+  return state_snapshot;
+}
+
 const aptitudeDepCache::apt_state_snapshot *aptitudeDepCache::snapshot_apt_state()
 {
   apt_state_snapshot *rval=new apt_state_snapshot;
@@ -2017,11 +2298,9 @@ void aptitudeDepCache::restore_apt_state(const apt_state_snapshot *snapshot)
 
   memcpy(PkgState, snapshot->PkgState, sizeof(StateCache)*Head().PackageCount);
   memcpy(DepState, snapshot->DepState, sizeof(char)*Head().DependsCount);
-  // memcpy doesn't work here because the aptitude_state structure
-  // contains a std::string.  (would it be worthwhile/possible to
-  // change things so that it doesn't?)
-  for(unsigned int i=0; i<Head().PackageCount; ++i)
-    package_states[i]=snapshot->AptitudeState[i];
+  // This is safe because the strings in aptitude_state are interned.
+  memcpy(package_states, snapshot->AptitudeState, sizeof(aptitude_state)*Head().PackageCount);
+  user_tag_packages_stale = true;
 
   iUsrSize=snapshot->iUsrSize;
   iDownloadSize=snapshot->iDownloadSize;
@@ -2094,51 +2373,138 @@ void aptitudeDepCache::apply_solution(const generic_solution<aptitude_universe>
   for(std::vector<std::pair<aptitude_resolver_version, bool> >::const_iterator it =
 	versions.begin(); it != versions.end(); ++it)
     {
-      const bool is_auto = it->second;
-
       LOG_TRACE(logger, "Selecting " << it->first << " "
-		<< (is_auto ? "automatically" : "manually"));
+		<< (it->second ? "automatically" : "manually"));
 
-      pkgCache::PkgIterator pkg = it->first.get_pkg();
-      pkgCache::VerIterator curver=pkg.CurrentVer();
-      pkgCache::VerIterator instver = (*apt_cache_file)[pkg].InstVerIter(*apt_cache_file);
-      pkgCache::VerIterator actionver = it->first.get_ver();
+      apply_solution_version(it->first.get_pkg(), it->first.get_ver(),
+			     it->second);
+    }
+}
 
-      // Check what type of action it is.
-      if(actionver.end())
-	{
-	  LOG_TRACE(logger, "Removing " << pkg.FullName(false));
+void aptitudeDepCache::apply_solution_version(const PkgIterator &realPkg,
+					      const VerIterator &actionver,
+					      bool is_auto)
+{
+  logging::LoggerPtr logger(Loggers::getAptitudeAptCache());
 
-	  // removal.
-	  internal_mark_delete(pkg, false, false);
-	  if(is_auto && !curver.end())
-	    get_ext_state(pkg).remove_reason = from_resolver;
-	}
-      else if(actionver == curver)
-	{
-	  LOG_TRACE(logger, "Keeping " << pkg.FullName(false)
-		    << " at its current version ("
-		    << curver.VerStr() << ")");
+  PkgIterator pkg(realPkg);
+  pkgCache::VerIterator curver=pkg.CurrentVer();
+  pkgCache::VerIterator instver = (*this)[pkg].InstVerIter(*this);
+
+  // Check what type of action it is.
+  if(actionver.end())
+    {
+      LOG_TRACE(logger, "Removing " << pkg.FullName(false));
+
+      // removal.
+      internal_mark_delete(pkg, false, false);
+      if(is_auto && !curver.end())
+	get_ext_state(pkg).remove_reason = from_resolver;
+    }
+  else if(actionver == curver)
+    {
+      LOG_TRACE(logger, "Keeping " << pkg.FullName(false)
+		<< " at its current version ("
+		<< curver.VerStr() << ")");
+
+      internal_mark_keep(pkg, is_auto, false);
+    }
+  else
+    // install a particular version that's not the current one.
+    {
+      LOG_TRACE(logger, "Installing " << pkg.FullName(false) << " " << actionver.VerStr());
+
+      set_candidate_version(actionver, NULL);
+      internal_mark_install(pkg, false, false);
+      // Mark the package as automatic iff it isn't currently
+      // going to be installed.  Thus packages that are currently
+      // manually installed don't get marked as auto, packages
+      // that are going to be manually installed don't get marked
+      // as auto, but packages that are being removed *do* get
+      // marked as auto.
+      if(is_auto && instver.end())
+	MarkAuto(pkg, true);
+    }
+}
+
+bool aptitudeDepCache::apply_resolver_plan(const aptitude::apt::resolver_plan &plan,
+					   undo_group *undo)
+{
+  logging::LoggerPtr logger(Loggers::getAptitudeAptCache());
+
+  if(read_only && !read_only_permission())
+    {
+      if(group_level == 0)
+	read_only_fail();
+      LOG_DEBUG(logger, "Not applying the resolver plan: the cache is read-only.");
+      return false;
+    }
 
-	  internal_mark_keep(pkg, is_auto, false);
+  // Look up every version before changing anything, so that a plan
+  // that refers to something this system doesn't have is rejected
+  // as a whole.
+  std::vector<std::pair<PkgIterator, VerIterator> > versions;
+  const std::vector<aptitude::apt::resolver_plan::entry> &entries(plan.get_entries());
+  for(std::vector<aptitude::apt::resolver_plan::entry>::const_iterator it =
+	entries.begin(); it != entries.end(); ++it)
+    {
+      PkgIterator pkg = FindPkg(it->package);
+      if(pkg.end())
+	{
+	  _error->Warning(_("The resolver plan refers to the package %s, which does not exist."),
+			  it->package.c_str());
+	  return false;
 	}
-      else
-	// install a particular version that's not the current one.
+
+      VerIterator ver;
+      if(!it->version.empty())
 	{
-	  LOG_TRACE(logger, "Installing " << pkg.FullName(false) << " " << actionver.VerStr());
-
-	  set_candidate_version(actionver, NULL);
-	  internal_mark_install(pkg, false, false);
-	  // Mark the package as automatic iff it isn't currently
-	  // going to be installed.  Thus packages that are currently
-	  // manually installed don't get marked as auto, packages
-	  // that are going to be manually installed don't get marked
-	  // as auto, but packages that are being removed *do* get
-	  // marked as auto.
-	  if(is_auto && instver.end())
-	    MarkAuto(pkg, true);
+	  for(ver = pkg.VersionList(); !ver.end(); ++ver)
+	    if(it->version == ver.VerStr())
+	      break;
+
+	  if(ver.end())
+	    {
+	      _error->Warning(_("The resolver plan installs version %s of %s, which is not available."),
+			      it->version.c_str(), it->package.c_str());
+	      return false;
+	    }
 	}
+
+      versions.push_back(std::make_pair(pkg, ver));
     }
+
+  LOG_DEBUG(logger, "Applying a resolver plan with " << versions.size() << " entries.");
+
+  undo_group *plan_undo = new undo_group;
+  {
+    action_group group(*this, plan_undo);
+
+    pre_package_state_changed();
+
+    for(std::vector<std::pair<PkgIterator, VerIterator> >::size_type i = 0;
+	i < versions.size(); ++i)
+      apply_solution_version(versions[i].first, versions[i].second,
+			     entries[i].automatic);
+  }
+
+  // The plan was computed for a system in the same state, so unless
+  // something that the fingerprint doesn't cover differs, this
+  // leaves nothing broken.
+  if(BrokenCount() > 0)
+    {
+      _error->Warning(_("Applying the resolver plan would leave broken packages."));
+      plan_undo->undo();
+      delete plan_undo;
+      return false;
+    }
+
+  if(undo != NULL)
+    undo->add_item(plan_undo);
+  else
+    delete plan_undo;
+
+  return true;
 }
 
 aptitudeCacheFile::aptitudeCacheFile()
@@ -2188,11 +2554,14 @@ bool aptitudeCacheFile::Open(OpProgress &Progress, bool do_initselections,
   if(_error->PendingError())
     return false;
 
-  Policy=new aptitudePolicy(Cache);
+  aptitudePolicy *policy = new aptitudePolicy(Cache);
+  Policy=policy;
   if(_error->PendingError())
     return false;
   if(ReadPinFile(*Policy) == false || ReadPinDir(*Policy) == false)
     return false;
+  // Reading the pins may have changed the candidates.
+  policy->invalidate_candidates();
 
   DCache=new aptitudeDepCache(Cache, Policy);
   if(_error->PendingError())
@@ -2236,21 +2605,25 @@ bool aptitudeDepCache::is_held(const PkgIterator &pkg)
 
   return !pkg.CurrentVer().end() &&
     (state.selection_state == pkgCache::State::Hold ||
-     (!candver.end() && candver.VerStr() == state.forbidver));
+     (!candver.end() && candver.VerStr() == state.forbidver.get()));
 }
 
 bool aptitudeDepCache::MarkFollowsRecommends()
 {
+  const aptitude::apt::config_snapshot &cfg(aptitude::apt::get_config_snapshot());
+
   return pkgDepCache::MarkFollowsRecommends() ||
-    aptcfg->FindB("Apt::Install-Recommends", true) ||
-    aptcfg->FindB(PACKAGE "::Keep-Recommends", false);
+    cfg.install_recommends ||
+    cfg.keep_recommends;
 }
 
 bool aptitudeDepCache::MarkFollowsSuggests()
 {
+  const aptitude::apt::config_snapshot &cfg(aptitude::apt::get_config_snapshot());
+
   return pkgDepCache::MarkFollowsSuggests() ||
-    aptcfg->FindB(PACKAGE "::Keep-Suggests", false) ||
-    aptcfg->FindB(PACKAGE "::Suggests-Important", false);
+    cfg.keep_suggests ||
+    cfg.suggests_important;
 }
 
 class AptitudeInRootSetFunc : public pkgDepCache::InRootSetFunc
@@ -2303,7 +2676,7 @@ public:
   bool InRootSet(const pkgCache::PkgIterator &pkg)
   {
     pkgRecords &records(cache.get_records());
-    if(p.valid() && aptitude::matching::get_match(p, pkg, search_info, cache, records).valid())
+    if(p.valid() && aptitude::matching::has_match(p, pkg, search_info, cache, records))
       return true;
     else
       return chain != NULL && chain->InRootSet(pkg);
@@ -2358,7 +2731,7 @@ bool aptitudeDepCache::IsInstallOk(const pkgCache::PkgIterator &pkg,
       return false;
     }
 
-  if(estate.forbidver == candver.VerStr())
+  if(estate.forbidver.get() == candver.VerStr())
     {
       LOG_INFO(Loggers::getAptitudeAptCache(),
 	       "Refusing to install the forbidden version "
@@ -2379,7 +2752,7 @@ bool aptitudeDepCache::IsDeleteOk(const pkgCache::PkgIterator &pkg,
     // resolution; allow it.
     return true;
 
-  if(!aptcfg->FindB(PACKAGE "::Auto-Install-Remove-Ok", false))
+  if(!aptitude::apt::get_config_snapshot().auto_install_remove_ok)
     return false;
   else
     {
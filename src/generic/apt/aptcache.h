@@ -22,8 +22,13 @@
 
 #include <config.h>
 
+#include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/bool_accumulate.h>
 
+#include <generic/apt/package_state_snapshot.h>
+#include <generic/util/interned.h>
+#include <generic/util/memory_accounting.h>
+
 #include <apt-pkg/depcache.h>
 #include <apt-pkg/pkgrecords.h>
 
@@ -53,7 +58,9 @@ class undoable;
 class undo_group;
 class pkgProblemResolver;
 class aptitude_universe;
+class aptitude_resolver_dep_table;
 template<typename PackageUniverse> class generic_solution;
+namespace aptitude { namespace apt { class resolver_plan; } }
 
 class aptitudeDepCache:public pkgDepCache, public sigc::trackable
 {
@@ -90,8 +97,18 @@ public:
     }
   };
 
+  /** \brief A version string stored once for the whole program. */
+  typedef interned<std::string> interned_version;
+
+  /** \brief A set of user tags stored once for the whole program. */
+  typedef interned<std::set<user_tag> > interned_user_tags;
+
   /** This structure augments the basic depCache state structure to
    *  support special aptitude features.
+   *
+   *  The strings and sets stored here are interned, so this
+   *  structure holds no memory of its own and an array of it can be
+   *  copied with memcpy(); the snapshots taken for undo rely on this.
    */
   struct aptitude_state
   {
@@ -100,7 +117,7 @@ public:
 
     /** Stores the version, if any, that the user explicitly selected.
      */
-    std::string candver;
+    interned_version candver;
 
     /** Stores the version, if any, which the user has forbidden
      *  aptitude to choose as an upgrade target.  (handles a situation
@@ -109,10 +126,10 @@ public:
      *
      *  If this string is empty, no "forbid" qualifier is in place.
      */
-    std::string forbidver;
+    interned_version forbidver;
 
     /** \brief Stores the tags attached to this package by the user. */
-    std::set<user_tag> user_tags;
+    interned_user_tags user_tags;
 
     /** If the package is going to be removed, this gives the reason
      *  for the removal.
@@ -250,6 +267,29 @@ public:
   {
     return user_tags[tag.tag_num];
   }
+
+  /** \brief Retrieve the number of distinct user tags that are known. */
+  std::size_t get_user_tag_count() const { return user_tags.size(); }
+
+  /** \brief Retrieve one of the known user tags.
+   *
+   *  \param n  The index of the tag; must be less than
+   *             get_user_tag_count().
+   */
+  user_tag get_user_tag(std::size_t n) const
+  {
+    return user_tag(n);
+  }
+
+  /** \brief Retrieve the IDs of the packages that a tag is attached
+   *  to.
+   *
+   *  The index is built the first time it's needed and then kept up
+   *  to date as tags are attached and detached, so matching a tag
+   *  against every package is a lookup rather than a walk over each
+   *  package's tags.
+   */
+  const std::set<unsigned long> &get_user_tag_packages(const user_tag &tag);
 private:
   void parse_user_tags(std::set<user_tag> &tags,
 		       const char *&start, const char *end,
@@ -268,6 +308,11 @@ private:
   std::vector<std::string> user_tags;
   // Stores the reference corresponding to each string.
   std::map<std::string, user_tag_reference> user_tags_index;
+  // The IDs of the packages that each tag is attached to, indexed by
+  // the tag's reference.  Rebuilt on demand when user_tag_packages_stale
+  // is set.
+  std::vector<std::set<unsigned long> > user_tag_packages;
+  bool user_tag_packages_stale;
   // Read a set of user tags from the given string region
   // and write the tags into the index and into the given
   // set of tags.
@@ -285,9 +330,58 @@ private:
 
   apt_state_snapshot backup_state;
   // Stores what the cache was like just before an action was performed
+  //
+  // This is refreshed with a full copy at the end of each action
+  // group rather than by tracking what changed: libapt writes
+  // PkgState and DepState directly, so there is nowhere to hook in
+  // dirty tracking, and cleanup_after_change() has to walk every
+  // package to find the changes anyway.  The undo history itself
+  // only stores the packages that changed (see state_restorer()).
 
   pkgRecords *records;
 
+  /** \brief The snapshot of the package states published at the end
+   *  of the last action group.
+   */
+  aptitude::apt::package_state_snapshot_ptr state_snapshot;
+
+  /** \brief Protects state_snapshot, which background threads read. */
+  mutable cwidget::threads::mutex state_snapshot_mutex;
+
+  /** \brief Publish a new snapshot of the package states.
+   *
+   *  Unchanged parts of the previous snapshot are shared with the new
+   *  one.
+   */
+  void publish_state_snapshot();
+
+  /** \brief Incremented before every change to the package states. */
+  unsigned long state_generation;
+
+  /** \brief The action state of each package, as find_pkg_state()
+   *  computes it when broken packages are ignored.
+   *
+   *  Rebuilt whenever a snapshot is published; it describes the
+   *  current states only while action_states_generation equals
+   *  state_generation.  The table is never written outside those
+   *  rebuilds, so background threads can read it.
+   */
+  std::vector<signed char> action_states;
+  unsigned long action_states_generation;
+
+  void bump_state_generation()
+  {
+    ++state_generation;
+  }
+
+  /** \brief Recompute action_states from the current package states. */
+  void rebuild_action_states();
+
+  /** The solvers of each dependency, or NULL if no resolver has been
+   *  created for this cache yet.
+   */
+  aptitude_resolver_dep_table *resolver_dep_table;
+
   /** Call whenever the cache state is modified; discards the
    *  state of the active resolver.
    *
@@ -329,6 +423,13 @@ private:
   void internal_mark_delete(const PkgIterator &Pkg, bool Purge, bool unused_delete);
   void internal_mark_keep(const PkgIterator &Pkg, bool Automatic, bool SetHold);
 
+  /** Select one version from a solution or a resolver plan: install
+   *  ver, or remove pkg if ver is an end iterator.
+   */
+  void apply_solution_version(const PkgIterator &pkg,
+			      const VerIterator &ver,
+			      bool is_auto);
+
   /** Handle changing package states to take into account the garbage
    *  collector's output.  Uses the core pkgDepCache methods.
    */
@@ -351,6 +452,54 @@ public:
 
   pkgRecords &get_records() { return *records; }
 
+  /** \brief Get the most recently published snapshot of the package
+   *  states.
+   *
+   *  A snapshot is published when the cache is initialized and at
+   *  the end of every action group.  This may be invoked from any
+   *  thread, and the snapshot it returns can be read from any thread
+   *  without further locking; it doesn't change when the cache does.
+   */
+  aptitude::apt::package_state_snapshot_ptr get_state_snapshot() const;
+
+  /** \brief Look up a package's action state in the table built at
+   *  the end of the last action group.
+   *
+   *  This is how find_pkg_state() avoids reclassifying every package
+   *  it's asked about.
+   *
+   *  \param pkg  The package to look up.
+   *  \param out  Set to the package's pkg_action_state, ignoring
+   *              whether it's broken, if the lookup succeeds.
+   *
+   *  \return \b false if the package states might have changed since
+   *  the table was built.
+   */
+  bool get_cached_action_state(const PkgIterator &pkg, int &out) const
+  {
+    if(action_states_generation != state_generation)
+      return false;
+
+    out = action_states[pkg->ID];
+    return true;
+  }
+
+  /** \brief Build the resolver's table of dependency solvers, if it
+   *  has not been built already.
+   *
+   *  This must be called from the thread that owns the cache, before
+   *  the table is used by a resolver running in the background.
+   */
+  void build_resolver_dep_table();
+
+  /** \return the resolver's table of dependency solvers, or NULL if
+   *  it has not been built.
+   */
+  const aptitude_resolver_dep_table *get_resolver_dep_table() const
+  {
+    return resolver_dep_table;
+  }
+
   // If do_initselections is "false", the "sticky states" will not be used
   // to initialize packages.  (important for the command-line mode)
   bool build_selection_list(OpProgress &Prog, bool WithLock,
@@ -459,6 +608,27 @@ public:
   void detach_user_tag(const PkgIterator &pkg, const std::string &tag,
 		       undo_group *undo);
 
+  /** \brief Attach a tag to each of a list of packages.
+   *
+   *  This has the same effect as calling attach_user_tag() on each
+   *  package, but adds a single item to the undo group, which
+   *  removes the tag from every package that didn't already have
+   *  it.
+   */
+  void attach_user_tag(const std::vector<PkgIterator> &pkgs,
+		       const std::string &tag,
+		       undo_group *undo);
+
+  /** \brief Remove a tag from each of a list of packages.
+   *
+   *  This has the same effect as calling detach_user_tag() on each
+   *  package, but adds a single item to the undo group, which
+   *  restores the tag on every package it was removed from.
+   */
+  void detach_user_tag(const std::vector<PkgIterator> &pkgs,
+		       const std::string &tag,
+		       undo_group *undo);
+
   // Marks the given package as having been autoinstalled (so it will be
   // removed automatically) or having been installed manually.
 
@@ -490,6 +660,24 @@ public:
   void apply_solution(const generic_solution<aptitude_universe> &solution,
 		      undo_group *undo);
 
+  /** \brief Apply a resolver plan that was saved on another system.
+   *
+   *  The plan is applied like a solution, but only if it is valid
+   *  for this cache: every package and version it refers to must
+   *  exist, and no packages may be broken once it is applied.  If
+   *  the plan is rejected, a warning saying why is pushed onto the
+   *  error stack and the cache is left as it was.
+   *
+   *  \param plan  the plan to apply.
+   *
+   *  \param undo  the undo group to which any undo actions
+   *               generated by applying the plan should be added.
+   *
+   *  \return \b true if the plan was applied.
+   */
+  bool apply_resolver_plan(const aptitude::apt::resolver_plan &plan,
+			   undo_group *undo);
+
   /** \return \b true if automatic aptitude upgrades should ignore this
    *  package.
    */
@@ -564,6 +752,15 @@ public:
 		  bool FromUser);
 
   virtual ~aptitudeDepCache();
+
+private:
+  /** \brief Report the package state tables and the snapshots of
+   *  them to a memory report.
+   */
+  void account_memory(aptitude::util::memory_report &report);
+
+  // Declared last so that it's destroyed first.
+  aptitude::util::memory_account account;
 };
 
 class pkgPolicy;
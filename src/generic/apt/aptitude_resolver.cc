@@ -19,9 +19,12 @@
 
 #include "aptitude_resolver.h"
 
+#include "apt.h"
+#include "cache_artifact.h"
 #include "config_signal.h"
 
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/error.h>
 #include <apt-pkg/policy.h>
 #include <apt-pkg/sptr.h>
@@ -39,6 +42,15 @@
 
 #include <loggers.h>
 
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <istream>
+#include <map>
+#include <ostream>
+
+using aptitude::apt::cache_artifact_reader;
+using aptitude::apt::cache_artifact_writer;
 using cwidget::util::ssprintf;
 
 namespace
@@ -51,13 +63,43 @@ namespace
   logging::LoggerPtr loggerScores(aptitude::Loggers::getAptitudeResolverScores());
   logging::LoggerPtr loggerCosts(aptitude::Loggers::getAptitudeResolverCosts());
 
+  /** \brief Test a version against the version selection of a hint.
+   *
+   *  Selections by archive are tested by looking up each of the
+   *  version's package files in archive_files, which lists the files
+   *  that belong to the selected archive, instead of comparing the
+   *  archive names.  Other selections are passed to matches().
+   */
+  bool version_selection_matches(const aptitude_resolver::hint::version_selection &selection,
+                                 const std::vector<bool> &archive_files,
+                                 const aptitude_resolver_version &ver)
+  {
+    if(selection.get_type() != aptitude_resolver::hint::version_selection::select_by_archive)
+      return selection.matches(ver);
+
+    if(ver.get_ver().end())
+      return false;
+
+    for(pkgCache::VerFileIterator vf = ver.get_ver().FileList();
+        !vf.end(); ++vf)
+      if(archive_files[vf.File()->ID])
+        return true;
+
+    return false;
+  }
+
   /** \brief If the given version is valid, find its maximum priority
    *  and return a raise-cost operation for that priority.
+   *
+   *  There are only a handful of distinct priorities in an archive,
+   *  so the operation for each one is built once and remembered in
+   *  priority_costs.
    */
   cost raise_priority_op(aptitude_resolver_cost_settings &settings,
                          const aptitude_resolver_version &ver,
                          pkgPolicy *policy,
-                         aptitude_resolver_cost_settings::component &priority_component)
+                         aptitude_resolver_cost_settings::component &priority_component,
+                         std::map<int, cost> &priority_costs)
   {
     if(!settings.is_component_relevant(priority_component))
       return cost_limits::minimum_cost;
@@ -75,8 +117,17 @@ namespace
 	  }
 
         if(apt_priority > INT_MIN)
-          return settings.raise_cost(priority_component,
-                                     -apt_priority);
+          {
+            std::map<int, cost>::iterator found =
+              priority_costs.lower_bound(apt_priority);
+            if(found == priority_costs.end() || found->first != apt_priority)
+              found = priority_costs.insert(found,
+                                            std::make_pair(apt_priority,
+                                                           settings.raise_cost(priority_component,
+                                                                               -apt_priority)));
+
+            return found->second;
+          }
         else
           return cost_limits::minimum_cost;
       }
@@ -272,14 +323,11 @@ bool aptitude_resolver::hint::version_selection::matches(const aptitude_resolver
       for(pkgCache::VerFileIterator vf = ver.get_ver().FileList();
 	  !vf.end(); ++vf)
 	{
-	  for(pkgCache::PkgFileIterator pf = vf.File();
-	      !pf.end(); ++pf)
+	  const pkgCache::PkgFileIterator pf = vf.File();
+	  if(pf.Archive() != NULL && pf.Archive() == version_selection_string)
 	    {
-	      if(pf.Archive() == version_selection_string)
-		{
-		  LOG_TRACE(loggerHintsMatch, *this << " matches " << ver);
-		  return true;
-		}
+	      LOG_TRACE(loggerHintsMatch, *this << " matches " << ver);
+	      return true;
 	    }
 	}
 
@@ -725,11 +773,16 @@ aptitude_resolver::aptitude_resolver(int step_score,
 					       initial_installations,
 					       aptitude_universe(cache)),
    policy(_policy),
-   cost_settings(_cost_settings)
+   cost_settings(_cost_settings),
+   num_promotions_at_load(0)
 {
   using cwidget::util::ref_ptr;
   using aptitude::matching::pattern;
 
+  // The resolver runs in a background thread, so the dependency
+  // table has to exist before it starts.
+  cache->build_resolver_dep_table();
+
   LOG_TRACE(loggerScores, "Setting up the resolver; score parameters: step_score = " << step_score
 	    << ", broken_score = " << broken_score << ", unfixed_soft_score = " << unfixed_soft_score
 	    << ", infinity = " << infinity << ", resolution_score = " << resolution_score
@@ -795,7 +848,7 @@ bool aptitude_resolver::is_break_hold(const aptitude_resolver::version &v) const
   const bool not_currently_installed = p.get_pkg().CurrentVer().end();
   const bool current_version = v == get_initial_state().version_of(p);
   const bool held_back = state.selection_state == pkgCache::State::Hold;
-  const bool forbidden = !v.get_ver().end() && state.forbidver == v.get_ver().VerStr();
+  const bool forbidden = !v.get_ver().end() && state.forbidver.get() == v.get_ver().VerStr();
 
   if(not_currently_installed)
     {
@@ -1207,6 +1260,25 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
     broken_holds_component = cost_settings.get_or_create_component("broken-holds", aptitude_resolver_cost_settings::additive),
     canceled_actions_component = cost_settings.get_or_create_component("canceled-actions", aptitude_resolver_cost_settings::additive);
 
+  // The cost of each kind of change is the same for every version, so
+  // build them once rather than combining fresh costs for each of the
+  // archive's versions.
+  const cost
+    current_version_cost(apply_cfg_level(safe_level, cost_settings, safety_component)
+                         + cost_settings.add_to_cost(canceled_actions_component, 1)),
+    removal_of_manual_cost(cost_settings.add_to_cost(removals_of_manual_component, 1)),
+    removal_cost(apply_cfg_level(remove_level, cost_settings, safety_component)
+                 + cost_settings.add_to_cost(removals_component, 1)),
+    install_cost(cost_settings.add_to_cost(installs_component, 1)),
+    upgrade_cost(cost_settings.add_to_cost(upgrades_component, 1)),
+    default_version_cost(apply_cfg_level(safe_level, cost_settings, safety_component)),
+    non_default_version_cost(apply_cfg_level(non_default_level, cost_settings, safety_component)
+                             + cost_settings.add_to_cost(non_default_versions_component, 1)),
+    break_hold_cost(apply_cfg_level(break_hold_level, cost_settings, safety_component)
+                    + cost_settings.add_to_cost(broken_holds_component, 1)),
+    remove_essential_cost(apply_cfg_level(remove_essential_level, cost_settings, safety_component));
+  std::map<int, cost> priority_costs;
+
   // Resolve the component of each hint into a side table (since hints
   // are supposed to be purely syntactic, it would be wrong to store
   // the component there when we can look it up here with little
@@ -1230,6 +1302,68 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
         }
     }
 
+  // Sort the hints by target, so that each package only looks at the
+  // hints that could apply to it.  Most hints name a single package;
+  // they're indexed by that name, so a package costs one lookup
+  // however many of them there are.  The remaining hints are grouped
+  // by their target, which is matched once per version for each
+  // group.  Hints on components that can't affect the solution cost
+  // are dropped here rather than for every version.
+  std::map<std::string, std::vector<std::size_t> > hints_by_name;
+  std::vector<std::vector<std::size_t> > hints_by_target;
+  for(std::vector<hint>::const_iterator it = hints.begin(); it != hints.end(); ++it)
+    {
+      const std::size_t idx = it - hints.begin();
+
+      switch(it->get_type())
+        {
+        case hint::add_to_cost_component:
+        case hint::raise_cost_component:
+          if(!cost_settings.is_component_relevant(hint_components[idx]))
+            continue;
+          break;
+
+        default:
+          break;
+        }
+
+      const cwidget::util::ref_ptr<aptitude::matching::pattern> &target(it->get_target());
+      if(target->get_type() == aptitude::matching::pattern::exact_name)
+        {
+          hints_by_name[target->get_exact_name_name()].push_back(idx);
+          continue;
+        }
+
+      std::vector<std::vector<std::size_t> >::iterator group_it = hints_by_target.begin();
+      while(group_it != hints_by_target.end() &&
+            aptitude::matching::compare_patterns(hints[group_it->front()].get_target(),
+                                                 target) != 0)
+        ++group_it;
+
+      if(group_it == hints_by_target.end())
+        hints_by_target.push_back(std::vector<std::size_t>(1, idx));
+      else
+        group_it->push_back(idx);
+    }
+
+  // Find the package files of each archive named by a hint once,
+  // since there are far fewer files than versions to test.
+  std::vector<std::vector<bool> > hint_archive_files(hints.size());
+  for(std::vector<hint>::const_iterator it = hints.begin(); it != hints.end(); ++it)
+    {
+      const hint::version_selection &selection(it->get_version_selection());
+      if(selection.get_type() != hint::version_selection::select_by_archive)
+        continue;
+
+      std::vector<bool> &files(hint_archive_files[it - hints.begin()]);
+      files.resize(cache->Head().PackageFileCount, false);
+      for(pkgCache::PkgFileIterator pf = cache->GetCache().FileBegin();
+          !pf.end(); ++pf)
+        if(pf.Archive() != NULL &&
+           pf.Archive() == selection.get_version_selection_string())
+          files[pf->ID] = true;
+    }
+
   // Should I stick with APT iterators instead?  This is a bit more
   // convenient, though..
   for(aptitude_universe::package_iterator pi = get_universe().packages_begin();
@@ -1237,7 +1371,12 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
     {
       const aptitude_universe::package &p=*pi;
       aptitudeDepCache::aptitude_state &state=cache->get_ext_state(p.get_pkg());
+      const std::map<std::string, std::vector<std::size_t> >::const_iterator
+        hints_by_name_found(hints_by_name.empty()
+                            ? hints_by_name.end()
+                            : hints_by_name.find(p.get_pkg().Name()));
       pkgDepCache::StateCache &apt_state = (*cache)[p.get_pkg()];
+      const pkgCache::VerIterator candidate_ver(apt_state.CandidateVerIter(*cache));
 
       // Packages are considered "manual" either if they were manually
       // installed, or if they are currently installed and were
@@ -1296,49 +1435,66 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 
 	  pkgCache::VerIterator apt_ver(v.get_ver());
 
-	  // Apply resolver hints.
-	  for(std::vector<hint>::const_iterator it = hints.begin();
-	      it != hints.end(); ++it)
+	  // Apply resolver hints.  Collect the hints that match v, then
+	  // apply them in the order they were given.
+	  std::vector<std::size_t> matched_hints;
+
+	  if(hints_by_name_found != hints_by_name.end())
+	    for(std::vector<std::size_t>::const_iterator it =
+		  hints_by_name_found->second.begin();
+		it != hints_by_name_found->second.end(); ++it)
+	      {
+		if(version_selection_matches(hints[*it].get_version_selection(),
+					     hint_archive_files[*it], v))
+		  matched_hints.push_back(*it);
+	      }
+
+	  for(std::vector<std::vector<std::size_t> >::const_iterator
+		group_it = hints_by_target.begin();
+	      group_it != hints_by_target.end(); ++group_it)
 	    {
-	      const hint &h(*it);
-              const aptitude_resolver_cost_settings::component
-                &component = hint_components[it - hints.begin()];
-
-              // Bypass hints that are irrelevant.
-              switch(h.get_type())
-                {
-                case hint::add_to_cost_component:
-                case hint::raise_cost_component:
-                  if(!cost_settings.is_component_relevant(component))
-                    continue;
-                  break;
-
-                default:
-                  break;
-                }
-
-	      using aptitude::matching::get_match;
+	      // Check the version selections first, since they're
+	      // quicker than the target test.
+	      const std::size_t num_matched_before = matched_hints.size();
+	      for(std::vector<std::size_t>::const_iterator it =
+		    group_it->begin(); it != group_it->end(); ++it)
+		{
+		  if(version_selection_matches(hints[*it].get_version_selection(),
+					       hint_archive_files[*it], v))
+		    matched_hints.push_back(*it);
+		}
 
-	      // Check the version selection.  This is quicker than
-	      // the target test, so we do it first.
-	      if(!h.get_version_selection().matches(v))
+	      if(matched_hints.size() == num_matched_before)
 		continue;
 
-	      // Now check the target.
+	      using aptitude::matching::has_match;
+
+	      // Every hint in the group has the same target, so it's
+	      // only tested once.
+	      const cwidget::util::ref_ptr<aptitude::matching::pattern> &
+		target(hints[group_it->front()].get_target());
+	      bool target_matches;
 	      if(apt_ver.end())
-		{
-		  if(!get_match(h.get_target(), p.get_pkg(),
-				search_info, *cache,
-				records).valid())
-		    continue;
-		}
+		target_matches = has_match(target, p.get_pkg(),
+					   search_info, *cache,
+					   records);
 	      else
-		{
-		  if(!get_match(h.get_target(), p.get_pkg(), v.get_ver(),
-				search_info, *cache,
-				records).valid())
-		    continue;
-		}
+		target_matches = has_match(target, p.get_pkg(), v.get_ver(),
+					   search_info, *cache,
+					   records);
+
+	      if(!target_matches)
+		matched_hints.resize(num_matched_before);
+	    }
+
+	  std::sort(matched_hints.begin(), matched_hints.end());
+
+	  for(std::vector<std::size_t>::const_iterator it = matched_hints.begin();
+	      it != matched_hints.end(); ++it)
+	    {
+	      const hint &h(hints[*it]);
+              const aptitude_resolver_cost_settings::component
+                &component = hint_components[*it];
 
 	      // OK, apply the hint.
 	      switch(h.get_type())
@@ -1391,7 +1547,8 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
           if(v != initial_state.version_of(p))
             modify_version_cost(v, raise_priority_op(cost_settings,
                                                      v, policy,
-                                                     priority_component));
+                                                     priority_component,
+                                                     priority_costs));
 
 	  // Remember, the initial version is the InstVer.
 	  if(v == initial_state.version_of(p))
@@ -1427,9 +1584,7 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 		  add_version_score(v, keep_score);
 		}
 
-              modify_version_cost(v,
-                                  apply_cfg_level(safe_level, cost_settings, safety_component)
-                                  + cost_settings.add_to_cost(canceled_actions_component, 1));
+              modify_version_cost(v, current_version_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << safe_level << " for " << v
 			<< " because it is the currently installed version of a package  (" PACKAGE "::ProblemResolver::Safe-Level)");
@@ -1443,18 +1598,15 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 			    << std::noshowpos << " for " << v
 			    << " because it represents the removal of a manually installed package  (" PACKAGE "::ProblemResolver::RemoveScore).");
 		  add_version_score(v, remove_score);
-                  modify_version_cost(v,
-                                      cost_settings.add_to_cost(removals_of_manual_component, 1));
+                  modify_version_cost(v, removal_of_manual_cost);
 		}
 
-              modify_version_cost(v,
-                                  apply_cfg_level(remove_level, cost_settings, safety_component)
-                                  + cost_settings.add_to_cost(removals_component, 1));
+              modify_version_cost(v, removal_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << remove_level << " for " << v
 			<< " because it represents the removal of a package (" PACKAGE "::ProblemResolver::Removal-Level)");
 	    }
-	  else if(apt_ver == (*cache)[p.get_pkg()].CandidateVerIter(*cache))
+	  else if(apt_ver == candidate_ver)
 	    {
 	      if(manual)
 		{
@@ -1466,7 +1618,7 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 				<< std::noshowpos << " for " << v
 				<< " because it is a new install (" PACKAGE "::ProblemResolver::InstallScore).");
 		      add_version_score(v, install_score);
-                      modify_version_cost(v, cost_settings.add_to_cost(installs_component, 1));
+                      modify_version_cost(v, install_cost);
 		    }
 		  else
 		    {
@@ -1475,12 +1627,11 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 				<< std::noshowpos << " for " << v
 				<< " because it is an upgrade (" PACKAGE "::ProblemResolver::UpgradeScore).");
 		      add_version_score(v, upgrade_score);
-                      modify_version_cost(v, cost_settings.add_to_cost(upgrades_component, 1));
+                      modify_version_cost(v, upgrade_cost);
 		    }
 		}
 
-              modify_version_cost(v,
-                                  apply_cfg_level(safe_level, cost_settings, safety_component));
+              modify_version_cost(v, default_version_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << safe_level << " for " << v
 			<< " because it is the default install version of a package (" PACKAGE "::ProblemResolver::Safe-Level).");
@@ -1499,9 +1650,7 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 			<< " because it is a non-default version (" PACKAGE "::ProblemResolver::NonDefaultScore).");
 	      add_version_score(v, non_default_score);
 
-              modify_version_cost(v,
-                                  apply_cfg_level(non_default_level, cost_settings, safety_component)
-                                  + cost_settings.add_to_cost(non_default_versions_component, 1));
+              modify_version_cost(v, non_default_version_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << non_default_level << " for " << v
 			<< " because it is a non-default version (" PACKAGE "::ProblemResolver::Non-Default-Level).");
@@ -1523,9 +1672,7 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 		  reject_version(v);
 		}
 
-              modify_version_cost(v,
-                                  apply_cfg_level(break_hold_level, cost_settings, safety_component)
-                                  + cost_settings.add_to_cost(broken_holds_component, 1));
+              modify_version_cost(v, break_hold_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << break_hold_level << " for " << v
 			<< " because it breaks a hold/forbid (" PACKAGE "::ProblemResolver::Break-Hold-Level).");
@@ -1546,8 +1693,7 @@ void aptitude_resolver::add_action_scores(int preserve_score, int auto_score,
 			"** Rejecting " << v << " because it represents removing an essential package.");
 	      reject_version(v);
 
-              modify_version_cost(v,
-                                  apply_cfg_level(remove_essential_level, cost_settings, safety_component));
+              modify_version_cost(v, remove_essential_cost);
 	      LOG_DEBUG(loggerCosts,
 			"** Safety level raised to at least " << remove_essential_level << " for " << v
 			<< " because it represents removing an essential package.");
@@ -1703,3 +1849,299 @@ void aptitude_resolver::add_priority_scores(int important,
 	add_version_score(*vi, score_tweak);
       }
 }
+
+namespace
+{
+  const char promotions_magic[] = "aptitude-promotions 1";
+
+  std::string get_promotions_path()
+  {
+    return aptcfg->Find(PACKAGE "::ProblemResolver::Promotions-File",
+			(_config->FindDir("Dir::Cache") + "aptitude-promotions").c_str());
+  }
+
+  void hash_config_tree(std::size_t &hash, const Configuration::Item *itm)
+  {
+    for( ; itm != NULL; itm = itm->Next)
+      {
+	boost::hash_combine(hash, itm->FullTag());
+	boost::hash_combine(hash, itm->Value);
+	hash_config_tree(hash, itm->Child);
+      }
+  }
+
+  // Promotions are saved as offsets into the cache's arrays; the
+  // fingerprint guarantees that they refer to the same cache, but
+  // check that they're in range anyway in case the file is damaged.
+  template<typename T>
+  bool in_cache(pkgCache &pcache, const T *base, unsigned long index)
+  {
+    return index != 0 &&
+      reinterpret_cast<const char *>(base + index + 1) <=
+      static_cast<const char *>(pcache.DataEnd());
+  }
+
+  void write_version(std::ostream &out, const aptitude_resolver_version &v)
+  {
+    if(v.get_ver().end())
+      out << 'r' << v.get_pkg().Index();
+    else
+      out << 'i' << v.get_ver().Index();
+  }
+
+  bool read_version(std::istream &in, aptitudeDepCache *cache,
+		    aptitude_resolver_version &out)
+  {
+    pkgCache &pcache(cache->GetCache());
+    char tp;
+    unsigned long index;
+
+    if(!(in >> tp >> index))
+      return false;
+    else if(tp == 'r' && in_cache(pcache, pcache.PkgP, index))
+      {
+	out = aptitude_resolver_version::make_removal(pcache.PkgP + index, cache);
+	return true;
+      }
+    else if(tp == 'i' && in_cache(pcache, pcache.VerP, index))
+      {
+	out = aptitude_resolver_version::make_install(pcache.VerP + index, cache);
+	return true;
+      }
+    else
+      return false;
+  }
+
+  void write_dep(std::ostream &out, aptitudeDepCache *cache,
+		 const aptitude_resolver_dep &d)
+  {
+    const pkgCache::Provides * const prv = d.get_prv();
+
+    out << d.get_dep().Index() << ' '
+	<< (prv == NULL ? 0 : prv - cache->GetCache().ProvideP);
+  }
+
+  bool read_dep(std::istream &in, aptitudeDepCache *cache,
+		aptitude_resolver_dep &out)
+  {
+    pkgCache &pcache(cache->GetCache());
+    unsigned long dep_index, prv_index;
+
+    if(!(in >> dep_index >> prv_index))
+      return false;
+    else if(!in_cache(pcache, pcache.DepP, dep_index))
+      return false;
+    else if(prv_index != 0 && !in_cache(pcache, pcache.ProvideP, prv_index))
+      return false;
+    else
+      {
+	out = aptitude_resolver_dep(pcache.DepP + dep_index,
+				    prv_index == 0 ? NULL : pcache.ProvideP + prv_index,
+				    cache);
+	return true;
+      }
+  }
+
+  void write_choice(std::ostream &out, aptitudeDepCache *cache,
+		    const aptitude_resolver::choice &c)
+  {
+    switch(c.get_type())
+      {
+      case aptitude_resolver::choice::install_version:
+	if(c.get_from_dep_source())
+	  {
+	    out << "S ";
+	    write_version(out, c.get_ver());
+	    out << ' ';
+	    write_dep(out, cache, c.get_dep());
+	  }
+	else
+	  {
+	    out << "I ";
+	    write_version(out, c.get_ver());
+	  }
+	break;
+
+      case aptitude_resolver::choice::break_soft_dep:
+	out << "B ";
+	write_dep(out, cache, c.get_dep());
+	break;
+      }
+  }
+
+  bool read_choice(std::istream &in, aptitudeDepCache *cache,
+		   aptitude_resolver::choice &out)
+  {
+    char tp;
+    aptitude_resolver_version v;
+    aptitude_resolver_dep d;
+
+    if(!(in >> tp))
+      return false;
+
+    switch(tp)
+      {
+      case 'I':
+	if(!read_version(in, cache, v))
+	  return false;
+	out = aptitude_resolver::choice::make_install_version(v, 0);
+	return true;
+
+      case 'S':
+	if(!read_version(in, cache, v) || !read_dep(in, cache, d))
+	  return false;
+	out = aptitude_resolver::choice::make_install_version_from_dep_source(v, d, 0);
+	return true;
+
+      case 'B':
+	if(!read_dep(in, cache, d))
+	  return false;
+	out = aptitude_resolver::choice::make_break_soft_dep(d, 0);
+	return true;
+
+      default:
+	return false;
+      }
+  }
+}
+
+std::string aptitude_resolver::get_promotions_fingerprint() const
+{
+  if(!aptcfg->FindB(PACKAGE "::ProblemResolver::Persist-Promotions", true))
+    return std::string();
+
+  // Hints select their targets with search patterns, which can look
+  // at nearly anything about a package; don't try to tell whether
+  // their results changed.
+  const Configuration::Item * const hints =
+    aptcfg->Tree(PACKAGE "::ProblemResolver::Hints");
+  if(hints != NULL && hints->Child != NULL)
+    return std::string();
+
+  aptitudeDepCache * const cache(get_universe().get_cache());
+  const std::string cache_fingerprint = aptitude::apt::get_cache_fingerprint(*cache);
+  if(cache_fingerprint.empty())
+    return std::string();
+
+  std::size_t hash = 0;
+
+  const Configuration::Item * const settings =
+    aptcfg->Tree(PACKAGE "::ProblemResolver");
+  if(settings != NULL)
+    hash_config_tree(hash, settings->Child);
+  boost::hash_combine(hash, aptcfg->FindB("Apt::Install-Recommends", true));
+
+  // Everything else that decides which versions are discarded:
+  // the state the resolver starts from, the candidate versions
+  // (which depend on the pin settings) and holds and forbidden
+  // versions (which aren't stored in the cache).
+  for(pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg)
+    {
+      const aptitudeDepCache::aptitude_state &state(cache->get_ext_state(pkg));
+      const pkgCache::Version * const candidate = (*cache)[pkg].CandidateVer;
+
+      boost::hash_combine(hash, get_initial_state().version_of(package(pkg, cache)).get_id());
+      boost::hash_combine(hash, candidate == NULL ? 0 : candidate->ID);
+      boost::hash_combine(hash, state.selection_state == pkgCache::State::Hold);
+      boost::hash_combine(hash, state.forbidver.get());
+    }
+
+  return ssprintf("%s %lx", cache_fingerprint.c_str(), (unsigned long) hash);
+}
+
+void aptitude_resolver::load_persistent_promotions()
+{
+  logging::LoggerPtr logger(aptitude::Loggers::getAptitudeResolver());
+
+  promotions_fingerprint = get_promotions_fingerprint();
+  if(promotions_fingerprint.empty())
+    {
+      LOG_DEBUG(logger, "Not using persistent promotions for this resolver.");
+      return;
+    }
+
+  num_promotions_at_load = get_promotions().size();
+
+  const std::string path = get_promotions_path();
+  cache_artifact_reader reader(path, promotions_magic, promotions_fingerprint,
+			       "resolver's promotions", logger);
+  if(!reader.is_valid())
+    return;
+
+  std::istream &in(reader.get_stream());
+
+  aptitudeDepCache * const cache(get_universe().get_cache());
+  int num_loaded = 0;
+  unsigned int num_choices;
+  while(in >> num_choices)
+    {
+      choice_set choices;
+      bool ok = true;
+      for(unsigned int i = 0; ok && i < num_choices; ++i)
+	{
+	  choice c;
+	  ok = read_choice(in, cache, c);
+	  if(ok)
+	    choices.insert_or_narrow(c);
+	}
+
+      if(!ok)
+	{
+	  LOG_WARN(logger, "Ignoring the rest of " << path << ": it is damaged.");
+	  break;
+	}
+
+      add_promotion(choices, cost_limits::conflict_cost);
+      ++num_loaded;
+    }
+
+  LOG_DEBUG(logger, "Loaded " << num_loaded << " promotions from " << path);
+}
+
+void aptitude_resolver::save_persistent_promotions() const
+{
+  // If nothing was learned, don't replace the promotions that were
+  // saved for another problem.
+  if(promotions_fingerprint.empty() ||
+     get_promotions().size() == num_promotions_at_load)
+    return;
+
+  logging::LoggerPtr logger(aptitude::Loggers::getAptitudeResolver());
+
+  const std::string path = get_promotions_path();
+  aptitudeDepCache * const cache(get_universe().get_cache());
+  int num_saved = 0;
+
+  cache_artifact_writer writer(path, promotions_magic, promotions_fingerprint,
+			       "resolver's promotions", logger);
+  if(!writer.is_open())
+    return;
+
+  std::ostream &out(writer.get_stream());
+
+  const promotion_set &promotions(get_promotions());
+  for(promotion_set::const_iterator it = promotions.begin();
+      it != promotions.end(); ++it)
+    {
+      // Other promotions depend on the user's rejections and
+      // mandates, or on the solutions that were already returned.
+      if(it->get_cost() != cost_limits::conflict_cost ||
+	 it->get_valid_condition().valid())
+	continue;
+
+      const choice_set &choices(it->get_choices());
+      out << choices.size();
+      for(choice_set::const_iterator cit = choices.begin();
+	  cit != choices.end(); ++cit)
+	{
+	  out << ' ';
+	  write_choice(out, cache, *cit);
+	}
+      out << '\n';
+
+      ++num_saved;
+    }
+
+  if(writer.commit())
+    LOG_DEBUG(logger, "Saved " << num_saved << " promotions to " << path);
+}
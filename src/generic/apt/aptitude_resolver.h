@@ -67,6 +67,18 @@ class aptitude_resolver:public generic_problem_resolver<aptitude_universe>
 
   aptitude_resolver_cost_settings cost_settings;
 
+  /** \brief The problem that persistent promotions are saved for,
+   *  or an empty string if they shouldn't be saved.
+   */
+  std::string promotions_fingerprint;
+
+  /** \brief The number of promotions the resolver had before any
+   *  were loaded.
+   */
+  promotion_set::size_type num_promotions_at_load;
+
+  std::string get_promotions_fingerprint() const;
+
   void add_full_replacement_score(const pkgCache::VerIterator &src,
 				  const pkgCache::PkgIterator &real_target,
 				  const pkgCache::VerIterator &provider,
@@ -546,6 +558,27 @@ public:
    *  all of the user's planned actions.
    */
   choice_set get_keep_all_solution() const;
+
+  /** \brief Load the promotions that an earlier resolver saved for
+   *  the same problem.
+   *
+   *  The problem is identified by the package cache, the resolver
+   *  configuration and the initial state of every package; saved
+   *  promotions are ignored unless all of these match.  This should
+   *  be called once the resolver's scores and costs are set up and
+   *  before it starts searching.
+   */
+  void load_persistent_promotions();
+
+  /** \brief Save the promotions that this resolver has learned, so
+   *  that a later resolver for the same problem can start with them.
+   *
+   *  Only conflicts that don't depend on the user's rejections and
+   *  mandates are saved.  Does nothing unless
+   *  load_persistent_promotions() was called first.  This must not
+   *  be called while the resolver is running.
+   */
+  void save_persistent_promotions() const;
 };
 
 std::ostream &operator<<(std::ostream &out, const aptitude_resolver::hint &hint);
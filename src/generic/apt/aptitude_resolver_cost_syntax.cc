@@ -42,9 +42,10 @@ namespace
     {
       typedef cost_component_structure::entry result_type;
 
-      result_type operator()(int scaling_factor, const boost::shared_ptr<std::string> &name) const
+      result_type operator()(int scaling_factor,
+                             const boost::iterator_range<std::string::const_iterator> &name) const
       {
-        return result_type(*name, scaling_factor);
+        return result_type(std::string(name.begin(), name.end()), scaling_factor);
       }
     };
 
@@ -62,7 +63,7 @@ namespace
 
       return apply(make_entry(),
                    (  ( (lexeme(integer()) << lexeme(ch('*'))) | val(1) ) << notFollowedBy(str("max")),
-                      container(std::string(), lexeme(alpha() + many(alnum() | ch('-') | ch('_'))))  )).parse(input);
+                      lexeme(slice(alpha() + many(alnum() | ch('-') | ch('_'))))  )).parse(input);
     }
 
     void get_expected(std::ostream &out) const
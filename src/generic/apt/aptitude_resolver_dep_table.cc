@@ -0,0 +1,70 @@
+// aptitude_resolver_dep_table.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "aptitude_resolver_dep_table.h"
+
+#include "apt.h"
+
+#include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/version.h>
+
+aptitude_resolver_dep_table::aptitude_resolver_dep_table(pkgDepCache &cache)
+  : solvers_first(cache.Head().DependsCount, 0),
+    solvers_last(cache.Head().DependsCount, 0)
+{
+  for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+    for(pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver)
+      {
+	bool or_start = true;
+
+	for(pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep)
+	  {
+	    const bool starts_group = or_start;
+	    or_start = !(dep->CompareOp & pkgCache::Dep::Or);
+
+	    if(!starts_group || is_conflict(dep->Type))
+	      continue;
+
+	    solvers_first[dep->ID] = solvers.size();
+
+	    // These are exactly the versions that broken_under() looks
+	    // for: target versions that match the version constraint,
+	    // and for unversioned dependencies, the providers.
+	    for(pkgCache::DepIterator elt = dep; !elt.end(); ++elt)
+	      {
+		for(pkgCache::VerIterator target = elt.TargetPkg().VersionList();
+		    !target.end(); ++target)
+		  if(_system->VS->CheckDep(target.VerStr(),
+					   elt->CompareOp,
+					   elt.TargetVer()))
+		    solvers.push_back(solver(target.ParentPkg(), target));
+
+		if(!elt.TargetVer())
+		  for(pkgCache::PrvIterator prv = elt.TargetPkg().ProvidesList();
+		      !prv.end(); ++prv)
+		    solvers.push_back(solver(prv.OwnerPkg(), prv.OwnerVer()));
+
+		if(!(elt->CompareOp & pkgCache::Dep::Or))
+		  break;
+	      }
+
+	    solvers_last[dep->ID] = solvers.size();
+	  }
+      }
+}
@@ -0,0 +1,89 @@
+// aptitude_resolver_dep_table.h                    -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_RESOLVER_DEP_TABLE_H
+#define APTITUDE_RESOLVER_DEP_TABLE_H
+
+#include <apt-pkg/depcache.h>
+#include <apt-pkg/pkgcache.h>
+
+#include <vector>
+
+/** \brief A flat table of the versions that satisfy each
+ *  non-conflict dependency in the package cache.
+ *
+ *  Testing whether a Depends is broken means walking each element
+ *  of its OR group, comparing the version string of each target
+ *  version against the dependency and then walking the Provides of
+ *  the target package.  The resolver does this for every dependency
+ *  it touches on every step, so the table does that work once: the
+ *  solvers of each OR group are stored in a single array, and the
+ *  entries for a group are found by the ID of its first element.
+ *
+ *  The table only depends on the structure of the cache, not on its
+ *  state, so it remains valid until the cache is reloaded.
+ */
+class aptitude_resolver_dep_table
+{
+public:
+  /** \brief A version that satisfies a dependency. */
+  struct solver
+  {
+    const pkgCache::Package *pkg;
+    const pkgCache::Version *ver;
+
+    solver(const pkgCache::Package *_pkg,
+	   const pkgCache::Version *_ver)
+      : pkg(_pkg), ver(_ver)
+    {
+    }
+  };
+
+private:
+  /** \brief The solvers of every dependency, grouped by dependency. */
+  std::vector<solver> solvers;
+
+  /** \brief Indexed by dependency ID: the range of solvers that
+   *  belongs to the OR group starting at that dependency.
+   *
+   *  Entries for conflicts and for dependencies that are not at the
+   *  start of an OR group are empty.
+   */
+  std::vector<unsigned int> solvers_first, solvers_last;
+
+public:
+  /** \brief Build the table for every dependency in the given cache. */
+  explicit aptitude_resolver_dep_table(pkgDepCache &cache);
+
+  /** \return the first solver of the OR group that starts at dep. */
+  const solver *solvers_begin(const pkgCache::Dependency *dep) const
+  {
+    return solvers.empty() ? NULL : &solvers.front() + solvers_first[dep->ID];
+  }
+
+  /** \return the end of the solvers of the OR group that starts at
+   *  dep.
+   */
+  const solver *solvers_end(const pkgCache::Dependency *dep) const
+  {
+    return solvers.empty() ? NULL : &solvers.front() + solvers_last[dep->ID];
+  }
+};
+
+#endif // APTITUDE_RESOLVER_DEP_TABLE_H
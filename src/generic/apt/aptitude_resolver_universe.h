@@ -30,6 +30,7 @@
 
 #include "apt.h"
 #include "aptcache.h"
+#include "aptitude_resolver_dep_table.h"
 
 #include <generic/problemresolver/cost.h>
 
@@ -978,6 +979,24 @@ bool aptitude_resolver_dep::broken_under(const InstallationType &I) const
 
   if(!is_conflict(start->Type))
     {
+      // Every dependency in the resolver's universe belongs to an
+      // aptitudeDepCache.
+      const aptitude_resolver_dep_table *table =
+	static_cast<const aptitudeDepCache *>(cache)->get_resolver_dep_table();
+
+      if(table != NULL)
+	{
+	  pkgCache &pcache(cache->GetCache());
+
+	  for(const aptitude_resolver_dep_table::solver *it = table->solvers_begin(start),
+		*end = table->solvers_end(start); it != end; ++it)
+	    if(I.version_of(aptitude_resolver_package(it->pkg, cache)).get_ver() ==
+	       pkgCache::VerIterator(pcache, const_cast<pkgCache::Version *>(it->ver)))
+	      return false;
+
+	  return true;
+	}
+
       pkgCache::DepIterator dep = start_iter;
 
       while(!dep.end())
@@ -19,6 +19,29 @@
 #include <apt-pkg/pkgcache.h>
 #include <apt-pkg/error.h>
 
+aptitudePolicy::aptitudePolicy(pkgCache *Owner)
+  : pkgPolicy(Owner),
+    candidates(Owner->Head().PackageCount),
+    candidate_cached(Owner->Head().PackageCount, false)
+{
+}
+
+pkgCache::VerIterator aptitudePolicy::GetCandidateVer(pkgCache::PkgIterator const &Pkg)
+{
+  if(!candidate_cached[Pkg->ID])
+    {
+      candidates[Pkg->ID] = pkgPolicy::GetCandidateVer(Pkg);
+      candidate_cached[Pkg->ID] = true;
+    }
+
+  return pkgCache::VerIterator(*Cache, candidates[Pkg->ID]);
+}
+
+void aptitudePolicy::invalidate_candidates()
+{
+  candidate_cached.assign(candidate_cached.size(), false);
+}
+
 bool aptitudePolicy::IsImportantDep(pkgCache::DepIterator dep)
 {
   return pkgPolicy::IsImportantDep(dep);
@@ -12,6 +12,8 @@
 
 #include <apt-pkg/policy.h>
 
+#include <vector>
+
 /** \brief A policy class that allows Recommends and Suggests to be treated as
  *  "always important", "important for new installs", or "never important".
  * 
@@ -20,9 +22,31 @@
 
 class aptitudePolicy:public pkgPolicy
 {
+  /** \brief The candidate of each package, indexed by package ID.
+   *
+   *  Choosing a candidate means looking up the pin of every file of
+   *  every version of the package, and the depcache asks for the
+   *  candidate of a package each time it is marked for installation.
+   *  The pins don't change once the pin files have been read, so the
+   *  answer is remembered here.
+   */
+  std::vector<pkgCache::Version *> candidates;
+
+  /** \brief \b true for each package whose entry in candidates is
+   *  valid.
+   */
+  std::vector<bool> candidate_cached;
+
 public:
-  aptitudePolicy(pkgCache *Owner)
-    :pkgPolicy(Owner) {}
+  aptitudePolicy(pkgCache *Owner);
+
+  pkgCache::VerIterator GetCandidateVer(pkgCache::PkgIterator const &Pkg);
+
+  /** \brief Forget the candidates computed so far.
+   *
+   *  This must be called whenever the pins change.
+   */
+  void invalidate_candidates();
 
   bool IsImportantDep(pkgCache::DepIterator dep);
 };
@@ -0,0 +1,118 @@
+// cache_artifact.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "cache_artifact.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    cache_artifact_reader::cache_artifact_reader(const std::string &path,
+						 const std::string &magic,
+						 const std::string &fingerprint,
+						 const std::string &description,
+						 const util::logging::LoggerPtr &logger,
+						 std::ios::openmode mode)
+      : in(path.c_str(), std::ios::in | mode),
+	valid(false)
+    {
+      if(!in)
+	{
+	  LOG_DEBUG(logger, "No " << description << " found at " << path);
+	  return;
+	}
+
+      std::string stored_magic, stored_fingerprint;
+      std::getline(in, stored_magic);
+      std::getline(in, stored_fingerprint);
+      if(!in || stored_magic != magic)
+	{
+	  LOG_WARN(logger, "Ignoring " << path << ": not a " << description << ".");
+	  return;
+	}
+      else if(stored_fingerprint != fingerprint)
+	{
+	  LOG_DEBUG(logger, "The " << description << " at " << path << " is out of date.");
+	  return;
+	}
+
+      valid = true;
+    }
+
+    cache_artifact_writer::cache_artifact_writer(const std::string &_path,
+						 const std::string &magic,
+						 const std::string &fingerprint,
+						 const std::string &_description,
+						 const util::logging::LoggerPtr &_logger,
+						 std::ios::openmode mode)
+      : path(_path),
+	tmp_path(_path + ".new"),
+	description(_description),
+	logger(_logger),
+	out(tmp_path.c_str(), std::ios::out | std::ios::trunc | mode),
+	committed(false)
+    {
+      if(!out)
+	{
+	  LOG_DEBUG(logger, "Can't write the " << description << " to " << tmp_path);
+	  return;
+	}
+
+      out << magic << '\n'
+	  << fingerprint << '\n';
+    }
+
+    cache_artifact_writer::~cache_artifact_writer()
+    {
+      if(!committed && out.is_open())
+	{
+	  out.close();
+	  unlink(tmp_path.c_str());
+	}
+    }
+
+    bool cache_artifact_writer::commit()
+    {
+      if(!out.is_open())
+	return false;
+
+      out.close();
+      if(!out)
+	{
+	  LOG_WARN(logger, "Failed to write the " << description << " to " << tmp_path);
+	  unlink(tmp_path.c_str());
+	  return false;
+	}
+
+      committed = true;
+
+      if(rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+	  LOG_WARN(logger, "Failed to move the " << description << " into place at " << path);
+	  unlink(tmp_path.c_str());
+	  return false;
+	}
+
+      return true;
+    }
+  }
+}
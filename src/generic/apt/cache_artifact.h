@@ -0,0 +1,130 @@
+/** \file cache_artifact.h */ // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef CACHE_ARTIFACT_H
+#define CACHE_ARTIFACT_H
+
+#include <generic/util/logging.h>
+
+#include <fstream>
+#include <string>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief Read a file that was computed from the package cache.
+     *
+     *  Cache artifacts begin with two lines: a magic string that
+     *  identifies the kind of file, and the fingerprint of whatever
+     *  the contents were computed from (usually derived from
+     *  get_cache_fingerprint()).  A file whose magic string or
+     *  fingerprint doesn't match the expected one is ignored, so
+     *  artifacts are invalidated automatically when the cache
+     *  changes.
+     *
+     *  The reader's stream is positioned just after the header.
+     */
+    class cache_artifact_reader
+    {
+      std::ifstream in;
+      bool valid;
+
+      // Not copyable.
+      cache_artifact_reader(const cache_artifact_reader &);
+      cache_artifact_reader &operator=(const cache_artifact_reader &);
+
+    public:
+      /** \brief Open a cache artifact and check its header.
+       *
+       *  \param path         The file to read.
+       *  \param magic        The expected first line, without a newline.
+       *  \param fingerprint  The expected second line.
+       *  \param description  What the file contains, for log messages
+       *                      (e.g., "description index").
+       *  \param logger       Where to log why the file was rejected.
+       *  \param mode         Extra flags to open the file with.
+       */
+      cache_artifact_reader(const std::string &path,
+			    const std::string &magic,
+			    const std::string &fingerprint,
+			    const std::string &description,
+			    const util::logging::LoggerPtr &logger,
+			    std::ios::openmode mode = std::ios::openmode());
+
+      /** \return \b true if the file exists and its header matched. */
+      bool is_valid() const { return valid; }
+
+      /** \return the stream to read the body of the file from. */
+      std::istream &get_stream() { return in; }
+    };
+
+    /** \brief Write a file that was computed from the package cache.
+     *
+     *  The file is written next to its final location and renamed into
+     *  place by commit(), so a reader never sees a partial file.  If
+     *  the writer is destroyed without being committed, or if writing
+     *  failed, the temporary file is removed and the old artifact (if
+     *  any) is left alone.
+     */
+    class cache_artifact_writer
+    {
+      std::string path;
+      std::string tmp_path;
+      std::string description;
+      util::logging::LoggerPtr logger;
+      std::ofstream out;
+      bool committed;
+
+      // Not copyable.
+      cache_artifact_writer(const cache_artifact_writer &);
+      cache_artifact_writer &operator=(const cache_artifact_writer &);
+
+    public:
+      /** \brief Start writing a cache artifact, beginning with its
+       *  header.
+       *
+       *  The parameters are as for cache_artifact_reader.
+       */
+      cache_artifact_writer(const std::string &path,
+			    const std::string &magic,
+			    const std::string &fingerprint,
+			    const std::string &description,
+			    const util::logging::LoggerPtr &logger,
+			    std::ios::openmode mode = std::ios::openmode());
+
+      ~cache_artifact_writer();
+
+      /** \return \b true if the temporary file could be opened. */
+      bool is_open() const { return out.is_open(); }
+
+      /** \return the stream to write the body of the file to. */
+      std::ostream &get_stream() { return out; }
+
+      /** \brief Finish writing the file and move it into place.
+       *
+       *  \return \b true if the file was written and renamed
+       *  successfully.
+       */
+      bool commit();
+    };
+  }
+}
+
+#endif // CACHE_ARTIFACT_H
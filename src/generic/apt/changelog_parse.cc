@@ -24,12 +24,18 @@
 
 #include "apt.h"
 #include "desc_render.h"
+#include <loggers.h>
 
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/tagfile.h>
 #include <apt-pkg/strutl.h>
 
+#include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/version.h>
+
+#include <ctype.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include <generic/util/temp.h>
 
@@ -38,6 +44,7 @@
 #include <cwidget/generic/util/transcode.h>
 
 #include <generic/util/file_cache.h>
+#include <generic/util/logging.h>
 #include <generic/util/job_queue_thread.h>
 #include <generic/util/util.h>
 
@@ -351,9 +358,552 @@ namespace aptitude
       return parse_digested_changelog(digested);
     }
 
+    namespace
+    {
+      bool is_blank(const std::string &s)
+      {
+	for(std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+	  if(!isspace(*it))
+	    return false;
+
+	return true;
+      }
+
+      std::string trim(const std::string &s)
+      {
+	std::string::size_type first = 0;
+	while(first < s.size() && isspace(s[first]))
+	  ++first;
+
+	std::string::size_type last = s.size();
+	while(last > first && isspace(s[last - 1]))
+	  --last;
+
+	return std::string(s, first, last - first);
+      }
+
+      /** \brief Parse the first line of a changelog entry, which
+       *  looks like "source (version) distribution; urgency=low".
+       */
+      bool parse_changelog_header(const std::string &line,
+				  std::string &source,
+				  std::string &version,
+				  std::string &distribution,
+				  std::string &urgency)
+      {
+	if(line.empty() || !isalnum(line[0]))
+	  return false;
+
+	const std::string::size_type source_end = line.find(' ');
+	if(source_end == std::string::npos ||
+	   source_end + 1 >= line.size() || line[source_end + 1] != '(')
+	  return false;
+
+	const std::string::size_type version_end = line.find(')', source_end);
+	if(version_end == std::string::npos)
+	  return false;
+
+	const std::string::size_type semicolon = line.find(';', version_end);
+	if(semicolon == std::string::npos)
+	  return false;
+
+	source.assign(line, 0, source_end);
+	version.assign(line, source_end + 2, version_end - source_end - 2);
+	distribution = trim(std::string(line, version_end + 1, semicolon - version_end - 1));
+
+	if(version.empty() || version.find_first_of(" \t") != std::string::npos ||
+	   distribution.empty())
+	  return false;
+
+	urgency.clear();
+	const std::string::size_type urgency_begin = line.find("urgency=", semicolon);
+	if(urgency_begin != std::string::npos)
+	  {
+	    std::string::size_type urgency_end = urgency_begin + 8;
+	    while(urgency_end < line.size() &&
+		  line[urgency_end] != ',' && !isspace(line[urgency_end]))
+	      ++urgency_end;
+
+	    urgency.assign(line, urgency_begin + 8, urgency_end - urgency_begin - 8);
+	  }
+
+	return true;
+      }
+
+      /** \brief Parse the last line of a changelog entry, which looks
+       *  like " -- Maintainer <address>  date".
+       */
+      bool parse_changelog_trailer(const std::string &line,
+				   std::string &maintainer,
+				   std::string &date)
+      {
+	if(line.compare(0, 4, " -- ") != 0)
+	  return false;
+
+	const std::string::size_type address_begin = line.find('<', 4);
+	const std::string::size_type address_end =
+	  address_begin == std::string::npos ? std::string::npos : line.find('>', address_begin);
+
+	if(address_end == std::string::npos)
+	  {
+	    maintainer = trim(std::string(line, 4));
+	    date.clear();
+	  }
+	else
+	  {
+	    maintainer.assign(line, 4, address_end + 1 - 4);
+	    date = trim(std::string(line, address_end + 1));
+	  }
+
+	return true;
+      }
+
+      /** \brief Test whether a line ends the changelog proper. */
+      bool is_changelog_terminator(const std::string &line)
+      {
+	std::string::size_type start = 0;
+	if(line.compare(0, 2, ";;") == 0)
+	  {
+	    start = 2;
+	    while(start < line.size() && isspace(line[start]))
+	      ++start;
+	  }
+
+	return
+	  line.compare(start, 16, "Local variables:") == 0 ||
+	  line.compare(start, 16, "Local Variables:") == 0 ||
+	  line.compare(0, 13, "Old Changelog") == 0;
+      }
+    }
+
+    changelog_reader::changelog_reader(const std::string &filename)
+      : in(filename.c_str(), std::ios::in | std::ios::binary),
+	have_line(false),
+	line_begin(0),
+	next_line_begin(0),
+	entry_begin(0),
+	entry_end(0)
+    {
+      advance();
+    }
+
+    bool changelog_reader::advance()
+    {
+      line_begin = next_line_begin;
+      have_line = in.is_open() && std::getline(in, line);
+
+      if(have_line)
+	{
+	  next_line_begin += line.size();
+	  if(!in.eof())
+	    ++next_line_begin;
+
+	  if(!line.empty() && line[line.size() - 1] == '\r')
+	    line.erase(line.size() - 1);
+	}
+
+      return have_line;
+    }
+
+    void changelog_reader::seek(std::streamoff offset)
+    {
+      in.clear();
+      in.seekg(offset);
+      next_line_begin = offset;
+      advance();
+    }
+
+    cw::util::ref_ptr<changelog_entry> changelog_reader::next()
+    {
+      std::string source, version, distribution, urgency;
+
+      // Find the start of the next entry.
+      while(have_line &&
+	    !parse_changelog_header(line, source, version, distribution, urgency))
+	{
+	  if(is_changelog_terminator(line))
+	    have_line = false;
+	  else
+	    advance();
+	}
+
+      if(!have_line)
+	return NULL;
+
+      entry_begin = line_begin;
+
+      const std::string header(line);
+      std::vector<std::string> body;
+      std::string maintainer, date;
+
+      advance();
+      entry_end = line_begin;
+
+      while(have_line)
+	{
+	  if(parse_changelog_trailer(line, maintainer, date))
+	    {
+	      advance();
+	      entry_end = line_begin;
+	      break;
+	    }
+
+	  // An entry without a trailer ends where the next one
+	  // starts.
+	  std::string next_source, next_version, next_distribution, next_urgency;
+	  if(parse_changelog_header(line, next_source, next_version,
+				    next_distribution, next_urgency) ||
+	     is_changelog_terminator(line))
+	    break;
+
+	  body.push_back(line);
+	  advance();
+	  entry_end = line_begin;
+	}
+
+      while(!body.empty() && is_blank(body.back()))
+	body.pop_back();
+
+      // Lay out the text the way parsechangelog does, so that
+      // parse_changes() and the renderers see the same thing either
+      // way.
+      std::string changes(header);
+      for(std::vector<std::string>::const_iterator it = body.begin();
+	  it != body.end(); ++it)
+	{
+	  if(is_blank(*it))
+	    changes += "\n .";
+	  else
+	    {
+	      changes += "\n ";
+	      changes += *it;
+	    }
+	}
+
+      return changelog_entry::create(source,
+				     version,
+				     distribution,
+				     urgency,
+				     changes,
+				     parse_changes(changes),
+				     maintainer,
+				     date);
+    }
+
+    namespace
+    {
+      /** \brief Tracks which entries of a changelog are newer than a
+       *  given version.
+       */
+      class newer_entry_filter
+      {
+	std::string current_version;
+	std::string last_version;
+
+      public:
+	newer_entry_filter(const std::string &_current_version)
+	  : current_version(_current_version)
+	{
+	}
+
+	/** \return \b true if the entry with the given version, which
+	 *  follows every entry previously passed to this method, is
+	 *  new.
+	 */
+	bool is_new(const std::string &version)
+	{
+	  const bool retrograde =
+	    !last_version.empty() &&
+	    _system->VS->CmpVersion(version, last_version) > 0;
+	  last_version = version;
+
+	  return !retrograde &&
+	    _system->VS->CmpVersion(version, current_version) > 0;
+	}
+      };
+    }
+
+    cw::util::ref_ptr<changelog>
+    parse_changelog_newer_than(const temp::name &file,
+			       const std::string &current_version)
+    {
+      if(!file.valid())
+	return NULL;
+
+      changelog_reader reader(file.get_name());
+      if(!reader.is_open())
+	return NULL;
+
+      newer_entry_filter filter(current_version);
+      std::vector<cw::util::ref_ptr<changelog_entry> > entries;
+
+      for(cw::util::ref_ptr<changelog_entry> entry = reader.next();
+	  entry.valid() && filter.is_new(entry->get_version());
+	  entry = reader.next())
+	entries.push_back(entry);
+
+      return changelog::create(entries);
+    }
+
+    temp::name extract_changelog_newer_than(const temp::name &file,
+					    const std::string &current_version)
+    {
+      if(!file.valid())
+	return temp::name();
+
+      std::streamoff begin = -1, end = -1;
+      {
+	changelog_reader reader(file.get_name());
+	if(!reader.is_open())
+	  return temp::name();
+
+	newer_entry_filter filter(current_version);
+
+	for(cw::util::ref_ptr<changelog_entry> entry = reader.next();
+	    entry.valid() && filter.is_new(entry->get_version());
+	    entry = reader.next())
+	  {
+	    if(begin < 0)
+	      begin = reader.get_entry_begin();
+	    end = reader.get_entry_end();
+	  }
+      }
+
+      if(begin < 0)
+	return temp::name();
+
+      std::ifstream in(file.get_name().c_str(), std::ios::in | std::ios::binary);
+      in.seekg(begin);
+
+      std::string text(end - begin, '\0');
+      if(!in.read(&text[0], text.size()))
+	return temp::name();
+
+      temp::name rval("changelog");
+      std::ofstream out(rval.get_name().c_str(), std::ios::out | std::ios::binary);
+      out.write(text.data(), text.size());
+      out.close();
+
+      if(!out)
+	return temp::name();
+
+      return rval;
+    }
+
 
 
 
+    namespace
+    {
+      const char * const changelog_index_magic = "aptitude changelog index 1";
+
+      /** \brief Make a field safe to store in a tab-separated line. */
+      std::string index_field(const std::string &s)
+      {
+	std::string rval(s);
+	for(std::string::iterator it = rval.begin(); it != rval.end(); ++it)
+	  if(*it == '\t' || *it == '\n')
+	    *it = ' ';
+
+	return rval;
+      }
+
+      std::streamoff get_file_size(const std::string &filename)
+      {
+	struct stat buf;
+	if(stat(filename.c_str(), &buf) != 0)
+	  return -1;
+
+	return buf.st_size;
+      }
+    }
+
+    changelog_index::changelog_index()
+      : file_size(-1)
+    {
+    }
+
+    bool changelog_index::build(const std::string &filename)
+    {
+      entries.clear();
+      file_size = get_file_size(filename);
+
+      changelog_reader reader(filename);
+      if(file_size < 0 || !reader.is_open())
+	return false;
+
+      for(cw::util::ref_ptr<changelog_entry> entry = reader.next();
+	  entry.valid(); entry = reader.next())
+	entries.push_back(changelog_index_entry(reader.get_entry_begin(),
+						reader.get_entry_end(),
+						entry->get_version(),
+						entry->get_distribution(),
+						entry->get_urgency(),
+						entry->get_maintainer(),
+						entry->get_date_str()));
+
+      return true;
+    }
+
+    bool changelog_index::load(const std::string &index_filename)
+    {
+      entries.clear();
+      file_size = -1;
+
+      std::ifstream in(index_filename.c_str());
+      std::string line;
+      if(!std::getline(in, line) || line != changelog_index_magic)
+	return false;
+
+      std::streamoff size;
+      if(!(in >> size) || !std::getline(in, line))
+	return false;
+
+      while(std::getline(in, line))
+	{
+	  std::vector<std::string> fields;
+	  std::string::size_type start = 0;
+	  while(true)
+	    {
+	      const std::string::size_type tab = line.find('\t', start);
+	      fields.push_back(std::string(line, start, tab == std::string::npos ? std::string::npos : tab - start));
+	      if(tab == std::string::npos)
+		break;
+	      start = tab + 1;
+	    }
+
+	  if(fields.size() != 7)
+	    {
+	      entries.clear();
+	      return false;
+	    }
+
+	  entries.push_back(changelog_index_entry(atoll(fields[0].c_str()),
+						  atoll(fields[1].c_str()),
+						  fields[2],
+						  fields[3],
+						  fields[4],
+						  fields[5],
+						  fields[6]));
+	}
+
+      file_size = size;
+      return true;
+    }
+
+    bool changelog_index::save(const std::string &index_filename) const
+    {
+      std::ofstream out(index_filename.c_str());
+
+      out << changelog_index_magic << '\n'
+	  << file_size << '\n';
+
+      for(std::vector<changelog_index_entry>::const_iterator it = entries.begin();
+	  it != entries.end(); ++it)
+	out << it->get_begin() << '\t'
+	    << it->get_end() << '\t'
+	    << index_field(it->get_version()) << '\t'
+	    << index_field(it->get_distribution()) << '\t'
+	    << index_field(it->get_urgency()) << '\t'
+	    << index_field(it->get_maintainer()) << '\t'
+	    << index_field(it->get_date()) << '\n';
+
+      out.close();
+      return !out.fail();
+    }
+
+    bool changelog_index::matches(const std::string &filename) const
+    {
+      return file_size >= 0 && file_size == get_file_size(filename);
+    }
+
+    cw::util::ref_ptr<changelog>
+    changelog_index::parse(const std::string &filename,
+			   const std::string &from) const
+    {
+      if(!matches(filename))
+	return NULL;
+
+      changelog_reader reader(filename);
+      if(!reader.is_open())
+	return NULL;
+
+      newer_entry_filter filter(from);
+      std::vector<cw::util::ref_ptr<changelog_entry> > rval;
+
+      for(std::vector<changelog_index_entry>::const_iterator it = entries.begin();
+	  it != entries.end(); ++it)
+	{
+	  if(!from.empty() && !filter.is_new(it->get_version()))
+	    break;
+
+	  reader.seek(it->get_begin());
+	  cw::util::ref_ptr<changelog_entry> entry = reader.next();
+
+	  // If the entry isn't where the index says it is, the index
+	  // is stale.
+	  if(!entry.valid() ||
+	     reader.get_entry_begin() != it->get_begin() ||
+	     entry->get_version() != it->get_version())
+	    return NULL;
+
+	  rval.push_back(entry);
+	}
+
+      return changelog::create(rval);
+    }
+
+    cw::util::ref_ptr<changelog>
+    parse_changelog_indexed(const temp::name &file,
+			    const std::string &source_package,
+			    const std::string &source_version,
+			    const std::string &from)
+    {
+      if(!file.valid())
+	return NULL;
+
+      aptitude::util::logging::LoggerPtr logger(Loggers::getAptitudeChangelogParse());
+
+      const std::string index_uri =
+	ssprintf("changelog-index://%s/%s",
+		 source_package.c_str(), source_version.c_str());
+
+      changelog_index index;
+      if(download_cache != NULL)
+	{
+	  temp::name cached = download_cache->getItem(index_uri);
+	  if(cached.valid() && index.load(cached.get_name()))
+	    {
+	      cw::util::ref_ptr<changelog> rval = index.parse(file.get_name(), from);
+	      if(rval.valid())
+		{
+		  LOG_TRACE(logger, "Parsed " << file.get_name()
+			    << " using the cached index " << index_uri);
+		  return rval;
+		}
+
+	      LOG_DEBUG(logger, "The cached index " << index_uri
+			<< " doesn't match " << file.get_name() << ", rebuilding it.");
+	    }
+	}
+
+      if(!index.build(file.get_name()))
+	return NULL;
+
+      if(download_cache != NULL)
+	{
+	  temp::name index_file("changelog-index");
+	  if(index.save(index_file.get_name()))
+	    {
+	      LOG_TRACE(logger, "Caching the index of " << file.get_name()
+			<< " as " << index_uri);
+	      download_cache->putItem(index_uri, index_file.get_name());
+	    }
+	}
+
+      return index.parse(file.get_name(), from);
+    }
+
     namespace
     {
       void invoke_safe_slot(safe_slot0<void> slot)
@@ -468,6 +1018,25 @@ namespace aptitude
 				     job->get_from().c_str(),
 				     job->get_to().c_str());
 
+	  // Reading just the new entries through the changelog's
+	  // index is cheaper than running parsechangelog over the
+	  // whole file, so don't bother to digest it.
+	  if(!job->get_digested() && !job->get_from().empty())
+	    {
+	      LOG_TRACE(get_log_category(),
+			"Reading the entries of " << job->get_name().get_name()
+			<< " newer than " << job->get_from());
+
+	      cw::util::ref_ptr<aptitude::apt::changelog> parsed =
+		aptitude::apt::parse_changelog_indexed(job->get_name(),
+						       job->get_source_package(),
+						       job->get_to(),
+						       job->get_from());
+	      job->get_post_thunk()(sigc::bind(sigc::ptr_fun(&invoke_safe_slot),
+					       safe_bind(job->get_slot(), parsed)));
+	      return;
+	    }
+
 	  temp::name digested;
 	  if(job->get_digested())
 	    digested = job->get_name();
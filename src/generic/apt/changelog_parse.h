@@ -24,6 +24,8 @@
 
 #include <apt-pkg/pkgcache.h>
 
+#include <fstream>
+#include <string>
 #include <vector>
 
 #include <cwidget/generic/util/ref_ptr.h>
@@ -208,12 +210,23 @@ namespace aptitude
 
       changelog(FileFd &file);
 
+      changelog(const std::vector<cwidget::util::ref_ptr<changelog_entry> > &_entries)
+	: entries(_entries)
+      {
+      }
+
     public:
       static cwidget::util::ref_ptr<changelog> create(FileFd &file)
       {
 	return new changelog(file);
       }
 
+      static cwidget::util::ref_ptr<changelog>
+      create(const std::vector<cwidget::util::ref_ptr<changelog_entry> > &entries)
+      {
+	return new changelog(entries);
+      }
+
       /** \brief The type of an iterator over this changelog. */
       typedef std::vector<cwidget::util::ref_ptr<changelog_entry> >::const_iterator const_iterator;
       typedef std::vector<cwidget::util::ref_ptr<changelog_entry> >::size_type size_type;
@@ -223,6 +236,234 @@ namespace aptitude
       const_iterator end() const { return entries.end(); }
     };
 
+    /** \brief Reads the entries of a Debian changelog one at a time.
+     *
+     *  Entries are returned in the order they appear in the file,
+     *  newest first, and each one is only parsed when it's asked
+     *  for; a caller that wants the most recent entries can stop
+     *  without reading the rest of the file.
+     *
+     *  Unlike parse_changelog(), this reads the changelog format
+     *  itself instead of running parsechangelog.  Lines outside any
+     *  entry are skipped, and the changelog ends at an "Old
+     *  Changelog:" or "Local variables:" line.  The changes text of
+     *  each entry is laid out the way parsechangelog lays it out.
+     */
+    class changelog_reader
+    {
+      std::ifstream in;
+
+      /** \brief The next line of the file, if have_line is \b true. */
+      std::string line;
+      bool have_line;
+
+      /** \brief The offset of the start of \ref line. */
+      std::streamoff line_begin;
+      /** \brief The offset of the line after \ref line. */
+      std::streamoff next_line_begin;
+
+      std::streamoff entry_begin;
+      std::streamoff entry_end;
+
+      /** \brief Make the next line of the file current.
+       *
+       *  \return \b false at the end of the file.
+       */
+      bool advance();
+
+      // Not copyable.
+      changelog_reader(const changelog_reader &);
+      changelog_reader &operator=(const changelog_reader &);
+
+    public:
+      /** \brief Open the given changelog. */
+      explicit changelog_reader(const std::string &filename);
+
+      /** \return \b true if the changelog could be opened. */
+      bool is_open() const { return in.is_open(); }
+
+      /** \brief Parse the next entry of the changelog.
+       *
+       *  \return the entry, or \b NULL if there are no more.
+       */
+      cwidget::util::ref_ptr<changelog_entry> next();
+
+      /** \return the offset in the file of the first byte of the
+       *  entry most recently returned by next().
+       */
+      std::streamoff get_entry_begin() const { return entry_begin; }
+
+      /** \return the offset in the file just past the last line of
+       *  the entry most recently returned by next().
+       */
+      std::streamoff get_entry_end() const { return entry_end; }
+
+      /** \brief Continue reading from the given offset, which should
+       *  be the start of a line.
+       */
+      void seek(std::streamoff offset);
+    };
+
+    /** \brief Parse only the entries of a changelog that are newer
+     *  than the given version.
+     *
+     *  Reading stops at the first entry that isn't newer than
+     *  current_version, or that is newer than the entry before it
+     *  (some changelogs contain old entries with misleadingly large
+     *  version numbers).  The rest of the file is never read, so this is
+     *  much cheaper than parse_changelog() for long changelogs.
+     *
+     *  \param file             The changelog to read, which must not
+     *                          have been digested.
+     *  \param current_version  The version the changes should be
+     *                          newer than.
+     *
+     *  \return the new entries, newest first, or \b NULL if the file
+     *  can't be read.
+     */
+    cwidget::util::ref_ptr<changelog>
+    parse_changelog_newer_than(const temp::name &file,
+			       const std::string &current_version);
+
+    /** \brief Copy the text of the entries of a changelog that are
+     *  newer than the given version to a new file.
+     *
+     *  The entries are chosen as in parse_changelog_newer_than() and
+     *  copied exactly as they appear in the original file.
+     *
+     *  \return the new file, or an invalid name if there are no new
+     *  entries or the file can't be read.
+     */
+    temp::name extract_changelog_newer_than(const temp::name &file,
+					    const std::string &current_version);
+
+    /** \brief Where one entry of a changelog file is, and what its
+     *  header and trailer lines say.
+     */
+    class changelog_index_entry
+    {
+      std::streamoff begin;
+      std::streamoff end;
+
+      std::string version;
+      std::string distribution;
+      std::string urgency;
+      std::string maintainer;
+      std::string date;
+
+    public:
+      changelog_index_entry(std::streamoff _begin,
+			    std::streamoff _end,
+			    const std::string &_version,
+			    const std::string &_distribution,
+			    const std::string &_urgency,
+			    const std::string &_maintainer,
+			    const std::string &_date)
+	: begin(_begin), end(_end),
+	  version(_version), distribution(_distribution),
+	  urgency(_urgency), maintainer(_maintainer), date(_date)
+      {
+      }
+
+      /** \return the offset of the first byte of the entry. */
+      std::streamoff get_begin() const { return begin; }
+      /** \return the offset just past the last line of the entry. */
+      std::streamoff get_end() const { return end; }
+
+      const std::string &get_version() const { return version; }
+      const std::string &get_distribution() const { return distribution; }
+      const std::string &get_urgency() const { return urgency; }
+      const std::string &get_maintainer() const { return maintainer; }
+      /** \return the date of the entry, as it appears in the file. */
+      const std::string &get_date() const { return date; }
+    };
+
+    /** \brief A compact summary of a changelog file, listing where
+     *  each of its entries is.
+     *
+     *  An index is much smaller than the changelog, and it lets the
+     *  entries that are wanted be read by seeking straight to them
+     *  instead of parsing the whole file.  Indices are stored in the
+     *  download cache next to the changelogs they describe; see
+     *  parse_changelog_indexed().
+     */
+    class changelog_index
+    {
+      /** \brief The size of the indexed file, used to notice when an
+       *  index doesn't belong to the file it's used with.
+       */
+      std::streamoff file_size;
+      std::vector<changelog_index_entry> entries;
+
+    public:
+      changelog_index();
+
+      /** \brief Read the given changelog and replace the contents of
+       *  this index with the locations of its entries.
+       *
+       *  \return \b false if the changelog can't be read.
+       */
+      bool build(const std::string &filename);
+
+      /** \brief Replace the contents of this index with an index
+       *  stored by save().
+       *
+       *  \return \b false if the file can't be read or isn't an
+       *  index.
+       */
+      bool load(const std::string &index_filename);
+
+      /** \brief Write this index to the given file.
+       *
+       *  \return \b false if the file couldn't be written.
+       */
+      bool save(const std::string &index_filename) const;
+
+      /** \return \b true if this index could describe the given file. */
+      bool matches(const std::string &filename) const;
+
+      /** \return the entries of the changelog, newest first. */
+      const std::vector<changelog_index_entry> &get_entries() const { return entries; }
+
+      /** \brief Parse some of the entries of the indexed changelog.
+       *
+       *  \param filename  The changelog this index was built from.
+       *  \param from      If not empty, only the entries newer than
+       *                   this version are parsed, chosen as in
+       *                   parse_changelog_newer_than().
+       *
+       *  \return the entries, or \b NULL if the file can't be read or
+       *  doesn't match this index.
+       */
+      cwidget::util::ref_ptr<changelog> parse(const std::string &filename,
+					      const std::string &from) const;
+    };
+
+    /** \brief Parse a changelog using the index stored for it in the
+     *  download cache.
+     *
+     *  The index is keyed by the source package and version that the
+     *  changelog belongs to.  If there isn't one yet, or it doesn't
+     *  match the file, the changelog is indexed and the index is
+     *  stored for next time.  Either way, only the entries that are
+     *  wanted are parsed.
+     *
+     *  \param file            The changelog, which must not have been
+     *                         digested.
+     *  \param source_package  The source package of the changelog.
+     *  \param source_version  The version of the source package that
+     *                         the changelog was taken from.
+     *  \param from            If not empty, only the entries newer
+     *                         than this version are returned.
+     *
+     *  \return the entries, or \b NULL if the file can't be read.
+     */
+    cwidget::util::ref_ptr<changelog>
+    parse_changelog_indexed(const temp::name &file,
+			    const std::string &source_package,
+			    const std::string &source_version,
+			    const std::string &from = "");
+
     /** \brief Given a Debian changelog, parse it and generate a new
      *  file containing the changelog in an RFC822-style format.
      */
@@ -259,7 +500,10 @@ namespace aptitude
      *  \param slot A slot to invoke when teh changelog is parsed.  It
      *              will be invoked in the main thread.
      *  \param from The first version to parse, or an empty string
-     *              to start at the beginning of the changelog.
+     *              to start at the beginning of the changelog.  If
+     *              this is set and the changelog wasn't digested,
+     *              only the entries newer than it are read (see
+     *              parse_changelog_indexed()).
      *  \param to   The last version to parse, or an empty string
      *              to parse until the end of the changelog.
      *  \param source_package The name of the source package whose
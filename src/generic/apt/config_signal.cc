@@ -43,6 +43,10 @@ void signalling_config::Set(string Name, string Value)
   user_config->Set(Name, Value);
   system_config->Set(Name, Value);
 
+  // Refresh anything that depends on every option before the
+  // option's own listeners run.
+  changed.emit();
+
   connmap::iterator found=conn_table.find(Name);
 
   if(found!=conn_table.end())
@@ -54,6 +58,8 @@ void signalling_config::Set(string Name, int Value)
   user_config->Set(Name.c_str(), Value);
   system_config->Set(Name.c_str(), Value);
 
+  changed.emit();
+
   connmap::iterator found=conn_table.find(Name);
 
   if(found!=conn_table.end())
@@ -64,6 +70,8 @@ void signalling_config::SetNoUser(string Name, string Value)
 {
   system_config->Set(Name, Value);
 
+  changed.emit();
+
   connmap::iterator found=conn_table.find(Name);
 
   if(found!=conn_table.end())
@@ -74,6 +82,8 @@ void signalling_config::SetNoUser(string Name, int Value)
 {
   system_config->Set(Name.c_str(), Value);
 
+  changed.emit();
+
   connmap::iterator found=conn_table.find(Name);
 
   if(found!=conn_table.end())
@@ -110,6 +120,8 @@ void signalling_config::setcfg(Configuration *new_user_cfg,
 
   update_theme(system_config->Find(PACKAGE "::Theme", ""));
 
+  changed.emit();
+
   for(connmap::iterator i=conn_table.begin();
       i!=conn_table.end();
       i++)
@@ -214,6 +214,15 @@ public:
 
   void connect(string name, const sigc::slot0<void> &slot);
 
+  /** \brief Emitted after any option is modified through this
+   *  object, including when the whole configuration is replaced.
+   *
+   *  Unlike the signals registered with connect(), this doesn't
+   *  depend on how the option's name is spelled.  It is emitted
+   *  before the signals of the option itself.
+   */
+  sigc::signal0<void> changed;
+
   void Dump(std::ostream &out);
 };
 
@@ -0,0 +1,64 @@
+// config_snapshot.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "config_snapshot.h"
+
+#include "apt.h"
+#include "config_signal.h"
+
+#include <aptitude.h>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    namespace
+    {
+      config_snapshot snapshot;
+      bool snapshot_stale = true;
+    }
+
+    void config_snapshot::load(signalling_config &cfg)
+    {
+      auto_install = cfg.FindB(PACKAGE "::Auto-Install", true);
+      auto_install_remove_ok = cfg.FindB(PACKAGE "::Auto-Install-Remove-Ok", false);
+      install_recommends = cfg.FindB("APT::Install-Recommends", true);
+      keep_recommends = cfg.FindB(PACKAGE "::Keep-Recommends", false);
+      keep_suggests = cfg.FindB(PACKAGE "::Keep-Suggests", false);
+      suggests_important = cfg.FindB(PACKAGE "::Suggests-Important", false);
+      new_package_commands = cfg.FindB(PACKAGE "::UI::New-Package-Commands", true);
+    }
+
+    const config_snapshot &get_config_snapshot()
+    {
+      if(snapshot_stale)
+	{
+	  snapshot.load(*aptcfg);
+	  snapshot_stale = false;
+	}
+
+      return snapshot;
+    }
+
+    void invalidate_config_snapshot()
+    {
+      snapshot_stale = true;
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/** \file config_snapshot.h */ // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+class signalling_config;
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief The values of options that are read while marking
+     *  packages or walking dependencies.
+     *
+     *  Looking an option up in the configuration tree compares its
+     *  name against each node on the way; some options are consulted
+     *  once for each dependency that the depcache visits.  Those
+     *  options are copied into this structure, which is refreshed the
+     *  next time it is used after any option changes.
+     */
+    struct config_snapshot
+    {
+      /** \brief Aptitude::Auto-Install */
+      bool auto_install;
+
+      /** \brief Aptitude::Auto-Install-Remove-Ok */
+      bool auto_install_remove_ok;
+
+      /** \brief APT::Install-Recommends */
+      bool install_recommends;
+
+      /** \brief Aptitude::Keep-Recommends */
+      bool keep_recommends;
+
+      /** \brief Aptitude::Keep-Suggests */
+      bool keep_suggests;
+
+      /** \brief Aptitude::Suggests-Important */
+      bool suggests_important;
+
+      /** \brief Aptitude::UI::New-Package-Commands */
+      bool new_package_commands;
+
+      /** \brief Read the current values from the given configuration. */
+      void load(signalling_config &cfg);
+    };
+
+    /** \brief Retrieve the current values of the options in
+     *  config_snapshot.
+     *
+     *  The returned reference remains valid until the program exits,
+     *  but its contents change when the configuration does.
+     */
+    const config_snapshot &get_config_snapshot();
+
+    /** \brief Make the next call to get_config_snapshot() read the
+     *  configuration again.
+     *
+     *  This is connected to signalling_config::changed when the
+     *  configuration is created.
+     */
+    void invalidate_config_snapshot();
+  }
+}
+
+#endif // CONFIG_SNAPSHOT_H
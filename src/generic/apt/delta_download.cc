@@ -0,0 +1,196 @@
+// delta_download.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "delta_download.h"
+
+#include "apt.h"
+#include "aptcache.h"
+#include "config_signal.h"
+
+#include <aptitude.h>
+#include <loggers.h>
+
+#include <apt-pkg/strutl.h>
+
+#include <generic/util/logging.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    namespace
+    {
+      /** \brief An upgrade whose archive might be rebuilt. */
+      struct delta_candidate
+      {
+	std::string package;
+	std::string archive;
+	unsigned long long size;
+
+	delta_candidate(const std::string &_package,
+			const std::string &_archive,
+			unsigned long long _size)
+	  : package(_package), archive(_archive), size(_size)
+	{
+	}
+      };
+
+      // The name apt gives the archive of a version in the archive
+      // directory; see pkgAcqArchive.
+      std::string archive_filename(const pkgCache::VerIterator &ver)
+      {
+	return aptcfg->FindDir("Dir::Cache::Archives") +
+	  QuoteString(ver.ParentPkg().Name(), "_:") + '_' +
+	  QuoteString(ver.VerStr(), "_:") + '_' +
+	  QuoteString(ver.Arch(), "_:.") + ".deb";
+      }
+
+      bool archive_present(const std::string &filename,
+			   unsigned long long size)
+      {
+	struct stat buf;
+	return stat(filename.c_str(), &buf) == 0 &&
+	  (unsigned long long) buf.st_size == size;
+      }
+
+      /** \brief Run the rebuilding program with its output discarded.
+       *
+       *  \return the status returned by waitpid(), or -1 if the
+       *  program couldn't be run.
+       */
+      int run_rebuild_command(const std::vector<std::string> &args)
+      {
+	const pid_t pid = fork();
+	if(pid < 0)
+	  return -1;
+	else if(pid == 0)
+	  {
+	    const int fdnull = open("/dev/null", O_RDWR);
+	    if(fdnull >= 0)
+	      {
+		dup2(fdnull, 0);
+		dup2(fdnull, 1);
+		dup2(fdnull, 2);
+		close(fdnull);
+	      }
+
+	    std::vector<char *> argv;
+	    for(std::vector<std::string>::const_iterator it = args.begin();
+		it != args.end(); ++it)
+	      argv.push_back(const_cast<char *>(it->c_str()));
+	    argv.push_back(NULL);
+
+	    execv(argv[0], &argv[0]);
+	    _exit(127);
+	  }
+
+	while(true)
+	  {
+	    int status = 0;
+	    if(waitpid(pid, &status, 0) == pid)
+	      return status;
+	    else if(errno != EINTR)
+	      return -1;
+	  }
+      }
+    }
+
+    bool delta_download_enabled()
+    {
+      return aptcfg->FindB(PACKAGE "::Delta-Download", false);
+    }
+
+    delta_download_statistics rebuild_upgrades_from_deltas()
+    {
+      aptitude::util::logging::LoggerPtr logger(Loggers::getAptitudeInstallDeltas());
+      delta_download_statistics rval;
+
+      if(apt_cache_file == NULL || !delta_download_enabled())
+	return rval;
+
+      // Rebuilding a tiny archive costs more than downloading it.
+      const unsigned long long min_size =
+	(unsigned long long) aptcfg->FindI(PACKAGE "::Delta-Download::Min-Size", 32) * 1024;
+
+      std::vector<delta_candidate> candidates;
+      for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+	  !pkg.end(); ++pkg)
+	{
+	  const pkgDepCache::StateCache &state = (*apt_cache_file)[pkg];
+	  if(pkg.CurrentVer().end() || !state.Upgrade())
+	    continue;
+
+	  const pkgCache::VerIterator ver = state.InstVerIter(*apt_cache_file);
+	  if(ver.end() || !ver.Downloadable() || ver->Size < min_size)
+	    continue;
+
+	  const std::string archive = archive_filename(ver);
+	  if(archive_present(archive, ver->Size))
+	    continue;
+
+	  candidates.push_back(delta_candidate(pkg.Name(), archive, ver->Size));
+	}
+
+      if(candidates.empty())
+	return rval;
+
+      std::vector<std::string> args;
+      args.push_back(aptcfg->Find(PACKAGE "::Delta-Download::Command",
+				  "/usr/bin/debdelta-upgrade"));
+      args.push_back("--dir");
+      args.push_back(aptcfg->FindDir("Dir::Cache::Archives"));
+      for(std::vector<delta_candidate>::const_iterator it = candidates.begin();
+	  it != candidates.end(); ++it)
+	args.push_back(it->package);
+
+      LOG_INFO(logger, "Trying to rebuild " << candidates.size()
+	       << " archives from deltas with " << args[0]);
+
+      const int status = run_rebuild_command(args);
+      if(status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	// Whatever it did manage to rebuild is still used.
+	LOG_WARN(logger, args[0] << " failed (status " << status << ").");
+
+      for(std::vector<delta_candidate>::const_iterator it = candidates.begin();
+	  it != candidates.end(); ++it)
+	if(archive_present(it->archive, it->size))
+	  {
+	    LOG_DEBUG(logger, "Rebuilt " << it->archive);
+	    rval.archive_rebuilt(it->size);
+	  }
+
+      LOG_INFO(logger, "Rebuilt " << rval.get_num_rebuilt() << " of "
+	       << candidates.size() << " archives ("
+	       << rval.get_rebuilt_bytes() << " bytes).");
+
+      return rval;
+    }
+  }
+}
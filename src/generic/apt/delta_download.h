@@ -0,0 +1,84 @@
+// delta_download.h                                  -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef DELTA_DOWNLOAD_H
+#define DELTA_DOWNLOAD_H
+
+/** \file delta_download.h
+ *
+ *  Support for rebuilding the archives of upgraded packages from
+ *  binary deltas against the installed version, rather than fetching
+ *  them in full.
+ */
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief Describes the archives that were rebuilt from deltas. */
+    class delta_download_statistics
+    {
+      int num_rebuilt;
+      unsigned long long rebuilt_bytes;
+
+    public:
+      delta_download_statistics()
+	: num_rebuilt(0), rebuilt_bytes(0)
+      {
+      }
+
+      void archive_rebuilt(unsigned long long size)
+      {
+	++num_rebuilt;
+	rebuilt_bytes += size;
+      }
+
+      /** \return the number of archives that no longer need to be
+       *  downloaded.
+       */
+      int get_num_rebuilt() const { return num_rebuilt; }
+
+      /** \return the total size of those archives. */
+      unsigned long long get_rebuilt_bytes() const { return rebuilt_bytes; }
+    };
+
+    /** \return \b true if upgrades should be rebuilt from deltas. */
+    bool delta_download_enabled();
+
+    /** \brief Try to rebuild the archives of the packages that are
+     *  about to be upgraded from deltas.
+     *
+     *  The rebuilding is done by an external program (by default,
+     *  debdelta-upgrade), which is given the names of the upgraded
+     *  packages whose new archive is not already in the archive
+     *  directory.  It fetches whatever deltas the mirror offers,
+     *  decides for itself whether each one is worth using, and
+     *  leaves the rebuilt .debs in the archive directory, where the
+     *  normal download finds them and skips them.
+     *
+     *  Failures are logged and otherwise ignored: anything that
+     *  wasn't rebuilt is simply downloaded as usual.
+     *
+     *  \return the archives that were rebuilt.
+     */
+    delta_download_statistics rebuild_upgrades_from_deltas();
+  }
+}
+
+#endif // DELTA_DOWNLOAD_H
@@ -74,169 +74,224 @@ static void make_level_fragment(const wstring &desc,
 				wstring::size_type indent,
 				wstring::size_type &start,
 				bool recognize_bullets,
-				std::vector<aptitude::description_element_ref> &output)
+				std::vector<aptitude::description_element_ref> &output);
+
+/** Parses the next element at a single indent level.
+ *
+ *  The parameters are the same as those of make_level_fragment();
+ *  \param first should be \b true for the first element of the level
+ *  and is then cleared.
+ *
+ *  \return \b false if the level ended before an element was found;
+ *  start is then placed at the beginning of the line that ended it.
+ */
+static bool make_level_element(const wstring &desc,
+			       wstring::size_type indent,
+			       wstring::size_type &start,
+			       bool &first,
+			       bool recognize_bullets,
+			       std::vector<aptitude::description_element_ref> &output)
 {
-  bool first=true;
+  if(start>=desc.size())
+    return false;
+
+  wstring::size_type loc=start;
+  unsigned int nspaces;
 
-  while(start<desc.size())
+  if(!first)
     {
-      wstring::size_type loc=start;
-      unsigned int nspaces;
+      nspaces=0;
 
-      if(!first)
+      while(loc<desc.size() && desc[loc]==L' ' && nspaces<indent)
 	{
-	  nspaces=0;
+	  ++loc;
+	  ++nspaces;
+	}
 
-	  while(loc<desc.size() && desc[loc]==L' ' && nspaces<indent)
-	    {
-	      ++loc;
-	      ++nspaces;
-	    }
+      // This handles the case of " .\n" breaking list paragraphs.
+      // I arbitrarily put the paragraph break inside the indented
+      // text even when it actually terminates the list.
+      if(nspaces == 1 && loc < desc.size() && desc[loc] == L'.')
+	; // Handled uniformly below for both this case and the
+	  // case of a leading blank line.
+      else if(nspaces < indent) // Anything but a " .\n" that has
+				// the wrong indent will break the
+				// list.
+	return false;
+    }
+  else
+    {
+      nspaces=indent;
+      first=false;
+    }
 
-	  // This handles the case of " .\n" breaking list paragraphs.
-	  // I arbitrarily put the paragraph break inside the indented
-	  // text even when it actually terminates the list.
-	  if(nspaces == 1 && loc < desc.size() && desc[loc] == L'.')
-	    ; // Handled uniformly below for both this case and the
-	      // case of a leading blank line.
-	  else if(nspaces < indent) // Anything but a " .\n" that has
-				    // the wrong indent will break the
-				    // list.
-	    break;
-	}
-      else
-	{
-	  nspaces=indent;
-	  first=false;
-	}
+  // Only insert blank lines for full stops that have exactly one
+  // space; other full stops are treated as part of a paragraph.
+  if(nspaces == 1 && desc[loc] == '.')
+    {
+      output.push_back(aptitude::description_element::make_blank_line());
 
-      // Only insert blank lines for full stops that have exactly one
-      // space; other full stops are treated as part of a paragraph.
-      if(nspaces == 1 && desc[loc] == '.')
-	{
-	  output.push_back(aptitude::description_element::make_blank_line());
+      while(loc < desc.size() && desc[loc] != L'\n')
+	++loc;
 
-	  while(loc < desc.size() && desc[loc] != L'\n')
-	    ++loc;
+      if(loc < desc.size())
+	++loc;
 
-	  if(loc < desc.size())
-	    ++loc;
+      start=loc;
 
-	  start=loc;
+      return true; // Skip the switch statement below.
+    }
 
-	  continue; // Skip the switch statement below.
-	}
+  switch(desc[loc])
+    {
+    case L' ':
+      {
+	// Stores the number of spaces up to a bullet, if any.
+	unsigned int nspaces2=nspaces+1;
 
-      switch(desc[loc])
-	{
-	case L' ':
-	  {
-	    // Stores the number of spaces up to a bullet, if any.
-	    unsigned int nspaces2=nspaces+1;
+	++loc;
 
-	    ++loc;
+	// Provisionally check if it's a bulletted line --
+	// *ignoring leading spaces*.
+	wstring::size_type loc2=loc;
 
-	    // Provisionally check if it's a bulletted line --
-	    // *ignoring leading spaces*.
-	    wstring::size_type loc2=loc;
-
-	    while(loc2<desc.size() && desc[loc2] == L' ')
-	      {
-		++loc2;
-		++nspaces2;
-	      }
-
-	    if(recognize_bullets &&
-	       loc2 + 1 < desc.size() &&
-	       (desc[loc2] == L'+' ||
-		desc[loc2] == L'-' ||
-		desc[loc2] == L'*') &&
-	       desc[loc2 + 1] == L' ')
-	      {
-		// Start a list item (i.e., an indented region).
-
-		start = loc2 + 2;
-
-		std::vector<aptitude::description_element_ref> item_contents;
-
-		make_level_fragment(desc,
-				    nspaces2 + 2,
-				    start,
-				    recognize_bullets,
-				    item_contents);
-
-		output.push_back(aptitude::description_element::make_bullet_list(item_contents));
-	      }
-	    else
-	      {
-		int amt=0;
-		while(loc+amt<desc.size() && desc[loc+amt]!=L'\n')
-		  ++amt;
-
-		output.push_back(aptitude::description_element::make_literal(wstring(desc, loc, amt)));
-
-		loc+=amt;
-		if(loc<desc.size())
-		  ++loc;
-
-		start=loc;
-	      }
+	while(loc2<desc.size() && desc[loc2] == L' ')
+	  {
+	    ++loc2;
+	    ++nspaces2;
 	  }
 
-	  break;
-	default:
-	  // It's a paragraph.
+	if(recognize_bullets &&
+	   loc2 + 1 < desc.size() &&
+	   (desc[loc2] == L'+' ||
+	    desc[loc2] == L'-' ||
+	    desc[loc2] == L'*') &&
+	   desc[loc2 + 1] == L' ')
+	  {
+	    // Start a list item (i.e., an indented region).
+
+	    start = loc2 + 2;
+
+	    std::vector<aptitude::description_element_ref> item_contents;
+
+	    make_level_fragment(desc,
+				nspaces2 + 2,
+				start,
+				recognize_bullets,
+				item_contents);
+
+	    output.push_back(aptitude::description_element::make_bullet_list(item_contents));
+	  }
+	else
 	  {
-	    bool cont=true;
-	    wstring::size_type amt=0;
-	    wstring par=L"";
-
-	    do {
-	      amt=0;
-	      while(loc+amt<desc.size() && desc[loc+amt]!=L'\n')
-		++amt;
-
-	      par=par+wstring(desc, loc, amt);
-
-	      loc+=amt;
-
-	      // If we hit a newline and didn't just output a whitespace
-	      // character, insert one.
-	      if(loc<desc.size() && par.size()>0 && par[par.size()-1]!=' ')
-		par+=L" ";
-
-	      // Skip the newline
-	      if(loc<desc.size())
-		++loc;
-
-	      // Update start.
-	      start=loc;
-
-	      // Find how much indentation this line has.
-	      nspaces=0;
-	      while(loc<desc.size() && desc[loc]==L' ')
-		{
-		  ++loc;
-		  ++nspaces;
-		}
-
-	      // Check if we should continue (if not, we back up and
-	      // start parsing again from "start").  Note that *any*
-	      // change in the indentation requires us to restart --
-	      // more indentation is a literal line, while less means
-	      // we should exit this indent level.
-	      if(nspaces != indent)
-		cont=false;
-	      else if(loc>=desc.size())
-		cont=false;
-	      else if(nspaces == 1 && desc[loc] == '.')
-		cont=false;
-	    } while(cont);
-
-	    output.push_back(aptitude::description_element::make_paragraph(par));
+	    int amt=0;
+	    while(loc+amt<desc.size() && desc[loc+amt]!=L'\n')
+	      ++amt;
+
+	    output.push_back(aptitude::description_element::make_literal(wstring(desc, loc, amt)));
+
+	    loc+=amt;
+	    if(loc<desc.size())
+	      ++loc;
+
+	    start=loc;
 	  }
-	}
+      }
+
+      break;
+    default:
+      // It's a paragraph.
+      {
+	bool cont=true;
+	wstring::size_type amt=0;
+	wstring par=L"";
+
+	do {
+	  amt=0;
+	  while(loc+amt<desc.size() && desc[loc+amt]!=L'\n')
+	    ++amt;
+
+	  par=par+wstring(desc, loc, amt);
+
+	  loc+=amt;
+
+	  // If we hit a newline and didn't just output a whitespace
+	  // character, insert one.
+	  if(loc<desc.size() && par.size()>0 && par[par.size()-1]!=' ')
+	    par+=L" ";
+
+	  // Skip the newline
+	  if(loc<desc.size())
+	    ++loc;
+
+	  // Update start.
+	  start=loc;
+
+	  // Find how much indentation this line has.
+	  nspaces=0;
+	  while(loc<desc.size() && desc[loc]==L' ')
+	    {
+	      ++loc;
+	      ++nspaces;
+	    }
+
+	  // Check if we should continue (if not, we back up and
+	  // start parsing again from "start").  Note that *any*
+	  // change in the indentation requires us to restart --
+	  // more indentation is a literal line, while less means
+	  // we should exit this indent level.
+	  if(nspaces != indent)
+	    cont=false;
+	  else if(loc>=desc.size())
+	    cont=false;
+	  else if(nspaces == 1 && desc[loc] == '.')
+	    cont=false;
+	} while(cont);
+
+	output.push_back(aptitude::description_element::make_paragraph(par));
+      }
     }
+
+  return true;
+}
+
+static void make_level_fragment(const wstring &desc,
+				wstring::size_type indent,
+				wstring::size_type &start,
+				bool recognize_bullets,
+				std::vector<aptitude::description_element_ref> &output)
+{
+  bool first=true;
+
+  while(make_level_element(desc, indent, start, first,
+			   recognize_bullets, output))
+    ;
+}
+
+/** \return the location of the long description in desc: after the
+ *  short description and the leading space of the first line.
+ */
+static wstring::size_type find_long_description(const wstring &desc)
+{
+  wstring::size_type loc = 0;
+
+  // Skip the short description
+  while(loc < desc.size() && desc[loc]!=L'\n')
+    ++loc;
+
+  if(loc < desc.size()) // Skip the '\n'
+    ++loc;
+
+  // Skip leading whitespace on the first line if there is any.
+  if(loc<desc.size() && desc[loc] == L' ')
+    ++loc;
+
+  return loc;
+}
+
+static bool get_recognize_bullets()
+{
+  return aptcfg->FindB(PACKAGE "::Parse-Description-Bullets", true);
 }
 
 namespace aptitude
@@ -244,25 +299,83 @@ namespace aptitude
   void parse_desc(const std::wstring &desc,
 		  std::vector<description_element_ref> &output)
   {
-    wstring::size_type loc = 0;
-
-    // Skip the short description
-    while(loc < desc.size() && desc[loc]!=L'\n')
-      ++loc;
-
-    if(loc < desc.size()) // Skip the '\n'
-      ++loc;
-
-    // Skip leading whitespace on the first line if there is any.
-    if(loc<desc.size() && desc[loc] == L' ')
-      ++loc;
+    wstring::size_type loc = find_long_description(desc);
 
     // The initial indentation level is 1 because in a Packages file,
     // all Description lines get at least one character of indentation
     // and we want to strip that off.
-    make_level_fragment(desc, 1, loc,
-			aptcfg->FindB(PACKAGE "::Parse-Description-Bullets",
-				      true),
-			output);
+    make_level_fragment(desc, 1, loc, get_recognize_bullets(), output);
+  }
+
+  lazy_description::lazy_description()
+    : recognize_bullets(false)
+  {
+    init();
+  }
+
+  lazy_description::lazy_description(const std::wstring &_desc)
+    : desc(_desc), recognize_bullets(get_recognize_bullets())
+  {
+    init();
+  }
+
+  lazy_description::lazy_description(const std::wstring &_desc,
+				     bool _recognize_bullets)
+    : desc(_desc), recognize_bullets(_recognize_bullets)
+  {
+    init();
+  }
+
+  void lazy_description::init()
+  {
+    next = find_long_description(desc);
+    next_line = 0;
+    finished = next >= desc.size();
+  }
+
+  void lazy_description::parse_next()
+  {
+    if(finished)
+      return;
+
+    const wstring::size_type start = next;
+    const std::vector<description_element_ref>::size_type old_size = elements.size();
+
+    // Only the first element skips the indentation check, since
+    // find_long_description() already skipped its leading space.
+    bool first = elements.empty();
+    if(!make_level_element(desc, 1, next, first,
+			   recognize_bullets, elements))
+      finished = true;
+
+    for(std::vector<description_element_ref>::size_type i = old_size;
+	i < elements.size(); ++i)
+      element_lines.push_back(next_line);
+
+    for(wstring::size_type i = start; i < next; ++i)
+      if(desc[i] == L'\n')
+	++next_line;
+
+    if(next >= desc.size())
+      finished = true;
+  }
+
+  const std::vector<description_element_ref> &lazy_description::get_elements()
+  {
+    while(!finished)
+      parse_next();
+
+    return elements;
+  }
+
+  void lazy_description::get_first_lines(unsigned int lines,
+					 std::vector<description_element_ref> &output)
+  {
+    while(!finished && next_line < lines)
+      parse_next();
+
+    for(std::vector<description_element_ref>::size_type i = 0;
+	i < elements.size() && element_lines[i] < lines; ++i)
+      output.push_back(elements[i]);
   }
 }
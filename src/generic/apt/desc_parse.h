@@ -174,6 +174,71 @@ namespace aptitude
    */
   void parse_desc(const std::wstring &desc,
 		  std::vector<description_element_ref> &output);
+
+  /** \brief A description that is parsed as far as it is read.
+   *
+   *  Creating one only copies the text; its top-level elements are
+   *  parsed in order, the first time an element at or past them is
+   *  requested, and kept.  Code that only shows the beginning of a
+   *  description, or that fetches descriptions in advance, never pays
+   *  for parsing the rest.
+   */
+  class lazy_description
+  {
+    std::wstring desc;
+    bool recognize_bullets;
+
+    /** \brief Where parsing resumes, or desc.size() once the whole
+     *  description has been parsed.
+     */
+    std::wstring::size_type next;
+    /** \brief The line of the long description on which next lies,
+     *  counting from 0.
+     */
+    unsigned int next_line;
+    bool finished;
+
+    std::vector<description_element_ref> elements;
+    /** \brief The line on which each element of elements begins. */
+    std::vector<unsigned int> element_lines;
+
+    void init();
+
+    /** \brief Parse one more top-level element, if there is one. */
+    void parse_next();
+
+  public:
+    /** \brief Create an empty description. */
+    lazy_description();
+
+    /** \brief Create a description from the same text as
+     *  parse_desc() takes, recognizing bullets as configured.
+     */
+    explicit lazy_description(const std::wstring &desc);
+
+    /** \brief Create a description from the same text as
+     *  parse_desc() takes.
+     *
+     *  \param recognize_bullets  \b true if bulleted lists should be
+     *  parsed as lists rather than literal text.
+     */
+    lazy_description(const std::wstring &desc, bool recognize_bullets);
+
+    /** \brief Retrieve every top-level element, parsing the rest of
+     *  the description if necessary.
+     */
+    const std::vector<description_element_ref> &get_elements();
+
+    /** \brief Retrieve the top-level elements that begin on one of
+     *  the first few lines of the long description.
+     *
+     *  \param lines          how many lines of the long description to
+     *                        return the elements of.
+     *  \param[out] output    the elements; they are appended to it.
+     */
+    void get_first_lines(unsigned int lines,
+			 std::vector<description_element_ref> &output);
+  };
 }
 
 #endif
@@ -24,12 +24,22 @@
 #include "log.h"
 
 #include <aptitude.h>
+#include <loggers.h>
 
 #include <apt-pkg/acquire-item.h>
 #include <apt-pkg/dpkgpm.h>
 #include <apt-pkg/error.h>
+#include <apt-pkg/fileutl.h>
 #include <apt-pkg/sourcelist.h>
 
+#include <boost/make_shared.hpp>
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <generic/util/logging.h>
+#include <generic/util/run_metrics.h>
+#include <generic/util/timings.h>
+
 #include <sigc++/bind.h>
 
 #include <pthread.h>
@@ -37,18 +47,280 @@
 
 using namespace std;
 
+namespace cw = cwidget;
+
+using aptitude::Loggers;
+
+/** \brief A package manager that can leave out the archives that
+ *  haven't been downloaded yet.
+ */
+class pipelined_dpkg_pm : public pkgDPkgPM
+{
+public:
+  pipelined_dpkg_pm(pkgDepCache *cache)
+    : pkgDPkgPM(cache)
+  {
+  }
+
+  /** \brief Forget every archive that isn't on disk yet.
+   *
+   *  The install then stops, returning Incomplete, at the first
+   *  package in the install order that needs one of them.  Must be
+   *  invoked after FixMissing(), which would otherwise keep those
+   *  packages back.
+   */
+  void forget_missing_archives()
+  {
+    const unsigned long count = Cache.Head().PackageCount;
+    for(unsigned long i = 0; i < count; ++i)
+      {
+	// Archives that are ready have been moved to their final,
+	// absolute location.
+	const string &name = FileNames[i];
+	if(!name.empty() && (name[0] != '/' || !FileExists(name)))
+	  FileNames[i].clear();
+      }
+  }
+};
+
+/** \brief The status object of the background fetcher, used to stop
+ *  it early.
+ */
+class prefetch_status : public pkgAcquireStatus
+{
+  cw::threads::mutex cancel_mutex;
+  bool canceled;
+
+public:
+  prefetch_status()
+    : canceled(false)
+  {
+  }
+
+  void cancel()
+  {
+    cw::threads::mutex::lock l(cancel_mutex);
+    canceled = true;
+  }
+
+  bool Pulse(pkgAcquire *Owner)
+  {
+    pkgAcquireStatus::Pulse(Owner);
+
+    cw::threads::mutex::lock l(cancel_mutex);
+    return !canceled;
+  }
+
+  bool MediaChange(std::string, std::string)
+  {
+    // Anything on a CD is fetched in the foreground.
+    return false;
+  }
+};
+
+namespace
+{
+  /** \return \b true if the item's file is already on disk. */
+  bool item_ready(const pkgAcquire::Item *item)
+  {
+    return item->Status == pkgAcquire::Item::StatDone && item->Complete;
+  }
+
+  /** \brief Drop the items of a fetcher that aren't already
+   *  downloaded, except for a batch at the front of the queue.
+   *
+   *  The archives are queued in the order they will be installed
+   *  in, so the batch that is kept is the next one to install.
+   *
+   *  \param batch_size  How many bytes to keep.  At least one item is
+   *                     always kept.
+   *  \param kept        The destination files of the items that
+   *                     were kept are stored here.
+   *
+   *  \return the number of items that were dropped.
+   */
+  int keep_first_batch(pkgAcquire *fetcher,
+		       unsigned long long batch_size,
+		       std::set<std::string> &kept)
+  {
+    std::vector<pkgAcquire::Item *> dropped;
+    unsigned long long total = 0;
+
+    for(pkgAcquire::ItemIterator i = fetcher->ItemsBegin();
+	i != fetcher->ItemsEnd(); ++i)
+      {
+	if(item_ready(*i))
+	  continue;
+
+	if(kept.empty() || total + (*i)->FileSize <= batch_size)
+	  {
+	    total += (*i)->FileSize;
+	    kept.insert((*i)->DestFile);
+	  }
+	else
+	  dropped.push_back(*i);
+      }
+
+    // Deleting an item removes it from its fetcher.
+    for(std::vector<pkgAcquire::Item *>::const_iterator it = dropped.begin();
+	it != dropped.end(); ++it)
+      delete *it;
+
+    return dropped.size();
+  }
+
+  unsigned long long get_batch_size()
+  {
+    const int megabytes = aptcfg->FindI(PACKAGE "::Pipelined-Install::Batch-Size", 64);
+    return (unsigned long long)(megabytes < 1 ? 1 : megabytes) * 1024 * 1024;
+  }
+
+  class run_prefetch
+  {
+    pkgAcquire *prefetcher;
+
+  public:
+    run_prefetch(pkgAcquire *_prefetcher)
+      : prefetcher(_prefetcher)
+    {
+    }
+
+    void operator()() const
+    {
+      const pkgAcquire::RunResult res = prefetcher->Run();
+
+      LOG_DEBUG(Loggers::getAptitudeInstallPipeline(),
+		"The background fetch finished with result " << res);
+
+      // Any errors will be reported when the archives are fetched
+      // in the foreground.
+      _error->Discard();
+    }
+  };
+}
+
 download_install_manager::download_install_manager(bool _download_only,
 						   const run_dpkg_in_terminal_func &_run_dpkg_in_terminal)
-  : log(NULL), download_only(_download_only), pm(new pkgDPkgPM(*apt_cache_file)),
+  : log(NULL), download_only(_download_only), pm(new pipelined_dpkg_pm(*apt_cache_file)),
+    pipelined(!_download_only && aptcfg->FindB(PACKAGE "::Pipelined-Install", false)),
+    deferred_archives(false),
+    prefetched_last_round(false),
+    prefetch_pm(NULL),
+    prefetcher(NULL),
+    prefetcher_status(NULL),
+    changes_logged(false),
     run_dpkg_in_terminal(_run_dpkg_in_terminal)
 {
 }
 
 download_install_manager::~download_install_manager()
 {
+  finish_prefetch(true);
   delete pm;
 }
 
+void download_install_manager::select_round_archives()
+{
+  std::set<std::string> kept;
+  int num_dropped;
+
+  if(!prefetched_last_round)
+    // Nothing has been fetched ahead of time, so download the first
+    // batch now.
+    num_dropped = keep_first_batch(fetcher, get_batch_size(), kept);
+  else
+    {
+      // The archives of this round were fetched during the last one;
+      // only fetch the ones that didn't make it.
+      std::vector<pkgAcquire::Item *> dropped;
+      for(pkgAcquire::ItemIterator i = fetcher->ItemsBegin();
+	  i != fetcher->ItemsEnd(); ++i)
+	{
+	  if(item_ready(*i))
+	    continue;
+
+	  if(prefetched.find((*i)->DestFile) != prefetched.end())
+	    kept.insert((*i)->DestFile);
+	  else
+	    dropped.push_back(*i);
+	}
+
+      for(std::vector<pkgAcquire::Item *>::const_iterator it = dropped.begin();
+	  it != dropped.end(); ++it)
+	delete *it;
+
+      num_dropped = dropped.size();
+    }
+
+  deferred_archives = num_dropped > 0;
+
+  LOG_INFO(Loggers::getAptitudeInstallPipeline(),
+	   "Fetching " << kept.size() << " archives in this round, leaving "
+	   << num_dropped << " for later rounds.");
+}
+
+void download_install_manager::start_prefetch()
+{
+  prefetched.clear();
+  prefetched_last_round = false;
+
+  prefetch_pm = new pipelined_dpkg_pm(*apt_cache_file);
+  prefetcher_status = new prefetch_status;
+  prefetcher = new pkgAcquire;
+  prefetcher->Setup(prefetcher_status);
+
+  // A separate package manager keeps the fetcher from writing to
+  // the file names that dpkg is using.
+  if(!prefetch_pm->GetArchives(prefetcher, &src_list, apt_package_records))
+    {
+      LOG_WARN(Loggers::getAptitudeInstallPipeline(),
+	       "Couldn't queue the next batch of archives; they will be fetched in the next round.");
+      _error->Discard();
+      finish_prefetch(true);
+      return;
+    }
+
+  keep_first_batch(prefetcher, get_batch_size(), prefetched);
+
+  if(prefetched.empty())
+    {
+      finish_prefetch(true);
+      return;
+    }
+
+  LOG_INFO(Loggers::getAptitudeInstallPipeline(),
+	   "Fetching the next " << prefetched.size()
+	   << " archives in the background.");
+
+  prefetched_last_round = true;
+  prefetch_thread = boost::make_shared<cw::threads::thread>(run_prefetch(prefetcher));
+}
+
+void download_install_manager::finish_prefetch(bool cancel)
+{
+  if(prefetch_thread.get() != NULL)
+    {
+      if(cancel)
+	prefetcher_status->cancel();
+      else
+	LOG_DEBUG(Loggers::getAptitudeInstallPipeline(),
+		  "Waiting for the background fetch to finish.");
+
+      prefetch_thread->join();
+      prefetch_thread.reset();
+    }
+
+  if(prefetcher != NULL)
+    prefetcher->Shutdown();
+
+  delete prefetcher;
+  prefetcher = NULL;
+  delete prefetcher_status;
+  prefetcher_status = NULL;
+  delete prefetch_pm;
+  prefetch_pm = NULL;
+}
+
 bool download_install_manager::prepare(OpProgress &progress,
 				       pkgAcquireStatus &acqlog,
 				       download_signal_log *signallog)
@@ -89,6 +361,10 @@ bool download_install_manager::prepare(OpProgress &progress,
       return false;
     }
 
+  // Archives rebuilt here are already in place when the fetcher
+  // looks for them, so it skips them.
+  delta_statistics = aptitude::apt::rebuild_upgrades_from_deltas();
+
   fetcher = new pkgAcquire;
   fetcher->Setup(&acqlog);
 
@@ -102,6 +378,12 @@ bool download_install_manager::prepare(OpProgress &progress,
       return false;
     }
 
+  if(pipelined)
+    select_round_archives();
+
+  aptitude::util::record_install((*apt_cache_file)->InstCount(),
+				 (*apt_cache_file)->DelCount());
+
   return true;
 }
 
@@ -134,13 +416,21 @@ download_manager::result download_install_manager::finish_pre_dpkg(pkgAcquire::R
       return failure;
     }
 
-  log_changes();
+  if(!changes_logged)
+    {
+      log_changes();
+      changes_logged = true;
+    }
 
   // Note that someone could grab the lock before dpkg takes it;
   // without a more complicated synchronization protocol (and I don't
   // control the code at dpkg's end), them's the breaks.
   apt_cache_file->ReleaseLock();
 
+  // Stop the install at the first archive of a later batch.
+  if(deferred_archives)
+    pm->forget_missing_archives();
+
   result rval = success;
 
   const pkgPackageManager::OrderResult pre_fork_result =
@@ -148,6 +438,13 @@ download_manager::result download_install_manager::finish_pre_dpkg(pkgAcquire::R
 
   if(pre_fork_result == pkgPackageManager::Failed)
     rval = failure;
+  else if(deferred_archives)
+    // The list of files to install has been copied out of the
+    // package manager, so it's safe to start fetching the next batch
+    // while dpkg runs.
+    start_prefetch();
+  else
+    prefetched_last_round = false;
 
   return rval;
 }
@@ -159,7 +456,11 @@ pkgPackageManager::OrderResult download_install_manager::run_dpkg(int status_fd)
   sigfillset(&allsignals);
 
   pthread_sigmask(SIG_UNBLOCK, &allsignals, &oldsignals);
-  pkgPackageManager::OrderResult pmres = pm->DoInstallPostFork(status_fd);
+  pkgPackageManager::OrderResult pmres;
+  {
+    aptitude::util::phase_timer timer("dpkg");
+    pmres = pm->DoInstallPostFork(status_fd);
+  }
 
   switch(pmres)
     {
@@ -199,6 +500,11 @@ void download_install_manager::finish_post_dpkg(pkgPackageManager::OrderResult d
       break;
     }
 
+  // The next round mustn't start downloading the archives that the
+  // background fetcher is working on, so wait for it.  If the install
+  // failed, there won't be a next round.
+  finish_prefetch(rval == failure);
+
   fetcher->Shutdown();
 
   // Get the archives again.  This was necessary for multi-CD
@@ -212,6 +518,8 @@ void download_install_manager::finish_post_dpkg(pkgPackageManager::OrderResult d
       _error->Error(_("Could not regain the system lock!  (Perhaps another apt or dpkg is running?)"));
       rval = failure;
     }
+  else if(rval == do_again && pipelined)
+    select_round_archives();
 
   if(rval != do_again)
     {
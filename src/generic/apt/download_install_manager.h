@@ -23,6 +23,7 @@
 #include "download_manager.h"
 
 #include "apt.h"
+#include "delta_download.h"
 
 #include <apt-pkg/packagemanager.h> // For OrderResult
 #include <apt-pkg/pkgcache.h>       // For logging
@@ -30,6 +31,10 @@
 
 #include <sigc++/signal.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -50,6 +55,17 @@ typedef sigc::slot2<void,
 		    sigc::slot1<pkgPackageManager::OrderResult, int>,
 		    sigc::slot1<void, pkgPackageManager::OrderResult> > run_dpkg_in_terminal_func;
 
+namespace cwidget
+{
+  namespace threads
+  {
+    class thread;
+  }
+}
+
+class pipelined_dpkg_pm;
+class prefetch_status;
+
 /** Manages downloading and installing packages. */
 class download_install_manager : public download_manager
 {
@@ -60,7 +76,68 @@ class download_install_manager : public download_manager
   bool download_only;
 
   /** The package manager object used when installing packages */
-  pkgPackageManager *pm;
+  pipelined_dpkg_pm *pm;
+
+  /** \brief If \b true, packages are installed in batches, each one
+   *  as soon as its archives are downloaded, while the archives of
+   *  the next batch are fetched in the background.
+   *
+   *  Each batch is one round of the install process: dpkg stops
+   *  (returning Incomplete) at the first package whose archive isn't
+   *  available yet, and finish() asks the caller to go again.
+   */
+  bool pipelined;
+
+  /** \brief \b true if some archives were left out of the current
+   *  round, to be installed in a later one.
+   */
+  bool deferred_archives;
+
+  /** \brief \b true if the archives of the current round were
+   *  fetched in the background during the last round.
+   */
+  bool prefetched_last_round;
+
+  /** \brief The destination files of the archives that were handed
+   *  to the background fetcher in the last round.
+   *
+   *  Any of these that didn't arrive are fetched in the foreground,
+   *  so that their errors are reported as usual.
+   */
+  std::set<std::string> prefetched;
+
+  /** \brief The objects used to fetch the next batch of archives
+   *  while dpkg runs, or \b NULL if nothing is being fetched.
+   */
+  pipelined_dpkg_pm *prefetch_pm;
+  pkgAcquire *prefetcher;
+  prefetch_status *prefetcher_status;
+  boost::shared_ptr<cwidget::threads::thread> prefetch_thread;
+
+  /** \brief \b true once the changes have been written to the log. */
+  bool changes_logged;
+
+  /** \brief The archives that prepare() rebuilt from deltas. */
+  aptitude::apt::delta_download_statistics delta_statistics;
+
+  /** \brief Remove from the fetcher the archives that shouldn't be
+   *  downloaded in this round.
+   *
+   *  Only invoked in pipelined mode, after the archives are queued.
+   */
+  void select_round_archives();
+
+  /** \brief Start fetching the next batch of archives in a
+   *  background thread.
+   */
+  void start_prefetch();
+
+  /** \brief Wait for the background fetch, if any, to finish.
+   *
+   *  \param cancel  If \b true, stop the fetch instead of waiting
+   *                 for the archives to arrive.
+   */
+  void finish_prefetch(bool cancel);
 
   /** The list of sources from which to download. */
   pkgSourceList src_list;
@@ -150,6 +227,14 @@ public:
 	      OpProgress *progress,
 	      const sigc::slot1<void, download_manager::result> &k);
 
+  /** \return the archives that were rebuilt from deltas instead of
+   *  being downloaded.
+   */
+  const aptitude::apt::delta_download_statistics &get_delta_statistics() const
+  {
+    return delta_statistics;
+  }
+
   /** Invoked after an automatic 'forget new' operation. */
   sigc::signal0<void> post_forget_new_hook;
 };
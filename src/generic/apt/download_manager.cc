@@ -19,6 +19,29 @@
 
 #include "download_manager.h"
 
+#include <generic/util/run_metrics.h>
+
+#include <apt-pkg/acquire-item.h>
+
+namespace
+{
+  /** \brief Record the files that a fetcher is about to download in
+   *  the run metrics.
+   */
+  void record_fetch(pkgAcquire &fetcher)
+  {
+    unsigned long items = 0;
+    for(pkgAcquire::ItemIterator it = fetcher.ItemsBegin();
+	it != fetcher.ItemsEnd(); ++it)
+      if(!(*it)->Local && !(*it)->Complete)
+	++items;
+
+    const unsigned long long needed = fetcher.FetchNeeded();
+    const unsigned long long present = fetcher.PartialPresent();
+    aptitude::util::record_download(items, needed > present ? needed - present : 0);
+  }
+}
+
 download_manager::download_manager()
   : fetcher(NULL)
 {
@@ -31,10 +54,12 @@ download_manager::~download_manager()
 
 pkgAcquire::RunResult download_manager::do_download()
 {
+  record_fetch(*fetcher);
   return fetcher->Run();
 }
 
 pkgAcquire::RunResult download_manager::do_download(int PulseInterval)
 {
+  record_fetch(*fetcher);
   return fetcher->Run(PulseInterval);
 }
@@ -20,6 +20,7 @@
 
 #include "download_queue.h"
 
+#include <aptitude.h>
 #include <loggers.h>
 
 #include <generic/apt/apt.h>
@@ -37,6 +38,7 @@
 #include <boost/unordered_map.hpp>
 #include <boost/weak_ptr.hpp>
 
+#include <algorithm>
 #include <list>
 
 #include <sigc++/bind.h>
@@ -410,13 +412,23 @@ namespace aptitude
       // filled in and added to the download queue.
       bool canceled;
 
+      // True if cancel() has been invoked.  Unlike "canceled", this
+      // is set immediately, so that a request that is still waiting
+      // to start can be dropped without ever reaching apt.  Protected
+      // by the download thread's state mutex.
+      bool cancel_requested;
+
     public:
       /** \brief Create an unconnected download request. */
       download_request_impl()
-	: canceled(false)
+	: canceled(false),
+	  cancel_requested(false)
       {
       }
 
+      bool get_cancel_requested() const { return cancel_requested; }
+      void set_cancel_requested() { cancel_requested = true; }
+
       /** \brief Associate this request with a particular active
        *  download.
        */
@@ -470,6 +482,10 @@ namespace aptitude
 	boost::shared_ptr<download_callbacks> callbacks;
 	post_thunk_f post_thunk;
 
+	download_priority priority;
+	// The host part of the URI; used to apply the per-host limit.
+	std::string host;
+
 	// When the cached file was last modified, or 0 to not set the
 	// last modified time in the HTTP header.  This member is
 	// initially 0 and is updated if the file is found in the
@@ -487,12 +503,15 @@ namespace aptitude
 		      const temp::name &_filename,
 		      const boost::shared_ptr<download_callbacks> &_callbacks,
 		      post_thunk_f _post_thunk,
+		      download_priority _priority,
 		      const boost::shared_ptr<download_request_impl> &_request)
 	  : uri(_uri),
 	    short_description(_short_description),
 	    filename(_filename),
 	    callbacks(_callbacks),
 	    post_thunk(_post_thunk),
+	    priority(_priority),
+	    host(::URI(_uri).Host),
 	    last_modified_time(0),
 	    request(_request)
 	{
@@ -505,6 +524,8 @@ namespace aptitude
 	time_t get_last_modified_time() const { return last_modified_time; }
 	const boost::shared_ptr<download_callbacks> &get_callbacks() const { return callbacks; }
 	post_thunk_f get_post_thunk() const { return post_thunk; }
+	download_priority get_priority() const { return priority; }
+	const std::string &get_host() const { return host; }
 	const boost::shared_ptr<download_request_impl> &get_request() const { return request; }
 
 	void update_from_cache(const temp::name &new_filename,
@@ -515,6 +536,16 @@ namespace aptitude
 	}
       };
 
+      /** \brief Orders start requests by priority. */
+      struct start_request_priority_lt
+      {
+	bool operator()(const boost::shared_ptr<start_request> &r1,
+			const boost::shared_ptr<start_request> &r2) const
+	{
+	  return r1->get_priority() < r2->get_priority();
+	}
+      };
+
       /** \brief A background thread that looks up files in the cache.
        *
        *  Requests are passed along to the main download thread after
@@ -595,16 +626,8 @@ namespace aptitude
 	      return false;
 	    }
 
-	  for(std::deque<boost::shared_ptr<start_request> >::const_iterator it =
-		start_requests.begin();
-	      it != start_requests.end(); ++it)
-	    {
-	      const start_request &req(**it);
-
-	      process_start_request(req, *Owner);
-	    }
-	  start_requests.clear();
-
+	  // Process cancellations first, so that a request that was
+	  // canceled before it started is never handed to apt.
 	  for(std::deque<boost::shared_ptr<download_request_impl> >::const_iterator it =
 		cancel_requests.begin(); it != cancel_requests.end(); ++it)
 	    {
@@ -612,6 +635,8 @@ namespace aptitude
 	    }
 	  cancel_requests.clear();
 
+	  process_start_requests(*Owner);
+
 	  for(pkgAcquire::Worker *w = Owner->WorkersBegin();
 	      w != NULL; w = Owner->WorkerStep(w))
 	    {
@@ -734,6 +759,14 @@ namespace aptitude
       {
 	cw::threads::mutex::lock l(state_mutex);
 
+	if(job->get_request()->get_cancel_requested())
+	  {
+	    LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
+		      "Not queuing a download of " << job->get_uri()
+		      << ": it was canceled.");
+	    return;
+	  }
+
 	start_requests.push_back(job);
 	ensure_background_thread();
       }
@@ -775,6 +808,97 @@ namespace aptitude
 						  req.get_post_thunk()));
       }
 
+      /** \brief Attach a start request to a download of the same URI
+       *  that is already running.
+       *
+       *  All the listeners of a job are notified when it finishes, so
+       *  the file is only fetched once no matter how many times it
+       *  was requested.
+       */
+      static void join_active_download(const start_request &req,
+				       const boost::shared_ptr<download_job> &job)
+      {
+	cw::threads::mutex::lock l(state_mutex);
+
+	LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
+		  "Attaching a request for " << req.get_uri()
+		  << " to the download that is already running.");
+
+	req.get_request()->bind(job,
+				job->add_listener(req.get_callbacks(),
+						  req.get_post_thunk()));
+      }
+
+      /** \brief Hand as many waiting start requests to the Acquire
+       *  queue as the per-host limits allow.
+       *
+       *  Requests are considered in order of priority.  A request
+       *  for a URI that is already being downloaded joins the running
+       *  download instead of starting a new one.  Requests that can't
+       *  be started yet are left in start_requests, to be retried on
+       *  the next Pulse() or by the next Acquire run.
+       */
+      static void process_start_requests(pkgAcquire &acquireQueue)
+      {
+	cw::threads::mutex::lock l(state_mutex);
+
+	if(start_requests.empty())
+	  return;
+
+	const int max_per_host =
+	  std::max(1, aptcfg->FindI(PACKAGE "::Download-Queue::Max-Per-Host", 4));
+
+	boost::unordered_map<std::string, int> active_per_host;
+	for(boost::unordered_map<std::string, boost::shared_ptr<active_download_info> >::const_iterator
+	      it = active_downloads.begin(); it != active_downloads.end(); ++it)
+	  ++active_per_host[::URI(it->first).Host];
+
+	std::stable_sort(start_requests.begin(), start_requests.end(),
+			 start_request_priority_lt());
+
+	std::deque<boost::shared_ptr<start_request> > waiting;
+	for(std::deque<boost::shared_ptr<start_request> >::const_iterator it =
+	      start_requests.begin();
+	    it != start_requests.end(); ++it)
+	  {
+	    const start_request &req(**it);
+
+	    if(req.get_request()->get_cancel_requested())
+	      {
+		LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
+			  "Dropping the canceled download of " << req.get_uri());
+		continue;
+	      }
+
+	    // If the URI is already being downloaded, just listen to
+	    // that download; this doesn't need a slot.
+	    boost::unordered_map<std::string, boost::shared_ptr<active_download_info> >::const_iterator
+	      found = active_downloads.find(req.get_uri());
+	    if(found != active_downloads.end())
+	      {
+		join_active_download(req, found->second->get_job());
+		continue;
+	      }
+
+	    int &num_active(active_per_host[req.get_host()]);
+	    if(num_active >= max_per_host ||
+	       (req.get_priority() == download_priority_low && num_active > 0))
+	      {
+		waiting.push_back(*it);
+		continue;
+	      }
+
+	    process_start_request(req, acquireQueue);
+	    ++num_active;
+	  }
+
+	if(!waiting.empty())
+	  LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
+		    waiting.size() << " downloads are waiting for a free slot.");
+
+	start_requests.swap(waiting);
+      }
+
     public:
       download_thread()
       {
@@ -785,7 +909,8 @@ namespace aptitude
       start_download_job(const std::string &uri,
 			 const std::string &short_description,
 			 const boost::shared_ptr<download_callbacks> &callbacks,
-			 post_thunk_f post_thunk)
+			 post_thunk_f post_thunk,
+			 download_priority priority)
       {
 	cw::threads::mutex::lock l(state_mutex);
 
@@ -806,6 +931,7 @@ namespace aptitude
 					    temp::name("aptitudeDownload"),
 					    callbacks,
 					    post_thunk,
+					    priority,
 					    rval);
 
 	cache_lookup_thread::add_job(start);
@@ -829,6 +955,20 @@ namespace aptitude
 	    return;
 	  }
 
+	req->set_cancel_requested();
+
+	// If the download is still waiting for a slot, it can be
+	// dropped right away.  (if it's still being looked up in the
+	// cache, queue_job() will drop it)
+	for(std::deque<boost::shared_ptr<start_request> >::iterator it =
+	      start_requests.begin(); it != start_requests.end(); )
+	  {
+	    if((*it)->get_request() == req)
+	      it = start_requests.erase(it);
+	    else
+	      ++it;
+	  }
+
 	cancel_requests.push_back(req);
 
 	ensure_background_thread();
@@ -924,29 +1064,27 @@ namespace aptitude
 	    LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
 		      "Setting up the download process for the background download queue.");
 
-	    download_callback cb;
-	    pkgAcquire downloader;
-            downloader.Setup(&cb);
-
-	    for(std::deque<boost::shared_ptr<start_request> >::const_iterator it =
-		  start_requests.begin();
-		it != start_requests.end(); ++it)
-	      {
-		const start_request &request = **it;
+	    {
+	      download_callback cb;
+	      pkgAcquire downloader;
+	      downloader.Setup(&cb);
 
-		process_start_request(request, downloader);
-	      }
+	      process_start_requests(downloader);
 
-	    start_requests.clear();
+	      LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
+			"Running the current download queue.");
 
-	    LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
-		      "Running the current download queue.");
+	      l.release();
 
-	    l.release();
+	      downloader.Run();
 
-	    downloader.Run();
+	      l.acquire();
+	    }
 
-	    l.acquire();
+	    // Anything left in the map belonged to the Acquire object
+	    // that was just destroyed; it mustn't count against the
+	    // per-host limits of the next one.
+	    active_downloads.clear();
 	  }
 
 	LOG_TRACE(Loggers::getAptitudeDownloadQueue(),
@@ -1023,10 +1161,12 @@ namespace aptitude
   queue_download(const std::string &uri,
 		 const std::string &short_description,
 		 const boost::shared_ptr<download_callbacks> &callbacks,
-		 post_thunk_f post_thunk)
+		 post_thunk_f post_thunk,
+		 download_priority priority)
   {
     return download_thread::start_download_job(uri, short_description,
-					       callbacks, post_thunk);
+					       callbacks, post_thunk,
+					       priority);
   }
 
   void shutdown_download_queue()
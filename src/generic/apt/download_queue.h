@@ -96,15 +96,36 @@ namespace aptitude
 
     /** \brief Cancel this download request.
      *
-     *  This is safe to call from any thread.  There is no guarantee
-     *  that the download won't complete anyway, but if it hasn't
-     *  completed by the next call to Pulse() (once a second or so),
-     *  it will be canceled.  Even if it does complete, the callbacks
-     *  won't be invoked.
+     *  This is safe to call from any thread.  If the download hasn't
+     *  started yet, it is removed from the queue immediately.
+     *  Otherwise there is no guarantee that the download won't
+     *  complete anyway, but if it hasn't completed by the next call
+     *  to Pulse() (once a second or so), it will be canceled.  Even
+     *  if it does complete, the callbacks won't be invoked.
      */
     virtual void cancel() = 0;
   };
 
+  /** \brief How urgently a download is needed.
+   *
+   *  Downloads that are waiting to start are started in order of
+   *  priority, and downloads of the same priority are started in the
+   *  order they were queued.
+   */
+  enum download_priority
+    {
+      /** \brief Something the user asked for and is waiting to see. */
+      download_priority_high,
+      /** \brief The default priority. */
+      download_priority_normal,
+      /** \brief Something that might be needed later.
+       *
+       *  Low-priority downloads from a host are only started when
+       *  nothing else is being downloaded from that host.
+       */
+      download_priority_low
+    };
+
   /** \brief Add a new download to the background thread's queue.
    *
    *  \param uri          The URI to download.
@@ -118,13 +139,20 @@ namespace aptitude
    *  \param post_thunk   A function used to pass download events to
    *                      the main thread.
    *
+   *  \param priority     How urgently the download is needed.
+   *
+   *  At most Aptitude::Download-Queue::Max-Per-Host downloads from
+   *  any one host are handed to apt at a time; the rest wait in the
+   *  queue, where canceling them doesn't cost any network traffic.
+   *
    *  \return a handle that can be used to cancel the download.
    */
   boost::shared_ptr<download_request>
   queue_download(const std::string &uri,
 		 const std::string &short_description,
 		 const boost::shared_ptr<download_callbacks> &callbacks,
-		 post_thunk_f post_thunk);
+		 post_thunk_f post_thunk,
+		 download_priority priority = download_priority_normal);
 
   /** \brief Shut down the background thread and clear its data
    *  structures; used to abort all processing when the program is
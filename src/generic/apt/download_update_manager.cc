@@ -29,11 +29,16 @@
 #include <apt-pkg/error.h>
 #include <apt-pkg/algorithms.h>
 
+#include <loggers.h>
+
+#include <generic/util/logging.h>
+
 #include <cwidget/generic/util/exception.h>
 #include <cwidget/generic/util/ssprintf.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -203,15 +208,16 @@ namespace
     std::string errmsg() const { return msg; }
   };
 
-  /** \brief Run a subprocess and redirect its output to /dev/null.
+  /** \brief Start a subprocess with its output redirected to
+   *  /dev/null.
    *
    *  $PATH is not searched, and the arguments are passed directly to
-   *  the subprocess without shell intervention.  The return value is
-   *  the status of the subcommand as it would be returned from
-   *  waitpid().
+   *  the subprocess without shell intervention.
+   *
+   *  \return the process ID of the subprocess.
    */
-  int run_in_subprocess_to_devnull(const std::string &command,
-				   const std::vector<std::string> &args)
+  pid_t start_subprocess_to_devnull(const std::string &command,
+				    const std::vector<std::string> &args)
   {
     // Merge any new information in the apt cache into the debtags cache
     // by running 'debtags update'.  Be safe here: don't risk running
@@ -259,96 +265,133 @@ namespace
 	exit(execv(command.c_str(), argv));
       }
     else
+      return pid;
+  }
+
+  /** \brief Wait for a subprocess started by
+   *  start_subprocess_to_devnull().
+   *
+   *  \return the status of the subcommand as it would be returned
+   *  from waitpid().
+   */
+  int wait_for_subprocess(pid_t pid)
+  {
+    while(true)
       {
-	while(true)
+	int status = 0;
+	errno = 0;
+	if(waitpid(pid, &status, 0) == pid)
+	  return status;
+	else if(errno != EINTR)
 	  {
-	    int status = 0;
-	    errno = 0;
-	    if(waitpid(pid, &status, 0) == pid)
-	      return status;
-	    else if(errno != EINTR)
-	      {
-		int errnum = errno;
-		throw SubprocessException(cw::util::ssprintf(_("waitpid() failed: %s"),
-							     cw::util::sstrerror(errnum).c_str()));
-	      }
+	    int errnum = errno;
+	    throw SubprocessException(cw::util::ssprintf(_("waitpid() failed: %s"),
+							 cw::util::sstrerror(errnum).c_str()));
 	  }
       }
   }
-}
-
-void download_update_manager::finish(pkgAcquire::RunResult res,
-				     OpProgress *progress,
-				     const sigc::slot1<void, result> &k)
-{
-  if(log != NULL)
-    log->Complete();
 
-  apt_close_cache();
+  /** \brief Logs how long each stage of the post-update work takes. */
+  class stage_timer
+  {
+    const char *stage;
+    struct timeval start;
 
-  if(res != pkgAcquire::Continue)
+  public:
+    stage_timer(const char *_stage)
+      : stage(_stage)
     {
-      k(failure);
-      return;
+      gettimeofday(&start, 0);
     }
 
-  // Rebuild the apt caches as done in apt-get.  cachefile is scoped
-  // so it dies before we possibly-reload the cache.  This will do a
-  // little redundant work in visual mode, but avoids lots of
-  // redundant work at the command-line.
-  {
-    pkgCacheFile cachefile;
-    if(!cachefile.BuildCaches(progress, true))
-      {
-	k(failure);
-	return;
-      }
-  }
+    ~stage_timer()
+    {
+      struct timeval end;
+      gettimeofday(&end, 0);
 
-  bool need_forget_new = 
-    aptcfg->FindB(PACKAGE "::Forget-New-On-Update", false);
+      const long long ms =
+	(end.tv_sec - start.tv_sec) * 1000LL + (end.tv_usec - start.tv_usec) / 1000;
 
-  bool need_autoclean =
-    aptcfg->FindB(PACKAGE "::AutoClean-After-Update", false);
+      LOG_INFO(aptitude::Loggers::getAptitudeUpdate(),
+	       stage << " took " << ms << " ms");
+    }
+  };
 
 #ifdef HAVE_EPT
-  std::string debtags = aptcfg->Find(PACKAGE "::Debtags-Binary", "/usr/bin/debtags");
-
-  if(debtags.size() == 0)
-    _error->Error(_("The debtags command must not be an empty string."));
-  // Keep the user from killing themselves without trying: a relative
-  // path would open a root exploit.
-  else if(debtags[0] != '/')
-    _error->Error(_("The debtags command must be an absolute path."));
-  // Check up-front if we can execute the command.  This is not ideal
-  // since there's a race condition (the command could go away before
-  // we try to execute it) but the worst that will happen is that we
-  // display a confusing error message (...exited with code 255).
-  else if(euidaccess(debtags.c_str(), X_OK) != 0)
+  /** \brief A debtags update running in the background. */
+  class debtags_update
+  {
+    std::string debtags;
+    std::string debtags_options;
+    pid_t pid;
+
+  public:
+    debtags_update()
+      : pid(-1)
     {
-      int errnum = errno;
-      if(errnum == ENOENT)
-	// Fail silently instead of annoying the user over and over.
-	;  //_error->Warning(_("The debtags command (%s) does not exist; perhaps you need to install the debtags package?"),
-                            //debtags.c_str());
-      else
-	_error->Error(_("The debtags command (%s) cannot be executed: %s"),
-		      debtags.c_str(), cw::util::sstrerror(errnum).c_str());
     }
-  else
+
+    /** \brief Start "debtags update", if it's available. */
+    void start()
     {
-      progress->OverallProgress(0, 0, 1, _("Updating debtags database"));
+      debtags = aptcfg->Find(PACKAGE "::Debtags-Binary", "/usr/bin/debtags");
+
+      if(debtags.size() == 0)
+	_error->Error(_("The debtags command must not be an empty string."));
+      // Keep the user from killing themselves without trying: a relative
+      // path would open a root exploit.
+      else if(debtags[0] != '/')
+	_error->Error(_("The debtags command must be an absolute path."));
+      // Check up-front if we can execute the command.  This is not ideal
+      // since there's a race condition (the command could go away before
+      // we try to execute it) but the worst that will happen is that we
+      // display a confusing error message (...exited with code 255).
+      else if(euidaccess(debtags.c_str(), X_OK) != 0)
+	{
+	  int errnum = errno;
+	  if(errnum == ENOENT)
+	    // Fail silently instead of annoying the user over and over.
+	    ;  //_error->Warning(_("The debtags command (%s) does not exist; perhaps you need to install the debtags package?"),
+				//debtags.c_str());
+	  else
+	    _error->Error(_("The debtags command (%s) cannot be executed: %s"),
+			  debtags.c_str(), cw::util::sstrerror(errnum).c_str());
+	}
+      else
+	{
+	  debtags_options = aptcfg->Find(PACKAGE "::Debtags-Update-Options", "--local");
 
-      std::string debtags_options = aptcfg->Find(PACKAGE "::Debtags-Update-Options", "--local");
+	  std::vector<std::string> args;
+	  args.push_back(debtags);
+	  args.push_back("update");
+	  parse_command_arguments(debtags_options, args);
 
-      std::vector<std::string> args;
-      args.push_back(debtags);
-      args.push_back("update");
-      parse_command_arguments(debtags_options, args);
+	  try
+	    {
+	      pid = start_subprocess_to_devnull(debtags, args);
+	    }
+	  catch(cw::util::Exception &e)
+	    {
+	      report_failure(e);
+	    }
+	}
+    }
+
+    /** \brief Wait for the update to finish and report how it went. */
+    void finish(OpProgress *progress)
+    {
+      if(pid < 0)
+	return;
+
+      progress->OverallProgress(0, 0, 1, _("Updating debtags database"));
 
       try
 	{
-	  int status = run_in_subprocess_to_devnull(debtags, args);
+	  stage_timer timer("Waiting for debtags");
+
+	  int status = wait_for_subprocess(pid);
+	  pid = -1;
+
 	  if(WIFSIGNALED(status))
 	    {
 	      std::string coredumpstr;
@@ -377,27 +420,92 @@ void download_update_manager::finish(pkgAcquire::RunResult res,
 	}
       catch(cw::util::Exception &e)
 	{
-	      // ForTranslators: "%s update %s" gets replaced by a command line, do not translate it!
-	  _error->Warning(_("Updating the debtags database (%s update %s) failed (perhaps debtags is not installed?): %s"),
-			  debtags.c_str(), debtags_options.c_str(), e.errmsg().c_str());
+	  pid = -1;
+	  report_failure(e);
 	}
 
       progress->Progress(1);
       progress->Done();
     }
+
+  private:
+    void report_failure(const cw::util::Exception &e)
+    {
+      // ForTranslators: "%s update %s" gets replaced by a command line, do not translate it!
+      _error->Warning(_("Updating the debtags database (%s update %s) failed (perhaps debtags is not installed?): %s"),
+		      debtags.c_str(), debtags_options.c_str(), e.errmsg().c_str());
+    }
+  };
+#endif
+}
+
+void download_update_manager::finish(pkgAcquire::RunResult res,
+				     OpProgress *progress,
+				     const sigc::slot1<void, result> &k)
+{
+  if(log != NULL)
+    log->Complete();
+
+  apt_close_cache();
+
+  if(res != pkgAcquire::Continue)
+    {
+      k(failure);
+      return;
+    }
+
+  bool need_forget_new = 
+    aptcfg->FindB(PACKAGE "::Forget-New-On-Update", false);
+
+  bool need_autoclean =
+    aptcfg->FindB(PACKAGE "::AutoClean-After-Update", false);
+
+#ifdef HAVE_EPT
+  // debtags only reads the downloaded lists and its own tag sources,
+  // so it can run while the apt caches are rebuilt.
+  debtags_update debtags;
+  debtags.start();
+#endif
+
+  // Rebuild the apt caches as done in apt-get.  cachefile is scoped
+  // so it dies before we possibly-reload the cache.  This will do a
+  // little redundant work in visual mode, but avoids lots of
+  // redundant work at the command-line.
+  {
+    stage_timer timer("Rebuilding the apt caches");
+
+    pkgCacheFile cachefile;
+    if(!cachefile.BuildCaches(progress, true))
+      {
+#ifdef HAVE_EPT
+	debtags.finish(progress);
+#endif
+	k(failure);
+	return;
+      }
+  }
+
+#ifdef HAVE_EPT
+  debtags.finish(progress);
 #endif
 
   if(need_forget_new || need_autoclean)
-    apt_load_cache(progress, true);
+    {
+      stage_timer timer("Reloading the package cache");
+      apt_load_cache(progress, true);
+    }
 
   if(apt_cache_file != NULL && need_forget_new)
     {
+      stage_timer timer("Forgetting new packages");
       (*apt_cache_file)->forget_new(NULL);
       post_forget_new_hook();
     }
 
   if(apt_cache_file != NULL && need_autoclean)
     {
+      stage_timer timer("Cleaning the archive directory");
+
       pre_autoclean_hook();
 
       my_cleaner cleaner;
@@ -20,6 +20,7 @@
 #include "dump_packages.h"
 
 #include "apt.h"
+#include "record_prefetch.h"
 
 #include <apt-pkg/configuration.h>
 #include <apt-pkg/error.h>
@@ -32,6 +33,7 @@
 #include <aptitude.h>
 #include <generic/util/dirent_safe.h>
 #include <generic/util/temp.h>
+#include <generic/util/thread_pool.h>
 
 #include <dirent.h>
 #include <errno.h>
@@ -40,7 +42,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <sstream>
 
 namespace aptitude
 {
@@ -83,6 +88,8 @@ namespace aptitude
       eassert(apt_cache_file != NULL);
       eassert(apt_package_records != NULL);
 
+      prefetch_version_records(packages, true, false);
+
       for(std::vector<pkgCache::VerIterator>::const_iterator it =
 	    packages.begin(); it != packages.end(); ++it)
 	{
@@ -93,6 +100,75 @@ namespace aptitude
 
     namespace
     {
+      /** \brief The packages being written to a truncated copy.
+       *
+       *  Membership is tested for every target of every dependency
+       *  that is copied, so it is stored as a flag per package ID
+       *  rather than searched for in a std::set.
+       */
+      class package_subset
+      {
+	std::vector<bool> members;
+
+      public:
+	explicit package_subset(const std::set<pkgCache::PkgIterator> &packages)
+	  : members((*apt_cache_file)->Head().PackageCount, false)
+	{
+	  for(std::set<pkgCache::PkgIterator>::const_iterator it =
+		packages.begin(); it != packages.end(); ++it)
+	    members[(*it)->ID] = true;
+	}
+
+	bool contains(const pkgCache::PkgIterator &pkg) const
+	{
+	  return members[pkg->ID];
+	}
+      };
+
+      bool verfile_offset_lt(const pkgCache::VerFileIterator &vf1,
+			     const pkgCache::VerFileIterator &vf2)
+      {
+	return vf1->Offset < vf2->Offset;
+      }
+
+      /** \brief The records of the package subset, listed by the
+       *  index file they come from.
+       *
+       *  Every index file in the cache appears, even if none of its
+       *  records are selected, and each file's records are sorted by
+       *  offset so that they can be copied in a single forward pass.
+       *  The status file is left out: it can hold entries that the
+       *  cache doesn't keep (packages that were purged but are still
+       *  listed), so it is always scanned.
+       */
+      typedef std::map<std::string, std::vector<pkgCache::VerFileIterator> > records_by_file;
+
+      void find_records_by_file(const std::set<pkgCache::PkgIterator> &packages,
+				records_by_file &out)
+      {
+	for(pkgCache::PkgFileIterator file = (*apt_cache_file)->FileBegin();
+	    !file.end(); ++file)
+	  if(file.FileName() != NULL &&
+	     (file->Flags & pkgCache::Flag::NotSource) == 0)
+	    out[file.FileName()];
+
+	for(std::set<pkgCache::PkgIterator>::const_iterator it =
+	      packages.begin(); it != packages.end(); ++it)
+	  for(pkgCache::VerIterator ver = it->VersionList(); !ver.end(); ++ver)
+	    for(pkgCache::VerFileIterator vf = ver.FileList(); !vf.end(); ++vf)
+	      {
+		const pkgCache::PkgFileIterator file = vf.File();
+		if(file.FileName() == NULL ||
+		   (file->Flags & pkgCache::Flag::NotSource) != 0)
+		  continue;
+
+		out[file.FileName()].push_back(vf);
+	      }
+
+	for(records_by_file::iterator it = out.begin(); it != out.end(); ++it)
+	  std::sort(it->second.begin(), it->second.end(), verfile_offset_lt);
+      }
+
       class dep_target
       {
 	std::string name;
@@ -251,12 +327,12 @@ namespace aptitude
       // of visited packages (or provided by a version of a visited
       // package!).
       bool is_irrelevant_dep(const dep_target &target,
-			     const std::set<pkgCache::PkgIterator> &visited_packages)
+			     const package_subset &visited_packages)
       {
 	pkgCache::PkgIterator pkg = (*apt_cache_file)->FindPkg(target.get_name());
 	if(pkg.end())
 	  return true;
-	else if(visited_packages.find(pkg) != visited_packages.end())
+	else if(visited_packages.contains(pkg))
 	  return false;
 	else
 	  {
@@ -265,7 +341,7 @@ namespace aptitude
 	    for(pkgCache::PrvIterator prvIt = pkg.ProvidesList();
 		!prvIt.end(); ++prvIt)
 	      {
-		if(visited_packages.find(prvIt.OwnerPkg()) != visited_packages.end())
+		if(visited_packages.contains(prvIt.OwnerPkg()))
 		  return false;
 	      }
 
@@ -276,7 +352,7 @@ namespace aptitude
       // Drop targets of dependencies that are irrelevant;
       // drop dependencies with only irrelevant targets.
       void filter_deps(const std::vector<dep_element> &in_elements,
-		       const std::set<pkgCache::PkgIterator> &visited_packages,
+		       const package_subset &visited_packages,
 		       std::vector<dep_element> &out_elements)
       {
 	for(std::vector<dep_element>::const_iterator inIt = in_elements.begin();
@@ -331,7 +407,7 @@ namespace aptitude
 
       void dump_truncated_section(const char *start,
 				  const char *stop,
-				  const std::set<pkgCache::PkgIterator> &visited_packages,
+				  const package_subset &visited_packages,
 				  std::ostream &out)
       {
 	eassert(apt_cache_file != NULL);
@@ -434,6 +510,175 @@ namespace aptitude
 	  }
       }
 
+      /** \brief A run of sections that one task of the thread pool
+       *  truncates.
+       */
+      struct truncated_chunk
+      {
+	std::vector<std::string>::const_iterator begin, end;
+
+	/** \brief \b true if the first section of the chunk is the
+	 *  first one written, and so isn't preceded by a blank line.
+	 */
+	bool first;
+
+	std::string output;
+
+	// Set if the chunk stopped because of an exception.
+	std::string error;
+      };
+
+      class truncated_chunk_worker
+      {
+	truncated_chunk *chunk;
+	const package_subset *visited_packages;
+
+      public:
+	truncated_chunk_worker(truncated_chunk *_chunk,
+			       const package_subset *_visited_packages)
+	  : chunk(_chunk), visited_packages(_visited_packages)
+	{
+	}
+
+	void operator()() const
+	{
+	  std::ostringstream out;
+
+	  try
+	    {
+	      for(std::vector<std::string>::const_iterator it =
+		    chunk->begin; it != chunk->end; ++it)
+		{
+		  if(it != chunk->begin || !chunk->first)
+		    out << std::endl;
+
+		  const char * const start = it->data();
+		  dump_truncated_section(start, start + it->size(),
+					 *visited_packages, out);
+		}
+	    }
+	  catch(cwidget::util::Exception &e)
+	    {
+	      chunk->error = e.errmsg();
+	    }
+	  catch(std::exception &e)
+	    {
+	      chunk->error = e.what();
+	    }
+
+	  chunk->output = out.str();
+	}
+      };
+
+      /** \brief Writes truncated sections to a stream, truncating
+       *  them on the thread pool.
+       *
+       *  pkgRecords and pkgTagFile reuse their buffer for each
+       *  record, and neither can be shared between threads, so the
+       *  records are still read one at a time by the calling thread;
+       *  each one is copied into a queue as it's read.  When the
+       *  queue is full, or when flush() is invoked, it is cut into
+       *  chunks that are truncated in parallel, and their output is
+       *  written in the order the sections were added.  Truncating a
+       *  section only reads the package cache and the package subset,
+       *  so the chunks share nothing else.
+       *
+       *  The output is the same as invoking dump_truncated_section()
+       *  on each section in turn, with a blank line between sections.
+       */
+      class truncated_section_writer
+      {
+	const package_subset &visited_packages;
+	std::ostream &out;
+
+	std::vector<std::string> pending;
+	std::string::size_type pending_size;
+	bool first;
+
+	/** \brief How many sections each task truncates. */
+	static const std::vector<std::string>::size_type chunk_sections = 128;
+
+	/** \brief How much text to queue before truncating it. */
+	static const std::string::size_type max_pending_size = 8 * 1024 * 1024;
+
+      public:
+	truncated_section_writer(const package_subset &_visited_packages,
+				 std::ostream &_out)
+	  : visited_packages(_visited_packages),
+	    out(_out),
+	    pending_size(0),
+	    first(true)
+	{
+	}
+
+	/** \brief Queue a section to be truncated and written. */
+	void add(const char *start, const char *stop)
+	{
+	  pending.push_back(std::string(start, stop));
+	  pending_size += stop - start;
+
+	  if(pending_size >= max_pending_size)
+	    flush();
+	}
+
+	/** \brief Truncate and write every queued section.
+	 *
+	 *  This must be invoked after the last section is added.
+	 *
+	 *  \throw ParseException if a section can't be parsed; the
+	 *  sections before it have been written.
+	 */
+	void flush()
+	{
+	  if(pending.empty())
+	    return;
+
+	  const std::vector<std::string>::size_type num_chunks =
+	    (pending.size() + chunk_sections - 1) / chunk_sections;
+	  std::vector<truncated_chunk> chunks(num_chunks);
+	  for(std::vector<std::string>::size_type i = 0; i < num_chunks; ++i)
+	    {
+	      chunks[i].begin = pending.begin() + i * chunk_sections;
+	      chunks[i].end = pending.begin() + std::min(pending.size(), (i + 1) * chunk_sections);
+	      chunks[i].first = first && i == 0;
+	    }
+
+	  // Waiting for a chunk that no worker has started yet runs it
+	  // in this thread, so a single chunk never leaves the calling
+	  // thread.  After an error, the chunks that haven't started are
+	  // dropped; the batch waits for the running ones before the
+	  // sections are freed.
+	  std::string error;
+	  {
+	    util::cancel_token canceled;
+	    util::thread_pool::batch workers(util::thread_pool::get(), canceled);
+	    for(std::vector<std::string>::size_type i = 0; i < num_chunks; ++i)
+	      workers.submit(truncated_chunk_worker(&chunks[i], &visited_packages));
+
+	    for(std::vector<std::string>::size_type i = 0; i < num_chunks; ++i)
+	      {
+		workers.wait(i);
+
+		out.write(chunks[i].output.data(), chunks[i].output.size());
+
+		if(!chunks[i].error.empty())
+		  {
+		    error = chunks[i].error;
+		    canceled.cancel();
+		    break;
+		  }
+	      }
+	  }
+
+	  first = false;
+	  pending.clear();
+	  pending_size = 0;
+
+	  if(!error.empty())
+	    throw ParseException(error);
+	}
+      };
+
       // Use pkgTagFile to copy all the entries of fd that are tagged
       // with 'Package' and a package whose name appears in the given
       // set to the output stream.
@@ -445,12 +690,12 @@ namespace aptitude
       // doing anything with them!).
       void copy_truncated(FileFd &fd,
 			  std::ostream &out,
-			  const std::set<pkgCache::PkgIterator> &visited_packages)
+			  const package_subset &visited_packages)
       {
 	pkgTagFile tag_file(&fd);
 
 	pkgTagSection section;
-	bool first = true;
+	truncated_section_writer writer(visited_packages, out);
 	while(tag_file.Step(section))
 	  {
 	    // Look for a Package tag.
@@ -463,21 +708,40 @@ namespace aptitude
 	    if(pkg.end())
 	      continue;
 
-	    if(visited_packages.find(pkg) == visited_packages.end())
+	    if(!visited_packages.contains(pkg))
 	      continue;
 
-	    // Write out a separator if we already write something.
-	    if(first)
-	      first = false;
-	    else
-	      out << std::endl;
-
 	    // Whee, write out the section.
 	    const char *start;
 	    const char *stop;
 	    section.GetSection(start, stop);
-	    dump_truncated_section(start, stop, visited_packages, out);
+	    writer.add(start, stop);
+	  }
+
+	writer.flush();
+      }
+
+      // Copy the given records of an index file, which must be
+      // sorted by offset.  Since the cache already knows where each
+      // package's entry is, this reads the selected entries and skips
+      // everything else, instead of parsing every section of the file
+      // to find out which package it describes.
+      void copy_records_truncated(const std::vector<pkgCache::VerFileIterator> &records,
+				  std::ostream &out,
+				  const package_subset &visited_packages)
+      {
+	truncated_section_writer writer(visited_packages, out);
+	for(std::vector<pkgCache::VerFileIterator>::const_iterator it =
+	      records.begin(); it != records.end(); ++it)
+	  {
+	    pkgRecords::Parser &p = apt_package_records->Lookup(*it);
+	    const char *start, *stop;
+	    p.GetRec(start, stop);
+
+	    writer.add(start, stop);
 	  }
+
+	writer.flush();
       }
     }
 
@@ -522,9 +786,13 @@ namespace aptitude
 	return result;
     }
 
+    // If records is not NULL and lists inFileName, only the records
+    // it holds for that file are copied; otherwise the whole file is
+    // scanned.
     void copy_truncated(const std::string &inFileName,
 			const std::string &outFileName,
-			const std::set<pkgCache::PkgIterator> &visited_packages)
+			const package_subset &visited_packages,
+			const records_by_file *records = NULL)
     {
       int infd = open(inFileName.c_str(), O_RDONLY);
       if(infd == -1)
@@ -546,11 +814,21 @@ namespace aptitude
       if(make_directory_and_parents(dirname(outFileName)) != 0)
 	return;
 
-      std::ofstream outfile(outFileName.c_str());
+      // Index files run to tens of megabytes; write them out in
+      // large blocks.
+      std::vector<char> out_buffer(1024 * 1024);
+      std::ofstream outfile;
+      outfile.rdbuf()->pubsetbuf(&out_buffer[0], out_buffer.size());
+      outfile.open(outFileName.c_str());
       if(!outfile)
 	return;
 
-      copy_truncated(infile, outfile, visited_packages);
+      const records_by_file::const_iterator found =
+	records == NULL ? records_by_file::const_iterator() : records->find(inFileName);
+      if(records != NULL && found != records->end())
+	copy_records_truncated(found->second, outfile, visited_packages);
+      else
+	copy_truncated(infile, outfile, visited_packages);
     }
 
     void get_directory_files(const std::string &dir,
@@ -570,7 +848,8 @@ namespace aptitude
 
     void copy_dir_truncated(const std::string &dir,
 			    const std::string &to,
-			    std::set<pkgCache::PkgIterator> visited_packages)
+			    const package_subset &visited_packages,
+			    const records_by_file *records = NULL)
     {
       std::vector<std::string> dir_files;
       get_directory_files(dir, dir_files);
@@ -589,9 +868,12 @@ namespace aptitude
 	  if(*it == "." || *it == "..")
 	    continue;
 
-	  const std::string inFileName = dir + "/" + *it;
+	  // Don't double the slash that FindDir() leaves on the end,
+	  // so that the name matches the one in the cache.
+	  const std::string inFileName =
+	    dir + (dir[dir.size() - 1] == '/' ? "" : "/") + *it;
 	  const std::string outFileName = to + "/" + *it;
-	  copy_truncated(inFileName, outFileName, visited_packages);
+	  copy_truncated(inFileName, outFileName, visited_packages, records);
 	}
     }
 
@@ -677,7 +959,7 @@ namespace aptitude
 	}
     }
 
-    void dump_truncated_apt_extended_states(const std::set<pkgCache::PkgIterator> &visited_packages,
+    void dump_truncated_apt_extended_states(const package_subset &visited_packages,
 					    const std::string &outDir)
     {
       temp::dir tmp_dir("aptitude-dump-directory");
@@ -705,7 +987,7 @@ namespace aptitude
       unlink((tmp_dir.get_name() + "/extended_states").c_str());
     }
 
-    void dump_truncated_aptitude_states(const std::set<pkgCache::PkgIterator> &visited_packages,
+    void dump_truncated_aptitude_states(const package_subset &visited_packages,
 					const std::string &outDir)
     {
       temp::dir tmp_dir("aptitude-dump-directory");
@@ -749,8 +1031,12 @@ namespace aptitude
     // Dir::State::* are truncated copies; the others are copied
     // literally.
     void make_truncated_state_copy(const std::string &outDir,
-				   const std::set<pkgCache::PkgIterator> &visited_packages)
+				   const std::set<pkgCache::PkgIterator> &packages)
     {
+      const package_subset visited_packages(packages);
+      records_by_file records;
+      find_records_by_file(packages, records);
+
       {
 	dump_truncated_aptitude_states(visited_packages, outDir);
       }
@@ -767,7 +1053,7 @@ namespace aptitude
 	const std::string lists = _config->FindDir("Dir::State::lists");
 	if(!lists.empty())
 	  copy_dir_truncated(lists, outDir + "/" + lists,
-			     visited_packages);
+			     visited_packages, &records);
       }
 
       {
@@ -777,13 +1063,6 @@ namespace aptitude
 			 visited_packages);
       }
 
-      {
-	const std::string lists = _config->FindFile("Dir::State::lists");
-	if(!lists.empty())
-	  copy_dir_truncated(lists, outDir + "/" + lists,
-			     visited_packages);
-      }
-
       {
 	// Could do a recursive copy of Dir::Etc, which would pick
 	// up files not explicitly called out here, but that's an
@@ -849,9 +1128,21 @@ namespace aptitude
     void dump_truncated_packages(const std::set<pkgCache::PkgIterator> &packages,
 				 std::ostream &out)
     {
+      const package_subset visited_packages(packages);
+
       try
 	{
-	  bool first = true;
+	  {
+	    std::vector<pkgCache::VerIterator> versions;
+	    for(std::set<pkgCache::PkgIterator>::const_iterator it = packages.begin();
+		it != packages.end(); ++it)
+	      for(pkgCache::VerIterator vIt = it->VersionList(); !vIt.end(); ++vIt)
+		versions.push_back(vIt);
+
+	    prefetch_version_records(versions, true, false);
+	  }
+
+	  truncated_section_writer writer(visited_packages, out);
 	  for(std::set<pkgCache::PkgIterator>::const_iterator it = packages.begin();
 	      it != packages.end(); ++it)
 	    {
@@ -860,19 +1151,16 @@ namespace aptitude
 		  for(pkgCache::VerFileIterator vfIt = vIt.FileList();
 		      !vfIt.end(); ++vfIt)
 		    {
-		      if(first)
-			first = false;
-		      else
-			out << std::endl;
-
 		      pkgRecords::Parser &p = apt_package_records->Lookup(vfIt);
 		      const char *start, *stop;
 		      p.GetRec(start, stop);
 
-		      dump_truncated_section(start, stop, packages, out);
+		      writer.add(start, stop);
 		    }
 		}
 	    }
+
+	  writer.flush();
 	}
       catch(const cwidget::util::Exception &e)
 	{
@@ -0,0 +1,184 @@
+// history_index.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "history_index.h"
+
+#include <fstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace aptitude
+{
+  namespace history
+  {
+    namespace
+    {
+      const int num_fields = 6;
+
+      // Splits a line into its tab-separated fields; returns false
+      // if it has the wrong number of them.
+      bool split_index_line(const std::string &line,
+			    std::string (&fields)[num_fields])
+      {
+	std::string::size_type start = 0;
+	for(int i = 0; i < num_fields; ++i)
+	  {
+	    const std::string::size_type tab = line.find('\t', start);
+	    const bool last = (i == num_fields - 1);
+
+	    if(last != (tab == std::string::npos))
+	      return false;
+
+	    fields[i] = line.substr(start, last ? std::string::npos : tab - start);
+	    start = tab + 1;
+	  }
+
+	return true;
+      }
+
+      bool parse_index_line(const std::string &line, index_entry &out)
+      {
+	std::string fields[num_fields];
+	if(!split_index_line(line, fields))
+	  return false;
+
+	char *endptr;
+	const long long timestamp = strtoll(fields[0].c_str(), &endptr, 10);
+	if(fields[0].empty() || *endptr != '\0')
+	  return false;
+
+	const long offset = strtol(fields[1].c_str(), &endptr, 10);
+	if(fields[1].empty() || *endptr != '\0')
+	  return false;
+
+	out = index_entry(static_cast<time_t>(timestamp), offset,
+			  fields[2], fields[3], fields[4], fields[5]);
+	return true;
+      }
+
+      /** \brief Scan the index for the entries of one package.
+       *
+       *  Compares the package field before anything else is parsed,
+       *  since nearly every line belongs to some other package.
+       */
+      template<typename F>
+      bool scan_index(const std::string &filename,
+		      const std::string &package,
+		      const std::string &action,
+		      F f)
+      {
+	std::ifstream in(filename.c_str());
+	if(!in)
+	  return false;
+
+	const std::string needle = "\t" + package + "\t";
+
+	std::string line;
+	while(std::getline(in, line))
+	  {
+	    if(line.find(needle) == std::string::npos)
+	      continue;
+
+	    index_entry entry;
+	    if(!parse_index_line(line, entry) ||
+	       entry.get_package() != package ||
+	       (!action.empty() && entry.get_action() != action))
+	      continue;
+
+	    f(entry);
+	  }
+
+	return true;
+      }
+
+      class push_entry
+      {
+	std::vector<index_entry> &out;
+
+      public:
+	push_entry(std::vector<index_entry> &_out)
+	  : out(_out)
+	{
+	}
+
+	void operator()(const index_entry &entry) const
+	{
+	  out.push_back(entry);
+	}
+      };
+
+      class keep_last_entry
+      {
+	index_entry &out;
+	bool &found;
+
+      public:
+	keep_last_entry(index_entry &_out, bool &_found)
+	  : out(_out), found(_found)
+	{
+	}
+
+	void operator()(const index_entry &entry) const
+	{
+	  out = entry;
+	  found = true;
+	}
+      };
+    }
+
+    bool append_index_entries(const std::string &filename,
+			      const std::vector<index_entry> &entries)
+    {
+      FILE *f = fopen(filename.c_str(), "a");
+      if(f == NULL)
+	return false;
+
+      for(std::vector<index_entry>::const_iterator it = entries.begin();
+	  it != entries.end(); ++it)
+	fprintf(f, "%lld\t%ld\t%s\t%s\t%s\t%s\n",
+		static_cast<long long>(it->get_timestamp()),
+		it->get_offset(),
+		it->get_action().c_str(),
+		it->get_package().c_str(),
+		it->get_old_version().c_str(),
+		it->get_new_version().c_str());
+
+      return fclose(f) == 0;
+    }
+
+    bool find_index_entries(const std::string &filename,
+			    const std::string &package,
+			    const std::string &action,
+			    std::vector<index_entry> &out)
+    {
+      return scan_index(filename, package, action, push_entry(out));
+    }
+
+    bool find_last_index_entry(const std::string &filename,
+			       const std::string &package,
+			       const std::string &action,
+			       index_entry &out)
+    {
+      bool found = false;
+      return scan_index(filename, package, action, keep_last_entry(out, found)) &&
+	found;
+    }
+  }
+}
@@ -0,0 +1,152 @@
+/** \file history_index.h */   // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef HISTORY_INDEX_H
+#define HISTORY_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+namespace aptitude
+{
+  namespace history
+  {
+    /** \brief One package change recorded in the history index.
+     *
+     *  Every time aptitude writes a log report, it also appends one
+     *  index entry per changed package to a separate file, so that
+     *  questions like "when was this package last upgraded?" can be
+     *  answered without reading (and translating back) the
+     *  human-readable log and its rotated copies.
+     *
+     *  Entries are stored one per line, as tab-separated fields:
+     *
+     *    timestamp offset action package old-version new-version
+     *
+     *  where the offset is the position of the report in the main
+     *  log at the time it was written.  The offset stops being
+     *  meaningful when the log is rotated; the rest of the entry
+     *  doesn't.
+     */
+    class index_entry
+    {
+      time_t timestamp;
+      long offset;
+      std::string action;
+      std::string package;
+      std::string old_version;
+      std::string new_version;
+
+    public:
+      index_entry()
+	: timestamp(0), offset(-1)
+      {
+      }
+
+      /** \brief Create an index entry.
+       *
+       *  \param _timestamp    When the change was logged.
+       *  \param _offset       Where the log report begins in the log
+       *                       file, or -1 if it isn't known.
+       *  \param _action       An untranslated name for the change,
+       *                       such as "install" or "upgrade".
+       *  \param _package      The full name of the package.
+       *  \param _old_version  The version that was installed, or
+       *                       an empty string if none was.
+       *  \param _new_version  The version that will be installed,
+       *                       or an empty string if none will.
+       */
+      index_entry(time_t _timestamp,
+		  long _offset,
+		  const std::string &_action,
+		  const std::string &_package,
+		  const std::string &_old_version,
+		  const std::string &_new_version)
+	: timestamp(_timestamp), offset(_offset),
+	  action(_action), package(_package),
+	  old_version(_old_version), new_version(_new_version)
+      {
+      }
+
+      time_t get_timestamp() const { return timestamp; }
+      long get_offset() const { return offset; }
+      const std::string &get_action() const { return action; }
+      const std::string &get_package() const { return package; }
+      const std::string &get_old_version() const { return old_version; }
+      const std::string &get_new_version() const { return new_version; }
+
+      bool operator==(const index_entry &other) const
+      {
+	return timestamp == other.timestamp &&
+	  offset == other.offset &&
+	  action == other.action &&
+	  package == other.package &&
+	  old_version == other.old_version &&
+	  new_version == other.new_version;
+      }
+    };
+
+    /** \brief Append entries to the history index.
+     *
+     *  \param filename  The index file; created if it doesn't exist.
+     *  \param entries   The entries to append.
+     *
+     *  \return \b true if the entries were written.
+     */
+    bool append_index_entries(const std::string &filename,
+			      const std::vector<index_entry> &entries);
+
+    /** \brief Find the changes to a package in the history index.
+     *
+     *  \param filename  The index file.
+     *  \param package   The full name of the package to look up.
+     *  \param action    If not empty, only entries with this action
+     *                   are returned.
+     *  \param out       The matching entries are appended here,
+     *                   oldest first.
+     *
+     *  Lines that can't be parsed are skipped.
+     *
+     *  \return \b false if the index couldn't be opened.
+     */
+    bool find_index_entries(const std::string &filename,
+			    const std::string &package,
+			    const std::string &action,
+			    std::vector<index_entry> &out);
+
+    /** \brief Find the most recent change to a package.
+     *
+     *  \param filename  The index file.
+     *  \param package   The full name of the package to look up.
+     *  \param action    If not empty, only entries with this action
+     *                   are considered.
+     *  \param out       Set to the most recent matching entry.
+     *
+     *  \return \b true if a matching entry was found.
+     */
+    bool find_last_index_entry(const std::string &filename,
+			       const std::string &package,
+			       const std::string &action,
+			       index_entry &out);
+  }
+}
+
+#endif // HISTORY_INDEX_H
@@ -12,7 +12,9 @@
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/version.h>
 
+#include <algorithm>
 #include <set>
+#include <vector>
 
 using namespace std;
 
@@ -167,11 +169,12 @@ void infer_reason(pkgCache::PkgIterator pkg, set<reason> &reasons)
   else if(actionstate==pkg_unchanged && pkg.CurrentVer().end())
     // Add notes about packages that Recommend or Suggest this.
     {
-      for(rev_dep_iterator d(pkg); !d.end(); ++d)
-	if((*d)->Type==pkgCache::Dep::Suggests ||
-	   (*d)->Type==pkgCache::Dep::Recommends)
-	  if(!candver.end() && relevant_dep(candver, *d))
-	    reasons.insert(reason((*d).ParentPkg(), *d));
+      for(rev_dep_iterator d(pkg,
+			     rev_dep_type_mask(pkgCache::Dep::Suggests) |
+			     rev_dep_type_mask(pkgCache::Dep::Recommends));
+	  !d.end(); ++d)
+	if(!candver.end() && relevant_dep(candver, *d))
+	  reasons.insert(reason((*d).ParentPkg(), *d));
     }
   // Non-unused removed packages: was one of their dependents
   //                             removed?  Maybe a conflicting package.
@@ -251,6 +254,128 @@ void infer_reason(pkgCache::PkgIterator pkg, set<reason> &reasons)
 
 }
 
+namespace
+{
+  /** Add reason(dep.ParentPkg(), dep) to the slot of pkg if pkg is
+   *  one of the automatically installed packages being examined and
+   *  dep is a reason for it.
+   *
+   *  \param provider  if not NULL, dep reaches pkg through a Provides of
+   *                   this version, which only counts if it's the
+   *                   version of pkg that will be installed.
+   */
+  void add_auto_install_reason(const pkgCache::PkgIterator &pkg,
+			       const pkgCache::VerIterator *provider,
+			       const pkgCache::DepIterator &dep,
+			       const vector<int> &slots,
+			       vector<vector<reason> > &reasons)
+  {
+    const int slot = slots[pkg->ID];
+    if(slot < 0)
+      return;
+
+    pkgCache::VerIterator instver = (*apt_cache_file)[pkg].InstVerIter(*apt_cache_file);
+    if(provider != NULL && instver != *provider)
+      return;
+
+    if(_system->VS->CheckDep(instver.VerStr(),
+			     dep->CompareOp, dep.TargetVer()))
+      reasons[slot].push_back(reason(dep.ParentPkg(), dep));
+  }
+
+  bool reasons_equivalent(const reason &a, const reason &b)
+  {
+    return !(a < b) && !(b < a);
+  }
+}
+
+void infer_reasons(const vector<pkgCache::PkgIterator> &pkgs,
+		   vector<vector<reason> > &reasons)
+{
+  reasons.clear();
+  reasons.resize(pkgs.size());
+
+  // slots[pkg->ID] is the index in pkgs of each automatically
+  // installed package, or -1.  Everything else is left to
+  // infer_reason(), which only looks at a handful of dependencies for
+  // the other states.
+  vector<int> slots((*apt_cache_file)->Head().PackageCount, -1);
+  bool any_auto_install = false;
+
+  for(vector<pkgCache::PkgIterator>::size_type i = 0; i < pkgs.size(); ++i)
+    {
+      const pkgCache::PkgIterator &pkg = pkgs[i];
+
+      if(find_pkg_state(pkg, *apt_cache_file) == pkg_auto_install)
+	{
+	  slots[pkg->ID] = i;
+	  any_auto_install = true;
+	}
+      else
+	{
+	  set<reason> pkg_reasons;
+	  infer_reason(pkg, pkg_reasons);
+	  reasons[i].assign(pkg_reasons.begin(), pkg_reasons.end());
+	}
+    }
+
+  if(!any_auto_install)
+    return;
+
+  // An automatically installed package is there because of the
+  // non-conflict dependencies of the versions to be installed that
+  // it, or something it provides, satisfies.  Look at each of those
+  // dependencies once, from the depending side.
+  for(pkgCache::PkgIterator depender = (*apt_cache_file)->PkgBegin();
+      !depender.end(); ++depender)
+    {
+      pkgCache::VerIterator depinstver = (*apt_cache_file)[depender].InstVerIter(*apt_cache_file);
+      if(depinstver.end())
+	continue;
+
+      for(pkgCache::DepIterator d = depinstver.DependsList(); !d.end(); ++d)
+	{
+	  if(is_conflict(d->Type))
+	    continue;
+
+	  pkgCache::PkgIterator target = d.TargetPkg();
+	  add_auto_install_reason(target, NULL, d, slots, reasons);
+
+	  for(pkgCache::PrvIterator prv = target.ProvidesList();
+	      !prv.end(); ++prv)
+	    {
+	      const pkgCache::VerIterator provider = prv.OwnerVer();
+	      add_auto_install_reason(prv.OwnerPkg(), &provider,
+				      d, slots, reasons);
+	    }
+	}
+    }
+
+  for(vector<pkgCache::PkgIterator>::size_type i = 0; i < pkgs.size(); ++i)
+    {
+      const int slot = slots[pkgs[i]->ID];
+
+      if(slot == static_cast<int>(i))
+	{
+	  vector<reason> &pkg_reasons = reasons[i];
+	  sort(pkg_reasons.begin(), pkg_reasons.end());
+	  pkg_reasons.erase(unique(pkg_reasons.begin(), pkg_reasons.end(),
+				   reasons_equivalent),
+			    pkg_reasons.end());
+	}
+    }
+
+  // A package that was listed more than once only had its last slot
+  // filled in.
+  for(vector<pkgCache::PkgIterator>::size_type i = 0; i < pkgs.size(); ++i)
+    {
+      const int slot = slots[pkgs[i]->ID];
+
+      if(slot >= 0 && slot != static_cast<int>(i))
+	reasons[i] = reasons[slot];
+    }
+}
+
 /** Infer reverse breakage information based on the given dependency. */
 void infer_reverse_breakage(pkgCache::PkgIterator &pkg,
 			    pkgCache::DepIterator &dep,
@@ -6,6 +6,7 @@
 #define INFER_DEPS_H
 
 #include <set>
+#include <vector>
 
 #include <apt-pkg/pkgcache.h>
 
@@ -70,6 +71,22 @@ bool operator<(const reason &a, const reason &b);
  */
 void infer_reason(pkgCache::PkgIterator pkg, std::set<reason> &reasons);
 
+/** Find the reasons for the states of many packages at once.
+ *
+ *  The result is the same as calling infer_reason() on each package,
+ *  but the reasons for automatic installations (usually the bulk of a
+ *  large change) are found by one sweep over the dependencies of the
+ *  versions that will be installed, instead of by walking the reverse
+ *  dependencies of each package separately.
+ *
+ *  \param pkgs the packages to analyze
+ *  \param reasons  reasons[i] is set to the reasons for pkgs[i]'s state,
+ *                  sorted and without duplicates, as they would
+ *                  appear in the set filled in by infer_reason().
+ */
+void infer_reasons(const std::vector<pkgCache::PkgIterator> &pkgs,
+		   std::vector<std::vector<reason> > &reasons);
+
 
 /** Do the opposite of infer_reason: instead of finding reasons for
  *  why \b this package is in its present state, find reasons (if any)
@@ -24,6 +24,8 @@
 
 #include <aptitude.h>
 
+#include <generic/apt/history/history_index.h>
+
 #include <generic/util/util.h>
 
 #include <apt-pkg/error.h>
@@ -31,7 +33,10 @@
 #include <apt-pkg/strutl.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 
@@ -40,22 +45,14 @@ using namespace std;
 typedef std::pair<pkgCache::PkgIterator, pkg_action_state> logitem;
 typedef std::vector<logitem> loglist;
 
-bool do_log(const string &log,
-	    const loglist &changed_packages)
+/** \brief Format the log report for the given changes.
+ *
+ *  The report is built once and written to every log target as a
+ *  single block.
+ */
+string format_log_report(const loglist &changed_packages)
 {
-  FILE *f = NULL;
-
-  if(log[0] == '|')
-    f = popen(log.c_str()+1, "w");
-  else
-    f = fopen(log.c_str(), "a");
-
-  if(!f)
-    {
-      _error->Errno("do_log", _("Unable to open %s to log actions"), log.c_str());
-
-      return false;
-    }
+  string report;
 
   time_t curtime = time(NULL);
   tm ltime;
@@ -68,33 +65,33 @@ bool do_log(const string &log,
     timestr = ssprintf(_("Error generating local time (%s)"),
 		       sstrerror(errno).c_str());
 
-  fprintf(f, "Aptitude " VERSION ": %s\n%s\n\n",
-	  _("log report"), timestr.c_str());
-  fprintf(f, _("IMPORTANT: this log only lists intended actions; actions which fail due to\ndpkg problems may not be completed.\n\n"));
-  fprintf(f, _("Will install %li packages, and remove %li packages.\n"),
-	  (*apt_cache_file)->InstCount(), (*apt_cache_file)->DelCount());
+  report += ssprintf("Aptitude " VERSION ": %s\n%s\n\n",
+		     _("log report"), timestr.c_str());
+  report += _("IMPORTANT: this log only lists intended actions; actions which fail due to\ndpkg problems may not be completed.\n\n");
+  report += ssprintf(_("Will install %li packages, and remove %li packages.\n"),
+		     (*apt_cache_file)->InstCount(), (*apt_cache_file)->DelCount());
 
   if((*apt_cache_file)->UsrSize() > 0)
-    fprintf(f, _("%sB of disk space will be used\n"),
-	    SizeToStr((*apt_cache_file)->UsrSize()).c_str());
+    report += ssprintf(_("%sB of disk space will be used\n"),
+		       SizeToStr((*apt_cache_file)->UsrSize()).c_str());
   else if((*apt_cache_file)->UsrSize() < 0)
-    fprintf(f, _("%sB of disk space will be freed\n"),
-	    SizeToStr((*apt_cache_file)->UsrSize()).c_str());
+    report += ssprintf(_("%sB of disk space will be freed\n"),
+		       SizeToStr((*apt_cache_file)->UsrSize()).c_str());
 
-  fprintf(f, "===============================================================================\n");
+  report += "===============================================================================\n";
 
 
   for(loglist::const_iterator i = changed_packages.begin();
       i != changed_packages.end(); ++i)
     {
       if(i->second == pkg_upgrade)
-	fprintf(f, _("[UPGRADE] %s %s -> %s\n"), i->first.FullName(false).c_str(),
-		i->first.CurrentVer().VerStr(),
-		(*apt_cache_file)[i->first].CandidateVerIter(*apt_cache_file).VerStr());
+	report += ssprintf(_("[UPGRADE] %s %s -> %s\n"), i->first.FullName(false).c_str(),
+			   i->first.CurrentVer().VerStr(),
+			   (*apt_cache_file)[i->first].CandidateVerIter(*apt_cache_file).VerStr());
       else if(i->second == pkg_downgrade)
-	fprintf(f, _("[DOWNGRADE] %s %s -> %s\n"), i->first.FullName(false).c_str(),
-		i->first.CurrentVer().VerStr(),
-		(*apt_cache_file)[i->first].CandidateVerIter(*apt_cache_file).VerStr());
+	report += ssprintf(_("[DOWNGRADE] %s %s -> %s\n"), i->first.FullName(false).c_str(),
+			   i->first.CurrentVer().VerStr(),
+			   (*apt_cache_file)[i->first].CandidateVerIter(*apt_cache_file).VerStr());
       else
 	if(i->second != pkg_unchanged)
 	  {
@@ -139,19 +136,126 @@ bool do_log(const string &log,
 		break;
 	      }
 
-	    fprintf(f, _("[%s] %s\n"), tag, i->first.FullName(false).c_str());
+	    report += ssprintf(_("[%s] %s\n"), tag, i->first.FullName(false).c_str());
 	  }
     }
-  fprintf(f, _("===============================================================================\n\nLog complete.\n"));
+  report += _("===============================================================================\n\nLog complete.\n");
+
+  return report;
+}
+
+// Sets offset to the position of the report in the log, or -1 if the
+// log is a pipe.
+bool do_log(const string &log,
+	    const string &report,
+	    long &offset)
+{
+  offset = -1;
 
   if(log[0] == '|')
-    pclose(f);
-  else
-    fclose(f);
+    {
+      FILE *f = popen(log.c_str()+1, "w");
+      if(!f)
+	{
+	  _error->Errno("do_log", _("Unable to open %s to log actions"), log.c_str());
+	  return false;
+	}
+
+      fwrite(report.data(), 1, report.size(), f);
+      pclose(f);
+      return true;
+    }
+
+  // O_APPEND makes the single write() below land at the end of the
+  // file even if something else is appending to it.
+  const int fd = open(log.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+  if(fd < 0)
+    {
+      _error->Errno("do_log", _("Unable to open %s to log actions"), log.c_str());
+      return false;
+    }
 
+  struct stat buf;
+  if(fstat(fd, &buf) == 0)
+    offset = buf.st_size;
+
+  const char *where = report.data();
+  size_t remaining = report.size();
+  while(remaining > 0)
+    {
+      const ssize_t amt = write(fd, where, remaining);
+      if(amt < 0)
+	{
+	  if(errno == EINTR)
+	    continue;
+
+	  _error->Errno("do_log", _("Unable to write to %s"), log.c_str());
+	  close(fd);
+	  return false;
+	}
+
+      where += amt;
+      remaining -= amt;
+    }
+
+  close(fd);
   return true;
 }
 
+namespace
+{
+  // Untranslated names for the history index.
+  const char *index_action_name(pkg_action_state s)
+  {
+    switch(s)
+      {
+      case pkg_broken: return "broken";
+      case pkg_unused_remove: return "remove-unused";
+      case pkg_auto_hold: return "hold-auto";
+      case pkg_auto_install: return "install-auto";
+      case pkg_auto_remove: return "remove-auto";
+      case pkg_downgrade: return "downgrade";
+      case pkg_hold: return "hold";
+      case pkg_reinstall: return "reinstall";
+      case pkg_install: return "install";
+      case pkg_remove: return "remove";
+      case pkg_upgrade: return "upgrade";
+      case pkg_unconfigured: return "unconfigured";
+      default: return "unknown";
+      }
+  }
+
+  void index_changes(const loglist &changed_packages, long offset)
+  {
+    const string index_file =
+      aptcfg->Find(PACKAGE "::History-Index",
+		   (aptcfg->FindDir("Dir::Aptitude::state", STATEDIR) + "history-index").c_str());
+
+    if(index_file.empty())
+      return;
+
+    const time_t now = time(NULL);
+
+    std::vector<aptitude::history::index_entry> entries;
+    for(loglist::const_iterator i = changed_packages.begin();
+	i != changed_packages.end(); ++i)
+      {
+	const pkgCache::VerIterator current = i->first.CurrentVer();
+	const pkgCache::VerIterator install =
+	  (*apt_cache_file)[i->first].InstVerIter(*apt_cache_file);
+
+	entries.push_back(aptitude::history::index_entry(now, offset,
+							 index_action_name(i->second),
+							 i->first.FullName(false),
+							 current.end() ? "" : current.VerStr(),
+							 install.end() ? "" : install.VerStr()));
+      }
+
+    if(!aptitude::history::append_index_entries(index_file, entries))
+      _error->Warning(_("Unable to update the history index %s"), index_file.c_str());
+  }
+}
+
 struct log_sorter
 {
   pkg_name_lt plt;
@@ -199,8 +303,18 @@ void log_changes()
 
       sort(changed_packages.begin(), changed_packages.end(), log_sorter());
 
+      const string report = format_log_report(changed_packages);
+
+      long main_log_offset = -1;
       for(vector<string>::iterator i
 	    = logs.begin(); i != logs.end(); ++i)
-	do_log(*i, changed_packages);
+	{
+	  long offset;
+	  if(do_log(*i, report, offset) && i == logs.begin() &&
+	     !main_log.empty())
+	    main_log_offset = offset;
+	}
+
+      index_changes(changed_packages, main_log_offset);
     }
 }
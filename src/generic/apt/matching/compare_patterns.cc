@@ -68,6 +68,10 @@ namespace aptitude
     int compare_patterns(const ref_ptr<pattern> &p1,
 			 const ref_ptr<pattern> &p2)
     {
+      // Interned patterns often share sub-patterns.
+      if(p1 == p2)
+	return 0;
+
       // If the patterns have different constructors, order them
       // according to their constructors.
       if(p1->get_type() < p2->get_type())
@@ -313,5 +317,153 @@ namespace aptitude
 
       eassert(!"Internal error: we should never get here.");
     }
+
+    void pattern_interner::intern_list(const std::vector<ref_ptr<pattern> > &in,
+				       std::vector<ref_ptr<pattern> > &out,
+				       bool &changed)
+    {
+      out.reserve(in.size());
+      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	    in.begin(); it != in.end(); ++it)
+	{
+	  out.push_back(intern(*it));
+	  if(out.back() != *it)
+	    changed = true;
+	}
+    }
+
+    ref_ptr<pattern> pattern_interner::intern(const ref_ptr<pattern> &p)
+    {
+      std::set<ref_ptr<pattern>, compare>::const_iterator found =
+	patterns.find(p);
+      if(found != patterns.end())
+	return *found;
+
+      // Share the sub-patterns first, so that two patterns that
+      // differ only near the root still share everything below it.
+      ref_ptr<pattern> rval(p);
+      switch(p->get_type())
+	{
+	case pattern::all_versions:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_all_versions_pattern()));
+	    if(sub != p->get_all_versions_pattern())
+	      rval = pattern::make_all_versions(sub);
+	  }
+	  break;
+
+	case pattern::and_tp:
+	  {
+	    std::vector<ref_ptr<pattern> > subs;
+	    bool changed = false;
+	    intern_list(p->get_and_patterns(), subs, changed);
+	    if(changed)
+	      rval = pattern::make_and(subs);
+	  }
+	  break;
+
+	case pattern::any_version:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_any_version_pattern()));
+	    if(sub != p->get_any_version_pattern())
+	      rval = pattern::make_any_version(sub);
+	  }
+	  break;
+
+	case pattern::bind:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_bind_pattern()));
+	    if(sub != p->get_bind_pattern())
+	      rval = pattern::make_bind(p->get_bind_variable_index(), sub);
+	  }
+	  break;
+
+	case pattern::depends:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_depends_pattern()));
+	    if(sub != p->get_depends_pattern())
+	      rval = pattern::make_depends(p->get_depends_depends_type(),
+					   p->get_depends_broken(),
+					   sub);
+	  }
+	  break;
+
+	case pattern::for_tp:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_for_pattern()));
+	    if(sub != p->get_for_pattern())
+	      rval = pattern::make_for(p->get_for_variable_name(), sub);
+	  }
+	  break;
+
+	case pattern::narrow:
+	  {
+	    ref_ptr<pattern> filter(intern(p->get_narrow_filter()));
+	    ref_ptr<pattern> sub(intern(p->get_narrow_pattern()));
+	    if(filter != p->get_narrow_filter() ||
+	       sub != p->get_narrow_pattern())
+	      rval = pattern::make_narrow(filter, sub);
+	  }
+	  break;
+
+	case pattern::not_tp:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_not_pattern()));
+	    if(sub != p->get_not_pattern())
+	      rval = pattern::make_not(sub);
+	  }
+	  break;
+
+	case pattern::or_tp:
+	  {
+	    std::vector<ref_ptr<pattern> > subs;
+	    bool changed = false;
+	    intern_list(p->get_or_patterns(), subs, changed);
+	    if(changed)
+	      rval = pattern::make_or(subs);
+	  }
+	  break;
+
+	case pattern::provides:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_provides_pattern()));
+	    if(sub != p->get_provides_pattern())
+	      rval = pattern::make_provides(sub);
+	  }
+	  break;
+
+	case pattern::reverse_depends:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_reverse_depends_pattern()));
+	    if(sub != p->get_reverse_depends_pattern())
+	      rval = pattern::make_reverse_depends(p->get_reverse_depends_depends_type(),
+						   p->get_reverse_depends_broken(),
+						   sub);
+	  }
+	  break;
+
+	case pattern::reverse_provides:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_reverse_provides_pattern()));
+	    if(sub != p->get_reverse_provides_pattern())
+	      rval = pattern::make_reverse_provides(sub);
+	  }
+	  break;
+
+	case pattern::widen:
+	  {
+	    ref_ptr<pattern> sub(intern(p->get_widen_pattern()));
+	    if(sub != p->get_widen_pattern())
+	      rval = pattern::make_widen(sub);
+	  }
+	  break;
+
+	default:
+	  break;
+	}
+
+      patterns.insert(rval);
+      return rval;
+    }
   }
 }
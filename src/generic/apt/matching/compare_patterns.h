@@ -24,6 +24,9 @@
 
 #include <cwidget/generic/util/ref_ptr.h>
 
+#include <set>
+#include <vector>
+
 namespace aptitude
 {
   namespace matching
@@ -46,6 +49,42 @@ namespace aptitude
      */
     int compare_patterns(const cwidget::util::ref_ptr<pattern> &p1,
 			 const cwidget::util::ref_ptr<pattern> &p2);
+
+    /** \brief Merges patterns that are syntactically identical.
+     *
+     *  Every pattern passed through a single interner is rebuilt so
+     *  that identical sub-patterns (as decided by compare_patterns)
+     *  are represented by the same object.  Since the search cache
+     *  remembers results by pattern object, this lets a term that
+     *  occurs in several patterns be evaluated once per package
+     *  instead of once per occurrence.
+     */
+    class pattern_interner
+    {
+      struct compare
+      {
+	bool operator()(const cwidget::util::ref_ptr<pattern> &p1,
+			const cwidget::util::ref_ptr<pattern> &p2) const
+	{
+	  return compare_patterns(p1, p2) < 0;
+	}
+      };
+
+      std::set<cwidget::util::ref_ptr<pattern>, compare> patterns;
+
+      void intern_list(const std::vector<cwidget::util::ref_ptr<pattern> > &in,
+		       std::vector<cwidget::util::ref_ptr<pattern> > &out,
+		       bool &changed);
+
+    public:
+      /** \brief Return the shared representative of a pattern.
+       *
+       *  The result compares equal to p; it is p itself unless an
+       *  identical pattern, or one with identical sub-patterns, was
+       *  interned earlier.
+       */
+      cwidget::util::ref_ptr<pattern> intern(const cwidget::util::ref_ptr<pattern> &p);
+    };
   }
 }
 
@@ -0,0 +1,490 @@
+// description_index.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "description_index.h"
+
+#include <aptitude.h>
+#include <loggers.h>
+
+#include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+#include <generic/apt/cache_artifact.h>
+#include <generic/apt/config_signal.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <cwidget/generic/util/transcode.h>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+#include <locale.h>
+
+using aptitude::Loggers;
+using aptitude::apt::cache_artifact_reader;
+using aptitude::apt::cache_artifact_writer;
+using cwidget::util::transcode;
+
+namespace aptitude
+{
+  namespace matching
+  {
+    namespace
+    {
+      const char index_magic[] = "aptitude description index 1";
+
+      // Map an ASCII letter or digit to 0..35; returns -1 for
+      // anything else.  Upper-case letters are folded to lower-case,
+      // since description searches are case-insensitive.
+      //
+      // This doesn't use isalnum() because it must not depend on the
+      // locale.
+      int trigram_char_code(char c)
+      {
+	if(c >= '0' && c <= '9')
+	  return c - '0';
+	else if(c >= 'a' && c <= 'z')
+	  return 10 + (c - 'a');
+	else if(c >= 'A' && c <= 'Z')
+	  return 10 + (c - 'A');
+	else
+	  return -1;
+      }
+
+      /** \brief Append the codes of all the indexable trigrams in s
+       *  to out.
+       */
+      void get_trigrams(const std::string &s, std::vector<unsigned int> &out)
+      {
+	for(std::string::size_type i = 0; i + 2 < s.size(); ++i)
+	  {
+	    const int c0 = trigram_char_code(s[i]);
+	    const int c1 = trigram_char_code(s[i + 1]);
+	    const int c2 = trigram_char_code(s[i + 2]);
+
+	    if(c0 >= 0 && c1 >= 0 && c2 >= 0)
+	      out.push_back((c0 * 36 + c1) * 36 + c2);
+	  }
+      }
+
+      void encode_varint(unsigned long n, std::string &out)
+      {
+	while(n >= 0x80)
+	  {
+	    out.push_back(static_cast<char>((n & 0x7f) | 0x80));
+	    n >>= 7;
+	  }
+	out.push_back(static_cast<char>(n));
+      }
+
+      void flush_literal(std::string &current,
+			 std::vector<std::string> &literals)
+      {
+	if(current.size() >= 3)
+	  {
+	    std::string lowered(current);
+	    for(std::string::iterator it = lowered.begin();
+		it != lowered.end(); ++it)
+	      if(*it >= 'A' && *it <= 'Z')
+		*it = *it - 'A' + 'a';
+
+	    literals.push_back(lowered);
+	  }
+
+	current.clear();
+      }
+
+      // Drop the last character of the current literal (because it
+      // was quantified) and end the literal.
+      void drop_quantified(std::string &current,
+			   std::vector<std::string> &literals)
+      {
+	if(!current.empty())
+	  current.erase(current.size() - 1);
+
+	flush_literal(current, literals);
+      }
+
+      /** \brief Compute the string that must match for an index on
+       *  disk to be used with the current cache.
+       *
+       *  Descriptions are translated, so this includes the locale as
+       *  well as the cache itself.
+       *
+       *  \return the fingerprint, or an empty string if the cache
+       *  file can't be found (e.g., because the cache was built in
+       *  memory).
+       */
+      std::string get_index_fingerprint(aptitudeDepCache &cache)
+      {
+	const std::string cache_fingerprint = apt::get_cache_fingerprint(cache);
+	if(cache_fingerprint.empty())
+	  return std::string();
+
+	const char *locale = setlocale(LC_ALL, NULL);
+
+	return cache_fingerprint + " " + (locale == NULL ? "" : locale);
+      }
+
+      std::string get_index_path()
+      {
+	return aptcfg->Find(PACKAGE "::Search::Description-Index-File",
+			    (_config->FindDir("Dir::Cache") + "aptitude-descriptions.idx").c_str());
+      }
+
+      // The index that was most recently used, and the fingerprint
+      // of the cache it was built from.
+      boost::shared_ptr<description_index> current_index;
+      std::string current_fingerprint;
+    }
+
+    void extract_regex_literals(const std::string &regex,
+				std::vector<std::string> &literals)
+    {
+      std::vector<std::string> found;
+      std::string current;
+      int depth = 0;
+
+      for(std::string::size_type i = 0; i < regex.size(); ++i)
+	{
+	  const char c = regex[i];
+
+	  switch(c)
+	    {
+	    case '|':
+	      // An alternation outside a group means that no literal
+	      // is required.  Inside a group it only affects text we
+	      // skip anyway.
+	      if(depth == 0)
+		return;
+	      break;
+
+	    case '(':
+	      flush_literal(current, found);
+	      ++depth;
+	      break;
+
+	    case ')':
+	      flush_literal(current, found);
+	      if(depth > 0)
+		--depth;
+	      break;
+
+	    case '[':
+	      flush_literal(current, found);
+	      // Skip the bracket expression; a ']' right after the
+	      // opening bracket (or after a '^') is literal.
+	      ++i;
+	      if(i < regex.size() && regex[i] == '^')
+		++i;
+	      if(i < regex.size() && regex[i] == ']')
+		++i;
+	      while(i < regex.size() && regex[i] != ']')
+		++i;
+	      break;
+
+	    case '*':
+	    case '?':
+	      drop_quantified(current, found);
+	      break;
+
+	    case '{':
+	      drop_quantified(current, found);
+	      while(i < regex.size() && regex[i] != '}')
+		++i;
+	      break;
+
+	    case '+':
+	      // The preceding character is required at least once.
+	      flush_literal(current, found);
+	      break;
+
+	    case '.':
+	    case '^':
+	    case '$':
+	      flush_literal(current, found);
+	      break;
+
+	    case '\\':
+	      if(i + 1 < regex.size())
+		{
+		  ++i;
+		  const char escaped = regex[i];
+
+		  // Escaped letters and digits are classes or
+		  // back-references, not literals.
+		  if(trigram_char_code(escaped) >= 0 || depth > 0)
+		    flush_literal(current, found);
+		  else
+		    current.push_back(escaped);
+		}
+	      break;
+
+	    default:
+	      if(depth > 0)
+		flush_literal(current, found);
+	      else
+		current.push_back(c);
+	      break;
+	    }
+	}
+
+      flush_literal(current, found);
+
+      literals.insert(literals.end(), found.begin(), found.end());
+    }
+
+    description_index::description_index()
+      : offsets(num_trigrams + 1)
+    {
+    }
+
+    boost::shared_ptr<description_index>
+    description_index::build(aptitudeDepCache &cache, pkgRecords &records)
+    {
+      logging::LoggerPtr logger(Loggers::getAptitudeMatchingDescriptionIndex());
+
+      LOG_INFO(logger, "Building the description index.");
+
+      pkgCache &pkg_cache(cache.GetCache());
+      const unsigned long num_packages = cache.Head().PackageCount;
+
+      // Visiting packages in ID order lets us append deltas to each
+      // posting list as we go.
+      std::vector<std::string> lists(num_trigrams);
+      std::vector<unsigned long> last_id(num_trigrams, 0);
+      std::vector<bool> seen_any(num_trigrams, false);
+
+      std::vector<unsigned int> trigrams;
+      for(unsigned long id = 0; id < num_packages; ++id)
+	{
+	  pkgCache::PkgIterator pkg(pkg_cache, pkg_cache.PkgP + id);
+
+	  trigrams.clear();
+	  for(pkgCache::VerIterator ver = pkg.VersionList();
+	      !ver.end(); ++ver)
+	    get_trigrams(transcode(get_long_description(ver, &records)),
+			 trigrams);
+
+	  std::sort(trigrams.begin(), trigrams.end());
+	  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+			 trigrams.end());
+
+	  for(std::vector<unsigned int>::const_iterator it = trigrams.begin();
+	      it != trigrams.end(); ++it)
+	    {
+	      const unsigned long delta =
+		seen_any[*it] ? id - last_id[*it] : id;
+
+	      encode_varint(delta, lists[*it]);
+	      last_id[*it] = id;
+	      seen_any[*it] = true;
+	    }
+	}
+
+      boost::shared_ptr<description_index> rval(new description_index);
+
+      std::string::size_type total_size = 0;
+      for(unsigned int t = 0; t < num_trigrams; ++t)
+	total_size += lists[t].size();
+      rval->postings.reserve(total_size);
+
+      for(unsigned int t = 0; t < num_trigrams; ++t)
+	{
+	  rval->offsets[t] = rval->postings.size();
+	  rval->postings.append(lists[t]);
+	  // Free the memory as we go.
+	  std::string().swap(lists[t]);
+	}
+      rval->offsets[num_trigrams] = rval->postings.size();
+
+      LOG_INFO(logger, "Built a description index of "
+	       << rval->postings.size() << " bytes for "
+	       << num_packages << " packages.");
+
+      return rval;
+    }
+
+    boost::shared_ptr<description_index>
+    description_index::load(const std::string &path,
+			    const std::string &fingerprint)
+    {
+      logging::LoggerPtr logger(Loggers::getAptitudeMatchingDescriptionIndex());
+
+      cache_artifact_reader reader(path, index_magic, fingerprint,
+				   "description index", logger,
+				   std::ios::binary);
+      if(!reader.is_valid())
+	return boost::shared_ptr<description_index>();
+
+      std::istream &in(reader.get_stream());
+
+      boost::shared_ptr<description_index> rval(new description_index);
+      in.read(reinterpret_cast<char *>(&rval->offsets[0]),
+	      rval->offsets.size() * sizeof(unsigned int));
+      if(!in)
+	{
+	  LOG_WARN(logger, "Ignoring " << path << ": truncated offset table.");
+	  return boost::shared_ptr<description_index>();
+	}
+
+      rval->postings.resize(rval->offsets[num_trigrams]);
+      if(!rval->postings.empty())
+	in.read(&rval->postings[0], rval->postings.size());
+      if(!in)
+	{
+	  LOG_WARN(logger, "Ignoring " << path << ": truncated posting lists.");
+	  return boost::shared_ptr<description_index>();
+	}
+
+      LOG_DEBUG(logger, "Loaded the description index from " << path);
+
+      return rval;
+    }
+
+    void description_index::save(const std::string &path,
+				 const std::string &fingerprint) const
+    {
+      logging::LoggerPtr logger(Loggers::getAptitudeMatchingDescriptionIndex());
+
+      cache_artifact_writer writer(path, index_magic, fingerprint,
+				   "description index", logger,
+				   std::ios::binary);
+      if(!writer.is_open())
+	return;
+
+      std::ostream &out(writer.get_stream());
+      out.write(reinterpret_cast<const char *>(&offsets[0]),
+		offsets.size() * sizeof(unsigned int));
+      out.write(postings.data(), postings.size());
+
+      if(writer.commit())
+	LOG_DEBUG(logger, "Saved the description index to " << path);
+    }
+
+    boost::shared_ptr<description_index>
+    description_index::get(aptitudeDepCache &cache, pkgRecords &records)
+    {
+      if(!aptcfg->FindB(PACKAGE "::Search::Use-Description-Index", true))
+	return boost::shared_ptr<description_index>();
+
+      const std::string fingerprint = get_index_fingerprint(cache);
+      if(fingerprint.empty())
+	return boost::shared_ptr<description_index>();
+
+      if(current_index.get() != NULL && current_fingerprint == fingerprint)
+	return current_index;
+
+      const std::string path = get_index_path();
+
+      boost::shared_ptr<description_index> rval = load(path, fingerprint);
+      if(rval.get() == NULL)
+	{
+	  rval = build(cache, records);
+	  rval->save(path, fingerprint);
+	}
+
+      current_index = rval;
+      current_fingerprint = fingerprint;
+
+      return rval;
+    }
+
+    void description_index::decode(unsigned int trigram,
+				   std::vector<unsigned long> &out) const
+    {
+      const unsigned char *it =
+	reinterpret_cast<const unsigned char *>(postings.data()) + offsets[trigram];
+      const unsigned char * const end =
+	reinterpret_cast<const unsigned char *>(postings.data()) + offsets[trigram + 1];
+
+      unsigned long id = 0;
+      while(it != end)
+	{
+	  unsigned long delta = 0;
+	  int shift = 0;
+	  while(it != end && (*it & 0x80) != 0)
+	    {
+	      delta |= static_cast<unsigned long>(*it & 0x7f) << shift;
+	      shift += 7;
+	      ++it;
+	    }
+	  if(it != end)
+	    {
+	      delta |= static_cast<unsigned long>(*it) << shift;
+	      ++it;
+	    }
+
+	  id += delta;
+	  out.push_back(id);
+	}
+    }
+
+    bool description_index::get_candidates(const std::string &regex,
+					   std::vector<unsigned long> &candidates) const
+    {
+      std::vector<std::string> literals;
+      extract_regex_literals(regex, literals);
+
+      std::vector<unsigned int> trigrams;
+      for(std::vector<std::string>::const_iterator it = literals.begin();
+	  it != literals.end(); ++it)
+	get_trigrams(*it, trigrams);
+
+      if(trigrams.empty())
+	return false;
+
+      std::sort(trigrams.begin(), trigrams.end());
+      trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+		     trigrams.end());
+
+      // Start from the shortest posting list so the intersection
+      // stays small.
+      std::vector<unsigned int>::iterator shortest = trigrams.begin();
+      for(std::vector<unsigned int>::iterator it = trigrams.begin();
+	  it != trigrams.end(); ++it)
+	if(offsets[*it + 1] - offsets[*it] < offsets[*shortest + 1] - offsets[*shortest])
+	  shortest = it;
+      std::swap(*trigrams.begin(), *shortest);
+
+      std::vector<unsigned long> result;
+      decode(trigrams.front(), result);
+
+      std::vector<unsigned long> postings, intersection;
+      for(std::vector<unsigned int>::const_iterator it = trigrams.begin() + 1;
+	  it != trigrams.end() && !result.empty(); ++it)
+	{
+	  postings.clear();
+	  decode(*it, postings);
+
+	  intersection.clear();
+	  std::set_intersection(result.begin(), result.end(),
+				postings.begin(), postings.end(),
+				std::back_inserter(intersection));
+	  result.swap(intersection);
+	}
+
+      candidates.swap(result);
+      return true;
+    }
+  }
+}
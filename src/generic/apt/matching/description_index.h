@@ -0,0 +1,118 @@
+// description_index.h    -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef DESCRIPTION_INDEX_H
+#define DESCRIPTION_INDEX_H
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+class aptitudeDepCache;
+class pkgRecords;
+
+namespace aptitude
+{
+  namespace matching
+  {
+    /** \brief Extract the literal strings that any match of a
+     *  regular expression must contain.
+     *
+     *  This is deliberately conservative: text inside groups,
+     *  bracket expressions and characters that are made optional by
+     *  a quantifier are never reported, and a top-level alternation
+     *  yields no literals at all.  Literals shorter than three
+     *  characters are dropped, and the rest are lowercased.
+     *
+     *  \param regex     The text of an extended regular expression.
+     *  \param literals  A vector to which the literals are appended.
+     */
+    void extract_regex_literals(const std::string &regex,
+				std::vector<std::string> &literals);
+
+    /** \brief A trigram index over the long descriptions of every
+     *  package version in the cache.
+     *
+     *  For each trigram of ASCII letters and digits, the index
+     *  stores the IDs of the packages that have a version whose
+     *  description contains that trigram (ignoring case).  This lets
+     *  description searches skip most packages without fetching
+     *  their records.  The index is only a pre-filter: candidate
+     *  packages must still be checked against the real regular
+     *  expression.
+     *
+     *  The index is stored on disk next to the apt cache and is
+     *  rebuilt whenever pkgcache.bin changes.
+     */
+    class description_index
+    {
+      // The posting list of trigram t is the byte range
+      // [offsets[t], offsets[t + 1]) of postings.  Each list is a
+      // sequence of package ID deltas in increasing order, encoded
+      // as variable-length integers.
+      std::vector<unsigned int> offsets;
+      std::string postings;
+
+      description_index();
+
+      static boost::shared_ptr<description_index>
+      build(aptitudeDepCache &cache, pkgRecords &records);
+
+      static boost::shared_ptr<description_index>
+      load(const std::string &path, const std::string &fingerprint);
+
+      void save(const std::string &path, const std::string &fingerprint) const;
+
+      void decode(unsigned int trigram, std::vector<unsigned long> &out) const;
+
+    public:
+      /** \brief The number of distinct trigrams that are indexed. */
+      static const unsigned int num_trigrams = 36 * 36 * 36;
+
+      /** \brief Retrieve the description index for the given cache.
+       *
+       *  The index is loaded from disk if it is up-to-date, and built
+       *  (and saved, if possible) otherwise.  The result is kept in
+       *  memory until the cache changes.
+       *
+       *  \return the index, or an invalid pointer if the index is
+       *  disabled or can't be built for this cache.
+       */
+      static boost::shared_ptr<description_index>
+      get(aptitudeDepCache &cache, pkgRecords &records);
+
+      /** \brief Find the packages whose descriptions could match a
+       *  regular expression.
+       *
+       *  \param regex       The text of the regular expression.
+       *  \param candidates  Set to the sorted IDs of the packages
+       *                     that might match.
+       *
+       *  \return \b true if the index could narrow down the search;
+       *  \b false if every package has to be tested (in which case
+       *  candidates is left unchanged).
+       */
+      bool get_candidates(const std::string &regex,
+			  std::vector<unsigned long> &candidates) const;
+    };
+  }
+}
+
+#endif // DESCRIPTION_INDEX_H
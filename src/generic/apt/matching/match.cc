@@ -19,12 +19,16 @@
 
 #include "match.h"
 
+#include "match_profile.h"
+
 #include <aptitude.h>
 
 #include <generic/apt/apt.h>
+#include <generic/apt/config_signal.h>
 #include <generic/apt/tags.h>
 #include <generic/apt/tasks.h>
 #include <generic/util/progress_info.h>
+#include <generic/util/thread_pool.h>
 #include <generic/util/util.h>
 
 #include <apt-pkg/error.h>
@@ -32,9 +36,14 @@
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/version.h>
 
+#include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/generic/util/transcode.h>
 
+#include <sigc++/bind.h>
+#include <sigc++/functors/ptr_fun.h>
+
 #ifdef HAVE_EPT_TEXTSEARCH
+#include <ept/textsearch/maint/path.h>
 #include <ept/textsearch/textsearch.h>
 #else
 #ifdef HAVE_EPT_AXI
@@ -47,14 +56,20 @@
 #include <xapian/enquire.h>
 
 #include <algorithm>
+#include <limits>
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
+#include "description_index.h"
+#include "pattern_cost.h"
 #include "serialize.h"
 
+using aptitude::util::cancel_token;
 using aptitude::util::progress_info;
+using aptitude::util::thread_pool;
 using boost::unordered_map;
+using cwidget::util::ssprintf;
 using cwidget::util::transcode;
 using cwidget::util::ref_ptr;
 
@@ -101,6 +116,145 @@ namespace aptitude
       }
 #endif
 
+      /** \brief Return the time at which the debtags index was last
+       *  rebuilt, or 0 if it doesn't exist.
+       */
+      time_t get_debtags_db_timestamp()
+      {
+#ifdef HAVE_EPT_TEXTSEARCH
+        return ept::textsearch::Path::indexTimestamp();
+#else
+        return ept::axi::timestamp();
+#endif
+      }
+
+      debtags_db *open_debtags_db()
+      {
+#ifdef HAVE_EPT_TEXTSEARCH
+        return new ept::textsearch::TextSearch;
+#else
+        return new Xapian::Database(ept::axi::path_db());
+#endif
+      }
+
+      /** \brief Keeps the debtags database open between searches.
+       *
+       *  Opening the index is much more expensive than most of the
+       *  searches that use it, and incremental searches run one
+       *  search per keystroke.  So each search cache borrows an open
+       *  handle from here and gives it back when it's destroyed.
+       *
+       *  A Xapian::Database can't be used by two threads at once, so
+       *  rather than a single handle there's a list of idle ones, and
+       *  a new one is opened only when every existing handle is in
+       *  use.  All the handles are dropped when the index is rebuilt
+       *  on disk; the caches that are still holding an old one keep
+       *  using it until they're destroyed.
+       *
+       *  All the methods are thread-safe.
+       */
+      class debtags_db_pool
+      {
+        cwidget::threads::mutex m;
+
+        // The handles that aren't being used by a search cache.
+        std::vector<boost::shared_ptr<debtags_db> > idle;
+
+        // The timestamp of the index that the idle handles belong
+        // to, and a counter that's incremented whenever it changes.
+        time_t timestamp;
+        unsigned long generation;
+
+        // Set if the index couldn't be opened; it isn't tried again
+        // until its timestamp changes.
+        bool open_failed;
+
+        // The most idle handles to keep around.
+        static const std::size_t max_idle = 4;
+
+        debtags_db_pool()
+          : timestamp(0), generation(0), open_failed(false)
+        {
+        }
+
+      public:
+        static debtags_db_pool &get()
+        {
+          // Deliberately leaked, like the thread pool: search caches
+          // can give their handles back while global destructors
+          // run.
+          static debtags_db_pool *pool = new debtags_db_pool;
+
+          return *pool;
+        }
+
+        /** \brief Borrow an open handle.
+         *
+         *  \param out_generation  Set to the generation of the handle,
+         *                         which should be passed to release().
+         *
+         *  \return an open handle, or NULL if the index can't be
+         *  opened.
+         */
+        boost::shared_ptr<debtags_db> acquire(unsigned long &out_generation)
+        {
+          const time_t current_timestamp = get_debtags_db_timestamp();
+
+          cwidget::threads::mutex::lock l(m);
+
+          if(current_timestamp != timestamp)
+            {
+              idle.clear();
+              timestamp = current_timestamp;
+              ++generation;
+              open_failed = false;
+            }
+
+          out_generation = generation;
+
+          if(!idle.empty())
+            {
+              boost::shared_ptr<debtags_db> rval(idle.back());
+              idle.pop_back();
+              return rval;
+            }
+
+          if(open_failed)
+            return boost::shared_ptr<debtags_db>();
+
+          // Opening the index can take a while; don't make the other
+          // searches wait for it.
+          l.release();
+
+          boost::shared_ptr<debtags_db> rval;
+          try
+            {
+              rval.reset(open_debtags_db());
+            }
+          catch(...)
+            {
+              l.acquire();
+              if(generation == out_generation)
+                open_failed = true;
+            }
+
+          return rval;
+        }
+
+        /** \brief Give back a handle returned by acquire(). */
+        void release(const boost::shared_ptr<debtags_db> &db,
+                     unsigned long db_generation)
+        {
+          if(db.get() == NULL)
+            return;
+
+          cwidget::threads::mutex::lock l(m);
+
+          if(db_generation == generation && idle.size() < max_idle)
+            idle.push_back(db);
+        }
+      };
+
       /** \brief Evaluate any regular expression-based pattern.
        *
        *  \param p      The pattern to evaluate.
@@ -198,14 +352,21 @@ namespace aptitude
 	 *  matched by this pattern.
 	 */
 	bool maybe_contains_package(const pkgCache::PkgIterator &pkg,
-				    const boost::scoped_ptr<debtags_db> &db) const
+				    const boost::shared_ptr<debtags_db> &db) const
 	{
 	  if(!matched_packages_valid || !db)
 	    return true;
-	  else
-	    return std::binary_search(matched_packages.begin(),
-				      matched_packages.end(),
-				      get_docid_by_name(*db, pkg.Name()));
+
+	  // A package that isn't in the index at all (because the
+	  // index is older than the package lists) can't be ruled
+	  // out here; the full matcher decides.
+	  const Xapian::docid docid = get_docid_by_name(*db, pkg.Name());
+	  if(docid == Xapian::docid())
+	    return true;
+
+	  return std::binary_search(matched_packages.begin(),
+				    matched_packages.end(),
+				    docid);
 	}
 
 	xapian_info()
@@ -220,6 +381,253 @@ namespace aptitude
 		   const ref_ptr<pattern> &pattern,
 		   bool debug);
       };
+
+      /** \brief Return \b true if p uses the variable stack (that
+       *  is, if it contains ?bind, ?= or ?for).
+       *
+       *  The result of matching such a pattern can depend on the
+       *  state of the stack, and evaluating it can change the stack,
+       *  so it must be evaluated exactly where and when it appears.
+       */
+      bool references_stack(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::bind:
+	  case pattern::equal:
+	  case pattern::for_tp:
+	    return true;
+
+	  case pattern::all_versions:
+	    return references_stack(p->get_all_versions_pattern());
+
+	  case pattern::and_tp:
+	  case pattern::or_tp:
+	    {
+	      const std::vector<ref_ptr<pattern> > &sub_patterns =
+		p->get_type() == pattern::and_tp
+		  ? p->get_and_patterns()
+		  : p->get_or_patterns();
+
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		if(references_stack(*it))
+		  return true;
+
+	      return false;
+	    }
+
+	  case pattern::any_version:
+	    return references_stack(p->get_any_version_pattern());
+
+	  case pattern::depends:
+	    return references_stack(p->get_depends_pattern());
+
+	  case pattern::narrow:
+	    return
+	      references_stack(p->get_narrow_filter()) ||
+	      references_stack(p->get_narrow_pattern());
+
+	  case pattern::not_tp:
+	    return references_stack(p->get_not_pattern());
+
+	  case pattern::provides:
+	    return references_stack(p->get_provides_pattern());
+
+	  case pattern::reverse_depends:
+	    return references_stack(p->get_reverse_depends_pattern());
+
+	  case pattern::reverse_provides:
+	    return references_stack(p->get_reverse_provides_pattern());
+
+	  case pattern::widen:
+	    return references_stack(p->get_widen_pattern());
+
+	  default:
+	    return false;
+	  }
+      }
+
+      /** \brief Return \b true if it's worth remembering the result
+       *  of matching p against each package or version during a
+       *  search.
+       *
+       *  This is the case for terms that start a new search over
+       *  the dependency graph, or that have to read the package
+       *  records, as long as their result doesn't depend on the
+       *  variable stack.
+       */
+      bool should_memoize(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::depends:
+	  case pattern::description:
+	  case pattern::maintainer:
+	  case pattern::provides:
+	  case pattern::reverse_depends:
+	  case pattern::reverse_provides:
+	  case pattern::source_package:
+	  case pattern::source_version:
+	    return !references_stack(p);
+
+	  default:
+	    return false;
+	  }
+      }
+
+      /** \brief A pattern lowered to a flat sequence of instructions.
+       *
+       *  The structural skeleton of a pattern (?and, ?or, ?not,
+       *  ?all-versions, ?any-version, ?for, ?narrow and ?widen) is
+       *  laid out in preorder in a single vector.  The children of a
+       *  structural instruction immediately follow it, and each
+       *  instruction stores the index one past the end of its
+       *  subtree; this is both the "next sibling" link used to walk
+       *  the children of a node and the target of the jump taken
+       *  when a node short-circuits.
+       *
+       *  The terms of an ?and are laid out in the order chosen by
+       *  get_conjunction_order(), so that cheap and selective terms
+       *  are tried first; each instruction remembers its position in
+       *  the source pattern so that the sub-matches can be reported
+       *  in their original order.  Terms that use the variable stack
+       *  are never reordered.
+       *
+       *  Every other term is a leaf of the program, and is handed
+       *  to evaluate_atomic() as before.  Terms that start a new
+       *  search (e.g., ?depends) compile their sub-patterns
+       *  separately the first time they are evaluated.
+       *
+       *  Executing a program produces exactly the same
+       *  structural_match tree as walking the original pattern.
+       */
+      class compiled_pattern
+      {
+      public:
+	struct instruction
+	{
+	  /** \brief The type of the source pattern, copied here so
+	   *  that dispatch doesn't have to chase the pattern pointer.
+	   */
+	  pattern::type tp;
+
+	  /** \brief The index one past the end of this instruction's
+	   *  subtree.
+	   */
+	  unsigned int end;
+
+	  /** \brief The position of this instruction's pattern among
+	   *  the sub-patterns of its parent.
+	   */
+	  unsigned int slot;
+
+	  /** \brief Whether the results of a leaf instruction are
+	   *  stored in the search cache (see should_memoize()).
+	   */
+	  bool memoize;
+
+	  /** \brief The source pattern of this instruction. */
+	  ref_ptr<pattern> p;
+
+	  instruction(pattern::type _tp, const ref_ptr<pattern> &_p,
+		      unsigned int _slot)
+	    : tp(_tp), end(0), slot(_slot), memoize(should_memoize(_p)), p(_p)
+	  {
+	  }
+	};
+
+      private:
+	std::vector<instruction> instructions;
+
+	void compile(const ref_ptr<pattern> &p, unsigned int slot)
+	{
+	  const unsigned int pc = instructions.size();
+	  instructions.push_back(instruction(p->get_type(), p, slot));
+
+	  switch(p->get_type())
+	    {
+	    case pattern::all_versions:
+	      compile(p->get_all_versions_pattern(), 0);
+	      break;
+
+	    case pattern::and_tp:
+	      {
+		const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_and_patterns());
+		std::vector<std::size_t> order;
+
+		if(references_stack(p))
+		  for(std::size_t i = 0; i < sub_patterns.size(); ++i)
+		    order.push_back(i);
+		else
+		  get_conjunction_order(sub_patterns, order);
+
+		for(std::vector<std::size_t>::const_iterator it =
+		      order.begin(); it != order.end(); ++it)
+		  compile(sub_patterns[*it], *it);
+	      }
+	      break;
+
+	    case pattern::any_version:
+	      compile(p->get_any_version_pattern(), 0);
+	      break;
+
+	    case pattern::for_tp:
+	      compile(p->get_for_pattern(), 0);
+	      break;
+
+	    case pattern::narrow:
+	      // The filter is always the first child.
+	      compile(p->get_narrow_filter(), 0);
+	      compile(p->get_narrow_pattern(), 1);
+	      break;
+
+	    case pattern::not_tp:
+	      compile(p->get_not_pattern(), 0);
+	      break;
+
+	    case pattern::or_tp:
+	      {
+		// ?or never short-circuits, so there's nothing to gain
+		// by reordering its terms.
+		const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_or_patterns());
+		for(std::size_t i = 0; i < sub_patterns.size(); ++i)
+		  compile(sub_patterns[i], i);
+	      }
+	      break;
+
+	    case pattern::widen:
+	      compile(p->get_widen_pattern(), 0);
+	      break;
+
+	    default:
+	      // Everything else is a leaf.
+	      break;
+	    }
+
+	  instructions[pc].end = instructions.size();
+	}
+
+      public:
+	compiled_pattern()
+	{
+	}
+
+	explicit compiled_pattern(const ref_ptr<pattern> &p)
+	{
+	  compile(p, 0);
+	}
+
+	const instruction &operator[](unsigned int pc) const
+	{
+	  return instructions[pc];
+	}
+
+	unsigned int size() const
+	{
+	  return instructions.size();
+	}
+      };
     }
 
     std::string structural_match::get_group(unsigned int group_num) const
@@ -312,7 +720,9 @@ namespace aptitude
     // collected in one place.
     class search_cache::implementation : public search_cache
     {
-      typedef std::map<std::pair<ref_ptr<pattern>, aptitudeDepCache::user_tag>, ref_ptr<match> > user_tag_match_map;
+      // The match of each ?user-tag pattern against each known tag,
+      // indexed by the tag's position in the cache's list of tags.
+      typedef std::map<ref_ptr<pattern>, std::vector<ref_ptr<match> > > user_tag_match_map;
 
       user_tag_match_map user_tag_matches;
 
@@ -325,9 +735,10 @@ namespace aptitude
 	}
       };
 
-      // Either a pointer to the debtags database, or NULL if it
-      // couldn't be initialized.
-      boost::scoped_ptr<debtags_db> db;
+      // Either a handle borrowed from the debtags_db_pool, or NULL
+      // if the database couldn't be opened.
+      boost::shared_ptr<debtags_db> db;
+      unsigned long db_generation;
 
       // Maps "top-level" patterns to their Xapian information (that
       // is, the corresponding query and/or query results).  Term hit
@@ -335,6 +746,84 @@ namespace aptitude
       // top-level term is filled in the first time it's encountered.
       std::map<ref_ptr<pattern>, xapian_info> toplevel_xapian_info;
 
+      // Maps each pattern that has been evaluated structurally to its
+      // compiled form.
+      std::map<ref_ptr<pattern>, compiled_pattern> compiled_patterns;
+
+      // The remembered results of matching a single atomic term
+      // against each package and version.  Entries are indexed by
+      // version ID, followed by the package IDs (for matches against
+      // virtual packages).
+      struct atomic_memo
+      {
+	// Which entries have been computed, and which of those
+	// matched.
+	std::vector<bool> known;
+	std::vector<bool> matched;
+
+	// The match objects for the entries that matched.
+	unordered_map<unsigned long, ref_ptr<match> > matches;
+      };
+
+      // Memoized atomic results, keyed by the term they belong to.
+      // Limited to max_atomic_memos terms to bound memory use.
+      std::map<ref_ptr<pattern>, atomic_memo> atomic_memos;
+      static const std::size_t max_atomic_memos = 64;
+
+      // The results of matching each ?archive and ?origin term
+      // against the package files, indexed by file ID.  There are
+      // only a few dozen package files, which are shared by most
+      // versions, so each regular expression only runs once per file
+      // instead of once per version.
+      struct package_file_memo
+      {
+	std::vector<bool> known;
+	std::vector<ref_ptr<match> > matches;
+      };
+
+      std::map<ref_ptr<pattern>, package_file_memo> package_file_memos;
+
+      static unsigned long get_memo_index(const matchable &target,
+					  const aptitudeDepCache &cache)
+      {
+	if(target.get_has_version())
+	  return target.get_ver()->ID;
+	else
+	  return cache.Head().VersionCount + target.get_pkg()->ID;
+      }
+
+      // The packages and versions that can satisfy each OR group,
+      // sorted, indexed by the ID of the group's first dependency.
+      // Each entry is a range of dep_target_list, or starts at
+      // range_unknown if it hasn't been computed yet.  Like the
+      // atomic memos, these only depend on the package lists, so
+      // they stay valid for the life of the search cache.
+      std::vector<std::pair<unsigned long, unsigned long> > dep_target_ranges;
+      std::vector<matchable> dep_target_list;
+
+    public:
+      /** \brief A dependency whose version restriction is satisfied
+       *  by a particular package or version.
+       */
+      struct reverse_dependency
+      {
+	pkgCache::Dependency *dep;
+
+	// \b true if the dependency is on a package provided by the
+	// version, rather than on the version's own package.
+	bool via_provides;
+      };
+
+    private:
+
+      // The dependencies that each package and version might
+      // satisfy, indexed like the atomic memos, in the same form as
+      // dep_target_ranges.
+      std::vector<std::pair<unsigned long, unsigned long> > revdep_ranges;
+      std::vector<reverse_dependency> revdep_list;
+
+      static const unsigned long range_unknown = static_cast<unsigned long>(-1);
+
       // Maps each term that has been looked up to a sorted list of
       // the packages it matches.
       std::map<std::string, std::vector<Xapian::docid> > matched_terms;
@@ -398,56 +887,100 @@ namespace aptitude
       }
 
     public:
-      implementation()
+      /** \brief Create a search cache.
+       *
+       *  \param open_db  If \b false, the Xapian database is not
+       *                  opened and term searches fall back to
+       *                  regular expressions.  Used by the parallel
+       *                  search workers, which only evaluate patterns
+       *                  that never consult the index.
+       */
+      // Where to record the cost of each pattern node, or NULL.
+      match_profile *profile;
+
+      explicit implementation(bool open_db = true)
+        : db_generation(0), profile(NULL)
       {
-	try
-	  {
-#ifdef HAVE_EPT_TEXTSEARCH
-	    db.reset(new ept::textsearch::TextSearch);
-#else
-#ifdef HAVE_EPT_AXI
-            db.reset(new Xapian::Database(ept::axi::path_db()));
-#else
-#error "Can't figure out how to create the debtags database."
-#endif
-#endif
-	  }
-	catch(...)
-	  {
-	    db.reset();
-	  }
+	if(open_db)
+	  db = debtags_db_pool::get().acquire(db_generation);
       }
 
-      const boost::scoped_ptr<debtags_db> &get_db() const
+      ~implementation()
+      {
+	debtags_db_pool::get().release(db, db_generation);
+      }
+
+      const boost::shared_ptr<debtags_db> &get_db() const
       {
 	return db;
       }
 
-      // Return a match of the given user tag to the given pattern,
-      // which must be a ?user-tag pattern.  If possible, this looks
-      // the match up using the internal cache; otherwise, it creates
-      // a new cache entry for the given pattern and tag.
-      ref_ptr<match> find_user_tag_match(const ref_ptr<pattern> &p,
-					 aptitudeDepCache::user_tag tag,
-					 const aptitudeDepCache &cache,
-					 bool debug)
+      match_profile *get_profile() const
+      {
+	return profile;
+      }
+
+      void set_profile(match_profile *_profile)
+      {
+	profile = _profile;
+      }
+
+      // Return the matches of the given ?user-tag pattern against
+      // every tag the cache knows about; the entry for a tag is
+      // invalid if the tag doesn't match.  Tags that were created
+      // since the last call are tested and added to the internal
+      // cache.
+      const std::vector<ref_ptr<match> > &
+      find_user_tag_matches(const ref_ptr<pattern> &p,
+			    const aptitudeDepCache &cache,
+			    bool debug)
       {
-	std::pair<ref_ptr<pattern>, aptitudeDepCache::user_tag>
-	  key(std::make_pair(p, tag));
-	user_tag_match_map::iterator cached_match(user_tag_matches.find(key));
+	std::vector<ref_ptr<match> > &matches(user_tag_matches[p]);
+
+	for(std::size_t n = matches.size(); n < cache.get_user_tag_count(); ++n)
+	  matches.push_back(evaluate_regexp(p,
+					    p->get_user_tag_regex_info(),
+					    cache.deref_user_tag(cache.get_user_tag(n)).c_str(),
+					    debug));
 
-	if(cached_match == user_tag_matches.end())
+	return matches;
+      }
+
+      // Return the match of the given ?archive or ?origin pattern
+      // against the corresponding field of a package file.  The
+      // result is computed the first time each file is tested.
+      ref_ptr<match> find_package_file_match(const ref_ptr<pattern> &p,
+					     const pkgCache::PkgFileIterator &file,
+					     const aptitudeDepCache &cache,
+					     bool debug)
+      {
+	package_file_memo &memo = package_file_memos[p];
+	if(memo.known.empty())
 	  {
-	    ref_ptr<match> m = evaluate_regexp(p,
-					       p->get_user_tag_regex_info(),
-					       cache.deref_user_tag(tag).c_str(),
-					       debug);
+	    memo.known.resize(cache.Head().PackageFileCount, false);
+	    memo.matches.resize(cache.Head().PackageFileCount);
+	  }
 
-	    user_tag_matches[key] = m;
-	    return m;
+	const unsigned long id = file->ID;
+	if(!memo.known[id])
+	  {
+	    const bool is_archive = (p->get_type() == pattern::archive);
+	    const char * const value =
+	      is_archive ? file.Archive() : file.Origin();
+
+	    if(value != NULL)
+	      memo.matches[id] =
+		evaluate_regexp(p,
+				is_archive
+				  ? p->get_archive_regex_info()
+				  : p->get_origin_regex_info(),
+				value,
+				debug);
+
+	    memo.known[id] = true;
 	  }
-	else
-	  return cached_match->second;
+
+	return memo.matches[id];
       }
 
       bool term_prefix_matches(const matchable &target,
@@ -645,53 +1178,265 @@ namespace aptitude
 
     public:
 
-      const xapian_info &get_toplevel_xapian_info(const ref_ptr<pattern> &toplevel,
-						  bool debug)
+      /** \brief Look up a memoized atomic result.
+       *
+       *  \param result  Set to the remembered match (which may be
+       *                 NULL) if there is one.
+       *
+       *  \return \b true if a result was remembered.
+       */
+      bool find_atomic_memo(const ref_ptr<pattern> &p,
+			    const matchable &target,
+			    const aptitudeDepCache &cache,
+			    ref_ptr<match> &result) const
       {
-	std::map<ref_ptr<pattern>, xapian_info>::iterator found =
-	  toplevel_xapian_info.find(toplevel);
+	std::map<ref_ptr<pattern>, atomic_memo>::const_iterator found =
+	  atomic_memos.find(p);
 
-	if(found == toplevel_xapian_info.end())
-	  {
-	    std::map<ref_ptr<pattern>, xapian_info>::iterator inserted =
-	      toplevel_xapian_info.insert(std::make_pair(toplevel, xapian_info())).first;
+	if(found == atomic_memos.end())
+	  return false;
 
-	    xapian_info &rval(inserted->second);
-	    if(db.get() != NULL)
-	      rval.setup(get_xapian_db(*db), toplevel, debug);
+	const unsigned long idx = get_memo_index(target, cache);
+	if(idx >= found->second.known.size() || !found->second.known[idx])
+	  return false;
 
-	    return rval;
-	  }
+	if(!found->second.matched[idx])
+	  result = NULL;
 	else
-	  return found->second;
-      }
-    };
- 
-    search_cache::search_cache()
-    {
-    }
+	  result = found->second.matches.find(idx)->second;
 
-    ref_ptr<search_cache> search_cache::create()
-    {
-      return new implementation;
-    }
+	return true;
+      }
 
-    namespace
-    {
-      Xapian::Query stem_term(const std::string &term)
+      /** \brief Remember the result of matching an atomic term
+       *  against a package or version.
+       */
+      void store_atomic_memo(const ref_ptr<pattern> &p,
+			     const matchable &target,
+			     const aptitudeDepCache &cache,
+			     const ref_ptr<match> &result)
       {
-	return Xapian::Query(Xapian::Query::OP_OR,
-			     Xapian::Query(term),
-			     Xapian::Stem("en")(term));
+	std::map<ref_ptr<pattern>, atomic_memo>::iterator found =
+	  atomic_memos.find(p);
+
+	if(found == atomic_memos.end())
+	  {
+	    if(atomic_memos.size() >= max_atomic_memos)
+	      return;
+
+	    const std::size_t size =
+	      cache.Head().VersionCount + cache.Head().PackageCount;
+
+	    found = atomic_memos.insert(std::make_pair(p, atomic_memo())).first;
+	    found->second.known.resize(size, false);
+	    found->second.matched.resize(size, false);
+	  }
+
+	const unsigned long idx = get_memo_index(target, cache);
+	if(idx >= found->second.known.size())
+	  return;
+
+	found->second.known[idx] = true;
+	if(result.valid())
+	  {
+	    found->second.matched[idx] = true;
+	    found->second.matches[idx] = result;
+	  }
       }
 
-      /** \brief Describes how version-by-version matching is carried
-       *  out.
+      /** \brief Append the packages and versions that can satisfy
+       *  an OR group to a list, in sorted order.
+       *
+       *  The targets are worked out the first time each group is
+       *  requested.  The caller gets a copy, since evaluating a
+       *  pattern against the targets can add more groups to the
+       *  table.
+       *
+       *  \param or_group_start  The first dependency of the group.
        */
-      enum structural_eval_mode
-	{
-	  /** \brief All the versions in the current pool must match. */
-	  structural_eval_all,
+      void get_dep_targets(const pkgCache::DepIterator &or_group_start,
+			   const aptitudeDepCache &cache,
+			   std::vector<matchable> &out)
+      {
+	if(dep_target_ranges.empty())
+	  dep_target_ranges.resize(cache.Head().DependsCount,
+				   std::make_pair(range_unknown, range_unknown));
+
+	const unsigned long id = or_group_start->ID;
+	if(id >= dep_target_ranges.size())
+	  return;
+
+	std::pair<unsigned long, unsigned long> &range = dep_target_ranges[id];
+	if(range.first == range_unknown)
+	  {
+	    range.first = dep_target_list.size();
+
+	    pkgCache::DepIterator dep = or_group_start;
+	    while(1)
+	      {
+		pkgCache::PkgIterator pkg(dep.TargetPkg());
+		if(pkg.VersionList().end())
+		  dep_target_list.push_back(matchable(pkg));
+		else
+		  {
+		    for(pkgCache::VerIterator i = pkg.VersionList(); !i.end(); ++i)
+		      if(_system->VS->CheckDep(i.VerStr(), dep->CompareOp, dep.TargetVer()))
+			dep_target_list.push_back(matchable(pkg, i));
+		  }
+
+		if((dep->CompareOp & pkgCache::Dep::Or) == 0)
+		  break;
+		else
+		  ++dep;
+	      }
+
+	    range.second = dep_target_list.size();
+	    std::sort(dep_target_list.begin() + range.first,
+		      dep_target_list.end());
+	  }
+
+	out.insert(out.end(),
+		   dep_target_list.begin() + range.first,
+		   dep_target_list.begin() + range.second);
+      }
+
+      /** \brief Append the dependencies whose version restriction
+       *  is satisfied by a package or version to a list.
+       *
+       *  This includes dependencies on the version's package, then
+       *  dependencies on the packages it provides, and is worked out
+       *  the first time each target is requested.  It doesn't
+       *  depend on the dependency type, so one list serves every
+       *  ?reverse-TYPE term.
+       */
+      void get_reverse_dependencies(const matchable &target,
+				    aptitudeDepCache &cache,
+				    std::vector<reverse_dependency> &out)
+      {
+	if(revdep_ranges.empty())
+	  revdep_ranges.resize(cache.Head().VersionCount + cache.Head().PackageCount,
+			       std::make_pair(range_unknown, range_unknown));
+
+	const unsigned long idx = get_memo_index(target, cache);
+	if(idx >= revdep_ranges.size())
+	  return;
+
+	std::pair<unsigned long, unsigned long> &range = revdep_ranges[idx];
+	if(range.first == range_unknown)
+	  {
+	    range.first = revdep_list.size();
+
+	    const pkgCache::PkgIterator pkg = target.get_package_iterator(cache);
+	    pkgCache::VerIterator ver;
+	    if(target.get_has_version())
+	      ver = target.get_version_iterator(cache);
+
+	    for(pkgCache::DepIterator d = pkg.RevDependsList();
+		!d.end(); ++d)
+	      if(!d.TargetVer() ||
+		 (target.get_has_version() &&
+		  _system->VS->CheckDep(ver.VerStr(), d->CompareOp, d.TargetVer())))
+		{
+		  reverse_dependency r;
+		  r.dep = &*d;
+		  r.via_provides = false;
+		  revdep_list.push_back(r);
+		}
+
+	    if(target.get_has_version())
+	      for(pkgCache::PrvIterator prv = ver.ProvidesList();
+		  !prv.end(); ++prv)
+		for(pkgCache::DepIterator d = prv.ParentPkg().RevDependsList();
+		    !d.end(); ++d)
+		  if(d.TargetVer() == NULL ||
+		     (prv.ProvideVersion() != NULL &&
+		      _system->VS->CheckDep(ver.VerStr(), d->CompareOp, d.TargetVer())))
+		    {
+		      reverse_dependency r;
+		      r.dep = &*d;
+		      r.via_provides = true;
+		      revdep_list.push_back(r);
+		    }
+
+	    range.second = revdep_list.size();
+	  }
+
+	out.insert(out.end(),
+		   revdep_list.begin() + range.first,
+		   revdep_list.begin() + range.second);
+      }
+
+      /** \brief Retrieve the compiled form of the given pattern,
+       *  compiling it the first time it is requested.
+       */
+      const compiled_pattern &get_compiled_pattern(const ref_ptr<pattern> &p)
+      {
+	std::map<ref_ptr<pattern>, compiled_pattern>::iterator found =
+	  compiled_patterns.find(p);
+
+	if(found == compiled_patterns.end())
+	  found = compiled_patterns.insert(std::make_pair(p, compiled_pattern(p))).first;
+
+	return found->second;
+      }
+
+      const xapian_info &get_toplevel_xapian_info(const ref_ptr<pattern> &toplevel,
+						  bool debug)
+      {
+	std::map<ref_ptr<pattern>, xapian_info>::iterator found =
+	  toplevel_xapian_info.find(toplevel);
+
+	if(found == toplevel_xapian_info.end())
+	  {
+	    std::map<ref_ptr<pattern>, xapian_info>::iterator inserted =
+	      toplevel_xapian_info.insert(std::make_pair(toplevel, xapian_info())).first;
+
+	    xapian_info &rval(inserted->second);
+	    if(db.get() != NULL)
+	      rval.setup(get_xapian_db(*db), toplevel, debug);
+
+	    if(profile != NULL && rval.get_matched_packages_valid())
+	      profile->add_prefilter(toplevel,
+				     ssprintf("Xapian: %lu hits",
+					      static_cast<unsigned long>(rval.get_xapian_match().size())));
+
+	    return rval;
+	  }
+	else
+	  return found->second;
+      }
+    };
+ 
+    search_cache::search_cache()
+    {
+    }
+
+    ref_ptr<search_cache> search_cache::create()
+    {
+      return new implementation;
+    }
+
+    void search_cache::set_profile(match_profile *profile)
+    {
+      static_cast<implementation *>(this)->set_profile(profile);
+    }
+
+    namespace
+    {
+      Xapian::Query stem_term(const std::string &term)
+      {
+	return Xapian::Query(Xapian::Query::OP_OR,
+			     Xapian::Query(term),
+			     Xapian::Stem("en")(term));
+      }
+
+      /** \brief Describes how version-by-version matching is carried
+       *  out.
+       */
+      enum structural_eval_mode
+	{
+	  /** \brief All the versions in the current pool must match. */
+	  structural_eval_all,
 
 	  /** \brief Any one of the versions in the current pool can match. */
 	  structural_eval_any
@@ -813,12 +1558,10 @@ namespace aptitude
 		{
 		  pkgCache::PkgFileIterator cur = f.File();
 
-		  if(!cur.end() && cur.Archive())
+		  if(!cur.end())
 		    {
-		      ref_ptr<match> m = evaluate_regexp(p,
-							 p->get_archive_regex_info(),
-							 cur.Archive(),
-							 debug);
+		      ref_ptr<match> m =
+			search_info->find_package_file_match(p, cur, cache, debug);
 
 		      if(m.valid())
 			return m;
@@ -1059,30 +1802,13 @@ namespace aptitude
 			  }
 
 			std::vector<matchable> new_pool;
+			search_info->get_dep_targets(or_group_start, cache, new_pool);
 
-			// See if a versionless match works.
-			while(1)
-			  {
-			    pkgCache::PkgIterator pkg(dep.TargetPkg());
-			    if(pkg.VersionList().end())
-			      new_pool.push_back(matchable(pkg));
-			    else
-			      {
-				for(pkgCache::VerIterator i=pkg.VersionList(); !i.end(); i++)
-				  if(_system->VS->CheckDep(i.VerStr(), dep->CompareOp, dep.TargetVer()))
-				    new_pool.push_back(matchable(pkg, i));
-			      }
-
-			    if((dep->CompareOp & pkgCache::Dep::Or) == 0)
-			      break;
-			    else
-			      ++dep;
-			  }
+			while(dep->CompareOp & pkgCache::Dep::Or)
+			  ++dep;
 
 			if(!new_pool.empty())
 			  {
-			    std::sort(new_pool.begin(), new_pool.end());
-
 			    ref_ptr<structural_match> m =
 			      evaluate_toplevel(structural_eval_any,
 						p->get_depends_pattern(),
@@ -1268,21 +1994,16 @@ namespace aptitude
 	    if(!target.get_has_version())
 	      return NULL;
 	    {
-	      pkgCache::PkgIterator pkg(target.get_package_iterator(cache));
 	      pkgCache::VerIterator ver(target.get_version_iterator(cache));
 
 	      for(pkgCache::VerFileIterator f = ver.FileList(); !f.end(); ++f)
 		{
 		  pkgCache::PkgFileIterator cur = f.File();
-		  const char *origin = cur.Origin();
 
-		  if(!cur.end() && origin != NULL)
+		  if(!cur.end())
 		    {
-		      ref_ptr<match>
-			m(evaluate_regexp(p,
-					  p->get_origin_regex_info(),
-					  origin,
-					  debug));
+		      ref_ptr<match> m =
+			search_info->find_package_file_match(p, cur, cache, debug);
 
 		      if(m.valid())
 			return m;
@@ -1350,18 +2071,26 @@ namespace aptitude
 
 	  case pattern::reverse_depends:
 	    {
-	      pkgCache::PkgIterator pkg = target.get_package_iterator(cache);
-	      pkgCache::VerIterator ver;
-	      if(target.get_has_version())
-		ver = target.get_version_iterator(cache);
 	      const bool broken = p->get_reverse_depends_broken();
 	      pkgCache::Dep::DepType type = p->get_reverse_depends_depends_type();
 
+	      std::vector<search_cache::implementation::reverse_dependency> revdeps;
+	      search_info->get_reverse_dependencies(target, cache, revdeps);
+
 	      std::vector<matchable> revdep_pool;
 
-	      for(pkgCache::DepIterator d = pkg.RevDependsList();
-		  !d.end(); ++d)
+	      for(std::vector<search_cache::implementation::reverse_dependency>::const_iterator
+		    it = revdeps.begin(); it != revdeps.end(); ++it)
 		{
+		  pkgCache::DepIterator d(cache, it->dep);
+
+		  // Dependencies through virtual packages don't treat
+		  // Pre-Depends as Depends.
+		  if(!(d->Type == type ||
+		       (!it->via_provides &&
+			type == pkgCache::Dep::Depends && d->Type == pkgCache::Dep::PreDepends)))
+		    continue;
+
 		  if(broken)
 		    {
 		      // Find the corresponding forward dependency and
@@ -1373,78 +2102,25 @@ namespace aptitude
 			continue;
 		    }
 
-		  if(  (d->Type == type ||
-			(type == pkgCache::Dep::Depends && d->Type == pkgCache::Dep::PreDepends)) &&
-		       (!d.TargetVer() || (target.get_has_version() &&
-					   _system->VS->CheckDep(ver.VerStr(), d->CompareOp, d.TargetVer())))   )
-		    {
-		      matchable m(d.ParentPkg(), d.ParentVer());
-		      if(revdep_pool.empty())
-			revdep_pool.push_back(m);
-		      else
-			revdep_pool[0] = m;
-
-
-		      ref_ptr<structural_match>
-			rval(evaluate_toplevel(structural_eval_any,
-					       p->get_reverse_depends_pattern(),
-					       the_stack,
-					       search_info,
-					       revdep_pool,
-					       cache,
-					       records,
-					       debug));
+		  matchable m(d.ParentPkg(), d.ParentVer());
+		  if(revdep_pool.empty())
+		    revdep_pool.push_back(m);
+		  else
+		    revdep_pool[0] = m;
 
-		      if(rval.valid())
-			return match::make_dependency(p, rval, d);
-		    }
-		}
 
-	      // Check dependencies through virtual packages.
-	      if(target.get_has_version())
-		{
-		  for(pkgCache::PrvIterator prv = ver.ProvidesList();
-		      !prv.end(); ++prv)
-		    {
-		      for(pkgCache::DepIterator d = prv.ParentPkg().RevDependsList();
-			  !d.end(); ++d)
-			{
-			  if(broken)
-			    {
-			      pkgCache::DepIterator d2(cache, &*d);
-			      while(d2->CompareOp & pkgCache::Dep::Or)
-				++d2;
-			      if(cache[d2] & pkgDepCache::DepGInstall)
-				continue;
-			    }
+		  ref_ptr<structural_match>
+		    rval(evaluate_toplevel(structural_eval_any,
+					   p->get_reverse_depends_pattern(),
+					   the_stack,
+					   search_info,
+					   revdep_pool,
+					   cache,
+					   records,
+					   debug));
 
-			  if(d->Type == type &&
-			     (d.TargetVer() == NULL ||
-			      (  prv.ProvideVersion() != NULL &&
-			         _system->VS->CheckDep(ver.VerStr(), d->CompareOp, d.TargetVer())  )))
-			    {
-			      matchable m(d.ParentPkg(), d.ParentVer());
-			      if(revdep_pool.empty())
-				revdep_pool.push_back(m);
-			      else
-				revdep_pool[0] = m;
-
-
-			      ref_ptr<structural_match>
-				rval(evaluate_toplevel(structural_eval_any,
-						       p->get_reverse_depends_pattern(),
-						       the_stack,
-						       search_info,
-						       revdep_pool,
-						       cache,
-						       records,
-						       debug));
-
-			      if(rval.valid())
-				return match::make_dependency(p, rval, d);
-			    }
-			}
-		    }
+		  if(rval.valid())
+		    return match::make_dependency(p, rval, d);
 		}
 
 	      return NULL;
@@ -1654,19 +2330,14 @@ namespace aptitude
 	    {
 	      pkgCache::PkgIterator pkg(target.get_package_iterator(cache));
 
-	      std::set<string> *l = get_tasks(pkg);
+	      const task_id_range tasks = get_task_ids(pkg);
 
-	      if(!l)
-		return NULL;
-
-	      for(std::set<string>::iterator i = l->begin();
-		  i != l->end();
-		  ++i)
+	      for(const task_id *i = tasks.first; i != tasks.second; ++i)
 		{
 		  ref_ptr<match> m =
 		    evaluate_regexp(p,
 				    p->get_task_regex_info(),
-				    i->c_str(),
+				    get_task_name(*i).c_str(),
 				    debug);
 
 		  if(m.valid())
@@ -1726,24 +2397,20 @@ namespace aptitude
 	      pkgCache::PkgIterator pkg =
 		target.get_package_iterator(cache);
 
-	      const std::set<aptitudeDepCache::user_tag> &user_tags =
-		cache.get_ext_state(pkg).user_tags;
+	      const std::vector<ref_ptr<match> > &tag_matches =
+		search_info->find_user_tag_matches(p, cache, debug);
 
-	      for(std::set<aptitudeDepCache::user_tag>::const_iterator it =
-		    user_tags.begin(); it != user_tags.end(); ++it)
+	      // Only the tags that match are looked up in the index of
+	      // tagged packages, in the same order as the package's own
+	      // set of tags.
+	      for(std::size_t n = 0; n < tag_matches.size(); ++n)
 		{
-		  aptitudeDepCache::user_tag tag(*it);
-
-		  ref_ptr<match> m(search_info->find_user_tag_match(p,
-								    tag,
-								    cache,
-								    debug));
-
 		  // NB: this currently short-circuits (as does, e.g.,
 		  // ?task); for highlighting purposes we might want
 		  // to return all matches.
-		  if(m.valid())
-		    return m;
+		  if(tag_matches[n].valid() &&
+		     cache.get_user_tag_packages(cache.get_user_tag(n)).count(pkg->ID) > 0)
+		    return tag_matches[n];
 		}
 
 	      return NULL;
@@ -1772,15 +2439,99 @@ namespace aptitude
 	  }
       }
 
-      ref_ptr<structural_match> evaluate_structural(structural_eval_mode mode,
-						    const ref_ptr<pattern> &p,
-						    stack &the_stack,
-						    const ref_ptr<search_cache::implementation> &search_info,
-						    const std::vector<matchable> &pool,
-						    aptitudeDepCache &cache,
-						    pkgRecords &records,
-						    bool debug)
+      /** \brief Match a leaf instruction against one matchable,
+       *  using the search cache's memoized result if there is one.
+       */
+      ref_ptr<match> evaluate_leaf(const compiled_pattern::instruction &instr,
+				   const matchable &target,
+				   stack &the_stack,
+				   const ref_ptr<search_cache::implementation> &search_info,
+				   aptitudeDepCache &cache,
+				   pkgRecords &records,
+				   bool debug)
+      {
+	match_profile * const profile = search_info->get_profile();
+
+	ref_ptr<match> rval;
+	if(instr.memoize &&
+	   search_info->find_atomic_memo(instr.p, target, cache, rval))
+	  {
+	    if(debug)
+	      {
+		std::cout << "Reusing the result of " << serialize_pattern(instr.p)
+			  << " for ";
+		print_matchable(std::cout, target, cache);
+		std::cout << std::endl;
+	      }
+
+	    if(profile != NULL)
+	      profile->add_memo_hit(instr.p, rval.valid());
+
+	    return rval;
+	  }
+
+	if(profile == NULL)
+	  rval = evaluate_atomic(instr.p, target, the_stack, search_info, cache, records, debug);
+	else
+	  {
+	    match_profile::timer t;
+	    rval = evaluate_atomic(instr.p, target, the_stack, search_info, cache, records, debug);
+	    profile->add_evaluation(instr.p, 1, rval.valid(), t.elapsed());
+	  }
+
+	if(instr.memoize)
+	  search_info->store_atomic_memo(instr.p, target, cache, rval);
+
+	return rval;
+      }
+
+      /** \brief Return \b true if instructions of the given type
+       *  combine the results of their sub-patterns, rather than
+       *  testing the pool themselves.
+       */
+      bool is_structural(pattern::type tp)
+      {
+	switch(tp)
+	  {
+	  case pattern::all_versions:
+	  case pattern::and_tp:
+	  case pattern::any_version:
+	  case pattern::for_tp:
+	  case pattern::narrow:
+	  case pattern::not_tp:
+	  case pattern::or_tp:
+	  case pattern::widen:
+	    return true;
+
+	  default:
+	    return false;
+	  }
+      }
+
+      ref_ptr<structural_match> evaluate_compiled(structural_eval_mode mode,
+						  const compiled_pattern &program,
+						  unsigned int pc,
+						  stack &the_stack,
+						  const ref_ptr<search_cache::implementation> &search_info,
+						  const std::vector<matchable> &pool,
+						  aptitudeDepCache &cache,
+						  pkgRecords &records,
+						  bool debug);
+
+      /** \brief The body of evaluate_compiled(), without the profiling. */
+      ref_ptr<structural_match> evaluate_compiled_node(structural_eval_mode mode,
+						       const compiled_pattern &program,
+						       unsigned int pc,
+						       stack &the_stack,
+						       const ref_ptr<search_cache::implementation> &search_info,
+						       const std::vector<matchable> &pool,
+						       aptitudeDepCache &cache,
+						       pkgRecords &records,
+						       bool debug)
       {
+	const compiled_pattern::instruction &instr(program[pc]);
+	const ref_ptr<pattern> &p(instr.p);
+
 	if(debug)
 	  {
 	    std::cout << "Matching " << serialize_pattern(p)
@@ -1802,21 +2553,21 @@ namespace aptitude
 	    std::cout << ")" << std::endl;
 	  }
 
-	switch(p->get_type())
+	switch(instr.tp)
 	  {
 	    // Structural matchers:
 
 	  case pattern::all_versions:
 	    {
 	      ref_ptr<structural_match>
-		m(evaluate_structural(structural_eval_all,
-				      p->get_all_versions_pattern(),
-				      the_stack,
-				      search_info,
-				      pool,
-				      cache,
-				      records,
-				      debug));
+		m(evaluate_compiled(structural_eval_all,
+				    program, pc + 1,
+				    the_stack,
+				    search_info,
+				    pool,
+				    cache,
+				    records,
+				    debug));
 
 	      if(!m.valid())
 		return NULL;
@@ -1827,25 +2578,27 @@ namespace aptitude
 
 	  case pattern::and_tp:
 	    {
-	      const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_and_patterns());
-	      std::vector<ref_ptr<structural_match> > sub_matches;
+	      // The terms may be evaluated out of order; each match is
+	      // stored at the position of its term in the pattern.
+	      std::vector<ref_ptr<structural_match> > sub_matches(p->get_and_patterns().size());
 
-	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
-		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+	      for(unsigned int child = pc + 1; child < instr.end;
+		  child = program[child].end)
 		{
-		  ref_ptr<structural_match> m(evaluate_structural(mode,
-								  (*it),
-								  the_stack,
-								  search_info,
-								  pool,
-								  cache,
-								  records,
-								  debug));
-
+		  ref_ptr<structural_match> m(evaluate_compiled(mode,
+								program, child,
+								the_stack,
+								search_info,
+								pool,
+								cache,
+								records,
+								debug));
+
+		  // Short-circuit: skip the remaining children.
 		  if(!m.valid())
 		    return NULL;
 
-		  sub_matches.push_back(m);
+		  sub_matches[program[child].slot] = m;
 		}
 
 	      return structural_match::make_branch(p, sub_matches.begin(), sub_matches.end());
@@ -1864,14 +2617,14 @@ namespace aptitude
 		  new_pool[0] = *it;
 
 		  ref_ptr<structural_match>
-		    m(evaluate_structural(mode,
-					  p->get_any_version_pattern(),
-					  the_stack,
-					  search_info,
-					  new_pool,
-					  cache,
-					  records,
-					  debug));
+		    m(evaluate_compiled(mode,
+					program, pc + 1,
+					the_stack,
+					search_info,
+					new_pool,
+					cache,
+					records,
+					debug));
 
 		  if(m.valid())
 		    sub_matches.push_back(m);
@@ -1889,14 +2642,14 @@ namespace aptitude
 	      the_stack.push_back(&pool);
 
 	      const ref_ptr<structural_match>
-		m(evaluate_structural(mode,
-				      p->get_for_pattern(),
-				      the_stack,
-				      search_info,
-				      pool,
-				      cache,
-				      records,
-				      debug));
+		m(evaluate_compiled(mode,
+				    program, pc + 1,
+				    the_stack,
+				    search_info,
+				    pool,
+				    cache,
+				    records,
+				    debug));
 
 	      if(m.valid())
 		return structural_match::make_branch(p, &m, (&m) + 1);
@@ -1921,14 +2674,14 @@ namespace aptitude
 		{
 		  singleton_pool[0] = *it;
 
-		  if(evaluate_structural(mode,
-					 p->get_narrow_filter(),
-					 the_stack,
-					 search_info,
-					 singleton_pool,
-					 cache,
-					 records,
-					 debug).valid())
+		  if(evaluate_compiled(mode,
+				       program, pc + 1,
+				       the_stack,
+				       search_info,
+				       singleton_pool,
+				       cache,
+				       records,
+				       debug).valid())
 		    new_pool.push_back(*it);
 		}
 
@@ -1937,14 +2690,14 @@ namespace aptitude
 	      else
 		{
 		  ref_ptr<structural_match>
-		    m(evaluate_structural(mode,
-					  p->get_narrow_pattern(),
-					  the_stack,
-					  search_info,
-					  new_pool,
-					  cache,
-					  records,
-					  debug));
+		    m(evaluate_compiled(mode,
+					program, program[pc + 1].end,
+					the_stack,
+					search_info,
+					new_pool,
+					cache,
+					records,
+					debug));
 
 		  if(!m.valid())
 		    return NULL;
@@ -1956,14 +2709,14 @@ namespace aptitude
 
 	  case pattern::not_tp:
 	    {
-	      ref_ptr<structural_match> m(evaluate_structural(mode,
-							      p->get_not_pattern(),
-							      the_stack,
-							      search_info,
-							      pool,
-							      cache,
-							      records,
-							      debug));
+	      ref_ptr<structural_match> m(evaluate_compiled(mode,
+							    program, pc + 1,
+							    the_stack,
+							    search_info,
+							    pool,
+							    cache,
+							    records,
+							    debug));
 
 	      if(!m.valid())
 		// Report a structural match with no sub-parts.  This
@@ -1980,23 +2733,22 @@ namespace aptitude
 
 	  case pattern::or_tp:
 	    {
-	      const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_or_patterns());
 	      std::vector<ref_ptr<structural_match> > sub_matches;
 
 	      // Note: we do *not* short-circuit, in order to allow
 	      // the caller to see as much information as possible
 	      // about the match.
-	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
-		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+	      for(unsigned int child = pc + 1; child < instr.end;
+		  child = program[child].end)
 		{
-		  ref_ptr<structural_match> m(evaluate_structural(mode,
-								  (*it),
-								  the_stack,
-								  search_info,
-								  pool,
-								  cache,
-								  records,
-								  debug));
+		  ref_ptr<structural_match> m(evaluate_compiled(mode,
+								program, child,
+								the_stack,
+								search_info,
+								pool,
+								cache,
+								records,
+								debug));
 
 		  if(m.valid())
 		    sub_matches.push_back(m);
@@ -2053,14 +2805,14 @@ namespace aptitude
 
 	      std::sort(new_pool.begin(), new_pool.end());
 	      ref_ptr<structural_match>
-		m(evaluate_structural(mode,
-				      p->get_widen_pattern(),
-				      the_stack,
-				      search_info,
-				      new_pool,
-				      cache,
-				      records,
-				      debug));
+		m(evaluate_compiled(mode,
+				    program, pc + 1,
+				    the_stack,
+				    search_info,
+				    new_pool,
+				    cache,
+				    records,
+				    debug));
 	      if(!m.valid())
 		return NULL;
 	      else
@@ -2119,7 +2871,7 @@ namespace aptitude
 		  for(std::vector<matchable>::const_iterator it =
 			pool.begin(); it != pool.end(); ++it)
 		    {
-		      cwidget::util::ref_ptr<match> m(evaluate_atomic(p, *it, the_stack, search_info, cache, records, debug));
+		      cwidget::util::ref_ptr<match> m(evaluate_leaf(instr, *it, the_stack, search_info, cache, records, debug));
 		      if(!m.valid())
 			{
 			  if(debug)
@@ -2147,7 +2899,7 @@ namespace aptitude
 		  for(std::vector<matchable>::const_iterator it =
 			pool.begin(); it != pool.end(); ++it)
 		    {
-		      cwidget::util::ref_ptr<match> m(evaluate_atomic(p, *it, the_stack, search_info, cache, records, debug));
+		      cwidget::util::ref_ptr<match> m(evaluate_leaf(instr, *it, the_stack, search_info, cache, records, debug));
 		      if(m.valid())
 			{
 			  if(debug)
@@ -2179,8 +2931,10 @@ namespace aptitude
 	  }
       }
 
-      ref_ptr<structural_match> evaluate_toplevel(structural_eval_mode mode,
-						  const ref_ptr<pattern> &p,
+      // Leaves are profiled by evaluate_leaf(), once per target.
+      ref_ptr<structural_match> evaluate_compiled(structural_eval_mode mode,
+						  const compiled_pattern &program,
+						  unsigned int pc,
 						  stack &the_stack,
 						  const ref_ptr<search_cache::implementation> &search_info,
 						  const std::vector<matchable> &pool,
@@ -2188,43 +2942,268 @@ namespace aptitude
 						  pkgRecords &records,
 						  bool debug)
       {
-	const xapian_info &xapian_match(search_info->get_toplevel_xapian_info(p, debug));
-
-	// This may be an efficiency problem.
-	std::vector<matchable> filtered_pool;
-	filtered_pool.reserve(pool.size());
-	for(std::vector<matchable>::const_iterator it = pool.begin();
-	    it != pool.end(); ++it)
-	  {
-	    if(xapian_match.maybe_contains_package(it->get_package_iterator(cache), search_info->get_db()))
-	      filtered_pool.push_back(*it);
-	  }
-
-	return evaluate_structural(mode, p, the_stack, search_info,
-				   filtered_pool, cache, records, debug);
+	match_profile * const profile = search_info->get_profile();
+	if(profile == NULL || !is_structural(program[pc].tp))
+	  return evaluate_compiled_node(mode, program, pc, the_stack, search_info,
+					pool, cache, records, debug);
+
+	match_profile::timer t;
+	ref_ptr<structural_match> rval(evaluate_compiled_node(mode, program, pc, the_stack,
+							      search_info, pool,
+							      cache, records, debug));
+	profile->add_evaluation(program[pc].p, pool.size(), rval.valid(), t.elapsed());
+
+	return rval;
       }
 
-      // is_pure_xapian returns "true" if we can identify a Xapian
-      // term that matches if AND ONLY IF the pattern matches.  In
-      // other words: it contains only structural patterns combined
-      // with Boolean operators (and version-manipulation operators,
-      // which we ignore).
-      bool is_pure_xapian(const ref_ptr<pattern> &p)
+      /** \brief Test whether a compiled pattern matches a pool.
+       *
+       *  This gives the same answer as evaluate_compiled(), but it
+       *  doesn't build a structural_match, so it allocates nothing
+       *  for the structural operators and it can stop at the first
+       *  element of the pool that decides the result.
+       */
+      bool evaluate_boolean(structural_eval_mode mode,
+			    const compiled_pattern &program,
+			    unsigned int pc,
+			    stack &the_stack,
+			    const ref_ptr<search_cache::implementation> &search_info,
+			    const std::vector<matchable> &pool,
+			    aptitudeDepCache &cache,
+			    pkgRecords &records,
+			    bool debug);
+
+      /** \brief The body of evaluate_boolean(), without the profiling. */
+      bool evaluate_boolean_node(structural_eval_mode mode,
+				 const compiled_pattern &program,
+				 unsigned int pc,
+				 stack &the_stack,
+				 const ref_ptr<search_cache::implementation> &search_info,
+				 const std::vector<matchable> &pool,
+				 aptitudeDepCache &cache,
+				 pkgRecords &records,
+				 bool debug)
       {
-	switch(p->get_type())
+	const compiled_pattern::instruction &instr(program[pc]);
+
+	switch(instr.tp)
 	  {
 	  case pattern::all_versions:
-	    return is_pure_xapian(p->get_all_versions_pattern());
+	    return evaluate_boolean(structural_eval_all,
+				    program, pc + 1,
+				    the_stack, search_info, pool,
+				    cache, records, debug);
 
 	  case pattern::and_tp:
-	    {
-	      const std::vector<ref_ptr<pattern> > &
-		sub_patterns(p->get_and_patterns());
+	    for(unsigned int child = pc + 1; child < instr.end;
+		child = program[child].end)
+	      if(!evaluate_boolean(mode, program, child,
+				   the_stack, search_info, pool,
+				   cache, records, debug))
+		return false;
 
-	      if(sub_patterns.size() == 0)
-		return true;
+	    return true;
 
-	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	  case pattern::any_version:
+	    {
+	      std::vector<matchable> new_pool;
+	      new_pool.push_back(matchable());
+
+	      for(std::vector<matchable>::const_iterator it =
+		    pool.begin(); it != pool.end(); ++it)
+		{
+		  new_pool[0] = *it;
+
+		  if(evaluate_boolean(mode, program, pc + 1,
+				      the_stack, search_info, new_pool,
+				      cache, records, debug))
+		    return true;
+		}
+
+	      return false;
+	    }
+
+	  case pattern::for_tp:
+	    the_stack.push_back(&pool);
+
+	    return evaluate_boolean(mode, program, pc + 1,
+				    the_stack, search_info, pool,
+				    cache, records, debug);
+
+	  case pattern::narrow:
+	    {
+	      std::vector<matchable> singleton_pool;
+	      std::vector<matchable> new_pool;
+	      singleton_pool.push_back(matchable());
+
+	      for(std::vector<matchable>::const_iterator it =
+		    pool.begin(); it != pool.end(); ++it)
+		{
+		  singleton_pool[0] = *it;
+
+		  if(evaluate_boolean(mode, program, pc + 1,
+				      the_stack, search_info, singleton_pool,
+				      cache, records, debug))
+		    new_pool.push_back(*it);
+		}
+
+	      if(new_pool.empty())
+		return false;
+	      else
+		return evaluate_boolean(mode, program, program[pc + 1].end,
+					the_stack, search_info, new_pool,
+					cache, records, debug);
+	    }
+
+	  case pattern::not_tp:
+	    return !evaluate_boolean(mode, program, pc + 1,
+				     the_stack, search_info, pool,
+				     cache, records, debug);
+
+	  case pattern::or_tp:
+	    // Unlike evaluate_compiled(), this can stop at the first
+	    // matching term, since nobody will look at the others.
+	    for(unsigned int child = pc + 1; child < instr.end;
+		child = program[child].end)
+	      if(evaluate_boolean(mode, program, child,
+				  the_stack, search_info, pool,
+				  cache, records, debug))
+		return true;
+
+	    return false;
+
+	  case pattern::widen:
+	    // Fall back to the full evaluator; building the widened
+	    // pool dominates the cost anyway.  This node has already
+	    // been profiled by evaluate_boolean().
+	    return evaluate_compiled_node(mode, program, pc,
+					  the_stack, search_info, pool,
+					  cache, records, debug).valid();
+
+	  default:
+	    // Atomic matchers:
+	    switch(mode)
+	      {
+	      case structural_eval_all:
+		if(pool.empty())
+		  return false;
+
+		for(std::vector<matchable>::const_iterator it =
+		      pool.begin(); it != pool.end(); ++it)
+		  if(!evaluate_leaf(instr, *it, the_stack, search_info,
+				    cache, records, debug).valid())
+		    return false;
+
+		return true;
+
+	      case structural_eval_any:
+		for(std::vector<matchable>::const_iterator it =
+		      pool.begin(); it != pool.end(); ++it)
+		  if(evaluate_leaf(instr, *it, the_stack, search_info,
+				   cache, records, debug).valid())
+		    return true;
+
+		return false;
+
+	      default:
+		throw MatchingException("Internal error: unhandled structural match mode.");
+	      }
+	  }
+      }
+
+      // Leaves are profiled by evaluate_leaf(), once per target.
+      bool evaluate_boolean(structural_eval_mode mode,
+			    const compiled_pattern &program,
+			    unsigned int pc,
+			    stack &the_stack,
+			    const ref_ptr<search_cache::implementation> &search_info,
+			    const std::vector<matchable> &pool,
+			    aptitudeDepCache &cache,
+			    pkgRecords &records,
+			    bool debug)
+      {
+	match_profile * const profile = search_info->get_profile();
+	if(profile == NULL || !is_structural(program[pc].tp))
+	  return evaluate_boolean_node(mode, program, pc, the_stack, search_info,
+				       pool, cache, records, debug);
+
+	match_profile::timer t;
+	const bool rval = evaluate_boolean_node(mode, program, pc, the_stack,
+						search_info, pool,
+						cache, records, debug);
+	profile->add_evaluation(program[pc].p, pool.size(), rval, t.elapsed());
+
+	return rval;
+      }
+
+      /** \brief Match a pattern against a pool, using the compiled
+       *  form of the pattern stored in the search cache.
+       */
+      ref_ptr<structural_match> evaluate_structural(structural_eval_mode mode,
+						    const ref_ptr<pattern> &p,
+						    stack &the_stack,
+						    const ref_ptr<search_cache::implementation> &search_info,
+						    const std::vector<matchable> &pool,
+						    aptitudeDepCache &cache,
+						    pkgRecords &records,
+						    bool debug)
+      {
+	return evaluate_compiled(mode,
+				 search_info->get_compiled_pattern(p), 0,
+				 the_stack,
+				 search_info,
+				 pool,
+				 cache,
+				 records,
+				 debug);
+      }
+
+      ref_ptr<structural_match> evaluate_toplevel(structural_eval_mode mode,
+						  const ref_ptr<pattern> &p,
+						  stack &the_stack,
+						  const ref_ptr<search_cache::implementation> &search_info,
+						  const std::vector<matchable> &pool,
+						  aptitudeDepCache &cache,
+						  pkgRecords &records,
+						  bool debug)
+      {
+	const xapian_info &xapian_match(search_info->get_toplevel_xapian_info(p, debug));
+
+	// This may be an efficiency problem.
+	std::vector<matchable> filtered_pool;
+	filtered_pool.reserve(pool.size());
+	for(std::vector<matchable>::const_iterator it = pool.begin();
+	    it != pool.end(); ++it)
+	  {
+	    if(xapian_match.maybe_contains_package(it->get_package_iterator(cache), search_info->get_db()))
+	      filtered_pool.push_back(*it);
+	  }
+
+	return evaluate_structural(mode, p, the_stack, search_info,
+				   filtered_pool, cache, records, debug);
+      }
+
+      // is_pure_xapian returns "true" if we can identify a Xapian
+      // term that matches if AND ONLY IF the pattern matches.  In
+      // other words: it contains only structural patterns combined
+      // with Boolean operators (and version-manipulation operators,
+      // which we ignore).
+      bool is_pure_xapian(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::all_versions:
+	    return is_pure_xapian(p->get_all_versions_pattern());
+
+	  case pattern::and_tp:
+	    {
+	      const std::vector<ref_ptr<pattern> > &
+		sub_patterns(p->get_and_patterns());
+
+	      if(sub_patterns.size() == 0)
+		return true;
+
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
 		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
 		{
 		  if(!is_pure_xapian(*it))
@@ -2402,6 +3381,11 @@ namespace aptitude
 	  case pattern::term_prefix:
 	    return true;
 
+	    // Matched against the tags recorded in the index (see
+	    // build_xapian_regex_query()).
+	  case pattern::tag:
+	    return true;
+
 	    // Various non-dependent terms.  All of these return
 	    // false.  Some have internal matchers, but they are
 	    // separate searches.
@@ -2437,7 +3421,6 @@ namespace aptitude
 	  case pattern::section:
 	  case pattern::source_package:
 	  case pattern::source_version:
-	  case pattern::tag:
 	  case pattern::task:
 	  case pattern::true_tp:
 	  case pattern::upgradable:
@@ -2663,6 +3646,41 @@ namespace aptitude
       //
       // Returns the new query, or an empty query if there's no
       // Xapian-dependence.
+      /** \brief Build a query for the documents with a term that
+       *  starts with prefix and whose remainder matches a regular
+       *  expression.
+       *
+       *  This is how patterns that apply a regular expression to
+       *  something the index records (such as debtags) narrow down
+       *  the packages they have to be checked against.  If the
+       *  index has no terms with the prefix at all, it was built
+       *  without the plugin that provides them, and a query that
+       *  matches every document is returned.
+       */
+      Xapian::Query build_xapian_regex_query(const std::string &prefix,
+					     const pattern::regex_info &info,
+					     const Xapian::Database &db)
+      {
+	Xapian::TermIterator it = db.allterms_begin(prefix);
+	const Xapian::TermIterator end = db.allterms_end(prefix);
+
+	if(it == end)
+	  return Xapian::Query(std::string());
+
+	std::vector<std::string> terms;
+	for( ; it != end; ++it)
+	  {
+	    const std::string term(*it);
+
+	    if(info.get_regex_nogroup()->exec(term.c_str() + prefix.size(), NULL, 0))
+	      terms.push_back(term);
+	  }
+
+	return Xapian::Query(Xapian::Query::OP_OR,
+			     terms.begin(),
+			     terms.end());
+      }
+
       Xapian::Query build_xapian_query(const cwidget::util::ref_ptr<pattern> &p,
 				       const Xapian::Database &db)
       {
@@ -2834,6 +3852,12 @@ namespace aptitude
 	      const std::vector<ref_ptr<pattern> > &sub_patterns =
 		p->get_or_patterns();
 
+	      // A package can match the OR through a branch that the
+	      // index knows nothing about, so the OR can only narrow
+	      // the search if every branch does.
+	      if(!is_xapian_dependent(p))
+		return Xapian::Query();
+
 	      Xapian::Query tail;
 
 	      for(std::vector<ref_ptr<pattern> >::const_reverse_iterator it =
@@ -2866,6 +3890,9 @@ namespace aptitude
 	  case pattern::exact_name:
 	    return Xapian::Query("XP" + p->get_exact_name_name());
 
+	  case pattern::tag:
+	    return build_xapian_regex_query("XT", p->get_tag_regex_info(), db);
+
 	  case pattern::term:
 	    // We try stemming everything as if it were English.
 	    //
@@ -2924,7 +3951,6 @@ namespace aptitude
 	  case pattern::section:
 	  case pattern::source_package:
 	  case pattern::source_version:
-	  case pattern::tag:
 	  case pattern::task:
 	  case pattern::true_tp:
 	  case pattern::upgradable:
@@ -2938,6 +3964,36 @@ namespace aptitude
       }
     }
 
+    namespace
+    {
+      /** \brief Build the pool that get_match() and has_match() test
+       *  a package or version against.
+       */
+      void make_initial_pool(const pkgCache::PkgIterator &pkg,
+			     const pkgCache::VerIterator &ver,
+			     std::vector<matchable> &initial_pool)
+      {
+	if(pkg.VersionList().end())
+	  initial_pool.push_back(matchable(pkg));
+	else if(ver.end())
+	  {
+	    for(pkgCache::VerIterator ver2 = pkg.VersionList();
+		!ver2.end(); ++ver2)
+	      {
+		initial_pool.push_back(matchable(pkg, ver2));
+	      }
+	  }
+	else
+	  {
+	    eassert(ver.ParentPkg() == pkg);
+
+	    initial_pool.push_back(matchable(pkg, ver));
+	  }
+
+	std::sort(initial_pool.begin(), initial_pool.end());
+      }
+    }
+
     ref_ptr<structural_match>
     get_match(const ref_ptr<pattern> &p,
 	      const pkgCache::PkgIterator &pkg,
@@ -2951,25 +4007,7 @@ namespace aptitude
       eassert(search_info.valid());
 
       std::vector<matchable> initial_pool;
-
-      if(pkg.VersionList().end())
-	initial_pool.push_back(matchable(pkg));
-      else if(ver.end())
-	{
-	  for(pkgCache::VerIterator ver2 = pkg.VersionList();
-	      !ver2.end(); ++ver2)
-	    {
-	      initial_pool.push_back(matchable(pkg, ver2));
-	    }
-	}
-      else
-	{
-	  eassert(ver.ParentPkg() == pkg);
-
-	  initial_pool.push_back(matchable(pkg, ver));
-	}
-
-      std::sort(initial_pool.begin(), initial_pool.end());
+      make_initial_pool(pkg, ver, initial_pool);
 
       stack st;
       st.push_back(&initial_pool);
@@ -3001,6 +4039,53 @@ namespace aptitude
 		       search_info, cache, records, debug);
     }
 
+    bool has_match(const ref_ptr<pattern> &p,
+		   const pkgCache::PkgIterator &pkg,
+		   const pkgCache::VerIterator &ver,
+		   const cwidget::util::ref_ptr<search_cache> &search_info,
+		   aptitudeDepCache &cache,
+		   pkgRecords &records,
+		   bool debug)
+    {
+      // The debugging output describes the match tree, so build it.
+      if(debug)
+	return get_match(p, pkg, ver, search_info, cache, records, debug).valid();
+
+      eassert(p.valid());
+      eassert(search_info.valid());
+
+      std::vector<matchable> initial_pool;
+      make_initial_pool(pkg, ver, initial_pool);
+
+      stack st;
+      st.push_back(&initial_pool);
+
+      ref_ptr<search_cache::implementation> search_info_imp =
+	search_info.dyn_downcast<search_cache::implementation>();
+      eassert(search_info_imp.valid());
+
+      return evaluate_boolean(structural_eval_any,
+			      search_info_imp->get_compiled_pattern(p), 0,
+			      st,
+			      search_info_imp,
+			      initial_pool,
+			      cache,
+			      records,
+			      debug);
+    }
+
+    bool has_match(const ref_ptr<pattern> &p,
+		   const pkgCache::PkgIterator &pkg,
+		   const cwidget::util::ref_ptr<search_cache> &search_info,
+		   aptitudeDepCache &cache,
+		   pkgRecords &records,
+		   bool debug)
+    {
+      return has_match(p, pkg,
+		       pkgCache::VerIterator(cache),
+		       search_info, cache, records, debug);
+    }
+
     void xapian_info::setup(const Xapian::Database &db,
 			    const ref_ptr<pattern> &p,
 			    bool debug)
@@ -3052,63 +4137,776 @@ namespace aptitude
 	}
     }
 
-    void search(const ref_ptr<pattern> &p,
-		const ref_ptr<search_cache> &search_info,
-		std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > &matches,
-		aptitudeDepCache &cache,
-		pkgRecords &records,
-                bool debug,
-                const sigc::slot<void, progress_info> &progress_slot)
+    namespace
     {
-      try
-	{
-          progress_slot(progress_info::pulse(_("Accessing index")));
-
-	  eassert(p.valid());
-	  eassert(search_info.valid());
-
-	  const ref_ptr<search_cache::implementation> info = search_info.dyn_downcast<search_cache::implementation>();
-	  eassert(info.valid());
-
-	  const xapian_info &xapian_results(info->get_toplevel_xapian_info(p, debug));
+      /** \brief Return \b true if the given pattern can be evaluated
+       *  concurrently from several threads.
+       *
+       *  This holds for patterns that only read from the package
+       *  cache and the package records (which each thread opens
+       *  separately).  Anything that examines the depcache state,
+       *  the Xapian index, or lazily-loaded global tables (tags,
+       *  tasks, user tags) must be run in the main thread.
+       */
+      bool is_thread_safe(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::all_versions:
+	    return is_thread_safe(p->get_all_versions_pattern());
 
-          const std::string filter_msg = _("Filtering packages");
-	  if(!xapian_results.get_matched_packages_valid())
+	  case pattern::and_tp:
+	  case pattern::or_tp:
 	    {
-	      if(debug)
-		std::cout << "Failed to build a Xapian query for this search." << std::endl
-			  << "Falling back to testing each package." << std::endl;
+	      const std::vector<ref_ptr<pattern> > &sub_patterns =
+		p->get_type() == pattern::and_tp
+		  ? p->get_and_patterns()
+		  : p->get_or_patterns();
 
-              progress_info progress = progress_info::bar(0, filter_msg);
-              progress_slot(progress);
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		if(!is_thread_safe(*it))
+		  return false;
 
-              int i = 0;
-	      for(pkgCache::PkgIterator pkg = cache.PkgBegin();
-		  !pkg.end(); ++pkg)
-		{
-		  if(pkg.VersionList().end() && pkg.ProvidesList().end())
-		    continue;
+	      return true;
+	    }
 
-		  // TODO: how do I make sure the sub-patterns are
-		  // searched using the right xapian_info?  I could thread
-		  // the current top-level or the current xapian_info
-		  // through, I suppose.  Or I could use a global list of
-		  // term postings and only store match sets on a
-		  // per-toplevel basis (that might work, actually?).
+	  case pattern::any_version:
+	    return is_thread_safe(p->get_any_version_pattern());
 
-		  ref_ptr<structural_match> m(get_match(p, pkg,
-							info,
-							cache,
-							records,
-							debug));
+	  case pattern::narrow:
+	    return
+	      is_thread_safe(p->get_narrow_filter()) &&
+	      is_thread_safe(p->get_narrow_pattern());
 
-		  if(m.valid())
-		    matches.push_back(std::make_pair(pkg, m));
+	  case pattern::not_tp:
+	    return is_thread_safe(p->get_not_pattern());
 
-                  ++i;
-                  progress.set_progress_fraction(((double)i) / ((double)cache.Head().PackageCount));
-                  progress_slot(progress);
-		}
+	  case pattern::widen:
+	    return is_thread_safe(p->get_widen_pattern());
+
+	  case pattern::archive:
+	  case pattern::architecture:
+	  case pattern::config_files:
+	  case pattern::description:
+	  case pattern::essential:
+	  case pattern::exact_name:
+	  case pattern::false_tp:
+	  case pattern::installed:
+	  case pattern::maintainer:
+	  case pattern::multiarch:
+	  case pattern::name:
+	  case pattern::origin:
+	  case pattern::priority:
+	  case pattern::section:
+	  case pattern::source_package:
+	  case pattern::source_version:
+	  case pattern::true_tp:
+	  case pattern::version:
+	  case pattern::virtual_tp:
+	    return true;
+
+	  default:
+	    return false;
+	  }
+      }
+
+      /** \brief A set of package IDs, stored as one bit per package.
+       *
+       *  Set operations work on a whole word of packages at a time,
+       *  which makes combining per-package flags over the entire
+       *  cache very cheap.
+       */
+      class package_set
+      {
+	typedef unsigned long word;
+	static const std::size_t bits_per_word = std::numeric_limits<word>::digits;
+
+	std::size_t num_packages;
+	std::vector<word> words;
+
+	// Clear the bits past the last package, so that complement()
+	// doesn't add packages that don't exist.
+	void trim()
+	{
+	  const std::size_t extra = num_packages % bits_per_word;
+	  if(extra != 0)
+	    words.back() &= (word(1) << extra) - 1;
+	}
+
+      public:
+	/** \brief Create a set of packages.
+	 *
+	 *  \param _num_packages  The number of packages in the cache.
+	 *  \param full           If \b true, the set initially contains
+	 *                        every package; otherwise it is empty.
+	 */
+	package_set(std::size_t _num_packages, bool full)
+	  : num_packages(_num_packages),
+	    words((_num_packages + bits_per_word - 1) / bits_per_word,
+		  full ? ~word(0) : word(0))
+	{
+	  trim();
+	}
+
+	bool contains(std::size_t id) const
+	{
+	  return id < num_packages &&
+	    (words[id / bits_per_word] & (word(1) << (id % bits_per_word))) != 0;
+	}
+
+	void insert(std::size_t id)
+	{
+	  if(id < num_packages)
+	    words[id / bits_per_word] |= word(1) << (id % bits_per_word);
+	}
+
+	void intersect(const package_set &other)
+	{
+	  eassert(other.num_packages == num_packages);
+	  for(std::size_t i = 0; i < words.size(); ++i)
+	    words[i] &= other.words[i];
+	}
+
+	void unite(const package_set &other)
+	{
+	  eassert(other.num_packages == num_packages);
+	  for(std::size_t i = 0; i < words.size(); ++i)
+	    words[i] |= other.words[i];
+	}
+
+	void complement()
+	{
+	  for(std::size_t i = 0; i < words.size(); ++i)
+	    words[i] = ~words[i];
+	  trim();
+	}
+
+	void swap(package_set &other)
+	{
+	  std::swap(num_packages, other.num_packages);
+	  words.swap(other.words);
+	}
+
+	/** \brief Count the packages in the set. */
+	std::size_t size() const
+	{
+	  std::size_t rval = 0;
+	  for(std::size_t i = 0; i < words.size(); ++i)
+	    for(word w = words[i]; w != 0; w &= w - 1)
+	      ++rval;
+
+	  return rval;
+	}
+      };
+
+      /** \brief Test whether a term only looks at package-level state.
+       *
+       *  These terms ignore which version of a package they are
+       *  matched against (apart from ?installed, which matches the
+       *  package pool of an installed package), so they can be
+       *  evaluated once per package.  ?broken, ?garbage and ?new also
+       *  fail on packages with no versions, which is likewise a
+       *  property of the package.
+       */
+      bool is_package_flag(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::action:
+	  case pattern::automatic:
+	  case pattern::broken:
+	  case pattern::config_files:
+	  case pattern::essential:
+	  case pattern::false_tp:
+	  case pattern::garbage:
+	  case pattern::installed:
+	  case pattern::new_tp:
+	  case pattern::obsolete:
+	  case pattern::true_tp:
+	  case pattern::upgradable:
+	  case pattern::virtual_tp:
+	    return true;
+
+	  default:
+	    return false;
+	  }
+      }
+
+      /** \brief Test whether a pattern is a Boolean combination of
+       *  package-level flags.
+       *
+       *  ?and, ?or and ?not match against the same pool as their
+       *  sub-patterns, so such a pattern matches a package exactly
+       *  when the same combination of its flags is true.
+       */
+      bool is_flag_pattern(const ref_ptr<pattern> &p)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::and_tp:
+	  case pattern::or_tp:
+	    {
+	      const std::vector<ref_ptr<pattern> > &sub_patterns =
+		p->get_type() == pattern::and_tp
+		? p->get_and_patterns()
+		: p->get_or_patterns();
+
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		if(!is_flag_pattern(*it))
+		  return false;
+
+	      return true;
+	    }
+
+	  case pattern::not_tp:
+	    return is_flag_pattern(p->get_not_pattern());
+
+	  default:
+	    return is_package_flag(p);
+	  }
+      }
+
+      /** \brief Compute the set of packages that a flag pattern
+       *  matches.
+       *
+       *  Each flag is tested once per package; ?and, ?or and ?not are
+       *  then applied to whole sets at a time.
+       */
+      void evaluate_flags(const ref_ptr<pattern> &p,
+			  aptitudeDepCache &cache,
+			  pkgRecords &records,
+			  package_set &out)
+      {
+	const std::size_t num_packages = cache.Head().PackageCount;
+
+	switch(p->get_type())
+	  {
+	  case pattern::and_tp:
+	    {
+	      package_set rval(num_packages, true);
+	      const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_and_patterns());
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		{
+		  package_set sub(num_packages, false);
+		  evaluate_flags(*it, cache, records, sub);
+		  rval.intersect(sub);
+		}
+
+	      out.swap(rval);
+	    }
+	    break;
+
+	  case pattern::or_tp:
+	    {
+	      package_set rval(num_packages, false);
+	      const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_or_patterns());
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		{
+		  package_set sub(num_packages, false);
+		  evaluate_flags(*it, cache, records, sub);
+		  rval.unite(sub);
+		}
+
+	      out.swap(rval);
+	    }
+	    break;
+
+	  case pattern::not_tp:
+	    evaluate_flags(p->get_not_pattern(), cache, records, out);
+	    out.complement();
+	    break;
+
+	  default:
+	    {
+	      eassert(is_package_flag(p));
+
+	      package_set rval(num_packages, false);
+	      const ref_ptr<search_cache::implementation> search_info(new search_cache::implementation(false));
+	      stack the_stack;
+
+	      for(std::size_t id = 0; id < num_packages; ++id)
+		{
+		  pkgCache::PkgIterator pkg(cache.GetCache(), cache.GetCache().PkgP + id);
+
+		  // Test the current version if there is one, so that
+		  // ?installed sees it.
+		  matchable target(pkg);
+		  if(!pkg.CurrentVer().end())
+		    target = matchable(pkg, pkg.CurrentVer());
+		  else if(!pkg.VersionList().end())
+		    target = matchable(pkg, pkg.VersionList());
+
+		  if(evaluate_atomic(p, target, the_stack, search_info,
+				     cache, records, false).valid())
+		    rval.insert(id);
+		}
+
+	      out.swap(rval);
+	    }
+	    break;
+	  }
+      }
+
+      /** \brief Collect the terms of a pattern that are flag patterns
+       *  and that must match for the whole pattern to match.
+       */
+      void get_required_flags(const ref_ptr<pattern> &p,
+			      std::vector<ref_ptr<pattern> > &flags)
+      {
+	if(is_flag_pattern(p))
+	  flags.push_back(p);
+	else if(p->get_type() == pattern::and_tp)
+	  {
+	    const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_and_patterns());
+	    for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		  sub_patterns.begin(); it != sub_patterns.end(); ++it)
+	      get_required_flags(*it, flags);
+	  }
+      }
+
+      /** \brief Use package-level flags to rule out packages that
+       *  can't match a pattern.
+       *
+       *  \param possible  Narrowed to the packages that satisfy every
+       *                   required flag term of p.
+       *  \param profile   If not \b NULL, the number of packages each
+       *                   flag term left is recorded here.
+       *
+       *  \return \b true if p had any required flag terms.
+       */
+      bool get_flag_candidates(const ref_ptr<pattern> &p,
+			       aptitudeDepCache &cache,
+			       pkgRecords &records,
+			       package_set &possible,
+			       match_profile *profile,
+			       bool debug)
+      {
+	std::vector<ref_ptr<pattern> > flags;
+	get_required_flags(p, flags);
+	if(flags.empty())
+	  return false;
+
+	for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	      flags.begin(); it != flags.end(); ++it)
+	  {
+	    if(debug)
+	      std::cout << "Evaluating the flags " << serialize_pattern(*it)
+			<< " over the whole cache." << std::endl;
+
+	    package_set matched(cache.Head().PackageCount, false);
+	    evaluate_flags(*it, cache, records, matched);
+	    possible.intersect(matched);
+
+	    if(profile != NULL)
+	      profile->add_prefilter(*it,
+				     ssprintf("package flags: %lu packages",
+					      static_cast<unsigned long>(matched.size())));
+	  }
+
+	return true;
+      }
+
+      /** \brief Collect the ?description terms that must match some
+       *  version of a package for p to match it.
+       *
+       *  Only terms that are reached through ?and and through the
+       *  version-pool operators are required; anything below ?or or
+       *  ?not is ignored.
+       */
+      void get_required_descriptions(const ref_ptr<pattern> &p,
+				     std::vector<ref_ptr<pattern> > &terms)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::description:
+	    terms.push_back(p);
+	    break;
+
+	  case pattern::and_tp:
+	    {
+	      const std::vector<ref_ptr<pattern> > &sub_patterns(p->get_and_patterns());
+	      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		    sub_patterns.begin(); it != sub_patterns.end(); ++it)
+		get_required_descriptions(*it, terms);
+	    }
+	    break;
+
+	  case pattern::all_versions:
+	    get_required_descriptions(p->get_all_versions_pattern(), terms);
+	    break;
+
+	  case pattern::any_version:
+	    get_required_descriptions(p->get_any_version_pattern(), terms);
+	    break;
+
+	  case pattern::for_tp:
+	    get_required_descriptions(p->get_for_pattern(), terms);
+	    break;
+
+	  case pattern::narrow:
+	    get_required_descriptions(p->get_narrow_pattern(), terms);
+	    break;
+
+	  case pattern::widen:
+	    get_required_descriptions(p->get_widen_pattern(), terms);
+	    break;
+
+	  default:
+	    break;
+	  }
+      }
+
+      /** \brief Use the description index to rule out packages that
+       *  can't match a pattern.
+       *
+       *  \param possible  Narrowed to the packages that might match.
+       *  \param profile   If not \b NULL, the number of packages the
+       *                   index left for each term is recorded here.
+       *
+       *  \return \b true if the index ruled anything out; if \b
+       *  false, possible is left unchanged.
+       */
+      bool get_description_candidates(const ref_ptr<pattern> &p,
+				      aptitudeDepCache &cache,
+				      pkgRecords &records,
+				      package_set &possible,
+				      match_profile *profile,
+				      bool debug)
+      {
+	std::vector<ref_ptr<pattern> > terms;
+	get_required_descriptions(p, terms);
+	if(terms.empty())
+	  return false;
+
+	const boost::shared_ptr<description_index> index =
+	  description_index::get(cache, records);
+	if(index.get() == NULL)
+	  return false;
+
+	bool filtered = false;
+	std::vector<unsigned long> candidates;
+	for(std::vector<ref_ptr<pattern> >::const_iterator it = terms.begin();
+	    it != terms.end(); ++it)
+	  {
+	    const std::string regex((*it)->get_description_regex_info().get_regex_string());
+	    if(!index->get_candidates(regex, candidates))
+	      continue;
+
+	    if(debug)
+	      std::cout << "The description index narrowed " << regex
+			<< " to " << candidates.size() << " packages." << std::endl;
+
+	    if(profile != NULL)
+	      profile->add_prefilter(*it,
+				     ssprintf("description index: %lu packages",
+					      static_cast<unsigned long>(candidates.size())));
+
+	    package_set matched(cache.Head().PackageCount, false);
+	    for(std::vector<unsigned long>::const_iterator cIt = candidates.begin();
+		cIt != candidates.end(); ++cIt)
+	      matched.insert(*cIt);
+
+	    possible.intersect(matched);
+	    filtered = true;
+	  }
+
+	return filtered;
+      }
+
+      /** \brief A contiguous slice of the packages being searched,
+       *  along with the matches found in it.
+       */
+      struct search_chunk
+      {
+	std::vector<pkgCache::PkgIterator>::const_iterator begin, end;
+	std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > matches;
+
+	// Set if the worker stopped because of an exception.
+	std::string error;
+      };
+
+      /** \brief Searches one chunk of the package list in a
+       *  background thread.
+       *
+       *  Each worker has its own package records and its own
+       *  search_cache, so the only state shared between workers is
+       *  the (read-only) package cache and the pattern itself.
+       */
+      class search_chunk_worker
+      {
+	ref_ptr<pattern> p;
+	search_chunk *chunk;
+	aptitudeDepCache *cache;
+
+      public:
+	search_chunk_worker(const ref_ptr<pattern> &_p,
+			    search_chunk *_chunk,
+			    aptitudeDepCache *_cache)
+	  : p(_p), chunk(_chunk), cache(_cache)
+	{
+	}
+
+	void operator()() const
+	{
+	  try
+	    {
+	      pkgRecords records(cache->GetCache());
+	      const ref_ptr<search_cache> info(new search_cache::implementation(false));
+
+	      for(std::vector<pkgCache::PkgIterator>::const_iterator it =
+		    chunk->begin; it != chunk->end; ++it)
+		{
+		  ref_ptr<structural_match> m(get_match(p, *it,
+							info,
+							*cache,
+							records,
+							false));
+
+		  if(m.valid())
+		    chunk->matches.push_back(std::make_pair(*it, m));
+		}
+	    }
+	  catch(cwidget::util::Exception &e)
+	    {
+	      chunk->error = e.errmsg();
+	    }
+	  catch(std::exception &e)
+	    {
+	      chunk->error = e.what();
+	    }
+	}
+      };
+
+      /** \brief Collects search results and passes them on in
+       *  batches.
+       */
+      class search_batcher
+      {
+	const sigc::slot<bool, const search_result_batch &> &batch_slot;
+	const std::size_t batch_size;
+	search_result_batch pending;
+	bool canceled;
+
+      public:
+	search_batcher(const sigc::slot<bool, const search_result_batch &> &_batch_slot,
+		       std::size_t _batch_size)
+	  : batch_slot(_batch_slot),
+	    batch_size(std::max(_batch_size, static_cast<std::size_t>(1))),
+	    canceled(false)
+	{
+	}
+
+	/** \brief Add a match, delivering the current batch if it is
+	 *  full.
+	 *
+	 *  \return \b false if the search has been cancelled.
+	 */
+	bool add(const pkgCache::PkgIterator &pkg,
+		 const ref_ptr<structural_match> &m)
+	{
+	  if(canceled)
+	    return false;
+
+	  pending.push_back(std::make_pair(pkg, m));
+	  if(pending.size() >= batch_size)
+	    return flush();
+	  else
+	    return true;
+	}
+
+	/** \brief Deliver any pending matches.
+	 *
+	 *  \return \b false if the search has been cancelled.
+	 */
+	bool flush()
+	{
+	  if(!canceled && !pending.empty())
+	    {
+	      canceled = !batch_slot(pending);
+	      pending.clear();
+	    }
+
+	  return !canceled;
+	}
+
+	bool get_canceled() const { return canceled; }
+      };
+
+      bool append_batch(const search_result_batch &batch,
+			search_result_batch &matches)
+      {
+	matches.insert(matches.end(), batch.begin(), batch.end());
+	return true;
+      }
+
+      /** \brief Test every package in the cache against a pattern,
+       *  splitting the work between several threads.
+       *
+       *  The package list is cut into num_threads contiguous chunks
+       *  in cache order, so concatenating the per-chunk results
+       *  yields the same ordering as a sequential scan.
+       */
+      void parallel_search(const ref_ptr<pattern> &p,
+			   search_batcher &output,
+			   aptitudeDepCache &cache,
+			   const package_set *possible,
+			   int num_threads,
+			   progress_info &progress,
+			   const sigc::slot<void, progress_info> &progress_slot)
+      {
+	std::vector<pkgCache::PkgIterator> packages;
+	packages.reserve(cache.Head().PackageCount);
+	for(pkgCache::PkgIterator pkg = cache.PkgBegin();
+	    !pkg.end(); ++pkg)
+	  {
+	    if(pkg.VersionList().end() && pkg.ProvidesList().end())
+	      continue;
+
+	    if(possible != NULL && !possible->contains(pkg->ID))
+	      continue;
+
+	    packages.push_back(pkg);
+	  }
+
+	std::vector<search_chunk> chunks(num_threads);
+	const std::vector<pkgCache::PkgIterator>::size_type chunk_size =
+	  (packages.size() + num_threads - 1) / num_threads;
+	for(int i = 0; i < num_threads; ++i)
+	  {
+	    const std::vector<pkgCache::PkgIterator>::size_type
+	      first = std::min(packages.size(), i * chunk_size),
+	      last = std::min(packages.size(), (i + 1) * chunk_size);
+
+	    chunks[i].begin = packages.begin() + first;
+	    chunks[i].end = packages.begin() + last;
+	  }
+
+	// Each chunk is a task on the thread pool; waiting for a chunk
+	// that no worker has started yet runs it in this thread.
+	cancel_token canceled;
+	thread_pool::batch workers(thread_pool::get(), canceled);
+	for(int i = 0; i < num_threads; ++i)
+	  workers.submit(search_chunk_worker(p, &chunks[i], &cache));
+
+	// Wait for the chunks in order, passing on their results as
+	// they finish.  After a cancellation, the chunks that haven't
+	// started are dropped; the ones that are running can't be
+	// interrupted, so they are still waited for, but their results
+	// are dropped.
+	for(int i = 0; i < num_threads; ++i)
+	  {
+	    workers.wait(i);
+
+	    if(!chunks[i].error.empty())
+	      _error->Error("%s", chunks[i].error.c_str());
+
+	    for(search_result_batch::const_iterator it =
+		  chunks[i].matches.begin(); it != chunks[i].matches.end(); ++it)
+	      if(!output.add(it->first, it->second))
+		break;
+
+	    output.flush();
+
+	    if(output.get_canceled())
+	      canceled.cancel();
+
+	    progress.set_progress_fraction(((double)(i + 1)) / ((double)num_threads));
+	    progress_slot(progress);
+	  }
+      }
+    }
+
+    bool search_incremental(const ref_ptr<pattern> &p,
+			    const ref_ptr<search_cache> &search_info,
+			    const sigc::slot<bool, const search_result_batch &> &batch_slot,
+			    aptitudeDepCache &cache,
+			    pkgRecords &records,
+			    std::size_t batch_size,
+			    bool debug,
+			    const sigc::slot<void, progress_info> &progress_slot)
+    {
+      search_batcher output(batch_slot, batch_size);
+
+      try
+	{
+          progress_slot(progress_info::pulse(_("Accessing index")));
+
+	  eassert(p.valid());
+	  eassert(search_info.valid());
+
+	  const ref_ptr<search_cache::implementation> info = search_info.dyn_downcast<search_cache::implementation>();
+	  eassert(info.valid());
+
+	  const xapian_info &xapian_results(info->get_toplevel_xapian_info(p, debug));
+
+          const std::string filter_msg = _("Filtering packages");
+	  if(!xapian_results.get_matched_packages_valid())
+	    {
+	      if(debug)
+		std::cout << "Failed to build a Xapian query for this search." << std::endl
+			  << "Falling back to testing each package." << std::endl;
+
+              progress_info progress = progress_info::bar(0, filter_msg);
+              progress_slot(progress);
+
+	      package_set possible(cache.Head().PackageCount, true);
+	      bool use_index =
+		get_flag_candidates(p, cache, records, possible,
+				    info->get_profile(), debug);
+	      if(get_description_candidates(p, cache, records, possible,
+					    info->get_profile(), debug))
+		use_index = true;
+
+	      const int num_threads =
+		aptcfg->FindI(PACKAGE "::Search::Threads", 1);
+
+	      // The worker threads have their own search caches, so
+	      // they can't be profiled.
+	      if(num_threads > 1 && !debug && info->get_profile() == NULL &&
+		 is_thread_safe(p))
+		{
+		  parallel_search(p, output, cache,
+				  use_index ? &possible : NULL,
+				  num_threads,
+				  progress, progress_slot);
+		}
+	      else
+		{
+		  int i = 0;
+		  for(pkgCache::PkgIterator pkg = cache.PkgBegin();
+		      !pkg.end(); ++pkg)
+		    {
+		      if(pkg.VersionList().end() && pkg.ProvidesList().end())
+			continue;
+
+		      if(use_index && !possible.contains(pkg->ID))
+			continue;
+
+		      // TODO: how do I make sure the sub-patterns are
+		      // searched using the right xapian_info?  I could thread
+		      // the current top-level or the current xapian_info
+		      // through, I suppose.  Or I could use a global list of
+		      // term postings and only store match sets on a
+		      // per-toplevel basis (that might work, actually?).
+
+		      ref_ptr<structural_match> m(get_match(p, pkg,
+							    info,
+							    cache,
+							    records,
+							    debug));
+
+		      if(m.valid() && !output.add(pkg, m))
+			break;
+
+		      ++i;
+		      progress.set_progress_fraction(((double)i) / ((double)cache.Head().PackageCount));
+		      progress_slot(progress);
+		    }
+		}
 	    }
 	  else
 	    {
@@ -3141,12 +4939,13 @@ namespace aptitude
 							    records,
 							    debug));
 
-		      if(m.valid())
-			matches.push_back(std::make_pair(pkg, m));
+		      if(m.valid() && !output.add(pkg, m))
+			break;
 		    }
 		}
 	    }
 
+	  output.flush();
           progress_slot(progress_info::none());
 	}
       catch(cwidget::util::Exception &e)
@@ -3161,6 +4960,23 @@ namespace aptitude
 	{
 	  _error->Error("%s", e.get_msg().c_str());
 	}
+
+      return !output.get_canceled();
+    }
+
+    void search(const ref_ptr<pattern> &p,
+		const ref_ptr<search_cache> &search_info,
+		std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > &matches,
+		aptitudeDepCache &cache,
+		pkgRecords &records,
+                bool debug,
+                const sigc::slot<void, progress_info> &progress_slot)
+    {
+      search_incremental(p, search_info,
+			 sigc::bind(sigc::ptr_fun(&append_batch), sigc::ref(matches)),
+			 cache, records,
+			 std::numeric_limits<std::size_t>::max(),
+			 debug, progress_slot);
     }
 
     void search_versions(const ref_ptr<pattern> &p,
@@ -3197,11 +5013,18 @@ namespace aptitude
               progress_info progress = progress_info::bar(0, filter_msg);
               progress_slot(progress);
 
+	      package_set possible(cache.Head().PackageCount, true);
+	      const bool use_index =
+		get_description_candidates(p, cache, records, possible,
+					   info->get_profile(), debug);
 
               int i = 0;
 	      for(pkgCache::PkgIterator pkg = cache.PkgBegin();
 		  !pkg.end(); ++pkg)
                 {
+                  if(use_index && !possible.contains(pkg->ID))
+                    continue;
+
                   for(pkgCache::VerIterator ver = pkg.VersionList();
                       !ver.end(); ++ver)
                     {
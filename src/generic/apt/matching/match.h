@@ -47,6 +47,8 @@ namespace aptitude
 
   namespace matching
   {
+    class match_profile;
+
     /** \brief Represents the atomic values that are selected by search
      *  patterns.
      *
@@ -624,6 +626,17 @@ namespace aptitude
     public:
       /** \brief Construct a new search cache. */
       static cwidget::util::ref_ptr<search_cache> create();
+
+      /** \brief Record the work done by each pattern node that is
+       *  evaluated through this cache.
+       *
+       *  \param profile  Where to record the statistics, or \b NULL
+       *                  to stop profiling.  The profile must outlive
+       *                  any searches that use this cache.  Searches
+       *                  that are being profiled always run in a
+       *                  single thread.
+       */
+      void set_profile(match_profile *profile);
     };
 
     /** \brief Test a version of a package against a pattern.
@@ -675,6 +688,44 @@ namespace aptitude
 	      pkgRecords &records,
 	      bool debug = false);
 
+    /** \brief Test whether a package or version matches a pattern.
+     *
+     *  This gives the same answer as get_match(...).valid(), but
+     *  doesn't build a description of the match, which makes it
+     *  considerably cheaper.  Use it when only a yes-or-no answer is
+     *  needed.
+     *
+     *  \param p   The pattern to execute.
+     *  \param pkg The package to compare.
+     *  \param ver The version to compare, or an end iterator to
+     *             test the package as a package.
+     *  \param search_info  Where to store "side information"
+     *                      associated with this search.
+     *  \param cache   The package cache in which to search.
+     *  \param records The package records with which to perform the match.
+     *  \param debug   If \b true, information about the search process
+     *                 will be printed to standard output.
+     */
+    bool has_match(const cwidget::util::ref_ptr<pattern> &p,
+		   const pkgCache::PkgIterator &pkg,
+		   const pkgCache::VerIterator &ver,
+		   const cwidget::util::ref_ptr<search_cache> &search_info,
+		   aptitudeDepCache &cache,
+		   pkgRecords &records,
+		   bool debug = false);
+
+    /** \brief Test whether a package matches a pattern.
+     *
+     *  This tests the package as a package, not as a version; it is
+     *  a cheaper equivalent of get_match(...).valid().
+     */
+    bool has_match(const cwidget::util::ref_ptr<pattern> &p,
+		   const pkgCache::PkgIterator &pkg,
+		   const cwidget::util::ref_ptr<search_cache> &search_info,
+		   aptitudeDepCache &cache,
+		   pkgRecords &records,
+		   bool debug = false);
+
     /** \brief Retrieve all the packages matching the given pattern.
      *
      *  This may use Xapian or other indices to accelerate the search
@@ -699,6 +750,45 @@ namespace aptitude
                 const sigc::slot<void, aptitude::util::progress_info> &progress_slot
                   = sigc::slot<void, aptitude::util::progress_info>());
 
+    /** \brief A batch of results delivered by search_incremental(). */
+    typedef std::vector<std::pair<pkgCache::PkgIterator, cwidget::util::ref_ptr<structural_match> > >
+    search_result_batch;
+
+    /** \brief Retrieve the packages matching the given pattern,
+     *  delivering them in batches as they are found.
+     *
+     *  This returns the same matches in the same order as search(),
+     *  but lets the caller display or process the first results
+     *  before the whole cache has been scanned.
+     *
+     *  \param p            The pattern to match against.
+     *  \param search_info  Where to store "side information"
+     *                      associated with this search.
+     *  \param batch_slot   Invoked with each batch of matches; if it
+     *                      returns \b false, the search is cancelled
+     *                      and no more batches are delivered.
+     *  \param cache        The package cache in which to search.
+     *  \param records      The package records in which to perform the match.
+     *  \param batch_size   The number of matches to collect before
+     *                      invoking batch_slot.  The last batch may be
+     *                      smaller.
+     *  \param debug        If \b true, information about the search
+     *                      process will be printed to standard output.
+     *  \param progress_slot A slot used to report the progress of the search.
+     *
+     *  \return \b false if the search was cancelled by batch_slot,
+     *  \b true otherwise.
+     */
+    bool search_incremental(const cwidget::util::ref_ptr<pattern> &p,
+			    const cwidget::util::ref_ptr<search_cache> &search_info,
+			    const sigc::slot<bool, const search_result_batch &> &batch_slot,
+			    aptitudeDepCache &cache,
+			    pkgRecords &records,
+			    std::size_t batch_size = 64,
+			    bool debug = false,
+			    const sigc::slot<void, aptitude::util::progress_info> &progress_slot
+			      = sigc::slot<void, aptitude::util::progress_info>());
+
     /** \brief Retrieve all the package versions matching the given pattern.
      *
      *  This may use Xapian or other indices to accelerate the search
@@ -0,0 +1,228 @@
+// match_profile.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "match_profile.h"
+
+#include "pattern.h"
+#include "serialize.h"
+
+#include <cwidget/generic/util/ssprintf.h>
+
+#include <sys/time.h>
+
+using cwidget::util::ref_ptr;
+using cwidget::util::ssprintf;
+
+namespace aptitude
+{
+  namespace matching
+  {
+    namespace
+    {
+      double now()
+      {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+      }
+
+      // The width of the pattern column, including indentation.
+      const std::string::size_type label_width = 40;
+
+      /** \brief Collect the sub-patterns of a node in the order they
+       *  appear when the node is written out.
+       */
+      void get_sub_patterns(const ref_ptr<pattern> &p,
+			    std::vector<ref_ptr<pattern> > &out)
+      {
+	switch(p->get_type())
+	  {
+	  case pattern::all_versions:
+	    out.push_back(p->get_all_versions_pattern());
+	    break;
+
+	  case pattern::and_tp:
+	    out.insert(out.end(),
+		       p->get_and_patterns().begin(),
+		       p->get_and_patterns().end());
+	    break;
+
+	  case pattern::any_version:
+	    out.push_back(p->get_any_version_pattern());
+	    break;
+
+	  case pattern::bind:
+	    out.push_back(p->get_bind_pattern());
+	    break;
+
+	  case pattern::depends:
+	    out.push_back(p->get_depends_pattern());
+	    break;
+
+	  case pattern::for_tp:
+	    out.push_back(p->get_for_pattern());
+	    break;
+
+	  case pattern::narrow:
+	    out.push_back(p->get_narrow_filter());
+	    out.push_back(p->get_narrow_pattern());
+	    break;
+
+	  case pattern::not_tp:
+	    out.push_back(p->get_not_pattern());
+	    break;
+
+	  case pattern::or_tp:
+	    out.insert(out.end(),
+		       p->get_or_patterns().begin(),
+		       p->get_or_patterns().end());
+	    break;
+
+	  case pattern::provides:
+	    out.push_back(p->get_provides_pattern());
+	    break;
+
+	  case pattern::reverse_depends:
+	    out.push_back(p->get_reverse_depends_pattern());
+	    break;
+
+	  case pattern::reverse_provides:
+	    out.push_back(p->get_reverse_provides_pattern());
+	    break;
+
+	  case pattern::widen:
+	    out.push_back(p->get_widen_pattern());
+	    break;
+
+	  default:
+	    break;
+	  }
+      }
+
+      std::string make_label(const ref_ptr<pattern> &p, int depth)
+      {
+	std::string rval(2 * depth, ' ');
+	rval += serialize_pattern(p);
+
+	if(rval.size() > label_width)
+	  {
+	    rval.erase(label_width - 3);
+	    rval += "...";
+	  }
+
+	return rval;
+      }
+
+      void format_node(const match_profile &profile,
+		       const ref_ptr<pattern> &p,
+		       int depth,
+		       std::string &out)
+      {
+	const std::string label(make_label(p, depth));
+	const match_profile::node_stats *stats = profile.find(p);
+
+	if(stats == NULL)
+	  out += ssprintf("%-*s %8s %10s %10s %8s %10s\n",
+			  static_cast<int>(label_width), label.c_str(),
+			  "-", "-", "-", "-", "-");
+	else
+	  {
+	    out += ssprintf("%-*s %8lu %10lu %10lu %8lu %10.1f\n",
+			    static_cast<int>(label_width), label.c_str(),
+			    stats->evaluations,
+			    stats->targets,
+			    stats->matches,
+			    stats->memo_hits,
+			    stats->seconds * 1000);
+
+	    for(std::vector<std::string>::const_iterator it =
+		  stats->prefilters.begin(); it != stats->prefilters.end(); ++it)
+	      out += std::string(2 * depth + 2, ' ') + "[" + *it + "]\n";
+	  }
+
+	std::vector<ref_ptr<pattern> > sub_patterns;
+	get_sub_patterns(p, sub_patterns);
+	for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	      sub_patterns.begin(); it != sub_patterns.end(); ++it)
+	  format_node(profile, *it, depth + 1, out);
+      }
+    }
+
+    match_profile::timer::timer()
+      : started(now())
+    {
+    }
+
+    double match_profile::timer::elapsed() const
+    {
+      return now() - started;
+    }
+
+    void match_profile::add_evaluation(const ref_ptr<pattern> &p,
+				       std::size_t targets,
+				       bool matched,
+				       double seconds)
+    {
+      node_stats &stats = nodes[p];
+      ++stats.evaluations;
+      stats.targets += targets;
+      if(matched)
+	++stats.matches;
+      stats.seconds += seconds;
+    }
+
+    void match_profile::add_memo_hit(const ref_ptr<pattern> &p,
+				     bool matched)
+    {
+      node_stats &stats = nodes[p];
+      ++stats.evaluations;
+      ++stats.targets;
+      ++stats.memo_hits;
+      if(matched)
+	++stats.matches;
+    }
+
+    void match_profile::add_prefilter(const ref_ptr<pattern> &p,
+				      const std::string &description)
+    {
+      nodes[p].prefilters.push_back(description);
+    }
+
+    const match_profile::node_stats *
+    match_profile::find(const ref_ptr<pattern> &p) const
+    {
+      std::map<ref_ptr<pattern>, node_stats>::const_iterator found =
+	nodes.find(p);
+
+      if(found == nodes.end())
+	return NULL;
+      else
+	return &found->second;
+    }
+
+    std::string match_profile::format(const ref_ptr<pattern> &root) const
+    {
+      std::string rval = ssprintf("%-*s %8s %10s %10s %8s %10s\n",
+				  static_cast<int>(label_width), "Pattern",
+				  "Evals", "Tested", "Matched", "Memo", "Time (ms)");
+      format_node(*this, root, 0, rval);
+      return rval;
+    }
+  }
+}
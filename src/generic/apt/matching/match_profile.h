@@ -0,0 +1,149 @@
+// match_profile.h    -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef MATCH_PROFILE_H
+#define MATCH_PROFILE_H
+
+/** \file match_profile.h */
+
+#include <cwidget/generic/util/ref_ptr.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace aptitude
+{
+  namespace matching
+  {
+    class pattern;
+
+    /** \brief Records how much work each node of a pattern took
+     *  during a search.
+     *
+     *  Attach a profile to a search_cache with
+     *  search_cache::set_profile(); every pattern node that is then
+     *  evaluated through that cache is counted against its own
+     *  entry.  Profiling times each evaluation separately, so it
+     *  slows the search down noticeably and should only be enabled
+     *  when the report is wanted.
+     */
+    class match_profile
+    {
+    public:
+      struct node_stats
+      {
+	/** \brief How many times the node was evaluated. */
+	unsigned long evaluations;
+
+	/** \brief The number of packages and versions the node was
+	 *  tested against, summed over all its evaluations.
+	 */
+	unsigned long targets;
+
+	/** \brief How many evaluations matched. */
+	unsigned long matches;
+
+	/** \brief How many evaluations reused a remembered result
+	 *  instead of testing the package again.
+	 */
+	unsigned long memo_hits;
+
+	/** \brief The time spent evaluating the node, including its
+	 *  sub-patterns, in seconds.
+	 */
+	double seconds;
+
+	/** \brief Descriptions of the indices that ruled out packages
+	 *  before this node was tested.
+	 */
+	std::vector<std::string> prefilters;
+
+	node_stats()
+	  : evaluations(0), targets(0), matches(0), memo_hits(0),
+	    seconds(0)
+	{
+	}
+      };
+
+      /** \brief Measures the duration of one evaluation. */
+      class timer
+      {
+	double started;
+
+      public:
+	timer();
+
+	/** \brief The number of seconds since the timer was created. */
+	double elapsed() const;
+      };
+
+    private:
+      std::map<cwidget::util::ref_ptr<pattern>, node_stats> nodes;
+
+    public:
+      /** \brief Count one evaluation of a pattern node.
+       *
+       *  \param p        The node that was evaluated.
+       *  \param targets  The number of packages and versions it was
+       *                  tested against.
+       *  \param matched  Whether the evaluation matched.
+       *  \param seconds  How long the evaluation took.
+       */
+      void add_evaluation(const cwidget::util::ref_ptr<pattern> &p,
+			  std::size_t targets,
+			  bool matched,
+			  double seconds);
+
+      /** \brief Count an evaluation of a node that was answered from
+       *  the search cache's memoized results.
+       */
+      void add_memo_hit(const cwidget::util::ref_ptr<pattern> &p,
+			bool matched);
+
+      /** \brief Note that an index narrowed the packages that a node
+       *  was tested against.
+       *
+       *  \param p            The node whose input was narrowed.
+       *  \param description  What did the narrowing, and how many
+       *                      packages it left.
+       */
+      void add_prefilter(const cwidget::util::ref_ptr<pattern> &p,
+			 const std::string &description);
+
+      /** \brief Look up the statistics of a node.
+       *
+       *  \return the statistics, or \b NULL if the node was never
+       *  evaluated.
+       */
+      const node_stats *find(const cwidget::util::ref_ptr<pattern> &p) const;
+
+      /** \brief Render the statistics as a table with one line per
+       *  node of the given pattern, indented to show its structure.
+       *
+       *  Nodes that were never evaluated (for instance because an
+       *  earlier term of an ?and always failed) are listed without
+       *  any numbers.
+       */
+      std::string format(const cwidget::util::ref_ptr<pattern> &root) const;
+    };
+  }
+}
+
+#endif // MATCH_PROFILE_H
@@ -46,6 +46,7 @@
 
 #include <generic/apt/apt.h>
 #include <generic/apt/aptcache.h>
+#include <generic/apt/config_signal.h>
 #include <generic/apt/tags.h>
 #include <generic/apt/tasks.h>
 
@@ -54,11 +55,15 @@
 #include <generic/util/immset.h>
 #include <generic/util/util.h>
 
+#include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/generic/util/transcode.h>
 
+#include <list>
+#include <map>
 #include <set>
 
+#include <locale.h>
 #include <stdarg.h>
 
 #include <apt-pkg/error.h>
@@ -1433,37 +1438,192 @@ ref_ptr<pattern> parse_condition_list(string::const_iterator &start,
     return pattern::make_or(grp.begin(), grp.end());
 }
 
-ref_ptr<pattern> parse_with_errors(string::const_iterator &start,
-				   const string::const_iterator &end,
-				   const std::vector<const char *> &terminators,
-				   bool require_full_parse,
-				   bool partial)
+namespace
 {
-  // Just filter blank strings out immediately.
-  while(start != end && isspace(*start) && !terminate(start, end, terminators))
-    ++start;
+  ref_ptr<pattern> parse_uncached(string::const_iterator &start,
+				  const string::const_iterator &end,
+				  const std::vector<const char *> &terminators,
+				  bool require_full_parse,
+				  bool partial)
+  {
+    // Just filter blank strings out immediately.
+    while(start != end && isspace(*start) && !terminate(start, end, terminators))
+      ++start;
 
-  if(start == end)
-    return ref_ptr<pattern>();
+    if(start == end)
+      return ref_ptr<pattern>();
 
-  string::const_iterator real_end = end;
+    string::const_iterator real_end = end;
 
-  // Move 'end' back as long as there's whitespace, so that we can
-  // easily check whether a word is at the end of the string.
-  while(start != real_end && isspace(*(real_end - 1)))
-    --real_end;
+    // Move 'end' back as long as there's whitespace, so that we can
+    // easily check whether a word is at the end of the string.
+    while(start != real_end && isspace(*(real_end - 1)))
+      --real_end;
 
-  ref_ptr<pattern> rval(parse_condition_list(start, real_end, terminators,
-					     true, partial,
-					     parse_environment()));
+    ref_ptr<pattern> rval(parse_condition_list(start, real_end, terminators,
+					       true, partial,
+					       parse_environment()));
 
-  while(start != real_end && isspace(*start))
-    ++start;
+    while(start != real_end && isspace(*start))
+      ++start;
+
+    if(require_full_parse && start != real_end)
+      throw MatchingException(_("Unexpected ')'"));
+    else
+      return rval;
+  }
+
+  /** \brief A process-wide cache of recently parsed patterns.
+   *
+   *  The user interfaces parse the same limit and search strings over
+   *  and over (for instance, on every keystroke of an incremental
+   *  search), so the results of successful parses are kept and
+   *  returned again when the same text is parsed with the same
+   *  options.  Patterns are immutable and thread-safe, so the same
+   *  object can be handed to every caller.
+   *
+   *  Failed parses aren't cached, so that their errors are reported
+   *  each time.
+   */
+  class parse_cache
+  {
+    struct entry
+    {
+      string key;
+      ref_ptr<pattern> result;
+      // How many characters of the input the parse consumed.
+      string::size_type consumed;
+
+      entry(const string &_key,
+	    const ref_ptr<pattern> &_result,
+	    string::size_type _consumed)
+	: key(_key), result(_result), consumed(_consumed)
+      {
+      }
+    };
+
+    // The most recently used entry is at the front.
+    typedef std::list<entry> entry_list;
+    entry_list entries;
+    std::map<string, entry_list::iterator> index;
+
+    cw::threads::mutex m;
+
+  public:
+    /** \brief Look up the result of a previous parse.
+     *
+     *  \return \b true if key was found, in which case result and
+     *  consumed are set.
+     */
+    bool find(const string &key,
+	      ref_ptr<pattern> &result,
+	      string::size_type &consumed)
+    {
+      cw::threads::mutex::lock l(m);
+
+      std::map<string, entry_list::iterator>::const_iterator found =
+	index.find(key);
+      if(found == index.end())
+	return false;
+
+      entries.splice(entries.begin(), entries, found->second);
+      result = found->second->result;
+      consumed = found->second->consumed;
+      return true;
+    }
+
+    /** \brief Store the result of a parse, evicting the least
+     *  recently used entries if the cache is full.
+     */
+    void insert(const string &key,
+		const ref_ptr<pattern> &result,
+		string::size_type consumed,
+		std::size_t max_size)
+    {
+      cw::threads::mutex::lock l(m);
+
+      if(index.find(key) != index.end())
+	return;
+
+      entries.push_front(entry(key, result, consumed));
+      index[key] = entries.begin();
+
+      while(entries.size() > max_size)
+	{
+	  index.erase(entries.back().key);
+	  entries.pop_back();
+	}
+    }
+  };
+
+  // This is deliberately allocated on the heap and leaked, so that it
+  // is still usable if a pattern is parsed while the program exits.
+  parse_cache *global_parse_cache = new parse_cache;
+
+  /** \brief Build the key under which a parse is cached.
+   *
+   *  Apart from the text itself and the parse options, the result
+   *  depends on the locale (priority names are translated) and on
+   *  whether a package cache is open to translate them.
+   */
+  string get_parse_cache_key(const string::const_iterator &start,
+			     const string::const_iterator &end,
+			     const std::vector<const char *> &terminators,
+			     bool require_full_parse,
+			     bool partial)
+  {
+    string rval(start, end);
+
+    rval.push_back('\0');
+    rval.push_back(require_full_parse ? '1' : '0');
+    rval.push_back(partial ? '1' : '0');
+    rval.push_back(apt_cache_file != NULL ? '1' : '0');
+
+    const char *locale = setlocale(LC_MESSAGES, NULL);
+    rval.push_back('\0');
+    if(locale != NULL)
+      rval += locale;
+
+    for(std::vector<const char *>::const_iterator it = terminators.begin();
+	it != terminators.end(); ++it)
+      {
+	rval.push_back('\0');
+	rval += *it;
+      }
 
-  if(require_full_parse && start != real_end)
-    throw MatchingException(_("Unexpected ')'"));
-  else
     return rval;
+  }
+}
+
+ref_ptr<pattern> parse_with_errors(string::const_iterator &start,
+				   const string::const_iterator &end,
+				   const std::vector<const char *> &terminators,
+				   bool require_full_parse,
+				   bool partial)
+{
+  // Patterns can be parsed before the configuration has been loaded
+  // (for instance, by the test suite); don't cache those.
+  const int max_size =
+    aptcfg == NULL ? 0 : aptcfg->FindI(PACKAGE "::Search::Pattern-Cache-Size", 64);
+  if(max_size <= 0)
+    return parse_uncached(start, end, terminators, require_full_parse, partial);
+
+  const string key(get_parse_cache_key(start, end, terminators,
+				       require_full_parse, partial));
+
+  ref_ptr<pattern> rval;
+  string::size_type consumed;
+  if(global_parse_cache->find(key, rval, consumed))
+    {
+      start += consumed;
+      return rval;
+    }
+
+  const string::const_iterator original_start = start;
+  rval = parse_uncached(start, end, terminators, require_full_parse, partial);
+
+  global_parse_cache->insert(key, rval, start - original_start, max_size);
+  return rval;
 }
 
 ref_ptr<pattern> parse(string::const_iterator &start,
@@ -0,0 +1,291 @@
+// pattern_cost.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "pattern_cost.h"
+
+#include "pattern.h"
+
+#include <algorithm>
+#include <limits>
+
+using cwidget::util::ref_ptr;
+
+namespace aptitude
+{
+  namespace matching
+  {
+    namespace
+    {
+      // Rough costs of the basic operations a term can perform.
+      const double flag_cost = 1;
+      const double cache_string_cost = 5;
+      const double file_list_cost = 10;
+      const double index_cost = 20;
+      const double records_cost = 100;
+
+      // Terms that start a new search over the dependency graph
+      // test their sub-pattern against several targets.
+      const double dependency_cost = 50;
+      const double dependency_fanout = 10;
+
+      // Operators that change the version pool test their
+      // sub-pattern against several versions.
+      const double versions_per_package = 2;
+
+      double sum_costs(const std::vector<ref_ptr<pattern> > &terms)
+      {
+	double rval = 0;
+	for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	      terms.begin(); it != terms.end(); ++it)
+	  rval += estimate_pattern_cost(*it);
+
+	return rval;
+      }
+
+      // The rank of a conjunct: the expected cost of evaluating it
+      // per unit of probability that it ends the conjunction.
+      double conjunction_rank(const ref_ptr<pattern> &p)
+      {
+	const double failure = 1 - estimate_pattern_selectivity(p);
+
+	if(failure <= 0)
+	  return std::numeric_limits<double>::infinity();
+	else
+	  return estimate_pattern_cost(p) / failure;
+      }
+
+      struct compare_ranks
+      {
+	const std::vector<double> &ranks;
+
+	compare_ranks(const std::vector<double> &_ranks)
+	  : ranks(_ranks)
+	{
+	}
+
+	bool operator()(std::size_t i1, std::size_t i2) const
+	{
+	  return ranks[i1] < ranks[i2];
+	}
+      };
+    }
+
+    double estimate_pattern_cost(const ref_ptr<pattern> &p)
+    {
+      switch(p->get_type())
+	{
+	  // Structural patterns:
+	case pattern::all_versions:
+	  return versions_per_package * estimate_pattern_cost(p->get_all_versions_pattern());
+	case pattern::and_tp:
+	  return sum_costs(p->get_and_patterns());
+	case pattern::any_version:
+	  return versions_per_package * estimate_pattern_cost(p->get_any_version_pattern());
+	case pattern::for_tp:
+	  return estimate_pattern_cost(p->get_for_pattern());
+	case pattern::narrow:
+	  return
+	    versions_per_package * estimate_pattern_cost(p->get_narrow_filter()) +
+	    estimate_pattern_cost(p->get_narrow_pattern());
+	case pattern::not_tp:
+	  return estimate_pattern_cost(p->get_not_pattern());
+	case pattern::or_tp:
+	  return sum_costs(p->get_or_patterns());
+	case pattern::widen:
+	  return versions_per_package * estimate_pattern_cost(p->get_widen_pattern());
+
+	  // Atomic patterns:
+	case pattern::action:
+	case pattern::automatic:
+	case pattern::broken:
+	case pattern::broken_type:
+	case pattern::candidate_version:
+	case pattern::config_files:
+	case pattern::current_version:
+	case pattern::equal:
+	case pattern::essential:
+	case pattern::false_tp:
+	case pattern::garbage:
+	case pattern::install_version:
+	case pattern::installed:
+	case pattern::multiarch:
+	case pattern::new_tp:
+	case pattern::obsolete:
+	case pattern::priority:
+	case pattern::true_tp:
+	case pattern::upgradable:
+	case pattern::virtual_tp:
+	  return flag_cost;
+
+	case pattern::architecture:
+	case pattern::exact_name:
+	case pattern::name:
+	case pattern::section:
+	case pattern::user_tag:
+	case pattern::version:
+	  return cache_string_cost;
+
+	case pattern::archive:
+	case pattern::origin:
+	  return file_list_cost;
+
+	case pattern::tag:
+	case pattern::task:
+	case pattern::term:
+	case pattern::term_prefix:
+	  return index_cost;
+
+	case pattern::description:
+	case pattern::maintainer:
+	case pattern::source_package:
+	case pattern::source_version:
+	  return records_cost;
+
+	case pattern::bind:
+	  return estimate_pattern_cost(p->get_bind_pattern());
+
+	case pattern::depends:
+	  return dependency_cost + dependency_fanout * estimate_pattern_cost(p->get_depends_pattern());
+	case pattern::provides:
+	  return dependency_cost + dependency_fanout * estimate_pattern_cost(p->get_provides_pattern());
+	case pattern::reverse_depends:
+	  return dependency_cost + dependency_fanout * estimate_pattern_cost(p->get_reverse_depends_pattern());
+	case pattern::reverse_provides:
+	  return dependency_cost + dependency_fanout * estimate_pattern_cost(p->get_reverse_provides_pattern());
+
+	default:
+	  return records_cost;
+	}
+    }
+
+    double estimate_pattern_selectivity(const ref_ptr<pattern> &p)
+    {
+      switch(p->get_type())
+	{
+	  // Structural patterns:
+	case pattern::all_versions:
+	  return estimate_pattern_selectivity(p->get_all_versions_pattern());
+	case pattern::and_tp:
+	  {
+	    const std::vector<ref_ptr<pattern> > &terms(p->get_and_patterns());
+	    double rval = 1;
+	    for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		  terms.begin(); it != terms.end(); ++it)
+	      rval *= estimate_pattern_selectivity(*it);
+	    return rval;
+	  }
+	case pattern::any_version:
+	  return estimate_pattern_selectivity(p->get_any_version_pattern());
+	case pattern::for_tp:
+	  return estimate_pattern_selectivity(p->get_for_pattern());
+	case pattern::narrow:
+	  return
+	    estimate_pattern_selectivity(p->get_narrow_filter()) *
+	    estimate_pattern_selectivity(p->get_narrow_pattern());
+	case pattern::not_tp:
+	  return 1 - estimate_pattern_selectivity(p->get_not_pattern());
+	case pattern::or_tp:
+	  {
+	    const std::vector<ref_ptr<pattern> > &terms(p->get_or_patterns());
+	    double none = 1;
+	    for(std::vector<ref_ptr<pattern> >::const_iterator it =
+		  terms.begin(); it != terms.end(); ++it)
+	      none *= 1 - estimate_pattern_selectivity(*it);
+	    return 1 - none;
+	  }
+	case pattern::widen:
+	  return estimate_pattern_selectivity(p->get_widen_pattern());
+
+	  // Atomic patterns:
+	case pattern::false_tp:
+	  return 0;
+	case pattern::true_tp:
+	  return 1;
+
+	case pattern::equal:
+	case pattern::exact_name:
+	  return 0.001;
+
+	case pattern::action:
+	case pattern::broken:
+	case pattern::broken_type:
+	case pattern::config_files:
+	case pattern::essential:
+	case pattern::garbage:
+	case pattern::obsolete:
+	case pattern::upgradable:
+	  return 0.01;
+
+	case pattern::automatic:
+	case pattern::description:
+	case pattern::installed:
+	case pattern::maintainer:
+	case pattern::name:
+	case pattern::new_tp:
+	case pattern::source_package:
+	case pattern::source_version:
+	case pattern::tag:
+	case pattern::task:
+	case pattern::term:
+	case pattern::term_prefix:
+	case pattern::user_tag:
+	case pattern::version:
+	  return 0.05;
+
+	case pattern::candidate_version:
+	case pattern::current_version:
+	case pattern::install_version:
+	case pattern::priority:
+	case pattern::section:
+	case pattern::virtual_tp:
+	  return 0.2;
+
+	case pattern::archive:
+	case pattern::architecture:
+	case pattern::multiarch:
+	case pattern::origin:
+	  return 0.5;
+
+	case pattern::bind:
+	  return estimate_pattern_selectivity(p->get_bind_pattern());
+
+	default:
+	  return 0.1;
+	}
+    }
+
+    void get_conjunction_order(const std::vector<ref_ptr<pattern> > &terms,
+			       std::vector<std::size_t> &order)
+    {
+      std::vector<double> ranks;
+      ranks.reserve(terms.size());
+      for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	    terms.begin(); it != terms.end(); ++it)
+	ranks.push_back(conjunction_rank(*it));
+
+      order.clear();
+      for(std::size_t i = 0; i < terms.size(); ++i)
+	order.push_back(i);
+
+      // A stable sort keeps terms with the same rank in the order
+      // the user wrote them.
+      std::stable_sort(order.begin(), order.end(), compare_ranks(ranks));
+    }
+  }
+}
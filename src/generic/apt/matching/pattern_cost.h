@@ -0,0 +1,67 @@
+// pattern_cost.h    -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef PATTERN_COST_H
+#define PATTERN_COST_H
+
+/** \file pattern_cost.h */
+
+#include <cwidget/generic/util/ref_ptr.h>
+
+#include <vector>
+
+namespace aptitude
+{
+  namespace matching
+  {
+    class pattern;
+
+    /** \brief Estimate how expensive it is to match a pattern against
+     *  a single package or version.
+     *
+     *  The result is in arbitrary units: testing a flag in the
+     *  package cache costs about 1, while reading the package
+     *  records costs about 100.
+     */
+    double estimate_pattern_cost(const cwidget::util::ref_ptr<pattern> &p);
+
+    /** \brief Estimate the fraction of packages or versions that a
+     *  pattern matches.
+     *
+     *  \return a number between 0 and 1.
+     */
+    double estimate_pattern_selectivity(const cwidget::util::ref_ptr<pattern> &p);
+
+    /** \brief Choose the order in which to evaluate the terms of a
+     *  conjunction.
+     *
+     *  Terms are ordered so that cheap terms, and terms that are
+     *  likely to fail, come first; this minimizes the expected cost
+     *  of evaluating the conjunction when it stops at the first
+     *  failing term.
+     *
+     *  \param terms  The terms of the conjunction.
+     *  \param order  Set to a permutation of the indices of terms.
+     */
+    void get_conjunction_order(const std::vector<cwidget::util::ref_ptr<pattern> > &terms,
+			       std::vector<std::size_t> &order);
+  }
+}
+
+#endif // PATTERN_COST_H
@@ -21,8 +21,11 @@
 
 #include "pattern.h"
 
+#include <boost/functional/hash.hpp>
+
 using cwidget::util::ref_ptr;
 
+#include <limits>
 #include <sstream>
 
 namespace aptitude
@@ -610,5 +613,589 @@ namespace aptitude
       serialize_pattern(p, rval);
       return rval.str();
     }
+
+    namespace
+    {
+      // Written at the start of every binary encoding.  Change it
+      // whenever the encoding changes, so that data written by an
+      // older version is rejected instead of misread.
+      const unsigned char binary_format_version = 1;
+
+      // The encoding is written through a "sink" so that the same
+      // code can produce it or hash it.
+
+      class string_sink
+      {
+	std::string &out;
+
+      public:
+	explicit string_sink(std::string &_out)
+	  : out(_out)
+	{
+	}
+
+	void put_byte(unsigned char c)
+	{
+	  out.push_back(c);
+	}
+
+	void put_bytes(const std::string &s)
+	{
+	  out += s;
+	}
+      };
+
+      class hash_sink
+      {
+	std::size_t hash;
+
+      public:
+	hash_sink()
+	  : hash(0)
+	{
+	}
+
+	void put_byte(unsigned char c)
+	{
+	  boost::hash_combine(hash, c);
+	}
+
+	void put_bytes(const std::string &s)
+	{
+	  boost::hash_combine(hash, s);
+	}
+
+	std::size_t get_hash() const
+	{
+	  return hash;
+	}
+      };
+
+      // Numbers are written seven bits at a time, lowest bits first;
+      // the high bit of each byte is set if more bytes follow.
+      template<typename Sink>
+      void encode_number(std::size_t n, Sink &out)
+      {
+	while(n >= 0x80)
+	  {
+	    out.put_byte((n & 0x7f) | 0x80);
+	    n >>= 7;
+	  }
+
+	out.put_byte(n);
+      }
+
+      template<typename Sink>
+      void encode_string(const std::string &s, Sink &out)
+      {
+	encode_number(s.size(), out);
+	out.put_bytes(s);
+      }
+
+      template<typename Sink>
+      void encode_regexp(const pattern::regex_info &info, Sink &out)
+      {
+	encode_string(info.get_regex_string(), out);
+      }
+
+      template<typename Sink>
+      void encode_pattern(const ref_ptr<pattern> &p, Sink &out);
+
+      template<typename Sink>
+      void encode_pattern_list(const std::vector<ref_ptr<pattern> > &patterns,
+			       Sink &out)
+      {
+	encode_number(patterns.size(), out);
+	for(std::vector<ref_ptr<pattern> >::const_iterator it =
+	      patterns.begin(); it != patterns.end(); ++it)
+	  encode_pattern(*it, out);
+      }
+
+      /** \brief Write the encoding of a pattern.
+       *
+       *  Each term is its type, followed by its fields in the order
+       *  that the pattern constructor takes them.  This must store
+       *  exactly the fields that compare_patterns() looks at, or
+       *  hash_pattern() will be wrong.
+       */
+      template<typename Sink>
+      void encode_pattern(const ref_ptr<pattern> &p, Sink &out)
+      {
+	out.put_byte(p->get_type());
+
+	switch(p->get_type())
+	  {
+	  case pattern::archive:
+	    encode_regexp(p->get_archive_regex_info(), out);
+	    break;
+
+	  case pattern::action:
+	    encode_number(p->get_action_action_type(), out);
+	    break;
+
+	  case pattern::all_versions:
+	    encode_pattern(p->get_all_versions_pattern(), out);
+	    break;
+
+	  case pattern::any_version:
+	    encode_pattern(p->get_any_version_pattern(), out);
+	    break;
+
+	  case pattern::architecture:
+	    encode_regexp(p->get_architecture_regex_info(), out);
+	    break;
+
+	  case pattern::and_tp:
+	    encode_pattern_list(p->get_and_patterns(), out);
+	    break;
+
+	  case pattern::bind:
+	    encode_number(p->get_bind_variable_index(), out);
+	    encode_pattern(p->get_bind_pattern(), out);
+	    break;
+
+	  case pattern::broken_type:
+	    encode_number(p->get_broken_type_depends_type(), out);
+	    break;
+
+	  case pattern::depends:
+	    encode_number(p->get_depends_depends_type(), out);
+	    out.put_byte(p->get_depends_broken() ? 1 : 0);
+	    encode_pattern(p->get_depends_pattern(), out);
+	    break;
+
+	  case pattern::description:
+	    encode_regexp(p->get_description_regex_info(), out);
+	    break;
+
+	  case pattern::equal:
+	    encode_number(p->get_equal_stack_position(), out);
+	    break;
+
+	  case pattern::exact_name:
+	    encode_string(p->get_exact_name_name(), out);
+	    break;
+
+	  case pattern::for_tp:
+	    encode_string(p->get_for_variable_name(), out);
+	    encode_pattern(p->get_for_pattern(), out);
+	    break;
+
+	  case pattern::maintainer:
+	    encode_regexp(p->get_maintainer_regex_info(), out);
+	    break;
+
+	  case pattern::multiarch:
+	    encode_number(p->get_multiarch_multiarch_type(), out);
+	    break;
+
+	  case pattern::name:
+	    encode_regexp(p->get_name_regex_info(), out);
+	    break;
+
+	  case pattern::narrow:
+	    encode_pattern(p->get_narrow_filter(), out);
+	    encode_pattern(p->get_narrow_pattern(), out);
+	    break;
+
+	  case pattern::not_tp:
+	    encode_pattern(p->get_not_pattern(), out);
+	    break;
+
+	  case pattern::or_tp:
+	    encode_pattern_list(p->get_or_patterns(), out);
+	    break;
+
+	  case pattern::origin:
+	    encode_regexp(p->get_origin_regex_info(), out);
+	    break;
+
+	  case pattern::priority:
+	    encode_number(p->get_priority_priority(), out);
+	    break;
+
+	  case pattern::provides:
+	    encode_pattern(p->get_provides_pattern(), out);
+	    break;
+
+	  case pattern::reverse_depends:
+	    encode_number(p->get_reverse_depends_depends_type(), out);
+	    out.put_byte(p->get_reverse_depends_broken() ? 1 : 0);
+	    encode_pattern(p->get_reverse_depends_pattern(), out);
+	    break;
+
+	  case pattern::reverse_provides:
+	    encode_pattern(p->get_reverse_provides_pattern(), out);
+	    break;
+
+	  case pattern::section:
+	    encode_regexp(p->get_section_regex_info(), out);
+	    break;
+
+	  case pattern::source_package:
+	    encode_regexp(p->get_source_package_regex_info(), out);
+	    break;
+
+	  case pattern::source_version:
+	    encode_regexp(p->get_source_version_regex_info(), out);
+	    break;
+
+	  case pattern::tag:
+	    encode_regexp(p->get_tag_regex_info(), out);
+	    break;
+
+	  case pattern::task:
+	    encode_regexp(p->get_task_regex_info(), out);
+	    break;
+
+	  case pattern::term:
+	    encode_string(p->get_term_term(), out);
+	    break;
+
+	  case pattern::term_prefix:
+	    encode_string(p->get_term_prefix_term(), out);
+	    break;
+
+	  case pattern::user_tag:
+	    encode_regexp(p->get_user_tag_regex_info(), out);
+	    break;
+
+	  case pattern::version:
+	    encode_regexp(p->get_version_regex_info(), out);
+	    break;
+
+	  case pattern::widen:
+	    encode_pattern(p->get_widen_pattern(), out);
+	    break;
+
+	    // Terms with no fields.
+	  case pattern::automatic:
+	  case pattern::broken:
+	  case pattern::candidate_version:
+	  case pattern::config_files:
+	  case pattern::current_version:
+	  case pattern::essential:
+	  case pattern::false_tp:
+	  case pattern::garbage:
+	  case pattern::install_version:
+	  case pattern::installed:
+	  case pattern::new_tp:
+	  case pattern::obsolete:
+	  case pattern::true_tp:
+	  case pattern::upgradable:
+	  case pattern::virtual_tp:
+	    break;
+	  }
+      }
+
+      /** \brief Reads back the output of encode_pattern(). */
+      class binary_reader
+      {
+	const std::string &data;
+	std::string::size_type pos;
+
+	// The number of ?for terms around the term being read, used
+	// to check the stack positions of ?bind and ?=.
+	std::size_t num_variables;
+
+	static void bad_encoding(const std::string &msg)
+	{
+	  throw MatchingException("Invalid binary pattern: " + msg);
+	}
+
+	std::size_t get_number(std::size_t max)
+	{
+	  std::size_t rval = 0;
+	  unsigned int shift = 0;
+	  unsigned char c;
+
+	  do
+	    {
+	      if(shift >= sizeof(std::size_t) * 8)
+		bad_encoding("number out of range.");
+
+	      c = get_byte();
+	      rval |= static_cast<std::size_t>(c & 0x7f) << shift;
+	      shift += 7;
+	    } while(c & 0x80);
+
+	  if(rval > max)
+	    bad_encoding("number out of range.");
+
+	  return rval;
+	}
+
+	std::string get_string()
+	{
+	  const std::size_t len = get_number(std::numeric_limits<std::size_t>::max());
+	  if(len > data.size() - pos)
+	    bad_encoding("unexpected end of data.");
+
+	  std::string rval(data, pos, len);
+	  pos += len;
+	  return rval;
+	}
+
+	pkgCache::Dep::DepType get_deptype()
+	{
+	  const std::size_t rval = get_number(pkgCache::Dep::Enhances);
+	  if(rval < pkgCache::Dep::Depends)
+	    bad_encoding("bad dependency type.");
+
+	  return static_cast<pkgCache::Dep::DepType>(rval);
+	}
+
+	std::vector<ref_ptr<pattern> > get_pattern_list()
+	{
+	  const std::size_t count = get_number(data.size() - pos);
+	  std::vector<ref_ptr<pattern> > rval;
+	  rval.reserve(count);
+	  for(std::size_t i = 0; i < count; ++i)
+	    rval.push_back(get_pattern());
+
+	  return rval;
+	}
+
+      public:
+	explicit binary_reader(const std::string &_data)
+	  : data(_data), pos(0), num_variables(0)
+	{
+	}
+
+	bool at_end() const
+	{
+	  return pos == data.size();
+	}
+
+	unsigned char get_byte()
+	{
+	  if(pos >= data.size())
+	    bad_encoding("unexpected end of data.");
+
+	  return data[pos++];
+	}
+
+	ref_ptr<pattern> get_pattern()
+	{
+	  const pattern::type tp =
+	    static_cast<pattern::type>(get_number(pattern::widen));
+
+	  switch(tp)
+	    {
+	    case pattern::archive:
+	      return pattern::make_archive(get_string());
+
+	    case pattern::action:
+	      return pattern::make_action(static_cast<pattern::action_type>(get_number(pattern::action_keep)));
+
+	    case pattern::all_versions:
+	      return pattern::make_all_versions(get_pattern());
+
+	    case pattern::any_version:
+	      return pattern::make_any_version(get_pattern());
+
+	    case pattern::architecture:
+	      return pattern::make_architecture(get_string());
+
+	    case pattern::automatic:
+	      return pattern::make_automatic();
+
+	    case pattern::and_tp:
+	      return pattern::make_and(get_pattern_list());
+
+	    case pattern::bind:
+	      {
+		if(num_variables == 0)
+		  bad_encoding("?bind outside ?for.");
+
+		const std::size_t index = get_number(num_variables - 1);
+		return pattern::make_bind(index, get_pattern());
+	      }
+
+	    case pattern::broken:
+	      return pattern::make_broken();
+
+	    case pattern::broken_type:
+	      return pattern::make_broken_type(get_deptype());
+
+	    case pattern::candidate_version:
+	      return pattern::make_candidate_version();
+
+	    case pattern::config_files:
+	      return pattern::make_config_files();
+
+	    case pattern::current_version:
+	      return pattern::make_current_version();
+
+	    case pattern::depends:
+	      {
+		const pkgCache::Dep::DepType deptype = get_deptype();
+		const bool broken = get_number(1) != 0;
+		return pattern::make_depends(deptype, broken, get_pattern());
+	      }
+
+	    case pattern::description:
+	      return pattern::make_description(get_string());
+
+	    case pattern::essential:
+	      return pattern::make_essential();
+
+	    case pattern::equal:
+	      if(num_variables == 0)
+		bad_encoding("?= outside ?for.");
+
+	      return pattern::make_equal(get_number(num_variables - 1));
+
+	    case pattern::exact_name:
+	      return pattern::make_exact_name(get_string());
+
+	    case pattern::false_tp:
+	      return pattern::make_false();
+
+	    case pattern::for_tp:
+	      {
+		const std::string variable_name = get_string();
+		++num_variables;
+		const ref_ptr<pattern> sub = get_pattern();
+		--num_variables;
+		return pattern::make_for(variable_name, sub);
+	      }
+
+	    case pattern::garbage:
+	      return pattern::make_garbage();
+
+	    case pattern::install_version:
+	      return pattern::make_install_version();
+
+	    case pattern::installed:
+	      return pattern::make_installed();
+
+	    case pattern::maintainer:
+	      return pattern::make_maintainer(get_string());
+
+	    case pattern::multiarch:
+	      return pattern::make_multiarch(static_cast<pattern::multiarch_type>(get_number(pattern::multiarch_allowed)));
+
+	    case pattern::name:
+	      return pattern::make_name(get_string());
+
+	    case pattern::narrow:
+	      {
+		const ref_ptr<pattern> filter = get_pattern();
+		return pattern::make_narrow(filter, get_pattern());
+	      }
+
+	    case pattern::new_tp:
+	      return pattern::make_new();
+
+	    case pattern::not_tp:
+	      return pattern::make_not(get_pattern());
+
+	    case pattern::obsolete:
+	      return pattern::make_obsolete();
+
+	    case pattern::or_tp:
+	      return pattern::make_or(get_pattern_list());
+
+	    case pattern::origin:
+	      return pattern::make_origin(get_string());
+
+	    case pattern::priority:
+	      {
+		const std::size_t priority = get_number(pkgCache::State::Extra);
+		if(priority < pkgCache::State::Important)
+		  bad_encoding("bad priority.");
+
+		return pattern::make_priority(static_cast<pkgCache::State::VerPriority>(priority));
+	      }
+
+	    case pattern::provides:
+	      return pattern::make_provides(get_pattern());
+
+	    case pattern::reverse_depends:
+	      {
+		const pkgCache::Dep::DepType deptype = get_deptype();
+		const bool broken = get_number(1) != 0;
+		return pattern::make_reverse_depends(deptype, broken, get_pattern());
+	      }
+
+	    case pattern::reverse_provides:
+	      return pattern::make_reverse_provides(get_pattern());
+
+	    case pattern::section:
+	      return pattern::make_section(get_string());
+
+	    case pattern::source_package:
+	      return pattern::make_source_package(get_string());
+
+	    case pattern::source_version:
+	      return pattern::make_source_version(get_string());
+
+	    case pattern::tag:
+	      return pattern::make_tag(get_string());
+
+	    case pattern::task:
+	      return pattern::make_task(get_string());
+
+	    case pattern::term:
+	      return pattern::make_term(get_string());
+
+	    case pattern::term_prefix:
+	      return pattern::make_term_prefix(get_string());
+
+	    case pattern::true_tp:
+	      return pattern::make_true();
+
+	    case pattern::upgradable:
+	      return pattern::make_upgradable();
+
+	    case pattern::user_tag:
+	      return pattern::make_user_tag(get_string());
+
+	    case pattern::version:
+	      return pattern::make_version(get_string());
+
+	    case pattern::virtual_tp:
+	      return pattern::make_virtual();
+
+	    case pattern::widen:
+	      return pattern::make_widen(get_pattern());
+	    }
+
+	  bad_encoding("unknown term type.");
+	  return ref_ptr<pattern>();
+	}
+      };
+    }
+
+    void serialize_pattern_binary(const ref_ptr<pattern> &p,
+				  std::string &out)
+    {
+      string_sink sink(out);
+      sink.put_byte(binary_format_version);
+      encode_pattern(p, sink);
+    }
+
+    ref_ptr<pattern> deserialize_pattern_binary(const std::string &data)
+    {
+      binary_reader reader(data);
+
+      if(reader.get_byte() != binary_format_version)
+	throw MatchingException("Invalid binary pattern: unsupported format version.");
+
+      ref_ptr<pattern> rval(reader.get_pattern());
+
+      if(!reader.at_end())
+	throw MatchingException("Invalid binary pattern: trailing data.");
+
+      return rval;
+    }
+
+    std::size_t hash_pattern(const ref_ptr<pattern> &p)
+    {
+      hash_sink sink;
+      encode_pattern(p, sink);
+      return sink.get_hash();
+    }
   }
 }
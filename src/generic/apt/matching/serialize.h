@@ -24,6 +24,7 @@
 
 #include <cwidget/generic/util/ref_ptr.h>
 
+#include <cstddef>
 #include <iostream>
 #include <string>
 
@@ -63,6 +64,45 @@ namespace aptitude
      *  \param p   The pattern to serialize.
      */
     std::string serialize_pattern(const cwidget::util::ref_ptr<pattern> &p);
+
+    /** \brief Append a compact binary encoding of the given pattern
+     *  to a string.
+     *
+     *  The encoding can be turned back into a pattern by
+     *  deserialize_pattern_binary() without going through the
+     *  parser, which makes it suitable for state that aptitude saves
+     *  and reloads itself.  Patterns in files that users edit should
+     *  keep using the text form.
+     *
+     *  Regular expressions are stored as their source text; they are
+     *  always compiled with the same flags, so that's all that's
+     *  needed to rebuild them.
+     *
+     *  \param p   The pattern to serialize.
+     *  \param out Where to append the encoding.  It can contain
+     *             any byte, including NUL.
+     */
+    void serialize_pattern_binary(const cwidget::util::ref_ptr<pattern> &p,
+				  std::string &out);
+
+    /** \brief Rebuild a pattern from the output of
+     *  serialize_pattern_binary().
+     *
+     *  \throw MatchingException if data isn't a complete encoding of
+     *  a pattern, or was written by an incompatible version of
+     *  aptitude, or if one of its regular expressions fails to
+     *  compile.
+     */
+    cwidget::util::ref_ptr<pattern>
+    deserialize_pattern_binary(const std::string &data);
+
+    /** \brief Compute a hash code for a pattern.
+     *
+     *  Patterns that compare_patterns() considers equal have the same
+     *  hash code, so this can be used to key a hash table on the
+     *  structure of patterns rather than on their identity.
+     */
+    std::size_t hash_pattern(const cwidget::util::ref_ptr<pattern> &p);
   }
 }
 
@@ -0,0 +1,185 @@
+// package_state_snapshot.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "package_state_snapshot.h"
+
+#include "aptcache.h"
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    bool package_state_snapshot::package_state::operator==(const package_state &other) const
+    {
+      return
+	current_ver == other.current_ver &&
+	candidate_ver == other.candidate_ver &&
+	install_ver == other.install_ver &&
+	mode == other.mode &&
+	flags == other.flags &&
+	iflags == other.iflags &&
+	dep_state == other.dep_state &&
+	selection_state == other.selection_state &&
+	aptitude_flags == other.aptitude_flags;
+    }
+
+    unsigned int package_state_snapshot::compare_states(const package_state &s1,
+							const package_state &s2)
+    {
+      unsigned int rval = 0;
+
+      if(s1.current_ver != s2.current_ver ||
+	 s1.candidate_ver != s2.candidate_ver ||
+	 s1.install_ver != s2.install_ver)
+	rval |= changed_versions;
+      if(s1.mode != s2.mode || s1.iflags != s2.iflags)
+	rval |= changed_mode;
+      if(s1.flags != s2.flags)
+	rval |= changed_flags;
+      if(s1.dep_state != s2.dep_state)
+	rval |= changed_dep_state;
+      if(s1.selection_state != s2.selection_state)
+	rval |= changed_selection;
+      if(s1.aptitude_flags != s2.aptitude_flags)
+	rval |= changed_aptitude_flags;
+
+      return rval;
+    }
+
+    void package_state_snapshot::read_state(aptitudeDepCache &cache,
+					    const pkgCache::PkgIterator &pkg,
+					    package_state &out)
+    {
+      const pkgDepCache::StateCache &state = cache[pkg];
+      const aptitudeDepCache::aptitude_state &ext_state =
+	cache.get_ext_state(pkg);
+
+      out.current_ver =
+	pkg.CurrentVer().end() ? no_version : pkg.CurrentVer()->ID;
+      out.candidate_ver =
+	state.CandidateVer == NULL ? no_version : state.CandidateVer->ID;
+      out.install_ver =
+	state.InstallVer == NULL ? no_version : state.InstallVer->ID;
+      out.mode = state.Mode;
+      out.flags = state.Flags;
+      out.iflags = state.iFlags;
+      out.dep_state = state.DepState;
+      out.selection_state = ext_state.selection_state;
+
+      out.aptitude_flags = 0;
+      if(ext_state.new_package)
+	out.aptitude_flags |= flag_new;
+      if(ext_state.reinstall)
+	out.aptitude_flags |= flag_reinstall;
+      if(ext_state.tagged)
+	out.aptitude_flags |= flag_tagged;
+      if(ext_state.flagged)
+	out.aptitude_flags |= flag_flagged;
+      if(ext_state.remove_reason == aptitudeDepCache::unused)
+	out.aptitude_flags |= flag_unused_remove;
+    }
+
+    boost::shared_ptr<const package_state_snapshot>
+    package_state_snapshot::create(aptitudeDepCache &cache,
+				   const boost::shared_ptr<const package_state_snapshot> &previous)
+    {
+      const std::size_t num_packages = cache.Head().PackageCount;
+      const bool can_share =
+	previous.get() != NULL && previous->num_packages == num_packages;
+
+      boost::shared_ptr<package_state_snapshot> rval(new package_state_snapshot(num_packages,
+										previous.get() == NULL ? 1 : previous->generation + 1));
+      rval->chunks.reserve((num_packages + chunk_size - 1) / chunk_size);
+
+      // Each chunk is read into a scratch buffer and compared against
+      // the previous snapshot; it's only copied if something in it
+      // changed, so marking a package costs one chunk of memory.
+      chunk current;
+      current.reserve(chunk_size);
+      bool changed = !can_share;
+
+      pkgCache &pkg_cache(cache.GetCache());
+      for(std::size_t start = 0; start < num_packages; start += chunk_size)
+	{
+	  const std::size_t end = std::min(num_packages, start + chunk_size);
+
+	  current.resize(end - start);
+	  for(std::size_t id = start; id < end; ++id)
+	    read_state(cache,
+		       pkgCache::PkgIterator(pkg_cache, pkg_cache.PkgP + id),
+		       current[id - start]);
+
+	  const std::size_t chunk_num = start / chunk_size;
+	  if(can_share && *previous->chunks[chunk_num] == current)
+	    rval->chunks.push_back(previous->chunks[chunk_num]);
+	  else
+	    {
+	      rval->chunks.push_back(boost::make_shared<chunk>(current));
+	      changed = true;
+	    }
+	}
+
+      if(!changed)
+	return previous;
+      else
+	return rval;
+    }
+
+    void package_state_snapshot::find_changes(const package_state_snapshot &other,
+					      std::vector<unsigned long> &out,
+					      std::vector<unsigned int> *masks) const
+    {
+      const std::size_t shared_packages = std::min(num_packages, other.num_packages);
+
+      for(std::size_t chunk_num = 0;
+	  chunk_num * chunk_size < shared_packages; ++chunk_num)
+	{
+	  const chunk &mine(*chunks[chunk_num]);
+	  const chunk &theirs(*other.chunks[chunk_num]);
+	  if(&mine == &theirs)
+	    continue;
+
+	  const std::size_t start = chunk_num * chunk_size;
+	  const std::size_t end = std::min(shared_packages, start + chunk_size);
+	  for(std::size_t id = start; id < end; ++id)
+	    {
+	      const unsigned int mask =
+		compare_states(mine[id - start], theirs[id - start]);
+	      if(mask != 0)
+		{
+		  out.push_back(id);
+		  if(masks != NULL)
+		    masks->push_back(mask);
+		}
+	    }
+	}
+
+      for(std::size_t id = shared_packages; id < std::max(num_packages, other.num_packages); ++id)
+	{
+	  out.push_back(id);
+	  if(masks != NULL)
+	    masks->push_back(changed_all);
+	}
+    }
+  }
+}
@@ -0,0 +1,237 @@
+// package_state_snapshot.h                          -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef PACKAGE_STATE_SNAPSHOT_H
+#define PACKAGE_STATE_SNAPSHOT_H
+
+#include <apt-pkg/pkgcache.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+/** \file package_state_snapshot.h
+ *
+ *  An immutable copy of the state of every package, for code that
+ *  runs outside the thread that owns the cache.
+ *
+ *  The depcache is modified in place by the main thread, so a
+ *  background thread can't safely read it.  Instead, the cache
+ *  publishes a new snapshot at the end of each action group; a
+ *  background thread grabs the current snapshot once and can then
+ *  read it without locks for as long as it likes, while the main
+ *  thread goes on marking packages.
+ *
+ *  Snapshots are stored as fixed-size chunks of packages, and a new
+ *  snapshot shares every chunk in which nothing changed with the one
+ *  before it, so publishing after marking a few packages only copies
+ *  a few chunks.
+ */
+
+class aptitudeDepCache;
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief The state of every package at one moment. */
+    class package_state_snapshot
+    {
+    public:
+      /** \brief The state of one package. */
+      struct package_state
+      {
+	/** \brief The ID of the current version, or no_version. */
+	unsigned long current_ver;
+
+	/** \brief The ID of the candidate version, or no_version. */
+	unsigned long candidate_ver;
+
+	/** \brief The ID of the version that will be installed, or
+	 *  no_version.
+	 */
+	unsigned long install_ver;
+
+	/** \brief The depcache mode (pkgDepCache::ModeDelete, ModeKeep
+	 *  or ModeInstall).
+	 */
+	unsigned char mode;
+
+	/** \brief The depcache flags (pkgCache::Flag). */
+	unsigned short flags;
+
+	/** \brief The internal depcache flags (pkgDepCache::InternalFlags). */
+	unsigned short iflags;
+
+	/** \brief The dependency state (pkgDepCache::DepStateFlags). */
+	unsigned char dep_state;
+
+	/** \brief The aptitude selection state
+	 *  (pkgCache::State::PkgSelectedState).
+	 */
+	unsigned char selection_state;
+
+	/** \brief aptitude's per-package flags (package_state_flags). */
+	unsigned char aptitude_flags;
+
+	bool operator==(const package_state &other) const;
+	bool operator!=(const package_state &other) const
+	{
+	  return !(*this == other);
+	}
+      };
+
+      /** \brief Values of package_state::aptitude_flags. */
+      enum package_state_flags
+	{
+	  flag_new = 0x1,
+	  flag_reinstall = 0x2,
+	  flag_tagged = 0x4,
+	  flag_flagged = 0x8,
+	  /** \brief Set if the package is being removed because it is
+	   *  unused.
+	   */
+	  flag_unused_remove = 0x10
+	};
+
+      /** \brief Bits describing which parts of a package's state
+       *  differ between two snapshots.
+       */
+      enum state_change
+	{
+	  /** \brief The current, candidate or install version. */
+	  changed_versions = 0x1,
+	  /** \brief The depcache mode or internal flags. */
+	  changed_mode = 0x2,
+	  /** \brief The depcache flags (e.g., Auto). */
+	  changed_flags = 0x4,
+	  /** \brief The dependency state. */
+	  changed_dep_state = 0x8,
+	  /** \brief The selection state. */
+	  changed_selection = 0x10,
+	  /** \brief aptitude's per-package flags. */
+	  changed_aptitude_flags = 0x20,
+
+	  /** \brief Every bit; used for packages that only exist in
+	   *  one of the snapshots.
+	   */
+	  changed_all = 0x3f
+	};
+
+      /** \brief Find out which parts of two package states differ.
+       *
+       *  \return a combination of state_change bits, or 0 if the
+       *  states are equal.
+       */
+      static unsigned int compare_states(const package_state &s1,
+					 const package_state &s2);
+
+      /** \brief The version ID used when there is no version. */
+      static const unsigned long no_version = (unsigned long)-1;
+
+    private:
+      /** \brief The number of packages in each chunk. */
+      static const std::size_t chunk_size = 1024;
+
+      typedef std::vector<package_state> chunk;
+
+      std::vector<boost::shared_ptr<const chunk> > chunks;
+      std::size_t num_packages;
+      unsigned long generation;
+
+      package_state_snapshot(std::size_t _num_packages,
+			     unsigned long _generation)
+	: num_packages(_num_packages), generation(_generation)
+      {
+      }
+
+      /** \brief Read the current state of a package from the cache. */
+      static void read_state(aptitudeDepCache &cache,
+			     const pkgCache::PkgIterator &pkg,
+			     package_state &out);
+
+    public:
+      /** \brief Take a snapshot of every package in the cache.
+       *
+       *  Must be invoked from the thread that owns the cache.
+       *
+       *  \param cache     The cache to read.
+       *  \param previous  If valid, a snapshot of the same cache to
+       *                   share unchanged chunks with.  If nothing
+       *                   changed at all, previous itself is returned.
+       */
+      static boost::shared_ptr<const package_state_snapshot>
+      create(aptitudeDepCache &cache,
+	     const boost::shared_ptr<const package_state_snapshot> &previous);
+
+      /** \brief Get the number of this snapshot.
+       *
+       *  Each snapshot published by a cache has a larger number than
+       *  the one before it, so two snapshots with the same number
+       *  are the same snapshot.
+       */
+      unsigned long get_generation() const { return generation; }
+
+      /** \brief Get the number of packages in this snapshot. */
+      std::size_t size() const { return num_packages; }
+
+      /** \brief Estimate the memory used by this snapshot, counting
+       *  chunks that are shared with other snapshots.
+       */
+      std::size_t memory_usage() const
+      {
+	return sizeof(*this) +
+	  chunks.capacity() * sizeof(chunks[0]) +
+	  chunks.size() * (sizeof(chunk) + chunk_size * sizeof(package_state));
+      }
+
+      /** \brief Get the state of the package with the given ID. */
+      const package_state &get(unsigned long id) const
+      {
+	return (*chunks[id / chunk_size])[id % chunk_size];
+      }
+
+      const package_state &get(const pkgCache::PkgIterator &pkg) const
+      {
+	return get(pkg->ID);
+      }
+
+      /** \brief Find the packages whose state differs between this
+       *  snapshot and another snapshot of the same cache.
+       *
+       *  Chunks that the two snapshots share are skipped, so this is
+       *  cheap when few packages changed.
+       *
+       *  \param other  The snapshot to compare against.
+       *  \param out    A vector to which the IDs of the packages that
+       *                changed are appended, in increasing order.
+       *  \param masks  If not NULL, a vector to which the
+       *                state_change bits of each package in out are
+       *                appended.
+       */
+      void find_changes(const package_state_snapshot &other,
+			std::vector<unsigned long> &out,
+			std::vector<unsigned int> *masks = NULL) const;
+    };
+
+    typedef boost::shared_ptr<const package_state_snapshot> package_state_snapshot_ptr;
+  }
+}
+
+#endif // PACKAGE_STATE_SNAPSHOT_H
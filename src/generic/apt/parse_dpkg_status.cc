@@ -22,6 +22,7 @@
 #include <aptitude.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 namespace aptitude
 {
@@ -29,9 +30,35 @@ namespace aptitude
   {
     namespace
     {
+      /** \brief A piece of a status line, left where it lies in the
+       *  input buffer.
+       *
+       *  Pieces are only copied into strings once it is known that
+       *  they end up in the parsed message.
+       */
+      struct text_range
+      {
+	const char *begin;
+	const char *end;
+
+	text_range(const char *_begin, const char *_end)
+	  : begin(_begin), end(_end)
+	{
+	}
+
+	bool operator==(const char *s) const
+	{
+	  const std::size_t len = strlen(s);
+	  return static_cast<std::size_t>(end - begin) == len &&
+	    memcmp(begin, s, len) == 0;
+	}
+
+	std::string str() const { return std::string(begin, end); }
+      };
+
       // Status constants.
-      const std::string status_pmerror("pmerror");
-      const std::string status_pmconffile("pmconffile");
+      const char * const status_pmerror = "pmerror";
+      const char * const status_pmconffile = "pmconffile";
 
       // Parses [[:space:]]* and returns the next character.
       const char *parse_whitespace(const char * &start,
@@ -44,8 +71,8 @@ namespace aptitude
       }
 
       // Parses [^:]*:, stripping whitespace and returning the text.
-      std::string parse_colon_fragment(const char * &start,
-				       const char * const end)
+      text_range parse_colon_fragment(const char * &start,
+				      const char * const end)
       {
 	const char * const begin = parse_whitespace(start, end);
 
@@ -59,11 +86,11 @@ namespace aptitude
 	while(last != begin && isspace(last[-1]))
 	  --last;
 
-	return std::string(begin, last);
+	return text_range(begin, last);
       }
 
       // Parses '[^']', returning the enclosed text.
-      std::string parse_single_quoted_string(const char * start,
+      std::string parse_single_quoted_string(const char * &start,
 					     const char * const end)
       {
 	parse_whitespace(start, end);
@@ -85,14 +112,30 @@ namespace aptitude
 	return std::string(rval_begin, rval_end);
       }
 
-      std::string strip_range(const char *begin, const char *end)
+      text_range strip_range(const char *begin, const char *end)
       {
 	while(begin < end && isspace(*begin))
 	  ++begin;
 	while(end > begin && isspace(end[-1]))
 	  --end;
 
-	return std::string(begin, end);
+	return text_range(begin, end);
+      }
+
+      // The input isn't NUL-terminated, so the number is copied to
+      // the stack before strtod() sees it.  Anything too long to be
+      // a percentage parses as zero.
+      double parse_percent(const text_range &r)
+      {
+	char buf[32];
+	const std::size_t len = r.end - r.begin;
+	if(len >= sizeof(buf))
+	  return 0;
+
+	memcpy(buf, r.begin, len);
+	buf[len] = '\0';
+
+	return strtod(buf, NULL);
       }
     }
 
@@ -143,57 +186,49 @@ namespace aptitude
       const char *where = buf;
 
       // First find out what type of message it is.
-      const std::string status(parse_colon_fragment(where, end));
+      const text_range status(parse_colon_fragment(where, end));
 
       if(status == status_pmerror)
 	{
 	  // error: pkg: percent: message
 
-	  const std::string pkg(parse_colon_fragment(where, end));
-	  const std::string percent_str(parse_colon_fragment(where, end));
-	  const std::string msg(strip_range(where, end));
+	  const text_range pkg(parse_colon_fragment(where, end));
+	  const text_range percent_str(parse_colon_fragment(where, end));
+	  const text_range msg(strip_range(where, end));
 
-	  char *percent_parse_end;
-	  const double percent = strtod(percent_str.c_str(), &percent_parse_end);
-
-	  return dpkg_status_message::make_error(percent, pkg, msg);
+	  return dpkg_status_message::make_error(parse_percent(percent_str),
+						 pkg.str(), msg.str());
 	}
       else if(status == status_pmconffile)
 	{
 	  // pmconffile: conffile-display-name: percent: 'old-file' 'new-file'
 
-	  const std::string conffile(parse_colon_fragment(where, end));
-	  const std::string percent_str(parse_colon_fragment(where, end));
-	  const std::string msg(strip_range(where, end));
-
-	  char *percent_parse_end;
-	  const double percent = strtod(percent_str.c_str(), &percent_parse_end);
+	  const text_range conffile(parse_colon_fragment(where, end));
+	  const text_range percent_str(parse_colon_fragment(where, end));
 
 	  const std::string old_filename(parse_single_quoted_string(where, end));
 	  const std::string new_filename(parse_single_quoted_string(where, end));
 
 	  return dpkg_status_message::make_conffile(old_filename,
 						    new_filename,
-						    percent,
-						    conffile);
+						    parse_percent(percent_str),
+						    conffile.str());
 	}
       else
 	{
 	  // (status): pkg: percent: message
 
-	  const std::string package(parse_colon_fragment(where, end));
-	  const std::string percent_str(parse_colon_fragment(where, end));
-	  const std::string msg(strip_range(where, end));
+	  const text_range package(parse_colon_fragment(where, end));
+	  const text_range percent_str(parse_colon_fragment(where, end));
+	  const text_range msg(strip_range(where, end));
 
-	  char *percent_parse_end;
-	  const double percent = strtod(percent_str.c_str(), &percent_parse_end);
-
-	  return dpkg_status_message::make_status(percent, package, msg);
+	  return dpkg_status_message::make_status(parse_percent(percent_str),
+						  package.str(), msg.str());
 	}
     }
 
     dpkg_status_parser::dpkg_status_parser()
-      : msg()
+      : partial_line()
     {
     }
 
@@ -202,21 +237,31 @@ namespace aptitude
       const char *begin = buf;
       const char * const end = buf + len;
 
-      const char *where = begin;
-
-      while(where < end)
+      while(begin < end)
 	{
-	  while(where < end && *where != '\n')
-	    ++where;
-
-	  msg.append(begin, where);
-	  pending_messages.push_back(dpkg_status_message::parse(msg.c_str(), msg.size()));
-	  msg.clear();
-
-	  if(where < end)
-	    ++where;
-
-	  begin = where;
+	  const char *newline =
+	    static_cast<const char *>(memchr(begin, '\n', end - begin));
+
+	  if(newline == NULL)
+	    {
+	      // Wait for the rest of the line.
+	      partial_line.append(begin, end);
+	      return;
+	    }
+
+	  if(partial_line.empty())
+	    pending_messages.push_back(dpkg_status_message::parse(begin, newline - begin));
+	  else
+	    {
+	      partial_line.append(begin, newline);
+	      pending_messages.push_back(dpkg_status_message::parse(partial_line.c_str(),
+								    partial_line.size()));
+	      // clear() keeps the allocated space for the next split
+	      // line.
+	      partial_line.clear();
+	    }
+
+	  begin = newline + 1;
 	}
     }
   }
@@ -85,6 +85,7 @@ namespace aptitude
 	  existing_filename(_existing_filename),
 	  new_filename(_new_filename),
 	  percent(_percent),
+	  package(_package),
 	  text(_text)
       {
       }
@@ -184,13 +185,20 @@ namespace aptitude
     // Dump a status message for debugging purposes.
     std::ostream &operator<<(std::ostream &out, const dpkg_status_message &mgs);
 
-    /** \brief A parser for the dpkg status pipe. */
+    /** \brief A parser for the dpkg status pipe.
+     *
+     *  Complete lines are parsed where they lie in the buffer passed
+     *  to process_input(); only a line that is split across two
+     *  reads is copied, into a buffer that is kept between calls so
+     *  that it stops being reallocated once it has grown to the
+     *  length of the longest line dpkg writes.
+     */
     class dpkg_status_parser
     {
-      /** \brief The parser's hidden state -- stores all the text
-       *  since the last newline.
+      /** \brief The parser's hidden state -- stores the text since
+       *  the last newline, if it has not been terminated yet.
        */
-      std::string msg;
+      std::string partial_line;
 
       std::deque<dpkg_status_message> pending_messages;
 
@@ -219,6 +227,10 @@ namespace aptitude
       }
 
       /** \brief Feed the given character buffer into the parser.
+       *
+       *  A message is parsed once the newline that ends it has been
+       *  read; any text after the last newline is held until the
+       *  rest of its line arrives.
        *
        *  \param buf   The character buffer containing data from the
        *               dpkg status pipe.
@@ -22,6 +22,7 @@
 #include "apt.h"
 #include "download_queue.h"
 
+#include <generic/util/file_cache.h>
 #include <generic/util/job_queue_thread.h>
 
 #include <aptitude.h>
@@ -35,6 +36,7 @@
 #include <sys/stat.h>
 
 #include <deque>
+#include <set>
 
 #include <sigc++/bind.h>
 
@@ -57,6 +59,12 @@ namespace aptitude
   {
     namespace
     {
+      // Where changelogs are fetched from if they aren't on the
+      // system.  The rest of the URI names the source version, so
+      // the file at a given URI never changes.
+      const char changelog_pool_uri_prefix[] =
+	"http://packages.debian.org/changelogs/pool/";
+
       // Hack to attempt to suppress an unnecessary apt error in the case
       // that there aren't any source records.
       bool source_lines_exist()
@@ -81,6 +89,44 @@ namespace aptitude
 
 	return false;
       }
+
+      /** \brief Build the URI of a changelog on packages.debian.org. */
+      std::string get_changelog_pool_uri(const changelog_info &info)
+      {
+	const string &source_package(info.get_source_package());
+	const string &source_version(info.get_source_version());
+	const string &section(info.get_section());
+
+	string realsection;
+
+	if(section.find('/') != section.npos)
+	  realsection.assign(section, 0, section.find('/'));
+	else
+	  realsection.assign("main");
+
+	string prefix;
+
+	if(source_package.size() > 3 &&
+	   source_package[0] == 'l' && source_package[1] == 'i' && source_package[2] == 'b')
+	  prefix = std::string("lib") + source_package[3];
+	else
+	  prefix = source_package[0];
+
+	string realver;
+
+	if(source_version.find(':') != source_version.npos)
+	  realver.assign(source_version, source_version.find(':') + 1, source_version.npos);
+	else
+	  realver = source_version;
+
+	return changelog_pool_uri_prefix +
+	  cw::util::ssprintf("%s/%s/%s/%s_%s/changelog",
+			     realsection.c_str(),
+			     prefix.c_str(),
+			     source_package.c_str(),
+			     source_package.c_str(),
+			     realver.c_str());
+      }
     }
 
     boost::shared_ptr<changelog_info>
@@ -170,6 +216,43 @@ namespace aptitude
 	// object.
 	std::string short_description;
 
+	/** \brief Start fetching the given URI.
+	 *
+	 *  If the URI is for a changelog on packages.debian.org and it's
+	 *  already in the download cache, the cached copy is used.  The
+	 *  download queue would ask the server whether a cached file has
+	 *  changed, but these files never do.
+	 *
+	 *  Must be invoked with state_mutex held.
+	 */
+	void queue_uri(const std::string &uri)
+	{
+	  if(download_cache.get() != NULL &&
+	     uri.compare(0, sizeof(changelog_pool_uri_prefix) - 1,
+			 changelog_pool_uri_prefix) == 0)
+	    {
+	      const temp::name cached_filename = download_cache->getItem(uri);
+	      if(cached_filename.valid())
+		{
+		  LOG_INFO(Loggers::getAptitudeChangelog(),
+			   "Using the cached copy of " << uri
+			   << " for " << short_description);
+
+		  current_download.reset();
+
+		  sigc::slot<void> success_thunk =
+		    sigc::bind(sigc::mem_fun(*this, &changelog_download::success),
+			       cached_filename);
+		  post_thunk(make_keepalive_slot(success_thunk, shared_from_this()));
+		  return;
+		}
+	    }
+
+	  current_download = queue_download(uri, short_description,
+					    shared_from_this(),
+					    post_thunk);
+	}
+
       public:
 	changelog_download(const boost::shared_ptr<download_callbacks> &_parent,
 			   post_thunk_f _post_thunk,
@@ -219,9 +302,7 @@ namespace aptitude
 		       "Enqueuing the first URI for "
 		       << short_description << ": " << uri);
 
-	      current_download = queue_download(uri, short_description,
-						shared_from_this(),
-						post_thunk);
+	      queue_uri(uri);
 	      started = true;
 	    }
 	}
@@ -293,9 +374,7 @@ namespace aptitude
 			 "Falling back to the next URI for "
 			 << short_description << ": " << uri);
 
-		current_download = queue_download(uri, short_description,
-						  shared_from_this(),
-						  post_thunk);
+		queue_uri(uri);
 	      }
 
 	      uris.pop_front();
@@ -436,7 +515,6 @@ namespace aptitude
 
 	  const string source_package(info.get_source_package());
 	  const string source_version(info.get_source_version());
-	  const string section(info.get_section());
 	  const string name(info.get_display_name());
 	  const string short_description = cw::util::ssprintf(_("ChangeLog of %s"), name.c_str());
 
@@ -520,34 +598,7 @@ namespace aptitude
 		      }
 		}
 
-	      string realsection;
-
-	      if(section.find('/') != section.npos)
-		realsection.assign(section, 0, section.find('/'));
-	      else
-		realsection.assign("main");
-
-	      string prefix;
-
-	      if(source_package.size() > 3 &&
-		 source_package[0] == 'l' && source_package[1] == 'i' && source_package[2] == 'b')
-		prefix = std::string("lib") + source_package[3];
-	      else
-		prefix = source_package[0];
-
-	      string realver;
-
-	      if(source_version.find(':') != source_version.npos)
-		realver.assign(source_version, source_version.find(':') + 1, source_version.npos);
-	      else
-		realver = source_version;
-
-	      string uri = cw::util::ssprintf("http://packages.debian.org/changelogs/pool/%s/%s/%s/%s_%s/changelog",
-					      realsection.c_str(),
-					      prefix.c_str(),
-					      source_package.c_str(),
-					      source_package.c_str(),
-					      realver.c_str());
+	      const string uri = get_changelog_pool_uri(info);
 	      LOG_TRACE(logger,
 			"Adding " << uri
 			<< " as a URI for the changelog of " << source_package << " " << source_version);
@@ -633,5 +684,82 @@ get_changelog(const pkgCache::VerIterator &ver,
 		       boost::make_shared<slot_callbacks>(success, failure),
 		       post_thunk);
 }
+
+namespace
+{
+  /** \brief Callbacks for a changelog that is only being fetched
+   *  into the download cache.
+   */
+  class prefetch_callbacks : public download_callbacks
+  {
+    std::string uri;
+
+  public:
+    prefetch_callbacks(const std::string &_uri)
+      : uri(_uri)
+    {
+    }
+
+    void success(const temp::name &n)
+    {
+      LOG_TRACE(Loggers::getAptitudeChangelog(),
+		"Prefetched " << uri);
+    }
+
+    void failure(const std::string &msg)
+    {
+      LOG_DEBUG(Loggers::getAptitudeChangelog(),
+		"Failed to prefetch " << uri << ": " << msg);
+    }
+  };
+
+  // The URIs that were already prefetched by this process.  Only
+  // accessed from the foreground thread.
+  std::set<std::string> prefetched_uris;
+}
+
+void prefetch_upgrade_changelogs(post_thunk_f post_thunk)
+{
+  if(!aptcfg->FindB(PACKAGE "::Changelog-Prefetch", false))
+    return;
+
+  if(apt_cache_file == NULL || download_cache.get() == NULL)
+    return;
+
+  int num_queued = 0;
+
+  for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+      !pkg.end(); ++pkg)
+    {
+      pkgDepCache::StateCache &state((*apt_cache_file)[pkg]);
+
+      if(pkg.CurrentVer().end() || !state.Upgrade())
+	continue;
+
+      // The installed changelog is for the old version, so the new
+      // one has to come from packages.debian.org.
+      boost::shared_ptr<changelog_info> info =
+	changelog_info::create(state.InstVerIter(*apt_cache_file));
+      if(info.get() == NULL)
+	continue;
+
+      const std::string uri = get_changelog_pool_uri(*info);
+      if(!prefetched_uris.insert(uri).second)
+	continue;
+
+      const std::string short_description =
+	cw::util::ssprintf(_("Changelog of %s"), info->get_display_name().c_str());
+
+      queue_download(uri, short_description,
+		     boost::make_shared<prefetch_callbacks>(uri),
+		     post_thunk,
+		     download_priority_low);
+      ++num_queued;
+    }
+
+  if(num_queued > 0)
+    LOG_INFO(Loggers::getAptitudeChangelog(),
+	     "Prefetching the changelogs of " << num_queued << " upgraded packages.");
+}
 }
 }
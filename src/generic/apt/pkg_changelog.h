@@ -131,6 +131,22 @@ namespace aptitude
 		  post_thunk_f post_thunk,
 		  const sigc::slot<void, temp::name> &success,
 		  const sigc::slot<void, std::string> &failure);
+
+    /** \brief Start fetching the changelogs of every package that is
+     *  about to be upgraded into the download cache.
+     *
+     *  This does nothing unless Aptitude::Changelog-Prefetch is
+     *  enabled.  The changelogs are downloaded at low priority, so
+     *  they don't delay anything the user asks for; once they are in
+     *  the cache, get_changelog() returns them without going to the
+     *  network.  Changelogs that were already prefetched are skipped,
+     *  so this can be called every time a preview is shown.
+     *
+     *  Must be invoked from the foreground thread.
+     *
+     *  \param post_thunk How to post thunks to the foreground thread.
+     */
+    void prefetch_upgrade_changelogs(post_thunk_f post_thunk);
   }
 }
 
@@ -40,6 +40,39 @@ void pkg_hier::visit_group(pkg_hier::group *group, void *parent_data,
     }
 }
 
+void pkg_hier::index_parents(pkg_hier::item &it)
+{
+  it.parents_begin=parent_ids.size();
+
+  for(std::set<string>::iterator i=it.parents.begin();
+      i!=it.parents.end(); ++i)
+    {
+      groupmap::iterator found=groups.find(*i);
+
+      if(found!=groups.end())
+	parent_ids.push_back(found->second.id);
+    }
+
+  it.parents_end=parent_ids.size();
+}
+
+void pkg_hier::build_index()
+{
+  groups_by_id.assign(max_group_id, NULL);
+  parent_ids.clear();
+
+  for(groupmap::iterator i=groups.begin(); i!=groups.end(); ++i)
+    {
+      groups_by_id[i->second.id]=&i->second;
+      index_parents(i->second);
+    }
+
+  for(pkgmap::iterator i=pkgs.begin(); i!=pkgs.end(); ++i)
+    index_parents(i->second);
+
+  indexed=true;
+}
+
 void pkg_hier::realize_group_up(pkg_hier::group *group,
 				pkg_hier::hierarchy_realizer *realizer)
 {
@@ -56,23 +89,20 @@ void pkg_hier::realize_group_up(pkg_hier::group *group,
 	  if(group->parents.empty())
 	    info->node_data.push_back(realizer->realize_group(group, NULL));
 	  else
-	    for(std::set<string>::iterator i=group->parents.begin();
-		i!=group->parents.end(); ++i)
+	    for(vector<int>::size_type i=group->parents_begin;
+		i!=group->parents_end; ++i)
 	      {
-		groupmap::iterator found=groups.find(*i);
+		pkg_hier::group *parent=groups_by_id[parent_ids[i]];
 
-		if(found!=groups.end())
-		  {
-		    // The group exists; realize it and then realize
-		    // ourselves based on it.
-		    realize_group_up(&found->second, realizer);
+		// Realize the parent and then realize ourselves based
+		// on it.
+		realize_group_up(parent, realizer);
 
-		    group::build_info *parent_info=realizer->get_build_info(found->second.id);
+		group::build_info *parent_info=realizer->get_build_info(parent->id);
 
-		    for(vector<void *>::iterator j=parent_info->node_data.begin();
-			j!=parent_info->node_data.end(); ++j)
-		      info->node_data.push_back(realizer->realize_group(group, *j));
-		  }
+		for(vector<void *>::iterator j=parent_info->node_data.begin();
+		    j!=parent_info->node_data.end(); ++j)
+		  info->node_data.push_back(realizer->realize_group(group, *j));
 	      }
 
 	  info->seen=true;
@@ -88,21 +118,18 @@ void pkg_hier::realize_item_up(pkg_hier::item *item,
   if(item->parents.empty())
     realizer->realize_item(item, NULL);
   else
-    for(std::set<string>::iterator i=item->parents.begin();
-	i!=item->parents.end(); ++i)
+    for(vector<int>::size_type i=item->parents_begin;
+	i!=item->parents_end; ++i)
       {
-	groupmap::iterator found=groups.find(*i);
+	pkg_hier::group *parent=groups_by_id[parent_ids[i]];
 
-	if(found!=groups.end())
-	  {
-	    realize_group_up(&found->second, realizer);
+	realize_group_up(parent, realizer);
 
-	    group::build_info *info=realizer->get_build_info(found->second.id);
+	group::build_info *info=realizer->get_build_info(parent->id);
 
-	    for(vector<void *>::iterator j=info->node_data.begin();
-		j!=info->node_data.end(); ++j)
-	      realizer->realize_item(item, *j);
-	  }
+	for(vector<void *>::iterator j=info->node_data.begin();
+	    j!=info->node_data.end(); ++j)
+	  realizer->realize_item(item, *j);
       }
 }
 
@@ -112,6 +139,9 @@ bool pkg_hier::realize_item_up(string item, hierarchy_realizer *realizer)
 
   if(found!=pkgs.end())
     {
+      if(!indexed)
+	build_index();
+
       realize_item_up(&found->second, realizer);
       return true;
     }
@@ -147,6 +177,8 @@ void pkg_hier::input_file(string fn)
   pkgTagFile tagfile(&f);
   pkgTagSection section;
 
+  indexed=false;
+
   bool first=true;
   string realm;
 
@@ -260,33 +292,23 @@ void pkg_hier::realize(string grp, void *init_parent_data,
   if(found!=groups.end())
     {
       // Resolve all dangling references (and bail out if we have loops?)
+      if(!indexed)
+	build_index();
 
-      // First, resolve references between groups.
       for(groupmap::iterator i=groups.begin(); i!=groups.end(); ++i)
 	i->second.children.clear();
 
+      // First, resolve references between groups.
       for(groupmap::iterator i=groups.begin(); i!=groups.end(); ++i)
-	for(std::set<string>::iterator j=i->second.parents.begin();
-	    j!=i->second.parents.end();
-	    ++j)
-	  {
-	    groupmap::iterator target=groups.find(*j);
-
-	    if(target!=groups.end())
-	      target->second.children.push_back(&i->second);
-	  }
+	for(vector<int>::size_type j=i->second.parents_begin;
+	    j!=i->second.parents_end; ++j)
+	  groups_by_id[parent_ids[j]]->children.push_back(&i->second);
 
       // Now, resolve references from packages to groups.
       for(pkgmap::iterator i=pkgs.begin(); i!=pkgs.end(); ++i)
-	for(std::set<string>::iterator j=i->second.parents.begin();
-	    j!=i->second.parents.end();
-	    ++j)
-	  {
-	    groupmap::iterator target=groups.find(*j);
-
-	    if(target!=groups.end())
-	      target->second.children.push_back(&i->second);
-	  }
+	for(vector<int>::size_type j=i->second.parents_begin;
+	    j!=i->second.parents_end; ++j)
+	  groups_by_id[parent_ids[j]]->children.push_back(&i->second);
 
       // Now, visit stuff.
       found->second.realize_me(this, init_parent_data, realizer);
@@ -299,6 +321,10 @@ void pkg_hier::clear()
   groups.clear();
 
   max_group_id=0;
+
+  indexed=false;
+  groups_by_id.clear();
+  parent_ids.clear();
 }
 
 pkg_hier::~pkg_hier()
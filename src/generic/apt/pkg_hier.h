@@ -53,6 +53,11 @@ public:
     std::string name;
     std::set<std::string> parents;
 
+    // The IDs of the groups among the parents that exist are
+    // parent_ids[parents_begin] to parent_ids[parents_end-1].  Set up
+    // by build_index().
+    std::vector<int>::size_type parents_begin, parents_end;
+
     // HACK: Used to build the hierarchy top-down.  Calls an appropriate
     // routine in the given hierarchy class.  parent_data is an opaque
     // value which stores data used to build the UI representation of
@@ -61,7 +66,7 @@ public:
 			    pkg_hier::hierarchy_realizer *realizer);
 
     item(std::string _name, std::vector<std::string> &_parents)
-      :name(_name)
+      :name(_name), parents_begin(0), parents_end(0)
     {
       for(std::vector<std::string>::iterator i=_parents.begin();
 	  i!=_parents.end();
@@ -70,11 +75,11 @@ public:
     }
 
     item(std::string _name)
-      :name(_name)
+      :name(_name), parents_begin(0), parents_end(0)
     {
     }
 
-    item() {}
+    item():parents_begin(0), parents_end(0) {}
 
     virtual ~item() {}
   };
@@ -170,6 +175,20 @@ public:
   };
 
 private:
+  // An integer-indexed copy of the links between groups and items, so
+  // that realizing the hierarchy doesn't look parents up by name.
+  // Built the first time the hierarchy is realized after it changes.
+  bool indexed;
+
+  // The groups, indexed by ID.
+  std::vector<group *> groups_by_id;
+
+  // The parent group IDs of every item and group, one range each.
+  std::vector<int> parent_ids;
+
+  void build_index();
+  void index_parents(item &it);
+
   // HACK: I don't like Visitor setups, but I'm in a hurry and it'll
   // be good enough..
   void visit_item(item *item, void *parent_data, hierarchy_realizer *realizer);
@@ -179,7 +198,7 @@ private:
   void realize_group_up(group *group, hierarchy_realizer *realizer);
   void realize_item_up(item *item, hierarchy_realizer *realizer);
 public:
-  pkg_hier():max_group_id(0) {}
+  pkg_hier():max_group_id(0), indexed(false) {}
 
   // Reads the given file and adds it to our database.
   void input_file(std::string fn);
@@ -198,6 +217,10 @@ public:
   // item * pointers!)
   void clear();
 
+  // Must be called after the parents of an item or group are changed
+  // or items are added other than through input_file().
+  void invalidate_index() {indexed=false;}
+
   virtual ~pkg_hier();
 };
 
@@ -0,0 +1,142 @@
+// record_prefetch.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "record_prefetch.h"
+
+#include <aptitude.h>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    namespace
+    {
+      // Records that are closer together than this are read as one
+      // range; reading the gap is cheaper than another seek.
+      const unsigned long merge_gap = 64 * 1024;
+
+      struct record_range
+      {
+	pkgCache::PkgFileIterator file;
+	unsigned long offset;
+	unsigned long size;
+
+	record_range(const pkgCache::PkgFileIterator &_file,
+		     unsigned long _offset,
+		     unsigned long _size)
+	  : file(_file), offset(_offset), size(_size)
+	{
+	}
+
+	bool operator<(const record_range &other) const
+	{
+	  if(file->ID != other.file->ID)
+	    return file->ID < other.file->ID;
+	  else
+	    return offset < other.offset;
+	}
+      };
+
+      void prefetch_range(int fd, unsigned long offset, unsigned long size)
+      {
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+#else
+	(void) fd;
+	(void) offset;
+	(void) size;
+#endif
+      }
+    }
+
+    void prefetch_version_records(const std::vector<pkgCache::VerIterator> &versions,
+				  bool all_files,
+				  bool descriptions)
+    {
+      std::vector<record_range> ranges;
+
+      for(std::vector<pkgCache::VerIterator>::const_iterator it = versions.begin();
+	  it != versions.end(); ++it)
+	{
+	  if(it->end())
+	    continue;
+
+	  for(pkgCache::VerFileIterator vf = it->FileList(); !vf.end(); ++vf)
+	    {
+	      ranges.push_back(record_range(vf.File(), vf->Offset, vf->Size));
+
+	      if(!all_files)
+		break;
+	    }
+
+#ifdef HAVE_DDTP
+	  if(descriptions)
+	    {
+	      pkgCache::DescIterator d =
+		const_cast<pkgCache::VerIterator &>(*it).TranslatedDescription();
+	      if(!d.end() && !d.FileList().end())
+		{
+		  pkgCache::DescFileIterator df = d.FileList();
+		  ranges.push_back(record_range(df.File(), df->Offset, df->Size));
+		}
+	    }
+#else
+	  (void) descriptions;
+#endif
+	}
+
+      std::sort(ranges.begin(), ranges.end());
+
+      std::vector<record_range>::const_iterator it = ranges.begin();
+      while(it != ranges.end())
+	{
+	  const pkgCache::PkgFileIterator file = it->file;
+	  const int fd =
+	    file.FileName() == NULL ? -1 : open(file.FileName(), O_RDONLY);
+
+	  // Walk over all the ranges in this file, merging the ones
+	  // that are close together.
+	  unsigned long start = it->offset;
+	  unsigned long end = it->offset + it->size;
+	  for(++it; it != ranges.end() && it->file == file; ++it)
+	    {
+	      if(it->offset > end + merge_gap)
+		{
+		  if(fd != -1)
+		    prefetch_range(fd, start, end - start);
+		  start = it->offset;
+		}
+
+	      end = std::max(end, it->offset + it->size);
+	    }
+
+	  if(fd != -1)
+	    {
+	      prefetch_range(fd, start, end - start);
+	      close(fd);
+	    }
+	}
+    }
+  }
+}
@@ -0,0 +1,66 @@
+// record_prefetch.h                                 -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef RECORD_PREFETCH_H
+#define RECORD_PREFETCH_H
+
+#include <apt-pkg/pkgcache.h>
+
+#include <vector>
+
+/** \file record_prefetch.h
+ *
+ *  Support for reading a batch of package records from disk in one
+ *  pass.
+ *
+ *  pkgRecords::Lookup() seeks to each record as it's asked for, so
+ *  displaying a few hundred packages in cache order jumps back and
+ *  forth across every Packages file on the system.  Prefetching the
+ *  records first sorts them by file and offset, merges records that
+ *  are close together, and asks the kernel to read the resulting
+ *  ranges ahead; the lookups made while displaying the results are
+ *  then served from the page cache.
+ */
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief Prefetch the package records of some versions.
+     *
+     *  This is only a hint; it never fails, and the records still
+     *  have to be read with pkgRecords::Lookup().
+     *
+     *  \param versions      The versions whose records will be needed.
+     *                       End iterators are ignored.
+     *  \param all_files     If \b true, prefetch the record of each
+     *                       version from every index file it appears
+     *                       in; otherwise only the first file, which is
+     *                       the one used by get_short_description()
+     *                       and friends, is fetched.
+     *  \param descriptions  If \b true, also prefetch the translated
+     *                       description of each version.
+     */
+    void prefetch_version_records(const std::vector<pkgCache::VerIterator> &versions,
+				  bool all_files,
+				  bool descriptions);
+  }
+}
+
+#endif // RECORD_PREFETCH_H
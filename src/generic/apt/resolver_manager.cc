@@ -34,15 +34,19 @@
 #include <loggers.h>
 
 #include <generic/problemresolver/problemresolver.h>
+#include <generic/problemresolver/search_telemetry.h>
 #include <generic/util/temp.h>
 #include <generic/util/undo.h>
 
 #include <apt-pkg/error.h>
+#include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/strutl.h>
+#include <apt-pkg/version.h>
 
 #include <sigc++/bind.h>
 #include <sigc++/functors/mem_fun.h>
 
+#include <algorithm>
 #include <fstream>
 
 #include <sys/types.h>
@@ -143,6 +147,32 @@ public:
   }
 
   tag get_type() const { return type; }
+
+  /** \brief Test whether a solution that was found before this
+   *  interaction can't be produced after it.
+   */
+  bool invalidates(const generic_solution<aptitude_universe> &sol) const
+  {
+    typedef generic_choice<aptitude_universe> choice;
+
+    switch(type)
+      {
+      case reject_version:
+	return sol.version_of(version.get_package()) == version;
+      case mandate_version:
+	return sol.version_of(version.get_package()) != version;
+      case harden_dep:
+	return sol.get_choices().contains(choice::make_break_soft_dep(dep, 0));
+      case approve_broken_dep:
+	return !sol.get_choices().contains(choice::make_break_soft_dep(dep, 0));
+      case undo:
+	// There's no telling which hints were reverted.
+	return true;
+      default:
+	// The other interactions only allow more solutions.
+	return false;
+      }
+  }
   const aptitude_resolver_version &get_version() const
   {
     eassert(!version.get_pkg().end());
@@ -172,16 +202,25 @@ resolver_manager::resolver_manager(aptitudeCacheFile *_cache_file,
    resolver(NULL),
    undos(new undo_list),
    ticks_since_last_solution(0),
+   time_limit(aptcfg->FindI(PACKAGE "::ProblemResolver::TimeLimit", 0)),
    solution_search_aborted(false),
    selected_solution(0),
+   max_solution_overlap(aptcfg->FindI(PACKAGE "::ProblemResolver::Max-Solution-Overlap", 100)),
+   hold_back_similar_solutions(true),
+   solutions_requested(0),
+   pending_speculative_jobs(0),
+   speculative_solutions(0),
+   speculative_max_steps(0),
    background_thread_killed(false),
    background_thread_running(false),
    resolver_null(true),
    background_thread_suspend_count(0),
    background_thread_in_resolver(false),
+   background_thread_speculating(false),
    initial_installations(_initial_installations),
    resolver_thread(NULL),
-   mutex(cwidget::threads::mutex::attr(PTHREAD_MUTEX_RECURSIVE))
+   mutex(cwidget::threads::mutex::attr(PTHREAD_MUTEX_RECURSIVE)),
+   account(sigc::mem_fun(*this, &resolver_manager::account_memory))
 {
   (*cache_file)->pre_package_state_changed.connect(sigc::mem_fun(this, &resolver_manager::discard_resolver));
   (*cache_file)->package_state_changed.connect(sigc::mem_fun(this, &resolver_manager::maybe_create_resolver));
@@ -209,6 +248,10 @@ resolver_manager::~resolver_manager()
       delete *it;
     }
 
+  for(std::vector<const generic_solution<aptitude_universe> *>::const_iterator it =
+	held_back_solutions.begin(); it != held_back_solutions.end(); ++it)
+    delete *it;
+
   delete undos;
 }
 
@@ -519,6 +562,32 @@ namespace
   {
     f();
   }
+
+  // The continuation of speculative jobs: the solution is kept in the
+  // solution list, and nobody is waiting for it.
+  class speculative_continuation : public resolver_manager::background_continuation
+  {
+  public:
+    void success(const generic_solution<aptitude_universe> &)
+    {
+    }
+
+    void no_more_solutions()
+    {
+    }
+
+    void no_more_time()
+    {
+    }
+
+    void interrupted()
+    {
+    }
+
+    void aborted(const std::string &)
+    {
+    }
+  };
 }
 
 // This assumes that background_resolver_active is empty when it
@@ -577,13 +646,19 @@ void resolver_manager::background_thread_execution()
 
       job_request job = pending_jobs.top();
       pending_jobs.pop();
+      if(job.speculative)
+	--pending_speculative_jobs;
 
       LOG_DEBUG(logger,
 		"Resolver thread: got a new job { solution number = "
 		<< job.sol_num << ", max steps = " << job.max_steps
-		<< ", continuation = " << job.k << " }");
+		<< ", max milliseconds = " << job.max_milliseconds
+		<< ", continuation = " << job.k
+		<< (job.speculative ? ", speculative" : "") << " }");
 
+      bool found_solution = false;
       background_thread_in_resolver = true;
+      background_thread_speculating = job.speculative;
       background_resolver_cond.wake_all();
       l.release();
 
@@ -591,6 +666,7 @@ void resolver_manager::background_thread_execution()
 	{
 	  const aptitude_resolver::solution *sol =
 	    do_get_solution(job.max_steps,
+			    job.max_milliseconds,
 			    job.sol_num,
 			    visited_packages);
 
@@ -615,6 +691,7 @@ void resolver_manager::background_thread_execution()
 		       *sol);
 	  // Wrap a keepalive slot around that so job.k lives.
 	  job.post_thunk(make_keepalive_slot(success_slot, job.k));
+	  found_solution = true;
 	}
       catch(InterruptedException)
 	{
@@ -632,6 +709,8 @@ void resolver_manager::background_thread_execution()
 	  background_thread_in_resolver = false;
 	  background_resolver_cond.wake_all();
 	  pending_jobs.push(job);
+	  if(job.speculative)
+	    ++pending_speculative_jobs;
 
 	  l.release();
 	}
@@ -677,6 +756,15 @@ void resolver_manager::background_thread_execution()
 		    "Resolver thread: caught a fatal error from the resolver: "
 		    << e.errmsg());
 
+	  // Nobody asked for this solution, so don't report the error
+	  // yet; the search will fail again when someone does.
+	  if(job.speculative)
+	    {
+	      cwidget::threads::mutex::lock sol_l(solutions_mutex);
+	      solution_search_aborted = false;
+	      solution_search_abort_msg.clear();
+	    }
+
 	  dump_visited_packages(visited_packages,
 				job.sol_num);
 
@@ -690,8 +778,143 @@ void resolver_manager::background_thread_execution()
       l.acquire();
 
       background_thread_in_resolver = false;
+      background_thread_speculating = false;
       background_resolver_cond.wake_all();
+
+      if(found_solution)
+	maybe_queue_speculative_job(job.max_milliseconds);
+    }
+}
+
+void resolver_manager::maybe_queue_speculative_job(int max_milliseconds)
+{
+  if(speculative_solutions <= 0 || speculative_max_steps <= 0 ||
+     resolver_null || !pending_jobs.empty())
+    return;
+
+  cwidget::threads::mutex::lock sol_l(solutions_mutex);
+  // Wait until the first solution is asked for, so that programs
+  // that never ask for one don't search for several.
+  if(solution_search_aborted || solutions_requested == 0 ||
+     solutions.size() >= solutions_requested + speculative_solutions)
+    return;
+
+  const unsigned int sol_num = solutions.size();
+  sol_l.release();
+
+  LOG_TRACE(Loggers::getAptitudeResolverThread(),
+	    "Speculatively computing solution " << sol_num << ".");
+
+  pending_jobs.push(job_request(sol_num, speculative_max_steps,
+				max_milliseconds,
+				boost::make_shared<speculative_continuation>(),
+				&inline_continuation_trampoline,
+				true));
+  ++pending_speculative_jobs;
+  background_control_cond.wake_all();
+}
+
+void resolver_manager::note_solution_requested(unsigned int solution_num)
+{
+  {
+    cwidget::threads::mutex::lock sol_l(solutions_mutex);
+    if(solution_num < solutions_requested)
+      return;
+
+    solutions_requested = solution_num + 1;
+  }
+
+  cwidget::threads::mutex::lock control_lock(background_control_mutex);
+  maybe_queue_speculative_job(time_limit);
+}
+
+void resolver_manager::discard_stale_speculative_solutions(const resolver_interaction &act)
+{
+  {
+    cwidget::threads::mutex::lock sol_l(solutions_mutex);
+
+    // The interactions and steps recorded for a discarded solution
+    // are passed on to the next solution, so that traces can still
+    // reproduce it.
+    std::vector<resolver_interaction> carried_interactions;
+    int carried_ticks = 0;
+    int num_discarded = 0;
+
+    std::vector<const solution_information *> kept;
+    for(unsigned int i = 0; i < solutions.size(); ++i)
+      {
+	const solution_information *info = solutions[i];
+
+	if(i < solutions_requested)
+	  kept.push_back(info);
+	else if(act.invalidates(*info->get_solution()))
+	  {
+	    carried_interactions.insert(carried_interactions.end(),
+					info->get_interactions()->begin(),
+					info->get_interactions()->end());
+	    carried_ticks += info->get_ticks();
+	    ++num_discarded;
+	    delete info;
+	  }
+	else if(!carried_interactions.empty() || carried_ticks > 0)
+	  {
+	    std::vector<resolver_interaction> *interactions =
+	      new std::vector<resolver_interaction>(carried_interactions);
+	    interactions->insert(interactions->end(),
+				 info->get_interactions()->begin(),
+				 info->get_interactions()->end());
+
+	    kept.push_back(new solution_information(interactions,
+						    carried_ticks + info->get_ticks(),
+						    new aptitude_resolver::solution(*info->get_solution()),
+						    info->get_summary()));
+	    carried_interactions.clear();
+	    carried_ticks = 0;
+	    delete info;
+	  }
+	else
+	  kept.push_back(info);
+      }
+
+    std::vector<const generic_solution<aptitude_universe> *> kept_held_back;
+    for(std::vector<const generic_solution<aptitude_universe> *>::const_iterator it =
+	  held_back_solutions.begin(); it != held_back_solutions.end(); ++it)
+      {
+	if(act.invalidates(**it))
+	  {
+	    ++num_discarded;
+	    delete *it;
+	  }
+	else
+	  kept_held_back.push_back(*it);
+      }
+    held_back_solutions.swap(kept_held_back);
+
+    actions_since_last_solution.insert(actions_since_last_solution.begin(),
+				       carried_interactions.begin(),
+				       carried_interactions.end());
+    ticks_since_last_solution += carried_ticks;
+    solutions.swap(kept);
+
+    if(num_discarded > 0)
+      LOG_DEBUG(Loggers::getAptitudeResolver(),
+		"Discarded " << num_discarded
+		<< " speculative solutions that the last hint ruled out.");
+  }
+
+  cwidget::threads::mutex::lock control_lock(background_control_mutex);
+  if(pending_speculative_jobs > 0)
+    {
+      std::priority_queue<job_request, std::vector<job_request>, job_request_compare> requested_jobs;
+      for( ; !pending_jobs.empty(); pending_jobs.pop())
+	if(!pending_jobs.top().speculative)
+	  requested_jobs.push(pending_jobs.top());
+
+      pending_jobs = requested_jobs;
+      pending_speculative_jobs = 0;
     }
+
+  maybe_queue_speculative_job(time_limit);
 }
 
 // Need this because sigc slots aren't threadsafe :-(
@@ -744,9 +967,11 @@ void resolver_manager::kill_background_thread()
       // Reset the associated data structures.
       control_lock.acquire();
       pending_jobs = std::priority_queue<job_request, std::vector<job_request>, job_request_compare>();
+      pending_speculative_jobs = 0;
       background_thread_killed = false;
       background_thread_suspend_count = 0;
       background_thread_in_resolver = false;
+      background_thread_speculating = false;
       solution_search_aborted = false;
       solution_search_abort_msg.clear();
     }
@@ -830,6 +1055,8 @@ void resolver_manager::discard_resolver()
 
   undos->clear_items();
 
+  resolver->save_persistent_promotions();
+
   delete resolver;
 
   {
@@ -842,9 +1069,16 @@ void resolver_manager::discard_resolver()
       delete *it;
 
     solutions.clear();
+
+    for(std::vector<const generic_solution<aptitude_universe> *>::const_iterator it =
+	  held_back_solutions.begin(); it != held_back_solutions.end(); ++it)
+      delete *it;
+
+    held_back_solutions.clear();
     solution_search_aborted = false;
     solution_search_abort_msg.clear();
     selected_solution = 0;
+    solutions_requested = 0;
   }
 
   resolver = NULL;
@@ -853,6 +1087,7 @@ void resolver_manager::discard_resolver()
     cwidget::threads::mutex::lock l2(background_control_mutex);
     resolver_null = true;
     pending_jobs = std::priority_queue<job_request, std::vector<job_request>, job_request_compare>();
+    pending_speculative_jobs = 0;
     background_control_cond.wake_all();
   }
 }
@@ -1003,8 +1238,45 @@ void resolver_manager::create_resolver()
 				aptcfg->FindI(PACKAGE "::ProblemResolver::OptionalScore", 1),
 				aptcfg->FindI(PACKAGE "::ProblemResolver::ExtraScore", -1));
 
+  resolver->load_persistent_promotions();
+
+  const std::string new_telemetry_target =
+    aptcfg->Find(PACKAGE "::ProblemResolver::Telemetry", "");
+  if(new_telemetry_target != telemetry_target)
+    {
+      telemetry_target = new_telemetry_target;
+      telemetry.reset();
+
+      if(!telemetry_target.empty())
+	{
+	  telemetry = search_telemetry::open(telemetry_target,
+					     aptcfg->FindI(PACKAGE "::ProblemResolver::Telemetry-Interval", 1000));
+	  if(telemetry.get() == NULL)
+	    _error->Errno("open", _("Unable to open the resolver telemetry stream %s"),
+			  telemetry_target.c_str());
+	}
+    }
+  resolver->set_telemetry(telemetry);
+
+  // In low-memory mode the search graph is kept small by default:
+  // it is compacted sooner, and its worst open steps are dropped.
+  const bool low_memory = apt_low_memory_mode();
+  resolver->set_compaction_threshold(std::max(0, aptcfg->FindI(PACKAGE "::ProblemResolver::Compaction-Threshold",
+							       low_memory ? 32 : 256)) *
+				     static_cast<std::size_t>(1024 * 1024));
+  resolver->set_max_open_steps(std::max(0, aptcfg->FindI(PACKAGE "::ProblemResolver::Max-Open-Steps",
+							 low_memory ? 20000 : 0)));
+
+  {
+    cwidget::threads::mutex::lock l2(solutions_mutex);
+    hold_back_similar_solutions = true;
+  }
+
   {
     cwidget::threads::mutex::lock l2(background_control_mutex);
+    speculative_solutions = aptcfg->FindI(PACKAGE "::ProblemResolver::Speculative-Solutions",
+					  low_memory ? 0 : 2);
+    speculative_max_steps = aptcfg->FindI(PACKAGE "::ProblemResolver::StepLimit", defaultStepLimit);
     resolver_null = false;
     background_control_cond.wake_all();
   }
@@ -1062,7 +1334,8 @@ bool resolver_manager::background_thread_active()
 
   cwidget::threads::mutex::lock ctl_l(background_control_mutex);
 
-  return !pending_jobs.empty() || background_thread_in_resolver;
+  return pending_jobs.size() > (std::size_t)pending_speculative_jobs ||
+    (background_thread_in_resolver && !background_thread_speculating);
 }
 
 bool resolver_manager::background_thread_aborted()
@@ -1095,10 +1368,13 @@ resolver_manager::state resolver_manager::state_snapshot()
 
   rval.selected_solution           = selected_solution;
   rval.generated_solutions         = solutions.size();
+  if(selected_solution < solutions.size())
+    rval.selected_summary          = solutions[selected_solution]->get_summary();
   rval.resolver_exists             = (resolver != NULL);
   rval.background_thread_active    = !solution_search_aborted &&
-                                        (!pending_jobs.empty() ||
-				         background_thread_in_resolver);
+                                        (pending_jobs.size() > (std::size_t)pending_speculative_jobs ||
+				         (background_thread_in_resolver &&
+					  !background_thread_speculating));
   rval.background_thread_aborted   = solution_search_aborted;
   rval.background_thread_abort_msg = solution_search_abort_msg;
 
@@ -1110,7 +1386,9 @@ resolver_manager::state resolver_manager::state_snapshot()
       rval.closed_size    = c.closed;
       rval.deferred_size  = c.deferred;
       rval.conflicts_size = c.conflicts;
-      rval.solutions_exhausted = c.finished;
+      rval.solutions_exhausted = c.finished && held_back_solutions.empty();
+      rval.steps_processed = c.steps;
+      rval.steps_dropped   = c.dropped;
     }
   else
     {
@@ -1118,6 +1396,8 @@ resolver_manager::state resolver_manager::state_snapshot()
       rval.closed_size    = 0;
       rval.deferred_size  = 0;
       rval.conflicts_size = 0;
+      rval.steps_processed = 0;
+      rval.steps_dropped   = 0;
 
       rval.solutions_exhausted = false;
     }
@@ -1125,8 +1405,143 @@ resolver_manager::state resolver_manager::state_snapshot()
   return rval;
 }
 
+bool resolver_manager::has_solution_with_same_effect(const generic_solution<aptitude_universe> &sol) const
+{
+  for(std::vector<const solution_information *>::const_iterator it =
+	solutions.begin(); it != solutions.end(); ++it)
+    if((*it)->get_solution()->has_same_effect(sol))
+      return true;
+
+  return false;
+}
+
+resolver_manager::solution_summary
+resolver_manager::summarize_solution(const generic_solution<aptitude_universe> &sol) const
+{
+  typedef generic_choice<aptitude_universe> choice;
+  typedef generic_choice_set<aptitude_universe> choice_set;
+
+  solution_summary rval;
+
+  for(choice_set::const_iterator i = sol.get_choices().begin();
+      i != sol.get_choices().end(); ++i)
+    {
+      // Ignore broken recommendations for now.
+      if(i->get_type() != choice::install_version)
+	continue;
+
+      pkgCache::PkgIterator pkg = i->get_ver().get_pkg();
+      pkgCache::VerIterator curver = pkg.CurrentVer();
+      pkgCache::VerIterator newver = i->get_ver().get_ver();
+
+      if(newver == curver)
+	++rval.keep_count;
+      else if(curver.end())
+	++rval.install_count;
+      else if(newver.end())
+	++rval.remove_count;
+      else
+	{
+	  // The versions can compare equal, eg, for a locally
+	  // compiled package and a standard package.
+	  //
+	  // \todo indicate "sidegrades" separately?
+	  if(_system->VS->CmpVersion(curver.VerStr(), newver.VerStr()) <= 0)
+	    ++rval.upgrade_count;
+	  else
+	    ++rval.downgrade_count;
+	}
+    }
+
+  return rval;
+}
+
+namespace
+{
+  /** \brief Compute the percentage of the actions of either solution
+   *  that both solutions perform.
+   */
+  int solution_overlap(const generic_solution<aptitude_universe> &sol1,
+		       const generic_solution<aptitude_universe> &sol2)
+  {
+    typedef generic_choice<aptitude_universe> choice;
+    typedef generic_choice_set<aptitude_universe> choice_set;
+
+    const choice_set &choices1(sol1.get_choices());
+    const choice_set &choices2(sol2.get_choices());
+
+    int shared = 0;
+    for(choice_set::const_iterator it = choices1.begin();
+	it != choices1.end(); ++it)
+      {
+	// Installing a version is the same action whichever
+	// dependency it was installed to fix.
+	aptitude_resolver_version ver;
+	if(it->get_type() == choice::install_version
+	   ? (choices2.get_version_of(it->get_ver().get_package(), ver) &&
+	      ver == it->get_ver())
+	   : choices2.contains(*it))
+	  ++shared;
+      }
+
+    const int total = (int)choices1.size() + (int)choices2.size() - shared;
+    return total == 0 ? 100 : shared * 100 / total;
+  }
+}
+
+bool resolver_manager::is_too_similar_to_earlier_solution(const generic_solution<aptitude_universe> &sol) const
+{
+  if(!hold_back_similar_solutions || max_solution_overlap >= 100)
+    return false;
+
+  for(std::vector<const solution_information *>::const_iterator it =
+	solutions.begin(); it != solutions.end(); ++it)
+    if(solution_overlap(sol, *(*it)->get_solution()) > max_solution_overlap)
+      return true;
+
+  return false;
+}
+
+void resolver_manager::add_solution(const generic_solution<aptitude_universe> &sol,
+				    int max_steps)
+{
+  solution_summary summary = summarize_solution(sol);
+  summary.is_keep_all =
+    (sol.get_choices() == resolver->get_keep_all_solution());
+
+  solutions.push_back(new solution_information(new std::vector<resolver_interaction>(actions_since_last_solution),
+					       ticks_since_last_solution + max_steps,
+					       new aptitude_resolver::solution(sol.clone()),
+					       summary));
+  actions_since_last_solution.clear();
+}
+
+bool resolver_manager::release_held_back_solution(int max_steps)
+{
+  while(!held_back_solutions.empty())
+    {
+      const generic_solution<aptitude_universe> *sol = held_back_solutions.front();
+      held_back_solutions.erase(held_back_solutions.begin());
+
+      const bool duplicate = has_solution_with_same_effect(*sol);
+      if(!duplicate)
+	{
+	  LOG_DEBUG(Loggers::getAptitudeResolver(),
+		    "Offering a held-back solution: " << *sol);
+	  add_solution(*sol, max_steps);
+	}
+      delete sol;
+
+      if(!duplicate)
+	return true;
+    }
+
+  return false;
+}
+
 const aptitude_resolver::solution *
-resolver_manager::do_get_solution(int max_steps, unsigned int solution_num,
+resolver_manager::do_get_solution(int max_steps, int max_milliseconds,
+				  unsigned int solution_num,
 				  std::set<aptitude_resolver_package> &visited_packages)
 {
   cwidget::threads::mutex::lock sol_l(solutions_mutex);
@@ -1139,18 +1554,35 @@ resolver_manager::do_get_solution(int max_steps, unsigned int solution_num,
 
       try
 	{
-	  generic_solution<aptitude_universe> sol = resolver->find_next_solution(max_steps, &visited_packages);
+	  generic_solution<aptitude_universe> sol = resolver->find_next_solution(max_steps, &visited_packages,
+								 max_milliseconds);
 
 	  sol_l.acquire();
 
-	  bool is_keep_all_solution =
-	    (sol.get_choices() == resolver->get_keep_all_solution());
+	  // The resolver never returns the same choices twice, but it
+	  // can return a solution that installs the same versions as
+	  // an earlier one for different reasons.  The user can't
+	  // tell those apart, so don't offer them again.
+	  if(has_solution_with_same_effect(sol))
+	    {
+	      LOG_DEBUG(Loggers::getAptitudeResolver(),
+			"Skipping a solution with the same effect as an earlier solution: " << sol);
+	      ticks_since_last_solution += max_steps;
+	      sol_l.release();
+	      continue;
+	    }
+
+	  if(is_too_similar_to_earlier_solution(sol))
+	    {
+	      LOG_DEBUG(Loggers::getAptitudeResolver(),
+			"Holding back a solution that is too similar to an earlier solution: " << sol);
+	      held_back_solutions.push_back(new generic_solution<aptitude_universe>(sol.clone()));
+	      ticks_since_last_solution += max_steps;
+	      sol_l.release();
+	      continue;
+	    }
 
-	  solutions.push_back(new solution_information(new std::vector<resolver_interaction>(actions_since_last_solution),
-						       ticks_since_last_solution + max_steps,
-						       new aptitude_resolver::solution(sol.clone()),
-						       is_keep_all_solution));
-	  actions_since_last_solution.clear();
+	  add_solution(sol, max_steps);
 	  sol_l.release();
 	}
       catch(const InterruptedException &e)
@@ -1160,12 +1592,18 @@ resolver_manager::do_get_solution(int max_steps, unsigned int solution_num,
 	}
       catch(NoMoreTime)
 	{
+	  sol_l.acquire();
 	  ticks_since_last_solution += max_steps;
-	  throw NoMoreTime();
+	  if(!release_held_back_solution(max_steps))
+	    throw NoMoreTime();
+	  sol_l.release();
 	}
       catch(NoMoreSolutions)
 	{
-	  throw NoMoreSolutions();
+	  sol_l.acquire();
+	  if(!release_held_back_solution(max_steps))
+	    throw NoMoreSolutions();
+	  sol_l.release();
 	}
       catch(cwidget::util::Exception &e)
 	{
@@ -1322,6 +1760,21 @@ bool resolver_manager::get_is_keep_all_solution(unsigned int solution_num,
   }
 }
 
+void resolver_manager::set_time_limit(int max_milliseconds)
+{
+  cwidget::threads::mutex::lock l(mutex);
+
+  time_limit = max_milliseconds;
+}
+
+void resolver_manager::set_max_solution_overlap(int percent)
+{
+  cwidget::threads::mutex::lock l(mutex);
+  cwidget::threads::mutex::lock sol_l(solutions_mutex);
+
+  max_solution_overlap = percent;
+}
+
 void resolver_manager::get_solution_background(unsigned int solution_num,
 					       int max_steps,
 					       const boost::shared_ptr<background_continuation> &k,
@@ -1341,14 +1794,18 @@ void resolver_manager::get_solution_background(unsigned int solution_num,
       const generic_solution<aptitude_universe> *sol = solutions[solution_num]->get_solution();
       sol_l.release();
 
+      note_solution_requested(solution_num);
       k->success(*sol);
       return;
     }
+  // The background thread starts speculating once this job is done.
+  solutions_requested = std::max(solutions_requested, solution_num + 1);
   sol_l.release();
 
 
   cwidget::threads::mutex::lock control_lock(background_control_mutex);
-  pending_jobs.push(job_request(solution_num, max_steps, k, post_thunk));
+  pending_jobs.push(job_request(solution_num, max_steps, time_limit,
+				k, post_thunk));
   background_control_cond.wake_all();
 }
 
@@ -1442,13 +1899,18 @@ void resolver_manager::resolver_manipulation(const T &t,
   background_suspender bs(*this);
 
   undo_group *undo = new undo_group;
+  const std::size_t step_updates_before = resolver->get_num_deferral_step_updates();
   (resolver->*action)(t, undo);
+  LOG_DEBUG(Loggers::getAptitudeResolver(),
+	    "Updated " << (resolver->get_num_deferral_step_updates() - step_updates_before)
+	    << " search steps after a user hint involving " << t);
   if(undo->empty())
     delete undo;
   else
     undos->add_item(undo);
 
   actions_since_last_solution.push_back(act);
+  discard_stale_speculative_solutions(act);
 
   l.release();
   bs.unsuspend();
@@ -1462,21 +1924,26 @@ void resolver_manager::reject_break_holds()
 
   std::auto_ptr<undo_group> undo(new undo_group);
 
-  for(aptitude_universe::package_iterator pi = resolver->get_universe().packages_begin();
-      !pi.end(); ++pi)
-    {
-      const aptitude_universe::package p = *pi;
+  {
+    // Propagate the rejections to the deferred choices in one pass.
+    expression_batch batch;
 
-      for(aptitude_universe::package::version_iterator vi = p.versions_begin(); !vi.end(); ++vi)
-	{
-	  const aptitude_universe::version v = *vi;
-	  if(resolver->is_break_hold(v))
-	    {
-	      actions_since_last_solution.push_back(resolver_interaction::RejectVersion(v));
-	      reject_version(v);
-	    }
-	}
-    }
+    for(aptitude_universe::package_iterator pi = resolver->get_universe().packages_begin();
+	!pi.end(); ++pi)
+      {
+	const aptitude_universe::package p = *pi;
+
+	for(aptitude_universe::package::version_iterator vi = p.versions_begin(); !vi.end(); ++vi)
+	  {
+	    const aptitude_universe::version v = *vi;
+	    if(resolver->is_break_hold(v))
+	      {
+		actions_since_last_solution.push_back(resolver_interaction::RejectVersion(v));
+		reject_version(v);
+	      }
+	  }
+      }
+  }
 
   if(!undo->empty())
     undos->add_item(undo.release());
@@ -1589,9 +2056,15 @@ bool resolver_manager::undo()
     {
       background_suspender bs(*this);
 
-      undos->undo();
+      {
+	// An undo group can revert many hints at once; propagate
+	// their effects on deferred choices in one pass.
+	expression_batch batch;
+	undos->undo();
+      }
 
       actions_since_last_solution.push_back(resolver_interaction::Undo());
+      discard_stale_speculative_solutions(resolver_interaction::Undo());
 
       bs.unsuspend();
       l.release();
@@ -1613,6 +2086,8 @@ void resolver_manager::select_solution(unsigned int solnum)
     selected_solution = solnum;
   sol_l.release();
 
+  note_solution_requested(selected_solution);
+
   l.release();
   state_changed();
 }
@@ -1641,6 +2116,8 @@ void resolver_manager::select_next_solution()
     ++selected_solution;
   sol_l.release();
 
+  note_solution_requested(selected_solution);
+
   l.release();
   state_changed();
 }
@@ -1700,6 +2177,28 @@ void resolver_manager::dump(ostream &out)
   out << "EXPECT ( " << aptcfg->FindI(PACKAGE "::ProblemResolver::StepLimit", defaultStepLimit) << " ANY )" << std::endl;
 }
 
+void resolver_manager::dump_statistics(ostream &out)
+{
+  cwidget::threads::mutex::lock l(mutex);
+  background_suspender bs(*this);
+
+  if(!resolver_exists())
+    return;
+
+  out << resolver->get_statistics();
+}
+
+void resolver_manager::account_memory(aptitude::util::memory_report &report)
+{
+  cwidget::threads::mutex::lock l(mutex);
+  background_suspender bs(*this);
+
+  if(!resolver_exists())
+    return;
+
+  resolver->account_memory(report);
+}
+
 void resolver_manager::maybe_start_solution_calculation(const boost::shared_ptr<background_continuation> &k,
 							post_thunk_f post_thunk)
 {
@@ -1928,6 +2427,25 @@ void resolver_manager::setup_safe_resolver(bool no_new_installs, bool no_new_upg
 
   background_suspender bs(*this);
 
+  // The safe resolver adds hints after each solution, so solutions
+  // computed ahead of time would just be thrown away, and it wants
+  // each solution to improve on the last one rather than to differ
+  // from it.
+  {
+    cwidget::threads::mutex::lock sol_l(solutions_mutex);
+    hold_back_similar_solutions = false;
+  }
+  {
+    cwidget::threads::mutex::lock control_lock(background_control_mutex);
+    speculative_solutions = 0;
+  }
+
+  // Collect the rejections first and install them all at once
+  // below: going through reject_version() would suspend the
+  // background thread, record an undo and emit state_changed() for
+  // every version in the archive.
+  std::vector<aptitude_resolver_version> rejections;
+
   for(pkgCache::PkgIterator p = (*cache_file)->PkgBegin();
       !p.end(); ++p)
     {
@@ -1941,7 +2459,7 @@ void resolver_manager::setup_safe_resolver(bool no_new_installs, bool no_new_upg
 	  LOG_DEBUG(logger,
 		    "setup_safe_resolver: Rejecting the removal of the package " << remove_p.get_package() << ".");
 
-	  reject_version(remove_p);
+	  rejections.push_back(remove_p);
 	}
 
       // Look up the version that's to-be-installed according to the
@@ -1998,10 +2516,44 @@ void resolver_manager::setup_safe_resolver(bool no_new_installs, bool no_new_upg
 		    LOG_DEBUG(logger, "setup_safe_resolver: Rejecting " << p_v << " (it is a new upgrade).");
 		}
 
-	      reject_version(p_v);
+	      rejections.push_back(p_v);
 	    }
 	}
     }
+
+  LOG_TRACE(logger,
+	    "setup_safe_resolver: Installing " << rejections.size() << " rejections.");
+
+  {
+    cwidget::threads::mutex::lock l(mutex);
+
+    // The resolver was just reset, so nothing has been searched yet;
+    // the batch only saves propagating each rejection separately to
+    // the deferral expressions that already exist.  A single undo
+    // group takes back the whole setup.
+    std::auto_ptr<undo_group> undo(new undo_group);
+
+    {
+      expression_batch batch;
+
+      for(std::vector<aptitude_resolver_version>::const_iterator it =
+	    rejections.begin(); it != rejections.end(); ++it)
+	{
+	  resolver->reject_version(*it, undo.get());
+	  actions_since_last_solution.push_back(resolver_interaction::RejectVersion(*it));
+	}
+    }
+
+    if(!undo->empty())
+      undos->add_item(undo.release());
+  }
+
+  bs.unsuspend();
+  state_changed();
+
+  for(std::vector<aptitude_resolver_version>::const_iterator it =
+	rejections.begin(); it != rejections.end(); ++it)
+    version_accept_reject_changed(*it);
 }
 
 void resolver_manager::safe_resolve_deps_background(bool no_new_installs, bool no_new_upgrades,
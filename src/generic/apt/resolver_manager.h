@@ -38,6 +38,7 @@
 #include <vector>
 
 #include <generic/util/immset.h>
+#include <generic/util/memory_accounting.h>
 #include <generic/util/post_thunk.h>
 
 /** \brief A higher-level resolver interface
@@ -61,6 +62,7 @@ class aptitudeCacheFile;
 template<typename PackageUniverse> class generic_solution;
 template<typename PackageUniverse> class generic_problem_resolver;
 class aptitude_resolver;
+class search_telemetry;
 class undo_group;
 class undo_list;
 
@@ -110,6 +112,58 @@ public:
     virtual void aborted(const std::string &errmsg) = 0;
   };
 
+  /** \brief What a solution would do to the current package states.
+   *
+   *  This is worked out once, when the solution is generated, so that
+   *  displays that just print the totals don't need to fetch the
+   *  solution and walk over its choices.
+   */
+  struct solution_summary
+  {
+    /** The number of packages that would be newly installed. */
+    int install_count;
+
+    /** The number of packages that would be removed. */
+    int remove_count;
+
+    /** The number of packages that would be kept at their current
+     *  version.
+     */
+    int keep_count;
+
+    /** The number of packages that would be upgraded. */
+    int upgrade_count;
+
+    /** The number of packages that would be downgraded. */
+    int downgrade_count;
+
+    /** \b true if this is the solution that keeps all packages at
+     *  their current version.
+     */
+    bool is_keep_all;
+
+    solution_summary()
+      : install_count(0), remove_count(0), keep_count(0),
+	upgrade_count(0), downgrade_count(0), is_keep_all(false)
+    {
+    }
+
+    bool operator==(const solution_summary &other) const
+    {
+      return install_count == other.install_count &&
+	remove_count == other.remove_count &&
+	keep_count == other.keep_count &&
+	upgrade_count == other.upgrade_count &&
+	downgrade_count == other.downgrade_count &&
+	is_keep_all == other.is_keep_all;
+    }
+
+    bool operator!=(const solution_summary &other) const
+    {
+      return !(*this == other);
+    }
+  };
+
   /** A snapshot of the state of the resolver. */
   struct state
   {
@@ -119,6 +173,11 @@ public:
     /** The number of already-generated solutions. */
     int generated_solutions;
 
+    /** If selected_solution is less than generated_solutions, the
+     *  summary of the selected solution.
+     */
+    solution_summary selected_summary;
+
     /** If \b true, then there are no more solutions to generate. */
     bool solutions_exhausted;
 
@@ -151,6 +210,14 @@ public:
 
     /** The number of conflicts discovered by the resolver. */
     size_t conflicts_size;
+
+    /** The number of steps the resolver has processed. */
+    size_t steps_processed;
+
+    /** The number of open steps the resolver dropped to stay under
+     *  Aptitude::ProblemResolver::Max-Open-Steps.
+     */
+    size_t steps_dropped;
   };
 
 private:
@@ -171,6 +238,11 @@ private:
     /** The number of steps to allow for this calculation. */
     int max_steps;
 
+    /** The number of milliseconds to allow for this calculation, or
+     *  0 for no limit.
+     */
+    int max_milliseconds;
+
     /** The continuation of this computation. */
     boost::shared_ptr<background_continuation> k;
 
@@ -179,20 +251,32 @@ private:
      */
     post_thunk_f post_thunk;
 
-    job_request(int _sol_num, int _max_steps,
+    /** \brief \b true if nobody asked for this solution yet; see
+     *  maybe_queue_speculative_job().
+     */
+    bool speculative;
+
+    job_request(int _sol_num, int _max_steps, int _max_milliseconds,
 		const boost::shared_ptr<background_continuation> &_k,
-		post_thunk_f _post_thunk)
-      : sol_num(_sol_num), max_steps(_max_steps), k(_k),
-	post_thunk(_post_thunk)
+		post_thunk_f _post_thunk,
+		bool _speculative = false)
+      : sol_num(_sol_num), max_steps(_max_steps),
+	max_milliseconds(_max_milliseconds), k(_k),
+	post_thunk(_post_thunk), speculative(_speculative)
     {
     }
   };
 
-  /** Sort job requests by their solution number and step count. */
+  /** Sort job requests by their solution number and step count.
+   *  Speculative jobs always come after the jobs that were requested.
+   */
   struct job_request_compare
   {
     bool operator()(const job_request &jr1, const job_request &jr2) const
     {
+      if(jr1.speculative != jr2.speculative)
+	return jr1.speculative;
+
       return jr1.sol_num < jr2.sol_num ||
 	(jr1.sol_num == jr2.sol_num && jr1.max_steps < jr2.max_steps);
     }
@@ -226,21 +310,28 @@ private:
    */
   int ticks_since_last_solution;
 
+  /** \brief The number of milliseconds that each search for a
+   *  solution may run, or 0 for no limit.
+   *
+   *  Copied into each job_request when it is queued.
+   */
+  int time_limit;
+
   /** \brief Stores the information needed to reproduce a solution. */
   class solution_information
   {
     const std::vector<resolver_interaction> *interactions;
     int ticks;
     const generic_solution<aptitude_universe> *solution;
-    bool is_keep_all_solution;
+    solution_summary summary;
 
   public:
     solution_information(const std::vector<resolver_interaction> *_interactions,
 			 int _ticks,
 			 const generic_solution<aptitude_universe> *_solution,
-			 bool _is_keep_all_solution)
+			 const solution_summary &_summary)
       : interactions(_interactions), ticks(_ticks), solution(_solution),
-	is_keep_all_solution(_is_keep_all_solution)
+	summary(_summary)
     {
     }
 
@@ -270,7 +361,13 @@ private:
     */
     bool get_is_keep_all_solution() const
     {
-      return is_keep_all_solution;
+      return summary.is_keep_all;
+    }
+
+    /** \brief Get the totals of what this solution would do. */
+    const solution_summary &get_summary() const
+    {
+      return summary;
     }
   };
 
@@ -300,11 +397,54 @@ private:
   /** The index of the currently selected solution. */
   unsigned int selected_solution;
 
+  /** \brief Solutions that were found but held back because they
+   *  were too similar to an earlier solution, in the order the
+   *  resolver produced them.
+   *
+   *  They are offered once the resolver runs out of solutions or
+   *  time.  The solutions are owned by this object.  This is in the
+   *  scope of solutions_mutex.
+   */
+  std::vector<const generic_solution<aptitude_universe> *> held_back_solutions;
+
+  /** \brief Solutions that share more than this percentage of their
+   *  actions with an earlier solution are held back; 100 disables
+   *  this.  This is in the scope of solutions_mutex.
+   */
+  int max_solution_overlap;
+
+  /** \brief \b false if max_solution_overlap is ignored for the
+   *  current resolver.  This is in the scope of solutions_mutex.
+   */
+  bool hold_back_similar_solutions;
+
+  /** \brief One more than the highest solution number that has been
+   *  requested or selected since the resolver was created.
+   *
+   *  Solutions at or beyond this index were computed speculatively
+   *  and haven't been shown to anyone yet.  This is in the scope of
+   *  solutions_mutex.
+   */
+  unsigned int solutions_requested;
+
   /** The pending job requests for the background thread.
    */
   std::priority_queue<job_request, std::vector<job_request>,
 		      job_request_compare> pending_jobs;
 
+  /** \brief The number of jobs in pending_jobs that are speculative. */
+  int pending_speculative_jobs;
+
+  /** \brief How many solutions past the last requested one the
+   *  background thread computes ahead of time, taken from
+   *  Aptitude::ProblemResolver::Speculative-Solutions.  Zero disables
+   *  speculation.
+   */
+  int speculative_solutions;
+
+  /** \brief The step limit used for speculative jobs. */
+  int speculative_max_steps;
+
   /** If \b true, the background thread should abort its execution. */
   bool background_thread_killed;
 
@@ -335,6 +475,21 @@ private:
    */
   std::string resolver_trace_file;
 
+  /** \brief The stream that the resolvers write telemetry to, or an
+   *  invalid pointer if Aptitude::ProblemResolver::Telemetry isn't
+   *  set or couldn't be opened.
+   *
+   *  The stream is shared by every resolver this object creates, so
+   *  that a plot covers the whole session.
+   */
+  boost::shared_ptr<search_telemetry> telemetry;
+
+  /** \brief The value of Aptitude::ProblemResolver::Telemetry that
+   *  telemetry was opened from, so that a stream that can't be
+   *  opened is only reported once.
+   */
+  std::string telemetry_target;
+
   /** The number of times the background thread has been suspended; it
    *  will only be allowed to run if this value is 0.
    */
@@ -347,13 +502,21 @@ private:
    */
   bool background_thread_in_resolver;
 
+  /** If \b true, the job that the background thread is running is
+   *  speculative, so foreground threads shouldn't report that the
+   *  resolver is busy.
+   */
+  bool background_thread_speculating;
+
   /** \brief The initial set of installations; used when setting up
    *  the resolver.
    */
   imm::map<aptitude_resolver_package, aptitude_resolver_version> initial_installations;
 
-  /** A lock around pending_jobs, background_thread_killed,
-   *  background_thread_suspend_count, background_thread_in_resolver,
+  /** A lock around pending_jobs, pending_speculative_jobs,
+   *  speculative_solutions, speculative_max_steps,
+   *  background_thread_killed, background_thread_suspend_count,
+   *  background_thread_in_resolver, background_thread_speculating,
    *  resolver_null, and resolver_trace_dir.
    */
   cwidget::threads::mutex background_control_mutex;
@@ -378,6 +541,14 @@ private:
    */
   mutable cwidget::threads::mutex mutex;
 
+  /** Reports the memory used by the resolver; see account_memory(). */
+  aptitude::util::memory_account account;
+
+  /** Add the memory used by the current resolver, if any, to the
+   *  report.  Suspends the background thread while it runs.
+   */
+  void account_memory(aptitude::util::memory_report &report);
+
   void discard_resolver();
   void create_resolver();
 
@@ -418,17 +589,84 @@ private:
   void dump_visited_packages(const std::set<aptitude_resolver_package> &visited_packages,
 			     int solution_number);
 
+  /** \return \b true if a solution that was already generated has
+   *  the same effect as sol.  The caller must hold solutions_mutex.
+   */
+  bool has_solution_with_same_effect(const generic_solution<aptitude_universe> &sol) const;
+
+  /** \brief Test whether a solution is too similar to an earlier
+   *  solution to be offered yet.
+   *
+   *  Must be called with solutions_mutex held.
+   */
+  bool is_too_similar_to_earlier_solution(const generic_solution<aptitude_universe> &sol) const;
+
+  /** \brief Append a solution to the solution list.
+   *
+   *  Must be called with solutions_mutex held.
+   */
+  void add_solution(const generic_solution<aptitude_universe> &sol,
+		    int max_steps);
+
+  /** \brief Move the first held-back solution that doesn't duplicate
+   *  an offered solution to the solution list.
+   *
+   *  Must be called with solutions_mutex held.
+   *
+   *  \return \b false if there was no such solution.
+   */
+  bool release_held_back_solution(int max_steps);
+
+  /** \brief Count the changes that sol makes to the current package
+   *  states.
+   */
+  solution_summary summarize_solution(const generic_solution<aptitude_universe> &sol) const;
+
   /** Low-level code to get a solution; it does not take the global
    *  lock, does not stop a background thread, and must run in the
    *  background.  It is called by background_thread_execution.
    */
   const generic_solution<aptitude_universe> *
-  do_get_solution(int max_steps, unsigned int solution_number,
+  do_get_solution(int max_steps, int max_milliseconds,
+		  unsigned int solution_number,
 		  std::set<aptitude_resolver_package> &visited_packages);
 
   /** The actual background thread. */
   void background_thread_execution();
 
+  /** \brief Queue a job that computes the next solution before it is
+   *  requested, so that stepping through solutions doesn't have to
+   *  wait for the resolver.
+   *
+   *  Nothing is queued if other jobs are pending, if speculation is
+   *  disabled, or if speculative_solutions solutions past the last
+   *  requested one have already been computed.  Speculative jobs run
+   *  after every requested job and are interrupted like any other
+   *  job when the resolver is modified.
+   *
+   *  Must be called with background_control_mutex held.
+   *
+   *  \param max_milliseconds  The time limit of the job.
+   */
+  void maybe_queue_speculative_job(int max_milliseconds);
+
+  /** \brief Record that the given solution was requested or selected,
+   *  and start computing the solutions after it.
+   *
+   *  Must be called with the main lock held, but not solutions_mutex
+   *  or background_control_mutex.
+   */
+  void note_solution_requested(unsigned int solution_num);
+
+  /** \brief Throw away the speculative solutions that could not have
+   *  been produced after the given interaction, and the speculative
+   *  jobs that are pending.
+   *
+   *  Must be called with the main lock held and the background
+   *  thread suspended.
+   */
+  void discard_stale_speculative_solutions(const resolver_interaction &act);
+
   /** Start a background thread if none exists. */
   void start_background_thread();
 
@@ -565,6 +803,33 @@ public:
 			       const boost::shared_ptr<background_continuation> &k,
 			       post_thunk_f post_thunk);
 
+  /** \brief Limit the wall-clock time of each search for a solution.
+   *
+   *  When the limit passes, the search returns the best solution it
+   *  has found so far, or fails with NoMoreTime if it has found
+   *  none.  The step limit passed to get_solution() and
+   *  get_solution_background() still applies.  The new limit takes
+   *  effect for searches that are requested after this call.
+   *
+   *  \param max_milliseconds  The time limit, or 0 for no limit.
+   */
+  void set_time_limit(int max_milliseconds);
+
+  /** \brief Ask for solutions that differ from each other.
+   *
+   *  The resolver tends to produce runs of solutions that only differ
+   *  in a package or two.  With a limit below 100, a solution that
+   *  shares more than the given percentage of its actions with an
+   *  earlier solution is held back, and the search goes on for a
+   *  solution that is more different.  Held-back solutions are
+   *  offered, in order, once the resolver runs out of solutions or
+   *  time, so no solution is lost.  The search itself, and the
+   *  promotions it learns, are shared by all the solutions.
+   *
+   *  \param percent  The largest overlap allowed, from 0 to 100.
+   */
+  void set_max_solution_overlap(int percent);
+
   /** If \b true, all solutions have been generated.  This is equivalent
    *  to the solutions_exhausted member of the state snapshot.
    */
@@ -744,6 +1009,11 @@ public:
    */
   void dump(std::ostream &out);
 
+  /** If a resolver exists, write the timings and counters it has
+   *  collected while searching to the given stream.
+   */
+  void dump_statistics(std::ostream &out);
+
   /** This signal is emitted when the selected solution changes, when
    *  the user takes an action that might change the number of
    *  available solutions (such as un-rejecting a package), and when a
@@ -0,0 +1,199 @@
+// resolver_plan.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include "resolver_plan.h"
+
+#include "apt.h"
+#include "aptcache.h"
+#include "aptitude_resolver_universe.h"
+#include "cache_artifact.h"
+
+#include <aptitude.h>
+#include <loggers.h>
+
+#include <generic/problemresolver/solution.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/md5.h>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+namespace aptitude
+{
+  namespace apt
+  {
+    namespace
+    {
+      const std::string plan_magic = "aptitude resolver plan 1";
+
+      // Removals are written as "-", which is never a valid version
+      // string.
+      const std::string removal_tag = "-";
+
+      void add_version(resolver_plan &plan,
+		       const aptitude_resolver_version &ver,
+		       bool automatic)
+      {
+	const pkgCache::VerIterator apt_ver(ver.get_ver());
+	plan.add(ver.get_pkg().FullName(false),
+		 apt_ver.end() ? std::string() : std::string(apt_ver.VerStr()),
+		 automatic);
+      }
+
+      std::string version_tag(const pkgCache::VerIterator &ver)
+      {
+	return ver.end() ? removal_tag : std::string(ver.VerStr());
+      }
+
+      void describe_config_tree(std::ostream &out,
+				const Configuration::Item *itm)
+      {
+	for( ; itm != NULL; itm = itm->Next)
+	  {
+	    out << itm->FullTag() << '=' << itm->Value << '\n';
+	    describe_config_tree(out, itm->Child);
+	  }
+      }
+    }
+
+    resolver_plan::resolver_plan(const generic_solution<aptitude_universe> &solution)
+    {
+      // The same versions, in the same order, that apply_solution()
+      // installs.
+      std::set<aptitude_resolver_version> initial_versions;
+      solution.get_initial_state().get_initial_versions(initial_versions);
+      for(std::set<aptitude_resolver_version>::const_iterator it =
+	    initial_versions.begin(); it != initial_versions.end(); ++it)
+	add_version(*this, *it, false);
+
+      for(generic_choice_set<aptitude_universe>::const_iterator it =
+	    solution.get_choices().begin();
+	  it != solution.get_choices().end(); ++it)
+	if(it->get_type() == generic_choice<aptitude_universe>::install_version)
+	  add_version(*this, it->get_ver(), true);
+    }
+
+    bool resolver_plan::save(const std::string &path,
+			     const std::string &fingerprint) const
+    {
+      cache_artifact_writer writer(path, plan_magic, fingerprint,
+				   "resolver plan",
+				   Loggers::getAptitudeResolver());
+      if(!writer.is_open())
+	return false;
+
+      std::ostream &out(writer.get_stream());
+      for(std::vector<entry>::const_iterator it = entries.begin();
+	  it != entries.end(); ++it)
+	out << (it->automatic ? 'A' : 'I') << ' '
+	    << it->package << ' '
+	    << (it->version.empty() ? removal_tag : it->version) << '\n';
+
+      return writer.commit();
+    }
+
+    bool resolver_plan::load(const std::string &path,
+			     const std::string &fingerprint)
+    {
+      util::logging::LoggerPtr logger(Loggers::getAptitudeResolver());
+
+      entries.clear();
+
+      cache_artifact_reader reader(path, plan_magic, fingerprint,
+				   "resolver plan", logger);
+      if(!reader.is_valid())
+	return false;
+
+      std::istream &in(reader.get_stream());
+      std::vector<entry> loaded;
+      std::string line;
+      while(std::getline(in, line))
+	{
+	  std::istringstream line_in(line);
+	  std::string tag, package, version, extra;
+	  if(!(line_in >> tag >> package >> version) ||
+	     (line_in >> extra) ||
+	     (tag != "A" && tag != "I"))
+	    {
+	      LOG_WARN(logger, "Ignoring " << path << ": it is damaged.");
+	      return false;
+	    }
+
+	  loaded.push_back(entry(package,
+				 version == removal_tag ? std::string() : version,
+				 tag == "A"));
+	}
+
+      entries.swap(loaded);
+      LOG_DEBUG(logger, "Loaded a resolver plan with " << entries.size()
+		<< " entries from " << path);
+      return true;
+    }
+
+    std::string get_resolver_plan_fingerprint(aptitudeDepCache &cache,
+					      const std::string &context)
+    {
+      std::ostringstream settings;
+      settings << context << '\n';
+      const Configuration::Item * const resolver_settings =
+	aptcfg->Tree(PACKAGE "::ProblemResolver");
+      if(resolver_settings != NULL)
+	describe_config_tree(settings, resolver_settings->Child);
+      settings << aptcfg->FindB("Apt::Install-Recommends", true) << '\n'
+	       << aptcfg->FindI(PACKAGE "::CmdLine::Request-Strictness", 10000) << '\n';
+
+      MD5Summation sum;
+      sum.Add(settings.str().c_str());
+
+      // The order of the package array depends on how the cache was
+      // built, so sort the packages before hashing them.
+      std::vector<std::string> packages;
+      for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+	{
+	  if(pkg.VersionList().end())
+	    continue;
+
+	  const pkgDepCache::StateCache &state(cache[pkg]);
+	  const aptitudeDepCache::aptitude_state &ext_state(cache.get_ext_state(pkg));
+
+	  std::string line(pkg.FullName(false));
+	  line += ' ';
+	  line += version_tag(pkg.CurrentVer());
+	  line += ' ';
+	  line += version_tag(state.CandidateVerIter(cache));
+	  line += ' ';
+	  line += version_tag(state.InstVerIter(cache));
+	  line += ext_state.selection_state == pkgCache::State::Hold ? " hold " : " - ";
+	  line += ext_state.forbidver.get();
+	  line += '\n';
+
+	  packages.push_back(line);
+	}
+
+      std::sort(packages.begin(), packages.end());
+      for(std::vector<std::string>::const_iterator it = packages.begin();
+	  it != packages.end(); ++it)
+	sum.Add(it->c_str());
+
+      return sum.Result().Value();
+    }
+  }
+}
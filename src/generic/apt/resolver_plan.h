@@ -0,0 +1,146 @@
+/** \file resolver_plan.h */ // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef RESOLVER_PLAN_H
+#define RESOLVER_PLAN_H
+
+#include <string>
+#include <vector>
+
+class aptitudeDepCache;
+class aptitude_universe;
+template<typename PackageUniverse> class generic_solution;
+
+namespace aptitude
+{
+  namespace apt
+  {
+    /** \brief A resolver solution that can be applied on another
+     *  system.
+     *
+     *  Solutions refer to packages and versions through the package
+     *  cache, so they only make sense to the process that computed
+     *  them.  A plan instead stores each package by its full name
+     *  and each version by its version string, so that a solution
+     *  found on one system can be saved and applied to other systems
+     *  that are in the same state, without searching for it again.
+     *
+     *  Plans are saved together with the fingerprint returned by
+     *  get_resolver_plan_fingerprint(), and are only loaded when the
+     *  fingerprint of the system loading them matches.
+     */
+    class resolver_plan
+    {
+    public:
+      /** \brief One package whose state the plan sets. */
+      struct entry
+      {
+	/** \brief The package's full name, including its architecture. */
+	std::string package;
+
+	/** \brief The version to install, or an empty string to
+	 *  remove the package.
+	 */
+	std::string version;
+
+	/** \brief \b true if the resolver chose this version; \b false
+	 *  if it was part of the state the resolver started from.
+	 */
+	bool automatic;
+
+	entry(const std::string &_package,
+	      const std::string &_version,
+	      bool _automatic)
+	  : package(_package), version(_version), automatic(_automatic)
+	{
+	}
+      };
+
+    private:
+      std::vector<entry> entries;
+
+    public:
+      /** \brief Create an empty plan. */
+      resolver_plan()
+      {
+      }
+
+      /** \brief Create a plan that has the same effect as the given
+       *  solution.
+       *
+       *  Choices to break soft dependencies are left out: applying a
+       *  solution only installs and removes packages.
+       */
+      explicit resolver_plan(const generic_solution<aptitude_universe> &solution);
+
+      const std::vector<entry> &get_entries() const { return entries; }
+
+      void add(const std::string &package,
+	       const std::string &version,
+	       bool automatic)
+      {
+	entries.push_back(entry(package, version, automatic));
+      }
+
+      /** \brief Write this plan to a file.
+       *
+       *  \param path         The file to write.
+       *  \param fingerprint  The fingerprint of the system the plan
+       *                      was computed on.
+       *
+       *  \return \b true if the file was written.
+       */
+      bool save(const std::string &path,
+		const std::string &fingerprint) const;
+
+      /** \brief Replace this plan with one read from a file.
+       *
+       *  \param path         The file to read.
+       *  \param fingerprint  The fingerprint of the system the plan
+       *                      is going to be applied to.
+       *
+       *  \return \b true if the file exists, was saved for the given
+       *  fingerprint and isn't damaged.  If the result is \b false,
+       *  the plan is left empty and the reason is logged.
+       */
+      bool load(const std::string &path,
+		const std::string &fingerprint);
+    };
+
+    /** \brief Compute a string that identifies the problem the
+     *  resolver is about to solve.
+     *
+     *  Unlike get_cache_fingerprint(), this only looks at the
+     *  contents of the cache and not at the cache file itself, so two
+     *  systems with the same packages available, the same packages
+     *  installed and the same actions requested have the same
+     *  fingerprint.  The resolver configuration is included, since it
+     *  changes which solution is chosen.
+     *
+     *  \param cache    The cache whose state should be described.
+     *  \param context  A string identifying how the resolver is going
+     *                  to be run (e.g., "safe-upgrade"); plans that
+     *                  were computed in another context don't match.
+     */
+    std::string get_resolver_plan_fingerprint(aptitudeDepCache &cache,
+					      const std::string &context);
+  }
+}
+
+#endif // RESOLVER_PLAN_H
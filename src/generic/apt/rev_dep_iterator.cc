@@ -0,0 +1,78 @@
+// rev_dep_iterator.cc
+//
+// Copyright 2004 Daniel Burrows
+
+#include "rev_dep_iterator.h"
+
+#include "aptcache.h"
+
+#include <sigc++/functors/ptr_fun.h>
+
+static rev_dep_index *the_rev_dep_index = NULL;
+
+static void reset_rev_dep_index()
+{
+  delete the_rev_dep_index;
+  the_rev_dep_index = NULL;
+}
+
+static void append_rev_deps(const pkgCache::PkgIterator &pkg,
+			    std::vector<rev_dep_edge> &edges)
+{
+  for(pkgCache::DepIterator dep = pkg.RevDependsList(); !dep.end(); ++dep)
+    {
+      rev_dep_edge edge;
+      edge.dep = dep->ID;
+      edge.type = dep->Type;
+      edges.push_back(edge);
+    }
+}
+
+static void build_rev_dep_index(pkgCache &cache, rev_dep_index &index)
+{
+  const unsigned long package_count = cache.Head().PackageCount;
+  const unsigned long version_count = cache.Head().VersionCount;
+
+  index.edges.reserve(cache.Head().DependsCount);
+  index.package_start.resize(package_count);
+  index.direct_end.resize(package_count);
+  index.package_end.resize(package_count);
+  index.version_start.resize(version_count);
+  index.version_end.resize(version_count);
+
+  for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+    {
+      index.package_start[pkg->ID] = index.edges.size();
+
+      append_rev_deps(pkg, index.edges);
+      index.direct_end[pkg->ID] = index.edges.size();
+
+      for(pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver)
+	{
+	  index.version_start[ver->ID] = index.edges.size();
+	  for(pkgCache::PrvIterator prv = ver.ProvidesList(); !prv.end(); ++prv)
+	    append_rev_deps(prv.ParentPkg(), index.edges);
+	  index.version_end[ver->ID] = index.edges.size();
+	}
+
+      index.package_end[pkg->ID] = index.edges.size();
+    }
+}
+
+const rev_dep_index &get_rev_dep_index()
+{
+  if(the_rev_dep_index == NULL)
+    {
+      static bool connected_reset = false;
+      if(!connected_reset)
+	{
+	  cache_closed.connect(sigc::ptr_fun(&reset_rev_dep_index));
+	  connected_reset = true;
+	}
+
+      the_rev_dep_index = new rev_dep_index;
+      build_rev_dep_index((*apt_cache_file)->GetCache(), *the_rev_dep_index);
+    }
+
+  return *the_rev_dep_index;
+}
@@ -7,60 +7,139 @@
 
 #include <apt-pkg/cacheiterators.h>
 
+#include <vector>
+
 #include "apt.h"
 
 /** \file rev_dep_iterator.h
  */
 
+/** \brief One reverse dependency stored in the rev_dep_index. */
+struct rev_dep_edge
+{
+  /** \brief The ID of the dependency. */
+  unsigned int dep;
+
+  /** \brief The type of the dependency, copied so that edges can be
+   *  filtered without touching the dependency itself.
+   */
+  unsigned char type;
+};
+
+/** \brief The reverse dependencies of every package, including those
+ *  that are via a Provided package, laid out in one array.
+ *
+ *  Built the first time it is needed and discarded when the cache is
+ *  closed.  The edges of the package with ID n are
+ *  edges[package_start[n]] up to edges[package_end[n]]: first the
+ *  dependencies on the package itself, up to direct_end[n], and then,
+ *  for each version in turn, the dependencies on what it Provides,
+ *  from version_start[v] up to version_end[v].  This is the order in
+ *  which walking the lists of the cache visits them.
+ */
+struct rev_dep_index
+{
+  std::vector<rev_dep_edge> edges;
+  std::vector<unsigned int> package_start;
+  std::vector<unsigned int> direct_end;
+  std::vector<unsigned int> package_end;
+  std::vector<unsigned int> version_start;
+  std::vector<unsigned int> version_end;
+};
+
+/** \brief Retrieve the reverse dependency index of the current
+ *  cache, building it if necessary.
+ */
+const rev_dep_index &get_rev_dep_index();
+
+/** \return a mask for rev_dep_iterator that accepts only dependencies
+ *  of the given type.
+ */
+inline unsigned int rev_dep_type_mask(unsigned char type)
+{
+  return 1U << type;
+}
+
 /** An iterator that iterates over all reverse deps of a package,
  *  including those that are via a Provided package.
+ *
+ *  The dependencies are read from the rev_dep_index, so iterating
+ *  doesn't chase the linked lists of the cache.
  */
 class rev_dep_iterator
 {
-  pkgCache::DepIterator rev_dep_lst;
-  pkgCache::PrvIterator prv_lst;
-  pkgCache::VerIterator ver_lst;
+  pkgCache *cache;
+
+  /** The edges that remain in the current range. */
+  const rev_dep_edge *current, *current_end;
+  /** The range to move to after the current one, if any. */
+  const rev_dep_edge *next, *next_end;
+
+  /** Which dependency types to return, as a combination of
+   *  rev_dep_type_mask() values.
+   */
+  unsigned int types;
 
-  /** Moves the internal DepIterator to the start of the next
-   *  dependency list, if necessary.
+  /** Moves to the next edge whose type is accepted, switching to the
+   *  second range if necessary.
    */
   void normalize()
   {
-    while(rev_dep_lst.end() && prv_lst.end() && !ver_lst.end())
+    while(true)
       {
-	prv_lst = ver_lst.ProvidesList();
-	++ver_lst;
+	while(current != current_end &&
+	      (types & rev_dep_type_mask(current->type)) == 0)
+	  ++current;
+
+	if(current != current_end || next == next_end)
+	  return;
+
+	current = next;
+	current_end = next_end;
+	next = next_end;
       }
+  }
 
-    while(rev_dep_lst.end() && !prv_lst.end())
+  /** Find the edges from begin up to end in the index. */
+  static void get_range(unsigned int begin, unsigned int end,
+			const rev_dep_index &index,
+			const rev_dep_edge *&first,
+			const rev_dep_edge *&last)
+  {
+    if(begin == end)
+      first = last = NULL;
+    else
       {
-	rev_dep_lst=prv_lst.ParentPkg().RevDependsList();
-	++prv_lst;
-
-	// If we're out of provides, try to snarf another version off
-	// the version list.
-	while(prv_lst.end() && !ver_lst.end())
-	  {
-	    prv_lst=ver_lst.ProvidesList();
-	    ++ver_lst;
-	  }
+	first = &index.edges[0] + begin;
+	last = &index.edges[0] + end;
       }
   }
+
 public:
+  /** \brief A type mask that accepts every dependency. */
+  static const unsigned int all_types = ~0U;
+
   /** Create a new rev_dep_iterator.
    *
    *  \param ver the version whose reverse dependencies are to be
    *  enumerated.
+   *  \param _types which dependency types to enumerate.
    */
-  rev_dep_iterator(pkgCache::VerIterator ver)
-    :rev_dep_lst(*apt_cache_file, NULL, (pkgCache::Version *) NULL),
-     prv_lst(*apt_cache_file, NULL, (pkgCache::Version *) NULL),
-     ver_lst(*apt_cache_file, (pkgCache::Version *) NULL)
+  rev_dep_iterator(pkgCache::VerIterator ver,
+		   unsigned int _types = all_types)
+    :cache(&(*apt_cache_file)->GetCache()),
+     current(NULL), current_end(NULL), next(NULL), next_end(NULL),
+     types(_types)
   {
     if(!ver.end())
       {
-	rev_dep_lst=ver.ParentPkg().RevDependsList();
-	prv_lst=ver.ProvidesList();
+	const rev_dep_index &index(get_rev_dep_index());
+	const unsigned long pkg_id = ver.ParentPkg()->ID;
+
+	get_range(index.package_start[pkg_id], index.direct_end[pkg_id],
+		  index, current, current_end);
+	get_range(index.version_start[ver->ID], index.version_end[ver->ID],
+		  index, next, next_end);
       }
 
     normalize();
@@ -71,30 +150,37 @@ public:
    *  \param pkg the package whose reverse dependencies are to be
    *  enumerated.  (without respect to a particular version, but
    *  including provides)
+   *  \param _types which dependency types to enumerate.
    */
-  rev_dep_iterator(pkgCache::PkgIterator pkg)
-    :rev_dep_lst(*apt_cache_file, NULL, (pkgCache::Version *) NULL),
-     prv_lst(*apt_cache_file, NULL, (pkgCache::Version *) NULL),
-     ver_lst(*apt_cache_file, (pkgCache::Version *) NULL)
+  rev_dep_iterator(pkgCache::PkgIterator pkg,
+		   unsigned int _types = all_types)
+    :cache(&(*apt_cache_file)->GetCache()),
+     current(NULL), current_end(NULL), next(NULL), next_end(NULL),
+     types(_types)
   {
     if(!pkg.end())
       {
-	rev_dep_lst=pkg.RevDependsList();
+	const rev_dep_index &index(get_rev_dep_index());
 
-	ver_lst=pkg.VersionList();
+	get_range(index.package_start[pkg->ID],
+		  index.package_end[pkg->ID],
+		  index, current, current_end);
       }
 
     normalize();
   }
 
   /** \return the dependency to which this iterator currently points. */
-  pkgCache::DepIterator operator*() const {return rev_dep_lst;}
+  pkgCache::DepIterator operator*() const
+  {
+    return pkgCache::DepIterator(*cache, cache->DepP + current->dep);
+  }
 
   /** \return \b true iff the iterator is at the end of its list. */
-  bool end() const {return rev_dep_lst.end();}
+  bool end() const {return current == current_end;}
 
   /** Advance the iterator to the next element of the list. */
-  void operator++() {++rev_dep_lst; normalize();}
+  void operator++() {++current; normalize();}
 };
 
 #endif // REV_DEP_ITERATOR_H
@@ -32,6 +32,10 @@ namespace aptitude
 		 post_thunk_f post_thunk)
   {
     std::string uri, short_description;
+    // Thumbnails are shown as a side effect of browsing packages,
+    // but a full-size screenshot is only fetched when the user asks
+    // for it.
+    download_priority priority = download_priority_normal;
     switch(key.get_type())
       {
       case screenshot_thumbnail:
@@ -48,11 +52,12 @@ namespace aptitude
 	       % key.get_package_name()).str();
 	short_description = (boost::format("Screenshot of %s")
 			     % key.get_package_name()).str();
+	priority = download_priority_high;
 	break;
       }
 
     return queue_download(uri, short_description,
-			  callbacks, post_thunk);
+			  callbacks, post_thunk, priority);
   }
 
   std::ostream &operator<<(std::ostream &out, const screenshot_key &key)
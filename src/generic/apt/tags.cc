@@ -52,7 +52,7 @@ tag::tag(std::string::const_iterator start,
   while(start != finish && isspace(*(finish-1)))
     --finish;
 
-  s.assign(start, finish);
+  s = std::string(start, finish);
 }
 
 tag::const_iterator &tag::const_iterator::operator++()
@@ -75,7 +75,8 @@ tag::const_iterator &tag::const_iterator::operator++()
 
 tag::const_iterator tag::begin() const
 {
-  tag::const_iterator rval(s.begin(), s.begin(), s.end());
+  const std::string &text(s.get());
+  tag::const_iterator rval(text.begin(), text.begin(), text.end());
 
   ++rval;
 
@@ -84,6 +85,9 @@ tag::const_iterator tag::begin() const
 
 int tag::cmp(const tag &other) const
 {
+  if(s == other.s)
+    return 0;
+
   const_iterator myT=begin(), otherT=other.begin();
 
   while(myT != end() && otherT != other.end())
@@ -143,9 +147,9 @@ tag_list::const_iterator tag_list::begin() const
 
 typedef set<tag> db_entry;
 
-// The database is built eagerly, since the common use case is
-// to scan everything in sight right away and this makes it easy
-// to provide a progress bar to the user.
+// The database is built the first time it is needed, since reading
+// the Tag field means looking up the record of every version; most
+// command-line runs never look at tags.
 db_entry *tagDB;
 
 static void insert_tags(const pkgCache::VerIterator &ver,
@@ -181,26 +185,8 @@ static void reset_tags()
   tagDB = NULL;
 }
 
-const set<tag> *get_tags(const pkgCache::PkgIterator &pkg)
-{
-  if(!apt_cache_file || !tagDB)
-    return NULL;
-
-  return tagDB + pkg->ID;
-}
-
-bool initialized_reset_signal;
-void load_tags(OpProgress &progress)
+static void build_tag_database()
 {
-  eassert(apt_cache_file && apt_package_records);
-
-  if(!initialized_reset_signal)
-    {
-      cache_closed.connect(sigc::ptr_fun(reset_tags));
-      cache_reload_failed.connect(sigc::ptr_fun(reset_tags));
-      initialized_reset_signal = true;
-    }
-
   tagDB = new db_entry[(*apt_cache_file)->Head().PackageCount];
 
   std::vector<loc_pair> verfiles;
@@ -214,18 +200,38 @@ void load_tags(OpProgress &progress)
 
   sort(verfiles.begin(), verfiles.end(), location_compare());
 
-  progress.OverallProgress(0, verfiles.size(), 1,
-			   _("Building tag database"));
-  size_t n=0;
   for(std::vector<loc_pair>::iterator i=verfiles.begin();
       i!=verfiles.end(); ++i)
+    insert_tags(i->first, i->second);
+}
+
+// Set by load_tags() in low-memory mode, where the database is
+// never built.
+static bool tags_disabled;
+
+const set<tag> *get_tags(const pkgCache::PkgIterator &pkg)
+{
+  if(!apt_cache_file || !apt_package_records || tags_disabled)
+    return NULL;
+
+  if(!tagDB)
+    build_tag_database();
+
+  return tagDB + pkg->ID;
+}
+
+bool initialized_reset_signal;
+void load_tags()
+{
+  if(!initialized_reset_signal)
     {
-      insert_tags(i->first, i->second);
-      ++n;
-      progress.OverallProgress(n, verfiles.size(), 1, _("Building tag database"));
+      cache_closed.connect(sigc::ptr_fun(reset_tags));
+      cache_reload_failed.connect(sigc::ptr_fun(reset_tags));
+      initialized_reset_signal = true;
     }
 
-  progress.Done();
+  reset_tags();
+  tags_disabled = apt_low_memory_mode();
 }
 
 
@@ -337,6 +343,10 @@ namespace aptitude
     const ept::debtags::Vocabulary *debtagsVocabulary;
 #endif
 
+    // Set once we have tried to open the database, even if that
+    // failed, so that a missing database is only looked for once.
+    bool debtags_opened;
+
     void reset_tags()
     {
       delete debtagsDB;
@@ -346,17 +356,20 @@ namespace aptitude
       delete debtagsVocabulary;
       debtagsVocabulary = NULL;
 #endif
+
+      debtags_opened = false;
     }
 
-    bool initialized_reset_signal;
-    void load_tags()
+    // The database is opened the first time it is needed.
+    void open_tags_database()
     {
-      if(!initialized_reset_signal)
-	{
-	  cache_closed.connect(sigc::ptr_fun(reset_tags));
-	  cache_reload_failed.connect(sigc::ptr_fun(reset_tags));
-	  initialized_reset_signal = true;
-	}
+      if(debtags_opened || !apt_cache_file)
+	return;
+
+      debtags_opened = true;
+
+      if(apt_low_memory_mode())
+	return;
 
       try
 	{
@@ -376,8 +389,23 @@ namespace aptitude
 	}
     }
 
+    bool initialized_reset_signal;
+    void load_tags()
+    {
+      if(!initialized_reset_signal)
+	{
+	  cache_closed.connect(sigc::ptr_fun(reset_tags));
+	  cache_reload_failed.connect(sigc::ptr_fun(reset_tags));
+	  initialized_reset_signal = true;
+	}
+
+      reset_tags();
+    }
+
     const std::set<tag> get_tags(const pkgCache::PkgIterator &pkg)
     {
+      open_tags_database();
+
       if(!apt_cache_file || !debtagsDB)
 	return std::set<tag>();
 
@@ -426,6 +454,8 @@ namespace aptitude
 #ifdef HAVE_EPT_DEBTAGS_VOCABULARY_FACET_DATA
     std::string get_facet_long_description(const tag &t)
     {
+      open_tags_database();
+
       if(debtagsVocabulary == NULL)
         return _("No tag descriptions are available.");
 
@@ -441,6 +471,8 @@ namespace aptitude
 
     std::string get_facet_short_description(const tag &t)
     {
+      open_tags_database();
+
       if(debtagsVocabulary == NULL)
         return _("No tag descriptions are available.");
 
@@ -472,6 +504,8 @@ namespace aptitude
 #ifdef HAVE_EPT_DEBTAGS_VOCABULARY_TAG_DATA
     std::string get_tag_long_description(const tag &t)
     {
+      open_tags_database();
+
       if(debtagsVocabulary == NULL)
         return _("No tag descriptions are available.");
 
@@ -487,6 +521,8 @@ namespace aptitude
 
     std::string get_tag_short_description(const tag &t)
     {
+      open_tags_database();
+
       if(debtagsVocabulary == NULL)
         return _("No tag descriptions are available.");
 
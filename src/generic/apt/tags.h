@@ -39,16 +39,22 @@
 
 #include <apt-pkg/pkgcache.h>
 
+#include <generic/util/interned.h>
+
 /** \brief A parser for tags.
  * 
  *  \file tags.h
  */
 
-class OpProgress;
-
 class tag
 {
-  std::string s;
+  /** \brief The text of the tag.
+   *
+   *  The same tags are attached to thousands of packages, so each
+   *  distinct tag is stored only once; comparing a tag with another
+   *  copy of itself is then a pointer comparison.
+   */
+  interned<std::string> s;
 
   int cmp(const tag &other) const;
 public:
@@ -135,12 +141,12 @@ public:
   const_iterator begin() const;
   const_iterator end() const
   {
-    return const_iterator(s.end(), s.end(), s.end());
+    return const_iterator(s.get().end(), s.get().end(), s.get().end());
   }
 
   std::string str() const
   {
-    return s;
+    return s.get();
   }
 };
 
@@ -209,8 +215,10 @@ public:
 // Grab the tags for the given package:
 const std::set<tag> *get_tags(const pkgCache::PkgIterator &pkg);
 
-// Load tags for all packages (call before get_tags)
-void load_tags(OpProgress &progress);
+// Prepare to read tags from a newly loaded cache (call before
+// get_tags).  The tags themselves are read the first time get_tags()
+// is invoked.
+void load_tags();
 
 
 
@@ -255,7 +263,11 @@ namespace aptitude
 
     const std::set<tag> get_tags(const pkgCache::PkgIterator &pkg);
 
-    /** \brief Initialize the cache of debtags information. */
+    /** \brief Initialize the cache of debtags information.
+     *
+     *  The debtags database is not opened until the first time tags
+     *  are retrieved, so this is cheap.
+     */
     void load_tags();
 
     /** \brief Get the name of the facet corresponding to a tag. */
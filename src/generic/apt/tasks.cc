@@ -25,72 +25,129 @@ using namespace std;
 
 map<string, task> *task_list=new map<string, task>;
 
-// This is an array indexed by package ID, managed by load_tasks.
-// (as usual, it's initialized to NULL)
-set<string> *tasks_by_package;
+// The tasks of every package, built the first time they are needed,
+// since that means looking at the record of every version, and
+// discarded by load_tasks() and reset_tasks().
+//
+// The tasks of the package with ID n are the IDs from
+// package_task_ids[package_task_offsets[n]] up to
+// package_task_ids[package_task_offsets[n + 1]]; package_task_offsets
+// is empty until the tasks are built.  Most packages belong to no
+// task, so this is much smaller than a set per package.
+static vector<string> task_names;
+static vector<unsigned int> package_task_offsets;
+static vector<task_id> package_task_ids;
+
+static void build_tasks_by_package();
+
+static void discard_tasks_by_package()
+{
+  vector<string>().swap(task_names);
+  vector<unsigned int>().swap(package_task_offsets);
+  vector<task_id>().swap(package_task_ids);
+}
 
-// Now this is just a wrapper, as you can see..
-std::set<std::string> *get_tasks(const pkgCache::PkgIterator &pkg)
+task_id_range get_task_ids(const pkgCache::PkgIterator &pkg)
 {
-  if(!tasks_by_package)
-    return NULL;
+  if(!apt_cache_file || !apt_package_records)
+    return task_id_range(NULL, NULL);
 
-  return tasks_by_package+pkg->ID;
+  if(package_task_offsets.empty())
+    build_tasks_by_package();
+
+  if(package_task_ids.empty())
+    return task_id_range(NULL, NULL);
+
+  const task_id * const ids = &package_task_ids[0];
+  return task_id_range(ids + package_task_offsets[pkg->ID],
+		       ids + package_task_offsets[pkg->ID + 1]);
 }
 
-/** \brief Add any tasks found in the given version-file pointer to
- *  the tasks of the given package.
- */
-static void append_tasks(const pkgCache::PkgIterator &pkg,
-			 const pkgCache::VerFileIterator &verfile)
+const std::string &get_task_name(task_id id)
 {
-  // This should never be called before load_tasks has initialized the
-  // tasks structure.
-  eassert(tasks_by_package);
+  eassert(id < task_names.size());
 
-  if(strcmp(pkg.Name(), "kdeadmin") == 0)
-    eassert(pkg.Name());
+  return task_names[id];
+}
 
-  set<string> &task_set=tasks_by_package[pkg->ID];
+bool find_task_id(const std::string &name, task_id &id)
+{
+  if(!apt_cache_file || !apt_package_records)
+    return false;
 
-  if(apt_package_records)
-    {
-      const char *start,*stop;
-      pkgTagSection sec;
+  if(package_task_offsets.empty())
+    build_tasks_by_package();
 
-      // Pull out pointers to the underlying record.
-      apt_package_records->Lookup(verfile).GetRec(start, stop);
+  const vector<string>::const_iterator found =
+    lower_bound(task_names.begin(), task_names.end(), name);
+  if(found == task_names.end() || *found != name)
+    return false;
 
-      // Parse it as a section.
-      sec.Scan(start, stop-start+1);
+  id = found - task_names.begin();
+  return true;
+}
 
-      string tasks=sec.FindS("Task");
+/** \brief A task a package belongs to, identified by the order in
+ *  which its name was first seen.
+ */
+typedef pair<unsigned long, task_id> task_membership;
 
-      string::size_type loc=0, firstcomma=0;
+/** \brief Add any tasks found in the given version-file pointer to
+ *  the memberships being collected.
+ *
+ *  \param pkg          The package to which verfile belongs.
+ *  \param verfile      The version-file whose record should be read.
+ *  \param ids_by_name  The temporary ID of each task name seen so far.
+ *  \param memberships  Where to store the tasks of pkg.
+ */
+static void append_tasks(const pkgCache::PkgIterator &pkg,
+			 const pkgCache::VerFileIterator &verfile,
+			 map<string, task_id> &ids_by_name,
+			 vector<task_membership> &memberships)
+{
+  const char *start,*stop;
+  pkgTagSection sec;
+
+  // Pull out pointers to the underlying record.
+  apt_package_records->Lookup(verfile).GetRec(start, stop);
+  if(!start || !stop)
+    return;
+
+  // Parse it as a section.
+  if(!sec.Scan(start, stop-start+1))
+    return;
 
+  const char *tasks, *tasks_end;
+  if(!sec.Find("Task", tasks, tasks_end))
+    return;
+
+  while(tasks != tasks_end)
+    {
       // Strip leading whitespace
-      while(loc<tasks.size() && isspace(tasks[loc]))
-	++loc;
+      while(tasks != tasks_end && isspace(*tasks))
+	++tasks;
 
-      while( (firstcomma=tasks.find(',', loc))!=tasks.npos)
+      const char *comma = tasks;
+      while(comma != tasks_end && *comma != ',')
+	++comma;
+
+      // Strip trailing whitespace
+      const char *name_end = comma;
+      while(name_end != tasks && isspace(name_end[-1]))
+	--name_end;
+
+      if(name_end != tasks)
 	{
-	  // Strip trailing whitespace
-	  string::size_type loc2=firstcomma-1;
-	  while(isspace(tasks[loc2]))
-	    --loc2;
-	  ++loc2;
-
-	  string taskname(tasks, loc, loc2-loc);
-	  task_set.insert(taskname);
-	  loc=firstcomma+1;
-
-	  // Strip leading whitespace
-	  while(loc<tasks.size() && isspace(tasks[loc]))
-	    ++loc;
+	  const map<string, task_id>::value_type
+	    entry(string(tasks, name_end), ids_by_name.size());
+	  const task_id id = ids_by_name.insert(entry).first->second;
+
+	  memberships.push_back(task_membership(pkg->ID, id));
 	}
 
-      if(loc!=tasks.size())
-	task_set.insert(string(tasks, loc));
+      tasks = comma;
+      if(tasks != tasks_end)
+	++tasks;
     }
 }
 
@@ -114,20 +171,15 @@ bool task::keys_present()
 	// Here it is assumed that all the tasks are loaded, because
 	// we're going to look them up.
 	{
-	  set<string> *tasks = get_tasks(pkg);
+	  task_id id;
+	  const task_id_range tasks = get_task_ids(pkg);
 
-	  if(!tasks)
+	  if(!find_task_id(name, id) ||
+	     !binary_search(tasks.first, tasks.second, id))
 	    {
 	      keys_present_cache=false;
 	      return false;
 	    }
-
-	  if(tasks->find(name) == tasks->end())
-	    {
-	      keys_present_cache=false;
-	      return false;
-	      break;
-	    }
 	}
     }
 
@@ -227,16 +279,13 @@ static string rfc822dgettext(string textdomain, string msgid)
   return msgstr;
 }
 
-void load_tasks(OpProgress &progress)
+static void build_tasks_by_package()
 {
   // Build a list for each package of the tasks that package belongs to.
   //
   // Sorting by location on disk is *critical* -- otherwise, this operation
   // will take ages.
 
-  // This is done prior to loading the task descriptions so that I can just
-  // bail if that fails.
-
   vector<loc_pair> versionfiles;
 
   for(pkgCache::PkgIterator pkg=(*apt_cache_file)->PkgBegin();
@@ -253,14 +302,57 @@ void load_tasks(OpProgress &progress)
 
   sort(versionfiles.begin(), versionfiles.end(), location_compare());
 
-  // Allocate and set up the table of task information.
-  delete[] tasks_by_package;
-  tasks_by_package = new set<string>[(*apt_cache_file)->Head().PackageCount];
+  map<string, task_id> ids_by_name;
+  vector<task_membership> memberships;
 
   for(vector<loc_pair>::iterator i=versionfiles.begin();
       i!=versionfiles.end();
       ++i)
-    append_tasks(i->first.ParentPkg(), i->second);
+    append_tasks(i->first.ParentPkg(), i->second, ids_by_name, memberships);
+
+  // Renumber the tasks in the order of their names, so that the
+  // tasks of a package come out in the same order as before.
+  discard_tasks_by_package();
+  task_names.reserve(ids_by_name.size());
+  vector<task_id> final_ids(ids_by_name.size());
+  for(map<string, task_id>::const_iterator it = ids_by_name.begin();
+      it != ids_by_name.end(); ++it)
+    {
+      final_ids[it->second] = task_names.size();
+      task_names.push_back(it->first);
+    }
+
+  for(vector<task_membership>::iterator it = memberships.begin();
+      it != memberships.end(); ++it)
+    it->second = final_ids[it->second];
+
+  // Several versions of a package usually name the same tasks.
+  sort(memberships.begin(), memberships.end());
+  memberships.erase(unique(memberships.begin(), memberships.end()),
+		    memberships.end());
+
+  const unsigned long package_count = (*apt_cache_file)->Head().PackageCount;
+  package_task_offsets.reserve(package_count + 1);
+  package_task_ids.reserve(memberships.size());
+  vector<task_membership>::const_iterator next = memberships.begin();
+  for(unsigned long id = 0; id < package_count; ++id)
+    {
+      package_task_offsets.push_back(package_task_ids.size());
+      for( ; next != memberships.end() && next->first == id; ++next)
+	package_task_ids.push_back(next->second);
+    }
+  package_task_offsets.push_back(package_task_ids.size());
+}
+
+void load_tasks(OpProgress &progress)
+{
+  // The tasks of each package are only found when they're needed.
+  discard_tasks_by_package();
+
+  // The descriptions are only used to display tasks, so they're
+  // worth skipping when memory is tight.
+  if(apt_low_memory_mode())
+    return;
 
   FileFd task_file;
 
@@ -334,6 +426,5 @@ void load_tasks(OpProgress &progress)
 void reset_tasks()
 {
   task_list->clear();
-  delete[] tasks_by_package;
-  tasks_by_package=NULL;
+  discard_tasks_by_package();
 }
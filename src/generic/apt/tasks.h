@@ -6,6 +6,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <utility>
 #include <apt-pkg/pkgcache.h>
 
 /** \brief Handles parsing the list of tasks and getting the task of a given
@@ -40,18 +41,45 @@ public:
   int relevance;
 };
 
-/** \brief Get the set of tasks associated with the given package.
+/** \brief Identifies the name of a task that some package belongs
+ *  to.
  *
- *  The caller should not delete this set; it's managed internally by
- *  the tasks module.
+ *  Task IDs are assigned in the order of the task names, and are only
+ *  valid until the task list is reloaded or reset.
  */
-std::set<std::string> *get_tasks(const pkgCache::PkgIterator &pkg);
+typedef unsigned int task_id;
+
+/** \brief A range [first, second) of task IDs, in increasing order. */
+typedef std::pair<const task_id *, const task_id *> task_id_range;
+
+/** \brief Get the tasks associated with the given package.
+ *
+ *  \return the IDs of the tasks named in the Task fields of the
+ *  package's versions, or an empty range if the package records are
+ *  not available.  The range is managed internally by the tasks
+ *  module.
+ */
+task_id_range get_task_ids(const pkgCache::PkgIterator &pkg);
+
+/** \brief Get the name of a task returned by get_task_ids(). */
+const std::string &get_task_name(task_id id);
+
+/** \brief Look up the ID of a task name.
+ *
+ *  \return \b true if some package belongs to the task, in which case
+ *  its ID is stored in id.
+ */
+bool find_task_id(const std::string &name, task_id &id);
 
 // Stores the various tasks.
 extern std::map<std::string, task> *task_list;
 
 // (re)loads in the current list of available tasks.  Necessary after a
 // cache reload, for obvious reasons.  apt_reload_cache will call this.
+//
+// Only the task descriptions are read here; the tasks of each package
+// are read from the package records the first time get_task_ids() or
+// find_task_id() is called.
 void load_tasks(OpProgress &progress);
 
 // Discards the current task list and readies a new one to be loaded.
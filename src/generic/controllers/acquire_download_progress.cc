@@ -21,6 +21,7 @@
 #include "acquire_download_progress.h"
 
 #include <generic/apt/download_signal_log.h>
+#include <generic/util/throttle.h>
 #include <generic/views/download_progress.h>
 
 // System includes:
@@ -78,18 +79,23 @@ namespace aptitude
 
       shared_ptr<views::download_progress> view;
 
+      shared_ptr<util::throttle> throttle;
+
       shared_ptr<views::download_progress::status>
       get_current_status(pkgAcquire *owner, download_signal_log &manager);
 
     public:
       impl(download_signal_log *log,
-           const shared_ptr<views::download_progress> &_view);
+           const shared_ptr<views::download_progress> &_view,
+           const shared_ptr<util::throttle> &_throttle);
     };
 
     acquire_download_progress::impl::impl(download_signal_log *log,
-                                          const shared_ptr<views::download_progress> &_view)
+                                          const shared_ptr<views::download_progress> &_view,
+                                          const shared_ptr<util::throttle> &_throttle)
       : id(1),
-        view(_view)
+        view(_view),
+        throttle(_throttle)
     {
       log->MediaChange_sig.connect(sigc::mem_fun(*this, &impl::media_change));
       log->IMSHit_sig.connect(sigc::mem_fun(*this, &impl::ims_hit));
@@ -260,6 +266,19 @@ namespace aptitude
                                                 download_signal_log &manager,
                                                 const sigc::slot1<void, bool> &k)
     {
+      // Walking the workers and redrawing the view is the expensive
+      // part of a pulse, so skip both until the throttle expires.
+      // Item events that arrive in the meantime have already been
+      // passed on; the next snapshot picks up their effect on the
+      // totals.
+      if(!throttle->update_required())
+        {
+          k(true);
+          return;
+        }
+
+      throttle->reset_timer();
+
       const shared_ptr<views::download_progress::status> status =
         get_current_status(owner, manager);
 
@@ -278,9 +297,10 @@ namespace aptitude
 
     shared_ptr<acquire_download_progress>
     create_acquire_download_progress(download_signal_log *log,
-                                     const shared_ptr<views::download_progress> &view)
+                                     const shared_ptr<views::download_progress> &view,
+                                     const shared_ptr<util::throttle> &throttle)
     {
-      return make_shared<acquire_download_progress::impl>(log, view);
+      return make_shared<acquire_download_progress::impl>(log, view, throttle);
     }
   }
 }
@@ -29,6 +29,11 @@ class download_signal_log;
 
 namespace aptitude
 {
+  namespace util
+  {
+    class throttle;
+  }
+
   namespace views
   {
     class download_progress;
@@ -55,7 +60,8 @@ namespace aptitude
       friend class impl;
       friend boost::shared_ptr<acquire_download_progress>
       create_acquire_download_progress(download_signal_log *,
-                                       const boost::shared_ptr<views::download_progress> &);
+                                       const boost::shared_ptr<views::download_progress> &,
+                                       const boost::shared_ptr<util::throttle> &);
 
     public:
       virtual ~acquire_download_progress() = 0;
@@ -66,6 +72,8 @@ namespace aptitude
      *  \param log       The download signal object whose events
      *                   will be received by the new controller.
      *  \param view      The view managed by the new controller.
+     *  \param throttle  Decides how often the view receives a new
+     *                   status snapshot.
      *
      *  The download progress instance holds a strong reference to the
      *  view, but no reference at all to the log; the log and the
@@ -74,7 +82,8 @@ namespace aptitude
      */
     boost::shared_ptr<acquire_download_progress>
     create_acquire_download_progress(download_signal_log *log,
-                                     const boost::shared_ptr<views::download_progress> &view);
+                                     const boost::shared_ptr<views::download_progress> &view,
+                                     const boost::shared_ptr<util::throttle> &throttle);
   }
 }
 
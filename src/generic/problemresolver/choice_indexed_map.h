@@ -103,6 +103,22 @@ public:
 
   size_type size() const { return curr_size; }
 
+  /** \brief Estimate the memory used by the index, not counting
+   *  memory owned by the stored values.
+   */
+  std::size_t memory_usage() const
+  {
+    std::size_t rval = install_version_objects.memory_usage() +
+      break_dep_objects.memory_usage();
+
+    for(typename imm::map<version, version_info>::const_iterator it =
+	  install_version_objects.begin();
+	it != install_version_objects.end(); ++it)
+      rval += it->second.from_dep_source.memory_usage();
+
+    return rval;
+  }
+
   void put(const choice &c, ValueType value)
   {
     switch(c.get_type())
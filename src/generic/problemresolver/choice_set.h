@@ -482,6 +482,13 @@ public:
     return install_version_choices.size() + not_install_version_choices.size();
   }
 
+  /** \brief Estimate the memory used by the nodes of this set. */
+  std::size_t memory_usage() const
+  {
+    return install_version_choices.memory_usage() +
+      not_install_version_choices.memory_usage();
+  }
+
   bool operator==(const generic_choice_set &other) const
   {
     return
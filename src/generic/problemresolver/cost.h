@@ -543,6 +543,9 @@ public:
    */
   bool is_above_or_equal(const cost &other) const
   {
+    if(impl_flyweight == other.impl_flyweight)
+      return true;
+
     return get_impl().is_above_or_equal(other.get_impl());
   }
 
@@ -612,13 +615,13 @@ public:
    */
   int compare(const cost &other) const
   {
-    const cost_impl &this_cost = get_impl(), &other_cost = other.get_impl();
-
-    // Rely on equality of flyweights being fast.
-    if(this_cost == other_cost)
+    // Rely on equality of flyweights being fast: equal costs share
+    // a single cost_impl, so this is a pointer comparison and the
+    // level vectors only need to be walked when the costs differ.
+    if(impl_flyweight == other.impl_flyweight)
       return 0;
     else
-      return this_cost.compare(other_cost);
+      return get_impl().compare(other.get_impl());
   }
 };
 
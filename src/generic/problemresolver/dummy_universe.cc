@@ -110,7 +110,7 @@ dummy_universe::~dummy_universe()
 
 
 void dummy_universe::add_package(const string &name,
-				 vector<string> the_versions,
+				 const vector<string> &the_versions,
 				 const string &curname)
 {
   eassert(!the_versions.empty());
@@ -260,11 +260,15 @@ dummy_universe_ref parse_universe_tail(istream &in)
 {
   dummy_universe_ref rval=new dummy_universe;
 
+  // Reused for every entry, so that large dumps don't allocate new
+  // buffers for each token.
+  string s;
+  vector<string> vernames;
+  vector<pair<string, string> > targets;
+
   in >> ws;
   while(in)
     {
-      string s;
-
       if(in.eof())
 	throw ParseError("Expected ']', 'PACKAGE', or 'DEP'; got EOF");
 
@@ -289,7 +293,7 @@ dummy_universe_ref parse_universe_tail(istream &in)
 	  if(in.eof())
 	    throw ParseError("Unexpected EOF after PACKAGE "+pkgname+" <");
 
-	  vector<string> vernames;
+	  vernames.clear();
 
 	  while(in)
 	    {
@@ -345,7 +349,7 @@ dummy_universe_ref parse_universe_tail(istream &in)
 	  if(in.eof())
 	    throw ParseError("Expected package-version pair, got EOF");
 
-	  vector<pair<string, string> > targets;
+	  targets.clear();
 
 	  while(in)
 	    {
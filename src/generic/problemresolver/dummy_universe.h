@@ -31,6 +31,7 @@
 #include <cwidget/generic/util/exception.h>
 
 #include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
 /** \brief A package dependency universe
  *
@@ -566,7 +567,7 @@ private:
   std::vector<dummy_version *> versions;
 
   /** Indexes packages by name. */
-  std::map<std::string, dummy_package *> packages_by_name;
+  boost::unordered_map<std::string, dummy_package *> packages_by_name;
 
   struct compare_dummy_packages
   {
@@ -586,7 +587,7 @@ private:
 
   dummy_package *find_package_internal(const std::string &pkg_name)
   {
-    std::map<std::string, dummy_package *>::const_iterator pfound=packages_by_name.find(pkg_name);
+    boost::unordered_map<std::string, dummy_package *>::const_iterator pfound=packages_by_name.find(pkg_name);
 
     if(pfound==packages_by_name.end())
       throw NoSuchNameError("package", pkg_name);
@@ -607,7 +608,7 @@ public:
    *         The first element of the list is the current version.
    */
   void add_package(const std::string &name,
-		   std::vector<std::string> the_versions,
+		   const std::vector<std::string> &the_versions,
 		   const std::string &curname);
 
   /** Set the current version of the given package to the given version. */
@@ -20,6 +20,26 @@
 
 #include "incremental_expression.h"
 
+int expression_batch::depth = 0;
+
+std::multimap<int, cwidget::util::ref_ptr<expression_base> > expression_batch::queue;
+
+void expression_batch::flush()
+{
+  // Expressions queued while flushing are parents of the one being
+  // processed, so they sort after it and are picked up by this loop.
+  while(!queue.empty())
+    {
+      std::multimap<int, cwidget::util::ref_ptr<expression_base> >::iterator
+	first = queue.begin();
+      cwidget::util::ref_ptr<expression_base> e = first->second;
+      queue.erase(first);
+
+      e->pending = false;
+      e->propagate_deferred_change();
+    }
+}
+
 void counting_bool_e::init_num_true()
 {
   const std::vector<cwidget::util::ref_ptr<expression<bool> > > &children(get_children());
@@ -28,6 +28,7 @@
 #include <generic/util/refcounted_base.h>
 
 #include <algorithm>
+#include <map>
 #include <set>
 
 #include <ostream>
@@ -37,13 +38,9 @@
 // the presence of threads without a lot of expensive locking, and
 // inside the resolver we don't need it).
 //
-// \todo Support delayed propagation of updates? (basically using a
-// queue -- this would avoid excessive recursion, and also avoid
-// having an unresponsive UI if there's a lot of stuff to update)
-// Maybe have a propagate() method on a generic (non-templated) base
-// class and have the user pass in a deque of pointers to that class
-// when signaling updates or modifying variable values.  propagate()
-// would also accept a deque, to totally flatten out the computation.
+// Updates are normally propagated immediately and recursively.  An
+// expression_batch can be used to collect the changes made by a
+// group of updates and propagate each one only once.
 
 template<typename T>
 class expression;
@@ -157,6 +154,110 @@ namespace aptitude
 template<typename T>
 class expression_container;
 
+class expression_batch;
+
+/** \brief The non-templated part of an expression, used to queue
+ *  changes in an expression_batch.
+ */
+class expression_base : public aptitude::util::refcounted_base_not_threadsafe
+{
+  friend class expression_batch;
+
+  // Greater than the height of every child of this expression, so
+  // that sorting by height visits children before their parents.
+  int height;
+
+  // True if this expression is waiting in the current batch.
+  bool pending;
+
+protected:
+  expression_base() : height(0), pending(false)
+  {
+  }
+
+  int get_height() const
+  {
+    return height;
+  }
+
+  void set_height(int new_height)
+  {
+    height = new_height;
+  }
+
+  bool get_pending() const
+  {
+    return pending;
+  }
+
+  /** \brief Invoked when the batch holding this expression is
+   *  flushed; should tell the parents of this expression about any
+   *  net change in its value since it was queued.
+   */
+  virtual void propagate_deferred_change() = 0;
+};
+
+/** \brief Defers the propagation of value changes while it exists.
+ *
+ *  While any batch exists, an expression whose value changes records
+ *  its old value and is queued instead of notifying its parents.
+ *  When the outermost batch is destroyed, the queued expressions are
+ *  processed children-first; each one notifies its parents once, and
+ *  only if its value is different from what it was when it was
+ *  queued.  Listeners such as expression_wrapper::changed() are
+ *  therefore invoked once per batch rather than once per update.
+ *
+ *  Batches may be nested.  Like the rest of this file, they are not
+ *  threadsafe: everything that modifies expressions while a batch is
+ *  open must run in the same thread.
+ */
+class expression_batch
+{
+  static int depth;
+
+  static std::multimap<int, cwidget::util::ref_ptr<expression_base> > queue;
+
+  static void flush();
+
+  // Not copyable.
+  expression_batch(const expression_batch &);
+  expression_batch &operator=(const expression_batch &);
+
+public:
+  expression_batch()
+  {
+    ++depth;
+  }
+
+  ~expression_batch()
+  {
+    if(depth == 1)
+      flush();
+    --depth;
+  }
+
+  /** \return \b true if a batch is currently open. */
+  static bool is_active()
+  {
+    return depth > 0;
+  }
+
+  /** \brief Queue an expression whose value has changed.
+   *
+   *  Only meaningful while a batch is open; expressions that are
+   *  already queued are ignored.
+   */
+  static void defer(expression_base *e)
+  {
+    if(!e->pending)
+      {
+	e->pending = true;
+	queue.insert(std::make_pair(e->height,
+				    cwidget::util::ref_ptr<expression_base>(e)));
+      }
+  }
+};
+
 /** \brief An expression whose value can be computed incrementally
  *  and updated in its parents.
  *
@@ -164,7 +265,7 @@ class expression_container;
  *                 should be copy-constructable and equality-comparable.
  */
 template<typename T>
-class expression : public aptitude::util::refcounted_base_not_threadsafe
+class expression : public expression_base
 {
   // Weak references to parents.
   std::set<expression_weak_ref<expression_container<T> > > parents;
@@ -172,6 +273,9 @@ class expression : public aptitude::util::refcounted_base_not_threadsafe
   // Incoming weak references.
   std::set<expression_weak_ref_generic *> weak_refs;
 
+  // The value this expression had when it was queued in a batch.
+  T deferred_old_value;
+
   // These two routines should be private, but they need to be exposed
   // to a templated class (expression_weak_ref<T>).
 public:
@@ -185,8 +289,8 @@ public:
     weak_refs.erase(ref);
   }
 
-protected:
-  void signal_value_changed(T old_value, T new_value)
+private:
+  void notify_parents(T old_value, T new_value)
   {
     cwidget::util::ref_ptr<expression> self(this);
 
@@ -209,6 +313,42 @@ protected:
       }
   }
 
+  void propagate_deferred_change()
+  {
+    T new_value = get_value();
+    if(new_value != deferred_old_value)
+      notify_parents(deferred_old_value, new_value);
+  }
+
+  // Make sure this expression is higher than a child of the given
+  // height, and that its own parents stay higher than it.
+  void raise_height_above(int child_height)
+  {
+    if(get_height() > child_height)
+      return;
+
+    set_height(child_height + 1);
+    for(typename std::set<expression_weak_ref<expression_container<T> > >::const_iterator
+	  it = parents.begin(); it != parents.end(); ++it)
+      if(it->get_valid())
+	it->get_value()->raise_height_above(get_height());
+  }
+
+protected:
+  void signal_value_changed(T old_value, T new_value)
+  {
+    if(expression_batch::is_active())
+      {
+	if(!get_pending())
+	  {
+	    deferred_old_value = old_value;
+	    expression_batch::defer(this);
+	  }
+      }
+    else
+      notify_parents(old_value, new_value);
+  }
+
 public:
   virtual ~expression()
   {
@@ -226,7 +366,10 @@ public:
   void add_parent(expression_container<T> *parent)
   {
     if(parent != NULL)
-      parents.insert(parent);
+      {
+	parents.insert(parent);
+	parent->raise_height_above(get_height());
+      }
   }
 
 private:
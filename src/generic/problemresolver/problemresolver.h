@@ -47,6 +47,7 @@
 #include <sstream>
 
 #include <limits.h>
+#include <sys/time.h>
 
 #include "choice.h"
 #include "choice_set.h"
@@ -57,16 +58,16 @@
 #include "solution.h"
 #include "resolver_undo.h"
 #include "search_graph.h"
+#include "search_statistics.h"
+#include "search_telemetry.h"
 #include "cost.h"
 #include "cost_limits.h"
 
 #include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/eassert.h>
 
-#include <generic/util/dense_setset.h>
 #include <generic/util/maybe.h>
 
-#include <boost/flyweight.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/unordered_set.hpp>
 
@@ -534,6 +535,12 @@ public:
      *  defer_cost.
      */
     size_t promotions;
+    /** \brief The number of steps processed so far. */
+    size_t steps;
+    /** \brief The number of open steps that were dropped to keep
+     *  the open queue under its limit.
+     */
+    size_t dropped;
 
     /** \b true if the resolver has finished searching for solutions.
      *  If open is empty, this member distinguishes between the start
@@ -547,7 +554,7 @@ public:
 
     queue_counts()
       : open(0), closed(0), deferred(0), conflicts(0), promotions(0),
-	finished(false),
+	steps(0), dropped(0), finished(false),
 	current_cost(cost_limits::minimum_cost)
     {
     }
@@ -631,49 +638,36 @@ private:
     choice_set actions;
     std::size_t hash;
 
-    struct combine_hashes
-    {
-      std::size_t &hash;
-
-      combine_hashes(std::size_t &_hash)
-	: hash(_hash)
-      {
-      }
-
-      bool operator()(const choice &c) const
-      {
-	boost::hash_combine(hash, c);
-	return true;
-      }
-    };
-
-    void init_hash()
+    void init_hash(std::size_t actions_hash)
     {
       hash = 0;
       boost::hash_combine(hash, score);
       boost::hash_combine(hash, action_score);
-      actions.for_each(combine_hashes(hash));
+      boost::hash_combine(hash, actions_hash);
     }
 
   public:
     step_contents()
       : score(0), action_score(0), actions()
     {
-      init_hash();
+      init_hash(step::get_actions_hash(actions));
     }
 
     step_contents(int _score, int _action_score,
 		  const choice_set &_actions)
       : score(_score), action_score(_action_score), actions(_actions)
     {
-      init_hash();
+      init_hash(step::get_actions_hash(actions));
     }
 
+    /** \brief Use the hash that the step maintains for its actions,
+     *  instead of walking them.
+     */
     step_contents(const step &s)
       : score(s.score), action_score(s.action_score),
 	actions(s.actions)
     {
-      init_hash();
+      init_hash(s.actions_hash);
     }
 
     std::size_t get_hash() const
@@ -732,6 +726,51 @@ private:
     }
   };
 
+  /** \brief Tracks the wall-clock time limit of a single call to
+   *  find_next_solution().
+   */
+  class search_deadline
+  {
+    bool limited;
+    timeval deadline;
+
+  public:
+    /** \brief Start the clock.
+     *
+     *  \param max_milliseconds  How long the search may run, or 0
+     *                           if it has no time limit.
+     */
+    explicit search_deadline(int max_milliseconds)
+      : limited(false)
+    {
+      if(max_milliseconds > 0 && gettimeofday(&deadline, 0) == 0)
+	{
+	  limited = true;
+	  deadline.tv_sec += max_milliseconds / 1000;
+	  deadline.tv_usec += (max_milliseconds % 1000) * 1000;
+	  if(deadline.tv_usec >= 1000000)
+	    {
+	      ++deadline.tv_sec;
+	      deadline.tv_usec -= 1000000;
+	    }
+	}
+    }
+
+    /** \return \b true if the time limit has passed. */
+    bool expired() const
+    {
+      if(!limited)
+	return false;
+
+      timeval now;
+      if(gettimeofday(&now, 0) != 0)
+	return false;
+
+      return now.tv_sec > deadline.tv_sec ||
+	(now.tv_sec == deadline.tv_sec && now.tv_usec >= deadline.tv_usec);
+    }
+  };
+
   /** \brief Used to convert a choice set into a model of Installation. */
   class choice_set_installation
   {
@@ -833,6 +872,51 @@ private:
   /** \brief Counts how many steps are deferred. */
   int num_deferred;
 
+  /** \brief Counts how many times a change in the deferral status
+   *  of a choice has updated a step.
+   *
+   *  Used to measure how much of the search graph each user hint
+   *  touches.
+   */
+  std::size_t num_deferral_step_updates;
+
+  /** \brief Timings and counters describing the searches run by
+   *  this resolver.
+   */
+  search_statistics statistics;
+
+  /** \brief Where to write periodic records about the search, or
+   *  an invalid pointer to not write any.
+   */
+  boost::shared_ptr<search_telemetry> telemetry;
+
+  /** \brief The estimated size of the search graph, in bytes, above
+   *  which its dead steps are released, or 0 to never release them.
+   */
+  std::size_t compaction_threshold;
+
+  /** \brief The estimated size of the search graph at which it will
+   *  next be compacted.
+   *
+   *  This starts at compaction_threshold and is raised after each
+   *  compaction that leaves the graph above it, so that a search
+   *  which is mostly live doesn't compact on every check.
+   */
+  std::size_t next_compaction_size;
+
+  /** \brief The number of steps the search graph has to reach before
+   *  its size is next compared with next_compaction_size.
+   *
+   *  Estimating the size walks every step, so it is only done each
+   *  time the graph grows by an eighth.
+   */
+  std::size_t next_compaction_check;
+
+  /** \brief The number of steps the open queue may hold before its
+   *  worst steps are dropped, or 0 to let it grow without bound.
+   */
+  std::size_t max_open_steps;
+
   /** Solutions generated "in the future", stored by reference to
    *  their step numbers.
    *
@@ -878,8 +962,13 @@ private:
    *  they are not a pure function of the contents of the solution; a
    *  solution might get a higher cost if we can prove that it will
    *  eventually have one anyway).
+   *
+   *  This is a vector rather than an array so that the default cost
+   *  is looked up in the flyweight table once and then copied into
+   *  each slot, instead of being looked up once per version in the
+   *  archive.
    */
-  cost *version_costs;
+  std::vector<cost> version_costs;
 
   /** \brief Used to track whether a single choice is approved or
    *  rejected.
@@ -1146,13 +1235,20 @@ private:
 
   /** \brief If the given step is already "seen", mark it as a clone
    *  and return true (telling our caller to abort).
+   *
+   *  \param stepNum   The step to test.
+   *  \param contents  The contents of that step.  The caller passes
+   *                   these in so that it can reuse them (and their
+   *                   hash, which costs a walk over every action in
+   *                   the step) when it adds the step to the closed
+   *                   set.
    */
-  bool is_already_seen(int stepNum)
+  bool is_already_seen(int stepNum, const step_contents &contents)
   {
     step &s(graph.get_step(stepNum));
 
     typename boost::unordered_map<step_contents, int, hash_step_contents>::const_iterator found =
-      closed.find(step_contents(s));
+      closed.find(contents);
     if(found != closed.end() && found->second != stepNum)
       {
 	LOG_TRACE(logger, "Step " << s.step_num << " is irrelevant: it was already encountered in this search.");
@@ -1272,7 +1368,7 @@ private:
     typedef generic_dep_solvers<PackageUniverse> dep_solvers;
 
 
-    for(typename imm::map<dep, boost::flyweight<dep_solvers> >::const_iterator it =
+    for(typename imm::map<dep, typename step::interned_dep_solvers>::const_iterator it =
 	  s.unresolved_deps.begin(); it != s.unresolved_deps.end(); ++it)
       {
 	const dep &d(it->first);
@@ -1479,6 +1575,7 @@ private:
       LOG_TRACE(logger, "Ignoring the empty promotion " << p);
     else if(promotions.insert(p) != promotions.end())
       {
+	statistics.promotion_added();
 	LOG_TRACE(logger, "Added the promotion " << p
 		  << " to the global promotion set.");
 
@@ -1887,7 +1984,7 @@ private:
 	  // Need to look up the solvers of the dep in order to know
 	  // the number of solvers that it was entered into the
 	  // by-num-solvers set with.
-	  typename imm::map<dep, typename step::flyweight_dep_solvers>::node
+	  typename imm::map<dep, typename step::interned_dep_solvers>::node
 	    solvers = s.unresolved_deps.lookup(d);
 
 	  if(solvers.isValid())
@@ -2000,7 +2097,7 @@ private:
 
 	  // Find the current number of solvers so we can yank the
 	  // dependency out of the unresolved-by-num-solvers set.
-	  typename imm::map<dep, typename step::flyweight_dep_solvers>::node
+	  typename imm::map<dep, typename step::interned_dep_solvers>::node
 	    current_solver_set_found = s.unresolved_deps.lookup(d);
 
 	  if(current_solver_set_found.isValid())
@@ -2024,8 +2121,8 @@ private:
 
 	      // Actually update the solvers of the dep.
 	      {
-		const typename step::flyweight_dep_solvers
-		  memoized_new_solvers(new_solvers);
+		const typename step::interned_dep_solvers
+		  memoized_new_solvers(graph.intern_solvers(new_solvers));
 		s.unresolved_deps.put(d, memoized_new_solvers);
 	      }
 
@@ -2294,6 +2391,9 @@ private:
   /** \brief Memoized version of build_is_deferred. */
   cwidget::util::ref_ptr<expression_box<bool> > build_is_deferred_listener(const choice &c)
   {
+    search_statistics::phase_timer timer(statistics,
+					 search_statistics::deferral_check);
+
     typename std::map<choice, expression_weak_ref<expression_box<bool> > >::const_iterator
       found = memoized_is_deferred.find(c);
 
@@ -2328,6 +2428,7 @@ private:
 		    int step_num) const
     {
       step &s(resolver.graph.get_step(step_num));
+      ++resolver.num_deferral_step_updates;
 
       if(how == search_graph::choice_mapping_action)
 	resolver.recompute_effective_step_cost(s);
@@ -2372,7 +2473,7 @@ private:
                              const int &check_structural_level = cost_limits::minimum_level,
                              bool do_check_structural_level = false)
   {
-    typename imm::map<dep, typename step::flyweight_dep_solvers>::node
+    typename imm::map<dep, typename step::interned_dep_solvers>::node
       found_solvers(s.unresolved_deps.lookup(solver_dep));
 
     if(found_solvers.isValid())
@@ -2406,8 +2507,8 @@ private:
 			     new_cost_is_deferred);
 	    new_dep_solvers.set_solver_information(solver_with_dep, new_solver_inf);
 	    {
-	      typename step::flyweight_dep_solvers
-		memoized_new_dep_solvers(new_dep_solvers);
+	      typename step::interned_dep_solvers
+		memoized_new_dep_solvers(graph.intern_solvers(new_dep_solvers));
 
 	      s.unresolved_deps.put(solver_dep, memoized_new_dep_solvers);
 	    }
@@ -2475,6 +2576,9 @@ private:
   void find_promotions_for_solver(step &s,
 				  const choice &solver)
   {
+    search_statistics::phase_timer timer(statistics,
+					 search_statistics::promotion_lookup);
+
     // \note imm::list<dep> is used so we don't have two separate
     // instantiations of
     // find_highest_incipient_promotions_containing().
@@ -2726,11 +2830,11 @@ private:
     {
     }
 
-    bool operator()(const std::pair<dep, typename step::dep_solvers> &p) const
+    bool operator()(const std::pair<dep, typename step::interned_dep_solvers> &p) const
     {
       maybe<cost> dep_cost;
 
-      p.second.for_each_solver(find_solvers_cost_lower_bound(dep_cost));
+      p.second.get().for_each_solver(find_solvers_cost_lower_bound(dep_cost));
 
       cost new_output_cost =
 	(dep_cost.get_has_value() && !output_cost.is_above_or_equal(dep_cost.get_value()))
@@ -2812,6 +2916,9 @@ private:
    */
   void recompute_effective_step_cost(step &s)
   {
+    search_statistics::phase_timer timer(statistics,
+					 search_statistics::cost_computation);
+
     LOG_TRACE(logger, "Recomputing the final cost of step " << s.step_num
 	      << " (was " << s.final_step_cost << ")");
 
@@ -3034,7 +3141,7 @@ private:
 	  const dep &d(*it);
 	  choice solver_with_dep(solver.copy_and_set_dep(d));
 
-	  typename imm::map<dep, typename step::flyweight_dep_solvers>::node current_solver_set_found =
+	  typename imm::map<dep, typename step::interned_dep_solvers>::node current_solver_set_found =
 	    s.unresolved_deps.lookup(d);
 
 	  if(current_solver_set_found.isValid())
@@ -3075,8 +3182,8 @@ private:
 				old_inf.get_is_deferred_listener());
 		      new_solvers.set_solver_information(solver_with_dep, new_inf);
 
-		      typename step::flyweight_dep_solvers
-			memoized_new_solvers(new_solvers);
+		      typename step::interned_dep_solvers
+			memoized_new_solvers(resolver.graph.intern_solvers(new_solvers));
 		      s.unresolved_deps.put(d, memoized_new_solvers);
 		      resolver.check_solvers_cost(s, new_solvers);
 
@@ -3172,6 +3279,7 @@ private:
 		    int step_num) const
     {
       step &s(r.graph.get_step(step_num));
+      ++r.num_deferral_step_updates;
 
       switch(tp)
 	{
@@ -3229,7 +3337,7 @@ private:
    */
   void find_promotions_for_dep_solvers(step &s, const dep &d)
   {
-    typename imm::map<dep, typename step::flyweight_dep_solvers>::node found =
+    typename imm::map<dep, typename step::interned_dep_solvers>::node found =
       s.unresolved_deps.lookup(d);
 
     if(found.isValid())
@@ -3284,8 +3392,8 @@ private:
       add_solver(s, solvers, d,
 		 choice::make_break_soft_dep(d, -1));
 
-    typename step::flyweight_dep_solvers
-      memoized_solvers(solvers);
+    typename step::interned_dep_solvers
+      memoized_solvers(graph.intern_solvers(solvers));
     s.unresolved_deps.put(d, memoized_solvers);
     LOG_TRACE(logger, "Marked the dependency " << d
 	      << " as unresolved in step " << s.step_num
@@ -3375,6 +3483,9 @@ private:
   void find_new_incipient_promotions(step &s,
 				     const choice &c)
   {
+    search_statistics::phase_timer timer(statistics,
+					 search_statistics::promotion_lookup);
+
     boost::unordered_map<choice, promotion> output;
 
     discards_blessed discards_blessed_p(s.is_blessed_solution,
@@ -3511,6 +3622,7 @@ private:
     // Copy all the state information over so we can work in-place on
     // the output set.
     output.actions = parent.actions;
+    output.actions_hash = parent.actions_hash;
     // A brief note on scores.
     //
     // These values are wrong.  They will be corrected at the bottom
@@ -3550,6 +3662,13 @@ private:
     // Insert the new choice into the output list of choices.  This
     // will be used below (in steps 3, 4, 5, 6 and 7).
     output.actions.insert_or_narrow(c);
+    // If the set grew, c was added as-is and its hash can be added
+    // to the parent's.  Otherwise it replaced or was absorbed by an
+    // existing choice, so start over.
+    if(output.actions.size() == parent.actions.size() + 1)
+      output.actions_hash += step::get_action_hash(c);
+    else
+      output.actions_hash = step::get_actions_hash(output.actions);
 
     // Rescan the solvers list to find the new cost.  I
     // could also handle this incrementally using the powers of
@@ -3699,7 +3818,7 @@ private:
 	return;
       }
 
-    typename imm::map<dep, typename step::flyweight_dep_solvers>::node bestSolvers =
+    typename imm::map<dep, typename step::interned_dep_solvers>::node bestSolvers =
       s.unresolved_deps.lookup(best.getVal().second);
 
     if(!bestSolvers.isValid())
@@ -3721,7 +3840,9 @@ private:
     bool first_successor = false;
     do_generate_single_successor generate_successor_f(s.step_num, *this,
 						      first_successor);
+    const std::size_t steps_before = graph.get_num_steps();
     bestDepSolvers.for_each_solver(generate_successor_f);
+    statistics.successors_of_step(graph.get_num_steps() - steps_before);
   }
 
   void do_log(const char *sourceName,
@@ -3775,11 +3896,16 @@ public:
      solver_executing(false), solver_cancelled(false),
      pending(step_goodness_compare(graph)),
      num_deferred(0),
+     num_deferral_step_updates(0),
+     compaction_threshold(0),
+     next_compaction_size(0),
+     next_compaction_check(0),
+     max_open_steps(0),
      pending_future_solutions(step_goodness_compare(graph)),
      closed(),
      promotions(_universe, *this),
      promotion_queue_tail(new promotion_queue_entry(0, 0)),
-     version_costs(new cost[_universe.get_version_count()])
+     version_costs(_universe.get_version_count())
   {
     logger->connect_message_logged(sigc::mem_fun(*this, &generic_problem_resolver::do_log));
 
@@ -3828,7 +3954,6 @@ public:
 
   ~generic_problem_resolver()
   {
-    delete[] version_costs;
   }
 
   /** \brief Get the dependencies that were initially broken in this
@@ -3872,6 +3997,49 @@ public:
     debug = new_debug;
   }
 
+  /** \brief Write records describing each search to the given
+   *  stream, or stop writing them if it is invalid.
+   *
+   *  Should only be called while the resolver is not running.
+   */
+  void set_telemetry(const boost::shared_ptr<search_telemetry> &new_telemetry)
+  {
+    telemetry = new_telemetry;
+  }
+
+  /** \brief Release the steps that the search can no longer reach
+   *  whenever the search graph grows past the given size.
+   *
+   *  \param bytes  The estimated size of the graph, as reported by
+   *                account_memory(), at which to compact it, or 0 to
+   *                never compact it.
+   *
+   *  Should only be called while the resolver is not running.
+   */
+  void set_compaction_threshold(std::size_t bytes)
+  {
+    compaction_threshold = bytes;
+    next_compaction_size = bytes;
+  }
+
+  /** \brief Drop the worst steps of the open queue whenever it holds
+   *  more than the given number of steps.
+   *
+   *  This bounds the memory used by a search, at the price of
+   *  possibly missing the best solution (or any solution) if one of
+   *  the dropped steps led to it.  The steps dropped so far are
+   *  counted by the search statistics and by get_counts().
+   *
+   *  \param steps  The largest number of open steps to keep, or 0 to
+   *                never drop any.
+   *
+   *  Should only be called while the resolver is not running.
+   */
+  void set_max_open_steps(std::size_t steps)
+  {
+    max_open_steps = steps;
+  }
+
   /** Clears all the internal state of the solver, discards solutions,
    *  zeroes out scores.  Call this routine after changing the state
    *  of packages to avoid inconsistent results.
@@ -3884,6 +4052,9 @@ public:
     promotion_queue_tail = boost::make_shared<promotion_queue_entry>(0, 0);
     graph.clear();
     closed.clear();
+    statistics.reset();
+    next_compaction_size = compaction_threshold;
+    next_compaction_check = 0;
 
     for(size_t i=0; i<universe.get_version_count(); ++i)
       weights.version_scores[i]=0;
@@ -3913,6 +4084,15 @@ public:
     return initial_state;
   }
 
+  /** \return the promotions that the resolver has learned so far.
+   *
+   *  This must not be called while the resolver is running.
+   */
+  const promotion_set &get_promotions() const
+  {
+    return promotions;
+  }
+
   /** \brief Apply the given operation to search nodes that include
    * the given set of choices.
    *
@@ -4204,17 +4384,104 @@ public:
     return num_deferred;
   }
 
-  /** Update the cached queue sizes. */
+  /** \return the number of step updates caused by changes to the
+   *  deferral status of choices since the resolver was created.
+   *
+   *  Rejecting, mandating, hardening or approving something only
+   *  revisits the steps that contain a choice whose deferral status
+   *  it changes; comparing this value before and after the change
+   *  shows how many that was.
+   */
+  std::size_t get_num_deferral_step_updates() const
+  {
+    return num_deferral_step_updates;
+  }
+
+  /** \return the timings and counters collected since the resolver
+   *  was created or last reset.
+   *
+   *  Like the other accessors, this should only be called while the
+   *  resolver is not running.
+   */
+  const search_statistics &get_statistics() const
+  {
+    return statistics;
+  }
+
+  /** \brief Add the estimated memory used by this resolver's search
+   *  to the given report.
+   *
+   *  Like get_statistics(), this should only be called while the
+   *  resolver is not running.
+   */
+  void account_memory(aptitude::util::memory_report &report) const
+  {
+    using aptitude::util::hashed_memory_usage;
+    using aptitude::util::node_memory_usage;
+
+    report.add("resolver search graph", graph.memory_usage());
+    report.add("resolver promotions", promotions.memory_usage());
+
+    // The action sets of the closed steps share their nodes with
+    // the search graph, so only the hash table itself is counted.
+    report.add("resolver queues",
+	       node_memory_usage(pending) +
+	       node_memory_usage(pending_future_solutions) +
+	       hashed_memory_usage(closed));
+  }
+
+  /** Update the cached queue sizes.
+   *
+   *  This runs on every step of the search, while the progress
+   *  displays read the counts from another thread; to keep the two
+   *  from waiting on each other, the new counts are computed before
+   *  the lock is taken, so that it is only held for a copy.
+   */
   void update_counts_cache()
   {
+    queue_counts new_counts;
+    new_counts.open       = pending.size();
+    new_counts.closed     = closed.size();
+    new_counts.deferred   = get_num_deferred();
+    new_counts.conflicts  = promotions.conflicts_size();
+    new_counts.promotions = promotions.size() - new_counts.conflicts;
+    new_counts.steps      = statistics.get_steps_processed();
+    new_counts.dropped    = statistics.get_steps_dropped();
+    new_counts.finished   = finished;
+    new_counts.current_cost = get_current_search_cost();
+
     cwidget::threads::mutex::lock l(counts_mutex);
-    counts.open       = pending.size();
-    counts.closed     = closed.size();
-    counts.deferred   = get_num_deferred();
-    counts.conflicts  = promotions.conflicts_size();
-    counts.promotions = promotions.size() - counts.conflicts;
-    counts.finished   = finished;
-    counts.current_cost = get_current_search_cost();
+    counts = new_counts;
+  }
+
+  /** \brief Write the current state of the search to the
+   *  telemetry stream, which must be valid.
+   */
+  void write_telemetry(const char *event)
+  {
+    search_telemetry::record r;
+    r.event = event;
+    r.steps = statistics.get_steps_processed();
+    r.open = pending.size();
+    r.closed = closed.size();
+    r.deferred = get_num_deferred();
+    r.conflicts = promotions.conflicts_size();
+    r.promotions = promotions.size() - r.conflicts;
+    r.promotions_learned = statistics.get_promotions_added();
+    r.graph_steps = graph.get_num_steps();
+
+    std::ostringstream cost_out;
+    cost_out << get_current_search_cost();
+    r.current_cost = cost_out.str();
+
+    if(!pending_future_solutions.empty())
+      {
+	std::ostringstream best_out;
+	best_out << graph.get_step(*pending_future_solutions.begin()).final_step_cost;
+	r.best_cost = best_out.str();
+      }
+
+    telemetry->write(r);
   }
 
   /** If no resolver is running, run through the deferred list and
@@ -4274,6 +4541,103 @@ private:
       !is_defer_cost(s.final_step_cost);
   }
 
+  /** \brief Release the dead steps of the search graph.
+   *
+   *  Steps that were pushed to a discard cost are dropped from the
+   *  open queue first: their cost can't come down again, so they
+   *  would never be processed.
+   */
+  void compact_graph()
+  {
+    for(typename std::set<int, step_goodness_compare>::iterator it = pending.begin();
+	it != pending.end(); )
+      {
+	const step &s(graph.get_step(*it));
+	if(is_discard_cost(s.final_step_cost) && !s.is_blessed_solution)
+	  pending.erase(it++);
+	else
+	  ++it;
+      }
+
+    std::vector<bool> queued(graph.get_num_steps(), false);
+    for(typename std::set<int, step_goodness_compare>::const_iterator it = pending.begin();
+	it != pending.end(); ++it)
+      queued[*it] = true;
+    for(typename std::set<int, step_goodness_compare>::const_iterator it = pending_future_solutions.begin();
+	it != pending_future_solutions.end(); ++it)
+      queued[*it] = true;
+
+    statistics.steps_released_by_compaction(graph.release_dead_steps(queued));
+  }
+
+  /** \brief Compact the search graph if it has grown past the
+   *  compaction threshold.
+   */
+  void maybe_compact_graph()
+  {
+    if(compaction_threshold == 0 ||
+       graph.get_num_steps() < next_compaction_check)
+      return;
+
+    const std::size_t num_steps = graph.get_num_steps();
+    next_compaction_check = num_steps + std::max<std::size_t>(64, num_steps / 8);
+
+    const std::size_t size_before = graph.memory_usage();
+    if(size_before < next_compaction_size)
+      return;
+
+    const std::size_t released_before = statistics.get_steps_released();
+    compact_graph();
+    const std::size_t size_after = graph.memory_usage();
+
+    next_compaction_size = std::max(compaction_threshold, 2 * size_after);
+
+    LOG_INFO(logger, "Compacted the search graph from about " << size_before
+	     << " to " << size_after << " bytes, releasing "
+	     << statistics.get_steps_released() - released_before
+	     << " of " << num_steps << " steps.");
+  }
+
+  /** \brief Drop the worst steps of the open queue if it has grown
+   *  past max_open_steps.
+   *
+   *  The queue is cut down to three quarters of the limit, so that
+   *  this doesn't run on every step.  Deferred steps and blessed
+   *  solutions are kept, since a change to the user's hints can make
+   *  them the best steps again; steps at a discard cost are dropped
+   *  without being counted, since they would never have been
+   *  processed anyway.  Compaction later releases whatever the
+   *  dropped steps leave unreachable.
+   */
+  void maybe_trim_open_queue()
+  {
+    if(max_open_steps == 0 || pending.size() <= max_open_steps)
+      return;
+
+    const std::size_t target = max_open_steps - max_open_steps / 4;
+    const std::size_t size_before = pending.size();
+    std::size_t dropped = 0;
+
+    typename std::set<int, step_goodness_compare>::iterator it = pending.end();
+    while(pending.size() > target && it != pending.begin())
+      {
+	--it;
+	const step &s(graph.get_step(*it));
+	if(s.is_blessed_solution || is_defer_cost(s.final_step_cost))
+	  continue;
+
+	if(!is_discard_cost(s.final_step_cost))
+	  ++dropped;
+	pending.erase(it++);
+      }
+
+    statistics.steps_dropped_by_limit(dropped);
+
+    LOG_INFO(logger, "Trimmed the open queue from " << size_before
+	     << " to " << pending.size() << " steps, dropping "
+	     << dropped << " candidates.");
+  }
+
   // Counts how many action hits existed in a promotion, allowing up
   // to one mismatch (which it stores).
   class count_action_hits
@@ -4364,6 +4728,9 @@ private:
    */
   void check_for_new_promotions(int step_num)
   {
+    search_statistics::phase_timer timer(statistics,
+					 search_statistics::promotion_lookup);
+
     step &s = graph.get_step(step_num);
 
     eassert(promotion_queue_tail.get() != NULL);
@@ -4474,9 +4841,12 @@ private:
 
 	sanity_check_promotions(s);
 
-	if(is_already_seen(step_num))
+	const step_contents contents(s);
+
+	if(is_already_seen(step_num, contents))
 	  {
 	    LOG_DEBUG(logger, "Dropping already visited search node in step " << s.step_num);
+	    statistics.step_already_seen();
 	  }
 	else if(irrelevant(s))
 	  {
@@ -4494,8 +4864,8 @@ private:
 	  {
 	    LOG_TRACE(logger, "Processing step " << step_num);
 
-	    closed[step_contents(s.score, s.action_score, s.actions)] =
-	      step_num;
+	    statistics.step_processed();
+	    closed[contents] = step_num;
 
 	    // If all dependencies are satisfied, we found a solution.
 	    if(s.unresolved_deps.empty())
@@ -4520,7 +4890,11 @@ private:
 	    // Nope, let's go enqueue successor nodes.
 	    else
 	      {
-		generate_successors(step_num, visited_packages);
+		{
+		  search_statistics::phase_timer timer(statistics,
+						       search_statistics::successor_generation);
+		  generate_successors(step_num, visited_packages);
+		}
                 const step &first_child = graph.get_step(s.first_child);
 
 		// If we enqueued *exactly* one successor, then this
@@ -4556,6 +4930,11 @@ public:
    *     in which case we just give up and report failure.  (this is a
    *     guard against exponential blowup)
    *
+   *   - The time limit passes.  If a solution has already been found
+   *     but the resolver is still looking for a better one, the best
+   *     solution found so far is returned; otherwise this is treated
+   *     like running out of steps.
+   *
    *   - We run out of potential solutions to try; failure.
    *
    *  \param max_steps the maximum number of solutions to test.
@@ -4564,16 +4943,22 @@ public:
    *           if not NULL, each package that influences the
    *           resolver's choices will be placed here.
    *
+   *  \param max_milliseconds
+   *           the maximum wall-clock time to spend searching, or 0
+   *           to search until max_steps is exhausted.
+   *
    *  \return a solution that fixes all broken dependencies
    *
    * \throws NoMoreSolutions if the potential solution list is exhausted.
-   * \throws NoMoreTime if no solution is found within max_steps steps.
+   * \throws NoMoreTime if no solution is found within max_steps steps
+   *                    or max_milliseconds milliseconds.
    *
    *  \todo when throwing NoMoreSolutions or NoMoreTime, maybe we
    *        should include the "least broken" solution seen.
    */
   solution find_next_solution(int max_steps,
-			      std::set<package> *visited_packages)
+			      std::set<package> *visited_packages,
+			      int max_milliseconds = 0)
   {
     // This object is responsible for managing the instance variables
     // that control threaded operation: it sets solver_executing when
@@ -4599,6 +4984,9 @@ public:
     // be to always return the first "future" solution that we find.
     int most_future_solution_steps = 0;
 
+    const search_deadline deadline(max_milliseconds);
+    bool out_of_time = false;
+
     if(finished)
       throw NoMoreSolutions();
 
@@ -4629,6 +5017,7 @@ public:
       }
 
     while(max_steps > 0 &&
+	  !out_of_time &&
 	  pending_contains_candidate() &&
 	  most_future_solution_steps <= future_horizon)
       {
@@ -4664,12 +5053,19 @@ public:
 	LOG_TRACE(logger, "Done generating successors.");
 
 	--max_steps;
+	out_of_time = deadline.expired();
 
 
 	// Propagate any new promotions that we discovered up the
 	// search tree.
 	graph.run_scheduled_promotion_propagations(promotion_adder(*this));
 	process_pending_promotions();
+
+	maybe_trim_open_queue();
+	maybe_compact_graph();
+
+	if(telemetry.get() != NULL && telemetry->due())
+	  write_telemetry("tick");
       }
 
     if(logger->isEnabledFor(logging::TRACE_LEVEL))
@@ -4706,6 +5102,9 @@ public:
 	    LOG_INFO(logger, "--- Returning the future solution "
 		     << rval << " from step " << best_future_solution);
 
+	    if(telemetry.get() != NULL)
+	      write_telemetry("solution");
+
 	    pending_future_solutions.erase(pending_future_solutions.begin());
 
 	    return rval;
@@ -4717,6 +5116,8 @@ public:
     if(pending_contains_candidate())
       {
 	LOG_INFO(logger, " *** Out of time after " << odometer << " steps.");
+	if(telemetry.get() != NULL)
+	  write_telemetry("out-of-time");
 	throw NoMoreTime();
       }
 
@@ -4731,6 +5132,9 @@ public:
 	     << "; promotions: " << promotions.size()
 	     << "; deferred: " << get_num_deferred());
 
+    if(telemetry.get() != NULL)
+      write_telemetry("exhausted");
+
     throw NoMoreSolutions();
   }
 
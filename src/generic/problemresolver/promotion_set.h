@@ -33,6 +33,7 @@
 #include <generic/util/compare3.h>
 #include <generic/util/immset.h>
 #include <generic/util/maybe.h>
+#include <generic/util/memory_accounting.h>
 
 #include <cwidget/generic/util/ref_ptr.h>
 
@@ -249,8 +250,6 @@ class promotion_set_callbacks
 /** \brief Represents a set of "promotions": mappings from sets of
  *  choices to costs implied by those choices.
  *
- *  Wraps up the various customizations of dense_setset for this case.
- *
  *  Requirements for this structure:
  *
  *
@@ -308,6 +307,58 @@ private:
 
   struct entry;
 
+  /** \brief A summary of a set of choices: each choice sets one bit,
+   *  chosen by hashing its version or dependency.
+   *
+   *  If a promotion is contained in a set of choices, each bit in the
+   *  promotion's signature is also set in the set's signature, so
+   *  most promotions that aren't contained can be rejected without
+   *  looking at their choices.
+   */
+  typedef unsigned long signature_type;
+
+  static signature_type get_signature(const choice &c)
+  {
+    const std::size_t num_bits = 8 * sizeof(signature_type);
+    std::size_t key = 0;
+
+    switch(c.get_type())
+      {
+      case choice::install_version:
+	key = c.get_ver().get_id();
+	break;
+
+      case choice::break_soft_dep:
+	key = boost::hash<dep>()(c.get_dep());
+	break;
+      }
+
+    return signature_type(1) << (key % num_bits);
+  }
+
+  struct accumulate_signature
+  {
+    signature_type &signature;
+
+    accumulate_signature(signature_type &_signature)
+      : signature(_signature)
+    {
+    }
+
+    bool operator()(const choice &c) const
+    {
+      signature |= get_signature(c);
+      return true;
+    }
+  };
+
+  static signature_type get_signature(const choice_set &choices)
+  {
+    signature_type rval = 0;
+    choices.for_each(accumulate_signature(rval));
+    return rval;
+  }
+
   /** \brief The structure used to store information about
    *  a promotion.
    */
@@ -315,6 +366,14 @@ private:
   {
     promotion p;
 
+    /** \brief The signature of the choices in this promotion. */
+    signature_type signature;
+
+    /** \brief The choice under which this entry is filed in the
+     *  pivot index.  Only meaningful if the promotion is not empty.
+     */
+    choice pivot;
+
     /** \brief An expression that will retract this entry when it
      *  becomes true.
      *
@@ -342,6 +401,7 @@ private:
 
     entry(const promotion &_p)
       : p(_p),
+	signature(get_signature(_p.get_choices())),
 	retraction_expression(),
 	active(false),
 	hit_count(0)
@@ -479,6 +539,18 @@ private:
   // understand the cost/benefit tradeoffs to using one.
   boost::unordered_map<dep, break_soft_dep_index_entry> break_soft_dep_index;
 
+  // The index above files each promotion under every one of its
+  // choices, which is what the incipient-promotion searches need.
+  // To find the promotions contained in a set of choices, it's
+  // enough to file each promotion under a single choice, its pivot:
+  // a contained promotion's pivot is matched by a choice in the set,
+  // so looking up each choice in the set finds every contained
+  // promotion exactly once, and the others are mostly rejected by
+  // their signatures.  Install-version pivots are filed by version,
+  // whether or not they are from a dependency source.
+  boost::unordered_map<version, std::vector<entry_ref> > install_version_pivot_index;
+  boost::unordered_map<dep, std::vector<entry_ref> > break_soft_dep_pivot_index;
+
   // Used to drop backpointers to an entry, one choice at a time.  Not
   // as efficient as the bulk operations below, but more general.
   class drop_choice
@@ -561,6 +633,56 @@ private:
 public:
   typedef unsigned int size_type;
   size_type size() const { return entries.size(); }
+
+  /** \brief Estimate the memory used by the promotions and the
+   *  indices over them.
+   */
+  std::size_t memory_usage() const
+  {
+    using aptitude::util::hashed_memory_usage;
+    using aptitude::util::node_memory_usage;
+    using aptitude::util::vector_memory_usage;
+
+    std::size_t rval = node_memory_usage(entries);
+    for(entry_const_ref it = entries.begin(); it != entries.end(); ++it)
+      rval += it->p.get_choices().memory_usage();
+
+    rval += num_versions * sizeof(install_version_index_entry *);
+    for(int i = 0; i < num_versions; ++i)
+      {
+	const install_version_index_entry *index_entry = install_version_index[i];
+	if(index_entry == NULL)
+	  continue;
+
+	rval += sizeof(install_version_index_entry);
+	rval += vector_memory_usage(index_entry->not_from_dep_source_entries);
+	rval += hashed_memory_usage(index_entry->from_dep_source_entries);
+	for(typename boost::unordered_map<dep, std::vector<entry_ref> >::const_iterator
+	      it = index_entry->from_dep_source_entries.begin();
+	    it != index_entry->from_dep_source_entries.end(); ++it)
+	  rval += vector_memory_usage(it->second);
+      }
+
+    rval += hashed_memory_usage(break_soft_dep_index);
+    for(typename boost::unordered_map<dep, break_soft_dep_index_entry>::const_iterator
+	  it = break_soft_dep_index.begin();
+	it != break_soft_dep_index.end(); ++it)
+      rval += vector_memory_usage(it->second);
+
+    rval += hashed_memory_usage(install_version_pivot_index);
+    for(typename boost::unordered_map<version, std::vector<entry_ref> >::const_iterator
+	  it = install_version_pivot_index.begin();
+	it != install_version_pivot_index.end(); ++it)
+      rval += vector_memory_usage(it->second);
+
+    rval += hashed_memory_usage(break_soft_dep_pivot_index);
+    for(typename boost::unordered_map<dep, std::vector<entry_ref> >::const_iterator
+	  it = break_soft_dep_pivot_index.begin();
+	it != break_soft_dep_pivot_index.end(); ++it)
+      rval += vector_memory_usage(it->second);
+
+    return rval;
+  }
   size_type conflicts_size() const { return num_conflicts; }
 
 private:
@@ -653,12 +775,147 @@ public:
 	p.get_choices().for_each(drop_choice(install_version_index,
 					     break_soft_dep_index,
 					     victim.entry_it));
+	drop_pivot_entry(victim.entry_it);
 
 	entries.erase(victim.entry_it);
       }
   }
 
 private:
+  /** \brief Find the list of pivot index entries that could be
+   *  matched by the given choice, or NULL if there are none.
+   */
+  const std::vector<entry_ref> *find_pivot_list(const choice &c) const
+  {
+    switch(c.get_type())
+      {
+      case choice::install_version:
+	{
+	  typename boost::unordered_map<version, std::vector<entry_ref> >::const_iterator found =
+	    install_version_pivot_index.find(c.get_ver());
+	  if(found == install_version_pivot_index.end())
+	    return NULL;
+	  else
+	    return &found->second;
+	}
+
+      case choice::break_soft_dep:
+	{
+	  typename boost::unordered_map<dep, std::vector<entry_ref> >::const_iterator found =
+	    break_soft_dep_pivot_index.find(c.get_dep());
+	  if(found == break_soft_dep_pivot_index.end())
+	    return NULL;
+	  else
+	    return &found->second;
+	}
+
+      default:
+	LOG_ERROR(logger, "find_pivot_list: bad choice type " << c.get_type());
+	return NULL;
+      }
+  }
+
+  /** \brief Picks the pivot for a new entry: the choice that the
+   *  fewest existing promotions contain.
+   *
+   *  A choice that rarely shows up in promotions is likely to be rare
+   *  in the search, too, so the entry will rarely need to be checked.
+   */
+  struct choose_pivot
+  {
+    const generic_promotion_set &parent;
+    choice &pivot;
+    mutable std::size_t pivot_uses;
+    mutable bool first;
+
+    choose_pivot(const generic_promotion_set &_parent, choice &_pivot)
+      : parent(_parent), pivot(_pivot), pivot_uses(0), first(true)
+    {
+    }
+
+    bool operator()(const choice &c) const
+    {
+      const std::vector<entry_ref> *uses = parent.find_index_list(c);
+      const std::size_t num_uses = uses == NULL ? 0 : uses->size();
+
+      if(first || num_uses < pivot_uses)
+	{
+	  pivot = c;
+	  pivot_uses = num_uses;
+	  first = false;
+	}
+
+      return true;
+    }
+  };
+
+  /** \brief File a new entry in the pivot index. */
+  void make_pivot_entry(const entry_ref &new_entry)
+  {
+    if(new_entry->p.get_choices().size() == 0)
+      return;
+
+    new_entry->p.get_choices().for_each(choose_pivot(*this, new_entry->pivot));
+
+    const choice &c(new_entry->pivot);
+    LOG_TRACE(logger, "Inserting a pivot index entry: " << c << " |-> " << new_entry->p);
+    switch(c.get_type())
+      {
+      case choice::install_version:
+	install_version_pivot_index[c.get_ver()].push_back(new_entry);
+	break;
+
+      case choice::break_soft_dep:
+	break_soft_dep_pivot_index[c.get_dep()].push_back(new_entry);
+	break;
+      }
+  }
+
+  /** \brief Remove an entry from the pivot index. */
+  void drop_pivot_entry(const entry_ref &victim)
+  {
+    if(victim->p.get_choices().size() == 0)
+      return;
+
+    const choice &c(victim->pivot);
+    switch(c.get_type())
+      {
+      case choice::install_version:
+	{
+	  typename boost::unordered_map<version, std::vector<entry_ref> >::iterator found =
+	    install_version_pivot_index.find(c.get_ver());
+	  if(found == install_version_pivot_index.end())
+	    LOG_ERROR(logger, "Unable to find a pivot index list for " << c << ", but one should exist.");
+	  else
+	    {
+	      std::vector<entry_ref> &pivot_entries(found->second);
+	      pivot_entries.erase(std::remove(pivot_entries.begin(), pivot_entries.end(), victim),
+				  pivot_entries.end());
+	      if(pivot_entries.empty())
+		install_version_pivot_index.erase(found);
+	    }
+	}
+	break;
+
+      case choice::break_soft_dep:
+	{
+	  typename boost::unordered_map<dep, std::vector<entry_ref> >::iterator found =
+	    break_soft_dep_pivot_index.find(c.get_dep());
+	  if(found == break_soft_dep_pivot_index.end())
+	    LOG_ERROR(logger, "Unable to find a pivot index list for " << c << ", but one should exist.");
+	  else
+	    {
+	      std::vector<entry_ref> &pivot_entries(found->second);
+	      pivot_entries.erase(std::remove(pivot_entries.begin(), pivot_entries.end(), victim),
+				  pivot_entries.end());
+	      if(pivot_entries.empty())
+		break_soft_dep_pivot_index.erase(found);
+	    }
+	}
+	break;
+      }
+  }
+
   /** \brief Find the list of index entries associated with the given
    *  choice, or NULL if it is not indexed.
    */
@@ -865,38 +1122,28 @@ private:
     }
   };
 
-  // To find a subset of an input set S, we find an entry that is hit
-  // by S exactly as many times as it has elements.  This works
-  // because we assume that it's impossible for an element of S to hit
-  // two distinct elements (no two choices in a search node can match
-  // each other).
+  // Computes the upper bound of the costs of the promotions that are
+  // contained in a set of choices, using the pivot index.
   //
-  // This computes the upper bound of all the elements that were
-  // matched.  We don't return all elements because we don't need to
-  // (this represents testing whether a set matches an existing
-  // promotion).  NB: the only reason for returning a promotion
-  // pointer rather than a boolean is so that we can provide
-  // diagnostic logging.
-  class find_entry_subset_op
+  // Each choice in the input set is looked up in the pivot index;
+  // since no two choices in the set can match each other, each
+  // contained promotion is visited exactly once.
+  class find_contained_promotions
   {
-    // A collection of conditions under which the returned promotion
-    // is true.  Each intersected promotion's validity condition is
-    // thrown in here.
-    mutable std::vector<cwidget::util::ref_ptr<expression<bool> > > rval_valid_conditions;
+    const generic_promotion_set &parent;
+    const choice_set &choices;
+    signature_type choices_signature;
+
     // The cost to return.
     mutable cost rval_cost;
 
-    logging::LoggerPtr logger;
-
   public:
-    find_entry_subset_op(const logging::LoggerPtr &_logger)
-      : logger(_logger)
-    {
-    }
-
-    const std::vector<cwidget::util::ref_ptr<expression<bool> > > &get_rval_valid_conditions() const
+    find_contained_promotions(const generic_promotion_set &_parent,
+			      const choice_set &_choices)
+      : parent(_parent),
+	choices(_choices),
+	choices_signature(get_signature(_choices))
     {
-      return rval_valid_conditions;
     }
 
     const cost &get_rval_cost() const
@@ -904,42 +1151,50 @@ private:
       return rval_cost;
     }
 
-    bool operator()(entry_ref r) const
+    // Used to test whether each choice in a promotion contains a
+    // choice in the input set.
+    struct choice_matched
     {
-      if(r->active)
+      const choice_set &choices;
+
+      choice_matched(const choice_set &_choices)
+	: choices(_choices)
+      {
+      }
+
+      bool operator()(const choice &c) const
+      {
+	return choices.has_contained_choice(c);
+      }
+    };
+
+    bool operator()(const choice &c) const
+    {
+      const std::vector<entry_ref> *pivot_entries = parent.find_pivot_list(c);
+      if(pivot_entries == NULL)
+	return true;
+
+      for(typename std::vector<entry_ref>::const_iterator it = pivot_entries->begin();
+	  it != pivot_entries->end(); ++it)
 	{
-	  if(r->hit_count == r->p.get_choices().size())
-	    {
-	      if(r->p.get_cost().is_above_or_equal(rval_cost))
-		{
-		  cost new_cost =
-		    cost::least_upper_bound(r->p.get_cost(), rval_cost);
+	  const entry &e(**it);
 
-		  LOG_DEBUG(logger, "find_entry_subset_op: resetting the hit count for "
-			    << r->p << " to 0 and incorporating it into the result (return value: "
-			    << rval_cost << " -> " << new_cost);
+	  if((e.signature & ~choices_signature) != 0 ||
+	     e.p.get_choices().size() > choices.size())
+	    continue;
+	  else if(rval_cost.is_above_or_equal(e.p.get_cost()))
+	    continue;
+	  else if(!e.p.get_choices().for_each(choice_matched(choices)))
+	    continue;
 
-		  rval_cost = new_cost;
-		  rval_valid_conditions.push_back(r->p.get_valid_condition());
-		}
-	      else
-		LOG_TRACE(logger, "find_entry_subset_op: resetting the hit count for "
-			  << r->p << " to 0, but not incorporating it into the result, because its cost "
-			  << r->p.get_cost() << " is lower than the current highest cost "
-			  << rval_cost);
-	    }
-	  else
-	    LOG_TRACE(logger, "find_entry_subset_op: " << r->p
-		      << " is not matched (needed " << r->p.get_choices().size()
-		      << " hits, but got only " << r->hit_count);
+	  const cost new_cost = cost::least_upper_bound(e.p.get_cost(), rval_cost);
 
-	  r->active = false;
-	  r->hit_count = 0;
+	  LOG_DEBUG(parent.logger, "find_contained_promotions: incorporating "
+		    << e.p << " into the result (return value: "
+		    << rval_cost << " -> " << new_cost << ")");
+
+	  rval_cost = new_cost;
 	}
-      else
-	// Note that if the hit-count is 0, we must have already
-	// processed this entry.
-	LOG_TRACE(logger, "find_entry_subset_op: skipping already processed promotion " << r->p);
 
       return true;
     }
@@ -1038,18 +1293,10 @@ public:
   {
     LOG_TRACE(logger, "Entering find_highest_promotion_cost(" << choices << ")");
 
-    traverse_intersections<increment_entry_count_op>
-      increment_f(*this, true, increment_entry_count_op(logger));
-    traverse_intersections<find_entry_subset_op>
-      find_result_f(*this, true, find_entry_subset_op(logger));
-    const find_entry_subset_op &find_result(find_result_f.get_op());
-
-    choices.for_each(increment_f);
-    // We have to run this even if the increment aborted, since we
-    // need to reset all the counters to 0 for the next run.
-    choices.for_each(find_result_f);
+    const find_contained_promotions find_f(*this, choices);
+    choices.for_each(find_f);
 
-    return find_result.get_rval_cost();
+    return find_f.get_rval_cost();
   }
 
   /** \brief A functor that, when applied to a Boolean value,
@@ -1125,7 +1372,7 @@ public:
    *         would be a subset if exactly one choice was added
    *         to the input).
    *
-   *  Similar to find_entry_subset_op, but finds incipient subsets as
+   *  Similar to find_contained_promotions, but finds incipient subsets as
    *  well as subsets, and fills in a map with its results rather than
    *  simply storing the single highest cost.
    */
@@ -2027,6 +2274,7 @@ public:
 	  {
 	    entry_ref ent(*it);
 	    LOG_TRACE(logger, "Removing " << ent->p);
+	    drop_pivot_entry(ent);
 
 	    if(ent->p.get_cost().get_structural_level() >= cost_limits::conflict_structural_level)
 	      --num_conflicts;
@@ -2043,6 +2291,7 @@ public:
 	  ++num_conflicts;
 
 	LOG_TRACE(logger, "Building index entries for " << p);
+	make_pivot_entry(new_entry);
 	p.get_choices().for_each(make_index_entries(new_entry,
 						    install_version_index,
 						    break_soft_dep_index,
@@ -2057,6 +2306,8 @@ public:
   {
     entries.clear();
     break_soft_dep_index.clear();
+    install_version_pivot_index.clear();
+    break_soft_dep_pivot_index.clear();
     num_conflicts = 0;
     for(int i = 0; i < num_versions; ++i)
       {
@@ -34,6 +34,8 @@
 #include <generic/util/compare3.h>
 #include <generic/util/immlist.h>
 #include <generic/util/immset.h>
+#include <generic/util/interned.h>
+#include <generic/util/memory_accounting.h>
 
 #include <boost/flyweight.hpp>
 #include <boost/flyweight/hashed_factory.hpp>
@@ -519,6 +521,12 @@ public:
     return solvers == other.solvers && structural_reasons == other.structural_reasons;
   }
 
+  /** \brief Estimate the memory used by the solver list. */
+  std::size_t memory_usage() const
+  {
+    return aptitude::util::vector_memory_usage(solvers);
+  }
+
   /** \brief Return the reasons that the set of solvers for this
    *  dependency was narrowed.
    */
@@ -717,6 +725,10 @@ public:
     // promotion ... better to just say "if we've processed it, it's
     // safe".
     bool is_blessed_solution : 1;
+    // If true, the search can no longer reach this step or any of
+    // its descendants, and release_dead_steps() has thrown away
+    // everything in it except its links and costs.
+    bool is_released : 1;
     // Index of the parent step, or -1 if there is no parent.
     int parent;
     // Index of the first child step, or -1 if there are no children.
@@ -774,11 +786,26 @@ public:
     typedef generic_solver_information<PackageUniverse> solver_information;
     typedef generic_dep_solvers<PackageUniverse> dep_solvers;
 
-    typedef boost::flyweight<dep_solvers> flyweight_dep_solvers;
+    /** \brief The pool in which the search graph stores the solver
+     *  sets of its steps.
+     *
+     *  Steps share most of their solver sets with their parents, so
+     *  each distinct set is stored once.
+     */
+    typedef intern_pool<dep_solvers> dep_solvers_pool;
+    typedef typename dep_solvers_pool::handle interned_dep_solvers;
 
     /** \brief The actions performed by this step. */
     choice_set actions;
 
+    /** \brief The sum of get_action_hash() over the actions of this
+     *  step.
+     *
+     *  Whoever modifies the actions must keep this up to date, which
+     *  lets the resolver hash a step without walking its actions.
+     */
+    std::size_t actions_hash;
+
     /** \brief The score of this step. */
     int score;
 
@@ -829,7 +856,7 @@ public:
      *	one maps to the reasons that any of its solvers were
      *	dropped.
      */
-    imm::map<dep, flyweight_dep_solvers> unresolved_deps;
+    imm::map<dep, interned_dep_solvers> unresolved_deps;
 
     /** \brief The unresolved dependencies, sorted by the number of
      *  solvers each one has.
@@ -922,12 +949,55 @@ public:
 
     // @}
 
+    /** \brief Compute the contribution of a single action to
+     *  actions_hash.
+     */
+    static std::size_t get_action_hash(const choice &c)
+    {
+      std::size_t rval = 0;
+      boost::hash_combine(rval, c);
+      return rval;
+    }
+
+  private:
+    struct accumulate_action_hashes
+    {
+      std::size_t &rval;
+
+      accumulate_action_hashes(std::size_t &_rval)
+	: rval(_rval)
+      {
+      }
+
+      bool operator()(const choice &c) const
+      {
+	rval += get_action_hash(c);
+	return true;
+      }
+    };
+
+  public:
+    /** \brief Compute actions_hash from scratch for the given set of
+     *  actions.
+     *
+     *  The hash is a sum so that it does not depend on the order in
+     *  which the actions were added, and so that adding an action
+     *  can update it in constant time.
+     */
+    static std::size_t get_actions_hash(const choice_set &actions)
+    {
+      std::size_t rval = 0;
+      actions.for_each(accumulate_action_hashes(rval));
+      return rval;
+    }
+
     /** \brief Default step constructor; only exists for use
      *  by STL containers.
      */
     step()
       : is_last_child(true),
 	is_blessed_solution(false),
+	is_released(false),
 	parent(-1), first_child(-1),
 	last_promotion_search(0),
 	choice_set_hit_count(0),
@@ -935,6 +1005,7 @@ public:
 	first_solver_hit(),
 	is_deferred_listener(),
 	canonical_clone(-1),
+	actions_hash(0),
 	reason(),
 	successor_constraints(), promotions(),
 	promotions_list(),
@@ -952,6 +1023,7 @@ public:
 	 int _action_score)
       : is_last_child(true),
 	is_blessed_solution(false),
+	is_released(false),
 	parent(-1), first_child(-1),
 	last_promotion_search(0),
 	choice_set_hit_count(0),
@@ -959,6 +1031,7 @@ public:
 	first_solver_hit(),
 	canonical_clone(-1),
 	actions(_actions),
+	actions_hash(get_actions_hash(_actions)),
 	score(_score),
 	action_score(_action_score),
 	is_deferred_listener(),
@@ -978,6 +1051,7 @@ public:
 	 const choice &_reason, bool _is_last_child)
       : is_last_child(_is_last_child),
 	is_blessed_solution(false),
+	is_released(false),
 	parent(_parent),
 	first_child(-1),
 	last_promotion_search(0),
@@ -986,6 +1060,7 @@ public:
 	first_solver_hit(),
 	canonical_clone(-1),
 	actions(_actions),
+	actions_hash(get_actions_hash(_actions)),
 	score(_score),
 	action_score(_action_score),
 	reason(_reason),
@@ -1058,7 +1133,21 @@ private:
   // new promotions in during backpropagation.
   promotion_set &promotions;
 
+  // Steps are stored in a deque, so they are allocated in large
+  // blocks and never move once they have been added.  Their set and
+  // map members can't be carved out of a per-search arena: their
+  // tree nodes are reference-counted and shared with the promotion
+  // set and with the solutions handed back to the caller, both of
+  // which outlive clear().
   std::deque<step> steps;
+
+  /** \brief The solver sets referred to by the steps.
+   *
+   *  This belongs to the graph rather than being shared by the whole
+   *  process, so that creating solver sets doesn't need a lock and
+   *  they are freed when the graph is cleared.
+   */
+  typename step::dep_solvers_pool solvers_pool;
   // Steps whose children have pending propagation requests.  Stored
   // in reverse order, because we should handle later steps first
   // (since they might be children of earlier steps and thus add new
@@ -1333,7 +1422,7 @@ private:
       // Check if we have a solver in this step first -- if you think
       // about it, it's more likely that this is true than that we
       // have an action.
-      typename imm::map<dep, typename step::flyweight_dep_solvers>::node found =
+      typename imm::map<dep, typename step::interned_dep_solvers>::node found =
 	s.unresolved_deps.lookup(d);
 
       if(found.isValid() &&
@@ -1445,6 +1534,38 @@ public:
     return steps.size();
   }
 
+  /** \brief Estimate the memory used by the steps and the indices
+   *  over them.
+   *
+   *  Steps share most of their set and map nodes with their parents,
+   *  so this is an upper bound: each shared node is counted once per
+   *  step that refers to it.
+   */
+  std::size_t memory_usage() const
+  {
+    std::size_t rval = steps.size() * sizeof(step);
+
+    for(typename std::deque<step>::const_iterator it = steps.begin();
+	it != steps.end(); ++it)
+      rval +=
+	it->actions.memory_usage() +
+	it->unresolved_deps.memory_usage() +
+	it->unresolved_deps_by_num_solvers.memory_usage() +
+	it->deps_solved_by_choice.memory_usage() +
+	it->forbidden_versions.memory_usage() +
+	aptitude::util::node_memory_usage(it->clones);
+
+    rval += aptitude::util::node_memory_usage(steps_pending_promotion_propagation);
+    rval += steps_related_to_choices.memory_usage();
+
+    rval += solvers_pool.memory_usage();
+    for(typename step::dep_solvers_pool::const_iterator it = solvers_pool.begin();
+	it != solvers_pool.end(); ++it)
+      rval += it->memory_usage();
+
+    return rval;
+  }
+
   /** \brief Retrieve the next promotion search index, incrementing it
    *  in the process.
    */
@@ -1470,6 +1591,169 @@ public:
     steps.clear();
     steps_pending_promotion_propagation.clear();
     steps_related_to_choices.clear();
+    // Only now that no step refers to them.
+    solvers_pool.clear();
+  }
+
+  /** \brief Store a solver set in this graph's pool.
+   *
+   *  \return a handle that can be placed in the unresolved_deps of
+   *  any step of this graph; it is valid until the graph is cleared.
+   */
+  typename step::interned_dep_solvers
+  intern_solvers(const typename step::dep_solvers &solvers)
+  {
+    return solvers_pool.intern(solvers);
+  }
+
+private:
+  /** \brief Throw away the contents of a step that will never be
+   *  visited again.
+   *
+   *  The links, costs and clone information are kept, so that the
+   *  step numbers stored in the resolver's queues, its closed set and
+   *  the children lists of other steps stay meaningful.
+   */
+  void release_step(step &s)
+  {
+    s.is_released = true;
+
+    s.actions = choice_set();
+    s.unresolved_deps = imm::map<dep, typename step::interned_dep_solvers>();
+    s.unresolved_deps_by_num_solvers = imm::set<std::pair<int, dep> >();
+    s.deps_solved_by_choice = generic_choice_indexed_map<PackageUniverse, imm::list<dep> >();
+    s.forbidden_versions = imm::map<version, choice>();
+    s.successor_constraints = choice_set();
+    s.is_deferred_listener = cwidget::util::ref_ptr<expression<bool> >();
+    s.promotion_queue_location.reset();
+
+    // The clones of a canonical step read its promotions.
+    if(s.clones.empty())
+      {
+	s.promotions.clear();
+	std::vector<promotion>().swap(s.promotions_list);
+	s.promotions_list_first_new_promotion = 0;
+      }
+  }
+
+  /** \brief Remove the released steps from the entries of the
+   *  choice->step reverse index.
+   */
+  class collect_live_bindings
+  {
+    const generic_search_graph &graph;
+    std::vector<std::pair<choice, choice_mapping_info> > &output;
+
+  public:
+    collect_live_bindings(const generic_search_graph &_graph,
+			  std::vector<std::pair<choice, choice_mapping_info> > &_output)
+      : graph(_graph), output(_output)
+    {
+    }
+
+    bool operator()(const choice &c, const choice_mapping_info &inf) const
+    {
+      imm::map<dep, imm::set<int> > live_steps;
+      bool changed = false;
+
+      const imm::map<dep, imm::set<int> > &steps(inf.get_steps());
+      for(typename imm::map<dep, imm::set<int> >::const_iterator it = steps.begin();
+	  it != steps.end(); ++it)
+	{
+	  imm::set<int> live_dep_steps;
+	  for(typename imm::set<int>::const_iterator stepIt = it->second.begin();
+	      stepIt != it->second.end(); ++stepIt)
+	    {
+	      if(graph.get_step(*stepIt).is_released)
+		changed = true;
+	      else
+		live_dep_steps.insert(*stepIt);
+	    }
+
+	  if(!live_dep_steps.empty())
+	    live_steps.put(it->first, live_dep_steps);
+	}
+
+      if(changed)
+	output.push_back(std::make_pair(c, choice_mapping_info(live_steps)));
+
+      return true;
+    }
+  };
+
+public:
+  /** \brief Release the contents of every step that the search can
+   *  no longer reach.
+   *
+   *  A step is dead if it is not waiting in one of the resolver's
+   *  queues, is not a solution and all of its children are dead:
+   *  nothing will expand it, return it or find a live step through
+   *  it again.  Dead steps keep their place in the graph, since
+   *  their numbers are stored in too many places to renumber them
+   *  safely, but their choice sets, solver maps and promotions are
+   *  freed and they are dropped from the reverse index.
+   *
+   *  Solutions that were already returned hold their own references
+   *  to the choices they contain, so they are not affected.
+   *
+   *  \param queued  For each step number, \b true if that step is
+   *                 still waiting in one of the resolver's queues.
+   *
+   *  \return the number of steps that were released by this call.
+   */
+  std::size_t release_dead_steps(const std::vector<bool> &queued)
+  {
+    eassert(queued.size() == steps.size());
+
+    std::vector<bool> live(steps.size(), false);
+    std::size_t rval = 0;
+
+    // Children are always added after their parents, so walking
+    // backwards visits every child before its parent.
+    for(int i = (int)steps.size() - 1; i >= 0; --i)
+      {
+	step &s(steps[i]);
+
+	bool is_live = queued[i] || s.is_blessed_solution;
+	if(!is_live && s.first_child != -1)
+	  for(int child = s.first_child; ; ++child)
+	    {
+	      if(live[child])
+		{
+		  is_live = true;
+		  break;
+		}
+	      else if(steps[child].is_last_child)
+		break;
+	    }
+
+	live[i] = is_live;
+	if(!is_live && !s.is_released)
+	  {
+	    release_step(s);
+	    ++rval;
+	  }
+      }
+
+    if(rval > 0)
+      {
+	std::vector<std::pair<choice, choice_mapping_info> > changed_bindings;
+	steps_related_to_choices.for_each(collect_live_bindings(*this, changed_bindings));
+
+	for(typename std::vector<std::pair<choice, choice_mapping_info> >::const_iterator
+	      it = changed_bindings.begin(); it != changed_bindings.end(); ++it)
+	  {
+	    if(it->second.get_steps().empty())
+	      steps_related_to_choices.erase(it->first);
+	    else
+	      steps_related_to_choices.put(it->first, it->second);
+	  }
+      }
+
+    LOG_DEBUG(logger, "Released " << rval << " dead steps out of "
+	      << steps.size());
+
+    return rval;
   }
 
   /** Retrieve the promotions list of the given step, returning the
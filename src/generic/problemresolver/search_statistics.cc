@@ -0,0 +1,112 @@
+// search_statistics.cc
+//
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "search_statistics.h"
+
+#include <ostream>
+
+search_statistics::search_statistics()
+{
+  reset();
+}
+
+void search_statistics::reset()
+{
+  for(int i = 0; i < num_phases; ++i)
+    {
+      phase_microseconds[i] = 0;
+      phase_count[i] = 0;
+    }
+
+  steps_processed = 0;
+  steps_already_seen = 0;
+  successors_generated = 0;
+  promotions_added = 0;
+  steps_released = 0;
+  steps_dropped = 0;
+
+  for(int i = 0; i < num_successor_buckets; ++i)
+    successor_histogram[i] = 0;
+}
+
+void search_statistics::successors_of_step(std::size_t n)
+{
+  successors_generated += n;
+
+  int bucket = 0;
+  while(n > 0 && bucket < num_successor_buckets - 1)
+    {
+      n >>= 1;
+      ++bucket;
+    }
+
+  ++successor_histogram[bucket];
+}
+
+const char *search_statistics::get_phase_name(phase p)
+{
+  switch(p)
+    {
+    case successor_generation:
+      return "successor-generation";
+    case promotion_lookup:
+      return "promotion-lookup";
+    case deferral_check:
+      return "deferral-check";
+    case cost_computation:
+      return "cost-computation";
+    default:
+      return "unknown";
+    }
+}
+
+std::ostream &operator<<(std::ostream &out, const search_statistics &statistics)
+{
+  out << "steps processed: " << statistics.get_steps_processed()
+      << " (" << statistics.get_steps_already_seen() << " already seen)" << std::endl
+      << "successors generated: " << statistics.get_successors_generated() << std::endl
+      << "promotions added: " << statistics.get_promotions_added() << std::endl
+      << "steps released: " << statistics.get_steps_released() << std::endl
+      << "steps dropped: " << statistics.get_steps_dropped() << std::endl;
+
+  for(int i = 0; i < search_statistics::num_phases; ++i)
+    {
+      const search_statistics::phase p = static_cast<search_statistics::phase>(i);
+
+      out << search_statistics::get_phase_name(p) << ": "
+	  << statistics.get_phase_count(p) << " calls, "
+	  << statistics.get_phase_microseconds(p) / 1000 << " ms" << std::endl;
+    }
+
+  out << "successors per step:";
+  for(int i = 0; i < search_statistics::num_successor_buckets; ++i)
+    {
+      if(i == 0)
+	out << " 0:";
+      else if(i == search_statistics::num_successor_buckets - 1)
+	out << " " << (1 << (i - 1)) << "+:";
+      else
+	out << " " << (1 << (i - 1)) << "-" << ((1 << i) - 1) << ":";
+
+      out << statistics.get_successor_bucket(i);
+    }
+  out << std::endl;
+
+  return out;
+}
@@ -0,0 +1,155 @@
+/** \file search_statistics.h */  // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef SEARCH_STATISTICS_H
+#define SEARCH_STATISTICS_H
+
+#include <iosfwd>
+
+#include <cstddef>
+
+#include <sys/time.h>
+
+/** \brief Cheap counters and timers describing a resolver search.
+ *
+ *  Unlike trace logging, these are always collected: each phase
+ *  costs two calls to gettimeofday() and a few additions, so they
+ *  can be used to find out whether a slow search is spending its
+ *  time building the search graph or looking up promotions.
+ *
+ *  Phases can nest (for instance, promotion lookups happen while
+ *  successors are being generated), and the time of a phase includes
+ *  the time of every phase nested in it.
+ */
+class search_statistics
+{
+public:
+  /** \brief The parts of the search that are timed. */
+  enum phase
+    {
+      /** \brief Building the successors of a step. */
+      successor_generation,
+      /** \brief Finding the promotions that apply to a step or to
+       *  one of its solvers.
+       */
+      promotion_lookup,
+      /** \brief Building the expressions that track whether a
+       *  choice is deferred.
+       */
+      deferral_check,
+      /** \brief Recomputing the effective cost of a step. */
+      cost_computation,
+      num_phases
+    };
+
+  /** \brief The number of buckets in the successor histogram.
+   *
+   *  Bucket 0 counts steps with no successors, and bucket i counts
+   *  steps with between 2^(i-1) and 2^i - 1 successors; the last
+   *  bucket also counts everything larger.
+   */
+  static const int num_successor_buckets = 12;
+
+private:
+  long long phase_microseconds[num_phases];
+  std::size_t phase_count[num_phases];
+
+  std::size_t steps_processed;
+  std::size_t steps_already_seen;
+  std::size_t successors_generated;
+  std::size_t promotions_added;
+  std::size_t steps_released;
+  std::size_t steps_dropped;
+
+  std::size_t successor_histogram[num_successor_buckets];
+
+public:
+  search_statistics();
+
+  /** \brief Discard everything that has been recorded. */
+  void reset();
+
+  /** \brief Times a phase for as long as it exists. */
+  class phase_timer
+  {
+    search_statistics &statistics;
+    phase p;
+    timeval start;
+
+    // Not copyable.
+    phase_timer(const phase_timer &);
+    phase_timer &operator=(const phase_timer &);
+
+  public:
+    phase_timer(search_statistics &_statistics, phase _p)
+      : statistics(_statistics), p(_p)
+    {
+      gettimeofday(&start, 0);
+    }
+
+    ~phase_timer()
+    {
+      timeval end;
+      gettimeofday(&end, 0);
+
+      statistics.phase_microseconds[p] +=
+	(end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_usec - start.tv_usec);
+      ++statistics.phase_count[p];
+    }
+  };
+
+  void step_processed() { ++steps_processed; }
+  void step_already_seen() { ++steps_already_seen; }
+  void promotion_added() { ++promotions_added; }
+  /** \brief Record that compacting the search graph released the
+   *  given number of dead steps.
+   */
+  void steps_released_by_compaction(std::size_t n) { steps_released += n; }
+  /** \brief Record that the given number of open steps were dropped
+   *  to keep the open queue under its size limit.
+   */
+  void steps_dropped_by_limit(std::size_t n) { steps_dropped += n; }
+
+  /** \brief Record that a step generated the given number of
+   *  successors.
+   */
+  void successors_of_step(std::size_t n);
+
+  /** \return the total time spent in the given phase. */
+  long long get_phase_microseconds(phase p) const { return phase_microseconds[p]; }
+  /** \return the number of times the given phase was entered. */
+  std::size_t get_phase_count(phase p) const { return phase_count[p]; }
+
+  std::size_t get_steps_processed() const { return steps_processed; }
+  std::size_t get_steps_already_seen() const { return steps_already_seen; }
+  std::size_t get_successors_generated() const { return successors_generated; }
+  std::size_t get_promotions_added() const { return promotions_added; }
+  std::size_t get_steps_released() const { return steps_released; }
+  std::size_t get_steps_dropped() const { return steps_dropped; }
+
+  /** \return the number of steps in the given successor bucket. */
+  std::size_t get_successor_bucket(int bucket) const { return successor_histogram[bucket]; }
+
+  /** \return a short name for the given phase. */
+  static const char *get_phase_name(phase p);
+};
+
+std::ostream &operator<<(std::ostream &out, const search_statistics &statistics);
+
+#endif // SEARCH_STATISTICS_H
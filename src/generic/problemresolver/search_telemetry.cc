@@ -0,0 +1,158 @@
+// search_telemetry.cc
+//
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "search_telemetry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <sstream>
+
+namespace
+{
+  long long now_microseconds()
+  {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+  }
+
+  /** \return the resident set size of this process in KiB, or 0 if
+   *  it can't be read.
+   */
+  unsigned long get_rss_kib()
+  {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if(f == NULL)
+      return 0;
+
+    unsigned long size = 0, resident = 0;
+    const int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+
+    if(n != 2)
+      return 0;
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+}
+
+search_telemetry::search_telemetry(int _fd, bool _close_fd, int interval_ms)
+  : fd(_fd),
+    close_fd(_close_fd),
+    interval_microseconds(interval_ms * 1000LL),
+    start(now_microseconds()),
+    last_record(start),
+    last_steps(0)
+{
+  write_line("time\tevent\tsteps\tsteps_per_sec\topen\tclosed\tdeferred"
+	     "\tpromotions\tconflicts\tpromotions_learned\tgraph_steps"
+	     "\trss_kib\tcurrent_cost\tbest_cost\n");
+}
+
+search_telemetry::~search_telemetry()
+{
+  if(close_fd)
+    close(fd);
+}
+
+boost::shared_ptr<search_telemetry>
+search_telemetry::open(const std::string &target, int interval_ms)
+{
+  if(target.compare(0, 3, "fd:") == 0)
+    {
+      char *end;
+      const long n = strtol(target.c_str() + 3, &end, 10);
+      if(*end != '\0' || end == target.c_str() + 3 || n < 0 ||
+	 fcntl(n, F_GETFD) == -1)
+	{
+	  errno = EBADF;
+	  return boost::shared_ptr<search_telemetry>();
+	}
+
+      return boost::shared_ptr<search_telemetry>(new search_telemetry(n, false, interval_ms));
+    }
+
+  const int new_fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(new_fd == -1)
+    return boost::shared_ptr<search_telemetry>();
+
+  return boost::shared_ptr<search_telemetry>(new search_telemetry(new_fd, true, interval_ms));
+}
+
+bool search_telemetry::due() const
+{
+  return now_microseconds() - last_record >= interval_microseconds;
+}
+
+void search_telemetry::write_line(const std::string &line)
+{
+  // Telemetry is best-effort: if the reader goes away, the search
+  // carries on without it.
+  std::string::size_type written = 0;
+  while(written < line.size())
+    {
+      const ssize_t n = ::write(fd, line.data() + written, line.size() - written);
+      if(n < 0)
+	{
+	  if(errno == EINTR)
+	    continue;
+	  return;
+	}
+
+      written += n;
+    }
+}
+
+void search_telemetry::write(const record &r)
+{
+  const long long now = now_microseconds();
+
+  double steps_per_sec = 0;
+  if(now > last_record && r.steps >= last_steps)
+    steps_per_sec = (r.steps - last_steps) * 1000000.0 / (now - last_record);
+
+  std::ostringstream out;
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  out << (now - start) / 1000000.0 << '\t'
+      << r.event << '\t'
+      << r.steps << '\t';
+  out.precision(1);
+  out << steps_per_sec << '\t'
+      << r.open << '\t'
+      << r.closed << '\t'
+      << r.deferred << '\t'
+      << r.promotions << '\t'
+      << r.conflicts << '\t'
+      << r.promotions_learned << '\t'
+      << r.graph_steps << '\t'
+      << get_rss_kib() << '\t'
+      << r.current_cost << '\t'
+      << r.best_cost << '\n';
+
+  write_line(out.str());
+
+  last_record = now;
+  last_steps = r.steps;
+}
@@ -0,0 +1,132 @@
+/** \file search_telemetry.h */  // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef SEARCH_TELEMETRY_H
+#define SEARCH_TELEMETRY_H
+
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <string>
+
+/** \brief A stream of periodic records describing a running
+ *  resolver search, for plotting how the search behaves over time.
+ *
+ *  Each record is one line of tab-separated fields, in the order
+ *  given by the header line written when the stream is opened:
+ *
+ *   - \b time: seconds since the stream was opened;
+ *   - \b event: "tick" for a periodic record, or "solution",
+ *     "out-of-time" or "exhausted" for the record written when a call
+ *     to find_next_solution() ends that way;
+ *   - \b steps: the steps processed since the resolver was created;
+ *   - \b steps_per_sec: the rate since the previous record;
+ *   - \b open, \b closed, \b deferred: the sizes of the queues;
+ *   - \b promotions, \b conflicts: the size of the promotion set
+ *     and how many of its entries are conflicts;
+ *   - \b promotions_learned: the promotions added by the search;
+ *   - \b graph_steps: the number of steps in the search graph;
+ *   - \b rss_kib: the resident set size of the process;
+ *   - \b current_cost: the cost of the next step to be processed;
+ *   - \b best_cost: the cost of the best solution found but not yet
+ *     returned, or "-" if there is none.
+ *
+ *  A search that is thrashing shows up as a falling step rate with a
+ *  growing open queue and few new promotions.
+ *
+ *  Records are only written by the thread running the search; a
+ *  stream shouldn't be used by two searches at once.
+ */
+class search_telemetry
+{
+public:
+  /** \brief The state of a search at one point in time. */
+  struct record
+  {
+    const char *event;
+    std::size_t steps;
+    std::size_t open;
+    std::size_t closed;
+    std::size_t deferred;
+    std::size_t promotions;
+    std::size_t conflicts;
+    std::size_t promotions_learned;
+    std::size_t graph_steps;
+    std::string current_cost;
+    std::string best_cost;
+
+    record()
+      : event("tick"), steps(0), open(0), closed(0), deferred(0),
+	promotions(0), conflicts(0), promotions_learned(0),
+	graph_steps(0), best_cost("-")
+    {
+    }
+  };
+
+private:
+  int fd;
+  bool close_fd;
+  long long interval_microseconds;
+
+  long long start;
+  long long last_record;
+  std::size_t last_steps;
+
+  // Not copyable.
+  search_telemetry(const search_telemetry &);
+  search_telemetry &operator=(const search_telemetry &);
+
+  void write_line(const std::string &line);
+
+public:
+  /** \brief Write records to the given file descriptor.
+   *
+   *  \param _fd           The descriptor to write to.
+   *  \param _close_fd     If \b true, the descriptor is closed when
+   *                       this object is destroyed.
+   *  \param interval_ms   The minimum time between two "tick"
+   *                       records.
+   */
+  search_telemetry(int _fd, bool _close_fd, int interval_ms);
+  ~search_telemetry();
+
+  /** \brief Open a telemetry stream.
+   *
+   *  \param target  Either "fd:N", to write to the already-open
+   *                 descriptor N, or the name of a file to create.
+   *  \param interval_ms  As for the constructor.
+   *
+   *  \return the new stream, or an invalid pointer (with errno set)
+   *  if the file can't be opened.
+   */
+  static boost::shared_ptr<search_telemetry> open(const std::string &target,
+						  int interval_ms);
+
+  /** \brief Return \b true if it's time for the next "tick" record.
+   *
+   *  This costs a call to gettimeofday(), so it can be checked on
+   *  every step.
+   */
+  bool due() const;
+
+  /** \brief Write a record, whether or not one is due. */
+  void write(const record &r);
+};
+
+#endif // SEARCH_TELEMETRY_H
@@ -260,6 +260,71 @@ private:
   /** Hide this, it's meaningless. */
   bool operator<(const generic_solution &other) const;
 
+  /** \brief Adds the hash of the effect of each choice to a sum.
+   *
+   *  The effect of a choice is the version it installs or the soft
+   *  dependency it breaks; the dependency that justified installing
+   *  a version is ignored.
+   */
+  struct accumulate_effect_hash
+  {
+    std::size_t &rval;
+
+    accumulate_effect_hash(std::size_t &_rval)
+      : rval(_rval)
+    {
+    }
+
+    bool operator()(const choice &c) const
+    {
+      std::size_t h = 0;
+      boost::hash_combine(h, c.get_type());
+      if(c.get_type() == choice::install_version)
+	boost::hash_combine(h, c.get_ver());
+      else
+	boost::hash_combine(h, c.get_dep());
+
+      rval += h;
+      return true;
+    }
+  };
+
+  /** \return a hash of the effects of the given choices that does
+   *  not depend on the order in which they are visited.
+   */
+  static std::size_t compute_effect_hash(const choice_set &choices)
+  {
+    std::size_t rval = 0;
+    choices.for_each(accumulate_effect_hash(rval));
+    return rval;
+  }
+
+  /** \brief Tests whether a choice has the same effect in another
+   *  choice set.
+   */
+  struct has_same_effect_in
+  {
+    const choice_set &other;
+
+    has_same_effect_in(const choice_set &_other)
+      : other(_other)
+    {
+    }
+
+    bool operator()(const choice &c) const
+    {
+      if(c.get_type() == choice::install_version)
+	{
+	  version other_ver;
+	  return
+	    other.get_version_of(c.get_ver().get_package(), other_ver) &&
+	    other_ver == c.get_ver();
+	}
+      else
+	return other.contains(c);
+    }
+  };
+
   class solution_rep
   {
     /** \brief The initial state of this solution.
@@ -289,6 +354,11 @@ private:
      */
     cost sol_cost;
 
+    /** \brief The hash of the effects of the choices, used to
+     *  recognize solutions that do the same thing.
+     */
+    std::size_t effect_hash;
+
     /** The reference count of this solution. */
     mutable unsigned int refcount;
 
@@ -304,6 +374,7 @@ private:
       : initial_state(_initial_state), choices(_choices),
 	score(_score),
 	sol_cost(_sol_cost),
+	effect_hash(compute_effect_hash(_choices)),
 	refcount(1)
     {
     }
@@ -320,6 +391,7 @@ private:
 
     int get_score() const {return score;}
     const cost &get_cost() const { return sol_cost; }
+    std::size_t get_effect_hash() const { return effect_hash; }
 
     version version_of(const package &pkg) const
     {
@@ -485,6 +557,29 @@ public:
     return real_soln->get_cost();
   }
 
+  /** \return a hash of what this solution does, ignoring the
+   *  dependencies that justified its choices.
+   *
+   *  This is computed once, when the solution is created.
+   */
+  std::size_t get_effect_hash() const
+  {
+    return real_soln->get_effect_hash();
+  }
+
+  /** \return \b true if this solution installs exactly the same
+   *  versions and breaks exactly the same soft dependencies as the
+   *  other solution, even if it installed them for different
+   *  reasons.
+   */
+  bool has_same_effect(const generic_solution &other) const
+  {
+    return
+      get_effect_hash() == other.get_effect_hash() &&
+      get_choices().size() == other.get_choices().size() &&
+      get_choices().for_each(has_same_effect_in(other.get_choices()));
+  }
+
   version version_of(const package &pkg) const
   {
     return real_soln->version_of(pkg);
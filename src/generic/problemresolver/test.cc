@@ -35,6 +35,8 @@
 #include <cwidget/generic/util/ssprintf.h>
 
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 
 using namespace std;
 
@@ -81,6 +83,14 @@ logging::LoggerPtr aptitude::Loggers::getAptitudeResolverSearchCosts()
 //
 // The second DEP form is a Conflicts, and is implicitly converted to
 // dependency form internally.
+//
+// Files written by aptitude's Aptitude::CmdLine::Resolver-Dump option
+// are in this format.  With --benchmark, each search prints a line
+// giving its run time, the work it did and the peak memory use of
+// the process so far, so dumps of real problems can be used to
+// measure the resolver ("make benchmark BENCHMARK_INPUTS=...").
+// With --telemetry FILE, every search writes periodic records about
+// its progress to FILE (see search_telemetry.h).
 
 namespace
 {
@@ -293,6 +303,60 @@ map<dummy_universe::package, dummy_resolver::version> read_solution(istream &f,
   throw ParseError("Unexpected error reading solution list");
 }
 
+// Set by --benchmark: report how long each search took and how much
+// work it did, instead of logging every step.
+bool benchmark = false;
+
+// Set by --telemetry: where the searches write telemetry records.
+boost::shared_ptr<search_telemetry> telemetry;
+
+/** \brief Prints the cost of one call to find_next_solution() when
+ *  it goes out of scope.
+ */
+class benchmark_report
+{
+  const dummy_resolver &resolver;
+  int step_count;
+  timeval start;
+
+public:
+  benchmark_report(const dummy_resolver &_resolver, int _step_count)
+    : resolver(_resolver), step_count(_step_count)
+  {
+    gettimeofday(&start, 0);
+  }
+
+  ~benchmark_report()
+  {
+    timeval end;
+    gettimeofday(&end, 0);
+
+    const long long elapsed_microseconds =
+      (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_usec - start.tv_usec);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const search_statistics &statistics = resolver.get_statistics();
+
+    cout << "BENCHMARK step_limit=" << step_count
+	 << " ms=" << elapsed_microseconds / 1000
+	 << " steps=" << statistics.get_steps_processed()
+	 << " successors=" << statistics.get_successors_generated()
+	 << " promotions=" << statistics.get_promotions_added()
+	 << " max_rss_kb=" << usage.ru_maxrss << endl;
+  }
+};
+
+dummy_resolver::solution find_next_solution(dummy_resolver &resolver, int step_count)
+{
+  if(!benchmark)
+    return resolver.find_next_solution(step_count, NULL);
+
+  benchmark_report report(resolver, step_count);
+  return resolver.find_next_solution(step_count, NULL);
+}
+
 int parse_int(const std::string &s)
 {
   if(s.empty())
@@ -400,7 +464,8 @@ void run_test_file(istream &f, bool show_world)
 				  imm::map<dummy_universe::package, dummy_universe::version>(),
 				  universe);
 
-	  resolver.set_debug(true);
+	  resolver.set_debug(!benchmark);
+	  resolver.set_telemetry(telemetry);
 
 	  read_scores(f, universe, resolver);
 
@@ -441,7 +506,7 @@ void run_test_file(istream &f, bool show_world)
 		{
 		  try
 		    {
-		      dummy_resolver::solution next_soln = resolver.find_next_solution(step_count, NULL);
+		      dummy_resolver::solution next_soln = find_next_solution(resolver, step_count);
 
 		      cout << "Next solution is ";
 		      next_soln.dump(cout);
@@ -463,7 +528,7 @@ void run_test_file(istream &f, bool show_world)
 		    {
 		      map<dummy_universe::package, dummy_resolver::version> expected=read_solution(f, universe);
 
-		      dummy_resolver::solution next_soln=resolver.find_next_solution(step_count, NULL);
+		      dummy_resolver::solution next_soln = find_next_solution(resolver, step_count);
 
 
 		      cout << "Next solution is ";
@@ -538,6 +603,24 @@ int main(int argc, char **argv)
           continue;
         }
 
+      if(!strcmp(argv[i], "--benchmark"))
+	{
+	  benchmark = true;
+	  continue;
+	}
+
+      if(!strcmp(argv[i], "--telemetry") && i + 1 < argc)
+	{
+	  ++i;
+	  telemetry = search_telemetry::open(argv[i], 100);
+	  if(telemetry.get() == NULL)
+	    {
+	      cerr << "Couldn't open " << argv[i] << " for telemetry." << endl;
+	      return -1;
+	    }
+	  continue;
+	}
+
       ifstream f(argv[i]);
 
       if(!f)
@@ -7,6 +7,8 @@
 
 #include <sigc++/signal.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -74,6 +76,29 @@ namespace aptitude
        */
       sigc::signal<void, T, std::size_t, std::size_t> signal_moved;
 
+      /** \brief Emitted after a contiguous range of values is added
+       *  to the list in one operation.
+       *
+       *  The parameters are the new values, in order, and the index
+       *  of the first one.  The index of each element formerly at or
+       *  above that index has been incremented by the number of new
+       *  values.
+       *
+       *  signal_inserted is not emitted for the individual values, so
+       *  clients that track the contents of the list must connect to
+       *  both signals.
+       */
+      sigc::signal<void, const std::vector<T> &, std::size_t> signal_inserted_range;
+
+      /** \brief Emitted after a contiguous range of values is removed
+       *  from the list in one operation.
+       *
+       *  The parameters are the removed values, in order, and the
+       *  former index of the first one.  signal_removed is not
+       *  emitted for the individual values.
+       */
+      sigc::signal<void, const std::vector<T> &, std::size_t> signal_removed_range;
+
       // @}
     };
 
@@ -99,6 +124,24 @@ namespace aptitude
        */
       virtual void remove(std::size_t position) = 0;
 
+      /** \brief Add a range of values to this list, starting at the
+       *  given position.
+       *
+       *  signal_inserted_range is invoked once after the values are
+       *  inserted, unless values is empty.
+       */
+      virtual void insert_range(const std::vector<T> &values,
+                                std::size_t position) = 0;
+
+      /** \brief Remove count values from this list, starting at the
+       *  given position.
+       *
+       *  position + count must be at most size().
+       *  signal_removed_range is invoked once after the values are
+       *  removed, unless count is zero.
+       */
+      virtual void remove_range(std::size_t position, std::size_t count) = 0;
+
       /** \brief Move an object to a new location.
        *
        *  from and to must be integers between 0 and size() - 1,
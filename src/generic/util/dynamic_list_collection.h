@@ -38,6 +38,8 @@
 #include <sigc++/bind.h>
 #include <sigc++/connection.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -136,6 +138,10 @@ namespace aptitude
                          const boost::shared_ptr<dynamic_list<T> > &list);
       void handle_move(const T &value, std::size_t from, std::size_t to,
                        const boost::shared_ptr<dynamic_list<T> > &list);
+      void handle_insert_range(const std::vector<T> &values, std::size_t idx,
+                               const boost::shared_ptr<dynamic_list<T> > &list);
+      void handle_remove_range(const std::vector<T> &values, std::size_t idx,
+                               const boost::shared_ptr<dynamic_list<T> > &list);
 
     public:
       // Only public for make_shared.
@@ -415,6 +421,64 @@ namespace aptitude
       signal_moved(value, from_idx, to_idx);
     }
 
+    template<typename T>
+    void dynamic_list_collection<T>::handle_insert_range(const std::vector<T> &values,
+                                                         std::size_t idx,
+                                                         const boost::shared_ptr<dynamic_list<T> > &list)
+    {
+      concrete_view_index &concrete_view = cells.template get<concrete_view_tag>();
+
+      // The same procedure as handle_insert(), except that the cells
+      // at or above idx move up by the number of new values.  The new
+      // values are adjacent in the parent list, so they're adjacent
+      // here too and can be reported as a single range.
+
+      by_parent_list_index &by_parent_list = cells.template get<by_parent_list_tag>();
+
+      std::pair<
+        typename by_parent_list_index::iterator,
+        typename by_parent_list_index::iterator > parent_range =
+        by_parent_list.equal_range(list);
+
+      typename concrete_view_index::const_iterator
+        insert_location = concrete_view.end();
+      for(typename by_parent_list_index::iterator it =
+            parent_range.first; it != parent_range.second; ++it)
+        {
+          const std::size_t it_idx = it->get_index_within_parent_list();
+
+          if(it_idx == idx)
+            insert_location = cells.template project<concrete_view_tag>(it);
+
+          if(it_idx >= idx)
+            by_parent_list.replace(it, cell(it->get_parent_list(),
+                                            it_idx + values.size(),
+                                            it->get_value()));
+        }
+
+      std::vector<cell> new_cells;
+      new_cells.reserve(values.size());
+      for(std::size_t i = 0; i < values.size(); ++i)
+        new_cells.push_back(cell(list, idx + i, values[i]));
+
+      const std::size_t insert_idx = insert_location - concrete_view.begin();
+      concrete_view.insert(insert_location, new_cells.begin(), new_cells.end());
+      this->signal_inserted_range(values, insert_idx);
+    }
+
+    template<typename T>
+    void dynamic_list_collection<T>::handle_remove_range(const std::vector<T> &values,
+                                                         std::size_t idx,
+                                                         const boost::shared_ptr<dynamic_list<T> > &list)
+    {
+      // Other lists' cells can be interleaved with the removed ones,
+      // so they might not be adjacent in this list; forward them one
+      // at a time.  Each removal shifts the next one down to idx.
+      for(typename std::vector<T>::const_iterator it = values.begin();
+          it != values.end(); ++it)
+        handle_remove(*it, idx, list);
+    }
+
     template<typename T>
     void dynamic_list_collection<T>::add_list(const boost::shared_ptr<dynamic_list<T> > &lst)
     {
@@ -440,9 +504,21 @@ namespace aptitude
                                                            &dynamic_list_collection::handle_move),
                                              lst));
 
+      const sigc::connection inserted_range_connection =
+        lst->signal_inserted_range.connect(sigc::bind(sigc::mem_fun(*this,
+                                                                    &dynamic_list_collection::handle_insert_range),
+                                                      lst));
+
+      const sigc::connection removed_range_connection =
+        lst->signal_removed_range.connect(sigc::bind(sigc::mem_fun(*this,
+                                                                   &dynamic_list_collection::handle_remove_range),
+                                                     lst));
+
       connections_by_list.insert(std::make_pair(lst, inserted_connection));
       connections_by_list.insert(std::make_pair(lst, removed_connection));
       connections_by_list.insert(std::make_pair(lst, moved_connection));
+      connections_by_list.insert(std::make_pair(lst, inserted_range_connection));
+      connections_by_list.insert(std::make_pair(lst, removed_range_connection));
     }
 
     template<typename T>
@@ -60,6 +60,8 @@ namespace aptitude
 
       void insert(const T &t, std::size_t position);
       void remove(std::size_t position);
+      void insert_range(const std::vector<T> &values, std::size_t position);
+      void remove_range(std::size_t position, std::size_t count);
       void move(std::size_t from, std::size_t to);
     };
 
@@ -102,6 +104,30 @@ namespace aptitude
       signal_removed(val, position);
     }
 
+    template<typename T>
+    void dynamic_list_impl<T>::insert_range(const std::vector<T> &values,
+                                            std::size_t position)
+    {
+      if(values.empty())
+        return;
+
+      entries.insert(entries.begin() + position, values.begin(), values.end());
+      this->signal_inserted_range(values, position);
+    }
+
+    template<typename T>
+    void dynamic_list_impl<T>::remove_range(std::size_t position,
+                                            std::size_t count)
+    {
+      if(count == 0)
+        return;
+
+      const typename collection::iterator first = entries.begin() + position;
+      const std::vector<T> vals(first, first + count);
+      entries.erase(first, first + count);
+      this->signal_removed_range(vals, position);
+    }
+
     template<typename T>
     void dynamic_list_impl<T>::move(std::size_t from, std::size_t to)
     {
@@ -25,6 +25,8 @@
 #include <sigc++/connection.h>
 #include <sigc++/slot.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -32,8 +34,44 @@ namespace aptitude
     template<typename T>
     class enumerator;
 
+    /** \brief Adapts a slot that takes one element to a slot that
+     *  takes a range of elements, by invoking it on each element in
+     *  turn.
+     *
+     *  Used by implementations of dynamic_set to implement
+     *  connect_inserted() and connect_removed() on top of their range
+     *  signals.
+     */
+    template<typename T>
+    class dynamic_set_each_element : public sigc::functor_base
+    {
+      sigc::slot<void, T> slot;
+
+    public:
+      typedef void result_type;
+
+      explicit dynamic_set_each_element(const sigc::slot<void, T> &_slot)
+        : slot(_slot)
+      {
+      }
+
+      void operator()(const std::vector<T> &values) const
+      {
+        for(typename std::vector<T>::const_iterator it = values.begin();
+            it != values.end(); ++it)
+          slot(*it);
+      }
+    };
+
     /** \brief An abstract interface for an unordered collection of
      *  objects that reports changes via signals.
+     *
+     *  Each change is reported exactly once to each connected slot.
+     *  A slot registered with connect_inserted_range() or
+     *  connect_removed_range() receives all the elements of a bulk
+     *  change in a single call; one registered with
+     *  connect_inserted() or connect_removed() is invoked once per
+     *  element.
      */
     template<typename T>
     class dynamic_set : public sigc::trackable
@@ -64,6 +102,24 @@ namespace aptitude
        *  removed from this set.
        */
       virtual sigc::connection connect_removed(const sigc::slot<void, T> &slot) = 0;
+
+      /** \brief Register a slot to be invoked after one or more
+       *  objects are inserted into this set.
+       *
+       *  The slot receives every object that was inserted by a
+       *  single operation; it is never invoked with an empty range.
+       */
+      virtual sigc::connection
+      connect_inserted_range(const sigc::slot<void, const std::vector<T> &> &slot) = 0;
+
+      /** \brief Register a slot to be invoked after one or more
+       *  objects are removed from this set.
+       *
+       *  The slot receives every object that was removed by a single
+       *  operation; it is never invoked with an empty range.
+       */
+      virtual sigc::connection
+      connect_removed_range(const sigc::slot<void, const std::vector<T> &> &slot) = 0;
     };
 
     template<typename T>
@@ -92,6 +148,21 @@ namespace aptitude
        *  invoked.
        */
       virtual void remove(const T &t) = 0;
+
+      /** \brief Insert each of the given elements that is not already
+       *  present.
+       *
+       *  The inserted signals are invoked once, with the elements that
+       *  were not already in the set, if there are any.
+       */
+      virtual void insert_range(const std::vector<T> &values) = 0;
+
+      /** \brief Remove each of the given elements that is present.
+       *
+       *  The removed signals are invoked once, with the elements that
+       *  were in the set, if there are any.
+       */
+      virtual void remove_range(const std::vector<T> &values) = 0;
     };
   }
 }
@@ -31,6 +31,8 @@
 
 #include <sigc++/signal.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -46,8 +48,12 @@ namespace aptitude
         public writable_dynamic_set<T>
     {
       boost::unordered_set<T> values;
-      sigc::signal<void, T> signal_inserted;
-      sigc::signal<void, T> signal_removed;
+
+      // Single-element changes are emitted as ranges of one element;
+      // connect_inserted() and connect_removed() adapt their slots
+      // to these signals.
+      sigc::signal<void, const std::vector<T> &> signal_inserted;
+      sigc::signal<void, const std::vector<T> &> signal_removed;
 
     public:
       /** \warning Should only be invoked by make_shared().
@@ -70,11 +76,17 @@ namespace aptitude
 
       void insert(const T &t);
       void remove(const T &t);
+      void insert_range(const std::vector<T> &new_values);
+      void remove_range(const std::vector<T> &old_values);
 
       std::size_t size();
       boost::shared_ptr<enumerator<T> > enumerate();
       sigc::connection connect_inserted(const sigc::slot<void, T> &slot);
       sigc::connection connect_removed(const sigc::slot<void, T> &slot);
+      sigc::connection
+      connect_inserted_range(const sigc::slot<void, const std::vector<T> &> &slot);
+      sigc::connection
+      connect_removed_range(const sigc::slot<void, const std::vector<T> &> &slot);
     };
 
     template<typename T>
@@ -110,7 +122,7 @@ namespace aptitude
         insert_result = values.insert(t);
 
       if(insert_result.second)
-        signal_inserted(t);
+        signal_inserted(std::vector<T>(1, t));
     }
 
     template<typename T>
@@ -118,7 +130,35 @@ namespace aptitude
     {
       const std::size_t num_erased = values.erase(t);
       if(num_erased > 0)
-        signal_removed(t);
+        signal_removed(std::vector<T>(1, t));
+    }
+
+    template<typename T>
+    void dynamic_set_impl<T>::insert_range(const std::vector<T> &new_values)
+    {
+      std::vector<T> inserted;
+
+      for(typename std::vector<T>::const_iterator it = new_values.begin();
+          it != new_values.end(); ++it)
+        if(values.insert(*it).second)
+          inserted.push_back(*it);
+
+      if(!inserted.empty())
+        signal_inserted(inserted);
+    }
+
+    template<typename T>
+    void dynamic_set_impl<T>::remove_range(const std::vector<T> &old_values)
+    {
+      std::vector<T> removed;
+
+      for(typename std::vector<T>::const_iterator it = old_values.begin();
+          it != old_values.end(); ++it)
+        if(values.erase(*it) > 0)
+          removed.push_back(*it);
+
+      if(!removed.empty())
+        signal_removed(removed);
     }
 
     template<typename T>
@@ -141,11 +181,25 @@ namespace aptitude
     template<typename T>
     sigc::connection dynamic_set_impl<T>::connect_inserted(const sigc::slot<void, T> &slot)
     {
-      return signal_inserted.connect(slot);
+      return signal_inserted.connect(dynamic_set_each_element<T>(slot));
     }
 
     template<typename T>
     sigc::connection dynamic_set_impl<T>::connect_removed(const sigc::slot<void, T> &slot)
+    {
+      return signal_removed.connect(dynamic_set_each_element<T>(slot));
+    }
+
+    template<typename T>
+    sigc::connection
+    dynamic_set_impl<T>::connect_inserted_range(const sigc::slot<void, const std::vector<T> &> &slot)
+    {
+      return signal_inserted.connect(slot);
+    }
+
+    template<typename T>
+    sigc::connection
+    dynamic_set_impl<T>::connect_removed_range(const sigc::slot<void, const std::vector<T> &> &slot)
     {
       return signal_removed.connect(slot);
     }
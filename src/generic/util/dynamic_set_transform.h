@@ -30,6 +30,8 @@
 #include <sigc++/signal.h>
 #include <sigc++/slot.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -47,11 +49,13 @@ namespace aptitude
       boost::shared_ptr<dynamic_set<From> > wrapped_set;
       boost::function<To (From)> f;
 
-      sigc::signal<void, To> signal_inserted;
-      sigc::signal<void, To> signal_removed;
+      sigc::signal<void, const std::vector<To> &> signal_inserted;
+      sigc::signal<void, const std::vector<To> &> signal_removed;
+
+      std::vector<To> transform_range(const std::vector<From> &from_values) const;
 
-      void handle_inserted(const From &from);
-      void handle_removed(const From &from);
+      void handle_inserted(const std::vector<From> &from_values);
+      void handle_removed(const std::vector<From> &from_values);
 
     public:
       /** \warning Should only be used by create(). */
@@ -66,6 +70,10 @@ namespace aptitude
       boost::shared_ptr<enumerator<To> > enumerate();
       sigc::connection connect_inserted(const sigc::slot<void, To> &slot);
       sigc::connection connect_removed(const sigc::slot<void, To> &slot);
+      sigc::connection
+      connect_inserted_range(const sigc::slot<void, const std::vector<To> &> &slot);
+      sigc::connection
+      connect_removed_range(const sigc::slot<void, const std::vector<To> &> &slot);
     };
 
     template<typename From, typename To>
@@ -74,8 +82,8 @@ namespace aptitude
       : wrapped_set(_wrapped_set),
         f(_f)
     {
-      wrapped_set->connect_inserted(sigc::mem_fun(*this, &dynamic_set_transform::handle_inserted));
-      wrapped_set->connect_removed(sigc::mem_fun(*this, &dynamic_set_transform::handle_removed));
+      wrapped_set->connect_inserted_range(sigc::mem_fun(*this, &dynamic_set_transform::handle_inserted));
+      wrapped_set->connect_removed_range(sigc::mem_fun(*this, &dynamic_set_transform::handle_removed));
     }
 
     template<typename From, typename To>
@@ -99,25 +107,53 @@ namespace aptitude
     }
 
     template<typename From, typename To>
-    void dynamic_set_transform<From, To>::handle_inserted(const From &from)
+    std::vector<To>
+    dynamic_set_transform<From, To>::transform_range(const std::vector<From> &from_values) const
     {
-      signal_inserted(f(from));
+      std::vector<To> rval;
+      rval.reserve(from_values.size());
+
+      for(typename std::vector<From>::const_iterator it = from_values.begin();
+          it != from_values.end(); ++it)
+        rval.push_back(f(*it));
+
+      return rval;
     }
 
     template<typename From, typename To>
-    void dynamic_set_transform<From, To>::handle_removed(const From &from)
+    void dynamic_set_transform<From, To>::handle_inserted(const std::vector<From> &from_values)
     {
-      signal_removed(f(from));
+      signal_inserted(transform_range(from_values));
+    }
+
+    template<typename From, typename To>
+    void dynamic_set_transform<From, To>::handle_removed(const std::vector<From> &from_values)
+    {
+      signal_removed(transform_range(from_values));
     }
 
     template<typename From, typename To>
     sigc::connection dynamic_set_transform<From, To>::connect_inserted(const sigc::slot<void, To> &slot)
     {
-      return signal_inserted.connect(slot);
+      return signal_inserted.connect(dynamic_set_each_element<To>(slot));
     }
 
     template<typename From, typename To>
     sigc::connection dynamic_set_transform<From, To>::connect_removed(const sigc::slot<void, To> &slot)
+    {
+      return signal_removed.connect(dynamic_set_each_element<To>(slot));
+    }
+
+    template<typename From, typename To>
+    sigc::connection
+    dynamic_set_transform<From, To>::connect_inserted_range(const sigc::slot<void, const std::vector<To> &> &slot)
+    {
+      return signal_inserted.connect(slot);
+    }
+
+    template<typename From, typename To>
+    sigc::connection
+    dynamic_set_transform<From, To>::connect_removed_range(const sigc::slot<void, const std::vector<To> &> &slot)
     {
       return signal_removed.connect(slot);
     }
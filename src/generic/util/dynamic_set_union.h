@@ -29,6 +29,8 @@
 
 #include <sigc++/signal.h>
 
+#include <vector>
+
 namespace aptitude
 {
   namespace util
@@ -58,11 +60,18 @@ namespace aptitude
       // Maintains pointers to the individual sets this contains.
       contained_sets_t contained_sets;
 
-      sigc::signal<void, T> signal_inserted;
-      sigc::signal<void, T> signal_removed;
+      sigc::signal<void, const std::vector<T> &> signal_inserted;
+      sigc::signal<void, const std::vector<T> &> signal_removed;
+
+      // Update the counts for a range of values inserted into or
+      // removed from one of the sets, and emit a single signal for
+      // the values that entered or left the union.
+      void handle_inserted(const std::vector<T> &values);
+      void handle_removed(const std::vector<T> &values);
 
-      void handle_inserted(const T &t);
-      void handle_removed(const T &t);
+      // Grow value_counts up front so that adding a large range
+      // rehashes at most once.
+      void reserve_counts(std::size_t num_new_values);
       class set_enumerator;
 
     public:
@@ -78,6 +87,10 @@ namespace aptitude
 
       sigc::connection connect_inserted(const sigc::slot<void, T> &slot);
       sigc::connection connect_removed(const sigc::slot<void, T> &slot);
+      sigc::connection
+      connect_inserted_range(const sigc::slot<void, const std::vector<T> &> &slot);
+      sigc::connection
+      connect_removed_range(const sigc::slot<void, const std::vector<T> &> &slot);
     };
 
     template<typename T>
@@ -98,14 +111,18 @@ namespace aptitude
     {
       if(contained_sets.find(set) == contained_sets.end())
         {
+          std::vector<T> values;
+          values.reserve(set->size());
           for(boost::shared_ptr<enumerator<T> > e = set->enumerate();
               e->advance(); )
-            handle_inserted(e->get_current());
+            values.push_back(e->get_current());
+
+          handle_inserted(values);
 
           sigc::connection inserted_connection =
-            set->connect_inserted(sigc::mem_fun(*this, &dynamic_set_union::handle_inserted));
+            set->connect_inserted_range(sigc::mem_fun(*this, &dynamic_set_union::handle_inserted));
           sigc::connection removed_connection =
-            set->connect_removed(sigc::mem_fun(*this, &dynamic_set_union::handle_removed));
+            set->connect_removed_range(sigc::mem_fun(*this, &dynamic_set_union::handle_removed));
 
           contained_sets.insert(std::make_pair(set, inserted_connection));
           contained_sets.insert(std::make_pair(set, removed_connection));
@@ -126,9 +143,13 @@ namespace aptitude
 
       if(found.first != found.second)
         {
+          std::vector<T> values;
+          values.reserve(set->size());
           for(boost::shared_ptr<enumerator<T> > e = set->enumerate();
               e->advance(); )
-            handle_removed(e->get_current());
+            values.push_back(e->get_current());
+
+          handle_removed(values);
 
           for(contained_iterator it = found.first; it != found.second; ++it)
             it->second.disconnect();
@@ -156,50 +177,91 @@ namespace aptitude
     sigc::connection
     dynamic_set_union<T>::connect_inserted(const sigc::slot<void, T> &slot)
     {
-      return signal_inserted.connect(slot);
+      return signal_inserted.connect(dynamic_set_each_element<T>(slot));
     }
 
     template<typename T>
     sigc::connection
     dynamic_set_union<T>::connect_removed(const sigc::slot<void, T> &slot)
+    {
+      return signal_removed.connect(dynamic_set_each_element<T>(slot));
+    }
+
+    template<typename T>
+    sigc::connection
+    dynamic_set_union<T>::connect_inserted_range(const sigc::slot<void, const std::vector<T> &> &slot)
+    {
+      return signal_inserted.connect(slot);
+    }
+
+    template<typename T>
+    sigc::connection
+    dynamic_set_union<T>::connect_removed_range(const sigc::slot<void, const std::vector<T> &> &slot)
     {
       return signal_removed.connect(slot);
     }
 
 
     template<typename T>
-    void dynamic_set_union<T>::handle_inserted(const T &t)
+    void dynamic_set_union<T>::reserve_counts(std::size_t num_new_values)
     {
-      typename value_counts_t::iterator found =
-        value_counts.find(t);
+      const float max_load = value_counts.max_load_factor();
+      const std::size_t wanted = value_counts.size() + num_new_values;
 
-      if(found != value_counts.end())
-        ++found->second;
-      else
+      if(wanted > value_counts.bucket_count() * max_load)
+        value_counts.rehash(static_cast<std::size_t>(wanted / max_load) + 1);
+    }
+
+    template<typename T>
+    void dynamic_set_union<T>::handle_inserted(const std::vector<T> &values)
+    {
+      std::vector<T> inserted;
+
+      reserve_counts(values.size());
+
+      for(typename std::vector<T>::const_iterator it = values.begin();
+          it != values.end(); ++it)
         {
-          value_counts.insert(std::make_pair(t, 1));
-          signal_inserted(t);
+          // A single lookup either finds the existing count or adds
+          // a zero count for a new value.
+          const std::pair<typename value_counts_t::iterator, bool> found =
+            value_counts.insert(std::make_pair(*it, 0));
+
+          ++found.first->second;
+          if(found.second)
+            inserted.push_back(*it);
         }
+
+      if(!inserted.empty())
+        signal_inserted(inserted);
     }
 
     template<typename T>
-    void dynamic_set_union<T>::handle_removed(const T &t)
+    void dynamic_set_union<T>::handle_removed(const std::vector<T> &values)
     {
-      typename value_counts_t::iterator found =
-        value_counts.find(t);
+      std::vector<T> removed;
 
-      if(found != value_counts.end())
+      for(typename std::vector<T>::const_iterator it = values.begin();
+          it != values.end(); ++it)
         {
-          --found->second;
+          typename value_counts_t::iterator found =
+            value_counts.find(*it);
 
-          if(found->second == 0)
+          if(found != value_counts.end())
             {
-              // Copy the value to send it to the signal.
-              const T value = found->first;
-              value_counts.erase(found);
-              signal_removed(value);
+              --found->second;
+
+              if(found->second == 0)
+                {
+                  // Copy the value to send it to the signal.
+                  removed.push_back(found->first);
+                  value_counts.erase(found);
+                }
             }
         }
+
+      if(!removed.empty())
+        signal_removed(removed);
     }
 
 
@@ -23,6 +23,7 @@
 #include "util.h"
 
 #include <apt-pkg/fileutl.h>
+#include <apt-pkg/md5.h>
 
 #include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/exception.h>
@@ -30,6 +31,7 @@
 
 #include <boost/format.hpp>
 #include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -40,12 +42,24 @@
 #include <boost/iostreams/stream.hpp>
 #include <boost/iostreams/write.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
 
 #include <loggers.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <utime.h>
+
+#include <fstream>
+#include <iterator>
 
 using namespace aptitude::sqlite;
 namespace cw = cwidget;
@@ -100,6 +114,92 @@ release upgrade23;							\
 
 	  store->exec(sql);
 	}
+
+	// Version 4 added the Compression column to the blobs table,
+	// which says how the blob's data is stored.  Every blob in an
+	// older cache was compressed with zlib.
+	void version_3_to_version_4(const boost::shared_ptr<db> &store)
+	{
+	  LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		   "Upgrading the cache from version 3 to version 4.");
+
+	  store->exec("savepoint upgrade34");
+
+	  boost::shared_ptr<statement> get_version_statement =
+	    statement::prepare(*store, "select version from format");
+	  {
+	    statement::execution get_version_execution(*get_version_statement);
+	    if(!get_version_execution.step())
+	      throw FileCacheException("Can't read the cache version number.");
+	    else
+	      {
+		int database_version = get_version_statement->get_int(0);
+		if(database_version != 3)
+		  throw FileCacheException("Wrong database version number for this upgrade.");
+	      }
+	  }
+
+	  const char * const sql = "                                    \
+alter table blobs							\
+add column Compression  integer   default 1  not null;			\
+									\
+update format								\
+set version = 4;							\
+									\
+release upgrade34;							\
+";
+
+	  store->exec(sql);
+	}
+      }
+
+      /** \brief The ways a blob can be stored; recorded in the
+       *  Compression column of the blobs table.
+       */
+      enum blob_compression
+	{
+	  /** \brief The blob is the file's contents. */
+	  compression_none = 0,
+	  /** \brief The blob is the file's contents compressed with zlib. */
+	  compression_zlib = 1
+	};
+
+      /** \brief Guess whether a file is already compressed by looking
+       *  at its first few bytes.
+       *
+       *  Compressing a PNG screenshot or a gzipped changelog again
+       *  costs CPU time and doesn't save any space.
+       */
+      bool looks_compressed(const std::string &path)
+      {
+	static const struct
+	{
+	  const char *magic;
+	  std::size_t length;
+	} formats[] =
+	    {
+	      { "\x89PNG",       4 },
+	      { "\xff\xd8\xff",  3 }, // JPEG
+	      { "GIF8",          4 },
+	      { "\x1f\x8b",      2 }, // gzip
+	      { "BZh",           3 },
+	      { "\xfd" "7zXZ",   5 }
+	    };
+
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	  return false;
+
+	char header[8];
+	const ssize_t amt = read(fd, header, sizeof(header));
+	close(fd);
+
+	for(std::size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+	  if(amt >= (ssize_t)formats[i].length &&
+	     memcmp(header, formats[i].magic, formats[i].length) == 0)
+	    return true;
+
+	return false;
       }
 
 
@@ -127,24 +227,82 @@ release upgrade23;							\
 	std::string filename; // Used to report errors.
 	/** \brief The maximum size of the cache, in bytes.
 	 *
-	 *  \todo What's the best way to compute the current size?  I
-	 *  could store it in the database and update it as part of
-	 *  the transaction that inserts / removes blobs.  Or I could
-	 *  use triggers to keep it up-to-date.  Or perhaps there's an
-	 *  sqlite query that will return the number of data pages
-	 *  used by a table/column?
+	 *  The current size is kept in the globals table by triggers
+	 *  on the cache table, so it's updated in the same transaction
+	 *  that inserts or removes an entry.
 	 *
-	 *  Also, I need to decide when to vacuum the database: after
+	 *  \todo I need to decide when to vacuum the database: after
 	 *  each update, after deletes, or what?
 	 */
 	int max_size;
 
+	/** \brief The size that the cache is shrunk to when an insert
+	 *  would make it larger than max_size.
+	 *
+	 *  Dropping more than is strictly needed means that a run of
+	 *  inserts into a full cache drops old entries once, in one
+	 *  statement, instead of on every insert.  Small caches only
+	 *  hold a few entries, so they drop just enough to make room.
+	 */
+	int low_water_size;
+
+	static int compute_low_water_size(int max_size)
+	{
+	  if(max_size < 1024 * 1024)
+	    return max_size;
+	  else
+	    return max_size - max_size / 8;
+	}
+
+	/** \brief The zlib compression level for new blobs, or 0 to
+	 *  store them uncompressed.
+	 */
+	int compression_level;
+
 	// Used to ensure that only one thread is accessing the
 	// database connection at once.  Several sqlite3 functions
 	// (e.g., sqlite3_last_insert_rowid()) are not threadsafe.
 	cw::threads::mutex store_mutex;
 
-	static const int current_version_number = 3;
+	/** \brief If \b true, lookups use their own connections to
+	 *  the database instead of \ref store.
+	 *
+	 *  This is only possible for an on-disk cache in WAL mode,
+	 *  where readers see a consistent snapshot of the database
+	 *  and neither block nor are blocked by a writer.  An
+	 *  in-memory database can't be shared between connections,
+	 *  so lookups in it take store_mutex instead.
+	 */
+	bool use_read_connections;
+
+	/** \brief Read-only connections that aren't in use.
+	 *
+	 *  A lookup checks one of these out, or opens a new one if
+	 *  there are none, and puts it back when it's done; so there
+	 *  is one connection for each thread that is reading at
+	 *  once.
+	 */
+	std::vector<boost::shared_ptr<db> > idle_read_connections;
+
+	/** \brief The most read connections that are kept open while
+	 *  they aren't being used.
+	 */
+	static const std::size_t max_idle_read_connections = 4;
+
+	/** \brief Keys that were looked up since the last time the
+	 *  cache was modified, oldest first.
+	 *
+	 *  Marking an entry as recently used is a write, so it can't
+	 *  be done on a read connection.  Since the order of entries
+	 *  only matters when old ones are being dropped, the marks
+	 *  are saved here and applied by the next putItem().
+	 */
+	std::vector<std::string> pending_uses;
+
+	/** \brief Protects idle_read_connections and pending_uses. */
+	cw::threads::mutex readers_mutex;
+
+	static const int current_version_number = 4;
 
 	void create_new_database()
 	{
@@ -168,6 +326,7 @@ create table cache ( CacheId integer primary key,			\
                      Key text not null );				\
 									\
 create table blobs ( BlobId integer primary key,			\
+                     Compression integer default 1 not null,		\
                      Data blob not null );				\
 									\
 create index cache_by_blob_id on cache (BlobId);			\
@@ -275,6 +434,9 @@ insert into globals(TotalBlobSize) values(0);				\
 			    upgrade::version_2_to_version_3(store);
 			    // Fallthrough.
 			  case 3:
+			    upgrade::version_3_to_version_4(store);
+			    // Fallthrough.
+			  case 4:
 			    break;
 
 			  }
@@ -323,7 +485,7 @@ insert into globals(TotalBlobSize) values(0);				\
 			       % total_size % computed_total_size);
 
 		      boost::shared_ptr<statement> fix_total_size_statement =
-			statement::prepare(*store, "update globals set TotalSize = ?");
+			statement::prepare(*store, "update globals set TotalBlobSize = ?");
 		      fix_total_size_statement->bind_int64(1, computed_total_size);
 		      fix_total_size_statement->exec();
 		    }
@@ -353,10 +515,14 @@ insert into globals(TotalBlobSize) values(0);				\
 	}
 
       public:
-	file_cache_sqlite(const std::string &_filename, int _max_size)
+	file_cache_sqlite(const std::string &_filename, int _max_size,
+			  int _compression_level)
 	  : store(db::create(_filename)),
 	    filename(_filename),
-	    max_size(_max_size)
+	    max_size(_max_size),
+	    low_water_size(compute_low_water_size(_max_size)),
+	    compression_level(_compression_level),
+	    use_read_connections(false)
 	{
 	  // Set up the database.  First, check the format:
 	  sqlite::db::statement_proxy check_for_format_statement =
@@ -375,8 +541,140 @@ insert into globals(TotalBlobSize) values(0);				\
 	    create_new_database();
 	  else
 	    sanity_check_database();
+
+	  if(filename != ":memory:")
+	    enable_write_ahead_log();
+	}
+
+	~file_cache_sqlite()
+	{
+	  cw::threads::mutex::lock l(store_mutex);
+
+	  try
+	    {
+	      db::transaction t(*store);
+	      apply_pending_uses();
+	      t.commit();
+	    }
+	  catch(...)
+	    {
+	    }
+	}
+
+      private:
+	/** \brief Switch the database to WAL mode, so that lookups
+	 *  can run alongside inserts.
+	 *
+	 *  If that fails (for instance, because the file is on a
+	 *  network filesystem), lookups fall back to sharing \ref
+	 *  store.
+	 */
+	void enable_write_ahead_log()
+	{
+	  use_read_connections = false;
+
+	  try
+	    {
+	      boost::shared_ptr<statement> journal_mode_statement =
+		statement::prepare(*store, "pragma journal_mode = WAL");
+
+	      statement::execution journal_mode_execution(*journal_mode_statement);
+	      use_read_connections =
+		journal_mode_execution.step() &&
+		journal_mode_statement->get_string(0) == "wal";
+	    }
+	  catch(sqlite::exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       "Can't enable the write-ahead log for \"" << filename << "\": " << ex.errmsg());
+	    }
+
+	  if(use_read_connections)
+	    LOG_DEBUG(Loggers::getAptitudeDownloadCache(),
+		      "Using the write-ahead log for \"" << filename << "\".");
+	  else
+	    LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		     "The write-ahead log is not available for \"" << filename << "\"; lookups will wait for inserts.");
+	}
+
+	/** \brief Get a read connection that no other thread is using.
+	 *
+	 *  It should be handed back with release_read_connection().
+	 */
+	boost::shared_ptr<db> acquire_read_connection()
+	{
+	  {
+	    cw::threads::mutex::lock l(readers_mutex);
+
+	    if(!idle_read_connections.empty())
+	      {
+		boost::shared_ptr<db> rval = idle_read_connections.back();
+		idle_read_connections.pop_back();
+		return rval;
+	      }
+	  }
+
+	  LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+		    "Opening a new read connection to \"" << filename << "\".");
+
+	  boost::shared_ptr<db> rval = db::create(filename, SQLITE_OPEN_READWRITE);
+	  rval->set_busy_timeout(500);
+	  return rval;
+	}
+
+	void release_read_connection(const boost::shared_ptr<db> &conn)
+	{
+	  cw::threads::mutex::lock l(readers_mutex);
+
+	  if(idle_read_connections.size() < max_idle_read_connections)
+	    idle_read_connections.push_back(conn);
+	}
+
+	/** \brief Record that the given key was just looked up. */
+	void note_use(const std::string &key)
+	{
+	  cw::threads::mutex::lock l(readers_mutex);
+
+	  pending_uses.push_back(key);
+	}
+
+	/** \brief Mark every entry that was looked up since the last
+	 *  call as recently used, in the order they were looked up.
+	 *
+	 *  Must be called with store_mutex held, inside a transaction
+	 *  on \ref store.
+	 */
+	void apply_pending_uses()
+	{
+	  std::vector<std::string> uses;
+	  {
+	    cw::threads::mutex::lock l(readers_mutex);
+	    uses.swap(pending_uses);
+	  }
+
+	  if(uses.empty())
+	    return;
+
+	  // WARNING: this might fail if the largest cache ID has been
+	  // used.  That should never happen in aptitude (you'd need
+	  // 10^18 get or put calls), and trying to avoid it seems like
+	  // it would cause a lot of trouble.
+	  //
+	  // The statement is retrieved once and reset for each key.
+	  sqlite::db::statement_proxy update_last_use_statement =
+	    store->get_cached_statement("update cache set CacheId = (select max(CacheId) from cache) + 1 where Key = ?");
+
+	  for(std::vector<std::string>::const_iterator it = uses.begin();
+	      it != uses.end(); ++it)
+	    {
+	      update_last_use_statement->reset();
+	      update_last_use_statement->bind_string(1, *it);
+	      update_last_use_statement->exec();
+	    }
 	}
 
+      public:
+
 	void putItem(const std::string &key,
 		     const std::string &path,
 		     time_t mtime)
@@ -390,32 +688,48 @@ insert into globals(TotalBlobSize) values(0);				\
 	      // there's no way to know the size of the compressed
 	      // data, but we need that size in order to insert it
 	      // into the cache database.
+	      //
+	      // Files that are already compressed, and files that
+	      // don't get any smaller, are stored as they are.
 	      temp::name tn("cacheContentCompressed");
 
-	      const std::string compressed_path(tn.get_name());
+	      // The file whose contents will be stored in the blob.
+	      std::string compressed_path(path);
+	      blob_compression compression = compression_none;
 
 	      // The size of the input file -- used only for logging
 	      // so we can see how well it was compressed.
 	      std::streamsize input_size = -1;
 
-	      // Compress the input file.
-	      //
-	      // TODO: make the compression level an option.  Maybe
-	      // also support other algorithms, although that needs a
-	      // schema change (an extra column in the blobs table
-	      // giving the compressor that was used).
-	      {
-		io::filtering_ostream compressed_out(io::zlib_compressor(9) | io::file_sink(compressed_path));
+	      if(compression_level > 0 && !looks_compressed(path))
+		{
+		  {
+		    io::filtering_ostream compressed_out(io::zlib_compressor(compression_level) | io::file_sink(tn.get_name()));
 
-		input_size = io::copy(io::file(path), compressed_out);
-	      }
+		    input_size = io::copy(io::file(path), compressed_out);
+		  }
 
-	      if(input_size < 0)
-		throw FileCacheException((boost::format("Unable to compress \"%s\" to \"%s\".")
-					  % path % compressed_path).str());
+		  if(input_size < 0)
+		    throw FileCacheException((boost::format("Unable to compress \"%s\" to \"%s\".")
+					      % path % tn.get_name()).str());
 
-	      LOG_TRACE(Loggers::getAptitudeDownloadCache(),
-			"Compressed \"" << path << "\" to \"" << compressed_path << "\"");
+		  struct stat compressed_buf;
+		  if(stat(tn.get_name().c_str(), &compressed_buf) == 0 &&
+		     compressed_buf.st_size < input_size)
+		    {
+		      LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+				"Compressed \"" << path << "\" to \"" << tn.get_name() << "\"");
+
+		      compressed_path = tn.get_name();
+		      compression = compression_zlib;
+		    }
+		  else
+		    LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+			      "Storing \"" << path << "\" uncompressed: compressing it doesn't make it smaller.");
+		}
+	      else
+		LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+			  "Storing \"" << path << "\" uncompressed.");
 
 	      // Here's the plan:
 	      //
@@ -423,10 +737,11 @@ insert into globals(TotalBlobSize) values(0);				\
 	      // 2) If the file is too large to ever cache, return
 	      //    immediately (don't cache it).
 	      // 3) In an sqlite transaction:
-	      //    3.a) Retrieve and save the keys of entries,
-	      //         starting with the oldest, until removing
-	      //         all the stored keys would create enough
-	      //         space for the new entry.
+	      //    3.a) If the new entry doesn't fit, retrieve and
+	      //         save the keys of entries, starting with the
+	      //         oldest, until removing all the stored keys
+	      //         would shrink the cache to low_water_size
+	      //         with the new entry.
 	      //    3.b) Delete the entries that were saved.
 	      //    3.c) Place the new entry into the cache.
 
@@ -455,6 +770,9 @@ insert into globals(TotalBlobSize) values(0);				\
 
 	      off_t compressed_size = buf.st_size;
 
+	      if(compression == compression_none)
+		input_size = compressed_size;
+
 	      if(compressed_size == 0 && input_size > 0)
 		throw FileCacheException("Sanity-check failed: a non-empty file was compressed to zero bytes!.");
 
@@ -484,6 +802,10 @@ insert into globals(TotalBlobSize) values(0);				\
 	      // Step 3)
 	      try
 		{
+		  // Bring the order of the entries up to date before
+		  // deciding which ones to drop.
+		  apply_pending_uses();
+
 		  sqlite::db::statement_proxy get_total_size_statement =
 		    store->get_cached_statement("select TotalBlobSize from globals");
 
@@ -499,8 +821,8 @@ insert into globals(TotalBlobSize) values(0);				\
 		  if(total_size + compressed_size > max_size)
 		    {
 		      LOG_TRACE(Loggers::getAptitudeDownloadCache(),
-				boost::format("The new cache size %ld exceeds the maximum size %ld; dropping old entries.")
-				% (total_size + compressed_size) % max_size);
+				boost::format("The new cache size %ld exceeds the maximum size %ld; dropping old entries down to %ld.")
+				% (total_size + compressed_size) % max_size % low_water_size);
 
 		      bool first = true;
 		      sqlite3_int64 last_cache_id_dropped = -1;
@@ -513,7 +835,7 @@ insert into globals(TotalBlobSize) values(0);				\
 		      {
 			statement::execution read_entries_execution(*read_entries_statement);
 
-			while(total_size + compressed_size - amount_dropped > max_size &&
+			while(total_size + compressed_size - amount_dropped > low_water_size &&
 			      read_entries_execution.step())
 			  {
 			    first = false;
@@ -552,8 +874,9 @@ insert into globals(TotalBlobSize) values(0);				\
 		    // incrementally.
 		    {
 		      sqlite::db::statement_proxy insert_blob_statement =
-			store->get_cached_statement("insert into blobs (Data) values (zeroblob(?))");
-		      insert_blob_statement->bind_int64(1, compressed_size);
+			store->get_cached_statement("insert into blobs (Compression, Data) values (?, zeroblob(?))");
+		      insert_blob_statement->bind_int(1, compression);
+		      insert_blob_statement->bind_int64(2, compressed_size);
 		      insert_blob_statement->exec();
 		    }
 
@@ -660,33 +983,136 @@ insert into globals(TotalBlobSize) values(0);				\
 
 	temp::name getItem(const std::string &key, time_t &mtime)
 	{
-	  cw::threads::mutex::lock l(store_mutex);
+	  try
+	    {
+	      temp::name rval;
+	      lookup(key, mtime, &rval, NULL);
+	      return rval;
+	    }
+	  catch(cw::util::Exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       boost::format("Can't get the cache entry for \"%s\": %s")
+		       % key % ex.errmsg());
+	      return temp::name();
+	    }
+	  catch(std::exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       boost::format("Can't get the cache entry for \"%s\": %s")
+		       % key % ex.what());
+	      return temp::name();
+	    }
+	}
 
+	/** \brief Decompress an entry straight into memory, without
+	 *  going through a temporary file.
+	 */
+	boost::shared_ptr<const std::string>
+	getItemContents(const std::string &key, time_t &mtime)
+	{
+	  try
+	    {
+	      boost::shared_ptr<std::string> rval =
+		boost::make_shared<std::string>();
+	      if(!lookup(key, mtime, NULL, rval.get()))
+		return boost::shared_ptr<const std::string>();
+
+	      return rval;
+	    }
+	  catch(cw::util::Exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       boost::format("Can't get the cache entry for \"%s\": %s")
+		       % key % ex.errmsg());
+	      return boost::shared_ptr<const std::string>();
+	    }
+	  catch(std::exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       boost::format("Can't get the cache entry for \"%s\": %s")
+		       % key % ex.what());
+	      return boost::shared_ptr<const std::string>();
+	    }
+	}
+
+      private:
+	/** \brief Extract the entry for the given key into either a
+	 *  new temporary file or a string, using a connection that no
+	 *  other thread is using.
+	 *
+	 *  Exactly one of file and contents should be non-NULL.
+	 *  Throws an exception if something goes wrong.
+	 *
+	 *  \return \b true if the key was found.
+	 */
+	bool lookup(const std::string &key, time_t &mtime,
+		    temp::name *file, std::string *contents)
+	{
 	  LOG_TRACE(Loggers::getAptitudeDownloadCache(),
 		    boost::format("Looking up \"%s\" in the cache.") % key);
 
+	  bool found;
+
+	  if(use_read_connections)
+	    {
+	      // If the lookup fails, the connection is closed rather
+	      // than reused.
+	      boost::shared_ptr<db> conn = acquire_read_connection();
+	      found = read_item(*conn, key, mtime, file, contents);
+	      release_read_connection(conn);
+	    }
+	  else
+	    {
+	      cw::threads::mutex::lock l(store_mutex);
+	      found = read_item(*store, key, mtime, file, contents);
+	    }
+
+	  if(found)
+	    note_use(key);
+
+	  return found;
+	}
+
+	/** \brief Extract the entry for the given key using the
+	 *  given connection.
+	 *
+	 *  The caller must ensure that no other thread is using conn.
+	 *  Throws an exception if something goes wrong.
+	 *
+	 *  \param file      If not NULL, the entry is extracted to a
+	 *                   new temporary file that's stored here.
+	 *  \param contents  If not NULL, the entry is extracted into
+	 *                   this string instead.
+	 *
+	 *  \return \b true if the key was found.
+	 */
+	bool read_item(db &conn, const std::string &key, time_t &mtime,
+		       temp::name *file, std::string *contents)
+	{
 	  // Here's the plan.
 	  //
 	  // 1) In an sqlite transaction:
 	  //    1.a) Look up the cache entry corresponding
 	  //         to this key.
-	  //    1.a.i)  If there is no entry, return an invalid name.
-	  //    1.a.ii) If there is an entry,
-	  //        1.a.ii.A) Update its last use field.
-	  //        1.a.ii.B) Extract it to a temporary file
-	  //                  and return it.
+	  //    1.a.i)  If there is no entry, return false.
+	  //    1.a.ii) If there is an entry, extract it to a
+	  //            temporary file or to memory.
+	  //
+	  // The entry is marked as recently used afterwards, by
+	  // note_use().
 	  try
 	    {
-	      store->exec("begin transaction");
+	      conn.exec("begin transaction");
 
 	      try
 		{
 		  sqlite::db::statement_proxy find_cache_entry_statement =
-		    store->get_cached_statement("select CacheId, BlobId, ModificationTime from cache where Key = ?");
+		    conn.get_cached_statement("select cache.CacheId, cache.BlobId, cache.ModificationTime, blobs.Compression from cache, blobs where cache.Key = ? and blobs.BlobId = cache.BlobId");
 
 		  bool found = false;
-		  sqlite3_int64 oldCacheId = -1;
 		  sqlite3_int64 blobId = -1;
+		  int compression = compression_zlib;
 		  find_cache_entry_statement->bind_string(1, key);
 		  {
 		    statement::execution find_cache_entry_execution(*find_cache_entry_statement);
@@ -694,9 +1120,9 @@ insert into globals(TotalBlobSize) values(0);				\
 
 		    if(found)
 		      {
-			oldCacheId = find_cache_entry_statement->get_int64(0);
 			blobId     = find_cache_entry_statement->get_int64(1);
 			mtime      = find_cache_entry_statement->get_int64(2);
+			compression = find_cache_entry_statement->get_int(3);
 		      }
 		    else
 		      // 1.a.i: no matching entry
@@ -704,39 +1130,49 @@ insert into globals(TotalBlobSize) values(0);				\
 			LOG_TRACE(Loggers::getAptitudeDownloadCache(),
 				  boost::format("No entry for \"%s\" found in the cache.") % key);
 
-			store->exec("rollback");
-			return temp::name();
+			conn.exec("rollback");
+			return false;
 		      }
 		  }
 
-		  // 1.a.ii.A: update the last use field.
-		  {
-		    // WARNING: this might fail if the largest
-		    // cache ID has been used.  That should never
-		    // happen in aptitude (you'd need 10^18 get or
-		    // put calls), and trying to avoid it seems
-		    // like it would cause a lot of trouble.
-		    sqlite::db::statement_proxy update_last_use_statement =
-		      store->get_cached_statement("update cache set CacheId = (select max(CacheId) from cache) + 1 where CacheId = ?");
-		    update_last_use_statement->bind_int64(1, oldCacheId);
-		    update_last_use_statement->exec();
-		  }
-
-		  // TODO: I should consolidate the temporary
-		  // directories aptitude creates.
-		  temp::name rval("cacheExtracted");
+		  // Where the entry is being extracted to, for the log.
+		  std::string destination("memory");
 
 		  int extracted_size = -1;
 		  {
 		    // Decompress the data as it's written to the
 		    // output file.
-		    io::filtering_ostream outfile(io::zlib_decompressor() | io::file_sink(rval.get_name()));
+		    io::filtering_ostream outfile;
+		    switch(compression)
+		      {
+		      case compression_none:
+			break;
+
+		      case compression_zlib:
+			outfile.push(io::zlib_decompressor());
+			break;
+
+		      default:
+			throw FileCacheException((boost::format("Unknown compression method %d for \"%s\".")
+						  % compression % key).str());
+		      }
+		    if(file != NULL)
+		      {
+			// TODO: I should consolidate the temporary
+			// directories aptitude creates.
+			*file = temp::name("cacheExtracted");
+			destination = file->get_name();
+			outfile.push(io::file_sink(destination));
+		      }
+		    else
+		      outfile.push(io::back_inserter(*contents));
+
 		    if(!outfile.good())
 		      throw FileCacheException(((boost::format("Can't open \"%s\" for writing"))
-						% rval.get_name()).str());
+						% destination).str());
 
 		    boost::shared_ptr<sqlite::blob> blob_data =
-		      sqlite::blob::open(*store,
+		      sqlite::blob::open(conn,
 					 "main",
 					 "blobs",
 					 "Data",
@@ -749,8 +1185,11 @@ insert into globals(TotalBlobSize) values(0);				\
 		    int amount_to_read = blob_data->size();
 		    int blob_offset = 0;
 
+		    if(contents != NULL && compression == compression_none)
+		      contents->reserve(amount_to_read);
+
 		    LOG_TRACE(Loggers::getAptitudeDownloadCache(),
-			      boost::format("Extracting %d bytes to \"%s\".") % amount_to_read % rval.get_name());
+			      boost::format("Extracting %d bytes to \"%s\".") % amount_to_read % destination);
 
 		    // Copy the blob into the temporary file.
 		    while(amount_to_read > 0)
@@ -774,10 +1213,10 @@ insert into globals(TotalBlobSize) values(0);				\
 
 		  LOG_INFO(Loggers::getAptitudeDownloadCache(),
 			   boost::format("Extracted %d bytes corresponding to \"%s\" to \"%s\".")
-			   % extracted_size % key % rval.get_name());
+			   % extracted_size % key % destination);
 
-		  store->exec("commit");
-		  return rval;
+		  conn.exec("commit");
+		  return true;
 		}
 	      catch(...)
 		{
@@ -785,7 +1224,7 @@ insert into globals(TotalBlobSize) values(0);				\
 		  // that fails too.
 		  try
 		    {
-		      store->exec("rollback");
+		      conn.exec("rollback");
 		    }
 		  catch(...)
 		    {
@@ -799,39 +1238,508 @@ insert into globals(TotalBlobSize) values(0);				\
 		  throw;
 		}
 	    }
+	  catch(sqlite::exception &ex)
+	    {
+	      throw FileCacheException("Can't read \"" + key + "\" from the cache: " + ex.errmsg());
+	    }
+	}
+      };
+
+      /** \brief Read the whole of a file that was retrieved from the
+       *  cache.
+       *
+       *  \return the file's contents, or an empty pointer if it
+       *  can't be read.
+       */
+      boost::shared_ptr<const std::string>
+      read_contents(const std::string &key, const temp::name &found)
+      {
+	std::ifstream in(found.get_name().c_str(), std::ios::in | std::ios::binary);
+	boost::shared_ptr<std::string> rval = boost::make_shared<std::string>();
+	rval->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+	if(!in.is_open() || in.bad())
+	  {
+	    LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		     "Can't read the cached copy of \"" << key << "\" from \"" << found.get_name() << "\".");
+	    return boost::shared_ptr<const std::string>();
+	  }
+
+	return rval;
+      }
+
+      /** \brief An in-memory cache of the most recently used files.
+       *
+       *  Unlike an sqlite cache, this stores each file's contents
+       *  exactly as they were inserted, so a hit costs neither
+       *  decompression nor a database query.  getItemContents()
+       *  returns the stored buffer itself; getItem() writes it to a
+       *  temporary file the first time it's asked for and returns
+       *  that same file until the entry is dropped.
+       */
+      class file_cache_memory : public file_cache
+      {
+	struct entry
+	{
+	  std::string key;
+	  boost::shared_ptr<const std::string> contents;
+	  time_t mtime;
+
+	  /** \brief The file that getItem() returns for this entry,
+	   *  or an invalid name if it hasn't been written yet.
+	   */
+	  mutable temp::name extracted;
+
+	  entry(const std::string &_key,
+		const boost::shared_ptr<const std::string> &_contents,
+		time_t _mtime)
+	    : key(_key), contents(_contents), mtime(_mtime)
+	  {
+	  }
+	};
+
+	// Entries are kept in order of last use, with the most
+	// recently used entry at the back.
+	typedef boost::multi_index_container<
+	  entry,
+	  boost::multi_index::indexed_by<
+	    boost::multi_index::hashed_unique<
+	      boost::multi_index::member<entry, std::string, &entry::key> >,
+	    boost::multi_index::sequenced<>
+	    >
+	  > entry_container;
+
+	typedef entry_container::nth_index<0>::type by_key_index;
+	typedef entry_container::nth_index<1>::type by_use_index;
+
+	entry_container entries;
+
+	/** \brief The total size of the stored contents, in bytes. */
+	std::size_t total_size;
+
+	/** \brief The maximum size of the stored contents, in bytes. */
+	std::size_t max_size;
+
+	cw::threads::mutex entries_mutex;
+
+	/** \brief Look up an entry and mark it as recently used.
+	 *
+	 *  Must be called with entries_mutex held.
+	 *
+	 *  \return the entry, or NULL if there isn't one.
+	 */
+	const entry *find_entry(const std::string &key)
+	{
+	  by_key_index &by_key(entries.get<0>());
+	  by_key_index::iterator found = by_key.find(key);
+	  if(found == by_key.end())
+	    return NULL;
+
+	  by_use_index &by_use(entries.get<1>());
+	  by_use.relocate(by_use.end(), entries.project<1>(found));
+
+	  return &*found;
+	}
+
+      public:
+	file_cache_memory(std::size_t _max_size)
+	  : total_size(0), max_size(_max_size)
+	{
+	}
+
+	void putItem(const std::string &key, const std::string &path,
+		     time_t mtime)
+	{
+	  try
+	    {
+	      std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+	      if(!in)
+		throw FileCacheException((boost::format("Can't open \"%s\".") % path).str());
+
+	      in.seekg(0, std::ios::end);
+	      const std::streamoff size = in.tellg();
+	      in.seekg(0, std::ios::beg);
+
+	      if(size < 0 || (std::size_t)size > max_size)
+		{
+		  LOG_INFO(Loggers::getAptitudeDownloadCache(),
+			   "Refusing to cache \"" << path << "\" as \"" << key
+			   << "\" in memory: its size " << size
+			   << " is greater than the cache size limit " << max_size);
+		  return;
+		}
+
+	      boost::shared_ptr<std::string> contents =
+		boost::make_shared<std::string>(size, '\0');
+	      if(size > 0 && !in.read(&(*contents)[0], size))
+		throw FileCacheException((boost::format("Can't read \"%s\".") % path).str());
+
+	      insert(key, contents, mtime);
+
+	      LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+			boost::format("Cached \"%s\" as \"%s\" in memory (%d bytes).")
+			% path % key % contents->size());
+	    }
 	  catch(cw::util::Exception &ex)
 	    {
 	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
-		       boost::format("Can't get the cache entry for \"%s\": %s")
-		       % key % ex.errmsg());
-	      return temp::name();
+		       boost::format("Can't cache \"%s\" as \"%s\": %s")
+		       % path % key % ex.errmsg());
 	    }
 	  catch(std::exception &ex)
 	    {
 	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
-		       boost::format("Can't get the cache entry for \"%s\": %s")
-		       % key % ex.what());
+		       boost::format("Can't cache \"%s\" as \"%s\": %s")
+		       % path % key % ex.what());
+	    }
+	}
+
+	/** \brief Store a buffer that's already in memory, sharing it
+	 *  rather than copying it.
+	 */
+	void putItemContents(const std::string &key,
+			     const boost::shared_ptr<const std::string> &contents,
+			     time_t mtime)
+	{
+	  if(contents->size() > max_size)
+	    {
+	      LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		       "Refusing to cache \"" << key
+		       << "\" in memory: its size " << contents->size()
+		       << " is greater than the cache size limit " << max_size);
+	      return;
+	    }
+
+	  insert(key, contents, mtime);
+
+	  LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+		    boost::format("Cached \"%s\" in memory (%d bytes).")
+		    % key % contents->size());
+	}
+
+      private:
+	/** \brief Add an entry, dropping the oldest entries to make
+	 *  room for it.
+	 *
+	 *  The entry must be no larger than max_size.
+	 */
+	void insert(const std::string &key,
+		    const boost::shared_ptr<const std::string> &contents,
+		    time_t mtime)
+	{
+	  cw::threads::mutex::lock l(entries_mutex);
+
+	  by_key_index &by_key(entries.get<0>());
+	  by_key_index::iterator found = by_key.find(key);
+	  if(found != by_key.end())
+	    {
+	      total_size -= found->contents->size();
+	      by_key.erase(found);
+	    }
+
+	  by_use_index &by_use(entries.get<1>());
+	  while(!by_use.empty() && total_size + contents->size() > max_size)
+	    {
+	      LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+			"Dropping \"" << by_use.front().key << "\" from the in-memory cache.");
+
+	      total_size -= by_use.front().contents->size();
+	      by_use.pop_front();
+	    }
+
+	  by_use.push_back(entry(key, contents, mtime));
+	  total_size += contents->size();
+	}
+
+      public:
+	boost::shared_ptr<const std::string>
+	getItemContents(const std::string &key, time_t &mtime)
+	{
+	  cw::threads::mutex::lock l(entries_mutex);
+
+	  const entry *found = find_entry(key);
+	  if(found == NULL)
+	    return boost::shared_ptr<const std::string>();
+
+	  mtime = found->mtime;
+	  return found->contents;
+	}
+
+	temp::name getItem(const std::string &key, time_t &mtime)
+	{
+	  cw::threads::mutex::lock l(entries_mutex);
+
+	  const entry *found = find_entry(key);
+	  if(found == NULL)
+	    return temp::name();
+
+	  mtime = found->mtime;
+
+	  if(!found->extracted.valid())
+	    {
+	      try
+		{
+		  temp::name extracted("cacheExtracted");
+
+		  std::ofstream out(extracted.get_name().c_str(),
+				    std::ios::out | std::ios::binary);
+		  out.write(found->contents->data(), found->contents->size());
+		  out.close();
+
+		  if(!out)
+		    throw FileCacheException((boost::format("Can't write \"%s\".") % extracted.get_name()).str());
+
+		  found->extracted = extracted;
+		}
+	      catch(cw::util::Exception &ex)
+		{
+		  LOG_WARN(Loggers::getAptitudeDownloadCache(),
+			   boost::format("Can't get the cache entry for \"%s\": %s")
+			   % key % ex.errmsg());
+		  return temp::name();
+		}
+	    }
+
+	  return found->extracted;
+	}
+      };
+
+      /** \brief A cache stored as plain files in a directory that
+       *  several systems can share, e.g. over NFS.
+       *
+       *  Each item is stored in a file named after the MD5 sum of
+       *  its key, with the item's modification time as the file's
+       *  modification time.  Files are written under a temporary name
+       *  and renamed into place, so a reader on another system never
+       *  sees a partly written item.  Nothing is ever removed from
+       *  the directory: it belongs to the whole site, so expiring old
+       *  items is left to whoever administers it.
+       */
+      class file_cache_shared_dir : public file_cache
+      {
+	std::string dirname;
+
+	/** \brief Return the directory that the item with the given
+	 *  hash goes in; spreading items over subdirectories keeps
+	 *  the directories small.
+	 */
+	std::string get_subdir(const std::string &hash) const
+	{
+	  return dirname + "/" + std::string(hash, 0, 2);
+	}
+
+	static std::string get_hash(const std::string &key)
+	{
+	  MD5Summation sum;
+	  sum.Add(key.c_str());
+	  return sum.Result().Value();
+	}
+
+	std::string get_path(const std::string &key) const
+	{
+	  const std::string hash = get_hash(key);
+	  return get_subdir(hash) + "/" + hash;
+	}
+
+	static bool copy_to_fd(const std::string &path, int fd)
+	{
+	  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+	  if(!in)
+	    return false;
+
+	  char buf[16384];
+	  while(in.read(buf, sizeof(buf)) || in.gcount() > 0)
+	    {
+	      const char *start = buf;
+	      std::streamsize amt = in.gcount();
+	      while(amt > 0)
+		{
+		  const ssize_t written = write(fd, start, amt);
+		  if(written < 0 && errno == EINTR)
+		    continue;
+		  else if(written <= 0)
+		    return false;
+
+		  start += written;
+		  amt -= written;
+		}
+	    }
+
+	  return !in.bad();
+	}
+
+      public:
+	file_cache_shared_dir(const std::string &_dirname)
+	  : dirname(_dirname)
+	{
+	}
+
+	void putItem(const std::string &key, const std::string &path,
+		     time_t mtime)
+	{
+	  const std::string hash = get_hash(key);
+	  const std::string subdir = get_subdir(hash);
+	  const std::string target = subdir + "/" + hash;
+
+	  if(mkdir(subdir.c_str(), 0755) != 0 && errno != EEXIST)
+	    {
+	      LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		       "Can't create \"" << subdir << "\" in the shared cache: "
+		       << cw::util::sstrerror(errno));
+	      return;
+	    }
+
+	  std::string tmp_name = target + ".XXXXXX";
+	  const int fd = mkstemp(&tmp_name[0]);
+	  if(fd < 0)
+	    {
+	      LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		       "Can't store \"" << key << "\" in the shared cache: "
+		       << cw::util::sstrerror(errno));
+	      return;
+	    }
+
+	  // mkstemp() creates files that only their owner can read.
+	  bool ok = fchmod(fd, 0644) == 0 && copy_to_fd(path, fd);
+	  ok = close(fd) == 0 && ok;
+
+	  struct utimbuf times;
+	  times.actime = mtime;
+	  times.modtime = mtime;
+	  ok = ok && utime(tmp_name.c_str(), &times) == 0;
+	  ok = ok && rename(tmp_name.c_str(), target.c_str()) == 0;
+
+	  if(!ok)
+	    {
+	      LOG_INFO(Loggers::getAptitudeDownloadCache(),
+		       "Can't store \"" << key << "\" in the shared cache: "
+		       << cw::util::sstrerror(errno));
+	      unlink(tmp_name.c_str());
+	      return;
+	    }
+
+	  LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+		    "Cached \"" << path << "\" as \"" << key
+		    << "\" in the shared cache at \"" << target << "\".");
+	}
+
+	temp::name getItem(const std::string &key, time_t &mtime)
+	{
+	  const std::string path = get_path(key);
+	  struct stat buf;
+	  if(stat(path.c_str(), &buf) != 0)
+	    return temp::name();
+
+	  // Another system could replace the file at any time, so
+	  // hand out a private copy.
+	  temp::name rval("cacheShared");
+	  const int fd = open(rval.get_name().c_str(),
+			      O_WRONLY | O_CREAT | O_EXCL, 0600);
+	  if(fd < 0)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       "Can't create \"" << rval.get_name() << "\": "
+		       << cw::util::sstrerror(errno));
+	      return temp::name();
+	    }
+
+	  const bool ok = copy_to_fd(path, fd);
+	  if(close(fd) != 0 || !ok)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       "Can't read \"" << key << "\" from the shared cache at \""
+		       << path << "\".");
 	      return temp::name();
 	    }
+
+	  LOG_TRACE(Loggers::getAptitudeDownloadCache(),
+		    "Found \"" << key << "\" in the shared cache.");
+	  mtime = buf.st_mtime;
+	  return rval;
+	}
+
+	boost::shared_ptr<const std::string>
+	getItemContents(const std::string &key, time_t &mtime)
+	{
+	  const std::string path = get_path(key);
+	  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+	  struct stat buf;
+	  if(!in || stat(path.c_str(), &buf) != 0)
+	    return boost::shared_ptr<const std::string>();
+
+	  boost::shared_ptr<std::string> rval = boost::make_shared<std::string>();
+	  rval->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	  if(in.bad())
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       "Can't read \"" << key << "\" from the shared cache at \""
+		       << path << "\".");
+	      return boost::shared_ptr<const std::string>();
+	    }
+
+	  mtime = buf.st_mtime;
+	  return rval;
 	}
       };
 
       /** \brief A multilevel cache.
        *
        *  "get" requests are serviced from each sub-cache in turn,
-       *  failing if the object isn't found in any cache.
+       *  failing if the object isn't found in any cache.  Anything
+       *  that is found is copied into the in-memory cache, if there
+       *  is one, and into the sub-caches that were checked before
+       *  it; e.g., items found in a shared cache are stored in the
+       *  local on-disk cache.
        *
        *  "put" requests are forwarded to all sub-caches.
        */
       class file_cache_multilevel : public file_cache
       {
+	boost::shared_ptr<file_cache_memory> memory;
 	std::vector<boost::shared_ptr<file_cache> > caches;
 
+	typedef std::vector<boost::shared_ptr<file_cache> >::const_iterator cache_iterator;
+
+	/** \brief Store an item that was found in a later sub-cache
+	 *  in the sub-caches [begin, end).
+	 */
+	static void populate(cache_iterator begin, cache_iterator end,
+			     const std::string &key,
+			     const temp::name &found,
+			     time_t mtime)
+	{
+	  for(cache_iterator it = begin; it != end; ++it)
+	    (*it)->putItem(key, found.get_name(), mtime);
+	}
+
+	static temp::name write_contents(const std::string &contents)
+	{
+	  temp::name rval("cacheContents");
+	  std::ofstream out(rval.get_name().c_str(),
+			    std::ios::out | std::ios::binary);
+	  out.write(contents.data(), contents.size());
+	  out.close();
+
+	  if(!out)
+	    {
+	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		       "Can't write \"" << rval.get_name() << "\".");
+	      return temp::name();
+	    }
+
+	  return rval;
+	}
+
       public:
 	file_cache_multilevel()
 	{
 	}
 
+	void set_memory_cache(const boost::shared_ptr<file_cache_memory> &cache)
+	{
+	  memory = cache;
+	}
+
 	void push_back(const boost::shared_ptr<file_cache> &cache)
 	{
 	  caches.push_back(cache);
@@ -841,6 +1749,9 @@ insert into globals(TotalBlobSize) values(0);				\
 	void putItem(const std::string &key, const std::string &path,
 		     time_t mtime)
 	{
+	  if(memory.get() != NULL)
+	    memory->putItem(key, path, mtime);
+
 	  for(std::vector<boost::shared_ptr<file_cache> >::const_iterator
 		it = caches.begin(); it != caches.end(); ++it)
 	    (*it)->putItem(key, path, mtime);
@@ -848,40 +1759,91 @@ insert into globals(TotalBlobSize) values(0);				\
 
 	temp::name getItem(const std::string &key, time_t &mtime)
 	{
+	  if(memory.get() != NULL)
+	    {
+	      temp::name found = memory->getItem(key, mtime);
+	      if(found.valid())
+		return found;
+	    }
+
 	  for(std::vector<boost::shared_ptr<file_cache> >::const_iterator
 		it = caches.begin(); it != caches.end(); ++it)
 	    {
 	      temp::name found = (*it)->getItem(key, mtime);
 	      if(found.valid())
-		return found;
+		{
+		  if(memory.get() != NULL)
+		    memory->putItem(key, found.get_name(), mtime);
+		  populate(caches.begin(), it, key, found, mtime);
+
+		  return found;
+		}
 	    }
 
 	  return temp::name();
 	}
+
+	boost::shared_ptr<const std::string>
+	getItemContents(const std::string &key, time_t &mtime)
+	{
+	  if(memory.get() != NULL)
+	    {
+	      boost::shared_ptr<const std::string> found =
+		memory->getItemContents(key, mtime);
+	      if(found.get() != NULL)
+		return found;
+	    }
+
+	  // The contents are read straight into memory and shared
+	  // with the in-memory cache, so no temporary file is written.
+	  for(std::vector<boost::shared_ptr<file_cache> >::const_iterator
+		it = caches.begin(); it != caches.end(); ++it)
+	    {
+	      boost::shared_ptr<const std::string> found =
+		(*it)->getItemContents(key, mtime);
+	      if(found.get() != NULL)
+		{
+		  if(memory.get() != NULL)
+		    memory->putItemContents(key, found, mtime);
+
+		  // The other sub-caches only accept files, so this
+		  // is the one case that needs a temporary file.
+		  if(it != caches.begin())
+		    {
+		      temp::name tn = write_contents(*found);
+		      if(tn.valid())
+			populate(caches.begin(), it, key, tn, mtime);
+		    }
+
+		  return found;
+		}
+	    }
+
+	  return boost::shared_ptr<const std::string>();
+	}
       };
     }
 
+    boost::shared_ptr<const std::string>
+    file_cache::getItemContents(const std::string &key, time_t &mtime)
+    {
+      temp::name found = getItem(key, mtime);
+      if(!found.valid())
+	return boost::shared_ptr<const std::string>();
+
+      return read_contents(key, found);
+    }
+
     boost::shared_ptr<file_cache> file_cache::create(const std::string &filename,
 						     int memory_size,
-						     int disk_size)
+						     int disk_size,
+						     int compression_level,
+						     const std::string &shared_directory)
     {
       boost::shared_ptr<file_cache_multilevel> rval = boost::make_shared<file_cache_multilevel>();
 
       if(memory_size > 0)
-	{
-	  try
-	    {
-	      // \note A boost::multi_index_container might be more
-	      // efficient for the in-memory cache.  OTOH, it would
-	      // require more code.
-	      rval->push_back(boost::make_shared<file_cache_sqlite>(":memory:", memory_size));
-	    }
-	  catch(const cw::util::Exception &ex)
-	    {
-	      LOG_WARN(Loggers::getAptitudeDownloadCache(),
-		       "Unable to create the in-memory cache: " << ex.errmsg());
-	    }
-	}
+	rval->set_memory_cache(boost::make_shared<file_cache_memory>(memory_size));
       else
 	LOG_INFO(Loggers::getAptitudeDownloadCache(),
 		 "In-memory cache disabled.");
@@ -891,7 +1853,8 @@ insert into globals(TotalBlobSize) values(0);				\
 	{
 	  try
 	    {
-	      rval->push_back(boost::make_shared<file_cache_sqlite>(filename, disk_size));
+	      rval->push_back(boost::make_shared<file_cache_sqlite>(filename, disk_size,
+								    compression_level));
 	    }
 	  catch(const cw::util::Exception &ex)
 	    {
@@ -903,6 +1866,17 @@ insert into globals(TotalBlobSize) values(0);				\
 	LOG_INFO(Loggers::getAptitudeDownloadCache(),
 		 "On-disk cache disabled.");
 
+      if(!shared_directory.empty())
+	{
+	  struct stat buf;
+	  if(stat(shared_directory.c_str(), &buf) != 0 || !S_ISDIR(buf.st_mode))
+	    LOG_WARN(Loggers::getAptitudeDownloadCache(),
+		     "Not using the shared cache \"" << shared_directory
+		     << "\": it is not a directory.");
+	  else
+	    rval->push_back(boost::make_shared<file_cache_shared_dir>(shared_directory));
+	}
+
       return rval;
     }
 
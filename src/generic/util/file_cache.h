@@ -21,6 +21,8 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <string>
+
 #include <time.h>
 
 #include "temp.h"
@@ -89,6 +91,9 @@ namespace aptitude
        *  As a side effect, marks the file as recently visited, so it
        *  will be less likely to be removed from the cache.
        *
+       *  The returned file may be shared with other callers, so it
+       *  must not be modified.
+       *
        *  \param key   The key under which the file was stored.
        *  \param mtime Set to the most recent date and time at which
        *               the given key was modified.
@@ -96,6 +101,22 @@ namespace aptitude
       virtual temp::name getItem(const std::string &key,
 				 time_t &mtime) = 0;
 
+      /** \brief Retrieve the contents of a file from the cache.
+       *
+       *  Like getItem(), but returns the file's contents instead of
+       *  a file.  If the item is in the in-memory cache, this
+       *  returns the stored buffer itself without copying it.
+       *
+       *  \param key   The key under which the file was stored.
+       *  \param mtime Set to the most recent date and time at which
+       *               the given key was modified.
+       *
+       *  \return the contents of the file, or an empty pointer if
+       *  the key isn't in the cache.
+       */
+      virtual boost::shared_ptr<const std::string>
+      getItemContents(const std::string &key, time_t &mtime);
+
       /** \brief Retrieve a file from the cache.
        *
        *  As a side effect, marks the file as recently visited, so it
@@ -115,15 +136,29 @@ namespace aptitude
        *  \param filename       The file in which the on-disk cache is
        *                        stored.
        *  \param memory_size    The maximum allowed size in bytes of the in-memory
-       *                        cache. (if zero, only an on-disk cache
-       *                        will be used)
+       *                        cache, which holds the most recently
+       *                        used files uncompressed. (if zero, only
+       *                        an on-disk cache will be used)
        *  \param disk_size      The maximum allowed size in bytes of the on-disk
        *                        cache.  (if zero, only a memory cache
        *                        will be used)
+       *  \param compression_level  The zlib compression level (1-9)
+       *                        used to store new files on disk, or 0
+       *                        to store them uncompressed.  Files that are
+       *                        already compressed (e.g., PNG images)
+       *                        are always stored as they are.
+       *  \param shared_directory  A directory that other systems
+       *                        also cache files in (e.g., over NFS),
+       *                        or an empty string to not use one.
+       *                        It is checked after the other caches,
+       *                        and anything found in it is copied into
+       *                        them.  Items are never removed from it.
        */
       static boost::shared_ptr<file_cache> create(const std::string &filename,
 						  int memory_size,
-						  int disk_size);
+						  int disk_size,
+						  int compression_level = 1,
+						  const std::string &shared_directory = std::string());
 
       virtual ~file_cache();
     };
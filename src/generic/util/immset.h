@@ -271,6 +271,26 @@ namespace imm
       return realNode->getRightChild();
     }
 
+    /** \return a reference to the left child.
+     *
+     *  Unlike getLeft(), this does not touch any reference counts;
+     *  the reference is only valid as long as this node is.
+     */
+    const wtree_node &getLeftChild() const
+    {
+      return realNode->getLeftChild();
+    }
+
+    /** \return a reference to the right child.
+     *
+     *  Unlike getRight(), this does not touch any reference counts;
+     *  the reference is only valid as long as this node is.
+     */
+    const wtree_node &getRightChild() const
+    {
+      return realNode->getRightChild();
+    }
+
     size_type size() const
     {
       if(realNode == NULL)
@@ -279,6 +299,12 @@ namespace imm
 	return realNode->getSize();
     }
 
+    /** \return the number of bytes allocated for each node. */
+    static std::size_t node_memory_size()
+    {
+      return sizeof(impl);
+    }
+
     wtree_node &operator=(const wtree_node &other)
     {
       if(other.realNode != NULL)
@@ -1019,26 +1045,52 @@ namespace imm
       return rval;
     }
 
-    /** Find a tree node by value.  \return the node, or an invalid
-     *	node if none exists.
+    /** Find a tree node by comparing a key against the values in
+     *  the tree.
+     *
+     *  \param k    The key to search for.
+     *  \param cmp  A function object such that cmp(k, v) is negative,
+     *              zero or positive as k is less than, equivalent to or
+     *              greater than the value v, consistently with the
+     *              ordering of this set.
+     *
+     *  \return the node, or an invalid node if none exists.
+     *
+     *  The search walks the tree by reference, so it doesn't touch
+     *  the reference counts of the nodes it passes through.
      */
-    node find_node(const Val &x) const
+    template<typename K, typename KeyCompare>
+    const node &find_node_by_key(const K &k, const KeyCompare &cmp) const
     {
-      node rval = impl.get_root();
+      const node *n = &impl.get_root();
 
-      while(rval.isValid())
+      while(n->isValid())
       {
-	int cmp = impl.get_value_compare()(x, rval.getVal());
+	int c = cmp(k, n->getVal());
 
-	if(cmp < 0)
-	  rval = rval.getLeft();
-	else if(cmp > 0)
-	  rval = rval.getRight();
+	if(c < 0)
+	  n = &n->getLeftChild();
+	else if(c > 0)
+	  n = &n->getRightChild();
 	else
-	  return rval;
+	  break;
       }
 
-      return rval;
+      return *n;
+    }
+
+    /** Find a tree node by value.  \return the node, or an invalid
+     *	node if none exists.
+     */
+    node find_node(const Val &x) const
+    {
+      return find_node_by_key(x, impl.get_value_compare());
+    }
+
+    /** \return the comparison operator of this set. */
+    const Compare &get_value_compare() const
+    {
+      return impl.get_value_compare();
     }
 
     /** \return the accumulated value for the entire set. */
@@ -1053,7 +1105,7 @@ namespace imm
     /** \return \b true if this set contains the given value. */
     bool contains(const Val &x) const
     {
-      return find_node(x).isValid();
+      return find_node_by_key(x, impl.get_value_compare()).isValid();
     }
 
     const_iterator begin() const
@@ -1088,6 +1140,16 @@ namespace imm
       return impl.get_root().size();
     }
 
+    /** \brief Estimate the memory used by the nodes of this set.
+     *
+     *  Nodes are shared between sets, so the estimates for several
+     *  sets can count the same memory more than once.
+     */
+    std::size_t memory_usage() const
+    {
+      return size() * node::node_memory_size();
+    }
+
     int empty() const
     {
       return impl.get_root().empty();
@@ -1237,6 +1299,30 @@ namespace imm
   private:
     mapping_type contents;
 
+    /** Compares a key directly against a binding, so that lookups
+     *  don't need to build a binding (and a default-constructed
+     *  value) to search with.
+     */
+    struct compare_key_to_binding
+    {
+      const Compare &real_cmp;
+
+      compare_key_to_binding(const Compare &_real_cmp)
+	: real_cmp(_real_cmp)
+      {
+      }
+
+      int operator()(const Key &k, const binding_type &b) const
+      {
+	return real_cmp(k, b.first);
+      }
+    };
+
+    const node &find_binding(const Key &k) const
+    {
+      return contents.find_node_by_key(k, compare_key_to_binding(contents.get_value_compare().real_cmp));
+    }
+
   public:
     /** Construct a map directly from a set of bindings. */
     map(const mapping_type &_contents)
@@ -1287,12 +1373,18 @@ namespace imm
       return contents.size();
     }
 
+    /** \brief Estimate the memory used by the nodes of this map. */
+    std::size_t memory_usage() const
+    {
+      return contents.memory_usage();
+    }
+
     /** \return either the node corresponding to the given key,
      *  or an empty tree.
      */
     node lookup(const Key &k) const
     {
-      return contents.find_node(binding_type(k, Val()));
+      return find_binding(k);
     }
 
     /** \return the accumulated value of the whole map. */
@@ -1306,7 +1398,7 @@ namespace imm
      */
     Val get(const Key &k, const Val &dflt) const
     {
-      node found = contents.find_node(binding_type(k, Val()));
+      const node &found = find_binding(k);
 
       if(found.isValid())
 	return found.getVal().second;
@@ -1355,7 +1447,7 @@ namespace imm
     /** \return \b true if k is in the domain of this mapping. */
     bool domain_contains(const Key &k) const
     {
-      return contents.contains(binding_type(k, Val()));
+      return find_binding(k).isValid();
     }
 
     bool operator<(const map &other) const
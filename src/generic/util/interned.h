@@ -0,0 +1,232 @@
+/** \file interned.h */ // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef INTERNED_H
+#define INTERNED_H
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <set>
+
+/** \brief A handle on a shared, immutable copy of a value.
+ *
+ *  Every distinct value is stored once, in a process-wide pool that
+ *  is never emptied, and an interned object is just a pointer into
+ *  that pool.  Copying, assigning and comparing interned objects are
+ *  therefore as cheap as copying and comparing a pointer, and an
+ *  array of structures containing them can be copied with memcpy().
+ *
+ *  This is meant for small sets of values that are stored many
+ *  times over, such as the per-package version strings in the
+ *  aptitude state.  Since the pool never shrinks, it should not be
+ *  used for values that are generated without bound.
+ *
+ *  Creating an interned object from a value takes a lock and
+ *  searches the pool; reading one does neither, so it is safe to
+ *  read the value of an interned object from any thread.
+ *
+ *  \tparam T   The type of value to store.  Must be
+ *              default-constructible, copyable, and ordered by
+ *              operator<.  The default-constructed value is not
+ *              stored in the pool.
+ */
+template<typename T>
+class interned
+{
+  /** \brief The pooled value, or NULL for the default value. */
+  const T *value;
+
+  static const T &get_default_value()
+  {
+    static const T default_value = T();
+    return default_value;
+  }
+
+  static const T *intern(const T &v)
+  {
+    // A value that is not less than or greater than the default is
+    // the default.
+    if(!(v < get_default_value()) && !(get_default_value() < v))
+      return NULL;
+
+    static cwidget::threads::mutex pool_mutex;
+    static std::set<T> pool;
+
+    cwidget::threads::mutex::lock l(pool_mutex);
+    return &*pool.insert(v).first;
+  }
+
+public:
+  /** \brief Create a handle on the default value. */
+  interned()
+    : value(NULL)
+  {
+  }
+
+  /** \brief Create a handle on the pooled copy of v. */
+  interned(const T &v)
+    : value(intern(v))
+  {
+  }
+
+  /** \return the stored value. */
+  const T &get() const
+  {
+    return value == NULL ? get_default_value() : *value;
+  }
+
+  /** \return \b true if this holds the default value. */
+  bool empty() const
+  {
+    return value == NULL;
+  }
+
+  /** \brief Compare two interned values.
+   *
+   *  Since every distinct value is pooled once, two handles are
+   *  equal exactly when they point at the same copy.
+   */
+  bool operator==(const interned &other) const
+  {
+    return value == other.value;
+  }
+
+  bool operator!=(const interned &other) const
+  {
+    return value != other.value;
+  }
+};
+
+/** \brief A pool of shared, immutable values that belongs to the
+ *  object using it.
+ *
+ *  Like interned, every distinct value is stored once and a handle is
+ *  just a pointer to the stored copy, so handles are compared by
+ *  comparing pointers.  Unlike interned, the pool is an ordinary
+ *  object: it takes no lock, so it must only be used by one thread at
+ *  a time, and clear() frees every value in it.  This suits values
+ *  that one computation generates in bulk and throws away when it
+ *  finishes.
+ *
+ *  \tparam T     The type of value to store.  Must be copyable and
+ *                comparable with operator==.
+ *  \tparam Hash  A function object that hashes values of type T.
+ */
+template<typename T, typename Hash = boost::hash<T> >
+class intern_pool
+{
+  // Hashed containers never move their elements, so handles stay
+  // valid as the pool grows.
+  typedef boost::unordered_set<T, Hash> value_set;
+  value_set values;
+
+  // Copying a pool would leave its handles pointing into the
+  // original.
+  intern_pool(const intern_pool &);
+  intern_pool &operator=(const intern_pool &);
+
+public:
+  /** \brief A handle on a value stored in the pool.
+   *
+   *  Handles are only valid until the pool that created them is
+   *  cleared or destroyed.
+   */
+  class handle
+  {
+    const T *value;
+
+    friend class intern_pool;
+
+    explicit handle(const T *_value)
+      : value(_value)
+    {
+    }
+
+  public:
+    /** \brief Create a handle that refers to no value; it may be
+     *  assigned to, but not read.
+     */
+    handle()
+      : value(NULL)
+    {
+    }
+
+    /** \return the stored value. */
+    const T &get() const
+    {
+      return *value;
+    }
+
+    operator const T &() const
+    {
+      return *value;
+    }
+
+    /** \brief Compare two handles from the same pool. */
+    bool operator==(const handle &other) const
+    {
+      return value == other.value;
+    }
+
+    bool operator!=(const handle &other) const
+    {
+      return value != other.value;
+    }
+  };
+
+  typedef typename value_set::const_iterator const_iterator;
+
+  intern_pool()
+  {
+  }
+
+  /** \brief Return a handle on the pooled copy of v, adding a copy
+   *  to the pool if there isn't one yet.
+   */
+  handle intern(const T &v)
+  {
+    return handle(&*values.insert(v).first);
+  }
+
+  /** \return the number of distinct values in the pool. */
+  std::size_t size() const { return values.size(); }
+
+  const_iterator begin() const { return values.begin(); }
+  const_iterator end() const { return values.end(); }
+
+  /** \brief Free every value in the pool, invalidating all handles. */
+  void clear()
+  {
+    values.clear();
+  }
+
+  /** \brief Estimate the memory used by the pool itself, not
+   *  counting memory owned by the values.
+   */
+  std::size_t memory_usage() const
+  {
+    return values.bucket_count() * sizeof(void *) +
+      values.size() * (sizeof(T) + sizeof(void *));
+  }
+};
+
+#endif // INTERNED_H
@@ -24,14 +24,23 @@
 
 #include <cwidget/generic/threads/threads.h>
 
+#include <generic/util/thread_pool.h>
+
 #include <loggers.h>
 
 namespace aptitude
 {
   namespace util
   {
-    /** \brief Base class for threads that work by processing a single
-     *  job at a time.
+    /** \brief Base class for background workers that process a
+     *  single job at a time.
+     *
+     *  The jobs are run by the global thread_pool: while the queue
+     *  is nonempty, one task of the pool processes a job and then
+     *  queues itself again for the next one.  So jobs are still
+     *  processed one at a time and in order, but an idle queue
+     *  doesn't hold on to a thread, and a busy one shares the pool
+     *  fairly with everything else.
      *
      *  \tparam Subclass The class that will be derived from
      *  job_queue.  Must be default-constructable and must define a
@@ -54,8 +63,9 @@ namespace aptitude
       // The single instance of this class.
       static boost::shared_ptr<job_queue_thread> active_instance;
 
-      // The active thread, or NULL if there isn't one.
-      static boost::shared_ptr<cwidget::threads::thread> active_thread;
+      // Set to true while a task that processes the queue is waiting
+      // in the thread pool or running.
+      static bool active;
 
       // Set to true if the thread is currently stopped.  This causes
       // the job-processing loop to exit and prevents the thread from
@@ -66,6 +76,9 @@ namespace aptitude
       // job.
       static cwidget::threads::mutex state_mutex;
 
+      // Signalled when the task processing the queue exits.
+      static cwidget::threads::condition idle_cond;
+
       class bootstrap
       {
 	boost::shared_ptr<job_queue_thread> target;
@@ -126,12 +139,12 @@ namespace aptitude
 	  start();
       }
 
-      /** \brief Stop the active thread if there is one.
+      /** \brief Stop processing jobs.
        *
        *  The background thread will only be stopped between jobs.
        *
-       *  Blocks until the thread exits.  Until start() is invoked, no
-       *  jobs will be processed.
+       *  Blocks until the job being processed, if any, is done.
+       *  Until start() is invoked, no jobs will be processed.
        */
       static void stop()
       {
@@ -142,14 +155,8 @@ namespace aptitude
 
 	stopped = true;
 
-	// Copy this since it'll be zeroed out when the thread exits,
-	// which can happen as soon as the lock is released below.
-	boost::shared_ptr<cwidget::threads::thread> active_thread_copy(active_thread);
-
-	l.release();
-
-	if(active_thread_copy.get() != NULL)
-	  active_thread_copy->join();
+	while(active)
+	  idle_cond.wait(l);
       }
 
       /** \brief Start the background thread if it has jobs to
@@ -164,7 +171,7 @@ namespace aptitude
 
 	stopped = false;
 
-	if(active_thread != NULL)
+	if(active)
 	  LOG_TRACE(Subclass::get_log_category(),
 		    "Not starting the background thread: it's already running.");
 	else if(empty())
@@ -174,8 +181,9 @@ namespace aptitude
 	  {
 	    LOG_TRACE(Subclass::get_log_category(), "Starting the background thread.");
 
+	    active = true;
 	    active_instance = boost::make_shared<Subclass>();
-	    active_thread = boost::make_shared<cwidget::threads::thread>(bootstrap(active_instance));
+	    thread_pool::get().submit(bootstrap(active_instance));
 	  }
       }
 
@@ -183,70 +191,50 @@ namespace aptitude
       virtual void process_job(const Job &job) = 0;
 
     private:
-      /** \brief Dequeue and process jobs until the queue is empty or
-       *  the thread is stopped.
+      /** \brief Process the next job, then queue another task for
+       *  the job after it, unless the queue is empty or stopped.
        */
       void run()
       {
-	try
+	cwidget::threads::mutex::lock l(state_mutex);
+
+	if(!jobs.empty() && !stopped)
 	  {
-	    cwidget::threads::mutex::lock l(state_mutex);
+	    Job next(jobs.front());
+	    jobs.pop_front();
 
-	    while(!jobs.empty() && !stopped)
+	    // Unlock the state mutex, so that jobs can be inserted
+	    // without blocking while this job is being processed.
+	    l.release();
+
+	    try
+	      {
+		process_job(next);
+	      }
+	    catch(const std::exception &ex)
+	      {
+		LOG_WARN(Subclass::get_log_category(), "Background thread: got std::exception: " << ex.what());
+	      }
+	    catch(const cwidget::util::Exception &ex)
+	      {
+		LOG_WARN(Subclass::get_log_category(), "Background thread: got cwidget::util::Exception: " << ex.errmsg());
+	      }
+	    catch(...)
 	      {
-		Job next(jobs.front());
-		jobs.pop_front();
-
-		// Unlock the state mutex, so that jobs can be
-		// inserted without blocking while this job is being
-		// processed.
-		l.release();
-
-		try
-		  {
-		    process_job(next);
-		  }
-		catch(const std::exception &ex)
-		  {
-		    LOG_WARN(Subclass::get_log_category(), "Background thread: got std::exception: " << ex.what());
-		  }
-		catch(const cwidget::util::Exception &ex)
-		  {
-		    LOG_WARN(Subclass::get_log_category(), "Background thread: got cwidget::util::Exception: " << ex.errmsg());
-		  }
-		catch(...)
-		  {
-		    LOG_WARN(Subclass::get_log_category(), "Background thread: got an unknown exception.");
-		  }
-
-		l.acquire();
+		LOG_WARN(Subclass::get_log_category(), "Background thread: got an unknown exception.");
 	      }
 
-	    active_thread.reset();
-	    active_instance.reset();
-	    return; // Unless there's an unlikely error, we exit here;
-	            // otherwise we try some last-chance error
-	            // handling below.
-	  }
-	catch(const std::exception &ex)
-	  {
-	    LOG_FATAL(Subclass::get_log_category(), "Background thread aborting with std::exception: " << ex.what());
+	    l.acquire();
 	  }
-	catch(const cwidget::util::Exception &ex)
-	  {
-	    LOG_FATAL(Subclass::get_log_category(), "Background thread aborting with cwidget::util::Exception: " << ex.errmsg());
-	  }
-	catch(...)
+
+	if(!jobs.empty() && !stopped)
+	  thread_pool::get().submit(bootstrap(active_instance));
+	else
 	  {
-	    LOG_FATAL(Subclass::get_log_category(), "Background thread aborting with an unknown exception.");
+	    active = false;
+	    active_instance.reset();
+	    idle_cond.wake_all();
 	  }
-
-	// Do what we can to recover, although there might be jobs
-	// that can't be processed!
-	{
-	  cwidget::threads::mutex::lock l(state_mutex);
-	  active_thread.reset();
-	}
       }
     };
 
@@ -258,12 +246,15 @@ namespace aptitude
     boost::shared_ptr<job_queue_thread<Subclass, Job> > job_queue_thread<Subclass, Job>::active_instance;
 
     template<typename Subclass, typename Job>
-    boost::shared_ptr<cwidget::threads::thread> job_queue_thread<Subclass, Job>::active_thread;
+    bool job_queue_thread<Subclass, Job>::active = false;
 
     template<typename Subclass, typename Job>
     bool job_queue_thread<Subclass, Job>::stopped = false;
 
     template<typename Subclass, typename Job>
     cwidget::threads::mutex job_queue_thread<Subclass, Job>::state_mutex((cwidget::threads::mutex::attr(PTHREAD_MUTEX_RECURSIVE)));
+
+    template<typename Subclass, typename Job>
+    cwidget::threads::condition job_queue_thread<Subclass, Job>::idle_cond;
   }
 }
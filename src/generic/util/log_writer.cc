@@ -0,0 +1,413 @@
+/** \file log_writer.cc */
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "log_writer.h"
+
+#include "util.h"
+
+#include <boost/make_shared.hpp>
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+using boost::make_shared;
+using boost::shared_ptr;
+using cwidget::threads::condition;
+using cwidget::threads::mutex;
+using cwidget::threads::thread;
+
+namespace aptitude
+{
+  namespace util
+  {
+    namespace logging
+    {
+      namespace
+      {
+        /** \brief A message waiting to be written.
+         *
+         *  Only what can't be recovered later is captured when the
+         *  message is logged; the line is put together by the writer
+         *  thread.
+         */
+        struct log_record
+        {
+          const char *sourceFilename;
+          int sourceLineNumber;
+          log_level level;
+          LoggerPtr logger;
+          std::string msg;
+          time_t when;
+          pthread_t thread_id;
+
+          log_record()
+            : sourceFilename(NULL),
+              sourceLineNumber(0),
+              level(TRACE_LEVEL),
+              when(0),
+              thread_id()
+          {
+          }
+
+          /** \brief Exchange the contents of two records.
+           *
+           *  Used to move messages in and out of the queue, so that
+           *  the queue's strings keep their storage from one message
+           *  to the next.
+           */
+          void swap(log_record &other)
+          {
+            std::swap(sourceFilename, other.sourceFilename);
+            std::swap(sourceLineNumber, other.sourceLineNumber);
+            std::swap(level, other.level);
+            logger.swap(other.logger);
+            msg.swap(other.msg);
+            std::swap(when, other.when);
+            std::swap(thread_id, other.thread_id);
+          }
+        };
+      }
+
+      class LogWriter::Impl : public LogWriter
+      {
+        std::ofstream out;
+
+        // The queue of waiting messages: a ring of queue.size()
+        // records, of which "count" starting at "head" are in use.
+        std::vector<log_record> queue;
+        std::size_t head;
+        std::size_t count;
+
+        // The number of messages that have been queued and the
+        // number that have been written.  flush() waits for the
+        // second to catch up with the first.
+        unsigned long numQueued;
+        unsigned long numWritten;
+
+        unsigned long numDropped;
+
+        // The number of dropped messages that haven't been mentioned
+        // in the log yet.
+        unsigned long numUnreportedDropped;
+
+        // Set by stop(); tells the writer thread to exit once the
+        // queue is empty.
+        bool stopping;
+
+        // Set to false when the writer thread exits.
+        bool running;
+
+        shared_ptr<thread> writerThread;
+
+        // The process that started the writer thread.  A child
+        // created with fork() doesn't have the thread (and might
+        // have a copy of state_mutex that is locked forever), so it
+        // ignores the writer altogether.
+        const pid_t owner;
+
+        // Protects all of the above except "out", which is only used
+        // by the writer thread.
+        mutable mutex state_mutex;
+
+        // Signalled when the queue becomes nonempty or the writer is
+        // stopped.
+        condition queue_cond;
+
+        // Signalled whenever the writer thread has written a batch of
+        // messages (making room in the queue) and when it exits.
+        condition written_cond;
+
+        // The time that was formatted most recently, and its text;
+        // most messages share a second with the one before them.
+        // Only used by the writer thread.
+        time_t lastTime;
+        std::string lastTimeText;
+
+        class bootstrap
+        {
+          Impl *target;
+
+        public:
+          bootstrap(Impl *_target)
+            : target(_target)
+          {
+          }
+
+          void operator()() const
+          {
+            target->run();
+          }
+        };
+
+        const std::string &formatTime(time_t when);
+        void writeRecord(const log_record &record);
+        void writeDropped(unsigned long dropped);
+
+        /** \brief The body of the writer thread. */
+        void run();
+
+      public:
+        Impl(const std::string &filename, std::size_t queueSize);
+        ~Impl();
+
+        /** \brief Start the writer thread. */
+        void start();
+
+        void write(const char *sourceFilename,
+                   int sourceLineNumber,
+                   log_level level,
+                   LoggerPtr logger,
+                   const std::string &msg);
+
+        void flush();
+        void stop();
+        unsigned long getNumDropped() const;
+      };
+
+      LogWriter::Impl::Impl(const std::string &filename,
+                            std::size_t queueSize)
+        : out(filename.c_str(), std::ios::app),
+          queue(queueSize == 0 ? 1 : queueSize),
+          head(0),
+          count(0),
+          numQueued(0),
+          numWritten(0),
+          numDropped(0),
+          numUnreportedDropped(0),
+          stopping(false),
+          running(false),
+          owner(getpid()),
+          lastTime(-1)
+      {
+      }
+
+      LogWriter::Impl::~Impl()
+      {
+        stop();
+      }
+
+      void LogWriter::Impl::start()
+      {
+        mutex::lock l(state_mutex);
+
+        running = true;
+        writerThread = make_shared<thread>(bootstrap(this));
+      }
+
+      const std::string &LogWriter::Impl::formatTime(time_t when)
+      {
+        if(when != lastTime)
+          {
+            struct tm local_time;
+            localtime_r(&when, &local_time);
+
+            lastTimeText = sstrftime("%F %T", &local_time);
+            lastTime = when;
+          }
+
+        return lastTimeText;
+      }
+
+      void LogWriter::Impl::writeRecord(const log_record &record)
+      {
+        out << formatTime(record.when)
+            << " [" << record.thread_id << "] "
+            << record.sourceFilename << ":" << record.sourceLineNumber
+            << " " << describe_log_level(record.level)
+            << " " << record.logger->getCategory()
+            << " - " << record.msg << '\n';
+      }
+
+      void LogWriter::Impl::writeDropped(unsigned long dropped)
+      {
+        out << formatTime(time(NULL))
+            << " [" << pthread_self() << "] "
+            << __FILE__ << ":" << __LINE__
+            << " " << describe_log_level(WARN_LEVEL)
+            << " aptitude.util.logging - " << dropped
+            << " log messages were dropped because the queue was full."
+            << '\n';
+      }
+
+      void LogWriter::Impl::run()
+      {
+        std::vector<log_record> batch;
+
+        mutex::lock l(state_mutex);
+
+        while(true)
+          {
+            while(count == 0 && numUnreportedDropped == 0 && !stopping)
+              queue_cond.wait(l);
+
+            if(count == 0 && numUnreportedDropped == 0)
+              break;
+
+            // Take everything in the queue at once, so that the lock
+            // isn't held while writing.
+            const std::size_t n = count;
+            if(batch.size() < n)
+              batch.resize(n);
+            for(std::size_t i = 0; i < n; ++i)
+              batch[i].swap(queue[(head + i) % queue.size()]);
+            head = (head + n) % queue.size();
+            count = 0;
+
+            const unsigned long dropped = numUnreportedDropped;
+            numUnreportedDropped = 0;
+
+            l.release();
+
+            if(out)
+              {
+                for(std::size_t i = 0; i < n; ++i)
+                  writeRecord(batch[i]);
+
+                if(dropped > 0)
+                  writeDropped(dropped);
+
+                out.flush();
+              }
+
+            l.acquire();
+
+            numWritten += n;
+            written_cond.wake_all();
+          }
+
+        running = false;
+        written_cond.wake_all();
+      }
+
+      void LogWriter::Impl::write(const char *sourceFilename,
+                                  int sourceLineNumber,
+                                  log_level level,
+                                  LoggerPtr logger,
+                                  const std::string &msg)
+      {
+        if(getpid() != owner)
+          return;
+
+        const time_t now = time(NULL);
+
+        mutex::lock l(state_mutex);
+
+        if(level == FATAL_LEVEL)
+          while(count == queue.size() && running && !stopping)
+            written_cond.wait(l);
+
+        if(stopping || count == queue.size())
+          {
+            ++numDropped;
+            // Messages logged after stop() have nowhere to go, so
+            // there's no point in counting them for the log.
+            if(!stopping)
+              ++numUnreportedDropped;
+            return;
+          }
+
+        log_record &record = queue[(head + count) % queue.size()];
+        record.sourceFilename = sourceFilename;
+        record.sourceLineNumber = sourceLineNumber;
+        record.level = level;
+        record.logger = logger;
+        record.msg.assign(msg);
+        record.when = now;
+        record.thread_id = pthread_self();
+
+        ++count;
+        ++numQueued;
+        const unsigned long sequence = numQueued;
+
+        // The writer only sleeps when the queue is empty.
+        if(count == 1)
+          queue_cond.wake_one();
+
+        if(level == FATAL_LEVEL)
+          while(numWritten < sequence && running)
+            written_cond.wait(l);
+      }
+
+      void LogWriter::Impl::flush()
+      {
+        if(getpid() != owner)
+          return;
+
+        mutex::lock l(state_mutex);
+
+        const unsigned long target = numQueued;
+        while(numWritten < target && running)
+          written_cond.wait(l);
+      }
+
+      void LogWriter::Impl::stop()
+      {
+        if(getpid() != owner)
+          return;
+
+        mutex::lock l(state_mutex);
+
+        stopping = true;
+        queue_cond.wake_all();
+
+        shared_ptr<thread> writerThreadCopy;
+        writerThreadCopy.swap(writerThread);
+
+        l.release();
+
+        if(writerThreadCopy.get() != NULL)
+          writerThreadCopy->join();
+      }
+
+      unsigned long LogWriter::Impl::getNumDropped() const
+      {
+        mutex::lock l(state_mutex);
+
+        return numDropped;
+      }
+
+
+      LogWriter::LogWriter()
+      {
+      }
+
+      LogWriter::~LogWriter()
+      {
+      }
+
+      shared_ptr<LogWriter> createLogWriter(const std::string &filename,
+                                            std::size_t queueSize)
+      {
+        shared_ptr<LogWriter::Impl> rval =
+          make_shared<LogWriter::Impl>(filename, queueSize);
+        rval->start();
+
+        return rval;
+      }
+    }
+  }
+}
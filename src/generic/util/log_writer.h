@@ -0,0 +1,124 @@
+// log_writer.h                                      -*-c++-*-
+//
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_LOG_WRITER_H
+#define APTITUDE_UTIL_LOG_WRITER_H
+
+#include "logging.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
+namespace aptitude
+{
+  namespace util
+  {
+    namespace logging
+    {
+      /** \brief Writes log messages to a file from a background
+       *  thread.
+       *
+       *  Connect write() to a logger's message_logged signal.  The
+       *  thread that logs a message only copies it into a bounded
+       *  queue; the time stamp, the rest of the line and the file I/O
+       *  are all handled by the writer's own thread.  So turning on
+       *  trace messages costs the code being traced little more than
+       *  building the messages themselves.
+       *
+       *  If messages arrive faster than they can be written and the
+       *  queue fills up, new messages are discarded rather than
+       *  making the caller wait, and the number of discarded messages
+       *  is written to the log once there is room again.  FATAL
+       *  messages are never discarded: they wait for room, and then
+       *  wait until they have been written, since the program might
+       *  be about to die.
+       *
+       *  The writer thread belongs to the process that created the
+       *  writer; in a child created with fork(), all the methods
+       *  return immediately and messages are discarded.
+       */
+      class LogWriter
+      {
+        class Impl;
+        friend class Impl;
+
+        LogWriter();
+        LogWriter(const LogWriter &);
+
+        friend boost::shared_ptr<LogWriter>
+        createLogWriter(const std::string &filename,
+                        std::size_t queueSize);
+
+      public:
+        /** \brief Stops the writer thread; see stop(). */
+        virtual ~LogWriter();
+
+        /** \brief Queue a message to be written.
+         *
+         *  The parameters are those of the message_logged signal.
+         *
+         *  This function is thread-safe.
+         */
+        virtual void write(const char *sourceFilename,
+                           int sourceLineNumber,
+                           log_level level,
+                           LoggerPtr logger,
+                           const std::string &msg) = 0;
+
+        /** \brief Block until every message queued so far has been
+         *  written to the file.
+         *
+         *  This function is thread-safe.
+         */
+        virtual void flush() = 0;
+
+        /** \brief Write out the messages in the queue and stop the
+         *  writer thread.
+         *
+         *  Messages that are queued after this is invoked are
+         *  discarded.  Has no effect if the writer was already
+         *  stopped.
+         */
+        virtual void stop() = 0;
+
+        /** \brief Return the number of messages that have been
+         *  discarded because the queue was full or the writer was
+         *  stopped.
+         */
+        virtual unsigned long getNumDropped() const = 0;
+      };
+
+      /** \brief Create a log writer and start its thread.
+       *
+       *  \param filename   The file to append messages to.  It is
+       *                    opened once, when the writer is created;
+       *                    if it can't be opened, messages are
+       *                    silently discarded.
+       *  \param queueSize  The number of messages that can be waiting
+       *                    to be written before new ones are dropped.
+       */
+      boost::shared_ptr<LogWriter>
+      createLogWriter(const std::string &filename,
+                      std::size_t queueSize);
+    }
+  }
+}
+
+#endif // APTITUDE_UTIL_LOG_WRITER_H
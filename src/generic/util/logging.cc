@@ -59,6 +59,7 @@ namespace aptitude
           case INFO_LEVEL: return "INFO";
           case WARN_LEVEL: return "WARN";
           case ERROR_LEVEL: return "ERROR";
+          case FATAL_LEVEL: return "FATAL";
           default: return "???";
           }
       }
@@ -20,6 +20,8 @@
 #ifndef APTITUDE_UTIL_LOGGING_H
 #define APTITUDE_UTIL_LOGGING_H
 
+#include <config.h>
+
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -30,6 +32,16 @@
 
 #include <limits.h> // For INT_MIN
 
+/** \brief The lowest log level whose messages are compiled in.
+ *
+ *  Set with --enable-log-min-level; log statements below this level
+ *  are removed by the compiler, and isEnabledFor() is false for them
+ *  however the loggers are configured.
+ */
+#ifndef APTITUDE_LOG_MIN_LEVEL
+#define APTITUDE_LOG_MIN_LEVEL 0
+#endif
+
 namespace aptitude
 {
   namespace util
@@ -111,6 +123,7 @@ namespace aptitude
         bool isEnabledFor(log_level l) const
         {
           return
+            l >= APTITUDE_LOG_MIN_LEVEL &&
             effectiveLevel != OFF_LEVEL &&
             l >= effectiveLevel;
         }
@@ -190,19 +203,26 @@ namespace aptitude
         static LoggerPtr getLogger(const std::string &category);
       };
 
+// The logger is bound to a reference rather than copied, so that a
+// disabled log statement doesn't touch the shared_ptr's reference
+// count; and statements below APTITUDE_LOG_MIN_LEVEL don't even
+// evaluate the logger expression.
 #define LOG_LEVEL(level, logger, msg)                                   \
       do                                                                \
         {                                                               \
-          ::aptitude::util::logging::log_level __aptitude_util_logging_level = (level); \
-          ::aptitude::util::logging::LoggerPtr __aptitude_util_logging_logger = (logger); \
-          if(__aptitude_util_logging_logger->isEnabledFor(__aptitude_util_logging_level)) \
+          const ::aptitude::util::logging::log_level __aptitude_util_logging_level = (level); \
+          if(__aptitude_util_logging_level >= APTITUDE_LOG_MIN_LEVEL)   \
             {                                                           \
-              std::ostringstream __aptitude_util_logging_stream;        \
-              __aptitude_util_logging_stream << msg;                    \
-              (__aptitude_util_logging_logger)->log(__FILE__,           \
-                                                    __LINE__,           \
-                                                    __aptitude_util_logging_level, \
-                                                    __aptitude_util_logging_stream.str()); \
+              const ::aptitude::util::logging::LoggerPtr &__aptitude_util_logging_logger = (logger); \
+              if(__aptitude_util_logging_logger->isEnabledFor(__aptitude_util_logging_level)) \
+                {                                                       \
+                  std::ostringstream __aptitude_util_logging_stream;    \
+                  __aptitude_util_logging_stream << msg;                \
+                  (__aptitude_util_logging_logger)->log(__FILE__,       \
+                                                        __LINE__,       \
+                                                        __aptitude_util_logging_level, \
+                                                        __aptitude_util_logging_stream.str()); \
+                }                                                       \
             }                                                           \
         } while(0)                                                      \
 
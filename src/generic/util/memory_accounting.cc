@@ -0,0 +1,153 @@
+/** \file memory_accounting.cc */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "memory_accounting.h"
+
+// System includes:
+#include <cwidget/generic/threads/threads.h>
+#include <cwidget/generic/util/ssprintf.h>
+
+#include <algorithm>
+#include <set>
+
+using cwidget::util::ssprintf;
+
+namespace aptitude
+{
+  namespace util
+  {
+    namespace
+    {
+      /** \brief The live accounts.
+       *
+       *  Deliberately leaked, so that accounts belonging to global
+       *  objects can unregister while global destructors run.
+       */
+      class account_registry
+      {
+	cwidget::threads::mutex m;
+	std::set<const memory_account *> accounts;
+
+      public:
+	static account_registry &get()
+	{
+	  static account_registry *instance = new account_registry;
+	  return *instance;
+	}
+
+	void add(const memory_account *account)
+	{
+	  cwidget::threads::mutex::lock l(m);
+	  accounts.insert(account);
+	}
+
+	void remove(const memory_account *account)
+	{
+	  cwidget::threads::mutex::lock l(m);
+	  accounts.erase(account);
+	}
+
+	void collect(memory_report &report)
+	{
+	  cwidget::threads::mutex::lock l(m);
+	  for(std::set<const memory_account *>::const_iterator it = accounts.begin();
+	      it != accounts.end(); ++it)
+	    (*it)->account(report);
+	}
+      };
+
+      struct larger_usage
+      {
+	bool operator()(const std::pair<std::string, memory_report::usage> &u1,
+			const std::pair<std::string, memory_report::usage> &u2) const
+	{
+	  if(u1.second.bytes != u2.second.bytes)
+	    return u1.second.bytes > u2.second.bytes;
+	  else
+	    return u1.first < u2.first;
+	}
+      };
+
+      std::string format_line(const std::string &name,
+			      std::size_t bytes,
+			      unsigned long objects)
+      {
+	return ssprintf("%-30s %10lu KiB %8lu\n",
+			name.c_str(),
+			static_cast<unsigned long>((bytes + 1023) / 1024),
+			objects);
+      }
+    }
+
+    void memory_report::add(const std::string &subsystem, std::size_t bytes)
+    {
+      usage &u = subsystems[subsystem];
+      u.bytes += bytes;
+      ++u.objects;
+    }
+
+    std::size_t memory_report::get_total() const
+    {
+      std::size_t rval = 0;
+      for(const_iterator it = begin(); it != end(); ++it)
+	rval += it->second.bytes;
+      return rval;
+    }
+
+    std::string memory_report::format() const
+    {
+      std::vector<std::pair<std::string, usage> > sorted(begin(), end());
+      std::sort(sorted.begin(), sorted.end(), larger_usage());
+
+      std::string rval = ssprintf("%-30s %14s %8s\n",
+				  "Subsystem", "Estimated", "Objects");
+      unsigned long total_objects = 0;
+      for(std::vector<std::pair<std::string, usage> >::const_iterator
+	    it = sorted.begin(); it != sorted.end(); ++it)
+	{
+	  rval += format_line(it->first, it->second.bytes, it->second.objects);
+	  total_objects += it->second.objects;
+	}
+      rval += format_line("Total", get_total(), total_objects);
+
+      return rval;
+    }
+
+    memory_account::memory_account(const account_slot &_f)
+      : f(_f)
+    {
+      account_registry::get().add(this);
+    }
+
+    memory_account::~memory_account()
+    {
+      account_registry::get().remove(this);
+    }
+
+    void memory_account::account(memory_report &report) const
+    {
+      f(report);
+    }
+
+    void collect_memory_usage(memory_report &report)
+    {
+      account_registry::get().collect(report);
+    }
+  }
+}
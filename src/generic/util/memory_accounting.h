@@ -0,0 +1,161 @@
+/** \file memory_accounting.h */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_MEMORY_ACCOUNTING_H
+#define APTITUDE_UTIL_MEMORY_ACCOUNTING_H
+
+#include <sigc++/slot.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace aptitude
+{
+  namespace util
+  {
+    /** \brief Estimates of how much memory each subsystem is using,
+     *  filled in by the objects that own the memory.
+     *
+     *  The numbers are estimates computed from container sizes, not
+     *  measurements of the heap: they include the container nodes
+     *  that the standard library allocates but not allocator
+     *  overhead, and memory shared between several objects (such as
+     *  the nodes of immutable sets) is counted once for each object
+     *  that refers to it.
+     */
+    class memory_report
+    {
+    public:
+      struct usage
+      {
+	/** \brief The estimated number of bytes in use. */
+	std::size_t bytes;
+
+	/** \brief The number of objects that contributed to this
+	 *  entry.
+	 */
+	unsigned long objects;
+
+	usage()
+	  : bytes(0), objects(0)
+	{
+	}
+      };
+
+      typedef std::map<std::string, usage>::const_iterator const_iterator;
+
+    private:
+      std::map<std::string, usage> subsystems;
+
+    public:
+      /** \brief Add the memory used by one object to the total for a
+       *  subsystem.
+       */
+      void add(const std::string &subsystem, std::size_t bytes);
+
+      const_iterator begin() const { return subsystems.begin(); }
+      const_iterator end() const { return subsystems.end(); }
+
+      /** \brief The sum of all the subsystems. */
+      std::size_t get_total() const;
+
+      /** \brief Render the report as a table, largest subsystem
+       *  first, with one line per subsystem.
+       */
+      std::string format() const;
+    };
+
+    /** \brief Keeps a callback in the global list of memory accounts
+     *  for as long as it exists.
+     *
+     *  Owners of large data structures hold one of these as their
+     *  \e last member, so that it's unregistered before the other
+     *  members are destroyed.  The callback is invoked from whichever
+     *  thread calls collect_memory_usage(), with the registry locked:
+     *  owners whose data is modified by other threads have to lock it
+     *  themselves, and since an owner's destructor body runs before
+     *  its account is unregistered, owners should only be destroyed
+     *  by the thread that collects reports (normally the main
+     *  thread).
+     */
+    class memory_account
+    {
+    public:
+      typedef sigc::slot1<void, memory_report &> account_slot;
+
+    private:
+      account_slot f;
+
+      memory_account(const memory_account &);
+      memory_account &operator=(const memory_account &);
+
+    public:
+      explicit memory_account(const account_slot &_f);
+      ~memory_account();
+
+      /** \brief Invoke the callback. */
+      void account(memory_report &report) const;
+    };
+
+    /** \brief Ask every registered account to fill in the report. */
+    void collect_memory_usage(memory_report &report);
+
+    /** \name Estimates of the memory held by standard containers.
+     *
+     *  These count the elements and the bookkeeping that the
+     *  containers allocate, but not memory owned by the elements
+     *  themselves.
+     */
+
+    // @{
+
+    template<typename T, typename Alloc>
+    std::size_t vector_memory_usage(const std::vector<T, Alloc> &v)
+    {
+      return v.capacity() * sizeof(T);
+    }
+
+    /** \brief Estimate the memory used by a node-based container
+     *  (std::list, std::set, std::map): each element lives in its own
+     *  node with up to three links.
+     */
+    template<typename Container>
+    std::size_t node_memory_usage(const Container &c)
+    {
+      return c.size() * (sizeof(typename Container::value_type) + 3 * sizeof(void *));
+    }
+
+    /** \brief Estimate the memory used by a hashed container: the
+     *  bucket array plus one singly-linked node per element.
+     */
+    template<typename Container>
+    std::size_t hashed_memory_usage(const Container &c)
+    {
+      return c.bucket_count() * sizeof(void *) +
+	c.size() * (sizeof(typename Container::value_type) + sizeof(void *));
+    }
+
+    // @}
+  }
+}
+
+#endif // APTITUDE_UTIL_MEMORY_ACCOUNTING_H
@@ -0,0 +1,130 @@
+/** \file parallel_sort.h */ // -*-c++-*-
+
+//   Copyright (C) 2011 Daniel Burrows
+
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace aptitude
+{
+  namespace util
+  {
+    namespace parallel_sort_impl
+    {
+      template<typename RandomAccessIter, typename Compare>
+      class sort_chunk
+      {
+	RandomAccessIter begin, end;
+	Compare cmp;
+
+      public:
+	sort_chunk(RandomAccessIter _begin, RandomAccessIter _end,
+		   const Compare &_cmp)
+	  : begin(_begin), end(_end), cmp(_cmp)
+	{
+	}
+
+	void operator()()
+	{
+	  std::sort(begin, end, cmp);
+	}
+      };
+    }
+
+    /** \brief Sort a range, splitting the work between several
+     *  threads.
+     *
+     *  The range is cut into num_threads contiguous chunks; each
+     *  one is sorted with std::sort() by a task on the global
+     *  thread_pool (or by the calling thread, if it gets there
+     *  first), and the sorted chunks are then merged by the calling
+     *  thread.  Like
+     *  std::sort(), this is not stable.
+     *
+     *  Every thread gets its own copy of the comparison, and the
+     *  elements of a chunk are only touched by the thread sorting it.
+     *  The comparison must be safe to invoke from several threads at
+     *  once, and copying or swapping two elements must not touch any
+     *  other element (so avoid sorting objects that share a
+     *  non-thread-safe reference count).
+     *
+     *  \param begin        The start of the range to sort.
+     *  \param end          The end of the range to sort.
+     *  \param cmp          The less-than comparison to sort by.
+     *  \param num_threads  How many threads to use.
+     *  \param min_chunk    The smallest chunk worth giving to a
+     *                      thread; smaller ranges use fewer threads,
+     *                      and a range that can't be split at all is
+     *                      sorted in the calling thread.
+     */
+    template<typename RandomAccessIter, typename Compare>
+    void parallel_sort(RandomAccessIter begin, RandomAccessIter end,
+		       Compare cmp, int num_threads,
+		       std::size_t min_chunk = 4096)
+    {
+      typedef parallel_sort_impl::sort_chunk<RandomAccessIter, Compare> chunk;
+
+      const std::size_t size = end - begin;
+      if(min_chunk == 0)
+	min_chunk = 1;
+      if(num_threads < 1)
+	num_threads = 1;
+      if((std::size_t)num_threads > size / min_chunk)
+	num_threads = size / min_chunk;
+
+      if(num_threads <= 1)
+	{
+	  std::sort(begin, end, cmp);
+	  return;
+	}
+
+      const std::size_t chunk_size = (size + num_threads - 1) / num_threads;
+      std::vector<RandomAccessIter> bounds;
+      for(int i = 0; i < num_threads; ++i)
+	bounds.push_back(begin + std::min(size, i * chunk_size));
+      bounds.push_back(end);
+
+      // The calling thread sorts the last chunk itself rather than
+      // sitting idle, and helps with the others while it waits.
+      {
+	thread_pool::batch chunks(thread_pool::get());
+	for(int i = 0; i < num_threads - 1; ++i)
+	  chunks.submit(chunk(bounds[i], bounds[i + 1], cmp));
+
+	chunk(bounds[num_threads - 1], bounds[num_threads], cmp)();
+
+	chunks.wait();
+      }
+
+      // Merge neighbouring chunks until only one is left.
+      for(std::size_t width = 1; width < (std::size_t)num_threads; width *= 2)
+	for(std::size_t i = 0; i + width < (std::size_t)num_threads; i += 2 * width)
+	  std::inplace_merge(bounds[i],
+			     bounds[i + width],
+			     bounds[std::min((std::size_t)num_threads, i + 2 * width)],
+			     cmp);
+    }
+  }
+}
+
+#endif // PARALLEL_SORT_H
@@ -20,7 +20,9 @@
 #ifndef PARSERS_H
 #define PARSERS_H
 
+#include <algorithm>
 #include <exception>
+#include <iterator>
 #include <string>
 #include <sstream>
 #include <ostream>
@@ -609,6 +611,20 @@ namespace parsers
       output.push_back(parse(input));
     }
 
+    /** \brief Parse the input, throwing away the result.
+     *
+     *  Parsers whose result is expensive to build (typically
+     *  containers) provide their own skip() that only advances the
+     *  input, so that combinators that discard a result (skipMany(),
+     *  the first half of "p1 >> p2", slice(), ...) don't pay for
+     *  building it.
+     */
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      parse(input);
+    }
+
     /** \brief Write a description of what we expect to see here to
      *  the given stream.
      */
@@ -1031,11 +1047,23 @@ namespace parsers
       if(input.begin() == start)
         input.fail((boost::format(_("Expected an integer, got '%c'.")) % input.front()).str());
 
-      // Lean on strtol for now.
-      std::string s(start, input.begin());
+      // Lean on strtol for now.  Integers short enough to be valid
+      // are copied into a buffer on the stack, so the usual case
+      // doesn't allocate.
+      char buf[32];
+      std::string s;
+      const char *digits = buf;
+      if(std::distance(start, input.begin()) < (std::ptrdiff_t)sizeof(buf))
+        *std::copy(start, input.begin(), buf) = '\0';
+      else
+        {
+          s.assign(start, input.begin());
+          digits = s.c_str();
+        }
+
       char *endptr;
       errno = 0;
-      long rval = strtol(s.c_str(), &endptr, 0);
+      long rval = strtol(digits, &endptr, 0);
       if(errno != 0)
         {
           int errnum = errno;
@@ -1043,7 +1071,7 @@ namespace parsers
         }
 
       if(*endptr != '\0')
-        input.fail((boost::format(_("Invalid integer: \"%s\".")) % s).str());
+        input.fail((boost::format(_("Invalid integer: \"%s\".")) % digits).str());
 
       try
         {
@@ -1234,17 +1262,24 @@ namespace parsers
     template<typename ParseInput>
     result_type do_parse(ParseInput &input) const
     {
-      p1.parse(input);
+      p1.skip(input);
       return p2.parse(input);
     }
 
     template<typename ParseInput, typename Container>
     void parse_container(ParseInput &input, Container &output) const
     {
-      p1.parse(input);
+      p1.skip(input);
       p2.parse_container(input, output);
     }
 
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      p1.skip(input);
+      p2.skip(input);
+    }
+
     void get_expected(std::ostream &out) const
     {
       p1.get_expected_description(out);
@@ -1285,7 +1320,7 @@ namespace parsers
     result_type do_parse(ParseInput &input) const
     {
       result_type rval = p1.parse(input);
-      p2.parse(input);
+      p2.skip(input);
       return rval;
     }
 
@@ -1293,7 +1328,14 @@ namespace parsers
     void parse_container(ParseInput &input, Container &output) const
     {
       p1.parse_container(input, output);
-      p2.parse(input);
+      p2.skip(input);
+    }
+
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      p1.skip(input);
+      p2.skip(input);
     }
 
     void get_expected(std::ostream &out) const
@@ -1462,6 +1504,12 @@ namespace parsers
       return rval;
     }
 
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      p.skip(input);
+    }
+
     void get_expected(std::ostream &out) const
     {
       return p.get_expected(out);
@@ -1507,6 +1555,66 @@ namespace parsers
     return container_p<P, std::string>(p, std::string());
   }
 
+  /** \brief A parser that returns the stretch of input recognized by
+   *  its sub-parser, rather than the sub-parser's value.
+   *
+   *  The sub-parser is only used to recognize the input (see
+   *  parser_base::skip()), so for instance
+   *  slice(alpha() + many(alnum())) returns an identifier without
+   *  building a single container along the way.  The returned range
+   *  refers to the text being parsed and is only valid as long as
+   *  that text is.
+   *
+   *  \tparam P     The sub-parser.
+   *  \tparam Iter  The iterator type of the input; the input's
+   *                const_iterator must be convertible to it.
+   */
+  template<typename P, typename Iter>
+  class slice_p : public parser_base<slice_p<P, Iter>, boost::iterator_range<Iter> >
+  {
+    P p;
+
+  public:
+    slice_p(const P &_p)
+      : p(_p)
+    {
+    }
+
+    typedef boost::iterator_range<Iter> result_type;
+
+    template<typename ParseInput>
+    result_type do_parse(ParseInput &input) const
+    {
+      Iter start = input.begin();
+      p.skip(input);
+      return result_type(start, Iter(input.begin()));
+    }
+
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      p.skip(input);
+    }
+
+    void get_expected(std::ostream &out) const
+    {
+      p.get_expected(out);
+    }
+  };
+
+  /** \brief Create a parser that returns the part of a std::string
+   *  that its sub-parser recognizes.
+   *
+   *  Use slice_p directly to slice other kinds of input.
+   *
+   *  \param p The sub-parser.
+   */
+  template<typename P>
+  slice_p<P, std::string::const_iterator> slice(const P &p)
+  {
+    return slice_p<P, std::string::const_iterator>(p);
+  }
+
 
   /** \brief A parser that concatenates two sub-parsers into a single
    *  container parser.
@@ -1545,6 +1653,13 @@ namespace parsers
       p2.parse_container(input, output);
     }
 
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      p1.skip(input);
+      p2.skip(input);
+    }
+
     void get_expected(std::ostream &out) const
     {
       p1.get_expected(out);
@@ -1586,7 +1701,7 @@ namespace parsers
           typename ParseInput::const_iterator where = input.begin();
           try
             {
-              p.parse(input);
+              p.skip(input);
             }
           catch(ParseException &)
             {
@@ -1627,7 +1742,7 @@ namespace parsers
     template<typename ParseInput>
     nil_t do_parse(ParseInput &input) const
     {
-      p.parse(input);
+      p.skip(input);
 
       while(true)
         {
@@ -1635,7 +1750,7 @@ namespace parsers
 
           try
             {
-              p.parse(input);
+              p.skip(input);
             }
           catch(ParseException &)
             {
@@ -1738,6 +1853,42 @@ namespace parsers
         }
     }
 
+    /** \brief Recognize the list without collecting its elements.
+     *
+     *  Backtracking only has to restore the input position, since
+     *  there's no output to roll back.
+     */
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      bool foundOne = false;
+      while(true)
+        {
+          typename ParseInput::const_iterator where = input.begin();
+          try
+            {
+              p.skip(input);
+              foundOne = true;
+            }
+          catch(ParseException &)
+            {
+              if(where != input.begin())
+                throw;
+              else
+                break;
+            }
+        }
+
+      if(requireOne && !foundOne)
+        {
+          std::ostringstream msg;
+          msg << "Expected ";
+          get_expected(msg);
+
+          input.fail(msg.str());
+        }
+    }
+
     void get_expected(std::ostream &out) const
     {
       p.get_expected(out);
@@ -1822,7 +1973,7 @@ namespace parsers
 	    if(first)
 	      first = false;
 	    else
-	      separatorP.parse(input);
+	      separatorP.skip(input);
 
             valueP.parse_container(input, output);
 
@@ -1850,6 +2001,46 @@ namespace parsers
         }
     }
 
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      bool foundOne = false;
+      bool first = true;
+
+      while(true)
+      {
+	typename ParseInput::const_iterator initialBegin = input.begin();
+
+	try
+	  {
+	    if(first)
+	      first = false;
+	    else
+	      separatorP.skip(input);
+
+            valueP.skip(input);
+
+            foundOne = true;
+	  }
+	catch(ParseException &)
+	  {
+	    if(input.begin() == initialBegin)
+              break;
+	    else
+	      throw;
+	  }
+      }
+
+      if(requireOne && !foundOne)
+        {
+          std::ostringstream msg;
+          msg << "Expected ";
+          get_expected(msg);
+
+          input.fail(msg.str());
+        }
+    }
+
     void get_expected(std::ostream &out) const
     {
       valueP.get_expected(out);
@@ -2391,6 +2582,22 @@ namespace parsers
         }
     }
 
+    template<typename ParseInput>
+    void skip(ParseInput &input) const
+    {
+      typename ParseInput::const_iterator inputWhere = input.begin();
+
+      try
+        {
+          p.skip(input);
+        }
+      catch(ParseException &)
+        {
+          if(inputWhere != input.begin())
+            throw;
+        }
+    }
+
     void get_expected(std::ostream &out) const
     {
       p.get_expected(out);
@@ -2758,7 +2965,7 @@ namespace parsers
       try
         {
           ParseInput lookaheadInput = input;
-          lookaheadP.parse(lookaheadInput);
+          lookaheadP.skip(lookaheadInput);
         }
       catch(ParseException &)
         {
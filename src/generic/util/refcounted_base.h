@@ -28,7 +28,14 @@ namespace aptitude
 {
   namespace util
   {
-    /** \brief A class meant to be wrapped in cwidget::ref_ptr objects. */
+    /** \brief A class meant to be wrapped in cwidget::ref_ptr objects.
+     *
+     *  Use this for anything that is only touched by one thread, such
+     *  as the structures that live inside a single resolver (its
+     *  incremental expressions and immlist nodes).  Objects that are
+     *  handed to another thread should be cloned on the way, as
+     *  generic_solution::clone() does for solutions.
+     */
     class refcounted_base_not_threadsafe : public sigc::trackable
     {
       mutable int refcount;
@@ -52,7 +59,10 @@ namespace aptitude
     /** \brief A class meant to be wrapped in cwidget::ref_ptr objects.
      *
      *  This variant is threadsafe, which means it's quite a bit more
-     *  expensive to copy around.
+     *  expensive to copy around.  Only use it for objects that are
+     *  shared between threads without being cloned, such as the
+     *  initial state that the resolver thread shares with the
+     *  solutions it hands to the user interface.
      */
     class refcounted_base_threadsafe : public sigc::trackable
     {
@@ -0,0 +1,212 @@
+/** \file run_metrics.cc */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "run_metrics.h"
+
+#include "timings.h"
+
+// System includes:
+#include <cwidget/generic/threads/threads.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sstream>
+
+namespace aptitude
+{
+  namespace util
+  {
+    namespace
+    {
+      /** \brief The counters of this run.
+       *
+       *  Like the timing registry, this is never deleted, so that it
+       *  can be written from an atexit() handler.
+       */
+      struct counters
+      {
+	cwidget::threads::mutex m;
+
+	unsigned long resolver_solutions;
+	unsigned long long resolver_steps;
+	unsigned long download_items;
+	unsigned long long download_bytes;
+	unsigned long packages_installed;
+	unsigned long packages_removed;
+
+	counters()
+	  : resolver_solutions(0), resolver_steps(0),
+	    download_items(0), download_bytes(0),
+	    packages_installed(0), packages_removed(0)
+	{
+	}
+
+	static counters *get()
+	{
+	  static counters *instance = new counters;
+	  return instance;
+	}
+      };
+
+      const char header[] =
+	"version\tstart\tcommand\ttotal_sec\tload_cache_sec"
+	"\tresolver_sec\tresolver_searches\tresolver_solutions\tresolver_steps"
+	"\tdownload_sec\tdownload_items\tdownload_bytes\tdownload_bytes_per_sec"
+	"\tdpkg_sec\tdpkg_runs\tpackages_installed\tpackages_removed"
+	"\tpeak_rss_kib\n";
+
+      /** \brief Write out a phase's time and, if runs_too is set,
+       *  how many times it ran.
+       */
+      void write_phase(std::ostream &out, const char *name,
+		       bool runs_too, double &seconds)
+      {
+	unsigned long runs;
+	get_phase_totals(name, seconds, runs);
+
+	out << '\t' << seconds;
+	if(runs_too)
+	  out << '\t' << runs;
+      }
+
+      bool write_all(int fd, const std::string &data)
+      {
+	std::string::size_type written = 0;
+	while(written < data.size())
+	  {
+	    const ssize_t n = write(fd, data.data() + written, data.size() - written);
+	    if(n < 0)
+	      {
+		if(errno == EINTR)
+		  continue;
+		return false;
+	      }
+
+	    written += n;
+	  }
+
+	return true;
+      }
+    }
+
+    void record_resolver_search(std::size_t steps, bool found)
+    {
+      counters *c = counters::get();
+      cwidget::threads::mutex::lock l(c->m);
+
+      c->resolver_steps += steps;
+      if(found)
+	++c->resolver_solutions;
+    }
+
+    void record_download(unsigned long items, unsigned long long bytes)
+    {
+      counters *c = counters::get();
+      cwidget::threads::mutex::lock l(c->m);
+
+      c->download_items += items;
+      c->download_bytes += bytes;
+    }
+
+    void record_install(unsigned long installed, unsigned long removed)
+    {
+      counters *c = counters::get();
+      cwidget::threads::mutex::lock l(c->m);
+
+      c->packages_installed += installed;
+      c->packages_removed += removed;
+    }
+
+    bool write_run_metrics(const std::string &filename,
+			   const std::string &command)
+    {
+      std::string safe_command(command.empty() ? "-" : command);
+      for(std::string::iterator it = safe_command.begin();
+	  it != safe_command.end(); ++it)
+	if(*it == '\t' || *it == '\n')
+	  *it = ' ';
+
+      double total_sec;
+      unsigned long total_runs;
+      get_phase_totals("total", total_sec, total_runs);
+
+      std::ostringstream out;
+      out.setf(std::ios::fixed);
+      out.precision(3);
+      out << 1 << '\t'
+	  << (long)(time(NULL) - (time_t)total_sec) << '\t'
+	  << safe_command << '\t'
+	  << total_sec;
+
+      double seconds;
+      write_phase(out, "load-cache", false, seconds);
+      write_phase(out, "resolver", true, seconds);
+
+      counters *c = counters::get();
+      {
+	cwidget::threads::mutex::lock l(c->m);
+
+	out << '\t' << c->resolver_solutions
+	    << '\t' << c->resolver_steps;
+
+	double download_sec;
+	write_phase(out, "download", false, download_sec);
+	out << '\t' << c->download_items
+	    << '\t' << c->download_bytes;
+	out.precision(0);
+	out << '\t' << (download_sec > 0 ? c->download_bytes / download_sec : 0.0);
+	out.precision(3);
+
+	write_phase(out, "dpkg", true, seconds);
+	out << '\t' << c->packages_installed
+	    << '\t' << c->packages_removed;
+      }
+
+      struct rusage usage;
+      // ru_maxrss is measured in kilobytes.
+      out << '\t' << (getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0L)
+	  << '\n';
+
+      const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if(fd == -1)
+	return false;
+
+      // Everything is written with one append, so that the lines of
+      // runs that finish at the same time don't interleave.
+      struct stat buf;
+      std::string data;
+      if(fstat(fd, &buf) == 0 && buf.st_size == 0)
+	data = header;
+      data += out.str();
+
+      const bool ok = write_all(fd, data);
+      const int write_errno = errno;
+      if(close(fd) != 0 && ok)
+	return false;
+
+      errno = write_errno;
+      return ok;
+    }
+  }
+}
@@ -0,0 +1,99 @@
+/** \file run_metrics.h */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_RUN_METRICS_H
+#define APTITUDE_UTIL_RUN_METRICS_H
+
+#include <cstddef>
+#include <string>
+
+/** \brief A one-line summary of a whole run of the program, for
+ *  collecting from unattended installs.
+ *
+ *  The summary is appended to a file as one line of tab-separated
+ *  fields.  When the file is created, a header line naming the fields
+ *  is written first; the fields are, in order:
+ *
+ *   - \b version: the version of this layout, currently 1;
+ *   - \b start: when the run started, in seconds since the epoch;
+ *   - \b command: the command-line action, or "-" if there was none;
+ *   - \b total_sec: how long the run took;
+ *   - \b load_cache_sec: the time spent loading the package cache;
+ *   - \b resolver_sec, \b resolver_searches: the time spent waiting
+ *     for the dependency resolver and how many times it was asked
+ *     for a solution;
+ *   - \b resolver_solutions: how many of those searches found one;
+ *   - \b resolver_steps: the steps the resolver processed;
+ *   - \b download_sec: the time spent downloading;
+ *   - \b download_items, \b download_bytes: the package files that
+ *     were to be fetched and their size, not counting what was
+ *     already partially downloaded (the sizes of package lists aren't
+ *     known in advance, so updates aren't counted);
+ *   - \b download_bytes_per_sec: download_bytes over download_sec;
+ *   - \b dpkg_sec, \b dpkg_runs: the time spent running dpkg and how
+ *     many times it was run;
+ *   - \b packages_installed, \b packages_removed: the packages that
+ *     were to be installed or upgraded, and removed;
+ *   - \b peak_rss_kib: the peak resident set size of the process.
+ *
+ *  The times come from the phase timers of timings.h, which are only
+ *  recorded by the thread that runs the command line; the counters
+ *  can be recorded from any thread.
+ */
+
+namespace aptitude
+{
+  namespace util
+  {
+    /** \brief Record that the resolver was asked for a solution.
+     *
+     *  \param steps  The steps it processed while searching.
+     *  \param found  \b true if it found a solution.
+     */
+    void record_resolver_search(std::size_t steps, bool found);
+
+    /** \brief Record that a download was started.
+     *
+     *  \param items  The number of files to fetch.
+     *  \param bytes  The number of bytes to fetch.
+     */
+    void record_download(unsigned long items, unsigned long long bytes);
+
+    /** \brief Record the changes that an install run will make.
+     *
+     *  \param installed  The packages to install or upgrade.
+     *  \param removed    The packages to remove.
+     */
+    void record_install(unsigned long installed, unsigned long removed);
+
+    /** \brief Append the summary of this run to a file.
+     *
+     *  \param filename  The file to append to; it is created, with a
+     *                   header line, if it doesn't exist.
+     *  \param command   The command-line action, or an empty string.
+     *
+     *  \return \b false (with errno set) if the file couldn't be
+     *  written.
+     */
+    bool write_run_metrics(const std::string &filename,
+			   const std::string &command);
+  }
+}
+
+#endif // APTITUDE_UTIL_RUN_METRICS_H
@@ -44,6 +44,34 @@ namespace aptitude
       sqlite3_mutex_leave(sqlite3_db_mutex(handle));
     }
 
+    db::transaction::transaction(db &_parent)
+      : parent(_parent),
+	active(false)
+    {
+      parent.exec("begin transaction");
+      active = true;
+    }
+
+    db::transaction::~transaction()
+    {
+      if(active)
+	{
+	  try
+	    {
+	      parent.exec("rollback");
+	    }
+	  catch(...)
+	    {
+	    }
+	}
+    }
+
+    void db::transaction::commit()
+    {
+      parent.exec("commit");
+      active = false;
+    }
+
     db::db(const std::string &filename,
 	   int flags,
 	   const char *vfs)
@@ -151,34 +179,39 @@ namespace aptitude
 
     db::statement_proxy db::get_cached_statement(const std::string &sql)
     {
-      cwidget::threads::mutex::lock l(statement_cache_mutex);
+      {
+	cwidget::threads::mutex::lock l(statement_cache_mutex);
 
-      // Check whether the statement exists in the cache.
-      statement_cache_hash_index &index(get_cache_hash_index());
+	// Check whether the statement exists in the cache.
+	statement_cache_hash_index &index(get_cache_hash_index());
 
-      statement_cache_hash_index::const_iterator found =
-	index.find(sql);
+	statement_cache_hash_index::iterator found =
+	  index.find(sql);
 
-      if(found != index.end())
-	{
-	  // Extract the element from the set and return it.
-	  statement_cache_entry entry(*found);
-	  entry.stmt->reset();
+	if(found != index.end())
+	  {
+	    // Extract the element from the set and return it.  Only
+	    // this copy is removed: there might be others that are
+	    // waiting to be reused.
+	    statement_cache_entry entry(*found);
+	    index.erase(found);
 
-	  index.erase(sql);
+	    l.release();
 
-	  return statement_proxy(boost::make_shared<statement_proxy_impl>(entry));
-	}
-      else
-	{
-	  // Prepare a new SQL statement and return a proxy to it.  It
-	  // won't be added to the cache until the caller is done with
-	  // it.
-	  boost::shared_ptr<statement> stmt(statement::prepare(*this, sql));
+	    entry.stmt->reset();
 
-	  statement_cache_entry entry(sql, stmt);
-	  return statement_proxy(boost::make_shared<statement_proxy_impl>(entry));
-	}
+	    return statement_proxy(boost::make_shared<statement_proxy_impl>(entry));
+	  }
+      }
+
+      // Prepare a new SQL statement and return a proxy to it.  It
+      // won't be added to the cache until the caller is done with
+      // it.  Compiling the statement doesn't need the cache, so
+      // other threads can use it in the meantime.
+      boost::shared_ptr<statement> stmt(statement::prepare(*this, sql));
+
+      statement_cache_entry entry(sql, stmt);
+      return statement_proxy(boost::make_shared<statement_proxy_impl>(entry));
     }
 
     namespace
@@ -179,6 +179,40 @@ namespace aptitude
 	~lock();
       };
 
+      /** \brief RAII wrapper for a transaction.
+       *
+       *  The constructor begins a transaction on the database, and
+       *  the destructor rolls it back unless commit() was invoked
+       *  first.  Grouping many inserts or updates into one
+       *  transaction makes them much cheaper, since the database
+       *  file is only synced once, when the transaction commits.
+       */
+      class transaction
+      {
+	db &parent;
+	bool active;
+
+	transaction(const transaction &);
+
+      public:
+	/** \brief Begin a transaction on the given database. */
+	explicit transaction(db &_parent);
+
+	/** \brief Roll back the transaction if it hasn't been
+	 *  committed.
+	 *
+	 *  Errors from the rollback are ignored.
+	 */
+	~transaction();
+
+	/** \brief Commit the transaction.
+	 *
+	 *  Throws an exception if the commit fails, in which case the
+	 *  destructor still tries to roll the transaction back.
+	 */
+	void commit();
+      };
+
       /** \brief Open an SQLite database.
        *
        *  \param filename   The name of the database file to open.
@@ -275,7 +309,12 @@ namespace aptitude
        *  cache.
        *
        *  If the statement is not in the cache, it will be compiled
-       *  and added.
+       *  and added.  The cache is only locked while it's searched,
+       *  not while a new statement is compiled.
+       *
+       *  To run the same statement for many rows, retrieve it once
+       *  and reset() it between rows, instead of retrieving it for
+       *  each row.
        */
       statement_proxy get_cached_statement(const std::string &sql);
 
@@ -145,7 +145,8 @@ namespace temp
     }
   }
 
-  void initialize(const std::string &initial_prefix)
+  void initialize(const std::string &initial_prefix,
+		  const std::string &base_dir)
   {
     cw::threads::mutex::lock l(*temp_state_mutex);
 
@@ -168,7 +169,23 @@ namespace temp
 
     std::string prefix(initial_prefix);
 
-    const char *tmpdir = getenv("TMPDIR");
+    const char *tmpdir = NULL;
+
+    if(!base_dir.empty())
+      {
+	if(access(base_dir.c_str(), W_OK | X_OK) == 0)
+	  tmpdir = base_dir.c_str();
+	else
+	  {
+	    int errnum = errno;
+	    LOG_WARN(Loggers::getAptitudeTemp(),
+		     "Can't use \"" << base_dir << "\" for temporary files ("
+		     << sstrerror(errnum) << "); falling back to the default location.");
+	  }
+      }
+
+    if(tmpdir == NULL)
+      tmpdir = getenv("TMPDIR");
 
     if(tmpdir == NULL)
       tmpdir = getenv("TMP");
@@ -68,8 +68,17 @@ namespace temp
    *  If the temporary directory can't be created for some reason,
    *  this logs an error and continues; any attempt to create a name
    *  object after this will throw.
+   *
+   *  \param prefix    Included in the name of the temporary directory.
+   *  \param base_dir  If not empty, the directory in which to create
+   *                   the temporary directory, instead of $TMPDIR.
+   *                   Pointing this at a tmpfs keeps intermediate
+   *                   files such as decompressed downloads off the
+   *                   disk.  If it isn't a writable directory, a
+   *                   warning is logged and $TMPDIR is used.
    */
-  void initialize(const std::string &prefix);
+  void initialize(const std::string &prefix,
+		  const std::string &base_dir = std::string());
 
   /** \brief Shut down the temporary name system if it's initialized,
    *  recursively deleting the temporary directory and its contents.
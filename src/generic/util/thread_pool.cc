@@ -0,0 +1,343 @@
+/** \file thread_pool.cc */
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "thread_pool.h"
+
+#include <loggers.h>
+
+#include <boost/make_shared.hpp>
+
+#include <cwidget/generic/util/exception.h>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+using boost::make_shared;
+using boost::shared_ptr;
+using cwidget::threads::mutex;
+using cwidget::threads::thread;
+
+namespace aptitude
+{
+  namespace util
+  {
+    cancel_token::cancel_token()
+      : s(make_shared<state>())
+    {
+    }
+
+    void cancel_token::cancel()
+    {
+      mutex::lock l(s->m);
+
+      s->canceled = true;
+    }
+
+    bool cancel_token::is_canceled() const
+    {
+      mutex::lock l(s->m);
+
+      return s->canceled;
+    }
+
+
+    class thread_pool::bootstrap
+    {
+      thread_pool *pool;
+
+    public:
+      bootstrap(thread_pool *_pool)
+	: pool(_pool)
+      {
+      }
+
+      void operator()() const
+      {
+	pool->run_worker();
+      }
+    };
+
+    thread_pool::batch::batch(thread_pool &_pool,
+			      const cancel_token &_token)
+      : pool(_pool),
+	token(_token),
+	num_outstanding(0)
+    {
+    }
+
+    thread_pool::batch::~batch()
+    {
+      wait();
+    }
+
+    std::size_t thread_pool::batch::submit(const boost::function<void ()> &task,
+					   priority p)
+    {
+      mutex::lock l(pool.state_mutex);
+
+      entry e;
+      e.task = task;
+      e.token = token;
+      e.b = this;
+      e.index = done.size();
+
+      done.push_back(false);
+      ++num_outstanding;
+
+      pool.enqueue(e, p);
+
+      return e.index;
+    }
+
+    void thread_pool::batch::wait(std::size_t index)
+    {
+      mutex::lock l(pool.state_mutex);
+
+      while(!done[index])
+	{
+	  entry e;
+	  if(pool.take_next(e, this, index))
+	    pool.run_entry(e, l);
+	  else
+	    pool.state_cond.wait(l);
+	}
+    }
+
+    void thread_pool::batch::wait()
+    {
+      mutex::lock l(pool.state_mutex);
+
+      while(num_outstanding > 0)
+	{
+	  entry e;
+	  if(pool.take_next(e, this, done.size()))
+	    pool.run_entry(e, l);
+	  else
+	    pool.state_cond.wait(l);
+	}
+    }
+
+
+    thread_pool::thread_pool(int _max_threads)
+      : max_threads(_max_threads < 1 ? 1 : _max_threads),
+	num_threads(0),
+	num_idle(0),
+	stopping(false)
+    {
+    }
+
+    thread_pool::~thread_pool()
+    {
+      mutex::lock l(state_mutex);
+
+      stopping = true;
+      state_cond.wake_all();
+
+      std::vector<shared_ptr<thread> > threads_copy;
+      threads_copy.swap(threads);
+
+      l.release();
+
+      for(std::vector<shared_ptr<thread> >::const_iterator it =
+	    threads_copy.begin(); it != threads_copy.end(); ++it)
+	(*it)->join();
+    }
+
+    thread_pool &thread_pool::get()
+    {
+      // Deliberately leaked, like the logging system: the workers
+      // might still be running tasks while global destructors run.
+      static thread_pool *pool =
+	new thread_pool(std::max(4L, sysconf(_SC_NPROCESSORS_ONLN)));
+
+      return *pool;
+    }
+
+    thread_pool::group_ptr thread_pool::create_group(int limit)
+    {
+      return make_shared<group>(limit);
+    }
+
+    void thread_pool::set_group_limit(const group_ptr &g, int limit)
+    {
+      mutex::lock l(state_mutex);
+
+      g->limit = limit < 1 ? 1 : limit;
+      state_cond.wake_all();
+    }
+
+    void thread_pool::submit(const boost::function<void ()> &task,
+			     priority p,
+			     const group_ptr &g,
+			     const cancel_token &token)
+    {
+      mutex::lock l(state_mutex);
+
+      entry e;
+      e.task = task;
+      e.g = g;
+      e.token = token;
+      e.b = NULL;
+      e.index = 0;
+
+      enqueue(e, p);
+    }
+
+    void thread_pool::enqueue(const entry &e, priority p)
+    {
+      queues[p].push_back(e);
+
+      if(num_idle > 0)
+	state_cond.wake_all();
+      else if(num_threads < max_threads)
+	{
+	  LOG_TRACE(Loggers::getAptitudeThreadPool(),
+		    "Starting worker thread " << num_threads + 1
+		    << " of " << max_threads << ".");
+
+	  ++num_threads;
+	  threads.push_back(make_shared<thread>(bootstrap(this)));
+	}
+    }
+
+    bool thread_pool::take_next(entry &out, const batch *only,
+				std::size_t index)
+    {
+      // Look for the task a batch is waiting for first, so that
+      // wait(index) returns as soon as possible.
+      if(only != NULL && index < only->done.size())
+	for(int p = num_priorities - 1; p >= 0; --p)
+	  for(std::list<entry>::iterator it = queues[p].begin();
+	      it != queues[p].end(); ++it)
+	    if(it->b == only && it->index == index)
+	      {
+		out = *it;
+		queues[p].erase(it);
+		return true;
+	      }
+
+      for(int p = num_priorities - 1; p >= 0; --p)
+	{
+	  std::list<entry>::iterator it = queues[p].begin();
+	  while(it != queues[p].end())
+	    {
+	      if(only != NULL && it->b != only)
+		{
+		  ++it;
+		  continue;
+		}
+
+	      if(it->token.is_canceled())
+		{
+		  finish_entry(*it);
+		  it = queues[p].erase(it);
+		  continue;
+		}
+
+	      if(it->g.get() != NULL && it->g->running >= it->g->limit)
+		{
+		  ++it;
+		  continue;
+		}
+
+	      out = *it;
+	      queues[p].erase(it);
+	      if(out.g.get() != NULL)
+		++out.g->running;
+	      return true;
+	    }
+	}
+
+      return false;
+    }
+
+    void thread_pool::run_entry(entry &e, mutex::lock &l)
+    {
+      l.release();
+
+      // A canceled task that was taken because a batch was waiting
+      // for it specifically is dropped here.
+      if(!e.token.is_canceled())
+	{
+	  try
+	    {
+	      e.task();
+	    }
+	  catch(const std::exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeThreadPool(),
+		       "Background task: got std::exception: " << ex.what());
+	    }
+	  catch(const cwidget::util::Exception &ex)
+	    {
+	      LOG_WARN(Loggers::getAptitudeThreadPool(),
+		       "Background task: got cwidget::util::Exception: " << ex.errmsg());
+	    }
+	  catch(...)
+	    {
+	      LOG_WARN(Loggers::getAptitudeThreadPool(),
+		       "Background task: got an unknown exception.");
+	    }
+	}
+
+      // Don't hold on to whatever the task referred to.
+      e.task.clear();
+
+      l.acquire();
+
+      finish_entry(e);
+    }
+
+    void thread_pool::finish_entry(const entry &e)
+    {
+      if(e.g.get() != NULL)
+	--e.g->running;
+
+      if(e.b != NULL)
+	{
+	  e.b->done[e.index] = true;
+	  --e.b->num_outstanding;
+	}
+
+      state_cond.wake_all();
+    }
+
+    void thread_pool::run_worker()
+    {
+      mutex::lock l(state_mutex);
+
+      while(true)
+	{
+	  entry e;
+	  if(take_next(e, NULL, 0))
+	    run_entry(e, l);
+	  else if(stopping)
+	    break;
+	  else
+	    {
+	      ++num_idle;
+	      state_cond.wait(l);
+	      --num_idle;
+	    }
+	}
+    }
+  }
+}
@@ -0,0 +1,295 @@
+/** \file thread_pool.h */    // -*-c++-*-
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_THREAD_POOL_H
+#define APTITUDE_UTIL_THREAD_POOL_H
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <list>
+#include <vector>
+
+namespace aptitude
+{
+  namespace util
+  {
+    /** \brief A flag that the submitter of some tasks can set to tell
+     *  them to stop.
+     *
+     *  Copies of a token share the flag.  A task that is canceled
+     *  before it starts is never run; one that is already running has
+     *  to check is_canceled() itself if it wants to stop early.
+     */
+    class cancel_token
+    {
+      struct state
+      {
+	cwidget::threads::mutex m;
+	bool canceled;
+
+	state()
+	  : canceled(false)
+	{
+	}
+      };
+
+      boost::shared_ptr<state> s;
+
+    public:
+      /** \brief Create a token that hasn't been canceled. */
+      cancel_token();
+
+      /** \brief Cancel every task holding a copy of this token. */
+      void cancel();
+
+      bool is_canceled() const;
+    };
+
+    /** \brief A set of worker threads that run short tasks on behalf
+     *  of the rest of the program.
+     *
+     *  Background work that used to start a thread of its own (the
+     *  job_queue_thread queues, parallel searches and sorts) is
+     *  submitted here instead, so that the number of threads stays
+     *  bounded however many features are busy at once.
+     *
+     *  Tasks are run highest priority first, and in the order they
+     *  were submitted within a priority.  A task can be placed in a
+     *  group, which limits how many tasks of the group run at the
+     *  same time; a group with a limit of one runs its tasks one at a
+     *  time, in order.
+     *
+     *  Threads are started as they are needed, up to a fixed maximum,
+     *  and then stay around waiting for more work until the pool is
+     *  destroyed.
+     *
+     *  All the methods are thread-safe.
+     */
+    class thread_pool
+    {
+    public:
+      /** \brief How urgently a task should run. */
+      enum priority
+	{
+	  /** \brief Work that nobody is waiting for. */
+	  priority_low,
+	  priority_normal,
+	  /** \brief Work whose result is about to be displayed. */
+	  priority_high
+	};
+
+      /** \brief A set of tasks that share a concurrency limit. */
+      class group
+      {
+	friend class thread_pool;
+
+	// Both protected by the pool's state_mutex.
+	int limit;
+	int running;
+
+      public:
+	explicit group(int _limit)
+	  : limit(_limit < 1 ? 1 : _limit),
+	    running(0)
+	{
+	}
+      };
+
+      typedef boost::shared_ptr<group> group_ptr;
+
+      /** \brief Tasks that are submitted together and waited for
+       *  together.
+       *
+       *  A thread that waits for a batch runs the batch's tasks that
+       *  haven't started yet itself, rather than sleeping until a
+       *  worker gets to them.  So a task running on the pool can wait
+       *  for a batch without any risk of every worker being blocked.
+       *
+       *  A batch must not be destroyed while its tasks might run;
+       *  the destructor waits for them.
+       */
+      class batch
+      {
+	friend class thread_pool;
+
+	thread_pool &pool;
+	cancel_token token;
+
+	// Protected by the pool's state_mutex.
+	std::vector<bool> done;
+	std::size_t num_outstanding;
+
+	batch(const batch &);
+
+      public:
+	/** \brief Create a batch of tasks that will be run by the
+	 *  given pool.
+	 *
+	 *  \param _token  Canceling this token drops every task in the
+	 *                 batch that hasn't started yet.
+	 */
+	explicit batch(thread_pool &_pool,
+		       const cancel_token &_token = cancel_token());
+	~batch();
+
+	/** \brief Add a task to the batch.
+	 *
+	 *  \return the index of the task in the batch, for wait(). */
+	std::size_t submit(const boost::function<void ()> &task,
+			   priority p = priority_normal);
+
+	/** \brief Wait for a single task of this batch.
+	 *
+	 *  Returns immediately if the task was dropped because the
+	 *  batch was canceled.
+	 */
+	void wait(std::size_t index);
+
+	/** \brief Wait for every task of this batch. */
+	void wait();
+
+	const cancel_token &get_token() const { return token; }
+      };
+
+    private:
+      struct entry
+      {
+	boost::function<void ()> task;
+	group_ptr g;
+	cancel_token token;
+	// If the task is part of a batch, the batch and the task's
+	// index in it.
+	batch *b;
+	std::size_t index;
+      };
+
+      static const int num_priorities = priority_high + 1;
+
+      // The tasks that haven't started yet, by priority.
+      std::list<entry> queues[num_priorities];
+
+      int max_threads;
+      int num_threads;
+      int num_idle;
+
+      // Set by the destructor; idle workers exit when it's set.
+      bool stopping;
+
+      std::vector<boost::shared_ptr<cwidget::threads::thread> > threads;
+
+      cwidget::threads::mutex state_mutex;
+
+      // Signalled when a task is queued or finishes (which might
+      // free a slot in a group or complete a batch).
+      cwidget::threads::condition state_cond;
+
+      class bootstrap;
+      friend class bootstrap;
+      friend class batch;
+
+      thread_pool(const thread_pool &);
+
+      /** \brief Queue a task and start a thread for it if needed.
+       *
+       *  Must be invoked with state_mutex held.
+       */
+      void enqueue(const entry &e, priority p);
+
+      /** \brief Remove the next runnable task from the queue.
+       *
+       *  Tasks whose token has been canceled are dropped along the
+       *  way.  If only is set, only the tasks of that batch are
+       *  considered, and if index can be found it's taken first.
+       *
+       *  Must be invoked with state_mutex held.
+       *
+       *  \return \b true if a task was found.
+       */
+      bool take_next(entry &out, const batch *only, std::size_t index);
+
+      /** \brief Run a task that was taken from the queue.
+       *
+       *  Must be invoked with l holding state_mutex; the lock is
+       *  released while the task runs.
+       */
+      void run_entry(entry &e, cwidget::threads::mutex::lock &l);
+
+      /** \brief Record that a task finished or was dropped.
+       *
+       *  Must be invoked with state_mutex held.
+       */
+      void finish_entry(const entry &e);
+
+      /** \brief The body of each worker thread. */
+      void run_worker();
+
+    public:
+      /** \brief Create a pool.
+       *
+       *  \param _max_threads  The largest number of worker threads
+       *                       the pool will start.
+       */
+      explicit thread_pool(int _max_threads);
+
+      /** \brief Run the tasks that are still queued, then stop the
+       *  worker threads.
+       */
+      ~thread_pool();
+
+      /** \brief Get the pool shared by the whole program.
+       *
+       *  It has one thread per processor, but at least four, since
+       *  some tasks spend their time waiting for the disk.
+       */
+      static thread_pool &get();
+
+      /** \brief Create a group of tasks of which at most limit run
+       *  at once.
+       */
+      static group_ptr create_group(int limit);
+
+      /** \brief Change the number of tasks of a group that can run
+       *  at once.
+       *
+       *  Tasks that are already running are not affected.
+       */
+      void set_group_limit(const group_ptr &g, int limit);
+
+      /** \brief Queue a task.
+       *
+       *  \param task   The task to run.  An exception thrown by the
+       *                task is logged and otherwise ignored.
+       *  \param p      The priority of the task.
+       *  \param g      If not NULL, the group of the task.
+       *  \param token  If this token is canceled before the task
+       *                starts, the task is dropped.
+       */
+      void submit(const boost::function<void ()> &task,
+		  priority p = priority_normal,
+		  const group_ptr &g = group_ptr(),
+		  const cancel_token &token = cancel_token());
+    };
+  }
+}
+
+#endif // APTITUDE_UTIL_THREAD_POOL_H
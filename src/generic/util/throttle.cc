@@ -28,6 +28,8 @@ namespace aptitude
     {
       class throttle_impl : public throttle
       {
+        const double update_interval;
+
         boost::optional<struct timeval> last_update;
 
         logging::LoggerPtr logger;
@@ -36,12 +38,10 @@ namespace aptitude
         // failing.
         bool wrote_time_error;
 
-        static const double update_interval = 0.7;
-
         void write_time_error(int errnum);
 
       public:
-        throttle_impl();
+        explicit throttle_impl(double _update_interval);
 
         /** \return \b true if the timer has expired. */
         bool update_required();
@@ -52,8 +52,6 @@ namespace aptitude
         void reset_timer();
       };
 
-      const double throttle_impl::update_interval;
-
       void throttle_impl::write_time_error(int errnum)
       {
         if(!wrote_time_error)
@@ -65,8 +63,9 @@ namespace aptitude
           }
       }
 
-      throttle_impl::throttle_impl()
-        : logger(Loggers::getAptitudeCmdlineThrottle()),
+      throttle_impl::throttle_impl(double _update_interval)
+        : update_interval(_update_interval),
+          logger(Loggers::getAptitudeCmdlineThrottle()),
           wrote_time_error(false)
       {
       }
@@ -115,9 +114,9 @@ namespace aptitude
     {
     }
 
-    shared_ptr<throttle> create_throttle()
+    shared_ptr<throttle> create_throttle(double update_interval)
     {
-      return make_shared<throttle_impl>();
+      return make_shared<throttle_impl>(update_interval);
     }
   }
 }
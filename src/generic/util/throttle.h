@@ -49,10 +49,11 @@ namespace aptitude
 
     /** \brief Create a throttle object.
      *
-     *  \todo This should take an argument giving the update interval
-     *  in seconds.
+     *  \param update_interval  The number of seconds that must pass
+     *                          after reset_timer() is invoked before
+     *                          another update is required.
      */
-    boost::shared_ptr<throttle> create_throttle();
+    boost::shared_ptr<throttle> create_throttle(double update_interval = 0.7);
   }
 }
 
@@ -0,0 +1,102 @@
+/** \file thunk_dispatcher.cc */
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "thunk_dispatcher.h"
+
+using cwidget::threads::mutex;
+
+namespace aptitude
+{
+  namespace util
+  {
+    thunk_dispatcher::thunk_dispatcher(const boost::function<void ()> &_wakeup)
+      : wakeup_pending(false),
+	wakeup(_wakeup)
+    {
+    }
+
+    bool thunk_dispatcher::enqueue(const safe_slot0<void> &thunk)
+    {
+      pending.push_back(entry(thunk));
+
+      if(wakeup_pending)
+	return false;
+
+      wakeup_pending = true;
+      return true;
+    }
+
+    void thunk_dispatcher::post(const safe_slot0<void> &thunk)
+    {
+      mutex::lock l(m);
+
+      const bool need_wakeup = enqueue(thunk);
+
+      l.release();
+
+      if(need_wakeup)
+	wakeup();
+    }
+
+    void thunk_dispatcher::post_keyed(const void *key,
+				      const safe_slot0<void> &thunk)
+    {
+      mutex::lock l(m);
+
+      boost::unordered_map<const void *, std::size_t>::iterator found =
+	pending_by_key.find(key);
+
+      // The replaced thunk stays in the queue, marked dead, so that
+      // it's destroyed by run_pending() in the main thread.
+      if(found != pending_by_key.end())
+	{
+	  pending[found->second].live = false;
+	  found->second = pending.size();
+	}
+      else
+	pending_by_key[key] = pending.size();
+
+      const bool need_wakeup = enqueue(thunk);
+
+      l.release();
+
+      if(need_wakeup)
+	wakeup();
+    }
+
+    void thunk_dispatcher::run_pending()
+    {
+      std::vector<entry> batch;
+
+      {
+	mutex::lock l(m);
+
+	batch.swap(pending);
+	pending_by_key.clear();
+	wakeup_pending = false;
+      }
+
+      for(std::vector<entry>::const_iterator it = batch.begin();
+	  it != batch.end(); ++it)
+	if(it->live)
+	  it->thunk.get_slot()();
+    }
+  }
+}
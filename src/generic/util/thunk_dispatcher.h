@@ -0,0 +1,118 @@
+/** \file thunk_dispatcher.h */    // -*-c++-*-
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_THUNK_DISPATCHER_H
+#define APTITUDE_UTIL_THUNK_DISPATCHER_H
+
+#include "safe_slot.h"
+
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <vector>
+
+namespace aptitude
+{
+  namespace util
+  {
+    /** \brief Collects thunks posted by background threads and runs
+     *  them in batches in the main thread.
+     *
+     *  The main loop is woken up once for each batch rather than once
+     *  for each thunk: after the first thunk of a batch is posted,
+     *  later thunks just join the queue until the main thread calls
+     *  run_pending().
+     *
+     *  A thunk can also be posted with a key, typically the address
+     *  of the object whose state it reports.  If a thunk with the
+     *  same key is still waiting, it's dropped, so that a flood of
+     *  progress updates only costs the main thread the latest one.
+     *
+     *  All the methods except run_pending() can be invoked from any
+     *  thread.  Thunks that are dropped or run are destroyed in the
+     *  thread that invokes run_pending(), as safe_slot requires.
+     */
+    class thunk_dispatcher
+    {
+      struct entry
+      {
+        safe_slot0<void> thunk;
+        // false if a newer thunk with the same key replaced this one.
+        bool live;
+
+        explicit entry(const safe_slot0<void> &_thunk)
+          : thunk(_thunk), live(true)
+        {
+        }
+      };
+
+      cwidget::threads::mutex m;
+
+      std::vector<entry> pending;
+      // The index in "pending" of the newest thunk for each key.
+      boost::unordered_map<const void *, std::size_t> pending_by_key;
+
+      // Set once wakeup has been invoked for the current batch.
+      bool wakeup_pending;
+
+      boost::function<void ()> wakeup;
+
+      thunk_dispatcher(const thunk_dispatcher &);
+
+      /** \brief Queue a thunk; must be invoked with m held.
+       *
+       *  \return \b true if the main loop has to be woken up.
+       */
+      bool enqueue(const safe_slot0<void> &thunk);
+
+    public:
+      /** \brief Create a dispatcher.
+       *
+       *  \param _wakeup   A function that arranges for run_pending()
+       *                   to be invoked by the main loop.  It's
+       *                   invoked in the posting thread, without any
+       *                   locks held, at most once per batch.
+       */
+      explicit thunk_dispatcher(const boost::function<void ()> &_wakeup);
+
+      /** \brief Queue a thunk to be run in the main thread. */
+      void post(const safe_slot0<void> &thunk);
+
+      /** \brief Queue a thunk, replacing any thunk with the same key
+       *  that hasn't run yet.
+       *
+       *  The new thunk takes its place at the end of the queue, so
+       *  it still runs after everything that was posted before it.
+       */
+      void post_keyed(const void *key, const safe_slot0<void> &thunk);
+
+      /** \brief Run every thunk that was queued before this call.
+       *
+       *  Must be invoked from the main thread.  Thunks posted while
+       *  this runs form the next batch.
+       */
+      void run_pending();
+    };
+  }
+}
+
+#endif // APTITUDE_UTIL_THUNK_DISPATCHER_H
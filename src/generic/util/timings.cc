@@ -0,0 +1,223 @@
+/** \file timings.cc */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#include "timings.h"
+
+// System includes:
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace aptitude
+{
+  namespace util
+  {
+    struct phase_timer::phase
+    {
+      const char *name;
+      phase *parent;
+      std::vector<phase *> children;
+      double total;
+      unsigned long runs;
+
+      /** \brief When the current run of this phase started, or a
+       *  negative number if it isn't running.
+       */
+      double started;
+
+      phase(const char *_name, phase *_parent)
+	: name(_name), parent(_parent), total(0), runs(0), started(-1)
+      {
+      }
+
+      /** \brief Find or create the child phase with the given name. */
+      phase *get_child(const char *child_name)
+      {
+	for(std::vector<phase *>::const_iterator it = children.begin();
+	    it != children.end(); ++it)
+	  if(strcmp((*it)->name, child_name) == 0)
+	    return *it;
+
+	phase *rval = new phase(child_name, this);
+	children.push_back(rval);
+	return rval;
+      }
+    };
+
+    namespace
+    {
+      double now()
+      {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+      }
+
+      /** \brief The recorded phases.
+       *
+       *  The registry is created by the first timer, and the thread
+       *  that created it is the only one that records phases.  Since
+       *  that thread is also the only one that touches the tree, no
+       *  locking is needed.  Like the other global registries, it's
+       *  never deleted, so that timers and print_timings() can run
+       *  from atexit() handlers.
+       */
+      struct registry
+      {
+	pthread_t owner;
+	phase_timer::phase root;
+	phase_timer::phase *current;
+
+	registry()
+	  : owner(pthread_self()), root("total", NULL), current(&root)
+	{
+	  root.started = now();
+	}
+
+	static registry *get()
+	{
+	  static registry *instance = new registry;
+	  return instance;
+	}
+      };
+
+      /** \brief Get the totals of a phase up to the given time.
+       *
+       *  exit() doesn't unwind the stack, so a report written from an
+       *  atexit() handler can find phases that are still running;
+       *  count them as ending at that time.
+       */
+      void get_totals(const phase_timer::phase &p, double when,
+		      double &total, unsigned long &runs)
+      {
+	total = p.total;
+	runs = p.runs;
+	if(p.started >= 0)
+	  {
+	    total += when - p.started;
+	    ++runs;
+	  }
+      }
+
+      void add_named_totals(const phase_timer::phase &p, const char *name,
+			    double when,
+			    double &seconds, unsigned long &runs)
+      {
+	if(strcmp(p.name, name) == 0)
+	  {
+	    double total;
+	    unsigned long p_runs;
+	    get_totals(p, when, total, p_runs);
+	    seconds += total;
+	    runs += p_runs;
+	  }
+
+	for(std::vector<phase_timer::phase *>::const_iterator it = p.children.begin();
+	    it != p.children.end(); ++it)
+	  add_named_totals(**it, name, when, seconds, runs);
+      }
+
+      void print_phase(FILE *out, const phase_timer::phase &p,
+		       double when, int depth)
+      {
+	double total;
+	unsigned long runs;
+	get_totals(p, when, total, runs);
+
+	fprintf(out, "%*s%-*s %10.3f s", depth * 2, "",
+		30 - depth * 2, p.name, total);
+	if(runs > 1)
+	  fprintf(out, " (%lu runs)", runs);
+	fprintf(out, "\n");
+
+	for(std::vector<phase_timer::phase *>::const_iterator it = p.children.begin();
+	    it != p.children.end(); ++it)
+	  print_phase(out, **it, when, depth + 1);
+      }
+    }
+
+    phase_timer::phase_timer(const char *name)
+      : p(NULL)
+    {
+      registry *r = registry::get();
+      if(!pthread_equal(r->owner, pthread_self()))
+	return;
+
+      p = r->current->get_child(name);
+      r->current = p;
+      p->started = now();
+    }
+
+    phase_timer::~phase_timer()
+    {
+      if(p == NULL)
+	return;
+
+      p->total += now() - p->started;
+      p->started = -1;
+      ++p->runs;
+      registry::get()->current = p->parent;
+    }
+
+    void print_timings(FILE *out)
+    {
+      registry *r = registry::get();
+
+      fprintf(out, "Timings:\n");
+      print_phase(out, r->root, now(), 1);
+
+      struct rusage usage;
+      if(getrusage(RUSAGE_SELF, &usage) == 0)
+	// ru_maxrss is measured in kilobytes.
+	fprintf(out, "  Peak RSS: %ld KiB\n", usage.ru_maxrss);
+    }
+
+    void get_phase_totals(const char *name,
+			  double &seconds, unsigned long &runs)
+    {
+      seconds = 0;
+      runs = 0;
+      add_named_totals(registry::get()->root, name, now(), seconds, runs);
+    }
+
+    bool drop_page_cache()
+    {
+      sync();
+
+      const int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+      if(fd == -1)
+	return false;
+
+      // "1" drops the page cache but leaves the dentry and inode
+      // caches alone.
+      const bool ok = write(fd, "1\n", 2) == 2;
+      const int write_errno = errno;
+      close(fd);
+
+      errno = write_errno;
+      return ok;
+    }
+  }
+}
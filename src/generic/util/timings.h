@@ -0,0 +1,96 @@
+/** \file timings.h */   // -*-c++-*-
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_UTIL_TIMINGS_H
+#define APTITUDE_UTIL_TIMINGS_H
+
+#include <stdio.h>
+
+namespace aptitude
+{
+  namespace util
+  {
+    /** \brief Adds the time between its construction and its
+     *  destruction to the global timing registry under the given
+     *  phase name.
+     *
+     *  Timers nest: a timer created while another one is alive is
+     *  recorded as a child of the outer phase, and repeated phases
+     *  with the same name and parent are added together.  Only the
+     *  thread that started the program records anything; timers
+     *  created by other threads do nothing, so that background work
+     *  doesn't scramble the tree.
+     *
+     *  Recording a phase costs two calls to gettimeofday(), so timers
+     *  should surround whole phases of work, not inner loops.
+     */
+    class phase_timer
+    {
+    public:
+      /** \brief A node in the tree of recorded phases. */
+      struct phase;
+
+    private:
+      phase *p;
+
+      phase_timer(const phase_timer &);
+      phase_timer &operator=(const phase_timer &);
+
+    public:
+      /** \param name  The name of this phase; must outlive the
+       *               program (normally a string literal).
+       */
+      explicit phase_timer(const char *name);
+      ~phase_timer();
+    };
+
+    /** \brief Write the tree of recorded phases, with the total time
+     *  and number of runs of each, and the peak resident set size of
+     *  the process to the given file.
+     */
+    void print_timings(FILE *out);
+
+    /** \brief Add up every recorded phase with the given name,
+     *  wherever it appears in the tree.
+     *
+     *  Phases that are still running count as ending now.  The whole
+     *  run is the phase "total".  This must be invoked by the thread
+     *  that records phases.
+     *
+     *  \param name          The name of the phases to add up.
+     *  \param[out] seconds  The total time spent in those phases.
+     *  \param[out] runs     How many times they ran.
+     */
+    void get_phase_totals(const char *name,
+			  double &seconds, unsigned long &runs);
+
+    /** \brief Write any dirty pages to disk and ask the kernel to
+     *  drop its page cache, so that the files aptitude reads next
+     *  come from the disk.
+     *
+     *  This only works for root.
+     *
+     *  \return \b false (with errno set) if the page cache couldn't
+     *  be dropped.
+     */
+    bool drop_page_cache();
+  }
+}
+
+#endif // APTITUDE_UTIL_TIMINGS_H
@@ -8,24 +8,158 @@
 
 #include <cwidget/generic/util/eassert.h>
 
+#include <sigc++/functors/mem_fun.h>
+
 using namespace std;
 
+bool undo_group::covers(const undoable &newer) const
+{
+  for(vector<undoable *>::const_iterator i=items.begin(); i!=items.end(); i++)
+    if((*i)->supersedes(newer))
+      return true;
+
+  return false;
+}
+
+size_t undo_group::memory_size() const
+{
+  size_t rval=sizeof(undo_group) + items.capacity() * sizeof(undoable *);
+
+  for(vector<undoable *>::const_iterator i=items.begin(); i!=items.end(); i++)
+    rval+=(*i)->memory_size();
+
+  return rval;
+}
+
+bool undo_group::supersedes(const undoable &newer) const
+{
+  const undo_group *newer_group=dynamic_cast<const undo_group *>(&newer);
+
+  if(newer_group==NULL)
+    return covers(newer);
+
+  for(vector<undoable *>::const_iterator i=newer_group->items.begin();
+      i!=newer_group->items.end(); i++)
+    if(!covers(**i))
+      return false;
+
+  return true;
+}
+
+undo_list::undo_list()
+  : memory_used(0), memory_limit(0), max_items(0),
+    account(sigc::mem_fun(*this, &undo_list::account_memory))
+{
+  floors.push_back(0);
+}
+
+void undo_list::account_memory(aptitude::util::memory_report &report) const
+{
+  report.add("undo history",
+	     memory_used +
+	     aptitude::util::node_memory_usage(items) +
+	     aptitude::util::node_memory_usage(floors));
+}
+
 void undo_list::undo()
 {
   if(items.size()>floors.back())
     {
-      items.front()->undo();
-      delete items.front();
+      items.front().item->undo();
+      memory_used-=items.front().size;
+      delete items.front().item;
       items.pop_front();
     }
 
   changed();
 }
 
+void undo_list::add_item(undoable *item)
+{
+  const size_t item_size=item->memory_size();
+
+  items.push_front(entry(item, item_size));
+  memory_used+=item_size;
+
+  if(over_limits())
+    enforce_limits();
+
+  changed();
+}
+
+void undo_list::set_memory_limit(size_t limit)
+{
+  memory_limit=limit;
+
+  if(over_limits())
+    {
+      enforce_limits();
+      changed();
+    }
+}
+
+void undo_list::set_max_items(size_t limit)
+{
+  max_items=limit;
+
+  if(over_limits())
+    {
+      enforce_limits();
+      changed();
+    }
+}
+
+bool undo_list::over_limits() const
+{
+  return (memory_limit>0 && memory_used>memory_limit) ||
+    (max_items>0 && items.size()>max_items);
+}
+
+void undo_list::enforce_limits()
+{
+  if(floors.size()>1 || floors.back()>0)
+    return;
+
+  // Merge from the oldest end, since that's the history the user is
+  // least likely to step through one action at a time.
+  list<entry>::iterator older=items.end();
+  while(over_limits() && older!=items.begin())
+    {
+      --older;
+      if(older==items.begin())
+	break;
+
+      list<entry>::iterator newer=older;
+      --newer;
+
+      // Leave the newest item alone, so the action the user just
+      // performed can always be undone by itself.
+      if(newer==items.begin())
+	break;
+
+      if(older->item->supersedes(*newer->item))
+	{
+	  memory_used-=newer->size;
+	  delete newer->item;
+	  items.erase(newer);
+	  // Stay on the same older item: it might supersede the next
+	  // newer one too.
+	  ++older;
+	}
+    }
+
+  while(over_limits() && items.size()>1)
+    {
+      memory_used-=items.back().size;
+      delete items.back().item;
+      items.pop_back();
+    }
+}
+
 void undo_list::clear_items()
 {
-  for(list<undoable *>::iterator i=items.begin(); i!=items.end(); i++)
-    delete(*i);
+  for(list<entry>::iterator i=items.begin(); i!=items.end(); i++)
+    delete i->item;
 
   // FIXME: these tests on the size shouldn't be necessary..I'm trying to
   //       debug a weird problem.
@@ -35,6 +169,7 @@ void undo_list::clear_items()
     floors.erase(floors.begin(), floors.end());
 
   floors.push_back(0);
+  memory_used=0;
 
   eassert(items.size()==0);
   eassert(floors.size()==1);
@@ -49,14 +184,22 @@ void undo_list::collapse_to(unsigned int prev_size)
       eassert(prev_size>=floors.back());
 
       undo_group *new_item=new undo_group;
+      size_t new_size=0;
 
+      // Pull the items off newest first, so add them to the front of
+      // the group to keep it in order.
+      vector<undoable *> collapsed;
       while(items.size()>prev_size)
 	{
-	  new_item->add_item(items.front());
+	  collapsed.push_back(items.front().item);
+	  new_size+=items.front().size;
 	  items.pop_front();
 	}
 
-      items.push_front(new_item);
+      for(vector<undoable *>::reverse_iterator i=collapsed.rbegin(); i!=collapsed.rend(); i++)
+	new_item->add_item(*i);
+
+      items.push_front(entry(new_item, new_size));
     }
 
   changed();
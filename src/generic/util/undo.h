@@ -7,10 +7,14 @@
 #ifndef UNDO_H
 #define UNDO_H
 
+#include <cstddef>
 #include <list>
+#include <vector>
 
 #include <sigc++/signal.h>
 
+#include "memory_accounting.h"
+
 /** \brief A generic structure for undo information.
  * 
  *  \file undo.h
@@ -23,52 +27,112 @@ public:
   virtual void undo()=0;
   // Undoes the action (doh! :) )
 
+  /** \brief Estimate how much memory this object uses, in bytes.
+   *
+   *  undo_list uses this to enforce its memory limit.  Objects that
+   *  hold more than a few fields should override it.
+   */
+  virtual std::size_t memory_size() const {return sizeof(undoable);}
+
+  /** \brief Test whether undoing this action also completely undoes
+   *  a newer action.
+   *
+   *  If it does, undo_list is free to discard the newer action when
+   *  it needs to save memory: undoing both actions in turn has the
+   *  same effect as undoing this one.  The default is to never
+   *  supersede anything.
+   */
+  virtual bool supersedes(const undoable &newer) const {return false;}
+
   virtual ~undoable() {}
 };
 
 class undo_group:public undoable
-//  Groups several undo actions into a single shot -- does them from first to
-// last..
 {
-  std::list<undoable *> items;
+  // Stored oldest first and undone newest first.  A vector costs a
+  // pointer per item, which matters for groups that touch thousands
+  // of packages.
+  std::vector<undoable *> items;
+
+  /** \brief Test whether some item of this group supersedes newer. */
+  bool covers(const undoable &newer) const;
 public:
   virtual void undo()
   {
-    for(std::list<undoable *>::iterator i=items.begin(); i!=items.end(); i++)
+    for(std::vector<undoable *>::reverse_iterator i=items.rbegin(); i!=items.rend(); i++)
       (*i)->undo();
   }
 
   void add_item(undoable *item)
   {
-    items.push_front(item);
+    items.push_back(item);
   }
 
   bool empty() {return items.empty();}
 
+  std::size_t memory_size() const;
+
+  /** \brief A group supersedes an action if each of its parts is
+   *  superseded by an item of the group.
+   */
+  bool supersedes(const undoable &newer) const;
+
   virtual ~undo_group()
   {
-    for(std::list<undoable *>::iterator i=items.begin(); i!=items.end(); i++)
+    for(std::vector<undoable *>::iterator i=items.begin(); i!=items.end(); i++)
       delete *i;
   }
 };
 
 class undo_list
-//  A very very simple way to allow things to be undone.  It takes 
-// responsibility for deleting pointers that it's given.
 {
-  std::list<undoable *> items;
+  struct entry
+  {
+    undoable *item;
+    // The item's memory_size() when it was added.
+    std::size_t size;
+
+    entry(undoable *_item, std::size_t _size)
+      :item(_item), size(_size)
+    {
+    }
+  };
+
+  std::list<entry> items;
   std::list<unsigned int> floors;
+
+  // The total size of the items, and the most that's allowed (0 for
+  // no limit).
+  std::size_t memory_used;
+  std::size_t memory_limit;
+
+  // The most items that are kept (0 for no limit).
+  std::size_t max_items;
+
+  /** \brief Test whether the list is over one of its limits. */
+  bool over_limits() const;
+
+  /** \brief Bring the list back under memory_limit and max_items.
+   *
+   *  Adjacent items are merged first, by dropping newer items that
+   *  an older one supersedes; only if that isn't enough are the
+   *  oldest items forgotten.  The newest item is always kept as it
+   *  is.  Since the indices of the items change, nothing is done
+   *  while a floor is pushed.
+   */
+  void enforce_limits();
+
+  void account_memory(aptitude::util::memory_report &report) const;
+
+  // Declared last so that it's destroyed first.
+  aptitude::util::memory_account account;
 public:
-  undo_list() {floors.push_back(0);}
+  undo_list();
 
   void undo();
 
-  void add_item(undoable *item)
+  void add_item(undoable *item);
     // Inserts an item into the stack of undoable actions
-  {
-    items.push_front(item);
-    changed();
-  }
 
   void clear_items();
 
@@ -82,6 +146,22 @@ public:
   void push_floor(unsigned int floor);
   void pop_floor();
 
+  /** \brief Limit the estimated memory used by the items in the list.
+   *
+   *  \param limit  The limit in bytes, or 0 for no limit.
+   */
+  void set_memory_limit(std::size_t limit);
+
+  /** \brief Limit the number of items in the list.
+   *
+   *  \param limit  The most items to keep, or 0 for no limit.  The
+   *                oldest items are forgotten first.
+   */
+  void set_max_items(std::size_t limit);
+
+  /** \brief Get the estimated memory used by the items in the list. */
+  std::size_t get_memory_used() const {return memory_used;}
+
   /** \brief Emitted after a new entry is added to the list and after
    *  an entry is removed from the list.
    */
@@ -89,8 +169,8 @@ public:
 
   virtual ~undo_list()
   {
-    for(std::list<undoable *>::iterator i=items.begin(); i!=items.end(); i++)
-      delete (*i);
+    for(std::list<entry>::iterator i=items.begin(); i!=items.end(); i++)
+      delete i->item;
   }
 };
 
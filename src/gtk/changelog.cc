@@ -138,157 +138,312 @@ namespace gui
     };
   }
 
-  // \todo Maybe support hiding older versions by default, with a
-  // clickable link at the end saying "show older versions...".
-  //
-  // NB: some changelogs aren't monotonically increasing, so that
-  // support should put a link wherever the "newness state" goes from
-  // newer to not-newer.
-  static Gtk::TextBuffer::iterator
-  do_render_changelog(const cwidget::util::ref_ptr<aptitude::apt::changelog> &cl,
-		      const Glib::RefPtr<Gtk::TextBuffer> &textBuffer,
-		      const std::string &current_version,
-		      Gtk::TextBuffer::iterator where,
-		      bool only_new)
+  namespace
   {
-    using aptitude::apt::changelog;
+    /** \brief The number of changelog entries that are inserted into
+     *  the buffer by each idle callback of render_changelog_chunked().
+     */
+    const std::size_t changelog_entries_per_chunk = 10;
 
-    // Don't update the display until we finish everything.
-    TextBufferUserAction text_buffer_user_action_scope(textBuffer);
+    /** \brief Renders the entries of a changelog into a text buffer,
+     *  a few at a time.
+     *
+     *  The insertion point is kept in a mark rather than an iterator,
+     *  so the buffer can be modified between calls to
+     *  render_entries().
+     */
+    class changelog_render_job
+    {
+      cw::util::ref_ptr<aptitude::apt::changelog> cl;
+      Glib::RefPtr<Gtk::TextBuffer> textBuffer;
+      std::string current_version;
+      bool only_new;
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> newer_tag(textBuffer->create_tag());
-    newer_tag->property_weight() = Pango::WEIGHT_SEMIBOLD;
-    newer_tag->property_weight_set() = true;
+      Glib::RefPtr<Gtk::TextBuffer::Mark> where_mark;
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> number_tag = textBuffer->create_tag();
-    number_tag->property_scale() = Pango::SCALE_LARGE;
+      // The next entry to render.
+      aptitude::apt::changelog::const_iterator next;
+      bool finished;
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_low_tag = textBuffer->create_tag();
+      // Remember whether we added any changelog entries, so we can
+      // show a message if there aren't any.
+      bool added_at_least_one;
+      std::string last_version;
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_medium_tag = textBuffer->create_tag();
-    urgency_medium_tag->property_weight() = Pango::WEIGHT_BOLD;
-    urgency_medium_tag->property_weight_set() = true;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> newer_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> number_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_low_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_medium_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_high_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_critical_tag;
+      Glib::RefPtr<Gtk::TextBuffer::Tag> date_tag;
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_high_tag = textBuffer->create_tag();
-    urgency_high_tag->property_weight() = Pango::WEIGHT_BOLD;
-    urgency_high_tag->property_weight_set() = true;
-    urgency_high_tag->property_foreground() = "#FF0000";
-    urgency_high_tag->property_foreground_set() = true;
+      void render_entry(const cw::util::ref_ptr<aptitude::apt::changelog_entry> &ent,
+			bool newer,
+			Gtk::TextBuffer::iterator &where);
 
-    // NB: "emergency" and "critical" are the same; thus saith
-    // Policy.
-    Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_critical_tag = textBuffer->create_tag();
-    urgency_critical_tag->property_weight() = Pango::WEIGHT_BOLD;
-    urgency_critical_tag->property_weight_set() = true;
-    urgency_critical_tag->property_scale() = Pango::SCALE_LARGE;
-    urgency_critical_tag->property_foreground() = "#FF0000";
-    urgency_critical_tag->property_foreground_set() = true;
+      void finish(Gtk::TextBuffer::iterator &where);
 
-    Glib::RefPtr<Gtk::TextBuffer::Tag> date_tag = textBuffer->create_tag();
+    public:
+      changelog_render_job(const cw::util::ref_ptr<aptitude::apt::changelog> &_cl,
+			   const Glib::RefPtr<Gtk::TextBuffer> &_textBuffer,
+			   const std::string &_current_version,
+			   const Gtk::TextBuffer::iterator &where,
+			   bool _only_new);
 
-    // Remember whether we added any changelog entries, so we can show
-    // a message if there aren't any.
-    bool added_at_least_one = false;
-    std::string last_version;
+      ~changelog_render_job()
+      {
+	textBuffer->delete_mark(where_mark);
+      }
+
+      /** \brief Render up to max_entries more entries.
+       *
+       *  \return \b true if the whole changelog has been rendered.
+       */
+      bool render_entries(std::size_t max_entries);
 
-    for(changelog::const_iterator it = cl->begin(); it != cl->end(); ++it)
+      /** \brief Return an iterator to the end of the rendered text. */
+      Gtk::TextBuffer::iterator get_where() const
       {
-	cw::util::ref_ptr<aptitude::apt::changelog_entry> ent(*it);
+	return textBuffer->get_iter_at_mark(where_mark);
+      }
+    };
 
-	if(only_new)
-	  {
-	    // Check whether the version numbers in the changelog are
-	    // out-of-order.  We start with the most recent changelog
-	    // entry, so they should be decreasing.  If they aren't in
-	    // order, stop generating output.
-	    //
-	    // This is necessary because in practice, some package
-	    // changelogs contain many entries that are "newer" than
-	    // the most recent entry.  Including those entries
-	    // produces output that is both excessive and wrong.
-	    const bool retrograde =
-	      !last_version.empty() &&
-	      _system->VS->CmpVersion(ent->get_version(), last_version) > 0;
-	    if(retrograde)
+    changelog_render_job::changelog_render_job(const cw::util::ref_ptr<aptitude::apt::changelog> &_cl,
+					       const Glib::RefPtr<Gtk::TextBuffer> &_textBuffer,
+					       const std::string &_current_version,
+					       const Gtk::TextBuffer::iterator &where,
+					       bool _only_new)
+      : cl(_cl),
+	textBuffer(_textBuffer),
+	current_version(_current_version),
+	only_new(_only_new),
+	// Right gravity, so the mark stays after the text we insert.
+	where_mark(textBuffer->create_mark(where, false)),
+	next(cl->begin()),
+	finished(false),
+	added_at_least_one(false)
+    {
+      newer_tag = textBuffer->create_tag();
+      newer_tag->property_weight() = Pango::WEIGHT_SEMIBOLD;
+      newer_tag->property_weight_set() = true;
+
+      number_tag = textBuffer->create_tag();
+      number_tag->property_scale() = Pango::SCALE_LARGE;
+
+      urgency_low_tag = textBuffer->create_tag();
+
+      urgency_medium_tag = textBuffer->create_tag();
+      urgency_medium_tag->property_weight() = Pango::WEIGHT_BOLD;
+      urgency_medium_tag->property_weight_set() = true;
+
+      urgency_high_tag = textBuffer->create_tag();
+      urgency_high_tag->property_weight() = Pango::WEIGHT_BOLD;
+      urgency_high_tag->property_weight_set() = true;
+      urgency_high_tag->property_foreground() = "#FF0000";
+      urgency_high_tag->property_foreground_set() = true;
+
+      // NB: "emergency" and "critical" are the same; thus saith
+      // Policy.
+      urgency_critical_tag = textBuffer->create_tag();
+      urgency_critical_tag->property_weight() = Pango::WEIGHT_BOLD;
+      urgency_critical_tag->property_weight_set() = true;
+      urgency_critical_tag->property_scale() = Pango::SCALE_LARGE;
+      urgency_critical_tag->property_foreground() = "#FF0000";
+      urgency_critical_tag->property_foreground_set() = true;
+
+      date_tag = textBuffer->create_tag();
+    }
+
+    // \todo Maybe support hiding older versions by default, with a
+    // clickable link at the end saying "show older versions...".
+    //
+    // NB: some changelogs aren't monotonically increasing, so that
+    // support should put a link wherever the "newness state" goes from
+    // newer to not-newer.
+    bool changelog_render_job::render_entries(std::size_t max_entries)
+    {
+      if(finished)
+	return true;
+
+      // Don't update the display until we finish this batch.
+      TextBufferUserAction text_buffer_user_action_scope(textBuffer);
+
+      Gtk::TextBuffer::iterator where = get_where();
+
+      for(std::size_t n = 0; n < max_entries && next != cl->end(); ++n)
+	{
+	  cw::util::ref_ptr<aptitude::apt::changelog_entry> ent(*next);
+
+	  if(only_new)
+	    {
+	      // Check whether the version numbers in the changelog are
+	      // out-of-order.  We start with the most recent changelog
+	      // entry, so they should be decreasing.  If they aren't in
+	      // order, stop generating output.
+	      //
+	      // This is necessary because in practice, some package
+	      // changelogs contain many entries that are "newer" than
+	      // the most recent entry.  Including those entries
+	      // produces output that is both excessive and wrong.
+	      const bool retrograde =
+		!last_version.empty() &&
+		_system->VS->CmpVersion(ent->get_version(), last_version) > 0;
+	      if(retrograde)
+		{
+		  next = cl->end();
+		  break;
+		}
+	      last_version = ent->get_version();
+	    }
+
+	  bool newer =
+	    !current_version.empty() &&
+	    _system->VS->CmpVersion(ent->get_version(), current_version) > 0;
+
+	  // If the current entry isn't newer, we would have to have
+	  // out-of-order entries in order to see a newer one, so stop
+	  // scanning the changelog at that point.
+	  if(only_new && !newer)
+	    {
+	      next = cl->end();
 	      break;
-	    last_version = ent->get_version();
-	  }
+	    }
 
-	bool newer =
-	  !current_version.empty() &&
-	  _system->VS->CmpVersion(ent->get_version(), current_version) > 0;
-
-	// If the current entry isn't newer, we would have to have
-	// out-of-order entries in order to see a newer one, so stop
-	// scanning the changelog at that point.
-	if(only_new && !newer)
-	  break;
-
-	added_at_least_one = true;
-
-	const bool use_newer_tag = !only_new && newer;
-
-	if(it != cl->begin())
-	  where = textBuffer->insert(where, "\n\n");
-
-	Glib::RefPtr<Gtk::TextBuffer::Mark> changelog_entry_mark;
-	if(use_newer_tag)
-	  changelog_entry_mark = textBuffer->create_mark(where);
-
-	// Can't hyperlink to the package name because it's a
-	// source package name.  Plus, it might not exist.
-	where = textBuffer->insert(where, ent->get_source());
-	where = textBuffer->insert(where, " (");
-	where = textBuffer->insert_with_tag(where,
-					    ent->get_version(),
-					    number_tag);
-	where = textBuffer->insert(where, ") ");
-	where = textBuffer->insert(where, ent->get_distribution());
-	where = textBuffer->insert(where, "; urgency=");
-	Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_tag;
-	const std::string &urgency = ent->get_urgency();
-	if(urgency == "low")
-	  urgency_tag = urgency_low_tag;
-	else if(urgency == "medium")
-	  urgency_tag = urgency_medium_tag;
-	else if(urgency == "high")
-	  urgency_tag = urgency_high_tag;
-	else if(urgency == "critical" || urgency == "emergency")
-	  urgency_tag = urgency_critical_tag;
-
-	if(urgency_tag)
-	  where = textBuffer->insert_with_tag(where, urgency, urgency_tag);
-	else
-	  where = textBuffer->insert(where, urgency);
+	  if(next != cl->begin())
+	    where = textBuffer->insert(where, "\n\n");
 
-	where = textBuffer->insert(where, "\n");
+	  render_entry(ent, newer, where);
+	  added_at_least_one = true;
+	  ++next;
+	}
 
-	where = render_change_elements(ent->get_changes(), ent->get_elements()->get_elements(), textBuffer, where);
+      if(next == cl->end())
+	{
+	  finish(where);
+	  finished = true;
+	}
 
-	where = textBuffer->insert(where, "\n\n");
-	where = textBuffer->insert(where, " -- ");
-	where = textBuffer->insert(where, ent->get_maintainer());
-	where = textBuffer->insert(where, " ");
-	where = textBuffer->insert_with_tag(where, ent->get_date_str(), date_tag);
+      textBuffer->move_mark(where_mark, where);
+      return finished;
+    }
 
-	if(use_newer_tag)
-	  {
-	    Gtk::TextBuffer::iterator start = textBuffer->get_iter_at_mark(changelog_entry_mark);
-	    textBuffer->apply_tag(newer_tag, start, where);
-	  }
-      }
+    void changelog_render_job::render_entry(const cw::util::ref_ptr<aptitude::apt::changelog_entry> &ent,
+					    bool newer,
+					    Gtk::TextBuffer::iterator &where)
+    {
+      const bool use_newer_tag = !only_new && newer;
+
+      Glib::RefPtr<Gtk::TextBuffer::Mark> changelog_entry_mark;
+      if(use_newer_tag)
+	changelog_entry_mark = textBuffer->create_mark(where);
+
+      // Can't hyperlink to the package name because it's a
+      // source package name.  Plus, it might not exist.
+      where = textBuffer->insert(where, ent->get_source());
+      where = textBuffer->insert(where, " (");
+      where = textBuffer->insert_with_tag(where,
+					  ent->get_version(),
+					  number_tag);
+      where = textBuffer->insert(where, ") ");
+      where = textBuffer->insert(where, ent->get_distribution());
+      where = textBuffer->insert(where, "; urgency=");
+      Glib::RefPtr<Gtk::TextBuffer::Tag> urgency_tag;
+      const std::string &urgency = ent->get_urgency();
+      if(urgency == "low")
+	urgency_tag = urgency_low_tag;
+      else if(urgency == "medium")
+	urgency_tag = urgency_medium_tag;
+      else if(urgency == "high")
+	urgency_tag = urgency_high_tag;
+      else if(urgency == "critical" || urgency == "emergency")
+	urgency_tag = urgency_critical_tag;
+
+      if(urgency_tag)
+	where = textBuffer->insert_with_tag(where, urgency, urgency_tag);
+      else
+	where = textBuffer->insert(where, urgency);
 
-    if(!added_at_least_one)
-      {
-	if(cl->size() == 0)
-	  where = textBuffer->insert(where, _("The changelog is empty."));
-	else if((*cl->begin())->get_version() == current_version)
-	  where = textBuffer->insert(where, _("No new changelog entries; it looks like you installed a locally compiled version of this package."));
-	else
-	  where = textBuffer->insert(where, _("No new changelog entries; this is likely due to a binary-only upload of this package."));
-      }
+      where = textBuffer->insert(where, "\n");
 
-    return where;
+      where = render_change_elements(ent->get_changes(), ent->get_elements()->get_elements(), textBuffer, where);
+
+      where = textBuffer->insert(where, "\n\n");
+      where = textBuffer->insert(where, " -- ");
+      where = textBuffer->insert(where, ent->get_maintainer());
+      where = textBuffer->insert(where, " ");
+      where = textBuffer->insert_with_tag(where, ent->get_date_str(), date_tag);
+
+      if(use_newer_tag)
+	{
+	  Gtk::TextBuffer::iterator start = textBuffer->get_iter_at_mark(changelog_entry_mark);
+	  textBuffer->apply_tag(newer_tag, start, where);
+	  textBuffer->delete_mark(changelog_entry_mark);
+	}
+    }
+
+    void changelog_render_job::finish(Gtk::TextBuffer::iterator &where)
+    {
+      if(!added_at_least_one)
+	{
+	  if(cl->size() == 0)
+	    where = textBuffer->insert(where, _("The changelog is empty."));
+	  else if((*cl->begin())->get_version() == current_version)
+	    where = textBuffer->insert(where, _("No new changelog entries; it looks like you installed a locally compiled version of this package."));
+	  else
+	    where = textBuffer->insert(where, _("No new changelog entries; this is likely due to a binary-only upload of this package."));
+	}
+    }
+
+    // Idle callback for render_changelog_chunked(); returns false,
+    // disconnecting itself, once the job is finished.
+    bool render_changelog_chunk(const boost::shared_ptr<changelog_render_job> &job)
+    {
+      return !job->render_entries(changelog_entries_per_chunk);
+    }
+
+    void render_invalid_changelog(const Glib::RefPtr<Gtk::TextBuffer> &textBuffer,
+				  Gtk::TextBuffer::iterator &where)
+    {
+      Glib::RefPtr<Gtk::TextBuffer::Tag> warning_tag = textBuffer->create_tag();
+      warning_tag->property_weight() = Pango::WEIGHT_BOLD;
+      warning_tag->property_weight_set() = true;
+      warning_tag->property_foreground() = "#FF0000";
+      warning_tag->property_foreground_set() = true;
+      where = textBuffer->insert_with_tag(where,
+					  "Can't parse changelog, did you install the libparse-debianchangelog-perl package ?", warning_tag);
+      // \todo Offer to install libparse-debianchangelog-perl if we
+      // can't parse the changelog because it's missing.
+      // Maybe we could add an action button that does that ?
+    }
+
+    /** \brief Render a changelog like render_changelog(), but insert
+     *  the first entries right away and the rest from idle callbacks,
+     *  so that a huge changelog doesn't freeze the window.
+     *
+     *  The newest entries come first in the changelog, so they are
+     *  the ones that appear immediately.
+     */
+    void render_changelog_chunked(const cw::util::ref_ptr<aptitude::apt::changelog> &cl,
+				  const Glib::RefPtr<Gtk::TextBuffer> &textBuffer,
+				  const std::string &current_version,
+				  Gtk::TextBuffer::iterator where,
+				  bool only_new)
+    {
+      if(!cl.valid())
+	{
+	  render_invalid_changelog(textBuffer, where);
+	  return;
+	}
+
+      boost::shared_ptr<changelog_render_job> job =
+	boost::make_shared<changelog_render_job>(cl, textBuffer, current_version,
+						 where, only_new);
+
+      if(!job->render_entries(changelog_entries_per_chunk))
+	Glib::signal_idle().connect(sigc::bind(sigc::ptr_fun(&render_changelog_chunk),
+					       job));
+    }
   }
 
   Gtk::TextBuffer::iterator
@@ -299,19 +454,15 @@ namespace gui
 		   bool only_new)
   {
     if(cl.valid())
-      return do_render_changelog(cl, textBuffer, current_version, where, only_new);
+      {
+	changelog_render_job job(cl, textBuffer, current_version, where, only_new);
+	job.render_entries(cl->size());
+	return job.get_where();
+      }
     else
       {
-        Glib::RefPtr<Gtk::TextBuffer::Tag> warning_tag = textBuffer->create_tag();
-        warning_tag->property_weight() = Pango::WEIGHT_BOLD;
-        warning_tag->property_weight_set() = true;
-        warning_tag->property_foreground() = "#FF0000";
-        warning_tag->property_foreground_set() = true;
-        return textBuffer->insert_with_tag(where,
-					   "Can't parse changelog, did you install the libparse-debianchangelog-perl package ?", warning_tag);
-        // \todo Offer to install libparse-debianchangelog-perl if we
-        // can't parse the changelog because it's missing.
-        // Maybe we could add an action button that does that ?
+	render_invalid_changelog(textBuffer, where);
+	return where;
       }
   }
 
@@ -370,11 +521,11 @@ namespace gui
       const bool only_new = download_info->only_new;
 
       // Now insert the changelog.
-      render_changelog(cl,
-		       download_info->text_buffer,
-		       download_info->current_version,
-		       where,
-		       only_new);
+      render_changelog_chunked(cl,
+			       download_info->text_buffer,
+			       download_info->current_version,
+			       where,
+			       only_new);
     }
 
     void changelog_download_error(const std::string &error,
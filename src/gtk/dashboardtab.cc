@@ -32,13 +32,17 @@
 #include <aptitude.h>
 #include <loggers.h>
 
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/pkgcache.h>
 
+#include <boost/functional/hash.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/ref.hpp>
 
 #include <generic/apt/apt.h>
 #include <generic/apt/apt_undo_group.h>
+#include <generic/apt/cache_artifact.h>
+#include <generic/apt/config_signal.h>
 #include <generic/apt/matching/pattern.h>
 #include <generic/apt/resolver_manager.h>
 
@@ -53,13 +57,10 @@ namespace
 {
   // Used to build the initial installations for the resolver.
   imm::map<aptitude_resolver_package, aptitude_resolver_version>
-  get_upgradable()
+  get_upgradable(const std::set<pkgCache::PkgIterator> &upgradable)
   {
     imm::map<aptitude_resolver_package, aptitude_resolver_version> rval;
 
-    std::set<pkgCache::PkgIterator> upgradable;
-    (*apt_cache_file)->get_upgradable(true, upgradable);
-
     for(std::set<pkgCache::PkgIterator>::const_iterator it =
 	  upgradable.begin(); it != upgradable.end(); ++it)
       {
@@ -75,6 +76,85 @@ namespace
 
     return rval;
   }
+
+  const char upgrade_summary_magic[] = "aptitude-dashboard-upgrade 1";
+
+  std::string get_upgrade_summary_path()
+  {
+    return aptcfg->Find(PACKAGE "::Dashboard-Upgrade-File",
+			(_config->FindDir("Dir::Cache") + "aptitude-dashboard-upgrade").c_str());
+  }
+
+  // Identifies an upgrade calculation: the cache it ran on, the state
+  // the resolver started from and the upgrades it tried to install.
+  // The saved summary is only displayed until a new calculation
+  // finishes, so this doesn't try to account for the resolver's
+  // settings.
+  std::string get_upgrade_summary_fingerprint(const std::set<pkgCache::PkgIterator> &upgradable)
+  {
+    const std::string cache_fingerprint =
+      aptitude::apt::get_cache_fingerprint(**apt_cache_file);
+    if(cache_fingerprint.empty())
+      return std::string();
+
+    std::size_t hash = 0;
+    for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+	!pkg.end(); ++pkg)
+      {
+	const pkgCache::Version * const install_ver =
+	  (*apt_cache_file)[pkg].InstallVer;
+	boost::hash_combine(hash, install_ver == NULL ? 0 : install_ver->ID + 1);
+      }
+
+    for(std::set<pkgCache::PkgIterator>::const_iterator it =
+	  upgradable.begin(); it != upgradable.end(); ++it)
+      boost::hash_combine(hash, (*it)->ID);
+
+    return cw::util::ssprintf("%s %lx", cache_fingerprint.c_str(),
+			      (unsigned long) hash);
+  }
+
+  bool load_upgrade_summary(const std::string &fingerprint,
+			    int &num_upgrades,
+			    int &num_upgrades_selected)
+  {
+    logging::LoggerPtr logger(Loggers::getAptitudeGtkDashboardUpgradeResolver());
+
+    aptitude::apt::cache_artifact_reader reader(get_upgrade_summary_path(),
+						upgrade_summary_magic,
+						fingerprint,
+						"dashboard upgrade summary",
+						logger);
+    if(!reader.is_valid())
+      return false;
+
+    if(!(reader.get_stream() >> num_upgrades >> num_upgrades_selected) ||
+       num_upgrades_selected < 0 || num_upgrades_selected > num_upgrades)
+      {
+	LOG_WARN(logger, "Ignoring " << get_upgrade_summary_path() << ": it is damaged.");
+	return false;
+      }
+
+    return true;
+  }
+
+  void save_upgrade_summary(const std::string &fingerprint,
+			    int num_upgrades,
+			    int num_upgrades_selected)
+  {
+    logging::LoggerPtr logger(Loggers::getAptitudeGtkDashboardUpgradeResolver());
+
+    aptitude::apt::cache_artifact_writer writer(get_upgrade_summary_path(),
+						upgrade_summary_magic,
+						fingerprint,
+						"dashboard upgrade summary",
+						logger);
+    if(!writer.is_open())
+      return;
+
+    writer.get_stream() << num_upgrades << ' ' << num_upgrades_selected << '\n';
+    writer.commit();
+  }
 }
 
 namespace gui
@@ -475,64 +555,98 @@ namespace gui
 	LOG_WARN(logger, "Not creating a resolver: the apt cache is closed.");
 	discard_resolver(); // Just to be sure.
       }
-    else if(upgrade_resolver != NULL)
+    else if(upgrade_resolver != NULL || start_resolver_connection.connected())
       {
 	// Shouldn't happen.
 	LOG_WARN(logger, "Not creating a new resolver for the dashboard tab (one already exists).");
       }
     else
       {
-	LOG_TRACE(logger, "Creating a new resolver for the dashboard tab.");
-	upgrade_resolver = new resolver_manager(apt_cache_file, get_upgradable());
-
-	if(!upgrade_resolver->resolver_exists())
-	  {
-	    LOG_TRACE(logger, "Not calculating an upgrade: there are no broken dependencies.");
-	    // To ensure consistency, invoke success() with an invalid
-	    // solution (indicating nothing to be done).
-	    upgrade_resolver_success(generic_solution<aptitude_universe>());
-	    return;
-	  }
-
-	LOG_TRACE(logger, "Starting to calculate the upgrade in the background.");
-	if(background_upgrade_redirect != NULL)
-	  {
-	    // Shouldn't happen.
-	    LOG_WARN(logger, "The background redirecter was unexpectedly not NULL.");
-	    delete background_upgrade_redirect;
-	    background_upgrade_redirect = NULL;
-	  }
-	background_upgrade_redirect = new redirect_from_background(*this);
-
-	{
-	  sigc::slot<void, generic_solution<aptitude_universe> > success_slot =
-	    sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::success);
-	  sigc::slot<void> no_more_solutions_slot =
-	    sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::no_more_solutions);
-	  sigc::slot<void, std::string> aborted_slot =
-	    sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::aborted);
-
-	  boost::shared_ptr<upgrade_continuation> k =
-	    boost::make_shared<upgrade_continuation>(make_safe_slot(success_slot),
-						     make_safe_slot(no_more_solutions_slot),
-						     make_safe_slot(aborted_slot),
-						     boost::ref(*upgrade_resolver));
-
-	  upgrade_resolver->safe_resolve_deps_background(false, true, k, &post_thunk);
-	}
+	std::set<pkgCache::PkgIterator> upgradable;
+	(*apt_cache_file)->get_upgradable(true, upgradable);
+	pending_upgrades = get_upgradable(upgradable);
+	upgrade_summary_fingerprint = get_upgrade_summary_fingerprint(upgradable);
 
 	LOG_TRACE(logger, "Setting up the progress bar.");
 	upgrade_resolver_progress->show();
 	upgrade_resolver_progress->set_text(_("Calculating upgrade..."));
 	upgrade_resolver_progress->pulse();
-	upgrade_resolver_label->hide();
+
+	// Until the upgrade is recalculated, show what it came to the
+	// last time; the buttons stay inactive, since there's no
+	// solution to act on yet.
+	int num_upgrades, num_upgrades_selected;
+	if(!upgrade_summary_fingerprint.empty() &&
+	   load_upgrade_summary(upgrade_summary_fingerprint,
+				num_upgrades, num_upgrades_selected))
+	  {
+	    LOG_TRACE(logger, "Showing the saved upgrade summary while the upgrade is recalculated.");
+	    show_upgrade_summary(num_upgrades, num_upgrades_selected);
+	    upgrade_resolver_label->show();
+	  }
+	else
+	  upgrade_resolver_label->hide();
 	fix_manually_button->set_sensitive(false);
 	upgrade_button->set_sensitive(false);
 
 	pulse_progress_connection.disconnect(); // Just extra paranoia.
 	pulse_progress_connection = Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &DashboardTab::pulse_progress_timeout),
 									   3);
+
+	start_resolver_connection =
+	  Glib::signal_idle().connect(sigc::mem_fun(*this, &DashboardTab::start_resolver));
+      }
+  }
+
+  bool DashboardTab::start_resolver()
+  {
+    logging::LoggerPtr logger(Loggers::getAptitudeGtkDashboardUpgradeResolver());
+
+    if(apt_cache_file == NULL)
+      {
+	LOG_WARN(logger, "Not creating a resolver: the apt cache is closed.");
+	return false;
+      }
+
+    LOG_TRACE(logger, "Creating a new resolver for the dashboard tab.");
+    upgrade_resolver = new resolver_manager(apt_cache_file, pending_upgrades);
+    pending_upgrades = imm::map<aptitude_resolver_package, aptitude_resolver_version>();
+
+    if(!upgrade_resolver->resolver_exists())
+      {
+	LOG_TRACE(logger, "Not calculating an upgrade: there are no broken dependencies.");
+	// To ensure consistency, invoke success() with an invalid
+	// solution (indicating nothing to be done).
+	upgrade_resolver_success(generic_solution<aptitude_universe>());
+	return false;
+      }
+
+    LOG_TRACE(logger, "Starting to calculate the upgrade in the background.");
+    if(background_upgrade_redirect != NULL)
+      {
+	// Shouldn't happen.
+	LOG_WARN(logger, "The background redirecter was unexpectedly not NULL.");
+	delete background_upgrade_redirect;
+	background_upgrade_redirect = NULL;
       }
+    background_upgrade_redirect = new redirect_from_background(*this);
+
+    sigc::slot<void, generic_solution<aptitude_universe> > success_slot =
+      sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::success);
+    sigc::slot<void> no_more_solutions_slot =
+      sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::no_more_solutions);
+    sigc::slot<void, std::string> aborted_slot =
+      sigc::mem_fun(*background_upgrade_redirect, &redirect_from_background::aborted);
+
+    boost::shared_ptr<upgrade_continuation> k =
+      boost::make_shared<upgrade_continuation>(make_safe_slot(success_slot),
+					       make_safe_slot(no_more_solutions_slot),
+					       make_safe_slot(aborted_slot),
+					       boost::ref(*upgrade_resolver));
+
+    upgrade_resolver->safe_resolve_deps_background(false, true, k, &post_thunk);
+
+    return false;
   }
 
   void DashboardTab::discard_resolver()
@@ -546,6 +660,8 @@ namespace gui
     delete background_upgrade_redirect;
     background_upgrade_redirect = NULL;
     pulse_progress_connection.disconnect();
+    start_resolver_connection.disconnect();
+    pending_upgrades = imm::map<aptitude_resolver_package, aptitude_resolver_version>();
 
     // Throw away the resolver itself.
     delete upgrade_resolver;
@@ -608,13 +724,22 @@ namespace gui
       // If there are no problems, we upgrade all the currently
       // upgradable packages.
       num_upgrades_selected = upgrades.size();
-    const int num_upgrades_not_selected
-      = upgrades.size() - num_upgrades_selected;
+    if(!upgrade_summary_fingerprint.empty())
+      save_upgrade_summary(upgrade_summary_fingerprint,
+			   upgrades.size(), num_upgrades_selected);
 
     upgrade_resolver_progress->hide();
     upgrade_resolver_label->show();
+    show_upgrade_summary(upgrades.size(), num_upgrades_selected);
+  }
+
+  void DashboardTab::show_upgrade_summary(int num_upgrades,
+					  int num_upgrades_selected)
+  {
+    const int num_upgrades_not_selected
+      = num_upgrades - num_upgrades_selected;
 
-    if(upgrades.empty())
+    if(num_upgrades == 0)
       {
 	upgrade_resolver_label->set_text(_("No upgrades are available."));
 	fix_manually_button->set_sensitive(false);
@@ -642,7 +767,7 @@ namespace gui
 						    num_upgrades_selected),
 					   upgrade_button->get_label().c_str(),
 					   num_upgrades_selected,
-					   (int)upgrades.size());
+					   num_upgrades);
 
 	    if(num_upgrades_not_selected > 0)
 	      {
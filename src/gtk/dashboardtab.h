@@ -58,6 +58,20 @@ namespace gui
     // "hold" state changes, that can affect the upgrade calculation.
     resolver_manager *upgrade_resolver;
 
+    // The upgrades that the next resolver will start from, and the
+    // idle connection that will create it.  The resolver is created
+    // from an idle callback so that the dashboard can be drawn
+    // (showing the last summary that was computed) before the
+    // resolver's setup work is done.
+    imm::map<aptitude_resolver_package, aptitude_resolver_version> pending_upgrades;
+    sigc::connection start_resolver_connection;
+
+    // The fingerprint of the upgrade that is being calculated; the
+    // summary of the result is saved under this key, so that it can
+    // be shown immediately the next time the same upgrade is
+    // calculated.  Empty if the summary shouldn't be saved.
+    std::string upgrade_summary_fingerprint;
+
     // Collects code that keeps track of the "fixing upgrade" state.
     class fixing_upgrade_info
     {
@@ -242,8 +256,11 @@ namespace gui
     /** \brief Create the internal resolver if it doesn't exist and
      *  start its calculation.
      *
-     *  Shows the progress bar and hides the label; makes the button
-     *  inactive and kicks off a timer to pulse the progress bar.
+     *  Shows the progress bar and makes the button inactive.  If a
+     *  summary of the same upgrade was saved earlier, it is shown in
+     *  the label until the new calculation finishes; otherwise the
+     *  label is hidden.  The resolver itself is created once the main
+     *  loop is idle.
      */
     void make_resolver();
     /** \brief Throw away the internal resolver and solution, and hide
@@ -251,6 +268,24 @@ namespace gui
      */
     void discard_resolver();
 
+    /** \brief Create the internal resolver and start its calculation
+     *  in the background.
+     *
+     *  Invoked from an idle callback set up by make_resolver().
+     */
+    bool start_resolver();
+
+    /** \brief Describe the result of an upgrade calculation.
+     *
+     *  Sets the label text and the sensitivity of the buttons.
+     *
+     *  \param num_upgrades           The number of packages that can
+     *                                be upgraded.
+     *  \param num_upgrades_selected  The number of those that the
+     *                                calculated upgrade installs.
+     */
+    void show_upgrade_summary(int num_upgrades, int num_upgrades_selected);
+
   public:
     DashboardTab(Glib::ustring label);
     ~DashboardTab();
@@ -29,10 +29,16 @@
 #include "pkgview.h"
 #include "progress.h"
 
+#include <loggers.h>
+
 #include <cmdline/cmdline_why.h>
 
+#include <generic/util/job_queue_thread.h>
+
 #include <cwidget/generic/util/ssprintf.h>
 
+#include <boost/make_shared.hpp>
+
 namespace gui
 {
   // \todo let the user adjust the parameters of the search
@@ -121,10 +127,15 @@ namespace gui
     get_xml()->get_widget("dependency_path_end_show_only_label", path_label);
     size_group->add_widget (*path_label);
 
-    // \todo do something sensible on "closed".
+    cache_closed.connect(sigc::mem_fun(this, &DependencyChainsTab::do_cache_closed));
     cache_reloaded.connect(sigc::mem_fun(this, &DependencyChainsTab::selection_changed));
   }
 
+  DependencyChainsTab::~DependencyChainsTab()
+  {
+    search_token.cancel();
+  }
+
   namespace
   {
     pkgCache::PkgIterator get_path_package(const Glib::RefPtr<Gtk::TreeModel> &model,
@@ -211,44 +222,215 @@ namespace gui
     }
   };
 
-  Glib::RefPtr<Gtk::TreeModel> DependencyChainsTab::get_results()
+  namespace
   {
-    using namespace aptitude;
-    using cwidget::util::ref_ptr;
+    typedef boost::shared_ptr<std::vector<std::vector<aptitude::why::action> > > dependency_chains_results;
 
-    Glib::RefPtr<Gtk::ListStore> store = Gtk::ListStore::create(*results_view->get_columns());
+    /** \brief Thrown from the callbacks of a search to abandon it
+     *  when its results are no longer wanted.
+     */
+    class dependency_chains_search_canceled
+    {
+    };
+
+    /** \brief Callbacks that stop a "why" search as soon as its
+     *  token is canceled.
+     */
+    class dependency_chains_search_callbacks : public aptitude::why::why_callbacks
+    {
+      aptitude::util::cancel_token token;
+
+      void check_canceled() const
+      {
+	if(token.is_canceled())
+	  throw dependency_chains_search_canceled();
+      }
+
+    public:
+      explicit dependency_chains_search_callbacks(const aptitude::util::cancel_token &_token)
+	: token(_token)
+      {
+      }
+
+      void examining_dep(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_because_not_a_conflict(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_because_is_a_conflict(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_according_to_parameters(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_because_not_from_selected_version(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_because_satisfied_by_current_version(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void skip_because_already_seen(const std::vector<aptitude::why::action> &results) { check_canceled(); }
+      void skip_because_version_check_failed(const pkgCache::DepIterator &dep) { check_canceled(); }
+      void enqueued(const pkgCache::PkgIterator &pkg) { check_canceled(); }
+      void enqueued(const pkgCache::PrvIterator &prv) { check_canceled(); }
+      void begin(const aptitude::why::search_params &params) { check_canceled(); }
+      void start_target(const aptitude::why::target &t,
+			const std::vector<aptitude::why::action> &actions)
+      {
+	check_canceled();
+      }
+    };
+
+    class dependency_chains_job
+    {
+      std::vector<cwidget::util::ref_ptr<aptitude::matching::pattern> > leaves;
+      pkgCache::PkgIterator target;
+      aptitude::util::cancel_token token;
+      safe_slot1<void, dependency_chains_results> k;
+
+    public:
+      dependency_chains_job()
+      {
+      }
 
-    // Just add the error row up-front so we know it always appears if
-    // we break out.
+      dependency_chains_job(const std::vector<cwidget::util::ref_ptr<aptitude::matching::pattern> > &_leaves,
+			    const pkgCache::PkgIterator &_target,
+			    const aptitude::util::cancel_token &_token,
+			    const safe_slot1<void, dependency_chains_results> &_k)
+	: leaves(_leaves), target(_target), token(_token), k(_k)
+      {
+      }
+
+      const std::vector<cwidget::util::ref_ptr<aptitude::matching::pattern> > &get_leaves() const { return leaves; }
+      const pkgCache::PkgIterator &get_target() const { return target; }
+      const aptitude::util::cancel_token &get_token() const { return token; }
+      const safe_slot1<void, dependency_chains_results> &get_k() const { return k; }
+    };
+
+    std::ostream &operator<<(std::ostream &out, const dependency_chains_job &job)
     {
-      Gtk::TreeModel::iterator iter = store->append();
-      Gtk::TreeModel::Row row = *iter;
-      (new HeaderEntity(_("Select one or more starting packages and an ending package to search.")))->fill_row(results_view->get_columns(), row);
+      return out << "(target = " << job.get_target().FullName(false)
+		 << ", " << job.get_leaves().size() << " leaves)";
     }
 
+    /** \brief Runs the searches of the dependency chains tabs, one at
+     *  a time.
+     *
+     *  Only the latest search of each tab matters: a search whose
+     *  token was canceled is skipped, or abandoned if it's already
+     *  running.
+     */
+    class dependency_chains_thread
+      : public aptitude::util::job_queue_thread<dependency_chains_thread,
+						dependency_chains_job>
+    {
+      // Set to true when the global signal handlers are connected up.
+      static bool signals_connected;
+
+      // The token of the job that's running, so that it can be
+      // abandoned before the cache is closed.
+      static cwidget::threads::mutex running_mutex;
+      static aptitude::util::cancel_token running_token;
+
+      static void cancel_running_and_stop()
+      {
+	{
+	  cwidget::threads::mutex::lock l(running_mutex);
+	  running_token.cancel();
+	}
+
+	stop();
+      }
+
+    public:
+      static logging::LoggerPtr get_log_category()
+      {
+	return aptitude::Loggers::getAptitudeWhyGtk();
+      }
+
+      dependency_chains_thread()
+      {
+	if(!signals_connected)
+	  {
+	    cache_closed.connect(sigc::ptr_fun(&dependency_chains_thread::cancel_running_and_stop));
+	    cache_reloaded.connect(sigc::ptr_fun(&dependency_chains_thread::start));
+	    signals_connected = true;
+	  }
+      }
+
+      void process_job(const dependency_chains_job &job)
+      {
+	logging::LoggerPtr logger(get_log_category());
+
+	if(job.get_token().is_canceled())
+	  {
+	    LOG_TRACE(logger, "Skipping the canceled search " << job << ".");
+	    return;
+	  }
+
+	{
+	  cwidget::threads::mutex::lock l(running_mutex);
+	  running_token = job.get_token();
+	}
+
+	LOG_TRACE(logger, "Searching for dependency chains: " << job << ".");
+
+	dependency_chains_results results =
+	  boost::make_shared<std::vector<std::vector<aptitude::why::action> > >();
+	try
+	  {
+	    aptitude::why::find_best_justification(job.get_leaves(),
+						   aptitude::why::target::Install(job.get_target()),
+						   false,
+						   0,
+						   boost::make_shared<dependency_chains_search_callbacks>(job.get_token()),
+						   *results);
+	  }
+	catch(dependency_chains_search_canceled &)
+	  {
+	    LOG_TRACE(logger, "Abandoned the search " << job << ".");
+	    return;
+	  }
+
+	post_event(safe_bind(job.get_k(), results));
+      }
+    };
+    bool dependency_chains_thread::signals_connected = false;
+    cwidget::threads::mutex dependency_chains_thread::running_mutex;
+    aptitude::util::cancel_token dependency_chains_thread::running_token;
+  }
+
+  Glib::RefPtr<Gtk::TreeModel> DependencyChainsTab::make_message_results(const std::string &msg)
+  {
+    Glib::RefPtr<Gtk::ListStore> store = Gtk::ListStore::create(*results_view->get_columns());
+
+    Gtk::TreeModel::iterator iter = store->append();
+    Gtk::TreeModel::Row row = *iter;
+    (new HeaderEntity(msg))->fill_row(results_view->get_columns(), row);
+
+    return store;
+  }
+
+  Glib::RefPtr<Gtk::TreeModel> DependencyChainsTab::start_search()
+  {
+    using namespace aptitude;
+    using cwidget::util::ref_ptr;
+
+    // Shown if we break out before starting a search.
+    const std::string select_msg(_("Select one or more starting packages and an ending package to search."));
+
     Glib::RefPtr<Gtk::TreeView::Selection> start_selection =
       start_search_list->get_package_list()->get_treeview()->get_selection();
     Glib::RefPtr<Gtk::TreeView::Selection> end_selection =
       end_search_list->get_package_list()->get_treeview()->get_selection();
 
     if(!start_selection || !end_selection)
-      return store;
+      return make_message_results(select_msg);
 
     Gtk::TreeSelection::ListHandle_Path start_rows = start_selection->get_selected_rows();
     Gtk::TreeSelection::ListHandle_Path end_rows = end_selection->get_selected_rows();
 
     if(start_rows.empty())
-      return store;
+      return make_message_results(select_msg);
 
     const Gtk::TreeSelection::ListHandle_Path::const_iterator end_begin =
       end_rows.begin();
     if(end_begin == end_rows.end())
-      return store;
+      return make_message_results(select_msg);
     const pkgCache::PkgIterator target = get_path_package(end_search_list->get_package_list()->get_model(),
 							  *end_search_list->get_package_list()->get_columns(),
 							  *end_begin);
     if(target.end())
-      return store;
+      return make_message_results(select_msg);
 
     std::vector<ref_ptr<matching::pattern> > leaves;
     for(Gtk::TreeSelection::ListHandle_Path::const_iterator
@@ -262,44 +444,63 @@ namespace gui
       }
 
     if(leaves.empty())
-      return store;
-
-    // Clear the error message.
-    store->clear();
-
-    // Now we run the "why" algorithm.
-    std::vector<std::vector<why::action> > results;
-    why::find_best_justification(leaves,
-				 why::target::Install(target),
-				 false,
-				 0,
-                                 boost::shared_ptr<aptitude::why::why_callbacks>(),
-				 results);
-    if(results.empty() || results.front().empty())
+      return make_message_results(select_msg);
+
+    // Now we run the "why" algorithm in the background; the results
+    // replace the message below when it's done.
+    sigc::slot<void, dependency_chains_results> search_finished_slot =
+      sigc::bind(sigc::mem_fun(*this, &DependencyChainsTab::search_finished),
+		 search_token);
+    dependency_chains_thread::add_job(dependency_chains_job(leaves, target, search_token,
+							    make_safe_slot(search_finished_slot)));
+
+    return make_message_results(_("Searching for dependency chains..."));
+  }
+
+  void DependencyChainsTab::search_finished(const dependency_chains_results &results,
+					    aptitude::util::cancel_token token)
+  {
+    using namespace aptitude;
+
+    // The selection changed or the cache was closed after this
+    // search started.
+    if(token.is_canceled())
+      return;
+
+    if(results->empty() || results->front().empty())
       {
-	Gtk::TreeModel::iterator iter = store->append();
-	Gtk::TreeModel::Row row = *iter;
-	(new HeaderEntity(_("No dependency chain found.")))->fill_row(results_view->get_columns(), row);
+	results_view->set_model(make_message_results(_("No dependency chain found.")));
+	return;
       }
-    else
+
+    Glib::RefPtr<Gtk::ListStore> store = Gtk::ListStore::create(*results_view->get_columns());
+    for(std::vector<why::action>::const_iterator act_it = results->front().begin();
+	act_it != results->front().end(); ++act_it)
       {
-	for(std::vector<why::action>::const_iterator act_it = results[0].begin();
-	    act_it != results[0].end(); ++act_it)
-	  {
-	    // TODO: add support for viewing more than one
-	    // result. (left/right arrow buttons?)
-	    Gtk::TreeModel::iterator iter = store->append();
-	    Gtk::TreeModel::Row row = *iter;
-	    (new DependencyChainActionEntity(*act_it))->fill_row(results_view->get_columns(),
-								 row);
-	  }
+	// TODO: add support for viewing more than one
+	// result. (left/right arrow buttons?)
+	Gtk::TreeModel::iterator iter = store->append();
+	Gtk::TreeModel::Row row = *iter;
+	(new DependencyChainActionEntity(*act_it))->fill_row(results_view->get_columns(),
+							     row);
       }
 
-    return store;
+    results_view->set_model(store);
   }
 
   void DependencyChainsTab::selection_changed()
   {
-    results_view->set_model(get_results());
+    search_token.cancel();
+    search_token = aptitude::util::cancel_token();
+
+    results_view->set_model(start_search());
+  }
+
+  void DependencyChainsTab::do_cache_closed()
+  {
+    search_token.cancel();
+    search_token = aptitude::util::cancel_token();
+
+    results_view->set_model(make_message_results(_("Select one or more starting packages and an ending package to search.")));
   }
 }
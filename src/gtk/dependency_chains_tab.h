@@ -26,6 +26,8 @@
 
 #include <cwidget/generic/util/ref_ptr.h>
 
+#include <generic/util/thread_pool.h>
+
 #include "tab.h"
 
 #include "packagestab.h" // For PackageSearchList.
@@ -33,6 +35,18 @@
 #include <gtkmm/entry.h>
 #include <gtkmm/treemodel.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace aptitude
+{
+  namespace why
+  {
+    class action;
+  }
+}
+
 namespace gui
 {
   class PkgView;
@@ -46,17 +60,34 @@ namespace gui
 
     cwidget::util::ref_ptr<EntityView> results_view;
 
-    // Gets the TreeModel for the results view.
-    Glib::RefPtr<Gtk::TreeModel> get_results();
+    // Canceled when the results of the search that's running in the
+    // background are no longer wanted.
+    aptitude::util::cancel_token search_token;
+
+    // Builds a results model holding a single message.
+    Glib::RefPtr<Gtk::TreeModel> make_message_results(const std::string &msg);
+
+    // Starts a background search for the chains between the selected
+    // packages, and returns the model to display until it finishes.
+    Glib::RefPtr<Gtk::TreeModel> start_search();
+
+    // Invoked in the main thread when a background search finishes.
+    void search_finished(const boost::shared_ptr<std::vector<std::vector<aptitude::why::action> > > &results,
+			 aptitude::util::cancel_token token);
 
     // Invoked when either view's selection changes.
     void selection_changed();
 
+    // Drops the current search, since its results refer to the cache.
+    void do_cache_closed();
+
   public:
     /** \brief Create a new dependency-chains tab.
      *
      *  \param label  The label of the new tab.
      */
     DependencyChainsTab(const Glib::ustring &label);
+
+    ~DependencyChainsTab();
   };
 }
@@ -25,13 +25,18 @@
 
 #include <generic/util/temp.h>
 
+#include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/ssprintf.h>
 
+#include <boost/make_shared.hpp>
+
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h> // Fox UNIX-domain sockets.
 
+#include <errno.h>
 #include <termios.h>
+#include <unistd.h>
 
 #include <apt-pkg/error.h>
 
@@ -52,122 +57,6 @@ namespace gui
 {
   namespace
   {
-    // In some theoretical sense, it might be worthwhile to create a
-    // thread to monitor the dpkg socket.  In practical terms, though,
-    // I expect that it'll be perfectly acceptable to handle dpkg
-    // status messages from the main loop.
-    //
-    // The main reason for this class is that we need to store the
-    // dpkg status fd parser somewhere.  It also makes me feel a
-    // little better about copying slots around.
-    //
-    // This is a self-deleting class: it kills itself when it hits
-    // EOF on the socket.
-    class dpkg_socket_data_processor : public sigc::trackable
-    {
-      int fd;
-      safe_slot1<void, aptitude::apt::dpkg_status_message> report_message;
-      aptitude::apt::dpkg_status_parser parser;
-      logging::LoggerPtr logger;
-
-      static void delete_socket_data_processor(logging::LoggerPtr logger,
-					       dpkg_socket_data_processor *processor)
-      {
-	LOG_TRACE(logger, "Deleting dpkg socket data processor " << processor << ".");
-	delete processor;
-      }
-
-    public:
-      dpkg_socket_data_processor(int _fd,
-				 const safe_slot1<void, aptitude::apt::dpkg_status_message> &_report_message)
-	: fd(_fd), report_message(_report_message),
-	  logger(Loggers::getAptitudeDpkgStatusPipe())
-      {
-      }
-
-      bool process_data_from_dpkg_socket(Glib::IOCondition condition)
-      {
-	LOG_TRACE(logger, "Got dpkg socket event: condition " << condition);
-
-	bool rval = false;
-
-	if(condition & Glib::IO_IN)
-	  {
-	    LOG_TRACE(logger, "Reading data from the dpkg socket.");
-	    char buf[1024];
-	    const int buf_len = sizeof(buf);
-	    int amt;
-	    bool read_anything = false;
-	    do
-	      {
-		amt = recv(fd, buf, buf_len, MSG_DONTWAIT);
-
-		if(amt < 0)
-		  {
-		    int errnum = errno;
-		    std::string err(cw::util::sstrerror(errnum));
-		    LOG_FATAL(logger, "Error reading from the dpkg socket: " << err);
-		    break;
-		  }
-
-		// TODO: I should escape all the socket data.
-		LOG_DEBUG(logger, "Read data from the dpkg socket: \"" << std::string(buf, amt) << "\".");
-
-		parser.process_input(buf, amt);
-
-		if(aptcfg->FindB("Debug::Aptitude::Dpkg-Status-Fd", false))
-		  write(1, buf, amt);
-
-		while(parser.has_pending_message())
-		  {
-		    aptitude::apt::dpkg_status_message
-		      msg(parser.pop_message());
-		    LOG_TRACE(logger, "Parsed dpkg message: " << msg << ".");
-		    report_message.get_slot()(msg);
-		  }
-
-		if(amt > 0)
-		  read_anything = true;
-	      }
-	    while(amt > 0);
-
-	    if(read_anything)
-	      LOG_TRACE(logger, "No data received from the dpkg socket, assuming the process exited.");
-	    else
-	      LOG_TRACE(logger, "Done reading data from the dpkg socket.");
-
-	    rval = read_anything;
-	  }
-	else if( (condition & Glib::IO_NVAL) ||
-		 (condition & Glib::IO_ERR) ||
-		 (condition & Glib::IO_HUP) )
-	  {
-	    LOG_TRACE(logger, "The socket seems to have closed, exiting.");
-	    rval = false;
-	  }
-	else
-	  {
-	    LOG_ERROR(logger, "Unexpected IO condition " << condition);
-	    _error->Warning("Unexpected IO condition %d", condition);
-	    rval = false;
-	  }
-
-	if(!rval)
-	  // We could probably just "delete this" right here, but I feel
-	  // a little nervous about deleting something that's actively
-	  // involved in signal delivery.
-	  {
-	    LOG_DEBUG(logger, "Scheduling this socket data processor (" << this << ") for deletion.");
-	    sigc::slot0<void> delete_this =
-	      sigc::bind(sigc::ptr_fun(&dpkg_socket_data_processor::delete_socket_data_processor),
-			 logger, this);
-	    post_event(make_safe_slot(delete_this));
-	  }
-
-	return rval;
-      }
-    };
-
     // Closure structure to connect up the child-exited signal.
     struct child_exited_info
     {
@@ -290,11 +179,168 @@ namespace gui
     return false;
   }
 
-  void DpkgTerminal::handle_status_message(aptitude::apt::dpkg_status_message msg)
+  /** \brief The messages that the status thread has parsed. */
+  class DpkgTerminal::status_queue
   {
-    subprocess_running_changed(true);
-    reset_inactivity_timeout();
-    status_message(msg);
+    cw::threads::mutex mutex;
+    std::vector<aptitude::apt::dpkg_status_message> messages;
+    bool wakeup_pending;
+    bool eof;
+
+  public:
+    status_queue()
+      : wakeup_pending(false), eof(false)
+    {
+    }
+
+    /** \brief Add messages to the queue.
+     *
+     *  \return \b true if the main thread should be woken up; only
+     *  one wakeup is outstanding at a time, so a flood of messages
+     *  costs the main loop one event per iteration.
+     */
+    bool push(const std::vector<aptitude::apt::dpkg_status_message> &new_messages,
+	      bool at_eof)
+    {
+      cw::threads::mutex::lock l(mutex);
+
+      messages.insert(messages.end(), new_messages.begin(), new_messages.end());
+      if(at_eof)
+	eof = true;
+
+      if(wakeup_pending)
+	return false;
+
+      wakeup_pending = true;
+      return true;
+    }
+
+    /** \brief Remove every message from the queue. */
+    void take(std::vector<aptitude::apt::dpkg_status_message> &out,
+	      bool &out_eof)
+    {
+      cw::threads::mutex::lock l(mutex);
+
+      out.swap(messages);
+      out_eof = eof;
+      wakeup_pending = false;
+    }
+  };
+
+  /** \brief Reads the dpkg status socket until it is closed. */
+  class DpkgTerminal::status_reader
+  {
+    int fd;
+    bool echo;
+    boost::shared_ptr<status_queue> queue;
+    safe_slot0<void> wakeup;
+
+  public:
+    status_reader(int _fd, bool _echo,
+		  const boost::shared_ptr<status_queue> &_queue,
+		  const safe_slot0<void> &_wakeup)
+      : fd(_fd), echo(_echo), queue(_queue), wakeup(_wakeup)
+    {
+    }
+
+    void operator()()
+    {
+      logging::LoggerPtr logger(Loggers::getAptitudeDpkgStatusPipe());
+      aptitude::apt::dpkg_status_parser parser;
+      std::vector<aptitude::apt::dpkg_status_message> messages;
+
+      while(true)
+	{
+	  char buf[4096];
+	  const int amt = recv(fd, buf, sizeof(buf), 0);
+
+	  if(amt < 0)
+	    {
+	      int errnum = errno;
+	      if(errnum == EINTR)
+		continue;
+
+	      std::string err(cw::util::sstrerror(errnum));
+	      LOG_FATAL(logger, "Error reading from the dpkg socket: " << err);
+	    }
+
+	  if(amt <= 0)
+	    break;
+
+	  // TODO: I should escape all the socket data.
+	  LOG_DEBUG(logger, "Read data from the dpkg socket: \"" << std::string(buf, amt) << "\".");
+
+	  parser.process_input(buf, amt);
+
+	  if(echo)
+	    write(1, buf, amt);
+
+	  while(parser.has_pending_message())
+	    {
+	      messages.push_back(parser.pop_message());
+	      LOG_TRACE(logger, "Parsed dpkg message: " << messages.back() << ".");
+	    }
+
+	  if(!messages.empty())
+	    {
+	      if(queue->push(messages, false))
+		post_event(wakeup);
+	      messages.clear();
+	    }
+	}
+
+      LOG_TRACE(logger, "No more data from the dpkg socket, assuming the process exited.");
+      if(queue->push(messages, true))
+	post_event(wakeup);
+    }
+  };
+
+  void DpkgTerminal::handle_status_messages()
+  {
+    std::vector<aptitude::apt::dpkg_status_message> messages;
+    bool eof;
+    pending_status->take(messages, eof);
+
+    using aptitude::apt::dpkg_status_message;
+    std::size_t last_status = messages.size();
+    for(std::size_t i = 0; i < messages.size(); ++i)
+      if(messages[i].get_type() == dpkg_status_message::status)
+	last_status = i;
+
+    if(!messages.empty())
+      {
+	LOG_TRACE(Loggers::getAptitudeDpkgStatusPipe(),
+		  "Handling " << messages.size() << " dpkg status messages.");
+	subprocess_running_changed(true);
+	reset_inactivity_timeout();
+      }
+
+    for(std::size_t i = 0; i < messages.size(); ++i)
+      {
+	if(messages[i].get_type() == dpkg_status_message::status &&
+	   i != last_status)
+	  continue;
+
+	status_message(messages[i]);
+      }
+
+    if(eof)
+      join_status_thread();
+  }
+
+  void DpkgTerminal::join_status_thread()
+  {
+    if(status_thread.get() != NULL)
+      {
+	status_thread->join();
+	status_thread.reset();
+      }
+
+    if(status_fd != -1)
+      {
+	close(status_fd);
+	status_fd = -1;
+      }
   }
 
   void DpkgTerminal::handle_dpkg_finished(pkgPackageManager::OrderResult result)
@@ -309,7 +355,9 @@ namespace gui
   DpkgTerminal::DpkgTerminal()
     : sent_finished_signal(false),
       subprocess_complete(false),
-      logger(Loggers::getAptitudeDpkgTerminal())
+      logger(Loggers::getAptitudeDpkgTerminal()),
+      pending_status(boost::make_shared<status_queue>()),
+      status_fd(-1)
   {
     LOG_TRACE(logger, "Creating the dpkg terminal manager.");
 
@@ -324,6 +372,12 @@ namespace gui
   DpkgTerminal::~DpkgTerminal()
   {
     LOG_TRACE(logger, "Destroying the dpkg terminal manager (" << this << ").");
+
+    // Wake the status thread up if dpkg is somehow still running.
+    if(status_thread.get() != NULL)
+      shutdown(status_fd, SHUT_RDWR);
+    join_status_thread();
+
     delete terminal;
   }
 
@@ -648,13 +702,19 @@ namespace gui
 	  }
 
 	// Catch status output from the install process.
-	sigc::slot1<void, aptitude::apt::dpkg_status_message>
-	  report_message_slot(sigc::mem_fun(*this, &DpkgTerminal::handle_status_message));
-	dpkg_socket_data_processor *data_processor = new dpkg_socket_data_processor(dpkg_sock, make_safe_slot(report_message_slot));
 	if(dpkg_sock != -1)
-	  Glib::signal_io().connect(sigc::mem_fun(*data_processor, &dpkg_socket_data_processor::process_data_from_dpkg_socket),
-				    dpkg_sock,
-				    Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP | Glib::IO_NVAL);
+	  {
+	    join_status_thread(); // Just to be sure.
+
+	    sigc::slot0<void> wakeup_slot =
+	      sigc::mem_fun(*this, &DpkgTerminal::handle_status_messages);
+	    status_fd = dpkg_sock;
+	    status_thread =
+	      boost::make_shared<cw::threads::thread>(status_reader(dpkg_sock,
+								    aptcfg->FindB("Debug::Aptitude::Dpkg-Status-Fd", false),
+								    pending_status,
+								    make_safe_slot(wakeup_slot)));
+	  }
 
 	// The parent process.  Here we just wait for the reaper to
 	// tell us that the child finished, then return the result.
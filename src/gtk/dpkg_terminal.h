@@ -32,8 +32,18 @@
 
 #include <loggers.h>
 
+#include <boost/shared_ptr.hpp>
+
 struct sockaddr_un;
 
+namespace cwidget
+{
+  namespace threads
+  {
+    class thread;
+  }
+}
+
 /** \brief Support for creating a GUI terminal in which dpkg can be
  *  invoked.
  *
@@ -79,10 +89,39 @@ namespace gui
      */
     bool subprocess_timeout_handler();
 
-    /** \brief Reset the activity timeout and forward the given
-     *  message to the status message signal.
+    class status_queue;
+    class status_reader;
+
+    /** \brief Messages read from the dpkg status socket that the main
+     *  thread hasn't handled yet.
+     */
+    boost::shared_ptr<status_queue> pending_status;
+
+    /** \brief The thread that reads the dpkg status socket, or NULL.
+     *
+     *  The socket is read in its own thread so that dpkg never waits
+     *  for the main loop to get around to it, no matter how busy the
+     *  GUI is.
+     */
+    boost::shared_ptr<cwidget::threads::thread> status_thread;
+
+    /** \brief The dpkg status socket, or -1. */
+    int status_fd;
+
+    /** \brief Handle the status messages that were queued since the
+     *  last call.
+     *
+     *  Resets the activity timeout once and forwards the messages to
+     *  the status message signal.  Status messages that are followed
+     *  by another one in the same batch are dropped, since they
+     *  would be overwritten before they could be drawn.
+     */
+    void handle_status_messages();
+
+    /** \brief Wait for the status thread to exit and close the
+     *  socket.
      */
-    void handle_status_message(aptitude::apt::dpkg_status_message msg);
+    void join_status_thread();
 
     /** \brief Invoked when the subprocess terminates.
      *
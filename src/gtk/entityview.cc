@@ -28,6 +28,7 @@
 
 #include <gtk/gui.h>
 #include <gtk/info.h>
+#include <gtk/pkglistmodel.h>
 
 #include <apt-pkg/error.h>
 #include <apt-pkg/pkgsystem.h>
@@ -708,6 +709,12 @@ namespace gui
 
   void EntityView::refresh_view(const std::set<pkgCache::PkgIterator> *changed_packages)
   {
+    if(package_list_model)
+      {
+	package_list_model->refresh_packages(*changed_packages);
+	return;
+      }
+
     for(std::set<pkgCache::PkgIterator>::iterator pkg = changed_packages->begin(); pkg != changed_packages->end(); pkg++)
       {
         std::pair<std::multimap<pkgCache::PkgIterator, Gtk::TreeModel::iterator>::iterator,
@@ -867,10 +874,14 @@ namespace gui
 			    sigc::mem_fun(this, &EntityView::compare_rows_by_version));
 
     revstore.clear();
-    model->foreach_iter(sigc::bind(sigc::ptr_fun(&post_process_model),
-				   model,
-				   get_columns(),
-				   get_reverse_store()));
+    // A package list fills in its rows as they're displayed, so walk
+    // over it only when it's refreshed, not to build revstore.
+    package_list_model = PkgListModel::find(model);
+    if(!package_list_model)
+      model->foreach_iter(sigc::bind(sigc::ptr_fun(&post_process_model),
+				     model,
+				     get_columns(),
+				     get_reverse_store()));
     get_treeview()->set_model(model);
   }
 }
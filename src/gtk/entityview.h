@@ -38,6 +38,7 @@ namespace gui
 {
   class EntityView;
   class EntityColumns;
+  class PkgListModel;
 
   class Entity : public aptitude::util::refcounted_base_threadsafe
   {
@@ -177,6 +178,10 @@ namespace gui
       Glib::ustring visible_columns_dialog_parent_title;
 
       std::multimap<pkgCache::PkgIterator, Gtk::TreeModel::iterator> revstore;
+      /** \brief The package list displayed by this view, if its
+       *  model is one; refreshed in place of revstore.
+       */
+      Glib::RefPtr<PkgListModel> package_list_model;
       void init(Glib::RefPtr<Gnome::Glade::Xml> refGlade,
                 Glib::ustring gladename);
 
@@ -23,6 +23,7 @@
 #include "filesview.h"
 #include "aptitude.h"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 //#include <string>
@@ -35,8 +36,11 @@
 #include <apt-pkg/tagfile.h>
 #include <apt-pkg/version.h>
 
+#include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/ssprintf.h>
 
+#include <boost/make_shared.hpp>
+
 #include <generic/apt/changelog_parse.h>
 #include <generic/apt/download_manager.h>
 #include <generic/apt/pkg_changelog.h>
@@ -50,6 +54,8 @@ namespace gui
   {
     add(Type);
     add(File);
+    add(Path);
+    add(Node);
   }
 
   FilesTreeView::FilesTreeView(BaseObjectType* cobject, const Glib::RefPtr<Gnome::Glade::Xml>& refGlade)
@@ -114,6 +120,7 @@ namespace gui
 
     tree->signal_context_menu.connect(sigc::mem_fun(*this, &FilesView::context_menu_handler));
     tree->signal_row_activated().connect(sigc::mem_fun(*this, &FilesView::row_activated_handler));
+    tree->signal_test_expand_row().connect(sigc::mem_fun(*this, &FilesView::test_expand_row_handler));
     tree->set_column_drag_function(sigc::mem_fun(*this, &FilesView::column_drop_handler));
 
     tree->set_search_column(cols.File);
@@ -122,7 +129,7 @@ namespace gui
     tree->get_selection()->set_mode(Gtk::SELECTION_MULTIPLE);
 
     // FIXME: Should we be doing this here ?
-    store = Gtk::ListStore::create(cols);
+    store = Gtk::TreeStore::create(cols);
     // FIXME: There's an issue here when the cache is reloaded (eg. after an update).
     //        A duplicate "Files" column is appended and the TreeView is wrecked.
     tree->append_column("Type", cols.Type);
@@ -146,7 +153,7 @@ namespace gui
       while (!iter_list.empty())
         {
           Gtk::TreeModel::iterator iter = iter_list.front();
-          Glib::ustring filename = (*iter)[cols.File];
+          Glib::ustring filename = (*iter)[cols.Path];
           dispatch_action(filename, action);
 
           iter_list.pop_front();
@@ -183,10 +190,18 @@ namespace gui
 
   FilesView::FilesView(Glib::RefPtr<Gnome::Glade::Xml> refGlade,
                          Glib::ustring gladename)
+    : load_request(0)
   {
     init(refGlade, gladename);
   }
 
+  FilesView::~FilesView()
+  {
+    for(std::map<int, boost::shared_ptr<cwidget::threads::thread> >::const_iterator
+          it = load_threads.begin(); it != load_threads.end(); ++it)
+      it->second->join();
+  }
+
   namespace
   {
     void add_menu_item(Gtk::Menu *menu,
@@ -244,8 +259,12 @@ namespace gui
              path != selected_rows.end(); ++path)
           {
             Gtk::TreeModel::iterator iter = model->get_iter(*path);
+            const int node = (*iter)[cols.Node];
+            if(node < 0)
+              continue;
+
             Glib::ustring type = (*iter)[cols.Type];
-            Glib::ustring filename = (*iter)[cols.File];
+            Glib::ustring filename = (*iter)[cols.Path];
             add_action(type, filename, actions);
           }
 
@@ -273,12 +292,151 @@ namespace gui
   }
 
   FilesView::FilesView(Gtk::TreeView *_treeview)
+    : load_request(0)
   {
   }
 
+  class FilesView::files_tree
+  {
+  public:
+    struct node
+    {
+      /** \brief The last component of the node's path. */
+      std::string name;
+      std::string path;
+      bool is_dir;
+      /** \brief The children of a directory, sorted by name. */
+      std::vector<std::size_t> children;
+
+      node(const std::string &_name, const std::string &_path)
+        : name(_name), path(_path), is_dir(false)
+      {
+      }
+    };
+
+  private:
+    std::vector<node> nodes;
+    std::map<std::string, std::size_t> nodes_by_path;
+
+    class name_lt
+    {
+      const std::vector<node> &nodes;
+    public:
+      name_lt(const std::vector<node> &_nodes)
+        : nodes(_nodes)
+      {
+      }
+
+      bool operator()(std::size_t n1, std::size_t n2) const
+      {
+        return nodes[n1].name < nodes[n2].name;
+      }
+    };
+
+    // Find the node of a path, creating it and its parent
+    // directories if necessary.
+    std::size_t get_node(const std::string &path)
+    {
+      std::map<std::string, std::size_t>::const_iterator found =
+        nodes_by_path.find(path);
+      if(found != nodes_by_path.end())
+        return found->second;
+
+      const std::string::size_type slash = path.rfind('/');
+      const std::size_t parent =
+        get_node(slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash));
+
+      const std::size_t rval = nodes.size();
+      nodes.push_back(node(path.substr(slash + 1), path));
+      nodes[parent].is_dir = true;
+      nodes[parent].children.push_back(rval);
+      nodes_by_path[path] = rval;
+
+      return rval;
+    }
+
+  public:
+    files_tree()
+    {
+      nodes.push_back(node("", "/"));
+      nodes.front().is_dir = true;
+      nodes_by_path["/"] = 0;
+    }
+
+    /** \brief The root directory. */
+    static const std::size_t root = 0;
+
+    const node &get(std::size_t n) const { return nodes[n]; }
+
+    /** \brief Read a dpkg file list.
+     *
+     *  \return \b false if the list couldn't be opened.
+     */
+    bool read(const std::string &filename)
+    {
+      std::ifstream fileslist(filename.c_str());
+      if(fileslist.fail())
+        return false;
+
+      std::string path;
+      while(std::getline(fileslist, path))
+        {
+          while(path.size() > 1 && path[path.size() - 1] == '/')
+            path.erase(path.size() - 1);
+
+          // dpkg lists the root directory as "/.".
+          if(path.empty() || path == "/.")
+            continue;
+
+          get_node(path);
+        }
+      nodes_by_path.clear();
+
+      // Directories that don't contain anything, and the files
+      // themselves, are only told apart by looking at them.
+      for(std::vector<node>::iterator it = nodes.begin();
+          it != nodes.end(); ++it)
+        {
+          if(it->children.empty())
+            it->is_dir = Glib::file_test(it->path, Glib::FILE_TEST_IS_DIR);
+          else
+            std::sort(it->children.begin(), it->children.end(), name_lt(nodes));
+        }
+
+      return true;
+    }
+  };
+
+  class FilesView::load_thread
+  {
+    int request;
+    std::string filename;
+    safe_slot2<void, int, boost::shared_ptr<const files_tree> > k;
+
+  public:
+    load_thread(int _request,
+                const std::string &_filename,
+                const safe_slot2<void, int, boost::shared_ptr<const files_tree> > &_k)
+      : request(_request), filename(_filename), k(_k)
+    {
+    }
+
+    void operator()()
+    {
+      boost::shared_ptr<files_tree> result = boost::make_shared<files_tree>();
+      if(!result->read(filename))
+        result.reset();
+
+      post_event(safe_bind(k, request, boost::shared_ptr<const files_tree>(result)));
+    }
+  };
+
   void FilesView::load_version(pkgCache::VerIterator ver)
   {
+    ++load_request;
     store->clear();
+    files.reset();
+    loading_row = Gtk::TreeModel::iterator();
 
     if(ver.end())
        // Assume this means, e.g. a virtual package with no files.
@@ -288,6 +446,7 @@ namespace gui
       {
 	Gtk::TreeModel::iterator iter = store->append();
 	Gtk::TreeModel::Row row = *iter;
+	row[cols.Node] = -1;
 	using cwidget::util::ssprintf;
 
 	if(!ver.ParentPkg().CurrentVer().end())
@@ -300,32 +459,112 @@ namespace gui
     Glib::ustring fileslistname = Glib::ustring("/var/lib/dpkg/info/")
     + Glib::ustring(ver.ParentPkg().Name()) + Glib::ustring(".list");
 
-    std::ifstream fileslist(fileslistname.c_str());
+    loading_row = store->append();
+    (*loading_row)[cols.Node] = -1;
+    (*loading_row)[cols.File] = _("Loading the list of files...");
+
+    sigc::slot<void, int, boost::shared_ptr<const files_tree> > k =
+      sigc::mem_fun(*this, &FilesView::files_loaded);
+    load_threads[load_request] =
+      boost::make_shared<cwidget::threads::thread>(load_thread(load_request,
+                                                               fileslistname,
+                                                               make_safe_slot(k)));
+  }
+
+  void FilesView::files_loaded(int request, boost::shared_ptr<const files_tree> result)
+  {
+    // The thread posted this just before exiting, so this won't wait
+    // for long.
+    std::map<int, boost::shared_ptr<cwidget::threads::thread> >::iterator
+      found = load_threads.find(request);
+    if(found != load_threads.end())
+      {
+        found->second->join();
+        load_threads.erase(found);
+      }
+
+    if(request != load_request)
+      return;
 
-    if(fileslist.fail())
+    if(loading_row)
+      {
+        store->erase(loading_row);
+        loading_row = Gtk::TreeModel::iterator();
+      }
+
+    if(result.get() == NULL)
     {
       Gtk::TreeModel::iterator iter = store->append();
       Gtk::TreeModel::Row row = *iter;
+      row[cols.Node] = -1;
       row[cols.File] = _("Files list is only available for installed packages.");
       return;
     }
 
-    std::string filename;
+    files = result;
 
-    while(std::getline(fileslist, filename))
-    {
-      Gtk::TreeModel::iterator iter = store->append();
-      Gtk::TreeModel::Row row = *iter;
-      if (Glib::file_test(filename, Glib::FILE_TEST_IS_DIR))
+    const files_tree::node &root(files->get(files_tree::root));
+    for(std::vector<std::size_t>::const_iterator it = root.children.begin();
+        it != root.children.end(); ++it)
+      append_node(store->children(), *it, "/");
+  }
+
+  void FilesView::append_node(const Gtk::TreeNodeChildren &children,
+                              std::size_t node,
+                              const std::string &prefix)
+  {
+    // Fold directories that only hold one other directory into a
+    // single row.
+    std::string label = prefix + files->get(node).name;
+    while(files->get(node).children.size() == 1 &&
+          files->get(files->get(node).children.front()).is_dir)
       {
-        row[cols.Type] = "d";
+        node = files->get(node).children.front();
+        label += "/" + files->get(node).name;
       }
-      else
+
+    const files_tree::node &n(files->get(node));
+
+    Gtk::TreeModel::iterator iter = store->append(children);
+    Gtk::TreeModel::Row row = *iter;
+    row[cols.Type] = n.is_dir ? "d" : "f";
+    row[cols.File] = label;
+    row[cols.Path] = n.path;
+    row[cols.Node] = node;
+
+    // Give the directory a placeholder, so that it can be expanded;
+    // its real contents are added when it is.
+    if(!n.children.empty())
       {
-        row[cols.Type] = "f";
+        Gtk::TreeModel::iterator placeholder = store->append(row.children());
+        (*placeholder)[cols.Node] = -1;
       }
-      row[cols.File] = filename;
-    }
+  }
+
+  bool FilesView::test_expand_row_handler(const Gtk::TreeModel::iterator &iter,
+                                          const Gtk::TreeModel::Path &path)
+  {
+    if(!files)
+      return false;
+
+    Gtk::TreeModel::Row row = *iter;
+    const int node = row[cols.Node];
+    if(node < 0 || row.children().empty())
+      return false;
+
+    Gtk::TreeModel::iterator first = row.children().begin();
+    const int first_node = (*first)[cols.Node];
+    if(first_node >= 0)
+      return false; // Already filled in.
+
+    store->erase(first);
+
+    const files_tree::node &n(files->get(node));
+    for(std::vector<std::size_t>::const_iterator it = n.children.begin();
+        it != n.children.end(); ++it)
+      append_node(row.children(), *it, "");
+
+    return false;
   }
 
 }
@@ -33,9 +33,21 @@
 #include <generic/util/refcounted_base.h>
 #include <generic/util/temp.h>
 #include <generic/util/util.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <map>
 #include <set>
 using namespace std;
 
+namespace cwidget
+{
+  namespace threads
+  {
+    class thread;
+  }
+}
+
 namespace gui
 {
   enum FilesAction
@@ -47,7 +59,19 @@ namespace gui
   {
     public:
       Gtk::TreeModelColumn<Glib::ustring> Type;
+      /** \brief The name displayed in the row.
+       *
+       *  Chains of directories that contain nothing but one other
+       *  directory are displayed in a single row, so this can be
+       *  several path components.
+       */
       Gtk::TreeModelColumn<Glib::ustring> File;
+      /** \brief The full path of the file. */
+      Gtk::TreeModelColumn<Glib::ustring> Path;
+      /** \brief The node of the file list that the row displays, or
+       *  -1 for rows that don't display a file.
+       */
+      Gtk::TreeModelColumn<int> Node;
 
       FilesColumns();
   };
@@ -61,13 +85,61 @@ namespace gui
       sigc::signal<void> signal_selection;
   };
 
-  class FilesView : public aptitude::util::refcounted_base_threadsafe
+  /** \brief Displays the files of an installed package as a tree.
+   *
+   *  The package's file list is read, and its files are examined, in
+   *  a background thread.  The rows of a directory are only created
+   *  when it is first expanded, so packages with tens of thousands
+   *  of files are displayed as quickly as small ones.
+   */
+  class FilesView : public aptitude::util::refcounted_base_threadsafe,
+                    public sigc::trackable
   {
     private:
-      Glib::RefPtr<Gtk::ListStore> store;
+      Glib::RefPtr<Gtk::TreeStore> store;
       FilesTreeView * tree;
       FilesColumns cols;
 
+      /** \brief The files of a package, arranged as a tree. */
+      class files_tree;
+      class load_thread;
+
+      /** \brief The file list that is displayed, if any. */
+      boost::shared_ptr<const files_tree> files;
+
+      /** \brief The number of the most recent call to
+       *  load_version(); results from earlier calls are dropped.
+       */
+      int load_request;
+
+      /** \brief The threads reading file lists, by request number. */
+      std::map<int, boost::shared_ptr<cwidget::threads::thread> > load_threads;
+
+      /** \brief The row that says the file list is being read. */
+      Gtk::TreeModel::iterator loading_row;
+
+      /** \brief Invoked in the main thread when a file list is read.
+       *
+       *  \param request  The request that was loaded.
+       *  \param result   The files of the package, or an invalid
+       *                  pointer if its file list couldn't be read.
+       */
+      void files_loaded(int request, boost::shared_ptr<const files_tree> result);
+
+      /** \brief Append a row for a node of the file list.
+       *
+       *  \param children  Where to append the row.
+       *  \param node      The node to display.
+       *  \param prefix    Text to put before the node's name.
+       */
+      void append_node(const Gtk::TreeNodeChildren &children,
+                       std::size_t node,
+                       const std::string &prefix);
+
+      /** \brief Fill in the rows of a directory when it is expanded. */
+      bool test_expand_row_handler(const Gtk::TreeModel::iterator &iter,
+                                   const Gtk::TreeModel::Path &path);
+
       void init(Glib::RefPtr<Gnome::Glade::Xml> refGlade,
                 Glib::ustring gladename);
 
@@ -102,6 +174,11 @@ namespace gui
         return new FilesView(treeview);
       }
 
+      /** \brief Start displaying the files of the package that owns
+       *  the given version.
+       *
+       *  The files appear once they have been read in the background.
+       */
       void load_version(pkgCache::VerIterator ver);
 
       /** \brief Construct a new files view.
@@ -113,6 +190,8 @@ namespace gui
       FilesView(Glib::RefPtr<Gnome::Glade::Xml> refGlade,
                                Glib::ustring gladename);
 
+      ~FilesView();
+
 
       FilesTreeView * get_treeview() const { return tree; };
       const FilesColumns * get_columns() const { return &cols; };
@@ -47,6 +47,8 @@
 #include <generic/apt/tags.h>
 
 #include <generic/util/refcounted_wrapper.h>
+#include <generic/util/thunk_dispatcher.h>
+#include <generic/util/timings.h>
 
 #include <sigc++/signal.h>
 
@@ -119,58 +121,24 @@ namespace gui
   {
     // The Glib::dispatch mechanism only allows us to wake the main
     // thread up; it doesn't allow us to pass actual information across
-    // the channel.  To hack this together, I borrow the event_queue
-    // abstraction from cwidget, and use a dispatcher for the sole
-    // purpose of waking the main thread up.
-    //
-    // I believe that putting sigc++ slots on this list should be OK:
-    // from the sigc++ code, it looks like they get passed by value, not
-    // by reference.  Once the slot is safely stuck into the list,
-    // everything should be OK.
-
-    cwidget::threads::mutex background_events_mutex;
-    // Set to "true" if the background events function is currently
-    // executing a thunk, in which case we don't need to invoke the
-    // dispatcher.  This avoids trouble caused by the thunk invoking
-    // post_event() and filling up the queue, so it deadlocks itself.
-    bool run_background_events_active = false;
-    bool background_events_dispatcher_signalled = false;
-    std::deque<safe_slot0<void> > background_events;
+    // the channel.  So the thunks are queued in a thunk_dispatcher, and
+    // the dispatcher is used for the sole purpose of waking the main
+    // thread up, once per batch of thunks.  Since a thunk that posts
+    // another thunk only queues it for the next batch, the pipe behind
+    // the dispatcher can't fill up and deadlock us.
+
     Glib::Dispatcher background_events_dispatcher;
 
-    // Used to ensure that run_background_events_active is true only
-    // while the inner portion of the "while" loop below is running.
-    class set_bool_in_scope
+    void wake_main_loop()
     {
-      bool &target;
+      background_events_dispatcher();
+    }
 
-    public:
-      set_bool_in_scope(bool &_target)
-	: target(_target)
-      {
-	target = true;
-      }
-
-      ~set_bool_in_scope()
-      {
-	target = false;
-      }
-    };
+    aptitude::util::thunk_dispatcher background_events(&wake_main_loop);
 
     void run_background_events()
     {
-      cwidget::threads::mutex::lock l(background_events_mutex);
-      while(!background_events.empty())
-	{
-	  set_bool_in_scope setter(run_background_events_active);
-	  safe_slot0<void> f = background_events.front();
-	  background_events.pop_front();
-
-	  l.release();
-	  f.get_slot()();
-	  l.acquire();
-	}
-      background_events_dispatcher_signalled = false;
+      background_events.run_pending();
     }
   }
 
@@ -184,14 +152,12 @@ namespace gui
 
   void post_event(const safe_slot0<void> &event)
   {
-    // Ensure that the dispatcher is only invoked once.
-    cwidget::threads::mutex::lock l(background_events_mutex);
-    background_events.push_back(event);
-    if(!run_background_events_active && !background_events_dispatcher_signalled)
-      {
-	background_events_dispatcher();
-	background_events_dispatcher_signalled = true;
-      }
+    background_events.post(event);
+  }
+
+  void post_keyed_event(const void *key, const safe_slot0<void> &event)
+  {
+    background_events.post_keyed(key, event);
   }
 
   void post_thunk(const sigc::slot<void> &thunk)
@@ -1745,6 +1711,16 @@ namespace gui
 	apt_init(p.unsafe_get_ref(), true, NULL);
       }
 
+      // For --benchmark-startup, quit as soon as the window has been
+      // drawn with the cache loaded.  Idle handlers at the default
+      // priority only run once GTK+ has finished redrawing.
+      if(aptcfg->FindB(PACKAGE "::Benchmark-Startup", false))
+	{
+	  Glib::signal_idle().connect(sigc::bind_return(sigc::ptr_fun(&do_quit),
+							false));
+	  return;
+	}
+
       if(getuid() == 0 && aptcfg->FindB(PACKAGE "::Update-On-Startup", true))
 	do_update();
     }
@@ -1759,47 +1735,50 @@ namespace gui
     // initialize GTK+ *and report whether the initialization
     // succeeded*.  gtkmm doesn't wrap it.  But initializing GTK+
     // twice won't hurt, so we do that.
-    if(!gtk_init_check(&argc, &argv))
-      return false;
+    {
+      aptitude::util::phase_timer timer("gtk-init");
 
-    Glib::init();
-    // If we don't check thread_supported() first, thread_init()
-    // aborts with an error on some architectures. (see Debian bug
-    // #555120)
-    if(!Glib::thread_supported())
-      Glib::thread_init();
+      if(!gtk_init_check(&argc, &argv))
+	return false;
 
-    background_events_dispatcher.connect(sigc::ptr_fun(&run_background_events));
+      Glib::init();
+      // If we don't check thread_supported() first, thread_init()
+      // aborts with an error on some architectures. (see Debian bug
+      // #555120)
+      if(!Glib::thread_supported())
+	Glib::thread_init();
 
-    pKit = new Gtk::Main(argc, argv);
-    Gtk::Main::signal_quit().connect(&do_want_quit);
-    init_glade(argc, argv);
+      background_events_dispatcher.connect(sigc::ptr_fun(&run_background_events));
 
-    if(!refXml)
-      {
-	_error->Error(_("Unable to load the user interface definition file %s/aptitude.glade."),
-		      PKGDATADIR);
+      pKit = new Gtk::Main(argc, argv);
+      Gtk::Main::signal_quit().connect(&do_want_quit);
+      init_glade(argc, argv);
 
-	delete pKit;
+      if(!refXml)
+	{
+	  _error->Error(_("Unable to load the user interface definition file %s/aptitude.glade."),
+			PKGDATADIR);
 
-	return false;
-      }
+	  delete pKit;
 
-    // Set up the style for GTK+ widgets.
-    init_style();
+	  return false;
+	}
 
-    // Set up the resolver-triggering signals.
-    init_resolver();
+      // Set up the style for GTK+ widgets.
+      init_style();
 
-    // Postpone apt_init until we enter the main loop, so we get a GUI
-    // progress bar.
-    Glib::signal_idle().connect(sigc::bind_return(sigc::ptr_fun(&do_apt_init),
-						  false));
+      // Set up the resolver-triggering signals.
+      init_resolver();
 
-    refXml->get_widget_derived("main_window", pMainWindow);
+      // Postpone apt_init until we enter the main loop, so we get a GUI
+      // progress bar.
+      Glib::signal_idle().connect(sigc::bind_return(sigc::ptr_fun(&do_apt_init),
+						    false));
 
-    pMainWindow->tab_add(new DashboardTab(_("Dashboard")));
+      refXml->get_widget_derived("main_window", pMainWindow);
 
+      pMainWindow->tab_add(new DashboardTab(_("Dashboard")));
+    }
 
     //This is the loop
     Gtk::Main::run(*pMainWindow);
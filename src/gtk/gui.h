@@ -82,6 +82,15 @@ namespace gui
   /** \brief Dispatch the given thunk to the main loop. */
   void post_event(const safe_slot0<void> &thunk);
 
+  /** \brief Dispatch the given thunk to the main loop, dropping any
+   *  thunk posted with the same key that hasn't run yet.
+   *
+   *  Use this for updates where only the latest one matters, such as
+   *  progress reports; the key is usually the address of the object
+   *  whose state is being reported.
+   */
+  void post_keyed_event(const void *key, const safe_slot0<void> &thunk);
+
   /** \brief Wrap the given thunk in a safe_slot and post it to the
    *  main loop.
    */
@@ -34,6 +34,7 @@
 #include <apt-pkg/version.h>
 
 #include <generic/apt/apt.h>
+#include <generic/apt/record_prefetch.h>
 #include <generic/util/undo.h>
 
 #include <solution_fragment.h>
@@ -43,6 +44,10 @@
 #include <gtk/packageinformation.h>
 #include <gtk/screenshot.h>
 
+#include <cwidget/generic/threads/threads.h>
+
+#include <boost/make_shared.hpp>
+
 namespace gui
 {
   namespace
@@ -101,7 +106,7 @@ namespace gui
 
         if(state.Status!=2 && estate.selection_state == pkgCache::State::Hold && !state.NowBroken())
           return std::make_pair(hold_columns, "gray");
-        else if(ver.VerStr() == estate.forbidver)
+        else if(ver.VerStr() == estate.forbidver.get())
           return std::make_pair(forbid_columns, "dim gray");
         else if(state.Delete())
           return (state.iFlags&pkgDepCache::Purge)
@@ -524,8 +529,48 @@ namespace gui
     }
   }
 
+  /** \brief Reads the package records for an InfoTab.
+   *
+   *  The thread uses its own pkgRecords, so it doesn't disturb the
+   *  main thread's, and posts the filled-in information back to the
+   *  main thread when it's done.
+   */
+  class InfoTab::records_thread
+  {
+    int request;
+    PackageInformation info;
+    pkgCache::VerIterator ver;
+    // Invoked in the main thread with the request and the results.
+    safe_slot2<void, int, PackageInformation> k;
+
+  public:
+    records_thread(int _request,
+		   const PackageInformation &_info,
+		   const pkgCache::VerIterator &_ver,
+		   const safe_slot2<void, int, PackageInformation> &_k)
+      : request(_request), info(_info), ver(_ver), k(_k)
+    {
+    }
+
+    void operator()()
+    {
+      pkgRecords records(*apt_cache_file);
+
+      // Read the record and the description in one pass, instead of
+      // seeking back and forth for each field.
+      std::vector<pkgCache::VerIterator> versions;
+      versions.push_back(ver);
+      aptitude::apt::prefetch_version_records(versions, false, true);
+
+      info.load_records(records);
+
+      post_event(safe_bind(k, request, info));
+    }
+  };
+
   InfoTab::InfoTab(const Glib::ustring &label)
-  : Tab(Info, label, Gnome::Glade::Xml::create(glade_main_file, "main_info_hpaned"), "main_info_hpaned")
+  : Tab(Info, label, Gnome::Glade::Xml::create(glade_main_file, "main_info_hpaned"), "main_info_hpaned"),
+    records_request(0)
   {
     get_xml()->get_widget("main_info_textview", textview);
 
@@ -563,6 +608,65 @@ namespace gui
     get_widget()->show();
   }
 
+  InfoTab::~InfoTab()
+  {
+    join_records_threads();
+  }
+
+  void InfoTab::start_loading_records(const PackageInformation &info)
+  {
+    ++records_request;
+
+    sigc::slot<void, int, PackageInformation> k =
+      sigc::mem_fun(*this, &InfoTab::records_loaded);
+    records_threads[records_request] =
+      boost::make_shared<cwidget::threads::thread>(records_thread(records_request,
+								  info,
+								  current_version,
+								  make_safe_slot(k)));
+  }
+
+  void InfoTab::records_loaded(int request, PackageInformation info)
+  {
+    // The thread posted this just before exiting, so this won't
+    // wait for long.
+    std::map<int, boost::shared_ptr<cwidget::threads::thread> >::iterator
+      found = records_threads.find(request);
+    if(found != records_threads.end())
+      {
+	found->second->join();
+	records_threads.erase(found);
+      }
+
+    if(request != records_request || !info_buffer || !records_mark)
+      return;
+
+    info_buffer->erase(info_buffer->get_iter_at_mark(records_mark),
+		       info_buffer->end());
+
+    info_buffer->insert(info_buffer->end(), info.ShortDescription());
+    info_buffer->insert(info_buffer->end(), "\n");
+
+    // TODO: insert a horizontal rule here (how?)
+
+    info_buffer->insert(info_buffer->end(), "\n");
+
+    info_buffer->insert(info_buffer->end(), "\n");
+
+    info_buffer->insert_with_tag(info_buffer->end(), _("Description: "), field_name_tag);
+
+    info_buffer->insert(info_buffer->end(), info.LongDescription());
+  }
+
+  void InfoTab::join_records_threads()
+  {
+    for(std::map<int, boost::shared_ptr<cwidget::threads::thread> >::const_iterator
+	  it = records_threads.begin(); it != records_threads.end(); ++it)
+      it->second->join();
+
+    records_threads.clear();
+  }
+
   void InfoTab::show_selected_version(const Gtk::TreeModel::iterator &iter)
   {
     Gtk::TreeModel::Row r(*iter);
@@ -591,6 +695,11 @@ namespace gui
 
   void InfoTab::do_cache_closed()
   {
+    // The records threads read the cache, so they have to finish
+    // before it goes away.
+    join_records_threads();
+    ++records_request;
+
     // The package and version views will handle themselves; we just need to deal
     // with the TextBuffer that shows the current package's state.
     Glib::RefPtr<Gtk::TextBuffer> reloadingBuffer = Gtk::TextBuffer::create();
@@ -670,6 +779,9 @@ namespace gui
       return;
     }
 
+    // Only the fields that come from the package cache are filled in
+    // here; the rest are read in the background and added to the
+    // end of the buffer when they arrive.
     PackageInformation info(pkg, ver);
 
     Glib::RefPtr<Gtk::TextBuffer::Tag> nameTag = textBuffer->create_tag();
@@ -678,6 +790,9 @@ namespace gui
     Glib::RefPtr<Gtk::TextBuffer::Tag> fieldNameTag = textBuffer->create_tag();
     fieldNameTag->property_weight() = 2 * Pango::SCALE;
 
+    Glib::RefPtr<Gtk::TextBuffer::Tag> loadingTag = textBuffer->create_tag();
+    loadingTag->property_style() = Pango::STYLE_ITALIC;
+
     textBuffer->insert_with_tag(textBuffer->end(),
         info.Name(),
         nameTag);
@@ -700,25 +815,19 @@ namespace gui
 	textBuffer->insert(textBuffer->end(), "\n");
       }
 
-    textBuffer->insert(textBuffer->end(), info.ShortDescription());
-    textBuffer->insert(textBuffer->end(), "\n");
-
-    // TODO: insert a horizontal rule here (how?)
-
-    textBuffer->insert(textBuffer->end(), "\n");
-
-    //pkgRecords::Parser &rec=apt_package_records->Lookup(ver.FileList());
-
-    textBuffer->insert(textBuffer->end(), "\n");
-
-    std::wstring longdesc = get_long_description(ver, apt_package_records);
-
-    textBuffer->insert_with_tag(textBuffer->end(), _("Description: "), fieldNameTag);
-
-    textBuffer->insert(textBuffer->end(), info.LongDescription());
+    // Left gravity, so that the mark stays put when the description
+    // is appended.
+    records_mark = textBuffer->create_mark(textBuffer->end(), true);
+    textBuffer->insert_with_tag(textBuffer->end(),
+				_("Loading description..."),
+				loadingTag);
 
+    info_buffer = textBuffer;
+    field_name_tag = fieldNameTag;
     textview->set_buffer(textBuffer);
 
+    start_loading_records(info);
+
     if(!package_name.empty())
       {
 	screenshot_image *thumbnail =
@@ -32,9 +32,22 @@
 
 #include <cwidget/generic/util/ref_ptr.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+
+namespace cwidget
+{
+  namespace threads
+  {
+    class thread;
+  }
+}
+
 namespace gui
 {
   class EntityView;
+  class PackageInformation;
 
   class InfoTab : public Tab
   {
@@ -56,6 +69,40 @@ namespace gui
 
       pkgCache::VerIterator current_version;
 
+      /** \brief The buffer that describes the current package. */
+      Glib::RefPtr<Gtk::TextBuffer> info_buffer;
+
+      /** \brief Marks the start of the part of info_buffer that is
+       *  filled in once the package records have been read.
+       */
+      Glib::RefPtr<Gtk::TextBuffer::Mark> records_mark;
+
+      /** \brief The tag used for field names in info_buffer. */
+      Glib::RefPtr<Gtk::TextBuffer::Tag> field_name_tag;
+
+      /** \brief Identifies the most recent request to read package
+       *  records; results of older requests are thrown away.
+       */
+      int records_request;
+
+      /** \brief The threads reading package records, by request. */
+      std::map<int, boost::shared_ptr<cwidget::threads::thread> > records_threads;
+
+      class records_thread;
+
+      /** \brief Start reading the package records for info in the
+       *  background.
+       */
+      void start_loading_records(const PackageInformation &info);
+
+      /** \brief Invoked in the main thread when a records thread has
+       *  finished.
+       */
+      void records_loaded(int request, PackageInformation info);
+
+      /** \brief Wait for every records thread to finish. */
+      void join_records_threads();
+
       void do_cache_closed();
       void do_cache_reloaded();
 
@@ -66,6 +113,7 @@ namespace gui
       void selected_version_changed();
     public:
       InfoTab(const Glib::ustring &label);
+      ~InfoTab();
       void disp_package(pkgCache::PkgIterator pkg, pkgCache::VerIterator ver);
 
       /** \brief Convenience function to create and display a new tab
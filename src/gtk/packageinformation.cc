@@ -93,10 +93,9 @@ namespace gui
     }
   }
 
-  PackageInformation::PackageInformation(pkgCache::PkgIterator pkg, pkgCache::VerIterator ver)
+  PackageInformation::PackageInformation(pkgCache::PkgIterator pkg, pkgCache::VerIterator _ver)
+    : ver(_ver), records_loaded(false)
   {
-    pkgRecords::Parser &rec=apt_package_records->Lookup(ver.FileList());
-
     name = pkg.Name();
 
     version = ver.VerStr();
@@ -105,21 +104,28 @@ namespace gui
 
     section = pkg.Section()?pkg.Section():_("Unknown");
 
-    maintainer = rec.Maintainer().c_str();
-
     compressed_size = SizeToStr(ver->Size).c_str();
 
     uncompressed_size = SizeToStr(ver->InstalledSize).c_str();
+  }
 
-    source_package = rec.SourcePkg().empty()?pkg.Name():rec.SourcePkg().c_str();
+  void PackageInformation::load_records(pkgRecords &records)
+  {
+    pkgRecords::Parser &rec=records.Lookup(ver.FileList());
 
-    short_description = cwidget::util::transcode(get_short_description(ver, apt_package_records),
+    maintainer = rec.Maintainer().c_str();
+
+    source_package = rec.SourcePkg().empty()?name:rec.SourcePkg().c_str();
+
+    short_description = cwidget::util::transcode(get_short_description(ver, &records),
 						 "UTF-8");
-    const std::wstring fulldesc = get_long_description(ver, apt_package_records);
+    const std::wstring fulldesc = get_long_description(ver, &records);
 
     std::vector<aptitude::description_element_ref> elements;
 
     aptitude::parse_desc(fulldesc, elements);
     make_desc_text(elements, 0, long_description);
+
+    records_loaded = true;
   }
 }
@@ -26,6 +26,8 @@
 #include <apt-pkg/pkgcache.h>
 #include <generic/apt/desc_parse.h>
 
+class pkgRecords;
+
 namespace gui
 {
   /** \brief A convenience class that collects all the code to extract
@@ -35,6 +37,13 @@ namespace gui
    *  description is only one thing it does.
    *
    *  \todo Is this class really necessary / useful?
+   *
+   *  The fields that come from the package cache are filled in when
+   *  the object is created; the ones that come from the package
+   *  records (the maintainer, the source package and the
+   *  descriptions) are empty until load_records() is invoked.  Since
+   *  reading the records can mean going to disk, load_records() can
+   *  be run in a background thread with its own pkgRecords.
    */
   class PackageInformation
   {
@@ -49,8 +58,22 @@ namespace gui
       std::string source_package;
       std::string short_description;
       std::string long_description;
+
+      pkgCache::VerIterator ver;
+      bool records_loaded;
   public:
       PackageInformation(pkgCache::PkgIterator pkg, pkgCache::VerIterator ver);
+
+      /** \brief Fill in the fields that come from the package records.
+       *
+       *  \param records  The records to read; any pkgRecords object for
+       *                  the cache will do.
+       */
+      void load_records(pkgRecords &records);
+
+      /** \return \b true if load_records() has been invoked. */
+      bool RecordsLoaded() const { return records_loaded; }
+
       std::string Name() const { return name; }
       std::string Version() const { return version; }
       std::string Priority() const { return priority; }
@@ -0,0 +1,373 @@
+// pkglistmodel.cc
+//
+//  Copyright 2011 Daniel Burrows
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; see the file COPYING.  If not, write to
+//  the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//  Boston, MA 02111-1307, USA.
+
+#include "pkglistmodel.h"
+
+#include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+
+#include <gtk/entityview.h>
+#include <gtk/pkgview.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace gui
+{
+  namespace
+  {
+    /** \brief How many rows to keep filled in.
+     *
+     *  This should comfortably exceed the number of rows that fit in
+     *  a package view, so that redrawing a view doesn't evict its own
+     *  rows.
+     */
+    const std::size_t row_cache_size = 512;
+
+    /** \brief Orders package IDs by the names of the packages. */
+    class id_name_lt
+    {
+      pkgCache &cache;
+    public:
+      id_name_lt(pkgCache &_cache)
+	: cache(_cache)
+      {
+      }
+
+      bool operator()(unsigned long id1, unsigned long id2) const
+      {
+	return strcmp(cache.StrP + cache.PkgP[id1].Name,
+		      cache.StrP + cache.PkgP[id2].Name) < 0;
+      }
+    };
+  }
+
+  PkgListModel::PkgListModel(const EntityColumns *_columns,
+			     std::vector<unsigned long> &_ids)
+    : Glib::ObjectBase(typeid(PkgListModel)),
+      Glib::Object(),
+      columns(_columns),
+      stamp(1),
+      cache_store(Gtk::ListStore::create(*_columns)),
+      next_slot(0)
+  {
+    sort_ids(_ids);
+    ids.swap(_ids);
+
+    const std::size_t num_packages = (*apt_cache_file)->Head().PackageCount;
+    rows_by_id.resize(num_packages, -1);
+    for(std::size_t row = 0; row < ids.size(); ++row)
+      rows_by_id[ids[row]] = row;
+
+    slot_by_id.resize(num_packages, -1);
+  }
+
+  Glib::RefPtr<PkgListModel> PkgListModel::create(const EntityColumns *columns,
+						  std::vector<unsigned long> &ids)
+  {
+    return Glib::RefPtr<PkgListModel>(new PkgListModel(columns, ids));
+  }
+
+  Glib::RefPtr<PkgListModel> PkgListModel::find(const Glib::RefPtr<Gtk::TreeModel> &model)
+  {
+    Glib::RefPtr<PkgListModel> rval =
+      Glib::RefPtr<PkgListModel>::cast_dynamic(model);
+    if(rval)
+      return rval;
+
+    Glib::RefPtr<Gtk::TreeModelSort> sorted =
+      Glib::RefPtr<Gtk::TreeModelSort>::cast_dynamic(model);
+    if(sorted)
+      return Glib::RefPtr<PkgListModel>::cast_dynamic(sorted->get_model());
+
+    return rval;
+  }
+
+  void PkgListModel::sort_ids(std::vector<unsigned long> &ids)
+  {
+    std::sort(ids.begin(), ids.end(),
+	      id_name_lt((*apt_cache_file)->GetCache()));
+  }
+
+  pkgCache::PkgIterator PkgListModel::get_package(int row) const
+  {
+    pkgCache &cache((*apt_cache_file)->GetCache());
+    return pkgCache::PkgIterator(cache, cache.PkgP + ids[row]);
+  }
+
+  const Gtk::TreeModel::iterator &PkgListModel::get_cached_row(unsigned long id) const
+  {
+    int slot = slot_by_id[id];
+    if(slot >= 0)
+      return cache_slots[slot];
+
+    if(cache_slots.size() < row_cache_size)
+      {
+	slot = cache_slots.size();
+	cache_slots.push_back(cache_store->append());
+	slot_ids.push_back(-1);
+      }
+    else
+      {
+	// Reuse the slots in turn; the rows on screen are looked up
+	// on every redraw, so they keep getting filled back in.
+	slot = next_slot;
+	next_slot = (next_slot + 1) % cache_slots.size();
+      }
+
+    if(slot_ids[slot] >= 0)
+      slot_by_id[slot_ids[slot]] = -1;
+    slot_ids[slot] = id;
+    slot_by_id[id] = slot;
+
+    Gtk::TreeModel::Row cached_row = *cache_slots[slot];
+    PkgEntity *ent = new PkgEntity(get_package(rows_by_id[id]));
+    ent->fill_row(columns, cached_row);
+
+    return cache_slots[slot];
+  }
+
+  void PkgListModel::add_packages(std::vector<unsigned long> &new_ids)
+  {
+    sort_ids(new_ids);
+
+    // Append the new rows, telling the view about each one as it
+    // appears, so that the model always matches what the view has
+    // been told.
+    const std::size_t old_size = ids.size();
+    for(std::vector<unsigned long>::const_iterator it = new_ids.begin();
+	it != new_ids.end(); ++it)
+      {
+	if(rows_by_id[*it] >= 0)
+	  continue;
+
+	const int row = ids.size();
+	rows_by_id[*it] = row;
+	ids.push_back(*it);
+
+	iterator iter;
+	make_iter(row, iter);
+	Path path;
+	path.push_back(row);
+	row_inserted(path, iter);
+      }
+    new_ids.clear();
+
+    if(ids.size() == old_size || old_size == 0)
+      return;
+
+    // Both halves are sorted, so merging them puts the list back in
+    // order.
+    std::inplace_merge(ids.begin(), ids.begin() + old_size, ids.end(),
+		       id_name_lt((*apt_cache_file)->GetCache()));
+
+    std::vector<int> new_order(ids.size());
+    bool reordered = false;
+    for(std::size_t row = 0; row < ids.size(); ++row)
+      {
+	new_order[row] = rows_by_id[ids[row]];
+	if(new_order[row] != (int)row)
+	  reordered = true;
+	rows_by_id[ids[row]] = row;
+      }
+
+    if(reordered)
+      {
+	// Use the C function so that the iterator of the top level
+	// can be passed as NULL.
+	Path path;
+	gtk_tree_model_rows_reordered(gobj(), path.gobj(), NULL,
+				      &new_order.front());
+      }
+  }
+
+  void PkgListModel::refresh_packages(const std::set<pkgCache::PkgIterator> &packages)
+  {
+    for(std::set<pkgCache::PkgIterator>::const_iterator it = packages.begin();
+	it != packages.end(); ++it)
+      {
+	const unsigned long id = (*it)->ID;
+	if(id >= rows_by_id.size() || rows_by_id[id] < 0)
+	  continue;
+
+	const int slot = slot_by_id[id];
+	if(slot >= 0)
+	  {
+	    slot_ids[slot] = -1;
+	    slot_by_id[id] = -1;
+	  }
+
+	const int row = rows_by_id[id];
+	iterator iter;
+	make_iter(row, iter);
+	Path path;
+	path.push_back(row);
+	row_changed(path, iter);
+      }
+  }
+
+  unsigned long PkgListModel::get_id(const iterator &iter)
+  {
+    return GPOINTER_TO_UINT(iter.gobj()->user_data);
+  }
+
+  void PkgListModel::make_iter(int row, iterator &iter) const
+  {
+    iter.set_stamp(stamp);
+    iter.gobj()->user_data = GUINT_TO_POINTER(ids[row]);
+  }
+
+  Gtk::TreeModelFlags PkgListModel::get_flags_vfunc() const
+  {
+    return Gtk::TREE_MODEL_LIST_ONLY | Gtk::TREE_MODEL_ITERS_PERSIST;
+  }
+
+  int PkgListModel::get_n_columns_vfunc() const
+  {
+    return columns->size();
+  }
+
+  GType PkgListModel::get_column_type_vfunc(int index) const
+  {
+    if(index < 0 || (unsigned int)index >= columns->size())
+      return G_TYPE_INVALID;
+
+    return columns->types()[index];
+  }
+
+  void PkgListModel::get_value_vfunc(const iterator &iter, int column,
+				     Glib::ValueBase &value) const
+  {
+    if(!iter_is_valid(iter))
+      return;
+
+    const unsigned long id = get_id(iter);
+
+    if(column == columns->Name.index())
+      {
+	value.init(G_TYPE_STRING);
+	g_value_set_string(value.gobj(), get_package(rows_by_id[id]).Name());
+	return;
+      }
+
+    const iterator &cached = get_cached_row(id);
+    gtk_tree_model_get_value(GTK_TREE_MODEL(cache_store->gobj()),
+			     const_cast<GtkTreeIter *>(cached.gobj()),
+			     column,
+			     value.gobj());
+  }
+
+  void PkgListModel::set_value_impl(const iterator &row, int column,
+				    const Glib::ValueBase &value)
+  {
+    // The values are computed from the package, so there's nothing
+    // to store.
+  }
+
+  bool PkgListModel::iter_next_vfunc(const iterator &iter,
+				     iterator &iter_next) const
+  {
+    iter_next = iterator();
+
+    if(!iter_is_valid(iter))
+      return false;
+
+    const int next = rows_by_id[get_id(iter)] + 1;
+    if((std::size_t)next >= ids.size())
+      return false;
+
+    make_iter(next, iter_next);
+    return true;
+  }
+
+  bool PkgListModel::iter_children_vfunc(const iterator &parent,
+					 iterator &iter) const
+  {
+    iter = iterator();
+    return false;
+  }
+
+  bool PkgListModel::iter_has_child_vfunc(const iterator &iter) const
+  {
+    return false;
+  }
+
+  int PkgListModel::iter_n_children_vfunc(const iterator &iter) const
+  {
+    return 0;
+  }
+
+  int PkgListModel::iter_n_root_children_vfunc() const
+  {
+    return ids.size();
+  }
+
+  bool PkgListModel::iter_nth_child_vfunc(const iterator &parent, int n,
+					  iterator &iter) const
+  {
+    iter = iterator();
+    return false;
+  }
+
+  bool PkgListModel::iter_nth_root_child_vfunc(int n, iterator &iter) const
+  {
+    iter = iterator();
+
+    if(n < 0 || (std::size_t)n >= ids.size())
+      return false;
+
+    make_iter(n, iter);
+    return true;
+  }
+
+  bool PkgListModel::iter_parent_vfunc(const iterator &child,
+				       iterator &iter) const
+  {
+    iter = iterator();
+    return false;
+  }
+
+  Gtk::TreeModel::Path PkgListModel::get_path_vfunc(const iterator &iter) const
+  {
+    Path rval;
+    if(iter_is_valid(iter))
+      rval.push_back(rows_by_id[get_id(iter)]);
+    return rval;
+  }
+
+  bool PkgListModel::get_iter_vfunc(const Path &path, iterator &iter) const
+  {
+    iter = iterator();
+
+    if(path.size() != 1)
+      return false;
+
+    return iter_nth_root_child_vfunc(path[0], iter);
+  }
+
+  bool PkgListModel::iter_is_valid(const iterator &iter) const
+  {
+    if(iter.get_stamp() != stamp)
+      return false;
+
+    const unsigned long id = get_id(iter);
+    return id < rows_by_id.size() && rows_by_id[id] >= 0;
+  }
+}
@@ -0,0 +1,176 @@
+// -*-c++-*-
+
+// pkglistmodel.h
+//
+//  Copyright 2011 Daniel Burrows
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; see the file COPYING.  If not, write to
+//  the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//  Boston, MA 02111-1307, USA.
+
+#ifndef PKGLISTMODEL_H_
+#define PKGLISTMODEL_H_
+
+#undef OK
+#include <gtkmm.h>
+
+#include <apt-pkg/pkgcache.h>
+
+#include <set>
+#include <vector>
+
+namespace gui
+{
+  class EntityColumns;
+
+  /** \brief A flat list of packages, sorted by name, whose rows are
+   *  computed when they are displayed.
+   *
+   *  The list itself is just a vector of package IDs.  The first time
+   *  a row's contents are requested, a PkgEntity is created for it
+   *  and its columns are filled in, and the result is kept in a small
+   *  cache of recently viewed rows; so building the list for every
+   *  package in the cache only costs as much as the rows that are
+   *  actually looked at.
+   *
+   *  The "name" column is read straight from the package cache
+   *  rather than through the row cache, so sorting on it is cheap.
+   *  Writing to a row has no effect: the values always reflect the
+   *  current state of the package.  When packages change, call
+   *  refresh_packages() to drop their cached rows.
+   *
+   *  Packages can be added to a list that is already displayed with
+   *  add_packages(), so that search results can be shown as they
+   *  arrive.  Iterators refer to packages rather than positions, so
+   *  they stay valid when rows are added.
+   *
+   *  The model is not sortable itself; wrap it in a
+   *  Gtk::TreeModelSort to let the user sort it on other columns.
+   */
+  class PkgListModel : public Glib::Object, public Gtk::TreeModel
+  {
+    const EntityColumns *columns;
+
+    /** \brief The IDs of the packages in this list, sorted by
+     *  package name.
+     */
+    std::vector<unsigned long> ids;
+
+    /** \brief The row of each package, indexed by package ID, or -1
+     *  if the package isn't in the list.
+     */
+    std::vector<int> rows_by_id;
+
+    /** \brief Identifies iterators that belong to this model. */
+    int stamp;
+
+    /** \brief Holds the cached rows. */
+    Glib::RefPtr<Gtk::ListStore> cache_store;
+
+    /** \brief The rows of cache_store, one per cache slot.
+     *
+     *  Slots are allocated as they are first needed.
+     */
+    mutable std::vector<Gtk::TreeModel::iterator> cache_slots;
+
+    /** \brief The ID of the package held in each cache slot, or -1. */
+    mutable std::vector<long> slot_ids;
+
+    /** \brief The cache slot of each package, indexed by package ID,
+     *  or -1.
+     */
+    mutable std::vector<int> slot_by_id;
+
+    /** \brief The next cache slot to reuse. */
+    mutable std::size_t next_slot;
+
+    /** \brief Get the cached contents of a package's row, filling
+     *  them in if necessary.
+     */
+    const Gtk::TreeModel::iterator &get_cached_row(unsigned long id) const;
+
+    /** \brief Get the ID of the package that an iterator points to. */
+    static unsigned long get_id(const iterator &iter);
+
+    /** \brief Make iter point at the given row. */
+    void make_iter(int row, iterator &iter) const;
+
+    /** \brief Sort package IDs by the names of the packages. */
+    static void sort_ids(std::vector<unsigned long> &ids);
+
+  protected:
+    PkgListModel(const EntityColumns *_columns,
+		 std::vector<unsigned long> &_ids);
+
+    Gtk::TreeModelFlags get_flags_vfunc() const;
+    int get_n_columns_vfunc() const;
+    GType get_column_type_vfunc(int index) const;
+    void get_value_vfunc(const iterator &iter, int column,
+			 Glib::ValueBase &value) const;
+    void set_value_impl(const iterator &row, int column,
+			const Glib::ValueBase &value);
+
+    bool iter_next_vfunc(const iterator &iter, iterator &iter_next) const;
+    bool iter_children_vfunc(const iterator &parent, iterator &iter) const;
+    bool iter_has_child_vfunc(const iterator &iter) const;
+    int iter_n_children_vfunc(const iterator &iter) const;
+    int iter_n_root_children_vfunc() const;
+    bool iter_nth_child_vfunc(const iterator &parent, int n,
+			      iterator &iter) const;
+    bool iter_nth_root_child_vfunc(int n, iterator &iter) const;
+    bool iter_parent_vfunc(const iterator &child, iterator &iter) const;
+    Path get_path_vfunc(const iterator &iter) const;
+    bool get_iter_vfunc(const Path &path, iterator &iter) const;
+    bool iter_is_valid(const iterator &iter) const;
+
+  public:
+    /** \brief Create a list of packages.
+     *
+     *  \param columns  The columns of the view the list is displayed
+     *                  in; used to fill in rows.
+     *  \param ids      The IDs of the packages to display, in any
+     *                  order.  The vector is emptied.
+     */
+    static Glib::RefPtr<PkgListModel> create(const EntityColumns *columns,
+					     std::vector<unsigned long> &ids);
+
+    /** \brief Find the package list behind a model.
+     *
+     *  \return model itself if it is a PkgListModel, the model that
+     *  it sorts if it is a Gtk::TreeModelSort of a PkgListModel, and
+     *  an invalid pointer otherwise.
+     */
+    static Glib::RefPtr<PkgListModel> find(const Glib::RefPtr<Gtk::TreeModel> &model);
+
+    /** \brief Get the package displayed in a row. */
+    pkgCache::PkgIterator get_package(int row) const;
+
+    /** \brief Add packages to the list.
+     *
+     *  The new rows are appended and then merged into place; the view
+     *  is told about each new row and then about the new order.
+     *  Packages that are already in the list are skipped.
+     *
+     *  \param new_ids  The IDs of the packages to add, in any order.
+     */
+    void add_packages(std::vector<unsigned long> &new_ids);
+
+    /** \brief Discard the cached rows of the given packages and
+     *  tell the view that they changed.
+     */
+    void refresh_packages(const std::set<pkgCache::PkgIterator> &packages);
+  };
+}
+
+#endif /* PKGLISTMODEL_H_ */
@@ -34,16 +34,20 @@
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
+#include <generic/util/progress_info.h>
 
 #include <solution_fragment.h>
 
 #include <gtk/gui.h>
 #include <gtk/info.h>
+#include <gtk/pkglistmodel.h>
 #include <gtk/progress.h>
 
 #include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/generic/util/transcode.h>
 
+#include <algorithm>
+
 using aptitude::Loggers;
 
 namespace gui
@@ -94,7 +98,7 @@ namespace gui
             == pkgCache::State::Hold && !state.InstBroken())
       return hold_columns;
     else if(state.Upgradable() && !pkg.CurrentVer().end() && !candver.end()
-        && candver.VerStr() == estate.forbidver)
+        && candver.VerStr() == estate.forbidver.get())
       return forbid_columns;
     else if(state.Delete())
       return ((state.iFlags & pkgDepCache::Purge) ? purge_columns : remove_columns);
@@ -129,7 +133,7 @@ namespace gui
             == pkgCache::State::Hold && !state.InstBroken())
       return "#FFCCCC";
     if (state.Upgradable() && !pkg.CurrentVer().end() && !candver.end()
-        && candver.VerStr() == estate.forbidver)
+        && candver.VerStr() == estate.forbidver.get())
       // FIXME: does this really deserve its own color?
       return "dark red";
     if (state.Delete())
@@ -365,6 +369,11 @@ namespace gui
   {
   }
 
+  bool PkgTreeModelGenerator::take_added_packages(std::vector<unsigned long> &out)
+  {
+    return false;
+  }
+
   PkgViewBase::PkgViewBase(const sigc::slot1<PkgTreeModelGenerator *, const EntityColumns *> _generatorK,
 			   const Glib::RefPtr<Gnome::Glade::Xml> &refGlade,
 			   const Glib::ustring &gladename,
@@ -383,6 +392,7 @@ namespace gui
     get_archive_column()->set_visible(false);
 
     background_builder.store_rebuilt.connect(sigc::mem_fun(*this, &PkgViewBase::store_rebuilt));
+    background_builder.store_partially_rebuilt.connect(sigc::mem_fun(*this, &PkgViewBase::store_partially_rebuilt));
   }
 
   PkgViewBase::~PkgViewBase()
@@ -402,6 +412,20 @@ namespace gui
     set_model(store);
   }
 
+  namespace
+  {
+    /** \brief The number of search results in the first batch sent
+     *  to the main thread.
+     *
+     *  Each batch after that is twice the size of the one before, up
+     *  to max_result_batch, so that the first results show up quickly
+     *  but the main thread isn't woken up for every handful of
+     *  packages in a big search.
+     */
+    const int min_result_batch = 64;
+    const int max_result_batch = 4096;
+  }
+
   // Bootstrap class for the build thread.
   class PkgViewBase::background_build_store::build_thread
   {
@@ -414,6 +438,17 @@ namespace gui
     cwidget::util::ref_ptr<cancel_flag> canceled;
     // The build's continuation; will be invoked in the main thread.
     safe_slot1<void, Glib::RefPtr<Gtk::TreeModel> > k;
+    // Invoked in the main thread with each batch of search results.
+    safe_slot1<void, std::vector<unsigned long> > batch_k;
+
+    // How many results have been found since the last batch was
+    // sent, and how many to wait for before sending the next one.
+    int batch_count;
+    int batch_limit;
+    // Set to false if the generator can't hand over partial results.
+    bool can_send_batches;
+    // Set to true once any batch has been sent.
+    bool sent_batches;
 
 
     // TODO: I really should just have a threadsafe OpProgress that
@@ -473,6 +508,7 @@ namespace gui
 		 const cwidget::util::ref_ptr<aptitude::matching::pattern> &_limit,
 		 const cwidget::util::ref_ptr<cancel_flag> &_canceled,
 		 const safe_slot1<void, Glib::RefPtr<Gtk::TreeModel> > &_k,
+		 const safe_slot1<void, std::vector<unsigned long> > &_batch_k,
 		 const safe_slot2<void, int, int> &_progress_callback,
 		 const safe_slot1<void, cwidget::threads::thread *> &_done_callback,
 		 cwidget::threads::box<cwidget::threads::thread *> &_thread_box,
@@ -482,6 +518,11 @@ namespace gui
 	limit(_limit),
 	canceled(_canceled),
 	k(_k),
+	batch_k(_batch_k),
+	batch_count(0),
+	batch_limit(min_result_batch),
+	can_send_batches(true),
+	sent_batches(false),
 	progress_callback(_progress_callback),
 	done_callback(_done_callback),
 	thread_box(_thread_box),
@@ -489,9 +530,75 @@ namespace gui
     {
     }
 
+    // Adds a batch of search results to the view; returns false to
+    // stop the search if the build was canceled.
+    bool add_matches(const aptitude::matching::search_result_batch &batch,
+		     PkgTreeModelGenerator *generator,
+		     int &num);
+
+    // Sends the results found since the last batch to the main
+    // thread, if the generator supports it.
+    void send_batch(PkgTreeModelGenerator *generator);
+
+    // Forwards the search's progress to the progress callback.
+    void search_progress(const aptitude::util::progress_info &info);
+
     void operator()();
   };
 
+  bool PkgViewBase::background_build_store::build_thread::add_matches(const aptitude::matching::search_result_batch &batch,
+								      PkgTreeModelGenerator *generator,
+								      int &num)
+  {
+    for(aptitude::matching::search_result_batch::const_iterator
+	  it = batch.begin(); it != batch.end(); ++it)
+      {
+	if(canceled->is_canceled())
+	  return false;
+
+	++num;
+	++batch_count;
+	generator->add(it->first);
+      }
+
+    if(batch_count >= batch_limit)
+      send_batch(generator);
+
+    return true;
+  }
+
+  void PkgViewBase::background_build_store::build_thread::send_batch(PkgTreeModelGenerator *generator)
+  {
+    if(!can_send_batches)
+      return;
+
+    std::vector<unsigned long> batch;
+    if(!generator->take_added_packages(batch))
+      {
+	can_send_batches = false;
+	return;
+      }
+
+    batch_count = 0;
+    batch_limit = std::min(2 * batch_limit, max_result_batch);
+
+    if(!batch.empty())
+      {
+	post_event(safe_bind(batch_k, batch));
+	sent_batches = true;
+      }
+  }
+
+  void PkgViewBase::background_build_store::build_thread::search_progress(const aptitude::util::progress_info &info)
+  {
+    // The total is only known once the search is over, so report
+    // how far through the package cache the search has got.
+    if(info.get_type() == aptitude::util::progress_type_bar)
+      post_keyed_event(this,
+		       safe_bind(progress_callback,
+				 info.get_progress_percent_int(), 100));
+  }
+
   void PkgViewBase::background_build_store::build_thread::operator()()
   {
     using namespace aptitude::matching;
@@ -514,28 +621,31 @@ namespace gui
 
     bool limited = limit.valid();
 
-    std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > matches;
     ref_ptr<search_cache> search_info(search_cache::create());
     if(limited)
       {
-	search(limit, search_info, matches, *apt_cache_file, *apt_package_records);
-
+	// Add the matches as they are found, so that the view isn't
+	// held up by the slowest part of the search.
 	int num = 0;
-	const int total = static_cast<int>(matches.size());
+	if(!search_incremental(limit, search_info,
+			       sigc::bind(sigc::mem_fun(*this, &build_thread::add_matches),
+					  generator.get(), sigc::ref(num)),
+			       *apt_cache_file, *apt_package_records,
+			       64, false,
+			       sigc::mem_fun(*this, &build_thread::search_progress)))
+	  return;
 
-	for(std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > >::const_iterator
-	      it = matches.begin(); it != matches.end(); ++it)
-	  {
-	    if(canceled->is_canceled())
-	      return;
-
-	    post_event(safe_bind(progress_callback, num, total));
+	post_event(safe_bind(progress_callback, num, num));
 
-	    ++num;
-	    generator->add(it->first);
+	if(sent_batches)
+	  {
+	    // The main thread already has a model holding the earlier
+	    // results; send it the rest and tell it that we're done.
+	    send_batch(generator.get());
+	    generator.reset();
+	    post_event(safe_bind(k, Glib::RefPtr<Gtk::TreeModel>()));
+	    return;
 	  }
-
-	post_event(safe_bind(progress_callback, total, total));
       }
     else
       {
@@ -578,7 +688,8 @@ namespace gui
 
   PkgViewBase::background_build_store::background_build_store(const sigc::slot<cwidget::util::ref_ptr<refcounted_progress> > &_builder_progress_k)
     : builder(NULL),
-      builder_progress_k(_builder_progress_k)
+      builder_progress_k(_builder_progress_k),
+      builder_columns(NULL)
   {
   }
 
@@ -614,6 +725,11 @@ namespace gui
       sigc::mem_fun(*this, &background_build_store::rebuild_store_finished);
     builder_callback = make_safe_slot(k);
 
+    sigc::slot<void, std::vector<unsigned long> > batch_k =
+      sigc::mem_fun(*this, &background_build_store::rebuild_store_batch);
+    builder_batch_callback = make_safe_slot(batch_k);
+    builder_columns = columns;
+
     sigc::slot<void, int, int> progress_callback =
       sigc::mem_fun(*this, &background_build_store::progress);
     builder_progress_callback = make_safe_slot(progress_callback);
@@ -634,6 +750,7 @@ namespace gui
 							limit,
 							builder_cancel,
 							builder_callback,
+							builder_batch_callback,
 							builder_progress_callback,
 							thread_stopped_safe_slot,
 							thread_box,
@@ -659,10 +776,13 @@ namespace gui
       builder_cancel->cancel();
 
     builder_callback.disconnect();
+    builder_batch_callback.disconnect();
     builder_progress_callback.disconnect();
     builder_cancel = cwidget::util::ref_ptr<cancel_flag>();
     builder_progress = cwidget::util::ref_ptr<guiOpProgress>();
     pulse_connection.disconnect();
+    partial_model.reset();
+    partial_store.reset();
     builder = NULL;
   }
 
@@ -734,10 +854,31 @@ namespace gui
     logging::LoggerPtr logger(Loggers::getAptitudeGtkPkgView());
     LOG_TRACE(logger, "The package view store was successfully rebuilt.");
 
+    // If the results were sent in batches, the thread doesn't send a
+    // model; the one built from the batches is complete now.
+    if(!model)
+      model = partial_store;
+
     // Clear out the background thread's structures and signal
     // connections.
     cancel();
-    store_rebuilt(model);
+    if(model)
+      store_rebuilt(model);
+  }
+
+  void PkgViewBase::background_build_store::rebuild_store_batch(std::vector<unsigned long> batch)
+  {
+    logging::LoggerPtr logger(Loggers::getAptitudeGtkPkgView());
+    LOG_TRACE(logger, "Adding " << batch.size() << " packages to the package view store.");
+
+    if(partial_model)
+      partial_model->add_packages(batch);
+    else
+      {
+	partial_model = PkgListModel::create(builder_columns, batch);
+	partial_store = Gtk::TreeModelSort::create(partial_model);
+	store_partially_rebuilt(partial_store);
+      }
   }
 
   bool PkgViewBase::background_build_store::pulse_progress()
@@ -767,6 +908,11 @@ namespace gui
     store_reloaded();
   }
 
+  void PkgViewBase::store_partially_rebuilt(const Glib::RefPtr<Gtk::TreeModel> &model)
+  {
+    set_model(model);
+  }
+
   void PkgViewBase::set_limit(const cwidget::util::ref_ptr<aptitude::matching::pattern> &_limit)
   {
     limit = _limit;
@@ -776,7 +922,6 @@ namespace gui
   PkgView::Generator::Generator(const EntityColumns *_columns)
     : columns(_columns)
   {
-    store = Gtk::ListStore::create(*columns);
   }
 
   PkgView::Generator *PkgView::Generator::create(const EntityColumns *columns)
@@ -786,22 +931,28 @@ namespace gui
 
   void PkgView::Generator::add(const pkgCache::PkgIterator &pkg)
   {
-    Gtk::TreeModel::iterator iter = store->append();
-    Gtk::TreeModel::Row row = *iter;
-    PkgEntity *ent = new PkgEntity(pkg);
-    ent->fill_row(columns, row);
+    ids.push_back(pkg->ID);
   }
 
   void PkgView::Generator::finish()
   {
-    store->set_sort_column(columns->Name, Gtk::SORT_ASCENDING);
+    // The list sorts the packages by name; the sort model only comes
+    // into play when the user picks a column to sort on.
+    model = Gtk::TreeModelSort::create(PkgListModel::create(columns, ids));
     // FIXME: Hack while finding a nonblocking thread join.
     finished = true;
   }
 
   Glib::RefPtr<Gtk::TreeModel> PkgView::Generator::get_model()
   {
-    return store;
+    return model;
+  }
+
+  bool PkgView::Generator::take_added_packages(std::vector<unsigned long> &out)
+  {
+    out.swap(ids);
+    ids.clear();
+    return true;
   }
 
   PkgView::PkgView(const Glib::RefPtr<Gnome::Glade::Xml> &refGlade,
@@ -125,6 +125,21 @@ namespace gui
      *  \return  The model built by this generator.
      */
     virtual Glib::RefPtr<Gtk::TreeModel> get_model() = 0;
+
+    /** \brief Hand over the packages added since the last call, so
+     *  that they can be displayed before the build is finished.
+     *
+     *  Generators that can't display a partial list should return
+     *  \b false, which is the default.  Once any packages have been
+     *  taken, finish() and get_model() are not invoked; the packages
+     *  that were taken are all that the view will show.
+     *
+     *  \param out  A vector in which to store the IDs of the packages
+     *               added since the last call.
+     *
+     *  \return \b true if the packages were handed over.
+     */
+    virtual bool take_added_packages(std::vector<unsigned long> &out);
   };
 
   /** \brief Base class for views that display a subset of the packages
@@ -189,6 +204,11 @@ namespace gui
        */
       safe_slot1<void, Glib::RefPtr<Gtk::TreeModel> > builder_callback;
 
+      /** \brief Like builder_callback, but for the batches of packages
+       *  found so far.
+       */
+      safe_slot1<void, std::vector<unsigned long> > builder_batch_callback;
+
       /** \brief Like builder_callback, but for the current progress. */
       safe_slot2<void, int, int> builder_progress_callback;
 
@@ -233,6 +253,17 @@ namespace gui
        */
       cwidget::util::ref_ptr<refcounted_progress> builder_progress;
 
+      /** \brief The columns of the view being built. */
+      const EntityColumns *builder_columns;
+
+      /** \brief The list of packages found so far by the current
+       *  builder, if it has sent any.
+       */
+      Glib::RefPtr<PkgListModel> partial_model;
+
+      /** \brief The model that displays partial_model. */
+      Glib::RefPtr<Gtk::TreeModel> partial_store;
+
       /** \brief The connection that pulses the main progress bar, if
        *  any.
        */
@@ -249,6 +280,14 @@ namespace gui
        */
       void rebuild_store_finished(Glib::RefPtr<Gtk::TreeModel> model);
 
+      /** \brief Invoked in the main thread with each batch of packages
+       *  that the build thread finds.
+       *
+       *  The first batch creates a list, which is passed to
+       *  store_partially_rebuilt; later batches are merged into it.
+       */
+      void rebuild_store_batch(std::vector<unsigned long> batch);
+
     public:
       background_build_store(const sigc::slot<cwidget::util::ref_ptr<refcounted_progress> > &_builder_progress_k);
       ~background_build_store();
@@ -280,6 +319,14 @@ namespace gui
       /** \brief Signal indicating that the store has been rebuilt.
        */
       sigc::signal<void, Glib::RefPtr<Gtk::TreeModel> > store_rebuilt;
+
+      /** \brief Signal indicating that the first results of the
+       *  rebuild are available.
+       *
+       *  The model will grow as more results arrive; store_rebuilt is
+       *  emitted with the same model once it is complete.
+       */
+      sigc::signal<void, Glib::RefPtr<Gtk::TreeModel> > store_partially_rebuilt;
     };
 
     /** \brief Invoked when the background builder is finished
@@ -290,6 +337,12 @@ namespace gui
      */
     void store_rebuilt(const Glib::RefPtr<Gtk::TreeModel> &model);
 
+    /** \brief Invoked when the background builder has the first
+     *  results of a rebuild; displays them without signaling that the
+     *  store was reloaded.
+     */
+    void store_partially_rebuilt(const Glib::RefPtr<Gtk::TreeModel> &model);
+
     background_build_store background_builder;
 
   public:
@@ -320,16 +373,25 @@ namespace gui
 
     /** \brief Change this view's limit to the given pattern. */
     void set_limit(const cwidget::util::ref_ptr<aptitude::matching::pattern> &limit);
+
+    /** \brief Retrieve the pattern that selects which packages are
+     *  displayed; an invalid pattern displays every package.
+     */
+    const cwidget::util::ref_ptr<aptitude::matching::pattern> &get_limit() const { return limit; }
   };
 
   /** \brief A view that displays an unorganized list of packages. */
   class PkgView : public PkgViewBase
   {
   public:
+    /** \brief Builds a PkgListModel of the packages, sorted by
+     *  name, so that rows are only filled in when they're displayed.
+     */
     class Generator : public PkgTreeModelGenerator
     {
-      Glib::RefPtr<Gtk::ListStore> store;
-      // We need this to set up the sorting at the end.
+      /** \brief The IDs of the packages added so far. */
+      std::vector<unsigned long> ids;
+      Glib::RefPtr<Gtk::TreeModel> model;
       const EntityColumns *columns;
     public:
       Generator(const EntityColumns *columns);
@@ -338,6 +400,7 @@ namespace gui
       void add(const pkgCache::PkgIterator &pkg);
       void finish();
       Glib::RefPtr<Gtk::TreeModel> get_model();
+      bool take_added_packages(std::vector<unsigned long> &out);
     };
 
     /** \brief Create a new PkgView.
@@ -20,12 +20,10 @@
 
 #include "post_event.h"
 
-#include <cwidget/generic/threads/threads.h>
+#include <generic/util/thunk_dispatcher.h>
 
 #include <glibmm/dispatcher.h>
 
-#include <deque>
-
 namespace gui
 {
   namespace globals
@@ -36,73 +34,32 @@ namespace gui
 
       // The Glib::dispatch mechanism only allows us to wake the main
       // thread up; it doesn't allow us to pass actual information
-      // across the channel.  To hack this together, I borrow the
-      // event_queue abstraction from cwidget, and use a dispatcher
-      // for the sole purpose of waking the main thread up.
-      //
-      // I believe that putting sigc++ slots on this list should be
-      // OK: from the sigc++ code, it looks like they get passed by
-      // value, not by reference.  Once the slot is safely stuck into
-      // the list, everything should be OK.
+      // across the channel.  So the thunks are queued in a
+      // thunk_dispatcher and the dispatcher is used for the sole
+      // purpose of waking the main thread up, once per batch of
+      // thunks.  Since a thunk that posts another thunk only queues
+      // it for the next batch, the pipe behind the dispatcher can't
+      // fill up and deadlock us.
 
-      cwidget::threads::mutex background_events_mutex;
-      // Set to "true" if the background events function is currently
-      // executing a thunk, in which case we don't need to invoke the
-      // dispatcher.  This avoids trouble caused by the thunk invoking
-      // post_event() and filling up the queue, so it deadlocks
-      // itself.
-      bool run_background_events_active = false;
-      bool background_events_dispatcher_signalled = false;
-      std::deque<safe_slot0<void> > background_events;
       Glib::Dispatcher background_events_dispatcher;
 
-      // Used to ensure that run_background_events_active is true only
-      // while the inner portion of the "while" loop below is running.
-      class set_bool_in_scope
+      void wake_main_loop()
       {
-        bool &target;
-
-      public:
-        set_bool_in_scope(bool &_target)
-          : target(_target)
-        {
-          target = true;
-        }
+        background_events_dispatcher();
+      }
 
-        ~set_bool_in_scope()
-        {
-          target = false;
-        }
-      };
+      aptitude::util::thunk_dispatcher background_events(&wake_main_loop);
 
       void run_background_events()
       {
-        cwidget::threads::mutex::lock l(background_events_mutex);
-        while(!background_events.empty())
-          {
-            set_bool_in_scope setter(run_background_events_active);
-            safe_slot0<void> f = background_events.front();
-            background_events.pop_front();
-
-            l.release();
-            f.get_slot()();
-            l.acquire();
-          }
-        background_events_dispatcher_signalled = false;
+        background_events.run_pending();
       }
     }
 
     // Interface routines to the background event code.
     void post_event(const safe_slot0<void> &event)
     {
-      // Ensure that the dispatcher is only invoked once.
-      cwidget::threads::mutex::lock l(background_events_mutex);
-      background_events.push_back(event);
-      if(!run_background_events_active && !background_events_dispatcher_signalled)
-        {
-          background_events_dispatcher();
-          background_events_dispatcher_signalled = true;
-        }
+      background_events.post(event);
     }
 
     void post_thunk(const sigc::slot<void> &thunk)
@@ -26,6 +26,8 @@
 
 #include <apt-pkg/strutl.h>
 
+#include <generic/apt/pkg_changelog.h>
+#include <generic/apt/matching/match.h>
 #include <generic/util/util.h>
 
 #include <gtk/hyperlink.h>
@@ -63,7 +65,7 @@ namespace gui
 	  {
 	    tree = store->append();
 	    Gtk::TreeModel::Row tree_row = *tree;
-	    (new HeaderEntity(_(child_names[group])))->fill_row(entity_columns, tree_row);
+	    (new HeaderEntity(get_group_name(group)))->fill_row(entity_columns, tree_row);
 	    state_trees[group] = tree;
 	  }
 	else
@@ -89,6 +91,11 @@ namespace gui
     return store;
   }
 
+  Glib::ustring PreviewView::Generator::get_group_name(int group)
+  {
+    return _(child_names[group]);
+  }
+
 
   // \todo This is proof-of-concept only; the child_names list should
   // be in common code.
@@ -119,6 +126,103 @@ namespace gui
 		  limit,
 		  build_progress_k)
   {
+    connect_package_states_changed();
+    cache_closed.connect(sigc::mem_fun(*this, &PreviewView::discard_changed_packages));
+    cache_reloaded.connect(sigc::mem_fun(*this, &PreviewView::connect_package_states_changed));
+  }
+
+  void PreviewView::connect_package_states_changed()
+  {
+    if(apt_cache_file != NULL)
+      (*apt_cache_file)->package_states_changed.connect(sigc::mem_fun(*this, &PreviewView::package_states_changed));
+  }
+
+  void PreviewView::package_states_changed(const std::set<pkgCache::PkgIterator> *changed)
+  {
+    changed_packages.insert(changed->begin(), changed->end());
+
+    // A large solution changes the states in several steps; update
+    // the view once, after all of them.
+    if(!update_connection.connected())
+      update_connection = Glib::signal_idle().connect(sigc::mem_fun(*this, &PreviewView::update_changed_packages));
+  }
+
+  void PreviewView::discard_changed_packages()
+  {
+    update_connection.disconnect();
+    changed_packages.clear();
+  }
+
+  bool PreviewView::update_changed_packages()
+  {
+    using cwidget::util::ref_ptr;
+    using namespace aptitude::matching;
+
+    std::set<pkgCache::PkgIterator> changed;
+    changed.swap(changed_packages);
+
+    // If the view isn't displaying a preview (for instance, because
+    // the cache is being reloaded), the next rebuild will pick up
+    // the new states.
+    Glib::RefPtr<Gtk::TreeStore> store =
+      Glib::RefPtr<Gtk::TreeStore>::cast_dynamic(get_model());
+    if(!store || apt_cache_file == NULL)
+      return false;
+
+    const EntityColumns *cols = get_columns();
+    std::multimap<pkgCache::PkgIterator, Gtk::TreeModel::iterator> &revstore = *get_reverse_store();
+    const ref_ptr<pattern> &limit = get_limit();
+    const ref_ptr<search_cache> search_info(search_cache::create());
+
+    for(std::set<pkgCache::PkgIterator>::const_iterator it = changed.begin();
+	it != changed.end(); ++it)
+      {
+	// Take the package out of the tree it was in, and drop the
+	// tree if it's now empty.
+	typedef std::multimap<pkgCache::PkgIterator, Gtk::TreeModel::iterator>::iterator revstore_iterator;
+	const std::pair<revstore_iterator, revstore_iterator> rows = revstore.equal_range(*it);
+	for(revstore_iterator row_it = rows.first; row_it != rows.second; ++row_it)
+	  {
+	    const Gtk::TreeModel::iterator parent = row_it->second->parent();
+	    store->erase(row_it->second);
+	    if(parent && parent->children().empty())
+	      store->erase(parent);
+	  }
+	revstore.erase(rows.first, rows.second);
+
+	const int group = find_pkg_state(*it, *apt_cache_file);
+	if(group == pkg_unchanged)
+	  continue;
+
+	if(limit.valid() &&
+	   !has_match(limit, *it, search_info, *apt_cache_file, *apt_package_records))
+	  continue;
+
+	// There are only a dozen trees, so just look for the right one.
+	const Glib::ustring group_name = Generator::get_group_name(group);
+	Gtk::TreeModel::iterator tree = store->children().begin();
+	while(tree != store->children().end() &&
+	      Glib::ustring((*tree)[cols->Name]) != group_name)
+	  ++tree;
+
+	const bool new_tree = (tree == store->children().end());
+	if(new_tree)
+	  {
+	    tree = store->append();
+	    Gtk::TreeModel::Row tree_row = *tree;
+	    (new HeaderEntity(group_name))->fill_row(cols, tree_row);
+	  }
+
+	Gtk::TreeModel::iterator iter = store->append(tree->children());
+	Gtk::TreeModel::Row row = *iter;
+	(new PkgEntity(*it))->fill_row(cols, row);
+	revstore.insert(std::make_pair(*it, iter));
+
+	if(new_tree)
+	  get_treeview()->expand_row(store->get_path(tree), false);
+      }
+
+    return false;
   }
 
   PreviewTab::PreviewTab(const Glib::ustring &label) :
@@ -152,6 +256,7 @@ namespace gui
 
     get_widget()->show();
 
+    aptitude::apt::prefetch_upgrade_changelogs(&post_thunk);
   }
 
   // TODO: Should be moved into PackagesView for use with PackagesView::signal_on_package_selection.
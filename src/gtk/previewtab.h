@@ -28,6 +28,8 @@
 
 #include <apt-pkg/pkgcache.h>
 
+#include <set>
+
 #include <gtk/tab.h>
 
 #include <cwidget/generic/util/ref_ptr.h>
@@ -59,11 +61,38 @@ namespace gui
       Generator(const EntityColumns *columns);
       static Generator *create(const EntityColumns *columns);
 
+      /** \brief Return the translated title of the tree holding the
+       *  packages in the given state.
+       */
+      static Glib::ustring get_group_name(int group);
+
       void add(const pkgCache::PkgIterator &pkg);
       void finish();
       Glib::RefPtr<Gtk::TreeModel> get_model();
     };
 
+  private:
+    // The packages whose states changed since their rows were last
+    // updated.
+    std::set<pkgCache::PkgIterator> changed_packages;
+
+    // The idle callback that updates the rows of changed_packages,
+    // if one is pending.
+    sigc::connection update_connection;
+
+    void connect_package_states_changed();
+
+    // Remembers which packages changed, and arranges for their rows
+    // to be updated once the main loop is idle.
+    void package_states_changed(const std::set<pkgCache::PkgIterator> *changed);
+
+    // Moves the rows of the changed packages to the trees for their
+    // new states, adding and dropping rows and trees as needed.
+    bool update_changed_packages();
+
+    void discard_changed_packages();
+
+  public:
     PreviewView(const Glib::RefPtr<Gnome::Glade::Xml> &refGlade,
 		const Glib::ustring &gladename,
 		const Glib::ustring &limit,
@@ -696,8 +696,9 @@ namespace gui
     accept_button->set_image(*new Gtk::Image(Gtk::Stock::APPLY, Gtk::ICON_SIZE_BUTTON));
 
     // TODO: ideally, instead of rereading the state, we should
-    // trigger an update using the last seen state.  Or maybe build two
-    // models and swap between them.
+    // trigger an update using the last seen state.  Both views of the
+    // displayed solution are kept by get_rendered_solution(), so this
+    // doesn't render anything.
     pButtonGroupByAction->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &ResolverTab::update_solution_pane),
 							      true));
     pButtonShowExplanation->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &ResolverTab::update_solution_pane),
@@ -758,6 +759,7 @@ namespace gui
     resolver_break_dep_accept_reject_changed_connection.disconnect();
 
     already_generated_model->clear();
+    discard_rendered_solutions();
 
     // TODO: what about encapsulated resolvers?
   }
@@ -1268,20 +1270,120 @@ namespace gui
       }
   }
 
+  namespace
+  {
+    /** \brief How many rendered solutions the resolver tab keeps.
+     *
+     *  Each solution can be kept twice, once for each view.
+     */
+    const std::size_t rendered_solutions_limit = 16;
+  }
+
   void ResolverTab::append_choice(const Glib::RefPtr<Gtk::TreeStore> &store,
 				  const cwidget::util::ref_ptr<ResolverView> &view,
 				  const Gtk::TreeModel::Row &parent_row,
-				  const choice &c) const
+				  const choice &c)
   {
     Gtk::TreeModel::iterator iter = store->append(parent_row.children());
     Gtk::TreeModel::Row row(*iter);
 
-    row[view->get_columns().ActionMarkup] =
-      "<b>" + render_choice_brief_markup(c) + "</b>\n<small>" +
-      render_choice_description_markup(c) + "</small>";
+    row[view->get_columns().ActionMarkup] = get_choice_markup(c);
     row[view->get_columns().Choice] = c;
   }
 
+  const std::string &ResolverTab::get_choice_markup(const choice &c)
+  {
+    std::string *markup;
+    if(c.get_type() == choice::install_version)
+      {
+	std::pair<std::map<aptitude_resolver_version, std::string>::iterator, bool>
+	  inserted = version_markup.insert(std::make_pair(c.get_ver(), std::string()));
+	if(!inserted.second)
+	  return inserted.first->second;
+	markup = &inserted.first->second;
+      }
+    else
+      {
+	std::pair<std::map<aptitude_resolver_dep, std::string>::iterator, bool>
+	  inserted = dep_markup.insert(std::make_pair(c.get_dep(), std::string()));
+	if(!inserted.second)
+	  return inserted.first->second;
+	markup = &inserted.first->second;
+      }
+
+    *markup =
+      "<b>" + render_choice_brief_markup(c) + "</b>\n<small>" +
+      get_description_markup(c) + "</small>";
+    return *markup;
+  }
+
+  const std::string &ResolverTab::get_description_markup(const choice &c)
+  {
+    // Only versions have descriptions; share one empty string
+    // between everything else.
+    static const std::string empty;
+    if(c.get_type() != choice::install_version)
+      return empty;
+
+    std::pair<std::map<aptitude_resolver_version, std::string>::iterator, bool>
+      inserted = description_markup.insert(std::make_pair(c.get_ver(), std::string()));
+    if(inserted.second)
+      inserted.first->second = render_choice_description_markup(c);
+    return inserted.first->second;
+  }
+
+  Glib::RefPtr<Gtk::TreeStore> ResolverTab::get_rendered_solution(const aptitude_solution &sol,
+								   bool as_explanation)
+  {
+    for(std::list<rendered_solution>::iterator it = rendered_solutions.begin();
+	it != rendered_solutions.end(); ++it)
+      {
+	if(it->sol == sol && it->as_explanation == as_explanation)
+	  {
+	    LOG_TRACE(Loggers::getAptitudeGtkResolver(),
+		      "Resolver tab: reusing the rendered solution " << sol);
+	    rendered_solutions.splice(rendered_solutions.begin(),
+				      rendered_solutions, it);
+	    return rendered_solutions.front().store;
+	  }
+      }
+
+    Glib::RefPtr<Gtk::TreeStore> store;
+    if(as_explanation)
+      store = render_as_explanation(sol);
+    else
+      store = render_as_action_groups(sol);
+
+    rendered_solutions.push_front(rendered_solution(sol, as_explanation, store));
+    if(rendered_solutions.size() > rendered_solutions_limit)
+      rendered_solutions.pop_back();
+
+    return store;
+  }
+
+  bool ResolverTab::prerender_other_view()
+  {
+    if(displayed_solution.valid() && apt_cache_file != NULL)
+      {
+	// Put the view that's shown back in front, so that rendering
+	// the other one never pushes it out.
+	const bool as_explanation = pButtonShowExplanation->get_active();
+	get_rendered_solution(displayed_solution, !as_explanation);
+	get_rendered_solution(displayed_solution, as_explanation);
+      }
+
+    return false;
+  }
+
+  void ResolverTab::discard_rendered_solutions()
+  {
+    prerender_connection.disconnect();
+    rendered_solutions.clear();
+    version_markup.clear();
+    dep_markup.clear();
+    description_markup.clear();
+  }
+
   Glib::RefPtr<Gtk::TreeStore> ResolverTab::render_as_action_groups(const aptitude_solution &sol)
   {
     Glib::RefPtr<Gtk::TreeStore> store(Gtk::TreeStore::create(solution_view->get_columns()));
@@ -1566,9 +1668,8 @@ namespace gui
 		      break;
 		    }
 
-		  std::string description_markup(render_choice_description_markup(*it));
 		  row[solution_view->get_columns().ActionMarkup] =
-		    "<b>" + markup + "</b>\n<small>" + description_markup + "</small>";
+		    "<b>" + markup + "</b>\n<small>" + get_description_markup(*it) + "</small>";
 		}
 
 		break;
@@ -2098,14 +2199,16 @@ namespace gui
 	  }
 	displayed_solution = new_solution;
 
-	Glib::RefPtr<Gtk::TreeModel> store;
-	if(pButtonShowExplanation->get_active())
-	  store = render_as_explanation(displayed_solution);
-	else
-	  store = render_as_action_groups(displayed_solution);
+	Glib::RefPtr<Gtk::TreeModel> store =
+	  get_rendered_solution(displayed_solution,
+				pButtonShowExplanation->get_active());
 
 	solution_view->set_model(store, get_resolver());
 	solution_view->get_treeview()->expand_all();
+
+	prerender_connection.disconnect();
+	prerender_connection =
+	  Glib::signal_idle().connect(sigc::mem_fun(*this, &ResolverTab::prerender_other_view));
 	pResolverStatus->set_markup(ssprintf(_("Solution %s of %s."),
 					     largenum(index).c_str(),
 					     largenum(state.generated_solutions).c_str()));
@@ -2208,6 +2311,7 @@ namespace gui
 
     using_internal_resolver = true;
     resolver = manager;
+    discard_rendered_solutions();
     if(manager != NULL)
       {
 	manager->state_changed.connect(sigc::bind(sigc::ptr_fun(&do_start_first_solution_calculation), manager));
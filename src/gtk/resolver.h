@@ -37,6 +37,9 @@
 
 #include <gtk/tab.h>
 
+#include <list>
+#include <map>
+
 namespace gui
 {
 
@@ -239,13 +242,89 @@ namespace gui
     // solution pane.
     aptitude_solution displayed_solution;
 
+    /** \brief A solution that was rendered into a tree store. */
+    struct rendered_solution
+    {
+      aptitude_solution sol;
+      bool as_explanation;
+      Glib::RefPtr<Gtk::TreeStore> store;
+
+      rendered_solution(const aptitude_solution &_sol,
+			bool _as_explanation,
+			const Glib::RefPtr<Gtk::TreeStore> &_store)
+	: sol(_sol), as_explanation(_as_explanation), store(_store)
+      {
+      }
+    };
+
+    /** \brief The most recently displayed solutions, most recent
+     *  first.
+     *
+     *  Stepping back to a solution, or switching between the two
+     *  views of it, reuses its store instead of rendering it again.
+     *  The preference columns of a store are refreshed whenever it is
+     *  displayed, so they never go stale.
+     */
+    std::list<rendered_solution> rendered_solutions;
+
+    /** \brief The markup of choices that were already rendered.
+     *
+     *  Consecutive solutions usually share most of their choices, so
+     *  rows are rendered once and copied into each solution that
+     *  contains them.  Keyed by what the choice installs or breaks,
+     *  which is all that its markup depends on.
+     */
+    std::map<aptitude_resolver_version, std::string> version_markup;
+    std::map<aptitude_resolver_dep, std::string> dep_markup;
+
+    /** \brief The markup of the descriptions that were looked up,
+     *  keyed by version.
+     */
+    std::map<aptitude_resolver_version, std::string> description_markup;
+
+    /** \brief The idle connection that renders the other view of the
+     *  displayed solution, so that switching views is immediate.
+     */
+    sigc::connection prerender_connection;
+
     /** \brief Add a child of the given iterator and populate it from
      *  the given choice.
      */
     void append_choice(const Glib::RefPtr<Gtk::TreeStore> &store,
 		       const cwidget::util::ref_ptr<ResolverView> &view,
 		       const Gtk::TreeModel::Row &parent_row,
-		       const generic_choice<aptitude_universe> &c) const;
+		       const generic_choice<aptitude_universe> &c);
+
+    /** \brief Get the markup of a row that displays the given
+     *  choice, rendering it if it hasn't been seen yet.
+     */
+    const std::string &get_choice_markup(const generic_choice<aptitude_universe> &c);
+
+    /** \brief Get the markup of the description of the package that a
+     *  choice installs or removes, looking it up if necessary.
+     */
+    const std::string &get_description_markup(const generic_choice<aptitude_universe> &c);
+
+    /** \brief Get a store displaying the given solution, reusing one
+     *  that was rendered recently if possible.
+     *
+     *  \param sol             The solution to render.
+     *  \param as_explanation  If \b true, render the solution as an
+     *                         explanation; otherwise, group its
+     *                         actions by type.
+     */
+    Glib::RefPtr<Gtk::TreeStore> get_rendered_solution(const aptitude_solution &sol,
+						       bool as_explanation);
+
+    /** \brief Render the view of the displayed solution that isn't
+     *  currently shown.
+     *
+     *  Invoked from an idle callback.
+     */
+    bool prerender_other_view();
+
+    /** \brief Throw away the rendered solutions and choices. */
+    void discard_rendered_solutions();
 
     // These two routines manage the connections to the resolver and
     // other state that has to be thrown away and recreated when the
@@ -31,15 +31,19 @@
 #include <cwidget/generic/util/ssprintf.h>
 
 #include <gdkmm/pixbufloader.h>
+#include <glibmm/fileutils.h>
 
 #include <generic/apt/apt.h>
 #include <generic/apt/config_signal.h>
 #include <generic/apt/download_queue.h>
 
-#include <generic/util/job_queue_thread.h>
+#include <generic/util/thread_pool.h>
 
 #include <sigc++/trackable.h>
 
+#include <algorithm>
+#include <fstream>
+
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -51,7 +55,7 @@
 
 using namespace aptitude;
 
-using aptitude::util::job_queue_thread;
+using aptitude::util::thread_pool;
 
 namespace cw = cwidget;
 
@@ -65,38 +69,148 @@ namespace gui
     {
       temp::name filename;
       boost::shared_ptr<screenshot_cache_entry> cache_entry;
+      int max_size;
 
     public:
       load_screenshot_job(const temp::name &_filename,
-			  const boost::shared_ptr<screenshot_cache_entry> &_cache_entry)
+			  const boost::shared_ptr<screenshot_cache_entry> &_cache_entry,
+			  int _max_size)
 	: filename(_filename),
-	  cache_entry(_cache_entry)
+	  cache_entry(_cache_entry),
+	  max_size(_max_size)
       {
       }
 
       const temp::name &get_filename() const { return filename; }
       const boost::shared_ptr<screenshot_cache_entry> &get_cache_entry() const { return cache_entry; }
+      /** \brief The size to shrink the image to fit in, or 0 to load
+       *  it at its original size.
+       */
+      int get_max_size() const { return max_size; }
     };
 
-    // Needed for job_queue_thread.
+    // Used to log the jobs as they are queued.
     std::ostream &operator<<(std::ostream &out, const load_screenshot_job &job);
 
-    /** \brief A background thread used to load whole screenshots.
+    /** \brief Decode a screenshot that has been fully downloaded. */
+    void load_screenshot(const load_screenshot_job &job);
+
+    /** \brief Runs a load_screenshot_job on the thread pool. */
+    class load_screenshot_task
+    {
+      load_screenshot_job job;
+
+    public:
+      load_screenshot_task(const load_screenshot_job &_job)
+	: job(_job)
+      {
+      }
+
+      void operator()() const
+      {
+	load_screenshot(job);
+      }
+    };
+
+    /** \brief Queue a screenshot to be decoded in the background.
      *
      *  Small screenshots or ones that are fetched instantly can be
      *  loaded in a background thread, avoiding slowing down the main
      *  thread with loading individual chunks.
+     *
+     *  Up to Screenshot::Decode-Threads screenshots are decoded at
+     *  once, so that one large screenshot doesn't hold up the
+     *  thumbnails queued behind it; and thumbnails are decoded ahead
+     *  of full-size screenshots.  Only invoked from the main thread.
      */
-    class load_screenshot_thread : public job_queue_thread<load_screenshot_thread, load_screenshot_job>
+    void add_load_screenshot_job(const load_screenshot_job &job)
     {
-    public:
-      static logging::LoggerPtr get_log_category()
-      {
-	return Loggers::getAptitudeGtkScreenshotCache();
-      }
+      static const thread_pool::group_ptr decode_group =
+	thread_pool::create_group(1);
 
-      void process_job(const load_screenshot_job &job);
-    };
+      thread_pool &pool(thread_pool::get());
+      pool.set_group_limit(decode_group,
+			   aptcfg->FindI(PACKAGE "::Screenshot::Decode-Threads", 2));
+
+      LOG_TRACE(Loggers::getAptitudeGtkScreenshotCache(),
+		"Queuing " << job);
+
+      pool.submit(load_screenshot_task(job),
+		  job.get_max_size() != 0
+		    ? thread_pool::priority_high
+		    : thread_pool::priority_normal,
+		  decode_group);
+    }
+
+    /** \brief Shrink an image that's larger than the given bounds as
+     *  it's loaded.
+     *
+     *  Connected to the size-prepared signal of a PixbufLoader.
+     *  Loaders that can decode at a reduced size (such as the JPEG
+     *  loader) then do so, instead of decoding the whole image and
+     *  scaling it afterwards.
+     */
+    void shrink_to_fit(int width, int height,
+		       Gdk::PixbufLoader *loader,
+		       int max_width, int max_height)
+    {
+      if(width <= max_width && height <= max_height)
+	return;
+
+      // Scale by whichever dimension is furthest over its bound.
+      int new_width, new_height;
+      if((long long)width * max_height > (long long)height * max_width)
+	{
+	  new_width = max_width;
+	  new_height = std::max(1, (int)((long long)height * max_width / width));
+	}
+      else
+	{
+	  new_height = max_height;
+	  new_width = std::max(1, (int)((long long)width * max_height / height));
+	}
+
+      LOG_TRACE(Loggers::getAptitudeGtkScreenshotCache(),
+		"Decoding a " << width << "x" << height
+		<< " screenshot at " << new_width << "x" << new_height);
+
+      loader->set_size(new_width, new_height);
+    }
+
+    /** \brief Get the size of the box that the given type of
+     *  screenshot should be shrunk to fit in, or 0 to load it at its
+     *  original size.
+     *
+     *  Thumbnails are shrunk to fit in a box of
+     *  Aptitude::Screenshot::Thumbnail-Max-Size pixels, in case the
+     *  server sends something larger; full-size screenshots are
+     *  loaded as they are.  Only invoked from the main thread.
+     */
+    int get_decode_size_limit(screenshot_type type)
+    {
+      if(type != screenshot_thumbnail)
+	return 0;
+
+      return std::max(0, aptcfg->FindI(PACKAGE "::Screenshot::Thumbnail-Max-Size", 160));
+    }
+
+    /** \brief Set up a loader to decode an image at the size it will
+     *  be displayed.
+     *
+     *  \param max_size  The result of get_decode_size_limit().
+     */
+    void limit_decode_size(const Glib::RefPtr<Gdk::PixbufLoader> &loader,
+			   int max_size)
+    {
+      if(max_size <= 0)
+	return;
+
+      // Bind a plain pointer so the loader doesn't keep itself
+      // alive.
+      loader->signal_size_prepared().connect(sigc::bind(sigc::ptr_fun(&shrink_to_fit),
+							loader.operator->(),
+							max_size, max_size));
+    }
 
 
     /** \brief A single cached screenshot.
@@ -366,7 +480,8 @@ namespace gui
 		      << " from the file " << filename.get_name()
 		      << " in the background thread.");
 
-	    load_screenshot_thread::add_job(load_screenshot_job(filename, shared_from_this()));
+	    add_load_screenshot_job(load_screenshot_job(filename, shared_from_this(),
+							get_decode_size_limit(key.get_type())));
 	  }
 	else
 	  {
@@ -392,7 +507,8 @@ namespace gui
 			     << " from the file " << filename.get_name()
 			     << " failed, falling back to loading the whole file: "
 			     << ex.what());
-		    load_screenshot_thread::add_job(load_screenshot_job(filename, shared_from_this()));
+		    add_load_screenshot_job(load_screenshot_job(filename, shared_from_this(),
+								get_decode_size_limit(key.get_type())));
 		  }
 	      }
 	    else
@@ -402,7 +518,8 @@ namespace gui
 			 << " from the file " << filename.get_name()
 			 << " failed, falling back to loading the whole file.");
 
-		load_screenshot_thread::add_job(load_screenshot_job(filename, shared_from_this()));
+		add_load_screenshot_job(load_screenshot_job(filename, shared_from_this(),
+							    get_decode_size_limit(key.get_type())));
 	      }
 	  }
       }
@@ -450,6 +567,7 @@ namespace gui
 	    if(!loader)
 	      {
 		loader = Gdk::PixbufLoader::create();
+		limit_decode_size(loader, get_decode_size_limit(key.get_type()));
 
 		loader->signal_area_prepared().connect(sigc::mem_fun(*this, &screenshot_cache_entry::area_prepared));
 		loader->signal_area_updated().connect(get_signal_updated().make_slot());
@@ -499,7 +617,15 @@ namespace gui
       typedef cache_map::index<by_screenshot_tag>::type by_screenshot_index;
 
       static cache_map cache;
-      static int cache_size; // Last computed size of the cache.
+
+      // Thumbnails and full-size screenshots are accounted
+      // separately, so that looking at a few large screenshots
+      // doesn't push every thumbnail out of the cache.
+      static const int num_tiers = screenshot_full + 1;
+
+      // Last computed size of each tier of the cache, indexed by
+      // screenshot type.
+      static int cache_size[num_tiers];
 
 
       // Store references to stuff that's been ejected from the cache,
@@ -559,8 +685,14 @@ namespace gui
 	weak_cache.insert(std::make_pair(entry->get_key(), entry));
       }
 
-      static int get_max_cache_size()
+      static int get_max_cache_size(screenshot_type type)
       {
+	// How much memory to tie up in loaded thumbnails; defaults to
+	// 1MB.
+	if(type == screenshot_thumbnail)
+	  return aptcfg->FindI(PACKAGE "::Screenshot::Thumbnail-Cache-Max",
+			       1024 * 1024);
+
 	// How much memory to tie up in loaded screenshots; defaults
 	// to 4MB.
 	return aptcfg->FindI(PACKAGE "::Screenshot::Cache-Max",
@@ -584,37 +716,39 @@ namespace gui
 	return rval;
       }
 
-      static void update_cache_size(int new_cache_size)
+      static void update_cache_size(screenshot_type type, int new_cache_size)
       {
-	cache_size = new_cache_size;
+	cache_size[type] = new_cache_size;
 
-	// If the cache is too large, repeatedly remove the front of
-	// the ordered index (subtracting its size) until it's small
+	// If the tier is too large, repeatedly remove its least
+	// recently used entry (subtracting its size) until it's small
 	// enough again.
-	const int max_cache_size = get_max_cache_size();
-	while(cache_size > max_cache_size)
+	const int max_cache_size = get_max_cache_size(type);
+	ordered_index &ordered(cache.get<ordered_tag>());
+	ordered_index::iterator it = ordered.begin();
+	while(cache_size[type] > max_cache_size)
 	  {
-	    ordered_index &ordered(cache.get<ordered_tag>());
+	    while(it != ordered.end() && (*it)->get_key().get_type() != type)
+	      ++it;
 
-	    if(ordered.size() == 0)
+	    if(it == ordered.end())
 	      {
 		LOG_WARN(Loggers::getAptitudeGtkScreenshotCache(),
-			 "Sanity-check failed: there are no cached screenshots, but the cache size is too large ("
-			 << cache_size << ")!");
+			 "Sanity-check failed: there are no cached screenshots of this type, but the cache size is too large ("
+			 << cache_size[type] << ")!");
 		break;
 	      }
 	    else
 	      {
-		boost::shared_ptr<screenshot_cache_entry> victim =
-		  ordered.front();
+		boost::shared_ptr<screenshot_cache_entry> victim = *it;
 
 		LOG_INFO(Loggers::getAptitudeGtkScreenshotCache(),
 			 "Dropping " << victim->get_key()
 			 << " from the cache to free up "
 			 << victim->get_size() << " bytes.");
 
-		ordered.pop_front();
-		cache_size -= victim->get_size();
+		it = ordered.erase(it);
+		cache_size[type] -= victim->get_size();
 		add_to_weak_cache(victim);
 	      }
 	  }
@@ -624,12 +758,13 @@ namespace gui
       static void update_entry_size(const boost::shared_ptr<screenshot_cache_entry> &entry,
 				    int new_size)
       {
-	const int new_cache_size = cache_size - entry->get_size() + new_size;
+	const screenshot_type type = entry->get_key().get_type();
+	const int new_cache_size = cache_size[type] - entry->get_size() + new_size;
 	LOG_TRACE(Loggers::getAptitudeGtkScreenshotCache(),
 		  "Updating the size of " << entry->get_key()
 		  << " from " << entry->get_size() << " to "
 		  << new_size << ", cache size changes from "
-		  << cache_size << " to " << new_cache_size);
+		  << cache_size[type] << " to " << new_cache_size);
 
 	entry->set_size(new_size);
 
@@ -641,7 +776,7 @@ namespace gui
 	  LOG_TRACE(Loggers::getAptitudeGtkScreenshotCache(),
 		    "Not updating the cache due to the change in the size of "
 << entry->get_key() << ": it was already replaced.");
-	update_cache_size(new_cache_size);
+	update_cache_size(type, new_cache_size);
       }
 
       static void screenshot_size_computed(const boost::weak_ptr<screenshot_cache_entry> &entryWeak)
@@ -718,7 +853,8 @@ namespace gui
 	  }
 
 	cache.get<ordered_tag>().push_back(entry);
-	update_cache_size(cache_size + entry->get_size());
+	const screenshot_type type = entry->get_key().get_type();
+	update_cache_size(type, cache_size[type] + entry->get_size());
       }
 
     public:
@@ -767,7 +903,8 @@ namespace gui
 		// low-level cache management routine instead of being
 		// replicated twice.
 		cache.get<ordered_tag>().push_back(rval_from_weak_cache);
-		update_cache_size(cache_size + rval_from_weak_cache->get_size());
+		update_cache_size(key.get_type(),
+				  cache_size[key.get_type()] + rval_from_weak_cache->get_size());
 
 		add_entry(rval_from_weak_cache);
 		// No need to attach signals -- they're already
@@ -813,7 +950,7 @@ namespace gui
     };
 
     screenshot_cache::cache_map screenshot_cache::cache;
-    int screenshot_cache::cache_size = 0;
+    int screenshot_cache::cache_size[screenshot_cache::num_tiers] = { 0 };
 
     screenshot_cache::weak_cache_map screenshot_cache::weak_cache;
 
@@ -840,7 +977,32 @@ namespace gui
 		 << ", " << job.get_cache_entry()->get_key() << ")";
     }
 
-    void load_screenshot_thread::process_job(const load_screenshot_job &job)
+    /** \brief Decode an image file at the size it will be used at.
+     *
+     *  \throw Glib::Exception if the file can't be decoded.
+     */
+    Glib::RefPtr<Gdk::Pixbuf> decode_screenshot_file(const std::string &filename,
+						     int max_size)
+    {
+      Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create();
+      limit_decode_size(loader, max_size);
+
+      std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+      if(!in)
+	throw Glib::FileError(Glib::FileError::FAILED,
+			      cw::util::ssprintf("Can't open %s", filename.c_str()));
+
+      const int blockSize = 1024 * 8;
+      char buf[blockSize];
+      while(in.read(buf, blockSize) || in.gcount() > 0)
+	loader->write(reinterpret_cast<const guint8 *>(buf), in.gcount());
+
+      loader->close();
+
+      return loader->get_pixbuf();
+    }
+
+    void load_screenshot(const load_screenshot_job &job)
     {
       LOG_INFO(Loggers::getAptitudeGtkScreenshotCache(),
 	       "Loading " << job.get_cache_entry()->get_key()
@@ -849,7 +1011,8 @@ namespace gui
       try
 	{
 	  Glib::RefPtr<Gdk::Pixbuf> pixbuf =
-	    Gdk::Pixbuf::create_from_file(job.get_filename().get_name());
+	    decode_screenshot_file(job.get_filename().get_name(),
+				   job.get_max_size());
 
 	  sigc::slot<void, Glib::RefPtr<Gdk::Pixbuf> > set_image_slot =
 	    sigc::mem_fun(*job.get_cache_entry(), &screenshot_cache_entry::image_loaded);
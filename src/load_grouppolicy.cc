@@ -40,6 +40,8 @@
 
 #include <apt-pkg/error.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include <map>
 
 using namespace std;
@@ -784,7 +786,7 @@ static void init_parse_types()
     }
 }
 
-pkg_grouppolicy_factory *parse_grouppolicy(const string &s)
+static pkg_grouppolicy_factory *do_parse_grouppolicy(const string &s)
 {
   init_parse_types();
 
@@ -807,3 +809,68 @@ pkg_grouppolicy_factory *parse_grouppolicy(const string &s)
       return NULL;
     }
 }
+
+namespace
+{
+  /** \brief Forwards to a parsed policy chain that is shared by
+   *  every view created from the same grouping string.
+   *
+   *  Factories are never modified after they are parsed and every
+   *  instantiation creates new policies, so sharing them is safe; the
+   *  chain is deleted with the last view using it.
+   */
+  class pkg_grouppolicy_shared_factory : public pkg_grouppolicy_factory
+  {
+    boost::shared_ptr<pkg_grouppolicy_factory> factory;
+
+  public:
+    pkg_grouppolicy_shared_factory(const boost::shared_ptr<pkg_grouppolicy_factory> &_factory)
+      : factory(_factory)
+    {
+    }
+
+    pkg_grouppolicy *instantiate(pkg_signal *sig,
+				 desc_signal *desc_sig)
+    {
+      return factory->instantiate(sig, desc_sig);
+    }
+  };
+
+  typedef map<string, boost::shared_ptr<pkg_grouppolicy_factory> > grouppolicy_cache;
+
+  /** \brief How many grouping strings to remember.  Users rarely
+   *  type more than a handful; the limit keeps mistyped strings from
+   *  piling up.
+   */
+  const grouppolicy_cache::size_type max_cached_grouppolicies = 32;
+
+  grouppolicy_cache &get_grouppolicy_cache()
+  {
+    static grouppolicy_cache cache;
+    return cache;
+  }
+}
+
+pkg_grouppolicy_factory *parse_grouppolicy(const string &s)
+{
+  grouppolicy_cache &cache(get_grouppolicy_cache());
+
+  grouppolicy_cache::const_iterator found = cache.find(s);
+  if(found != cache.end())
+    return new pkg_grouppolicy_shared_factory(found->second);
+
+  pkg_grouppolicy_factory *parsed = do_parse_grouppolicy(s);
+  // Strings that fail to parse aren't remembered, so that their
+  // errors are reported every time.
+  if(parsed == NULL)
+    return NULL;
+
+  // Views hold their own references, so forgetting everything is
+  // safe.
+  if(cache.size() >= max_cached_grouppolicies)
+    cache.clear();
+
+  boost::shared_ptr<pkg_grouppolicy_factory> shared(parsed);
+  cache[s] = shared;
+  return new pkg_grouppolicy_shared_factory(shared);
+}
@@ -30,8 +30,16 @@
 class pkg_grouppolicy_factory;
 
 /** \brief Parses a chain of grouping policies.
+ *
+ *  Each string is only parsed once: the policy chain, including any
+ *  patterns it compiles, is shared by every factory returned for the
+ *  same string.  The caller owns the returned factory and should
+ *  delete it as before.
  *
  *  \param s a string which specifies a grouping policy configuration.
+ *
+ *  \return the new factory, or NULL if s could not be parsed (the
+ *  error is reported through _error).
  */
 pkg_grouppolicy_factory *parse_grouppolicy(const std::string &s);
 
@@ -214,3 +214,38 @@ pkg_sortpolicy *parse_sortpolicy(string s)
 
   return rval;
 }
+
+namespace
+{
+  typedef map<string, boost::shared_ptr<pkg_sortpolicy> > sortpolicy_cache;
+
+  /** \brief How many sorting strings to remember; see
+   *  load_grouppolicy.cc.
+   */
+  const sortpolicy_cache::size_type max_cached_sortpolicies = 32;
+
+  sortpolicy_cache &get_sortpolicy_cache()
+  {
+    static sortpolicy_cache cache;
+    return cache;
+  }
+}
+
+boost::shared_ptr<pkg_sortpolicy> get_sortpolicy(const string &s)
+{
+  sortpolicy_cache &cache(get_sortpolicy_cache());
+
+  sortpolicy_cache::const_iterator found = cache.find(s);
+  if(found != cache.end())
+    return found->second;
+
+  boost::shared_ptr<pkg_sortpolicy> rval(parse_sortpolicy(s));
+  if(!rval)
+    return rval;
+
+  if(cache.size() >= max_cached_sortpolicies)
+    cache.clear();
+
+  cache[s] = rval;
+  return rval;
+}
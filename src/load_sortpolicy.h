@@ -5,6 +5,8 @@
 #ifndef LOAD_SORTPOLICY_H
 #define LOAD_SORTPOLICY_H
 
+#include <boost/shared_ptr.hpp>
+
 #include <string>
 
 /** \file load_sortpolicy.h
@@ -14,4 +16,16 @@ class pkg_sortpolicy;
 
 pkg_sortpolicy *parse_sortpolicy(std::string s);
 
+/** \brief Retrieve the sorting policy described by a string.
+ *
+ *  Unlike parse_sortpolicy(), each string is only parsed once, and
+ *  the same policy is returned every time it is requested.  Sorting
+ *  policies are never modified once they are built, so they can be
+ *  shared by any number of views.
+ *
+ *  \return the policy, or an invalid pointer if s could not be
+ *  parsed (the error is reported through _error).
+ */
+boost::shared_ptr<pkg_sortpolicy> get_sortpolicy(const std::string &s);
+
 #endif
@@ -154,6 +154,21 @@ namespace aptitude
     return Logger::getLogger("aptitude.gtk.toplevel.tabs");
   }
 
+  LoggerPtr Loggers::getAptitudeInstallDeltas()
+  {
+    return Logger::getLogger("aptitude.install.deltas");
+  }
+
+  LoggerPtr Loggers::getAptitudeInstallPipeline()
+  {
+    return Logger::getLogger("aptitude.install.pipeline");
+  }
+
+  LoggerPtr Loggers::getAptitudeMatchingDescriptionIndex()
+  {
+    return Logger::getLogger("aptitude.matching.descriptionIndex");
+  }
+
   LoggerPtr Loggers::getAptitudeQtInit()
   {
     return Logger::getLogger("aptitude.qt.init");
@@ -234,6 +249,16 @@ namespace aptitude
     return Logger::getLogger("aptitude.temp");
   }
 
+  LoggerPtr Loggers::getAptitudeThreadPool()
+  {
+    return Logger::getLogger("aptitude.threadpool");
+  }
+
+  LoggerPtr Loggers::getAptitudeUpdate()
+  {
+    return Logger::getLogger("aptitude.update");
+  }
+
   LoggerPtr Loggers::getAptitudeWhy()
   {
     return Logger::getLogger("aptitude.why");
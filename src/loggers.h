@@ -200,6 +200,27 @@ namespace aptitude
      */
     static logging::LoggerPtr getAptitudeGtkToplevelTabs();
 
+    /** \brief The logger for rebuilding the archives of upgraded
+     *  packages from deltas.
+     *
+     *  Name: aptitude.install.deltas
+     */
+    static logging::LoggerPtr getAptitudeInstallDeltas();
+
+    /** \brief The logger for installing packages in batches while
+     *  the rest of the archives download.
+     *
+     *  Name: aptitude.install.pipeline
+     */
+    static logging::LoggerPtr getAptitudeInstallPipeline();
+
+    /** \brief The logger for the on-disk index used to accelerate
+     *  description searches.
+     *
+     *  Name: aptitude.matching.descriptionIndex
+     */
+    static logging::LoggerPtr getAptitudeMatchingDescriptionIndex();
+
     /** \brief The logger for the initialization of the Qt frontend.
      *
      *  Name: aptitude.qt.init
@@ -296,6 +317,19 @@ namespace aptitude
     /** \brief The logger for messages related to temporary files. */
     static logging::LoggerPtr getAptitudeTemp();
 
+    /** \brief The logger for the shared pool of worker threads.
+     *
+     *  Name: aptitude.threadpool
+     */
+    static logging::LoggerPtr getAptitudeThreadPool();
+
+    /** \brief The logger for the work done after the package lists
+     *  are downloaded.
+     *
+     *  Name: aptitude.update
+     */
+    static logging::LoggerPtr getAptitudeUpdate();
+
     /** \brief The logger for the "why" command.
      *
      *  Name: aptitude.why
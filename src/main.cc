@@ -25,6 +25,7 @@
 
 #include <getopt.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include "aptitude.h"
 
@@ -40,8 +41,12 @@
 
 #include <generic/problemresolver/exceptions.h>
 
+#include <generic/util/log_writer.h>
 #include <generic/util/logging.h>
+#include <generic/util/memory_accounting.h>
+#include <generic/util/run_metrics.h>
 #include <generic/util/temp.h>
+#include <generic/util/timings.h>
 #include <generic/util/util.h>
 
 #ifdef HAVE_GTK
@@ -76,6 +81,7 @@
 #include <cmdline/cmdline_why.h>
 #include <cmdline/terminal.h>
 
+#include <sigc++/functors/mem_fun.h>
 #include <sigc++/functors/ptr_fun.h>
 
 #include <apt-pkg/error.h>
@@ -116,8 +122,10 @@ using logging::OFF_LEVEL;
 using logging::WARN_LEVEL;
 using logging::TRACE_LEVEL;
 
+using logging::LogWriter;
 using logging::Logger;
 using logging::LoggerPtr;
+using logging::createLogWriter;
 using logging::log_level;
 
 #if 0
@@ -206,6 +214,7 @@ static void usage()
   printf(_(" update       - Download lists of new/upgradable packages.\n"));
   printf(_(" safe-upgrade - Perform a safe upgrade.\n"));
   printf(_(" full-upgrade - Perform an upgrade, possibly installing and removing packages.\n"));
+  printf(_(" prefetch-upgrades - Download the packages a safe upgrade would install.\n"));
   printf(_(" build-dep    - Install the build-dependencies of packages.\n"));
   printf(_(" forget-new   - Forget what packages are \"new\".\n"));
   printf(_(" search       - Search for a package by name and/or expression.\n"));
@@ -278,6 +287,7 @@ enum {
   OPTION_FULL_RESOLVER,
   OPTION_SHOW_RESOLVER_ACTIONS,
   OPTION_NO_SHOW_RESOLVER_ACTIONS,
+  OPTION_SHOW_RESOLVER_STATS,
   OPTION_ARCH_ONLY,
   OPTION_NOT_ARCH_ONLY,
   OPTION_DISABLE_COLUMNS,
@@ -295,6 +305,13 @@ enum {
   OPTION_GROUP_BY,
   OPTION_SHOW_PACKAGE_NAMES,
   OPTION_NEW_GUI,
+  OPTION_TAB_SEPARATED,
+  OPTION_BATCH,
+  OPTION_TIMINGS,
+  OPTION_EXPLAIN,
+  OPTION_BENCHMARK_STARTUP,
+  OPTION_EXPORT_RESOLVER_PLAN,
+  OPTION_IMPORT_RESOLVER_PLAN,
 };
 int getopt_result;
 
@@ -310,6 +327,7 @@ option opts[]={
   {"without-recommends", 0, NULL, 'R'},
   {"download-only", 0, NULL, 'd'},
   {"assume-yes", 0, NULL, 'y'},
+  {"batch", 0, &getopt_result, OPTION_BATCH},
   {"verbose", 0, NULL, 'v'},
   {"show-versions", 0, NULL, 'V'},
   {"show-deps", 0, NULL, 'D'},
@@ -318,6 +336,7 @@ option opts[]={
   {"sort", 1, NULL, 'O'},
   {"target-release", 1, NULL, 't'},
   {"disable-columns", 0, &getopt_result, OPTION_DISABLE_COLUMNS},
+  {"tab-separated", 0, &getopt_result, OPTION_TAB_SEPARATED},
   {"no-new-installs", 0, &getopt_result, OPTION_NO_NEW_INSTALLS},
   {"no-new-upgrades", 0, &getopt_result, OPTION_NO_NEW_UPGRADES},
   {"allow-new-installs", 0, &getopt_result, OPTION_ALLOW_NEW_INSTALLS},
@@ -326,6 +345,7 @@ option opts[]={
   {"full-resolver", 0, &getopt_result, OPTION_FULL_RESOLVER},
   {"show-resolver-actions", 0, &getopt_result, OPTION_SHOW_RESOLVER_ACTIONS},
   {"no-show-resolver-actions", 0, &getopt_result, OPTION_NO_SHOW_RESOLVER_ACTIONS},
+  {"show-resolver-stats", 0, &getopt_result, OPTION_SHOW_RESOLVER_STATS},
   {"visual-preview", 0, &getopt_result, OPTION_VISUAL_PREVIEW},
   {"schedule-only", 0, &getopt_result, OPTION_QUEUE_ONLY},
   {"purge-unused", 0, &getopt_result, OPTION_PURGE_UNUSED},
@@ -353,6 +373,11 @@ option opts[]={
   {"group-by", 1, &getopt_result, OPTION_GROUP_BY},
   {"show-package-names", 1, &getopt_result, OPTION_SHOW_PACKAGE_NAMES},
   {"new-gui", 0, &getopt_result, OPTION_NEW_GUI},
+  {"timings", 0, &getopt_result, OPTION_TIMINGS},
+  {"explain", 0, &getopt_result, OPTION_EXPLAIN},
+  {"benchmark-startup", 2, &getopt_result, OPTION_BENCHMARK_STARTUP},
+  {"export-resolver-plan", 1, &getopt_result, OPTION_EXPORT_RESOLVER_PLAN},
+  {"import-resolver-plan", 1, &getopt_result, OPTION_IMPORT_RESOLVER_PLAN},
   {0,0,0,0}
 };
 
@@ -564,28 +589,52 @@ void handle_message_logged(const char *sourceFilename,
                            int sourceLineNumber,
                            log_level level,
                            LoggerPtr logger,
-                           const std::string &msg,
-                           const std::string &filename)
+                           const std::string &msg)
 {
-  if(filename == "-")
-    do_message_logged(std::cout,
-                      sourceFilename,
-                      sourceLineNumber,
-                      level,
-                      logger,
-                      msg);
-  else
+  do_message_logged(std::cout,
+                    sourceFilename,
+                    sourceLineNumber,
+                    level,
+                    logger,
+                    msg);
+}
+
+// Writes the log file, if there is one.  Deliberately leaked, so that
+// messages logged while global destructors run don't find it gone.
+boost::shared_ptr<LogWriter> *log_writer = NULL;
+
+void stop_log_writer()
+{
+  if(log_writer != NULL)
+    (*log_writer)->stop();
+}
+
+// Set by --benchmark-startup to describe the state of the page cache.
+const char *startup_benchmark_mode = NULL;
+
+// Standard output might be a pipe to another program, so the report
+// goes to standard error.
+void print_timings_at_exit()
+{
+  if(startup_benchmark_mode != NULL)
+    fprintf(stderr, _("Startup benchmark (%s page cache)\n"),
+            startup_benchmark_mode);
+
+  aptitude::util::print_timings(stderr);
+}
+
+// Set from Aptitude::Metrics-File when the summary of this run should
+// be written out at exit.
+std::string run_metrics_file;
+std::string run_metrics_command;
+
+void write_run_metrics_at_exit()
+{
+  if(!aptitude::util::write_run_metrics(run_metrics_file, run_metrics_command))
     {
-      std::ofstream f(filename.c_str(), std::ios::app);
-      if(f)
-        do_message_logged(f,
-                          sourceFilename,
-                          sourceLineNumber,
-                          level,
-                          logger,
-                          msg);
-      // Since logging is just for debugging, I don't do anything if
-      // the log file can't be opened.
+      _error->Errno("write_run_metrics", _("Unable to write the run metrics to %s"),
+		    run_metrics_file.c_str());
+      _error->DumpErrors();
     }
 }
 
@@ -652,7 +701,8 @@ int main(int argc, char *argv[])
   bool update_only=false, install_only=false, queue_only=false;
   bool autoclean_only = false;
   bool clean_only = false;
-  bool assume_yes=aptcfg->FindB(PACKAGE "::CmdLine::Assume-Yes", false);
+  bool assume_yes=aptcfg->FindB(PACKAGE "::CmdLine::Assume-Yes", false) ||
+    aptcfg->FindB(PACKAGE "::CmdLine::Batch", false);
   bool fix_broken=aptcfg->FindB(PACKAGE "::CmdLine::Fix-Broken", false);
   bool safe_resolver_no_new_installs = aptcfg->FindB(PACKAGE "::Safe-Resolver::No-New-Installs", false);
   bool safe_resolver_no_new_upgrades = aptcfg->FindB(PACKAGE "::Safe-Resolver::No-New-Upgrades", false);
@@ -673,6 +723,7 @@ int main(int argc, char *argv[])
   bool always_prompt=aptcfg->FindB(PACKAGE "::CmdLine::Always-Prompt", false);
   int verbose=aptcfg->FindI(PACKAGE "::CmdLine::Verbose", 0);
   bool seen_quiet = false;
+  bool show_timings = false;
   int quiet = 0;
   std::vector<aptitude::cmdline::tag_application> user_tags;
 
@@ -837,6 +888,9 @@ int main(int argc, char *argv[])
 	    case OPTION_NO_SHOW_RESOLVER_ACTIONS:
 	      safe_resolver_show_resolver_actions = false;
 	      break;
+	    case OPTION_SHOW_RESOLVER_STATS:
+	      aptcfg->Set(PACKAGE "::CmdLine::Show-Resolver-Stats", true);
+	      break;
 	    case OPTION_NO_NEW_INSTALLS:
 	      safe_resolver_no_new_installs = true;
 	      break;
@@ -912,6 +966,44 @@ int main(int argc, char *argv[])
 	    case OPTION_DISABLE_COLUMNS:
 	      disable_columns = true;
 	      break;
+	    case OPTION_TAB_SEPARATED:
+	      aptcfg->Set(PACKAGE "::CmdLine::Tab-Separated", true);
+	      break;
+	    case OPTION_BATCH:
+	      aptcfg->Set(PACKAGE "::CmdLine::Batch", true);
+	      assume_yes = true;
+	      break;
+	    case OPTION_TIMINGS:
+	      if(!show_timings)
+		atexit(&print_timings_at_exit);
+	      show_timings = true;
+	      break;
+	    case OPTION_EXPLAIN:
+	      aptcfg->Set(PACKAGE "::CmdLine::Explain-Search", true);
+	      break;
+	    case OPTION_EXPORT_RESOLVER_PLAN:
+	      aptcfg->Set(PACKAGE "::CmdLine::Export-Resolver-Plan", optarg);
+	      break;
+	    case OPTION_IMPORT_RESOLVER_PLAN:
+	      aptcfg->Set(PACKAGE "::CmdLine::Import-Resolver-Plan", optarg);
+	      break;
+	    case OPTION_BENCHMARK_STARTUP:
+	      if(optarg == NULL || strcasecmp(optarg, "warm") == 0)
+		startup_benchmark_mode = "warm";
+	      else if(strcasecmp(optarg, "cold") == 0)
+		startup_benchmark_mode = "cold";
+	      else
+		{
+		  fprintf(stderr, _("Invalid startup benchmark mode \"%s\" (should be \"warm\" or \"cold\").\n"),
+			  optarg);
+		  exit(1);
+		}
+
+	      aptcfg->SetNoUser(PACKAGE "::Benchmark-Startup", true);
+	      if(!show_timings)
+		atexit(&print_timings_at_exit);
+	      show_timings = true;
+	      break;
 #ifdef HAVE_GTK
 	    case OPTION_GUI:
 	      use_gtk_gui = true;
@@ -1037,12 +1129,28 @@ int main(int argc, char *argv[])
       why_display_mode = aptitude::why::no_summary;
     }
 
-  if(!log_file.empty())
+  // Messages to standard output are written right away, so that they
+  // stay in order with everything else that's printed there.  Since
+  // logging is just for debugging, I don't do anything if the log
+  // file can't be opened.
+  if(log_file == "-")
     Logger::getLogger("")
-      ->connect_message_logged(sigc::bind(sigc::ptr_fun(&handle_message_logged),
-                                          log_file));
+      ->connect_message_logged(sigc::ptr_fun(&handle_message_logged));
+  else if(!log_file.empty())
+    {
+      const int queue_size =
+        aptcfg->FindI(PACKAGE "::Logging::Queue-Size", 4096);
+      log_writer =
+        new boost::shared_ptr<LogWriter>(createLogWriter(log_file,
+                                                         std::max(queue_size, 1)));
+      Logger::getLogger("")
+        ->connect_message_logged(sigc::mem_fun(**log_writer,
+                                               &LogWriter::write));
+      atexit(&stop_log_writer);
+    }
 
-  temp::initialize("aptitude");
+  temp::initialize("aptitude",
+                   aptcfg->Find(PACKAGE "::Temp-Directory", ""));
 
   const bool debug_search = aptcfg->FindB(PACKAGE "::CmdLine::Debug-Search", false);
 
@@ -1084,6 +1192,46 @@ int main(int argc, char *argv[])
       exit(1);
     }
 
+  if(startup_benchmark_mode != NULL &&
+     strcmp(startup_benchmark_mode, "cold") == 0)
+    {
+      // The configuration has already been read, so only the files
+      // read from here on come from the disk.
+      aptitude::util::phase_timer timer("drop-page-cache");
+
+      if(getuid() != 0)
+	{
+	  fprintf(stderr, "%s\n",
+		  _("Only root can drop the page cache for --benchmark-startup=cold."));
+	  exit(1);
+	}
+
+      if(!aptitude::util::drop_page_cache())
+	{
+	  _error->Errno("drop_page_cache", _("Unable to drop the page cache"));
+	  _error->DumpErrors();
+	  exit(1);
+	}
+    }
+
+  // In command-line mode, startup ends when the cache has been
+  // loaded; the command itself isn't run.
+  if(startup_benchmark_mode != NULL && optind != argc)
+    {
+      OpTextProgress p(aptcfg->FindI("Quiet", 0));
+      apt_init(&p, true, status_fname);
+      _error->DumpErrors();
+      return 0;
+    }
+
+  run_metrics_file = aptcfg->Find(PACKAGE "::Metrics-File", "");
+  if(!run_metrics_file.empty())
+    {
+      if(optind != argc)
+	run_metrics_command = argv[optind];
+      atexit(&write_run_metrics_at_exit);
+    }
+
   // Possibly run off and do other commands.
   if(optind!=argc)
     {
@@ -1142,6 +1290,7 @@ int main(int argc, char *argv[])
 		   (!strcasecmp(argv[optind], "dist-upgrade")) ||
 		   (!strcasecmp(argv[optind], "full-upgrade")) ||
 		   (!strcasecmp(argv[optind], "safe-upgrade")) ||
+		   (!strcasecmp(argv[optind], "prefetch-upgrades")) ||
 		   (!strcasecmp(argv[optind], "upgrade")) ||
 		   (!strcasecmp(argv[optind], "remove")) ||
 		   (!strcasecmp(argv[optind], "purge")) ||
@@ -1205,6 +1354,17 @@ int main(int argc, char *argv[])
 	      apt_init(&p, false);
 	      exit(0);
 	    }
+	  else if(!strcasecmp(argv[optind], "memory-usage"))
+	    {
+	      OpTextProgress p(aptcfg->FindI("Quiet", 0));
+	      _error->DumpErrors();
+	      apt_init(&p, true);
+
+	      aptitude::util::memory_report report;
+	      aptitude::util::collect_memory_usage(report);
+	      printf("%s", report.format().c_str());
+	      exit(0);
+	    }
 	  else
 	    {
 	      fprintf(stderr, _("Unknown command \"%s\"\n"), argv[optind]);
@@ -1257,7 +1417,10 @@ int main(int argc, char *argv[])
 #endif
 
     {
-      ui_init();
+      {
+        aptitude::util::phase_timer timer("ui-init");
+        ui_init();
+      }
 
       try
         {
@@ -1281,14 +1444,29 @@ int main(int argc, char *argv[])
               (*apt_cache_file)->package_category_changed.connect(sigc::ptr_fun(cw::toplevel::update));
             }
 
-	  if(!aptcfg->FindB(PACKAGE "::UI::Flat-View-As-First-View", false))
-	    do_new_package_view(*p->get_progress().unsafe_get_ref());
-	  else
-	    do_new_flat_view(*p->get_progress().unsafe_get_ref());
+          {
+            aptitude::util::phase_timer timer("build-view");
+
+            if(!aptcfg->FindB(PACKAGE "::UI::Flat-View-As-First-View", false))
+              do_new_package_view(*p->get_progress().unsafe_get_ref());
+            else
+              do_new_flat_view(*p->get_progress().unsafe_get_ref());
+          }
 
           p->destroy();
           p = NULL;
 
+          if(startup_benchmark_mode != NULL)
+            {
+              {
+                aptitude::util::phase_timer timer("first-paint");
+                cw::toplevel::updatenow();
+              }
+
+              cw::toplevel::shutdown();
+              return 0;
+            }
+
           if(update_only)
             do_update_lists();
           else if(install_only)
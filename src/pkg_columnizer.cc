@@ -23,6 +23,7 @@
 
 #include "pkg_columnizer.h"
 #include "solution_fragment.h" // For archives_text.
+#include "ui.h"
 
 #include <generic/apt/apt.h>
 #include <generic/apt/config_signal.h>
@@ -37,6 +38,10 @@
 
 #include <cwidget/generic/util/transcode.h>
 
+#include <boost/unordered_map.hpp>
+
+#include <map>
+
 #include <unistd.h>
 
 namespace cw = cwidget;
@@ -111,9 +116,89 @@ const char *pkg_item::pkg_columnizer::column_names[pkg_columnizer::numtypes]=
    N_("DownloadSize")
   };
 
+namespace
+{
+  /** \brief The column values of one package, as last displayed. */
+  struct cached_row
+  {
+    /** \brief The ID of the version displayed, or ~0 for none. */
+    unsigned long ver_id;
+    int basex;
+    std::map<int, cw::column_disposition> columns;
+
+    cached_row()
+      : ver_id(~0UL), basex(0)
+    {
+    }
+  };
+
+  /** \brief The cached rows, indexed by package ID. */
+  boost::unordered_map<unsigned long, cached_row> cached_rows;
+
+  /** \brief Bumped whenever the cached values might be stale. */
+  unsigned long state_generation = 0;
+  /** \brief The generation that cached_rows belongs to. */
+  unsigned long cached_rows_generation = 0;
+
+  void connect_depcache_invalidation()
+  {
+    pkg_item::pkg_columnizer::invalidate_cache();
+
+    if(apt_cache_file)
+      (*apt_cache_file)->package_state_changed.connect(sigc::ptr_fun(&pkg_item::pkg_columnizer::invalidate_cache));
+  }
+
+  void connect_cache_invalidation()
+  {
+    static bool connected = false;
+    if(connected)
+      return;
+    connected = true;
+
+    package_states_changed.connect(sigc::ptr_fun(&pkg_item::pkg_columnizer::invalidate_cache));
+    cache_closed.connect(sigc::ptr_fun(&pkg_item::pkg_columnizer::invalidate_cache));
+    cache_reloaded.connect(sigc::ptr_fun(&connect_depcache_invalidation));
+
+    connect_depcache_invalidation();
+  }
+}
+
+void pkg_item::pkg_columnizer::invalidate_cache()
+{
+  ++state_generation;
+}
+
 cw::column_disposition pkg_item::pkg_columnizer::setup_column(int type)
 {
-  return setup_column(pkg, visible_ver, basex, type);
+  if(!use_cache || pkg.end())
+    return setup_column(pkg, visible_ver, basex, type);
+
+  connect_cache_invalidation();
+
+  if(cached_rows_generation != state_generation)
+    {
+      cached_rows.clear();
+      cached_rows_generation = state_generation;
+    }
+
+  const unsigned long ver_id = visible_ver.end() ? ~0UL : visible_ver->ID;
+  cached_row &row = cached_rows[pkg->ID];
+  if(row.ver_id != ver_id || row.basex != basex)
+    {
+      row.columns.clear();
+      row.ver_id = ver_id;
+      row.basex = basex;
+    }
+
+  std::map<int, cw::column_disposition>::const_iterator found =
+    row.columns.find(type);
+  if(found != row.columns.end())
+    return found->second;
+
+  const cw::column_disposition rval =
+    setup_column(pkg, visible_ver, basex, type);
+  row.columns.insert(std::make_pair(type, rval));
+  return rval;
 }
 
 cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::PkgIterator &pkg,
@@ -125,7 +210,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
     {
     case name:
       if(!pkg.end())
-	return cw::column_disposition(pkg.FullName(true), basex);
+	return cw::column_disposition(get_wide_full_name(pkg), basex);
       else
 	return cw::column_disposition("", 0);
 
@@ -176,7 +261,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
       if(pkg.end())
 	return cw::column_disposition("", 0);
       else if(!pkg.CurrentVer().end())
-	return cw::column_disposition(pkg.CurrentVer().VerStr(), 0);
+	return cw::column_disposition(get_wide_version_string(pkg.CurrentVer()), 0);
       else
 	return cw::column_disposition(_("<none>"), 0);
 
@@ -187,7 +272,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
 	  pkgCache::VerIterator cand_ver=(*apt_cache_file)[pkg].CandidateVerIter(*apt_cache_file);
 
 	  if(!cand_ver.end() && !pkg_obsolete(pkg))
-	    return cw::column_disposition(cand_ver.VerStr(), 0);
+	    return cw::column_disposition(get_wide_version_string(cand_ver), 0);
 	  else
 	    return cw::column_disposition(_("<none>"), 0);
 	}
@@ -281,7 +366,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
 	   !state.InstBroken())
 	  return cw::column_disposition("h", 0);
 	else if(state.Upgradable() && !pkg.CurrentVer().end() &&
-		!candver.end() && candver.VerStr() == estate.forbidver)
+		!candver.end() && candver.VerStr() == estate.forbidver.get())
 	  return cw::column_disposition("F", 0);
 	else if(state.Delete())
 	  return cw::column_disposition((state.iFlags&pkgDepCache::Purge)?"p":"d", 0);
@@ -312,7 +397,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
 	if(state.Status!=2 && (state.Held() || estate.selection_state==pkgCache::State::Hold) && !state.InstBroken())
 	  return cw::column_disposition(_("hold"), 0);
 	else if(state.Upgradable() && !pkg.CurrentVer().end() &&
-		!candver.end() && candver.VerStr() == estate.forbidver)
+		!candver.end() && candver.VerStr() == estate.forbidver.get())
 	  return cw::column_disposition(_("forbidden upgrade"), 0);
 	else if(state.Delete())
 	  return cw::column_disposition((state.iFlags&pkgDepCache::Purge)?_("purge"):_("delete"), 0);
@@ -377,7 +462,7 @@ cw::column_disposition pkg_item::pkg_columnizer::setup_column(const pkgCache::Pk
       break;
     case section:
       if(!visible_ver.end() && visible_ver.Section())
-	return cw::column_disposition(visible_ver.Section(), 0);
+	return cw::column_disposition(get_wide_cache_string(visible_ver.Section()), 0);
       else
 	return cw::column_disposition(_("Unknown"), 0);
 
@@ -44,6 +44,9 @@ class pkg_item::pkg_columnizer : public cwidget::config::column_generator
 
   int basex;
 
+  /** \brief If \b true, look columns up in the column cache. */
+  bool use_cache;
+
   // Set up the translated format widths.
   static void init_formatting();
 protected:
@@ -56,6 +59,14 @@ public:
 						  int type);
   virtual cwidget::column_disposition setup_column(int type);
 
+  /** \brief Throw away every cached column value.
+   *
+   *  Columns are cached for each package until the package states
+   *  change or the cache is reloaded; call this if a column can
+   *  change in some other way.
+   */
+  static void invalidate_cache();
+
   static const cwidget::config::column_definition_list &get_columns()
   {
     setup_columns();
@@ -86,14 +97,22 @@ public:
 
   int get_basex() {return basex;}
 
+  /** \brief Create a columnizer for a package.
+   *
+   *  \param _use_cache  If \b true, column values are remembered
+   *                     per package, so that rows that are painted
+   *                     over and over don't recompute them.
+   */
   pkg_columnizer(const pkgCache::PkgIterator &_pkg,
 		 const pkgCache::VerIterator &_visible_ver,
 		 const cwidget::config::column_definition_list &_columns,
-		 int _basex)
+		 int _basex,
+		 bool _use_cache = false)
     : column_generator(_columns),
       pkg(_pkg),
       visible_ver(_visible_ver),
-      basex(_basex)
+      basex(_basex),
+      use_cache(_use_cache)
   {
   }
 
@@ -29,6 +29,7 @@
 
 #include <generic/apt/apt.h>
 #include <generic/apt/config_signal.h>
+#include <generic/apt/matching/compare_patterns.h>
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/pattern.h>
 #include <generic/apt/pkg_hier.h>
@@ -96,7 +97,7 @@ public:
 
   virtual void add_package(const pkgCache::PkgIterator &i, pkg_subtree *root)
     {
-      root->add_child(new pkg_item(i, get_sig()));
+      root->add_deferred_package(i, get_sig());
       root->inc_num_packages();
     }
 };
@@ -554,7 +555,7 @@ public:
 
   virtual void add_package(const pkgCache::PkgIterator &pkg, pkg_subtree *root)
   {
-    if(matching::get_match(filter, pkg, search_info, *apt_cache_file, *apt_package_records).valid())
+    if(matching::has_match(filter, pkg, search_info, *apt_cache_file, *apt_package_records))
       chain->add_package(pkg, root);
   }
 
@@ -1079,20 +1080,19 @@ public:
 void pkg_grouppolicy_task::add_package(const pkgCache::PkgIterator &pkg,
 				       pkg_subtree *root)
 {
-  set<string> *tasks=get_tasks(pkg);
-
-  eassert(tasks);
+  const task_id_range tasks = get_task_ids(pkg);
 
   chain->add_package(pkg, root);
 
-  for(set<string>::iterator i = tasks->begin(); i != tasks->end(); ++i)
+  for(const task_id *i = tasks.first; i != tasks.second; ++i)
     {
-      subtree_map::iterator found=task_children.find(*i);
+      const string &name(get_task_name(*i));
+      subtree_map::iterator found=task_children.find(name);
 
       if(found==task_children.end())
 	{
 	  string section;
-	  map<string,task>::iterator taskfound=task_list->find(*i);
+	  map<string,task>::iterator taskfound=task_list->find(name);
 	  pkg_subtree *newtree, *sectiontree;
 
 	  if(taskfound==task_list->end())
@@ -1141,10 +1141,10 @@ void pkg_grouppolicy_task::add_package(const pkgCache::PkgIterator &pkg,
 				     get_desc_sig(),
 				     taskfound->second.relevance);
 	  else
-	    newtree=new task_subtree(cw::util::transcode(*i), L"",
+	    newtree=new task_subtree(cw::util::transcode(name), L"",
 				     get_desc_sig(), 5);
 
-	  task_children[*i]=newtree;
+	  task_children[name]=newtree;
 
 	  sectiontree->add_child(newtree);
 	  newtree->set_num_packages_parent(sectiontree);
@@ -1346,6 +1346,16 @@ public:
   }
 };
 
+pkg_grouppolicy_patterns_factory :: pkg_grouppolicy_patterns_factory(const std::vector<match_entry> &_subgroups,
+								      pkg_grouppolicy_factory *_chain)
+  :chain(_chain), subgroups(_subgroups)
+{
+  aptitude::matching::pattern_interner interner;
+  for(std::vector<match_entry>::iterator i = subgroups.begin();
+      i != subgroups.end(); ++i)
+    i->pattern = interner.intern(i->pattern);
+}
+
 pkg_grouppolicy *pkg_grouppolicy_patterns_factory :: instantiate(pkg_signal *sig,
 								 desc_signal *_desc_sig)
 {
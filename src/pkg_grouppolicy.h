@@ -330,11 +330,13 @@ private:
   std::vector<match_entry> subgroups;
 public:
 
+  /** \brief Create a pattern grouping policy factory.
+   *
+   *  Sub-patterns that appear in more than one entry are merged, so
+   *  that each of them is only tested once per package.
+   */
   pkg_grouppolicy_patterns_factory(const std::vector<match_entry> &_subgroups,
-				   pkg_grouppolicy_factory *_chain)
-    :chain(_chain), subgroups(_subgroups)
-  {
-  }
+				   pkg_grouppolicy_factory *_chain);
 
   pkg_grouppolicy *instantiate(pkg_signal *sig,
 			       desc_signal *_desc_sig);
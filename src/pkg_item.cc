@@ -38,6 +38,7 @@
 #include <generic/apt/apt.h>
 #include <generic/apt/apt_undo_group.h>
 #include <generic/apt/config_signal.h>
+#include <generic/apt/config_snapshot.h>
 #include <generic/apt/matching/match.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
@@ -124,12 +125,12 @@ void pkg_item::do_highlighted_changed(bool highlighted)
 
 void pkg_item::do_select(undo_group *undo)
 {
-	(*apt_cache_file)->mark_install(package, aptcfg->FindB(PACKAGE "::Auto-Install", true), false, undo);
+	(*apt_cache_file)->mark_install(package, aptitude::apt::get_config_snapshot().auto_install, false, undo);
 }
 
 void pkg_item::select(undo_group *undo)
 {
-  if(aptcfg->FindB(PACKAGE "::UI::New-Package-Commands", true))
+  if(aptitude::apt::get_config_snapshot().new_package_commands)
     do_select(undo);
   else if(!(*apt_cache_file)[package].Delete())
     do_select(undo);
@@ -148,7 +149,7 @@ void pkg_item::hold(undo_group *undo)
   // current package version (which is the newest) should be kept even if/when
   // a newer version becomes available.
 {
-  if(aptcfg->FindB(PACKAGE "::UI::New-Package-Commands", true))
+  if(aptitude::apt::get_config_snapshot().new_package_commands)
     do_hold(undo);
   else
     // Toggle the held state.
@@ -179,7 +180,7 @@ void pkg_item::do_remove(undo_group *undo)
 
 void pkg_item::remove(undo_group *undo)
 {
-  if(aptcfg->FindB(PACKAGE "::UI::New-Package-Commands", true))
+  if(aptitude::apt::get_config_snapshot().new_package_commands)
     do_remove(undo);
   else if(!(*apt_cache_file)[package].Install() && !((*apt_cache_file)[package].iFlags&pkgDepCache::ReInstall))
     do_remove(undo);
@@ -207,7 +208,7 @@ void pkg_item::reinstall(undo_group *undo)
 {
   if(!package.CurrentVer().end())
     (*apt_cache_file)->mark_install(package,
-				    aptcfg->FindB(PACKAGE "::Auto-Install", true),
+				    aptitude::apt::get_config_snapshot().auto_install,
 				    true,
 				    undo);
 }
@@ -310,7 +311,7 @@ void pkg_item::paint(cw::tree *win, int y, bool hierarchical, const cw::style &s
   pkg_columnizer::setup_columns();
 
   cw::config::empty_column_parameters p;
-  wstring disp=pkg_columnizer(package, visible_version(), pkg_columnizer::get_columns(), basex).layout_columns(width, p);
+  wstring disp=pkg_columnizer(package, visible_version(), pkg_columnizer::get_columns(), basex, true).layout_columns(width, p);
   win->mvaddnstr(y, 0, disp.c_str(), width);
 }
 
@@ -452,10 +453,10 @@ bool pkg_item::matches(const string &s) const
   cw::util::ref_ptr<aptitude::matching::search_cache> info =
     aptitude::matching::search_cache::create();
 
-  return aptitude::matching::get_match(p, package, visible_version(),
+  return aptitude::matching::has_match(p, package, visible_version(),
 				       info,
 				       *apt_cache_file,
-				       *apt_package_records).valid();
+				       *apt_package_records);
 }
 
 pkgCache::VerIterator pkg_item::visible_version(const pkgCache::PkgIterator &pkg)
@@ -26,6 +26,13 @@
 
 #include <cwidget/widgets/subtree.h>
 
+#include <generic/util/parallel_sort.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <string.h>
+
 namespace cw = cwidget;
 namespace cwidget
 {
@@ -35,7 +42,9 @@ namespace cwidget
 // Blah, this is the easiest way to define trivial subclasses:
 // (not that far from lambda, actually)
 // Yes, I hate typing more than I have to.
-#define PKG_SORTPOLICY_SUBCLASS(name,code)	\
+//
+// keycode fills in "fields" from "items"; see get_key_fields().
+#define PKG_SORTPOLICY_SUBCLASS(name,code,keycode)	\
 class name##_impl:public pkg_sortpolicy		\
 {						\
 public:						\
@@ -57,6 +66,12 @@ public:						\
       return get_chain()->compare(pkg1, ver1, pkg2, ver2);\
     else					\
       return get_reversed()?-rval:rval;		\
+  }						\
+						\
+  void get_key_fields(const std::vector<item> &items,	\
+		      std::vector<long long> &fields) const \
+  {						\
+    keycode					\
   }						\
 };						\
 						\
@@ -98,6 +113,167 @@ bool find_package_and_ver(cw::treeitem *item,
   return false;
 }
 
+namespace
+{
+  /** \brief Orders item indices by a string belonging to each item. */
+  class string_index_lt
+  {
+    const std::vector<const char *> &strings;
+    int (*cmp)(const char *, const char *);
+
+  public:
+    string_index_lt(const std::vector<const char *> &_strings,
+		    int (*_cmp)(const char *, const char *))
+      : strings(_strings), cmp(_cmp)
+    {
+    }
+
+    bool operator()(std::size_t i, std::size_t j) const
+    {
+      return cmp(strings[i], strings[j]) < 0;
+    }
+  };
+
+  /** \brief Set each field to the rank of its string under cmp.
+   *
+   *  Equal strings get equal ranks, and NULL strings get rank 0,
+   *  below every other string.
+   */
+  void rank_strings(const std::vector<const char *> &strings,
+		    int (*cmp)(const char *, const char *),
+		    std::vector<long long> &fields)
+  {
+    std::vector<std::size_t> order;
+    order.reserve(strings.size());
+    for(std::size_t i = 0; i < strings.size(); ++i)
+      {
+	if(strings[i] == NULL)
+	  fields[i] = 0;
+	else
+	  order.push_back(i);
+      }
+
+    std::sort(order.begin(), order.end(), string_index_lt(strings, cmp));
+
+    long long rank = 0;
+    for(std::size_t k = 0; k < order.size(); ++k)
+      {
+	if(k == 0 || cmp(strings[order[k - 1]], strings[order[k]]) != 0)
+	  ++rank;
+	fields[order[k]] = rank;
+      }
+  }
+
+  int compare_versions(const char *a, const char *b)
+  {
+    return _system->VS->CmpVersion(a, b);
+  }
+
+  void rank_names(const std::vector<pkg_sortpolicy::item> &items,
+		  std::vector<long long> &fields)
+  {
+    std::vector<const char *> names;
+    names.reserve(items.size());
+    for(std::size_t i = 0; i < items.size(); ++i)
+      names.push_back(items[i].first.Name());
+
+    rank_strings(names, &strcmp, fields);
+  }
+
+  void rank_versions(const std::vector<pkg_sortpolicy::item> &items,
+		     std::vector<long long> &fields)
+  {
+    std::vector<const char *> versions;
+    versions.reserve(items.size());
+    for(std::size_t i = 0; i < items.size(); ++i)
+      versions.push_back(items[i].second.end() ? NULL : items[i].second.VerStr());
+
+    rank_strings(versions, &compare_versions, fields);
+  }
+}
+
+pkg_sort_keys::pkg_sort_keys(const pkg_sortpolicy *policy,
+			     const std::vector<pkg_sortpolicy::item> &items)
+  : width(0), size(items.size())
+{
+  for(const pkg_sortpolicy *p = policy; p != NULL; p = p->chain)
+    ++width;
+
+  fields.resize(items.size() * width);
+
+  std::vector<long long> column(items.size());
+  std::size_t col = 0;
+  for(const pkg_sortpolicy *p = policy; p != NULL; p = p->chain, ++col)
+    {
+      p->get_key_fields(items, column);
+      for(std::size_t i = 0; i < items.size(); ++i)
+	fields[i * width + col] = p->reversed ? -column[i] : column[i];
+    }
+}
+
+int pkg_sort_keys::compare(std::size_t i, std::size_t j) const
+{
+  const long long *a = &fields[0] + i * width;
+  const long long *b = &fields[0] + j * width;
+  for(std::size_t col = 0; col < width; ++col)
+    {
+      if(a[col] < b[col])
+	return -1;
+      else if(a[col] > b[col])
+	return 1;
+    }
+
+  return 0;
+}
+
+class pkg_sort_keys::index_lt
+{
+  const pkg_sort_keys &keys;
+
+public:
+  index_lt(const pkg_sort_keys &_keys)
+    : keys(_keys)
+  {
+  }
+
+  bool operator()(std::size_t i, std::size_t j) const
+  {
+    // Fall back to the original position so that the order is
+    // stable even though the sort isn't.
+    const int cmp = keys.compare(i, j);
+    return cmp < 0 || (cmp == 0 && i < j);
+  }
+};
+
+void pkg_sort_keys::get_order(std::vector<std::size_t> &order,
+			      int num_threads) const
+{
+  order.clear();
+  order.reserve(size);
+  for(std::size_t i = 0; i < size; ++i)
+    order.push_back(i);
+
+  if(width > 0)
+    aptitude::util::parallel_sort(order.begin(), order.end(),
+				  index_lt(*this), num_threads);
+}
+
+void pkg_sort_keys::get_unique_order(std::vector<std::size_t> &order,
+				     int num_threads) const
+{
+  get_order(order, num_threads);
+  if(width == 0)
+    return;
+
+  std::vector<std::size_t>::iterator out = order.begin();
+  for(std::vector<std::size_t>::const_iterator it = order.begin();
+      it != order.end(); ++it)
+    if(out == order.begin() || compare(*(out - 1), *it) != 0)
+      *out++ = *it;
+
+  order.erase(out, order.end());
+}
+
 int pkg_sortpolicy_wrapper::compare(cw::treeitem *item1,
 				    cw::treeitem *item2) const
 {
@@ -122,7 +298,8 @@ int pkg_sortpolicy_wrapper::compare(cw::treeitem *item1,
 
 // The old by-name sorting
 PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_name,
-			return strcmp(pkg1.Name(), pkg2.Name()););
+			return strcmp(pkg1.Name(), pkg2.Name());,
+			rank_names(items, fields););
 
 // installed-size-sorting, treats virtual packages as 0-size
 PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_installed_size,
@@ -137,7 +314,11 @@ PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_installed_size,
 			else if(ver1->InstalledSize>ver2->InstalledSize)
 			  return 1;
 			else
-			  return 0;);
+			  return 0;,
+			for(std::size_t i = 0; i < items.size(); ++i)
+			  fields[i] = items[i].second.end()
+			    ? std::numeric_limits<long long>::max()
+			    : (long long) items[i].second->InstalledSize;);
 
 // Priority sorting
 PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_priority,
@@ -148,7 +329,9 @@ PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_priority,
 			else if(pri1==pri2)
 			  return 0;
 			else // if(pri1>pri2)
-			  return 1;);
+			  return 1;,
+			for(std::size_t i = 0; i < items.size(); ++i)
+			  fields[i] = items[i].second.end() ? 0 : items[i].second->Priority;);
 
 // Sort by version number
 PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_ver,
@@ -158,4 +341,5 @@ PKG_SORTPOLICY_SUBCLASS(pkg_sortpolicy_ver,
 			  return 1;
 			else
 			  return _system->VS->CmpVersion(ver1.VerStr(),
-							 ver2.VerStr()););
+							 ver2.VerStr());,
+			rank_versions(items, fields););
@@ -24,6 +24,9 @@
 #include <apt-pkg/pkgcache.h>
 #include <cwidget/widgets/treeitem.h>
 
+#include <utility>
+#include <vector>
+
 /** \brief Package sorting policies
  *
  * 
@@ -36,12 +39,15 @@
  */
 
 class pkg_tree_node;
+class pkg_sort_keys;
 
 class pkg_sortpolicy
 {
   pkg_sortpolicy *chain;
 
   bool reversed;
+
+  friend class pkg_sort_keys;
 protected:
   const pkg_sortpolicy *get_chain() const {return chain;}
   bool get_reversed() const {return reversed;}
@@ -51,8 +57,69 @@ public:
 
   virtual ~pkg_sortpolicy() {delete chain;}
 
+  /** \brief A package and the version of it that is sorted on. */
+  typedef std::pair<pkgCache::PkgIterator, pkgCache::VerIterator> item;
+
   virtual int compare(const pkgCache::PkgIterator &pkg1, const pkgCache::VerIterator &ver1,
 		      const pkgCache::PkgIterator &pkg2, const pkgCache::VerIterator &ver2) const=0;
+
+  /** \brief Compute this policy's part of the sort key of each item.
+   *
+   *  \param items   The items to compute keys for.
+   *  \param fields  A vector of the same size as items; fields[i]
+   *                 is set so that comparing two fields gives the same
+   *                 answer as compare() on the corresponding items
+   *                 (ignoring the chain and reversal).
+   */
+  virtual void get_key_fields(const std::vector<item> &items,
+			      std::vector<long long> &fields) const=0;
+};
+
+/** \brief Sort keys computed in advance for a list of items.
+ *
+ *  Each item gets one integer per policy in the chain; strings such
+ *  as names and versions are replaced by their rank among the items.
+ *  Sorting on the keys gives the same order as calling the policy's
+ *  compare() on every pair, but each name, version or record is only
+ *  looked at once per item instead of once per comparison.
+ */
+class pkg_sort_keys
+{
+  /** \brief The key of item i is at [i*width, (i+1)*width). */
+  std::vector<long long> fields;
+  std::size_t width;
+  std::size_t size;
+
+  class index_lt;
+
+public:
+  /** \brief Compute the keys of a list of items.
+   *
+   *  \param policy  The policy to sort by, or NULL to leave items in
+   *                 their original order.
+   *  \param items   The items to compute keys for.
+   */
+  pkg_sort_keys(const pkg_sortpolicy *policy,
+		const std::vector<pkg_sortpolicy::item> &items);
+
+  /** \brief Compare the keys of two items as compare() would. */
+  int compare(std::size_t i, std::size_t j) const;
+
+  /** \brief Compute the order of the items.
+   *
+   *  \param[out] order  Set to the indices of the items, sorted by key;
+   *                     items with equal keys stay in their original
+   *                     order.
+   *  \param num_threads How many threads to sort with.
+   */
+  void get_order(std::vector<std::size_t> &order, int num_threads = 1) const;
+
+  /** \brief Like get_order(), but only keep the first of each run of
+   *  items whose keys are equal.
+   *
+   *  Without a policy, no two items are considered equal.
+   */
+  void get_unique_order(std::vector<std::size_t> &order, int num_threads = 1) const;
 };
 
 // This is an experiment..I'm using factories to avoid a massively oversized
@@ -21,7 +21,11 @@
 
 #include "pkg_subtree.h"
 
+#include "pkg_item.h"
+#include "pkg_sortpolicy.h"
+
 #include <generic/apt/apt.h>
+#include <generic/util/memory_accounting.h>
 
 #include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/generic/util/transcode.h>
@@ -59,6 +63,120 @@ const wchar_t *pkg_subtree::label()
   return name.c_str();
 }
 
+void pkg_subtree::add_deferred_package(const pkgCache::PkgIterator &pkg,
+				       pkg_signal *sig)
+{
+  deferred_packages.push_back(pkg);
+  deferred_sig = sig;
+}
+
+void pkg_subtree::set_deferred_sorting(const boost::shared_ptr<pkg_sortpolicy> &sorting)
+{
+  deferred_sorting = sorting;
+
+  for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
+    {
+      pkg_subtree *child = dynamic_cast<pkg_subtree *>(*i);
+      if(child != NULL)
+	child->set_deferred_sorting(sorting);
+    }
+}
+
+std::size_t pkg_subtree::memory_usage()
+{
+  std::size_t rval = sizeof(*this) +
+    (name.capacity() + description.capacity()) * sizeof(wchar_t) +
+    aptitude::util::vector_memory_usage(deferred_packages);
+
+  for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
+    {
+      // Each child also costs a node in the list of children.
+      rval += 3 * sizeof(void *);
+
+      pkg_subtree *child = dynamic_cast<pkg_subtree *>(*i);
+      if(child != NULL)
+	rval += child->memory_usage();
+      else
+	// Other children are package and version rows, which are
+	// all about this size.
+	rval += sizeof(pkg_item);
+    }
+
+  return rval;
+}
+
+void pkg_subtree::materialize_deferred()
+{
+  if(deferred_packages.empty())
+    return;
+
+  // Clear the list first: adding and sorting children can call back
+  // into this tree.
+  std::vector<pkgCache::PkgIterator> packages;
+  packages.swap(deferred_packages);
+
+  // If the packages are the only children, create their items in
+  // sorted order; otherwise sort everything together.
+  if(get_children_begin() == get_children_end())
+    {
+      std::vector<pkg_sortpolicy::item> items;
+      items.reserve(packages.size());
+      for(std::vector<pkgCache::PkgIterator>::const_iterator it = packages.begin();
+	  it != packages.end(); ++it)
+	items.push_back(pkg_sortpolicy::item(*it, pkg_item::visible_version(*it)));
+
+      std::vector<std::size_t> order;
+      pkg_sort_keys(deferred_sorting.get(), items).get_order(order);
+
+      for(std::vector<std::size_t>::const_iterator it = order.begin();
+	  it != order.end(); ++it)
+	add_child(new pkg_item(packages[*it], deferred_sig));
+    }
+  else
+    {
+      for(std::vector<pkgCache::PkgIterator>::const_iterator it = packages.begin();
+	  it != packages.end(); ++it)
+	add_child(new pkg_item(*it, deferred_sig));
+
+      if(deferred_sorting.get() != NULL)
+	{
+	  pkg_sortpolicy_wrapper sorter(deferred_sorting.get());
+	  cw::subtree<pkg_tree_node>::sort(sorter);
+	}
+    }
+}
+
+pkg_subtree::levelref *pkg_subtree::begin()
+{
+  materialize_deferred();
+  return cw::subtree<pkg_tree_node>::begin();
+}
+
+pkg_subtree::levelref *pkg_subtree::end()
+{
+  materialize_deferred();
+  return cw::subtree<pkg_tree_node>::end();
+}
+
+bool pkg_subtree::has_visible_children()
+{
+  return get_expanded() && has_children();
+}
+
+bool pkg_subtree::has_children()
+{
+  return !deferred_packages.empty() ||
+    cw::subtree<pkg_tree_node>::has_children();
+}
+
+void pkg_subtree::sort(cw::sortpolicy &sort_method)
+{
+  if(deferred_sorting.get() == NULL)
+    materialize_deferred();
+
+  cw::subtree<pkg_tree_node>::sort(sort_method);
+}
+
 bool pkg_subtree::dispatch_key(const cw::config::key &k, cw::tree *owner)
 {
   if(pkg_tree_node::dispatch_key(k, owner))
@@ -71,6 +189,7 @@ void pkg_subtree::select(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->select(undo);
 }
@@ -79,6 +198,7 @@ void pkg_subtree::hold(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->hold(undo);
 }
@@ -87,6 +207,7 @@ void pkg_subtree::keep(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->keep(undo);
 }
@@ -95,6 +216,7 @@ void pkg_subtree::remove(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->remove(undo);
 }
@@ -103,6 +225,7 @@ void pkg_subtree::purge(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->purge(undo);
 }
@@ -111,6 +234,7 @@ void pkg_subtree::reinstall(undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->reinstall(undo);
 }
@@ -119,6 +243,7 @@ void pkg_subtree::set_auto(bool isauto, undo_group *undo)
 {
   aptitudeDepCache::action_group group(*apt_cache_file, undo);
 
+  materialize_deferred();
   for(child_iterator i=get_children_begin(); i!=get_children_end(); i++)
     (*i)->set_auto(isauto, undo);
 }
@@ -23,8 +23,16 @@
 
 #include <cwidget/widgets/subtree.h>
 
+#include <apt-pkg/pkgcache.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
 #include "pkg_node.h"
 
+class pkg_sortpolicy;
+
 /** \brief A subtree which contains packages (and other subtrees)
  * 
  *  \file pkg_subtree.h
@@ -42,6 +50,29 @@ class pkg_subtree:public cwidget::widgets::subtree<pkg_tree_node>,
   bool num_packages_known;
   int num_packages;
 
+  typedef sigc::signal2<void,
+			const pkgCache::PkgIterator &,
+			const pkgCache::VerIterator &> pkg_signal;
+
+  /** \brief Packages whose items haven't been created yet.
+   *
+   *  Large groups are usually never opened, so their items are only
+   *  created (and sorted into place) the first time the children of
+   *  this tree are needed.
+   */
+  std::vector<pkgCache::PkgIterator> deferred_packages;
+
+  /** \brief The signal passed to the items of deferred packages. */
+  pkg_signal *deferred_sig;
+
+  /** \brief How to sort the deferred items once they exist, or NULL
+   *  to leave them in the order they were added.
+   */
+  boost::shared_ptr<pkg_sortpolicy> deferred_sorting;
+
+  /** \brief Create the items of any deferred packages. */
+  void materialize_deferred();
+
   void do_highlighted_changed(bool highlighted);
 protected:
   void set_label(const std::wstring &_name) {name=_name;}
@@ -52,7 +83,8 @@ public:
     cwidget::widgets::subtree<pkg_tree_node>(_expanded), name(_name),
     description(_description), info_signal(_info_signal),
     num_packages_parent(NULL),
-    num_packages_known(true), num_packages(0)
+    num_packages_known(true), num_packages(0),
+    deferred_sig(NULL)
   {
     highlighted_changed.connect(sigc::mem_fun(this, &pkg_subtree::do_highlighted_changed));
   }
@@ -61,7 +93,8 @@ public:
     cwidget::widgets::subtree<pkg_tree_node>(_expanded), name(_name),
     description(L""), info_signal(NULL),
     num_packages_parent(NULL),
-    num_packages_known(true), num_packages(0)
+    num_packages_known(true), num_packages(0),
+    deferred_sig(NULL)
   {
     highlighted_changed.connect(sigc::mem_fun(this, &pkg_subtree::do_highlighted_changed));
   }
@@ -71,6 +104,39 @@ public:
   virtual const wchar_t *tag();
   virtual const wchar_t *label();
 
+  virtual levelref *begin();
+  virtual levelref *end();
+  bool has_visible_children();
+  bool has_children();
+
+  using cwidget::widgets::subtree<pkg_tree_node>::sort;
+  /** \brief Sort the children of this tree.
+   *
+   *  If this tree has no deferred sorting policy, any deferred items
+   *  are created first so that they are sorted too.
+   */
+  virtual void sort(cwidget::widgets::sortpolicy &sort_method);
+
+  /** \brief Add a package whose item is created the first time the
+   *  children of this tree are displayed or visited.
+   *
+   *  The package counts are not updated; call inc_num_packages() as
+   *  usual.
+   *
+   *  \param pkg  The package to add.
+   *  \param sig  The signal to pass to the package's item.  Every
+   *              deferred package of a tree must use the same signal.
+   */
+  void add_deferred_package(const pkgCache::PkgIterator &pkg, pkg_signal *sig);
+
+  /** \brief Set how the deferred items of this tree and of every
+   *  pkg_subtree below it are sorted when they are created.
+   *
+   *  Without a policy, sort() creates the deferred items so that it
+   *  can put them in order.
+   */
+  void set_deferred_sorting(const boost::shared_ptr<pkg_sortpolicy> &sorting);
+
   virtual void select(undo_group *undo);
   virtual void hold(undo_group *undo);
   virtual void keep(undo_group *undo);
@@ -108,6 +174,11 @@ public:
   std::wstring get_name() {return name;}
   std::wstring get_description() {return description;}
 
+  /** \brief Estimate the memory used by this tree and everything
+   *  below it, without creating the items of deferred packages.
+   */
+  std::size_t memory_usage();
+
   bool dispatch_key(const cwidget::config::key &k, cwidget::widgets::tree *owner);
 };
 
@@ -22,10 +22,12 @@
 #include "pkg_tree.h"
 
 #include "aptitude.h"
+#include "desc_render.h"
 #include "load_grouppolicy.h"
 #include "load_sortpolicy.h"
 #include "pkg_columnizer.h"
 #include "pkg_grouppolicy.h"
+#include "pkg_item.h"
 #include "pkg_node.h"
 #include "pkg_sortpolicy.h"
 #include "pkg_subtree.h"
@@ -33,6 +35,7 @@
 #include "progress.h"
 
 #include <cwidget/columnify.h>
+#include <cwidget/generic/threads/threads.h>
 #include <cwidget/generic/util/transcode.h>
 #include <cwidget/toplevel.h>
 #include <cwidget/widgets/treeitem.h>
@@ -43,13 +46,20 @@
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 
+#include <generic/util/safe_slot.h>
+
 #include <apt-pkg/progress.h>
 #include <apt-pkg/configuration.h>
 #include <apt-pkg/algorithms.h>
 
+#include <sigc++/adaptors/bind.h>
 #include <sigc++/adaptors/retype_return.h>
 #include <sigc++/functors/mem_fun.h>
 
+#include <boost/make_shared.hpp>
+
+#include <wctype.h>
+
 namespace cw = cwidget;
 namespace cwidget
 {
@@ -59,6 +69,155 @@ namespace cwidget
 namespace matching = aptitude::matching;
 using cw::util::ref_ptr;
 
+/** \brief A search for the packages matching a limit, run in its
+ *  own thread.
+ *
+ *  Only the search runs in the background: the grouping policies
+ *  create tree items and connect to signals, which has to happen in
+ *  the main thread, so the tree itself is built there from the list
+ *  of matches.
+ */
+class pkg_tree::limit_search
+{
+  const ref_ptr<matching::pattern> limit;
+  const std::wstring limitstr;
+  const bool keep_tree_if_unmatched;
+  const bool quiet;
+
+  /** \brief If restricted is \b true, the only packages that can
+   *  match the limit.
+   */
+  const std::vector<pkgCache::PkgIterator> candidates;
+  const bool restricted;
+
+  /** \brief Set by the main thread to stop the search early.
+   *
+   *  This is a best-effort cancel, checked between batches of
+   *  results; the search thread still has to be joined.
+   */
+  volatile bool canceled;
+
+  /** \brief Set by the search thread just before it notifies the
+   *  main thread.
+   */
+  volatile bool finished;
+
+  /** \brief An error that stopped the search, if any. */
+  std::string error;
+
+  /** \brief The matching packages; only touched by the search thread
+   *  until finished is set.
+   */
+  std::vector<pkgCache::PkgIterator> matches;
+
+  boost::shared_ptr<cw::threads::thread> thread;
+
+  class search_thread;
+  friend class search_thread;
+
+  class search_thread
+  {
+    boost::shared_ptr<limit_search> search;
+    // Invoked in the main thread once the search is over.
+    safe_slot0<void> k;
+
+  public:
+    search_thread(const boost::shared_ptr<limit_search> &_search,
+		  const safe_slot0<void> &_k)
+      : search(_search), k(_k)
+    {
+    }
+
+    void operator()()
+    {
+      try
+	{
+	  search->run();
+	}
+      catch(const cw::util::Exception &e)
+	{
+	  search->error = e.errmsg();
+	}
+
+      search->finished = true;
+      ui_post_thunk(k);
+    }
+  };
+
+  limit_search(const ref_ptr<matching::pattern> &_limit,
+	       const std::wstring &_limitstr,
+	       bool _keep_tree_if_unmatched,
+	       bool _quiet,
+	       const std::vector<pkgCache::PkgIterator> *_candidates)
+    : limit(_limit),
+      limitstr(_limitstr),
+      keep_tree_if_unmatched(_keep_tree_if_unmatched),
+      quiet(_quiet),
+      candidates(_candidates == NULL
+		 ? std::vector<pkgCache::PkgIterator>()
+		 : *_candidates),
+      restricted(_candidates != NULL),
+      canceled(false),
+      finished(false)
+  {
+  }
+
+  bool add_matches(const matching::search_result_batch &batch)
+  {
+    for(matching::search_result_batch::const_iterator it = batch.begin();
+	it != batch.end(); ++it)
+      matches.push_back(it->first);
+
+    return !canceled;
+  }
+
+  void run()
+  {
+    if(!restricted)
+      {
+	matching::search_incremental(limit, matching::search_cache::create(),
+				     sigc::mem_fun(*this, &limit_search::add_matches),
+				     *apt_cache_file,
+				     *apt_package_records);
+	return;
+      }
+
+    const ref_ptr<matching::search_cache> search_info(matching::search_cache::create());
+    for(std::vector<pkgCache::PkgIterator>::const_iterator it = candidates.begin();
+	it != candidates.end() && !canceled; ++it)
+      if(matching::has_match(limit, *it, search_info,
+			     *apt_cache_file, *apt_package_records))
+	matches.push_back(*it);
+  }
+
+public:
+  static boost::shared_ptr<limit_search>
+  start(const ref_ptr<matching::pattern> &limit,
+	const std::wstring &limitstr,
+	bool keep_tree_if_unmatched,
+	bool quiet,
+	const std::vector<pkgCache::PkgIterator> *candidates,
+	const safe_slot0<void> &k)
+  {
+    boost::shared_ptr<limit_search> rval(new limit_search(limit, limitstr,
+							  keep_tree_if_unmatched,
+							  quiet, candidates));
+    rval->thread = boost::make_shared<cw::threads::thread>(search_thread(rval, k));
+    return rval;
+  }
+
+  const ref_ptr<matching::pattern> &get_limit() const { return limit; }
+  const std::wstring &get_limitstr() const { return limitstr; }
+  bool get_keep_tree_if_unmatched() const { return keep_tree_if_unmatched; }
+  bool get_quiet() const { return quiet; }
+  bool is_finished() const { return finished; }
+  const std::string &get_error() const { return error; }
+  const std::vector<pkgCache::PkgIterator> &get_matches() const { return matches; }
+
+  void cancel() { canceled = true; }
+  void join() { thread->join(); }
+};
+
 cw::config::keybindings *pkg_tree::bindings=NULL;
 
 cw::editline::history_list pkg_tree::limit_history, pkg_tree::grouping_history,
@@ -74,11 +233,17 @@ pkg_tree::pkg_tree(const std::string &def_grouping,
 		   const std::wstring &def_limit)
   :initialized(false),
    grouping(_grouping), groupingstr(def_grouping),
-   sorting(parse_sortpolicy(aptcfg->Find(PACKAGE "::UI::Default-Sorting",
-					 "name"))),
+   sorting(get_sortpolicy(aptcfg->Find(PACKAGE "::UI::Default-Sorting",
+				       "name"))),
    limit(NULL),
-   limitstr(def_limit)
+   limitstr(def_limit),
+   limit_matches_valid(false),
+   description_prefetch_pending(false),
+   built_root(NULL),
+   account(sigc::mem_fun(*this, &pkg_tree::account_memory))
 {
+  selection_changed.connect(sigc::mem_fun(*this, &pkg_tree::handle_selection_changed));
+
   if(!limitstr.empty())
     limit = matching::parse(cw::util::transcode(limitstr));
 }
@@ -87,23 +252,85 @@ pkg_tree::pkg_tree(const std::string &def_grouping,
 		   pkg_grouppolicy_factory *_grouping)
   :initialized(false),
    grouping(_grouping), groupingstr(def_grouping),
-   sorting(parse_sortpolicy(aptcfg->Find(PACKAGE "::UI::Default-Sorting",
-					 "name"))),
+   sorting(get_sortpolicy(aptcfg->Find(PACKAGE "::UI::Default-Sorting",
+				       "name"))),
    limit(NULL),
-   limitstr(cw::util::transcode(aptcfg->Find(PACKAGE "::Pkg-Display-Limit", "")))
+   limitstr(cw::util::transcode(aptcfg->Find(PACKAGE "::Pkg-Display-Limit", ""))),
+   limit_matches_valid(false),
+   description_prefetch_pending(false),
+   built_root(NULL),
+   account(sigc::mem_fun(*this, &pkg_tree::account_memory))
 {
+  selection_changed.connect(sigc::mem_fun(*this, &pkg_tree::handle_selection_changed));
+
   if(!limitstr.empty())
     limit = matching::parse(cw::util::transcode(limitstr));
 }
 
+void pkg_tree::handle_selection_changed(cw::treeitem *item)
+{
+  // Wait until the keys that are already queued have been handled,
+  // so that holding down an arrow key doesn't prefetch every row it
+  // passes over.
+  if(!description_prefetch_pending)
+    {
+      description_prefetch_pending = true;
+      cw::toplevel::post_event(new cw::toplevel::slot_event(sigc::mem_fun(*this, &pkg_tree::prefetch_adjacent_descriptions)));
+    }
+}
+
+void pkg_tree::prefetch_adjacent_descriptions()
+{
+  description_prefetch_pending = false;
+
+  if(!apt_cache_file)
+    return;
+
+  const cw::treeiterator selected = get_selection();
+  if(selected == get_end())
+    return;
+
+  cw::treeiterator next = selected;
+  ++next;
+  if(next != get_end())
+    {
+      const pkg_item *item = dynamic_cast<const pkg_item *>(&*next);
+      if(item != NULL)
+	aptitude::prefetch_long_description(item->visible_version());
+    }
+
+  if(selected != get_begin())
+    {
+      cw::treeiterator prev = selected;
+      --prev;
+      const pkg_item *item = dynamic_cast<const pkg_item *>(&*prev);
+      if(item != NULL)
+	aptitude::prefetch_long_description(item->visible_version());
+    }
+}
+
 void pkg_tree::handle_cache_close()
 {
+  // The searches are reading the cache that's going away.
+  stop_background_searches();
+  limit_matches.clear();
+  limit_matches_valid = false;
   set_root(NULL);
+  built_root = NULL;
+}
+
+void pkg_tree::account_memory(aptitude::util::memory_report &report)
+{
+  std::size_t bytes = aptitude::util::vector_memory_usage(limit_matches);
+  if(built_root != NULL)
+    bytes += built_root->memory_usage();
+
+  report.add("package views", bytes);
 }
 
 pkg_tree::~pkg_tree()
 {
-  delete sorting;
+  stop_background_searches();
 }
 
 void pkg_tree::set_grouping(pkg_grouppolicy_factory *_grouping)
@@ -116,7 +343,7 @@ void pkg_tree::set_grouping(pkg_grouppolicy_factory *_grouping)
 
   grouping=_grouping;
 
-  build_tree();
+  rebuild_in_background(limit, limitstr, false);
 
   delete oldgrouping;
 }
@@ -134,25 +361,29 @@ void pkg_tree::set_grouping(const std::wstring &s)
 
 void pkg_tree::set_sorting(pkg_sortpolicy *_sorting)
 {
-  delete sorting;
+  set_sorting(boost::shared_ptr<pkg_sortpolicy>(_sorting));
+}
 
-  sorting=_sorting;
+void pkg_tree::set_sorting(const boost::shared_ptr<pkg_sortpolicy> &_sorting)
+{
+  sorting = _sorting;
 
   // ummmm
   if(grouping)
-    build_tree();
+    rebuild_in_background(limit, limitstr, false);
 }
 
 void pkg_tree::set_sorting(const std::wstring &s)
 {
   // FIXME: push wstrings down into the parsing code.
-  pkg_sortpolicy *policy=parse_sortpolicy(cw::util::transcode(s));
+  boost::shared_ptr<pkg_sortpolicy> policy(get_sortpolicy(cw::util::transcode(s)));
 
   if(policy)
     set_sorting(policy);
 }
 
-bool pkg_tree::build_tree(OpProgress &progress)
+bool pkg_tree::build_tree_from(const std::vector<pkgCache::PkgIterator> &packages,
+			       OpProgress &progress)
 {
   bool rval;
 
@@ -168,12 +399,13 @@ bool pkg_tree::build_tree(OpProgress &progress)
   reset_incsearch();
 
   set_root(NULL);
+  built_root = NULL;
 
   reset_incsearch();
 
   if(grouping && apt_cache_file)
     {
-      bool empty=true, cache_empty=true;
+      bool empty=true;
 
       pkg_subtree *mytree=new pkg_subtree(W_("All Packages"), true);
       pkg_grouppolicy *grouper=grouping->instantiate(&selected_signal,
@@ -181,6 +413,56 @@ bool pkg_tree::build_tree(OpProgress &progress)
 
       mytree->set_depth(-1);
 
+      int num = 0;
+      const int total = packages.size();
+
+      for(std::vector<pkgCache::PkgIterator>::const_iterator it = packages.begin();
+	  it != packages.end(); ++it)
+	{
+	  const pkgCache::PkgIterator &pkg = *it;
+
+	  progress.OverallProgress(num, total, 1, _("Building view"));
+	  ++num;
+
+	  // Filter useless packages up-front.
+	  if(pkg.VersionList().end() && pkg.ProvidesList().end())
+	    continue;
+
+	  empty = false;
+	  grouper->add_package(pkg, mytree);
+	}
+
+      progress.OverallProgress(total, total, 1, _("Building view"));
+
+      // Packages at the leaves of the tree are only turned into items
+      // when their group is opened; tell the groups how to sort them.
+      mytree->set_deferred_sorting(sorting);
+      pkg_sortpolicy_wrapper sorter(sorting.get());
+      mytree->sort(sorter);
+
+      set_root(mytree);
+      built_root = mytree;
+
+      delete grouper;
+
+      rval=packages.empty() || !empty;
+    }
+  else
+    rval=true;
+
+  cw::toplevel::update();
+
+  return rval;
+}
+
+bool pkg_tree::build_tree(OpProgress &progress)
+{
+  cancel_background_rebuild();
+
+  std::vector<pkgCache::PkgIterator> packages;
+
+  if(grouping && apt_cache_file)
+    {
       if(limit.valid())
 	{
 	  ref_ptr<matching::search_cache> search_info(matching::search_cache::create());
@@ -191,104 +473,217 @@ bool pkg_tree::build_tree(OpProgress &progress)
 			   *apt_cache_file,
 			   *apt_package_records);
 
-	  int num = 0;
-	  int total = matches.size();
-
+	  packages.reserve(matches.size());
 	  for(std::vector<std::pair<pkgCache::PkgIterator, cwidget::util::ref_ptr<matching::structural_match> > >::const_iterator
 		it = matches.begin(); it != matches.end(); ++it)
-	    {
-	      pkgCache::PkgIterator pkg(it->first);
-
-	      cache_empty = false;
+	    packages.push_back(it->first);
 
-	      progress.OverallProgress(num, total, 1, _("Building view"));
-	      ++num;
-
-	      // Filter useless packages up-front.
-	      if(pkg.VersionList().end() && pkg.ProvidesList().end())
-		continue;
-
-	      empty = false;
-	      grouper->add_package(pkg, mytree);
-	    }
-
-	  progress.OverallProgress(total, total, 1, _("Building view"));
+	  limit_matches = packages;
+	  limit_matches_valid = true;
 	}
       else
 	{
-	  int num = 0;
-	  int total = (*apt_cache_file)->Head().PackageCount;
+	  limit_matches.clear();
+	  limit_matches_valid = false;
 
+	  packages.reserve((*apt_cache_file)->Head().PackageCount);
 	  for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin(); !pkg.end(); ++pkg)
-	    {
-	      cache_empty = false;
+	    packages.push_back(pkg);
+	}
+    }
 
-	      progress.OverallProgress(num, total, 1, _("Building view"));
+  return build_tree_from(packages, progress);
+}
 
-	      ++num;
+bool pkg_tree::build_tree()
+{
+  progress_ref p=gen_progress_bar();
+  bool rval=build_tree(*p->get_progress().unsafe_get_ref());
+  p->destroy();
 
-	      // Filter useless packages up-front.
-	      if(pkg.VersionList().end() && pkg.ProvidesList().end())
-		continue;
+  return rval;
+}
 
-	      empty = false;
-	      grouper->add_package(pkg, mytree);
-	    }
+void pkg_tree::rebuild_in_background(const ref_ptr<matching::pattern> &new_limit,
+				     const std::wstring &new_limitstr,
+				     bool keep_tree_if_unmatched,
+				     const std::vector<pkgCache::PkgIterator> *candidates,
+				     bool quiet)
+{
+  cancel_background_rebuild();
 
-	  progress.OverallProgress(total, total, 1, _("Building view"));
-	}
+  if(!new_limit.valid() || !grouping || !apt_cache_file)
+    {
+      limit = new_limit;
+      limitstr = new_limitstr;
+      build_tree();
+      return;
+    }
 
-      pkg_sortpolicy_wrapper sorter(sorting);
-      mytree->sort(sorter);
+  pending_search =
+    limit_search::start(new_limit, new_limitstr, keep_tree_if_unmatched,
+			quiet, candidates,
+			make_safe_slot(sigc::slot0<void>(sigc::mem_fun(*this, &pkg_tree::background_search_finished))));
+  active_searches.push_back(pending_search);
+}
 
-      set_root(mytree);
+void pkg_tree::cancel_background_rebuild()
+{
+  if(pending_search.get() != NULL)
+    {
+      pending_search->cancel();
+      pending_search.reset();
+    }
+}
 
-      delete grouper;
+void pkg_tree::stop_background_searches()
+{
+  cancel_background_rebuild();
 
-      rval=cache_empty || !empty;
+  for(std::vector<boost::shared_ptr<limit_search> >::const_iterator it =
+	active_searches.begin(); it != active_searches.end(); ++it)
+    {
+      (*it)->cancel();
+      (*it)->join();
     }
-  else
-    rval=true;
 
-  cw::toplevel::update();
-
-  return rval;
+  active_searches.clear();
 }
 
-bool pkg_tree::build_tree()
+void pkg_tree::background_search_finished()
 {
+  // Reap every search that has exited, whether or not its result is
+  // still wanted.
+  std::vector<boost::shared_ptr<limit_search> > still_running;
+  for(std::vector<boost::shared_ptr<limit_search> >::const_iterator it =
+	active_searches.begin(); it != active_searches.end(); ++it)
+    {
+      if((*it)->is_finished())
+	(*it)->join();
+      else
+	still_running.push_back(*it);
+    }
+  active_searches.swap(still_running);
+
+  if(pending_search.get() == NULL || !pending_search->is_finished())
+    return;
+
+  boost::shared_ptr<limit_search> search;
+  search.swap(pending_search);
+
+  if(!search->get_error().empty())
+    {
+      if(!search->get_quiet())
+	show_message(search->get_error());
+      return;
+    }
+
+  const std::vector<pkgCache::PkgIterator> &matches = search->get_matches();
+
+  bool displayable = false;
+  for(std::vector<pkgCache::PkgIterator>::const_iterator it = matches.begin();
+      !displayable && it != matches.end(); ++it)
+    displayable = !it->VersionList().end() || !it->ProvidesList().end();
+
+  if(!displayable && search->get_keep_tree_if_unmatched() &&
+     !aptcfg->FindB(PACKAGE "::UI::Allow-Unmatched-Limit", false))
+    {
+      if(search->get_quiet())
+	return;
+
+      wchar_t buf[512];
+
+      swprintf(buf, 512, W_("No packages matched the pattern \"%ls\".").c_str(),
+	       search->get_limitstr().c_str());
+
+      show_message(buf);
+      return;
+    }
+
+  limit = search->get_limit();
+  limitstr = search->get_limitstr();
+  limit_matches = matches;
+  limit_matches_valid = true;
+
   progress_ref p=gen_progress_bar();
-  bool rval=build_tree(*p->get_progress().unsafe_get_ref());
+  build_tree_from(matches, *p->get_progress().unsafe_get_ref());
   p->destroy();
-
-  return rval;
 }
 
-void pkg_tree::set_limit(const std::wstring &_limit)
+namespace
 {
-  ref_ptr<matching::pattern> old_limit(limit);
-  std::wstring old_limitstr(limitstr);
+  /** \brief Test whether a limit is a single word matched against
+   *  package names.
+   */
+  bool is_plain_name_limit(const std::wstring &s)
+  {
+    if(s.empty())
+      return false;
+
+    for(std::wstring::const_iterator it = s.begin(); it != s.end(); ++it)
+      if(!iswalnum(*it) && *it != L'-')
+	return false;
+
+    return true;
+  }
+
+  std::wstring lowercase(const std::wstring &s)
+  {
+    std::wstring rval(s);
+    for(std::wstring::iterator it = rval.begin(); it != rval.end(); ++it)
+      *it = towlower(*it);
+    return rval;
+  }
+
+  /** \brief Test whether every package matching new_limitstr is
+   *  certain to match old_limitstr.
+   *
+   *  This only recognizes two easy cases: a longer substring of the
+   *  package name, and more terms added to the end of the pattern
+   *  (which are ANDed with it).
+   */
+  bool limit_narrows(const std::wstring &old_limitstr,
+		     const std::wstring &new_limitstr)
+  {
+    if(old_limitstr.empty())
+      return false;
+
+    if(is_plain_name_limit(old_limitstr) && is_plain_name_limit(new_limitstr))
+      return lowercase(new_limitstr).find(lowercase(old_limitstr)) != std::wstring::npos;
+
+    return
+      new_limitstr.size() > old_limitstr.size() &&
+      new_limitstr.compare(0, old_limitstr.size(), old_limitstr) == 0 &&
+      iswspace(new_limitstr[old_limitstr.size()]) &&
+      old_limitstr[old_limitstr.size() - 1] != L'\\' &&
+      new_limitstr.find(L'|', old_limitstr.size()) == std::wstring::npos;
+  }
+}
 
-  ref_ptr<matching::pattern> new_limit(matching::parse(cw::util::transcode(_limit)));
-  if(_limit.empty() || new_limit.valid())
-    {
-      limit=new_limit;
-      limitstr=_limit;
+void pkg_tree::change_limit(const std::wstring &_limit, bool quiet)
+{
+  ref_ptr<matching::pattern> new_limit(quiet
+				       ? matching::parse(cw::util::transcode(_limit), false, true)
+				       : matching::parse(cw::util::transcode(_limit)));
+  if(!_limit.empty() && !new_limit.valid())
+    return;
 
-      if(!build_tree() && !aptcfg->FindB(PACKAGE "::UI::Allow-Unmatched-Limit", false))
-	{
-	  wchar_t buf[512];
+  const bool narrows = limit.valid() && limit_matches_valid &&
+    limit_narrows(limitstr, _limit);
 
-	  swprintf(buf, 512, W_("No packages matched the pattern \"%ls\".").c_str(),
-		   _limit.c_str());
+  rebuild_in_background(new_limit, _limit, true,
+			narrows ? &limit_matches : NULL,
+			quiet);
+}
 
-	  show_message(buf);
-	  limit=old_limit;
-	  limitstr=old_limitstr;
+void pkg_tree::set_limit(const std::wstring &_limit)
+{
+  change_limit(_limit, false);
+}
 
-	  build_tree();
-	}
-    }
+void pkg_tree::preview_limit(std::wstring _limit)
+{
+  change_limit(_limit, true);
 }
 
 bool pkg_tree::find_limit_enabled()
@@ -298,12 +693,23 @@ bool pkg_tree::find_limit_enabled()
 
 bool pkg_tree::find_limit()
 {
-  prompt_string(W_("Enter the new package tree limit: "),
-		limitstr,
-		cw::util::arg(sigc::mem_fun(*this, &pkg_tree::set_limit)),
-		NULL,
-		NULL,
-		&limit_history);
+  if(aptcfg->FindB(PACKAGE "::UI::Incremental-Limit", false))
+    // Show the limit as it's typed; cancelling the prompt puts the
+    // old limit back.
+    prompt_string(W_("Enter the new package tree limit: "),
+		  limitstr,
+		  cw::util::arg(sigc::mem_fun(*this, &pkg_tree::set_limit)),
+		  cw::util::arg(sigc::bind(sigc::mem_fun(*this, &pkg_tree::set_limit),
+					   limitstr)),
+		  cw::util::arg(sigc::mem_fun(*this, &pkg_tree::preview_limit)),
+		  &limit_history);
+  else
+    prompt_string(W_("Enter the new package tree limit: "),
+		  limitstr,
+		  cw::util::arg(sigc::mem_fun(*this, &pkg_tree::set_limit)),
+		  NULL,
+		  NULL,
+		  &limit_history);
 
   return true;
 }
@@ -318,10 +724,7 @@ bool pkg_tree::find_reset_limit()
   if(!get_visible())
     return false;
 
-  limit=NULL;
-  limitstr=L"";
-
-  build_tree();
+  rebuild_in_background(NULL, L"", false);
 
   return true;
 }
@@ -27,6 +27,11 @@
 #include <apt-pkg/pkgcache.h>
 
 #include <generic/apt/matching/pattern.h>
+#include <generic/util/memory_accounting.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
 
 /** \brief Uses the cwidget::widgets::tree classes to display a tree containing packages
  *
@@ -43,6 +48,7 @@ class OpProgress;
 class pkg_grouppolicy;
 class pkg_grouppolicy_factory;
 class pkg_sortpolicy;
+class pkg_subtree;
 class pkg_tree_node;
 class undo_group;
 
@@ -55,7 +61,13 @@ class pkg_tree:public apt_undo_tree
 
   pkg_grouppolicy_factory *grouping;
   std::string groupingstr;
-  pkg_sortpolicy *sorting;
+  /** \brief The current sorting policy.
+   *
+   *  This is shared with the displayed tree, which uses it to sort
+   *  the items it creates lazily, and which can outlive a change of
+   *  policy while its replacement is being built.
+   */
+  boost::shared_ptr<pkg_sortpolicy> sorting;
 
   cwidget::util::ref_ptr<aptitude::matching::pattern> limit;
   std::wstring limitstr;
@@ -63,11 +75,112 @@ class pkg_tree:public apt_undo_tree
   // to be displayed)  This could be a grouping policy, but hardcoding the
   // filter here makes it easier to alter from the UI.
 
+  /** \brief The packages that matched limit when the tree was built.
+   *
+   *  A new limit that only narrows the current one is tested against
+   *  these instead of the whole cache.  Only meaningful if
+   *  limit_matches_valid is \b true.
+   */
+  std::vector<pkgCache::PkgIterator> limit_matches;
+  bool limit_matches_valid;
+
   static cwidget::widgets::editline::history_list limit_history, grouping_history,
     sorting_history;
 
+  class limit_search;
+
+  /** \brief The limit searches running in the background, including
+   *  ones that were superseded and are waiting to be joined.
+   */
+  std::vector<boost::shared_ptr<limit_search> > active_searches;
+
+  /** \brief The search whose result should replace the tree when it
+   *  finishes, or NULL.
+   */
+  boost::shared_ptr<limit_search> pending_search;
+
+  /** \brief Search for the packages matching new_limit in a
+   *  background thread, then rebuild the tree from them and make
+   *  new_limit the current limit.
+   *
+   *  The current tree stays on screen until then.  Starting another
+   *  rebuild (in the background or not) cancels this one.  Without a
+   *  limit there is nothing to search for, so the tree is rebuilt
+   *  immediately.
+   *
+   *  If keep_tree_if_unmatched is \b true, new_limit matches no
+   *  package that can be displayed and Aptitude::UI::Allow-Unmatched-Limit
+   *  isn't set, the user is told so and the tree and limit are left
+   *  alone.
+   *
+   *  \param candidates  If not NULL, only these packages are tested
+   *                     against new_limit; it must be certain that no
+   *                     other package matches.
+   *  \param quiet       If \b true, don't tell the user about errors
+   *                     or unmatched limits; just leave the tree
+   *                     alone.
+   */
+  void rebuild_in_background(const cwidget::util::ref_ptr<aptitude::matching::pattern> &new_limit,
+			     const std::wstring &new_limitstr,
+			     bool keep_tree_if_unmatched,
+			     const std::vector<pkgCache::PkgIterator> *candidates = NULL,
+			     bool quiet = false);
+
+  /** \brief Switch to a new limit, searching only the current
+   *  matches if the new limit narrows the current one.
+   */
+  void change_limit(const std::wstring &_limit, bool quiet);
+
+  /** \brief Show the limit being typed into the limit prompt. */
+  void preview_limit(std::wstring _limit);
+
+  /** \brief Ask the pending search, if any, to stop, and forget its
+   *  result.
+   */
+  void cancel_background_rebuild();
+
+  /** \brief Invoked in the main thread when a background search
+   *  finishes.
+   */
+  void background_search_finished();
+
+  /** \brief Cancel all the background searches and wait for them to
+   *  exit.
+   */
+  void stop_background_searches();
+
+  /** \brief Replace the tree by the given packages, grouped and
+   *  sorted.
+   *
+   *  \return \b false if none of the packages can be displayed.
+   */
+  bool build_tree_from(const std::vector<pkgCache::PkgIterator> &packages,
+		       OpProgress &progress);
+
   void handle_cache_close();
 
+  /** \brief If \b true, prefetch_adjacent_descriptions() has been
+   *  queued and hasn't run yet.
+   */
+  bool description_prefetch_pending;
+
+  /** \brief The root of the tree built by build_tree_from(), or NULL
+   *  if the tree is empty.  Owned by the tree widget.
+   */
+  pkg_subtree *built_root;
+
+  /** \brief Reports the memory used by this view. */
+  aptitude::util::memory_account account;
+
+  void account_memory(aptitude::util::memory_report &report);
+
+  void handle_selection_changed(cwidget::widgets::treeitem *item);
+
+  /** \brief Parse the descriptions of the rows next to the cursor, so
+   *  that they're ready when the cursor moves onto them.
+   */
+  void prefetch_adjacent_descriptions();
+
   /** Set up the limit and handle a few other things. */
   void init(const char *limitstr);
 protected:
@@ -133,6 +246,8 @@ public:
   void set_grouping(pkg_grouppolicy_factory *_grouping);
   void set_grouping(const std::wstring &s);
   void set_sorting(pkg_sortpolicy *_sorting);
+  /** \brief Sort by a policy that may be shared with other views. */
+  void set_sorting(const boost::shared_ptr<pkg_sortpolicy> &_sorting);
   void set_sorting(const std::wstring &s);
   void set_limit(const std::wstring &_limit);
   // Selects a new limit and rebuilds the tree.
@@ -36,6 +36,7 @@
 #include <generic/apt/apt.h>
 #include <generic/apt/apt_undo_group.h>
 #include <generic/apt/config_signal.h>
+#include <generic/apt/config_snapshot.h>
 
 #include <cwidget/generic/util/ssprintf.h>
 #include <cwidget/toplevel.h>
@@ -75,9 +76,9 @@ cw::column_disposition pkg_ver_columnizer::setup_column(const pkgCache::VerItera
       if(ver.end())
 	return cw::column_disposition("", 0);
       else if(show_pkg_name)
-	return cw::column_disposition(string(ver.ParentPkg().FullName(true))+" "+ver.VerStr(), basex);
+	return cw::column_disposition(get_wide_full_name(ver.ParentPkg()) + L" " + get_wide_version_string(ver), basex);
       else
-	return cw::column_disposition(ver.VerStr(), basex);
+	return cw::column_disposition(get_wide_version_string(ver), basex);
 
       break;
 
@@ -250,7 +251,7 @@ cw::column_disposition pkg_ver_columnizer::setup_column(const pkgCache::VerItera
 
 	if(state.Status!=2 && estate.selection_state==pkgCache::State::Hold && !state.NowBroken())
 	  return cw::column_disposition("h", 0);
-	else if(ver.VerStr() == estate.forbidver)
+	else if(ver.VerStr() == estate.forbidver.get())
 	  return cw::column_disposition("F", 0);
 	else if(state.Delete())
 	  return cw::column_disposition((state.iFlags&pkgDepCache::Purge)?"p":"d", 0);
@@ -293,7 +294,7 @@ cw::column_disposition pkg_ver_columnizer::setup_column(const pkgCache::VerItera
 	aptitudeDepCache::aptitude_state &estate=(*apt_cache_file)->get_ext_state(ver.ParentPkg());
 	if(state.Status!=2 && (state.Held() || estate.selection_state==pkgCache::State::Hold) && !state.NowBroken())
 	  return cw::column_disposition(_("hold"), 0);
-	else if(ver.VerStr() == estate.forbidver)
+	else if(ver.VerStr() == estate.forbidver.get())
 	  return cw::column_disposition("forbidden version", 0);
 	else if(state.Delete())
 	  return cw::column_disposition((state.iFlags&pkgDepCache::Purge)?"p":"d", 0);
@@ -374,7 +375,7 @@ cw::column_disposition pkg_ver_columnizer::setup_column(const pkgCache::VerItera
 	return cw::column_disposition("", 0);
 
       if(ver.Section())
-	return cw::column_disposition(ver.Section(), 0);
+	return cw::column_disposition(get_wide_cache_string(ver.Section()), 0);
       else
 	return cw::column_disposition(_("Unknown"), 0);
 
@@ -607,7 +608,7 @@ void pkg_ver_item::select(undo_group *undo)
     {
       undo_group *grp=undo?new apt_undo_group:NULL;
       (*apt_cache_file)->set_candidate_version(version, grp);
-      (*apt_cache_file)->mark_install(version.ParentPkg(), _config->FindB(PACKAGE "::Auto-Install", true), false, grp);
+      (*apt_cache_file)->mark_install(version.ParentPkg(), aptitude::apt::get_config_snapshot().auto_install, false, grp);
 
       if(undo)
 	undo->add_item(grp);
@@ -654,7 +655,7 @@ void pkg_ver_item::reinstall(undo_group *undo)
 {
   if(version.ParentPkg().CurrentVer()==version)
     (*apt_cache_file)->mark_install(version.ParentPkg(),
-				    aptcfg->FindB(PACKAGE "::Auto-Install", true),
+				    aptitude::apt::get_config_snapshot().auto_install,
 				    true,
 				    undo);
 }
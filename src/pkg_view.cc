@@ -244,9 +244,11 @@ public:
   {
     // Check against pkg.end() to hack around #339533; if ver is a
     // default iterator, pkg.end() is true.
-    wstring newdesc(pkg.end() ? L"" : get_long_description(ver, apt_package_records));
+    std::vector<aptitude::description_element_ref> elements;
+    if(!pkg.end())
+      aptitude::get_parsed_long_description(ver, elements);
 
-    cw::fragment *frag=make_desc_fragment(newdesc);
+    cw::fragment *frag=aptitude::make_desc_fragment(elements);
 
 #ifdef APT_HAS_HOMEPAGE
     cw::fragment *homepage;
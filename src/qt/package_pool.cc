@@ -23,6 +23,8 @@
 #include "package.h"
 
 #include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+#include <generic/apt/package_state_snapshot.h>
 
 // System includes
 #include "vector"
@@ -33,10 +35,50 @@ namespace aptitude
   {
     namespace qt
     {
+      namespace
+      {
+        /** \brief How many package objects the pool keeps alive.
+         *
+         *  This should comfortably exceed the number of packages a
+         *  view displays at once.
+         */
+        const std::size_t package_cache_size = 512;
+      }
+
       class package_pool::package_pool_impl : public package_pool,
                                               public sigc::trackable
       {
-	std::vector<package_ptr> packages;
+	/** \brief The IDs of the packages in the pool, in cache order. */
+	std::vector<unsigned long> package_ids;
+
+	/** \brief The index in package_ids of each package, by ID, or
+	 *  -1 if the package was filtered out.
+	 */
+	std::vector<int> index_by_id;
+
+	/** \brief The package objects that have been created recently.
+	 *
+	 *  Objects are only created when they're asked for, and the pool
+	 *  only holds on to the last package_cache_size of them; clients
+	 *  keep the ones they display alive with their own references.
+	 */
+	std::vector<package_ptr> cached_packages;
+
+	/** \brief The slot in cached_packages of each package, by ID, or
+	 *  -1.
+	 */
+	std::vector<int> slot_by_id;
+
+	/** \brief The next slot of cached_packages to reuse. */
+	std::size_t next_slot;
+
+	/** \brief Get the package object for a package in the pool,
+	 *  creating it if necessary.
+	 */
+	package_ptr get_cached_package(unsigned long id);
+
+	/** \brief The package states as of the last state change. */
+	aptitude::apt::package_state_snapshot_ptr last_snapshot;
 
 	/** \brief Metod invoked after cache reloading.
 	 *
@@ -74,9 +116,16 @@ namespace aptitude
 	/** \brief Retrieve a pointer to package at given index. */
 	package_ptr get_package_at_index(unsigned int index);
 
+	/** \brief Retrieve the ID of the package at given index. */
+	unsigned long get_package_id_at_index(unsigned int index);
+
+	/** \brief Retrieve the name of the package at given index. */
+	const char *get_package_name_at_index(unsigned int index);
+
 	sigc::signal0<void> cache_closed_signal;
 	sigc::signal0<void> cache_reloaded_signal;
 	sigc::signal1<void, std::vector<package_ptr> > cache_state_changed_signal;
+	sigc::signal1<void, const std::vector<package_change_range> &> package_ranges_changed_signal;
 
 	/** \brief Register a slot to be invoked when the apt cache is reloaded. */
 	sigc::connection connect_cache_reloaded(const sigc::slot<void> &slot);
@@ -86,9 +135,13 @@ namespace aptitude
 
 	/** \brief Register a slot to be invoked when the state of packages changes. */
 	sigc::connection connect_cache_state_changed(const sigc::slot<void, std::vector<package_ptr> > &slot);
+
+	/** \brief Register a slot to be invoked with the ranges of packages whose state changed. */
+	sigc::connection connect_package_ranges_changed(const sigc::slot<void, const std::vector<package_change_range> &> &slot);
       };
 
       package_pool::package_pool_impl::package_pool_impl()
+        : next_slot(0)
       {
 	cache_closed.connect(sigc::mem_fun(*this, &package_pool::package_pool_impl::handle_cache_closed));
         cache_reloaded.connect(sigc::mem_fun(*this, &package_pool::package_pool_impl::handle_cache_reloaded));
@@ -107,7 +160,9 @@ namespace aptitude
 
 	(*apt_cache_file)->package_state_changed.connect(sigc::mem_fun(*this, &package_pool::package_pool_impl::cache_state_changed));
 
-	packages.reserve((*apt_cache_file)->Head().PackageCount);
+	package_ids.reserve((*apt_cache_file)->Head().PackageCount);
+	index_by_id.assign((*apt_cache_file)->Head().PackageCount, -1);
+	slot_by_id.assign((*apt_cache_file)->Head().PackageCount, -1);
 
 	for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin(); !pkg.end(); ++pkg)
           {
@@ -115,9 +170,12 @@ namespace aptitude
             if(pkg.VersionList().end() && pkg.ProvidesList().end())
               continue;
 
-            packages.push_back(package::create(pkg));
+            index_by_id[pkg->ID] = package_ids.size();
+            package_ids.push_back(pkg->ID);
           }
 
+	last_snapshot = (*apt_cache_file)->get_state_snapshot();
+
 	cache_reloaded_signal();
       }
 
@@ -125,27 +183,132 @@ namespace aptitude
       {
 	cache_closed_signal();
 
-	packages.clear();
+	package_ids.clear();
+	index_by_id.clear();
+	cached_packages.clear();
+	slot_by_id.clear();
+	next_slot = 0;
+	last_snapshot.reset();
       }
 
       void package_pool::package_pool_impl::cache_state_changed()
       {
-	// TODO
+	const aptitude::apt::package_state_snapshot_ptr snapshot =
+	  (*apt_cache_file)->get_state_snapshot();
+
+	if(snapshot == last_snapshot)
+	  return;
+
+	// Comparing the snapshots only looks at the parts of the cache
+	// that changed, so this is cheap even though the signal doesn't
+	// say which packages it's about.
+	std::vector<unsigned long> changed_ids;
+	std::vector<unsigned int> changed_masks;
+	if(last_snapshot.get() != NULL && snapshot.get() != NULL)
+	  snapshot->find_changes(*last_snapshot, changed_ids, &changed_masks);
+	last_snapshot = snapshot;
+
+	// Merge packages that are next to each other in the pool and
+	// changed in the same way, so that applying a solution that
+	// touches thousands of packages produces a short list.
+	std::vector<package_change_range> ranges;
+	for(std::size_t i = 0; i < changed_ids.size(); ++i)
+	  {
+	    const unsigned long id = changed_ids[i];
+	    if(id >= index_by_id.size() || index_by_id[id] < 0)
+	      continue;
+
+	    const unsigned int index = index_by_id[id];
+	    if(!ranges.empty() &&
+	       ranges.back().end == index &&
+	       ranges.back().changes == changed_masks[i])
+	      ++ranges.back().end;
+	    else
+	      {
+		package_change_range range;
+		range.begin = index;
+		range.end = index + 1;
+		range.changes = changed_masks[i];
+		ranges.push_back(range);
+	      }
+	  }
+
+	if(!ranges.empty())
+	  package_ranges_changed_signal(ranges);
+
+	// Package objects remember what they've computed, so replace
+	// the ones that changed.  Packages without an object don't need
+	// to be reported: nobody can be displaying them.
+	pkgCache &cache((*apt_cache_file)->GetCache());
+	std::vector<package_ptr> changed;
+	for(std::vector<unsigned long>::const_iterator it = changed_ids.begin();
+	    it != changed_ids.end(); ++it)
+	  if(*it < slot_by_id.size() && slot_by_id[*it] >= 0)
+	    {
+	      package_ptr &p(cached_packages[slot_by_id[*it]]);
+	      p = package::create(pkgCache::PkgIterator(cache, cache.PkgP + *it));
+	      changed.push_back(p);
+	    }
+
+	if(!changed.empty())
+	  cache_state_changed_signal(changed);
+      }
+
+      package_ptr package_pool::package_pool_impl::get_cached_package(unsigned long id)
+      {
+	int slot = slot_by_id[id];
+	if(slot >= 0)
+	  return cached_packages[slot];
+
+	if(cached_packages.size() < package_cache_size)
+	  {
+	    slot = cached_packages.size();
+	    cached_packages.push_back(package_ptr());
+	  }
+	else
+	  {
+	    slot = next_slot;
+	    next_slot = (next_slot + 1) % cached_packages.size();
+	    slot_by_id[cached_packages[slot]->get_pkg()->ID] = -1;
+	  }
+
+	pkgCache &cache((*apt_cache_file)->GetCache());
+	cached_packages[slot] = package::create(pkgCache::PkgIterator(cache, cache.PkgP + id));
+	slot_by_id[id] = slot;
+
+	return cached_packages[slot];
       }
 
       int package_pool::package_pool_impl::get_packages_count()
       {
-	return packages.size();
+	return package_ids.size();
       }
 
       package_ptr package_pool::package_pool_impl::get_package_at_index(unsigned int index)
       {
-	if(index >= 0 && index < packages.size())
-	  return packages.at(index);
+	if(index < package_ids.size())
+	  return get_cached_package(package_ids[index]);
 
 	return package_ptr();
       }
 
+      unsigned long package_pool::package_pool_impl::get_package_id_at_index(unsigned int index)
+      {
+	if(index < package_ids.size())
+	  return package_ids[index];
+
+	return (unsigned long)-1;
+      }
+
+      const char *package_pool::package_pool_impl::get_package_name_at_index(unsigned int index)
+      {
+	if(index >= package_ids.size())
+	  return NULL;
+
+	pkgCache &cache((*apt_cache_file)->GetCache());
+	return cache.StrP + cache.PkgP[package_ids[index]].Name;
+      }
+
       sigc::connection
       package_pool::package_pool_impl::connect_cache_reloaded(const sigc::slot<void> &slot)
       {
@@ -164,6 +327,12 @@ namespace aptitude
 	return cache_state_changed_signal.connect(slot);
       }
 
+      sigc::connection
+      package_pool::package_pool_impl::connect_package_ranges_changed(const sigc::slot<void, const std::vector<package_change_range> &> &slot)
+      {
+	return package_ranges_changed_signal.connect(slot);
+      }
+
       package_pool *package_pool::get_instance()
       {
 	static package_pool_impl instance;
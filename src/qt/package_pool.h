@@ -37,12 +37,38 @@ namespace aptitude
       class package;
       typedef boost::shared_ptr<package> package_ptr;
 
+      /** \brief A run of neighbouring packages in the pool whose
+       *  states changed in the same way.
+       */
+      struct package_change_range
+      {
+	/** \brief The index of the first package in the run. */
+	unsigned int begin;
+
+	/** \brief One past the index of the last package in the run. */
+	unsigned int end;
+
+	/** \brief Which parts of the states changed, as a combination
+	 *  of aptitude::apt::package_state_snapshot::state_change bits.
+	 */
+	unsigned int changes;
+      };
+
       /** \brief A global pool of package objects.
        *
        *  The pool is filled when the object is created or when the
        *  cache is (re)loaded, and it is emptied when the cache is
        *  closed.
        *
+       *  The pool itself only stores the ID of each package.  Package
+       *  objects are created the first time they are retrieved, and
+       *  the pool only keeps the most recently retrieved ones alive;
+       *  hold on to the pointers of the packages being displayed.
+       *  Code that only needs the name or ID of a package, such as
+       *  code that sorts the whole pool, should use
+       *  get_package_name_at_index() and get_package_id_at_index(),
+       *  which don't create a package object.
+       *
        *  This pool also interprets signals for the benefit of its
        *  client code.
        */
@@ -76,6 +102,24 @@ namespace aptitude
          */
 	virtual package_ptr get_package_at_index(unsigned int index) = 0;
 
+	/** \brief Retrieve the ID of the package at given index.
+         *
+         *  \return the Pkg->ID of the package at index if index is
+         *  between 0 and get_packages_count() - 1, and (unsigned
+         *  long)-1 otherwise.
+         */
+	virtual unsigned long get_package_id_at_index(unsigned int index) = 0;
+
+	/** \brief Retrieve the name of the package at given index.
+         *
+         *  The name is read from the package cache, so it is only
+         *  valid until the cache is closed.
+         *
+         *  \return the name of the package at index if index is
+         *  between 0 and get_packages_count() - 1, and NULL otherwise.
+         */
+	virtual const char *get_package_name_at_index(unsigned int index) = 0;
+
 	/** \brief Register a slot to be invoked when the apt cache is reloaded.
          *
          *  The slot is guaranteed to be invoked after the pool has
@@ -92,8 +136,24 @@ namespace aptitude
 
 	/** \brief Register a slot to be invoked when the state of one
          *  or more packages changes.
+         *
+         *  The slot receives new objects for the packages that changed,
+         *  replacing the ones the pool handed out before; only packages
+         *  whose objects are still held by the pool are reported.
          */
 	virtual sigc::connection connect_cache_state_changed(const sigc::slot<void, std::vector<package_ptr> > &slot) = 0;
+
+	/** \brief Register a slot to be invoked with the indices of the
+         *  packages whose states changed.
+         *
+         *  Unlike connect_cache_state_changed(), every package that
+         *  changed is reported, whether or not it has an object, and
+         *  no objects are created.  The ranges are in increasing order
+         *  and don't overlap; a model can use the change bits to skip
+         *  rows whose displayed columns are unaffected, and to re-sort
+         *  only the rows that changed.
+         */
+	virtual sigc::connection connect_package_ranges_changed(const sigc::slot<void, const std::vector<package_change_range> &> &slot) = 0;
       };
     }
   }
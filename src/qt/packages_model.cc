@@ -0,0 +1,431 @@
+/** \file packages_model.cc */
+//
+// Copyright (C) 2010 Piotr Galiszewski
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+// Local includes
+#include "packages_model.h"
+
+#include "aptitude.h"
+
+#include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+#include <generic/apt/matching/match.h>
+#include <generic/apt/matching/pattern.h>
+#include <generic/apt/package_state_snapshot.h>
+
+// System includes
+#include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/version.h>
+
+#include <sigc++/functors/mem_fun.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+using aptitude::apt::package_state_snapshot;
+using cwidget::util::ref_ptr;
+
+namespace aptitude
+{
+  namespace gui
+  {
+    namespace qt
+    {
+      namespace
+      {
+	/** \brief Orders pool indices by the string stored for each
+	 *  of them.  Missing strings come first.
+	 */
+	class value_less
+	{
+	  const std::vector<const char *> *values;
+	  bool versions;
+
+	public:
+	  value_less(const std::vector<const char *> &_values, bool _versions)
+	    : values(&_values), versions(_versions)
+	  {
+	  }
+
+	  bool operator()(unsigned int a, unsigned int b) const
+	  {
+	    const char * const value_a = (*values)[a];
+	    const char * const value_b = (*values)[b];
+
+	    if(value_a == NULL || value_b == NULL)
+	      return value_a == NULL && value_b != NULL;
+	    else if(versions)
+	      return _system->VS->CmpVersion(value_a, value_b) < 0;
+	    else
+	      return strcmp(value_a, value_b) < 0;
+	  }
+	};
+
+	/** \brief Orders pool indices by their sort rank.  Ties are
+	 *  broken by pool index, in both directions, so that equal
+	 *  packages stay in the same order.
+	 */
+	class rank_less
+	{
+	  const std::vector<unsigned int> *ranks;
+	  bool descending;
+
+	public:
+	  rank_less(const std::vector<unsigned int> &_ranks, bool _descending)
+	    : ranks(&_ranks), descending(_descending)
+	  {
+	  }
+
+	  bool operator()(unsigned int a, unsigned int b) const
+	  {
+	    const unsigned int rank_a = (*ranks)[a];
+	    const unsigned int rank_b = (*ranks)[b];
+
+	    if(rank_a != rank_b)
+	      return descending ? rank_a > rank_b : rank_a < rank_b;
+	    else
+	      return a < b;
+	  }
+	};
+      }
+
+      packages_model::packages_model(QObject *parent)
+	: QAbstractTableModel(parent),
+	  sort_column(column_name),
+	  sort_order(Qt::AscendingOrder)
+      {
+	package_pool *pool = package_pool::get_instance();
+
+	pool->connect_cache_reloaded(sigc::mem_fun(*this, &packages_model::handle_cache_reloaded));
+	pool->connect_cache_closed(sigc::mem_fun(*this, &packages_model::handle_cache_closed));
+	pool->connect_package_ranges_changed(sigc::mem_fun(*this, &packages_model::handle_package_ranges_changed));
+
+	rebuild();
+      }
+
+      packages_model::~packages_model()
+      {
+      }
+
+      void packages_model::load_versions(unsigned int begin, unsigned int end)
+      {
+	package_pool *pool = package_pool::get_instance();
+	aptitudeDepCache &depcache(*apt_cache_file);
+	pkgCache &cache(depcache.GetCache());
+
+	for(unsigned int i = begin; i < end; ++i)
+	  {
+	    const pkgCache::PkgIterator pkg(cache, cache.PkgP + pool->get_package_id_at_index(i));
+
+	    const pkgCache::VerIterator current(pkg.CurrentVer());
+	    current_versions[i] = current.end() ? NULL : current.VerStr();
+
+	    const pkgCache::VerIterator candidate(depcache[pkg].CandidateVerIter(depcache));
+	    candidate_versions[i] = candidate.end() ? NULL : candidate.VerStr();
+	  }
+      }
+
+      void packages_model::compute_sort_ranks(int column)
+      {
+	std::vector<unsigned int> &ranks(sort_ranks[column]);
+	if(!ranks.empty())
+	  return;
+
+	package_pool *pool = package_pool::get_instance();
+	const unsigned int count = pool->get_packages_count();
+
+	std::vector<const char *> names;
+	const std::vector<const char *> *values;
+	switch(column)
+	  {
+	  case column_current_version:
+	    values = &current_versions;
+	    break;
+	  case column_candidate_version:
+	    values = &candidate_versions;
+	    break;
+	  default:
+	    names.reserve(count);
+	    for(unsigned int i = 0; i < count; ++i)
+	      names.push_back(pool->get_package_name_at_index(i));
+	    values = &names;
+	    break;
+	  }
+
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	for(unsigned int i = 0; i < count; ++i)
+	  order.push_back(i);
+
+	const value_less less(*values, column != column_name);
+	std::sort(order.begin(), order.end(), less);
+
+	ranks.resize(count);
+	unsigned int rank = 0;
+	for(unsigned int i = 0; i < count; ++i)
+	  {
+	    if(i > 0 && less(order[i - 1], order[i]))
+	      ++rank;
+	    ranks[order[i]] = rank;
+	  }
+      }
+
+      void packages_model::compute_matches()
+      {
+	matched_ids.clear();
+
+	if(!filter.valid())
+	  return;
+
+	std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<aptitude::matching::structural_match> > > matches;
+	aptitude::matching::search(filter,
+				   aptitude::matching::search_cache::create(),
+				   matches,
+				   *apt_cache_file,
+				   *apt_package_records);
+
+	matched_ids.assign((*apt_cache_file)->Head().PackageCount, false);
+	for(std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<aptitude::matching::structural_match> > >::const_iterator
+	      it = matches.begin(); it != matches.end(); ++it)
+	  matched_ids[it->first->ID] = true;
+      }
+
+      void packages_model::compute_rows()
+      {
+	package_pool *pool = package_pool::get_instance();
+	const unsigned int count = pool->get_packages_count();
+
+	rows.clear();
+	if(matched_ids.empty())
+	  {
+	    rows.reserve(count);
+	    for(unsigned int i = 0; i < count; ++i)
+	      rows.push_back(i);
+	  }
+	else
+	  for(unsigned int i = 0; i < count; ++i)
+	    if(matched_ids[pool->get_package_id_at_index(i)])
+	      rows.push_back(i);
+      }
+
+      void packages_model::sort_rows()
+      {
+	compute_sort_ranks(sort_column);
+	std::sort(rows.begin(), rows.end(),
+		  rank_less(sort_ranks[sort_column],
+			    sort_order == Qt::DescendingOrder));
+      }
+
+      void packages_model::update_persistent_indexes(const std::vector<unsigned int> &old_rows)
+      {
+	const QModelIndexList old_indexes(persistentIndexList());
+	if(old_indexes.isEmpty())
+	  return;
+
+	std::vector<int> row_by_index(package_pool::get_instance()->get_packages_count(), -1);
+	for(unsigned int row = 0; row < rows.size(); ++row)
+	  row_by_index[rows[row]] = row;
+
+	QModelIndexList new_indexes;
+	for(QModelIndexList::const_iterator it = old_indexes.begin();
+	    it != old_indexes.end(); ++it)
+	  {
+	    const int row = row_by_index[old_rows[it->row()]];
+	    new_indexes.append(row < 0 ? QModelIndex() : index(row, it->column()));
+	  }
+
+	changePersistentIndexList(old_indexes, new_indexes);
+      }
+
+      void packages_model::rebuild()
+      {
+	beginResetModel();
+
+	rows.clear();
+	matched_ids.clear();
+	current_versions.clear();
+	candidate_versions.clear();
+	for(int i = 0; i < num_columns; ++i)
+	  sort_ranks[i].clear();
+
+	if(apt_cache_file != NULL && apt_package_records != NULL)
+	  {
+	    const unsigned int count = package_pool::get_instance()->get_packages_count();
+	    current_versions.assign(count, NULL);
+	    candidate_versions.assign(count, NULL);
+	    load_versions(0, count);
+
+	    compute_matches();
+	    compute_rows();
+	    sort_rows();
+	  }
+
+	endResetModel();
+      }
+
+      void packages_model::handle_cache_reloaded()
+      {
+	rebuild();
+      }
+
+      void packages_model::handle_cache_closed()
+      {
+	beginResetModel();
+
+	rows.clear();
+	matched_ids.clear();
+	current_versions.clear();
+	candidate_versions.clear();
+	for(int i = 0; i < num_columns; ++i)
+	  sort_ranks[i].clear();
+
+	endResetModel();
+      }
+
+      void packages_model::handle_package_ranges_changed(const std::vector<package_change_range> &ranges)
+      {
+	bool versions_changed = false;
+	for(std::vector<package_change_range>::const_iterator it = ranges.begin();
+	    it != ranges.end(); ++it)
+	  if((it->changes & package_state_snapshot::changed_versions) != 0)
+	    {
+	      load_versions(it->begin, it->end);
+	      versions_changed = true;
+	    }
+
+	if(!versions_changed)
+	  return;
+
+	sort_ranks[column_current_version].clear();
+	sort_ranks[column_candidate_version].clear();
+
+	if(sort_column != column_name)
+	  {
+	    Q_EMIT(layoutAboutToBeChanged());
+	    const std::vector<unsigned int> old_rows(rows);
+	    sort_rows();
+	    update_persistent_indexes(old_rows);
+	    Q_EMIT(layoutChanged());
+	  }
+
+	if(!rows.empty())
+	  Q_EMIT(dataChanged(index(0, column_current_version),
+			     index(rows.size() - 1, column_candidate_version)));
+      }
+
+      void packages_model::set_filter(const ref_ptr<aptitude::matching::pattern> &p)
+      {
+	filter = p;
+
+	if(apt_cache_file == NULL || apt_package_records == NULL)
+	  return;
+
+	beginResetModel();
+	compute_matches();
+	compute_rows();
+	sort_rows();
+	endResetModel();
+      }
+
+      package_ptr packages_model::get_package_at_row(int row) const
+      {
+	if(row < 0 || (unsigned int)row >= rows.size())
+	  return package_ptr();
+
+	return package_pool::get_instance()->get_package_at_index(rows[row]);
+      }
+
+      int packages_model::rowCount(const QModelIndex &parent) const
+      {
+	return parent.isValid() ? 0 : rows.size();
+      }
+
+      int packages_model::columnCount(const QModelIndex &parent) const
+      {
+	return parent.isValid() ? 0 : num_columns;
+      }
+
+      QVariant packages_model::data(const QModelIndex &index, int role) const
+      {
+	if(!index.isValid() || role != Qt::DisplayRole ||
+	   index.row() < 0 || (unsigned int)index.row() >= rows.size())
+	  return QVariant();
+
+	const unsigned int pool_index = rows[index.row()];
+	const char *value;
+	switch(index.column())
+	  {
+	  case column_name:
+	    value = package_pool::get_instance()->get_package_name_at_index(pool_index);
+	    break;
+	  case column_current_version:
+	    value = current_versions[pool_index];
+	    break;
+	  case column_candidate_version:
+	    value = candidate_versions[pool_index];
+	    break;
+	  default:
+	    return QVariant();
+	  }
+
+	return value == NULL ? QVariant() : QVariant(QString::fromUtf8(value));
+      }
+
+      QVariant packages_model::headerData(int section, Qt::Orientation orientation, int role) const
+      {
+	if(orientation != Qt::Horizontal || role != Qt::DisplayRole)
+	  return QVariant();
+
+	switch(section)
+	  {
+	  case column_name:
+	    return QString(_("Name"));
+	  case column_current_version:
+	    return QString(_("Installed Version"));
+	  case column_candidate_version:
+	    return QString(_("Candidate Version"));
+	  default:
+	    return QVariant();
+	  }
+      }
+
+      void packages_model::sort(int column, Qt::SortOrder order)
+      {
+	if(column < 0 || column >= num_columns)
+	  return;
+
+	if(column == sort_column && order == sort_order)
+	  return;
+
+	Q_EMIT(layoutAboutToBeChanged());
+
+	sort_column = column;
+	sort_order = order;
+
+	const std::vector<unsigned int> old_rows(rows);
+	sort_rows();
+	update_persistent_indexes(old_rows);
+
+	Q_EMIT(layoutChanged());
+      }
+    }
+  }
+}
+
+#include "packages_model.moc"
@@ -0,0 +1,167 @@
+/** \file packages_model.h */   // -*-c++-*-
+//
+// Copyright (C) 2010 Piotr Galiszewski
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+#ifndef APTITUDE_QT_PACKAGES_MODEL_H
+#define APTITUDE_QT_PACKAGES_MODEL_H
+
+// Local includes
+#include "package_pool.h"
+
+// System includes
+#include <QtCore/QAbstractTableModel>
+
+#include <cwidget/generic/util/ref_ptr.h>
+
+#include <sigc++/trackable.h>
+
+#include <vector>
+
+namespace aptitude
+{
+  namespace matching
+  {
+    class pattern;
+  }
+
+  namespace gui
+  {
+    namespace qt
+    {
+      /** \brief A flat model of the packages in the package pool,
+       *  restricted by an optional search pattern.
+       *
+       *  Filtering and sorting never look at package objects.  The
+       *  pattern is matched against the whole cache in one pass, and
+       *  its results are stored as a bitmap indexed by package ID;
+       *  each column is sorted by an integer rank per pool index,
+       *  computed the first time the column is sorted on and kept
+       *  until the cache or the ranked values change.  Changing the
+       *  filter or the sort order is then a single pass over the pool
+       *  and a sort of integers.
+       */
+      class packages_model : public QAbstractTableModel, public sigc::trackable
+      {
+	Q_OBJECT
+
+      public:
+	enum column
+	  {
+	    /** \brief The name of the package. */
+	    column_name,
+	    /** \brief The installed version of the package. */
+	    column_current_version,
+	    /** \brief The candidate version of the package. */
+	    column_candidate_version,
+	    num_columns
+	  };
+
+      private:
+	cwidget::util::ref_ptr<aptitude::matching::pattern> filter;
+
+	/** \brief Which packages match the filter, indexed by
+	 *  Pkg->ID.  Empty if there is no filter.
+	 */
+	std::vector<bool> matched_ids;
+
+	/** \brief The pool indices of the displayed packages, in
+	 *  display order.
+	 */
+	std::vector<unsigned int> rows;
+
+	/** \brief The version strings displayed in each version
+	 *  column, indexed by pool index.  NULL if the package has no
+	 *  such version.
+	 */
+	std::vector<const char *> current_versions;
+	std::vector<const char *> candidate_versions;
+
+	/** \brief The sort rank of each pool index in each column.
+	 *
+	 *  Packages whose values compare equal have the same rank.  A
+	 *  column's vector is empty until it is needed and is cleared
+	 *  when its values change.
+	 */
+	std::vector<unsigned int> sort_ranks[num_columns];
+
+	int sort_column;
+	Qt::SortOrder sort_order;
+
+	/** \brief Load the displayed version strings from the cache. */
+	void load_versions(unsigned int begin, unsigned int end);
+
+	/** \brief Compute sort_ranks[column] if it is missing. */
+	void compute_sort_ranks(int column);
+
+	/** \brief Run the filter and store its results in matched_ids. */
+	void compute_matches();
+
+	/** \brief Rebuild rows from matched_ids, in pool order. */
+	void compute_rows();
+
+	/** \brief Sort rows according to sort_column and sort_order. */
+	void sort_rows();
+
+	/** \brief Move the persistent indexes of the model after the rows
+	 *  were reordered.
+	 *
+	 *  \param old_rows  The contents of rows before it was reordered.
+	 */
+	void update_persistent_indexes(const std::vector<unsigned int> &old_rows);
+
+	/** \brief Reset the model from the current contents of the pool. */
+	void rebuild();
+
+	void handle_cache_reloaded();
+	void handle_cache_closed();
+	void handle_package_ranges_changed(const std::vector<package_change_range> &ranges);
+
+      public:
+	/** \brief Create a new packages_model displaying every package
+	 *  in the pool, sorted by name.
+	 */
+	explicit packages_model(QObject *parent = 0);
+
+	virtual ~packages_model();
+
+	/** \brief Display only the packages that match the given
+	 *  pattern.
+	 *
+	 *  The pattern is matched once, when it is set and when the
+	 *  cache is reloaded; it is not matched again when the states
+	 *  of packages change.
+	 *
+	 *  \param p  The pattern to match, or an invalid pointer to
+	 *            display every package.
+	 */
+	void set_filter(const cwidget::util::ref_ptr<aptitude::matching::pattern> &p);
+
+	/** \brief Retrieve the package displayed at the given row. */
+	package_ptr get_package_at_row(int row) const;
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+	void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+      };
+    }
+  }
+}
+
+#endif // APTITUDE_QT_PACKAGES_MODEL_H
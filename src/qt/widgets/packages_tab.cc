@@ -20,8 +20,12 @@
 // Local includes:
 #include "packages_tab.h"
 
+#include "packages_model.h"
+
 #include "aptitude.h"
 
+#include <generic/apt/matching/pattern.h>
+
 // System includes:
 #include <QtGui/QComboBox>
 #include <QtGui/QHBoxLayout>
@@ -32,6 +36,9 @@
 #include <QtGui/QTreeView>
 #include <QtGui/QVBoxLayout>
 
+using aptitude::matching::pattern;
+using cwidget::util::ref_ptr;
+
 namespace aptitude
 {
   namespace gui
@@ -100,12 +107,14 @@ namespace aptitude
 	QHBoxLayout *search_layout = new QHBoxLayout(search_widget);
 
 	search_edit = new QLineEdit();
+	connect(search_edit, SIGNAL(returnPressed()), this, SLOT(search_changed()));
 
 	QStringList search_items;
 	search_items << _("Name") << _("Name and Description") << _("Maintainer") << _("Version");
 
 	search_by_combobox = new QComboBox();
 	search_by_combobox->addItems(search_items);
+	connect(search_by_combobox, SIGNAL(currentIndexChanged(int)), this, SLOT(search_changed()));
 
 	search_layout->addStretch();
 	search_layout->addWidget(new QLabel(_("Find:")));
@@ -113,8 +122,14 @@ namespace aptitude
 	search_layout->addWidget(new QLabel(_("by")));
 	search_layout->addWidget(search_by_combobox);
 
+	model = new packages_model(this);
+
 	packages_view = new QTreeView();
 	packages_view->setRootIsDecorated(false);
+	packages_view->setUniformRowHeights(true);
+	packages_view->setModel(model);
+	packages_view->setSortingEnabled(true);
+	packages_view->sortByColumn(packages_model::column_name, Qt::AscendingOrder);
 
 	right_layout->addWidget(search_widget);
 	right_layout->addWidget(packages_view);
@@ -126,6 +141,43 @@ namespace aptitude
       {
 
       }
+
+      void packages_tab::search_changed()
+      {
+	const std::string text(search_edit->text().toUtf8().constData());
+	if(text.empty())
+	  {
+	    model->set_filter(ref_ptr<pattern>());
+	    return;
+	  }
+
+	ref_ptr<pattern> p;
+	try
+	  {
+	    switch(search_by_combobox->currentIndex())
+	      {
+	      case 1:
+		p = pattern::make_or(pattern::make_name(text),
+				     pattern::make_description(text));
+		break;
+	      case 2:
+		p = pattern::make_maintainer(text);
+		break;
+	      case 3:
+		p = pattern::make_version(text);
+		break;
+	      default:
+		p = pattern::make_name(text);
+		break;
+	      }
+	  }
+	catch(aptitude::matching::MatchingException &)
+	  {
+	    return;
+	  }
+
+	model->set_filter(p);
+      }
     }
   }
 }
@@ -35,6 +35,8 @@ namespace aptitude
   {
     namespace qt
     {
+      class packages_model;
+
       /** \brief Tab containing widgets which allow searching and
        *  browsing a list of packages.
        */
@@ -49,6 +51,7 @@ namespace aptitude
 	QComboBox *search_by_combobox;
 	QLineEdit *search_edit;
 	QTreeView *packages_view;
+	packages_model *model;
 
 	/** \brief Create layouts and widgets. */
 	void create_gui();
@@ -67,6 +70,15 @@ namespace aptitude
 	 */
 	void manage_filters_clicked();
 
+	/** \brief Slot invoked when the user started a search.
+	 *
+	 *  Builds a pattern from the search text and the selected
+	 *  search mode and makes it the filter of the model.  If the
+	 *  text is not a valid regular expression, the current filter
+	 *  is kept.
+	 */
+	void search_changed();
+
       public:
 	/** \brief Create a new packages_tab object. */
 	explicit packages_tab(QWidget *parent = 0);
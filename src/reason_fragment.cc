@@ -398,7 +398,7 @@ cw::fragment *reason_fragment(const pkgCache::PkgIterator &pkg, bool &breakage)
     case pkg_hold:
       {
 	if(estate.selection_state != pkgCache::State::Hold &&
-	   !candver.end() && candver.VerStr() == estate.forbidver)
+	   !candver.end() && candver.VerStr() == estate.forbidver.get())
 	  fragments.push_back(wrapbox(cw::fragf(_("%B%s%b will not be upgraded to the forbidden version %B%s%b."),
 						pkg.FullName(true).c_str(),
 						candver.VerStr())));
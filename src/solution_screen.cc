@@ -46,6 +46,7 @@
 #include <cwidget/widgets/table.h>
 
 #include <algorithm>
+#include <iterator>
 
 typedef generic_solution<aptitude_universe> aptitude_solution;
 typedef generic_choice<aptitude_universe> choice;
@@ -60,63 +61,122 @@ namespace cwidget
 
 typedef aptitude_solution::choice_name_lt choice_name_lt;
 
-/** Partition the set of all packages into several vectors,
- *  according to the action to be performed on each package.
+/** The groups that the actions of a solution are displayed in, in
+ *  the order that they are displayed.
+ */
+enum action_group
+  {
+    group_remove,
+    group_keep,
+    group_install,
+    group_upgrade,
+    group_downgrade,
+    group_unresolved,
+    num_action_groups
+  };
+
+/** The actions of a solution, partitioned according to what each
+ *  one does and sorted by name within each group.
+ */
+struct binned_actions
+{
+  vector<choice> groups[num_action_groups];
+};
+
+/** \return the group that displays the given choice. */
+static action_group get_action_group(const choice &c)
+{
+  switch(c.get_type())
+    {
+    case choice::install_version:
+      switch(analyze_action(c.get_ver()))
+	{
+	case action_remove:
+	  return group_remove;
+	case action_keep:
+	  return group_keep;
+	case action_install:
+	  return group_install;
+	case action_downgrade:
+	  return group_downgrade;
+	case action_upgrade:
+	  return group_upgrade;
+	}
+      break;
+
+    case choice::break_soft_dep:
+      return group_unresolved;
+    }
+
+  abort();
+}
+
+/** \return \b true if choices contains a choice equal to c, and
+ *  store it in out.
+ */
+static bool find_equal_choice(const choice_set &choices, const choice &c,
+			      choice &out)
+{
+  return choices.get_containing_choice(c, out) && out == c;
+}
+
+/** Partition the actions of a solution by what they do, and sort
+ *  each group by name.
+ *
+ *  Adjacent solutions usually share most of their actions, so the
+ *  groups of a previously binned solution can be passed in: actions
+ *  that it contains are taken from it in their existing order, and
+ *  only the actions that are new in sol are analyzed, sorted and
+ *  merged in.
  *
- *  \param remove_actions each package to be removed will be placed in this vector.
- *  \param keep_actions each package which is being kept will be placed
- *         in this vector.
- *  \param install_actions if a package is being newly installed,
- *         its target version will be placed in this vector.
- *  \param downgrade_actions if a package is being downgraded,
- *         its target version will be placed in this vector.
- *  \param upgrade_actions if a package is being upgraded,
- *         its target version will be placed in this vector.
- *  \param unresolved_actions all the choices that leave a dependency
- *         unresolved will be placed in this vector.
+ *  \param sol          the solution to partition.
+ *  \param prev_choices the choices of the previously binned solution,
+ *                      or an empty set.
+ *  \param prev         the groups of the previously binned solution.
+ *  \param out          the groups of sol will be placed here.
  */
 void bin_actions(const aptitude_solution &sol,
-		 vector<choice> &remove_actions,
-		 vector<choice> &keep_actions,
-		 vector<choice> &install_actions,
-		 vector<choice> &downgrade_actions,
-		 vector<choice> &upgrade_actions,
-		 vector<choice> &unresolved_actions)
+		 const choice_set &prev_choices,
+		 const binned_actions &prev,
+		 binned_actions &out)
 {
+  const choice_set &choices = sol.get_choices();
 
-  for(choice_set::const_iterator it = sol.get_choices().begin();
-      it != sol.get_choices().end(); ++it)
+  for(int g = 0; g < num_action_groups; ++g)
     {
-      switch(it->get_type())
-	{
-	case choice::install_version:
-	  switch(analyze_action(it->get_ver()))
-	    {
-	    case action_remove:
-	      remove_actions.push_back(*it);
-	      break;
-	    case action_keep:
-	      keep_actions.push_back(*it);
-	      break;
-	    case action_install:
-	      install_actions.push_back(*it);
-	      break;
-	    case action_downgrade:
-	      downgrade_actions.push_back(*it);
-	      break;
-	    case action_upgrade:
-	      upgrade_actions.push_back(*it);
-	      break;
-	    default:
-	      abort();
-	    }
-	  break;
+      out.groups[g].clear();
 
-	case choice::break_soft_dep:
-	  unresolved_actions.push_back(*it);
-	  break;
+      for(vector<choice>::const_iterator it = prev.groups[g].begin();
+	  it != prev.groups[g].end(); ++it)
+	{
+	  choice c;
+	  if(find_equal_choice(choices, *it, c))
+	    out.groups[g].push_back(c);
 	}
     }
+
+  binned_actions added;
+  for(choice_set::const_iterator it = choices.begin();
+      it != choices.end(); ++it)
+    {
+      choice c;
+      if(!find_equal_choice(prev_choices, *it, c))
+	added.groups[get_action_group(*it)].push_back(*it);
+    }
+
+  for(int g = 0; g < num_action_groups; ++g)
+    if(!added.groups[g].empty())
+      {
+	sort(added.groups[g].begin(), added.groups[g].end(),
+	     choice_name_lt());
+
+	vector<choice> merged;
+	merged.reserve(out.groups[g].size() + added.groups[g].size());
+	merge(out.groups[g].begin(), out.groups[g].end(),
+	      added.groups[g].begin(), added.groups[g].end(),
+	      back_inserter(merged), choice_name_lt());
+	out.groups[g].swap(merged);
+      }
 }
 
 class label_tree : public cw::subtree_generic
@@ -149,6 +209,50 @@ public:
   }
 };
 
+/** A label_tree whose label describes a dependency.  The text is
+ *  only generated when the tree is first displayed, since a story
+ *  tree has one of these for every choice in the solution.
+ */
+class dep_label_tree : public cw::subtree_generic
+{
+  aptitude_resolver_dep d;
+  wstring my_label;
+  bool have_label;
+
+  const wstring &get_label()
+  {
+    if(!have_label)
+      {
+	my_label = dep_text(d.get_dep());
+	have_label = true;
+      }
+
+    return my_label;
+  }
+public:
+  dep_label_tree(const aptitude_resolver_dep &_d)
+    :cw::subtree_generic(true), d(_d), have_label(false)
+  {
+    set_selectable(false);
+  }
+
+  void paint(cw::tree *win, int y, bool hierarchical,
+	     const cw::style &st)
+  {
+    cw::subtree<cw::treeitem>::paint(win, y, hierarchical, get_label());
+  }
+
+  const wchar_t *tag()
+  {
+    return get_label().c_str();
+  }
+
+  const wchar_t *label()
+  {
+    return get_label().c_str();
+  }
+};
+
 
 
 cw::subtree_generic *make_dep_solvers_tree(const aptitude_resolver_dep &d)
@@ -215,7 +319,7 @@ cw::subtree_generic *make_story_tree(const aptitude_solution &sol,
 	{
 	case choice::install_version:
 	  {
-	    cw::subtree_generic *tree = new label_tree(dep_text(i->get_dep().get_dep()), true, false);
+	    cw::subtree_generic *tree = new dep_label_tree(i->get_dep());
 	    tree->add_child(new solution_act_item(i->get_ver(), i->get_dep(),
 						  set_short_description, set_active_dep));
 	    root->add_child(tree);
@@ -224,7 +328,7 @@ cw::subtree_generic *make_story_tree(const aptitude_solution &sol,
 
 	case choice::break_soft_dep:
 	  {
-	    cw::subtree_generic *tree = new label_tree(dep_text(i->get_dep().get_dep()), true, false);
+	    cw::subtree_generic *tree = new dep_label_tree(i->get_dep());
 	    tree->add_child(new solution_unresolved_item(i->get_dep(), false, set_active_dep));
 	    root->add_child(tree);
 	  }
@@ -235,107 +339,42 @@ cw::subtree_generic *make_story_tree(const aptitude_solution &sol,
   return root;
 }
 
-cw::subtree_generic *make_solution_tree(const aptitude_solution &sol,
+cw::subtree_generic *make_solution_tree(const binned_actions &actions,
 				       const sigc::slot1<void, cw::fragment *> &set_short_description,
 				       const sigc::slot1<void, aptitude_resolver_dep> &set_active_dep)
 {
-  // Bin packages according to what will happen to them.
-  vector<choice> remove_actions;
-  vector<choice> keep_actions;
-  vector<choice> install_actions;
-  vector<choice> downgrade_actions;
-  vector<choice> upgrade_actions;
-  vector<choice> unresolved;
-
-  bin_actions(sol, remove_actions, keep_actions, install_actions,
-	      downgrade_actions, upgrade_actions, unresolved);
-
-  typedef aptitude_solution::choice_name_lt choice_name_lt;
-
-  sort(remove_actions.begin(), remove_actions.end(),
-       choice_name_lt());
-  sort(keep_actions.begin(), keep_actions.end(),
-       choice_name_lt());
-  sort(install_actions.begin(), install_actions.end(),
-       choice_name_lt());
-  sort(downgrade_actions.begin(), downgrade_actions.end(),
-       choice_name_lt());
-  sort(upgrade_actions.begin(), upgrade_actions.end(),
-       choice_name_lt());
-  sort(unresolved.begin(), unresolved.end(),
-       choice_name_lt());
-
-  cw::subtree_generic *root = new label_tree(L"");
-
-  if(!remove_actions.empty())
+  static const char * const group_labels[num_action_groups] =
     {
-      cw::subtree_generic *remove_tree = new label_tree(W_("Remove the following packages:"));
-
-      for(vector<choice>::const_iterator i = remove_actions.begin();
-	  i != remove_actions.end(); ++i)
-	remove_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
-							  set_short_description, set_active_dep));
-
-      root->add_child(remove_tree);
-    }
+      N_("Remove the following packages:"),
+      N_("Keep the following packages at their current version:"),
+      N_("Install the following packages:"),
+      N_("Upgrade the following packages:"),
+      N_("Downgrade the following packages:"),
+      N_("Leave the following recommendations unresolved:")
+    };
 
-  if(!keep_actions.empty())
-    {
-      cw::subtree_generic *keep_tree = new label_tree(W_("Keep the following packages at their current version:"));
-
-      for(vector<choice>::const_iterator i = keep_actions.begin();
-	  i != keep_actions.end(); ++i)
-	keep_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
-							set_short_description, set_active_dep));
-
-      root->add_child(keep_tree);
-    }
-
-  if(!install_actions.empty())
-    {
-      cw::subtree_generic *install_tree = new label_tree(W_("Install the following packages:"));
-
-      for(vector<choice>::const_iterator i = install_actions.begin();
-	  i != install_actions.end(); ++i)
-	install_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
-							   set_short_description, set_active_dep));
-
-      root->add_child(install_tree);
-    }
+  cw::subtree_generic *root = new label_tree(L"");
 
-  if(!upgrade_actions.empty())
+  for(int g = 0; g < num_action_groups; ++g)
     {
-      cw::subtree_generic *upgrade_tree = new label_tree(W_("Upgrade the following packages:"));
+      const vector<choice> &group = actions.groups[g];
 
-      for(vector<choice>::const_iterator i = upgrade_actions.begin();
-	  i != upgrade_actions.end(); ++i)
-	upgrade_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
-							   set_short_description, set_active_dep));
+      if(group.empty())
+	continue;
 
-      root->add_child(upgrade_tree);
-    }
-
-  if(!downgrade_actions.empty())
-    {
-      cw::subtree_generic *downgrade_tree = new label_tree(W_("Downgrade the following packages:"));
+      cw::subtree_generic *group_tree = new label_tree(W_(group_labels[g]));
 
-      for(vector<choice>::const_iterator i = downgrade_actions.begin();
-	  i != downgrade_actions.end(); ++i)
-	downgrade_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
+      for(vector<choice>::const_iterator i = group.begin();
+	  i != group.end(); ++i)
+	{
+	  if(g == group_unresolved)
+	    group_tree->add_child(new solution_unresolved_item(i->get_dep(), false, set_active_dep));
+	  else
+	    group_tree->add_child(new solution_act_item_bare(i->get_ver(), i->get_dep(),
 							     set_short_description, set_active_dep));
+	}
 
-      root->add_child(downgrade_tree);
-    }
-
-  if(!unresolved.empty())
-    {
-      cw::subtree_generic *unresolved_tree = new label_tree(W_("Leave the following recommendations unresolved:"));
-
-      for(std::vector<choice>::const_iterator it = unresolved.begin();
-	  it != unresolved.end(); ++it)
-	unresolved_tree->add_child(new solution_unresolved_item(it->get_dep(), false, set_active_dep));
-
-      root->add_child(unresolved_tree);
+      root->add_child(group_tree);
     }
 
   return root;
@@ -374,9 +413,23 @@ class solution_examiner : public cw::multiplex
 {
   aptitude_solution last_sol;
 
+  /** The choices of the last solution whose actions were binned. */
+  choice_set binned_choices;
+
+  /** The binned actions of the last solution; reused when the next
+   *  solution is binned.
+   */
+  binned_actions actions;
+
   menu_tree_ref solution_tree;
   menu_tree_ref story_tree;
 
+  /** If \b true, solution_tree doesn't display last_sol yet. */
+  bool solution_tree_stale;
+
+  /** If \b true, story_tree doesn't display last_sol yet. */
+  bool story_tree_stale;
+
   sigc::slot1<void, cw::fragment *> set_short_description;
   sigc::slot1<void, aptitude_resolver_dep> set_active_dep;
 
@@ -398,6 +451,40 @@ class solution_examiner : public cw::multiplex
   {
     solution_tree->set_root(new cw::layout_item(cw::hardwrapbox(cw::text_fragment(s))), true);
     story_tree->set_root(new cw::layout_item(cw::hardwrapbox(cw::text_fragment(s))), true);
+    solution_tree_stale = false;
+    story_tree_stale = false;
+  }
+
+  /** Forget the binned actions; used when the analysis of a choice
+   *  might change, i.e., when the cache or resolver goes away.
+   */
+  void discard_binned_actions()
+  {
+    binned_choices = choice_set();
+    actions = binned_actions();
+  }
+
+  /** Display last_sol in whichever of the two trees is visible, if it
+   *  isn't already displayed there.  The hidden tree is filled in
+   *  when the user cycles to it.
+   */
+  void build_visible_tree()
+  {
+    if(solution_tree_stale && solution_tree == visible_widget())
+      {
+	binned_actions new_actions;
+	bin_actions(last_sol, binned_choices, actions, new_actions);
+	binned_choices = last_sol.get_choices();
+	actions = new_actions;
+
+	solution_tree->set_root(make_solution_tree(actions, set_short_description, set_active_dep));
+	solution_tree_stale = false;
+      }
+    else if(story_tree_stale && story_tree == visible_widget())
+      {
+	story_tree->set_root(make_story_tree(last_sol, set_short_description, set_active_dep));
+	story_tree_stale = false;
+      }
   }
 
   /** Send highlighted/unhighlighted messages to the subwidgets so
@@ -407,6 +494,8 @@ class solution_examiner : public cw::multiplex
   {
     cw::widget_ref tmpref(this);
 
+    build_visible_tree();
+
     if(solution_tree == visible_widget())
       {
 	story_tree->unhighlight_current();
@@ -440,6 +529,7 @@ protected:
 		    const sigc::slot1<void, aptitude_resolver_dep> &_set_active_dep)
     : cw::multiplex(false),
       solution_tree(solution_undo_tree::create()), story_tree(solution_undo_tree::create()),
+      solution_tree_stale(false), story_tree_stale(false),
       set_short_description(_set_short_description),
       set_active_dep(_set_active_dep)
   {
@@ -502,6 +592,7 @@ public:
 
     if(!apt_cache_file)
       {
+	discard_binned_actions();
 	set_static_root(W_("The package cache is not available."));
 	set_active_dep(aptitude_resolver_dep());
 	return;
@@ -509,6 +600,7 @@ public:
 
     if(!resman->resolver_exists())
       {
+	discard_binned_actions();
 	set_static_root(W_("No broken packages."));
 	set_short_description(cw::fragf(""));
 	set_active_dep(aptitude_resolver_dep());
@@ -553,6 +645,8 @@ public:
 
 	solution_tree->set_root(sol_root, true);
 	story_tree->set_root(story_root, true);
+	solution_tree_stale = false;
+	story_tree_stale = false;
 
 	last_sol.nullify();
 	return;
@@ -569,8 +663,8 @@ public:
       set_static_root(W_("Internal error: unexpected null solution."));
     else
       {
-	solution_tree->set_root(make_solution_tree(sol, set_short_description, set_active_dep));
-	story_tree->set_root(make_story_tree(sol, set_short_description, set_active_dep));
+	solution_tree_stale = true;
+	story_tree_stale = true;
       }
 
     update_highlights();
@@ -94,12 +94,15 @@
 #include <generic/apt/download_install_manager.h>
 #include <generic/apt/download_update_manager.h>
 #include <generic/apt/download_signal_log.h>
+#include <generic/apt/pkg_changelog.h>
 #include <generic/apt/resolver_manager.h>
 
 #include <generic/problemresolver/exceptions.h>
 #include <generic/problemresolver/solution.h>
 
+#include <generic/util/memory_accounting.h>
 #include <generic/util/temp.h>
+#include <generic/util/thunk_dispatcher.h>
 #include <generic/util/util.h>
 
 #include "dep_item.h"
@@ -1031,6 +1034,36 @@ static void do_help_about()
   popup_widget(w);
 }
 
+static void do_help_memory_usage()
+{
+  aptitude::util::memory_report report;
+  aptitude::util::collect_memory_usage(report);
+
+  // The report is a table, so don't let it be rewrapped.
+  vector<cw::fragment *> frags;
+  frags.push_back(wrapbox(cw::text_fragment(_("Estimated memory use by subsystem:"))));
+  frags.push_back(cw::newline_fragment());
+  frags.push_back(cw::newline_fragment());
+
+  const std::string text = report.format();
+  std::string::size_type start = 0;
+  while(start < text.size())
+    {
+      std::string::size_type end = text.find('\n', start);
+      if(end == std::string::npos)
+	end = text.size();
+
+      frags.push_back(clipbox(cw::text_fragment(std::string(text, start, end - start))));
+      frags.push_back(cw::newline_fragment());
+      start = end + 1;
+    }
+
+  cw::widget_ref w = cw::dialogs::ok(cw::sequence_fragment(frags));
+  w->show_all();
+
+  popup_widget(w);
+}
+
 /** Set up a new top-level file-viewing widget with a scrollbar. */
 static cw::widget_ref setup_fileview(const std::string &filename,
 				    const char *encoding,
@@ -1229,7 +1262,12 @@ namespace
   // this it should be all right.
   void do_post_thunk(const safe_slot0<void> &thunk)
   {
-    cw::toplevel::post_event(new aptitude::safe_slot_event(thunk));
+    ui_post_thunk(thunk);
+  }
+
+  void do_post_sigc_thunk(const sigc::slot<void> &thunk)
+  {
+    ui_post_thunk(make_safe_slot(thunk));
   }
 
   progress_with_destructor make_progress_bar()
@@ -1391,6 +1429,8 @@ static void do_show_preview()
       eassert(active_preview.valid());
       active_preview->show();
     }
+
+  aptitude::apt::prefetch_upgrade_changelogs(&do_post_sigc_thunk);
 }
 
 static void do_keep_all()
@@ -2620,6 +2660,10 @@ cw::menu_info help_menu_info[]={
 	       N_("View the terms under which you may copy and distribute aptitude"),
 	       sigc::ptr_fun(do_help_license)),
 
+  cw::menu_info(cw::menu_info::MENU_ITEM, N_("Memory ^Usage"), NULL,
+	       N_("View an estimate of the memory used by each part of the program"),
+	       sigc::ptr_fun(do_help_memory_usage)),
+
   cw::menu_info::MENU_END
 };
 
@@ -2721,6 +2765,40 @@ typedef cw::util::ref_ptr<help_bar> help_bar_ref;
 /** \brief A list of global connections that must be disconnected when the UI exits. */
 std::deque<sigc::connection> global_connections;
 
+namespace
+{
+  void run_posted_thunks();
+
+  // Posts a single cwidget event that runs everything posted since
+  // the last one.
+  void wake_main_loop()
+  {
+    const sigc::slot<void> run_slot(sigc::ptr_fun(&run_posted_thunks));
+
+    cw::toplevel::post_event(new aptitude::safe_slot_event(make_safe_slot(run_slot)));
+  }
+
+  aptitude::util::thunk_dispatcher &get_thunk_dispatcher()
+  {
+    // Deliberately leaked so that background threads can keep
+    // posting while global destructors run.
+    static aptitude::util::thunk_dispatcher *dispatcher =
+      new aptitude::util::thunk_dispatcher(&wake_main_loop);
+
+    return *dispatcher;
+  }
+
+  void run_posted_thunks()
+  {
+    get_thunk_dispatcher().run_pending();
+  }
+}
+
+void ui_post_thunk(const safe_slot0<void> &thunk)
+{
+  get_thunk_dispatcher().post(thunk);
+}
+
 void ui_init()
 {
   cw::toplevel::init();
@@ -17,6 +17,8 @@
 
 #include <cwidget/widgets/editline.h> // Included for history support.
 
+#include <generic/util/safe_slot.h>
+
 /** \brief Global UI definitions and routines
  *
  * 
@@ -204,6 +206,14 @@ extern sigc::signal1<void, bool> update_finished;
 void ui_init();
 void ui_main();
 
+/** \brief Run a thunk in the main thread; safe to invoke from any
+ *  thread.
+ *
+ *  Thunks that are posted in quick succession are run together, so
+ *  the main loop is only woken up once for all of them.
+ */
+void ui_post_thunk(const safe_slot0<void> &thunk);
+
 // Displays a "popup" widget.  If the second argument is false, show_all
 // will not be called on the widget.
 void popup_widget(const cwidget::widgets::widget_ref &w, bool do_show_all=true);
@@ -31,7 +31,6 @@
 #include "menu_redirect.h"
 #include "menu_text_layout.h"
 #include "progress.h"
-#include "safe_slot_event.h"
 #include "ui.h"
 
 #include <generic/apt/apt.h>
@@ -266,14 +265,22 @@ typedef cw::util::ref_ptr<pkg_changelog_screen> pkg_changelog_screen_ref;
 
 static void do_view_changelog(temp::name n,
 			      string pkgname,
-			      string curverstr)
+			      string curverstr,
+			      string source_package,
+			      string source_version)
 {
   string menulabel =
     ssprintf(_("ChangeLog of %s"), pkgname.c_str());
   string tablabel = ssprintf(_("%s changes"), pkgname.c_str());
   string desclabel = _("View the list of changes made to this Debian package.");
 
-  cw::util::ref_ptr<aptitude::apt::changelog> changelog(aptitude::apt::parse_changelog(n));
+  // Use the index of the changelog if we know what it's a changelog
+  // of, so that viewing it again doesn't mean parsing it again.
+  cw::util::ref_ptr<aptitude::apt::changelog> changelog;
+  if(!source_package.empty() && !source_version.empty())
+    changelog = aptitude::apt::parse_changelog_indexed(n, source_package, source_version);
+  if(!changelog.valid() || changelog->size() == 0)
+    changelog = aptitude::apt::parse_changelog(n);
   cw::fragment *f = changelog.valid() ? render_changelog(changelog, curverstr) : NULL;
 
   cw::table_ref           t = cw::table::create();
@@ -320,7 +327,7 @@ namespace
 {
   void do_post_thunk(const sigc::slot<void> &thunk)
   {
-    cw::toplevel::post_event(new aptitude::safe_slot_event(make_safe_slot(thunk)));
+    ui_post_thunk(make_safe_slot(thunk));
   }
 }
 
@@ -329,13 +336,19 @@ class changelog_callbacks : public aptitude::download_callbacks
   progress_ref download_progress;
   std::string pkgname;
   std::string curverstr;
+  std::string source_package;
+  std::string source_version;
 
 public:
   changelog_callbacks(const std::string &_pkgname,
-		      const std::string &_curverstr)
+		      const std::string &_curverstr,
+		      const std::string &_source_package,
+		      const std::string &_source_version)
     : download_progress(gen_progress_bar()),
       pkgname(_pkgname),
-      curverstr(_curverstr)
+      curverstr(_curverstr),
+      source_package(_source_package),
+      source_version(_source_version)
   {
     cw::util::ref_ptr<refcounted_progress> p(download_progress->get_progress());
 
@@ -357,7 +370,8 @@ public:
         download_progress->destroy();
         download_progress.clear();
       }
-    do_view_changelog(filename, pkgname, curverstr);
+    do_view_changelog(filename, pkgname, curverstr,
+		      source_package, source_version);
   }
 
   void failure(const std::string &msg)
@@ -417,10 +431,15 @@ void view_changelog(pkgCache::VerIterator ver)
       return;
     }
 
-  boost::shared_ptr<changelog_callbacks> callbacks =
-    boost::make_shared<changelog_callbacks>(ver.ParentPkg().Name(),
-					    current_source_ver);
   boost::shared_ptr<aptitude::apt::changelog_info> info =
     aptitude::apt::changelog_info::create(ver);
+  const std::string source_package = info.get() == NULL ? "" : info->get_source_package();
+  const std::string source_version = info.get() == NULL ? "" : info->get_source_version();
+
+  boost::shared_ptr<changelog_callbacks> callbacks =
+    boost::make_shared<changelog_callbacks>(ver.ParentPkg().Name(),
+					    current_source_ver,
+					    source_package,
+					    source_version);
   aptitude::apt::get_changelog(info, callbacks, do_post_thunk);
 }
@@ -0,0 +1,316 @@
+// bench.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+// Times the operations that dominate aptitude's interactive
+// performance against a real package cache, and prints one
+// tab-separated line per benchmark so that runs can be compared
+// mechanically.
+//
+// The cache is whatever apt is configured to load.  Use --root (or
+// APT_ROOT_DIR, as with aptitude itself) to point it at the output of
+// "aptitude extract-cache-subset", and -o to override individual
+// settings such as Dir::State::status.
+
+#include <aptitude.h>
+
+#include <generic/apt/apt.h>
+#include <generic/apt/aptcache.h>
+#include <generic/apt/config_signal.h>
+#include <generic/apt/matching/match.h>
+#include <generic/apt/matching/parse.h>
+#include <generic/apt/matching/pattern.h>
+#include <generic/util/parallel_sort.h>
+
+#include <apt-pkg/error.h>
+#include <apt-pkg/progress.h>
+
+#include <cwidget/generic/util/ref_ptr.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using aptitude::matching::parse;
+using aptitude::matching::pattern;
+using aptitude::matching::search;
+using aptitude::matching::search_cache;
+using aptitude::matching::structural_match;
+using cwidget::util::ref_ptr;
+
+namespace
+{
+  const char * const default_patterns[] = {
+    "?name(lib)",
+    "?installed",
+    "?description(editor)",
+    "?term(editor)",
+    "?depends(?name(^libc6$))",
+    "?reverse-depends(?installed)",
+    "?broken-reverse-depends(?true)",
+    "?upgradable ?not(?automatic)"
+  };
+
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  void report(const std::string &name, int iterations, double elapsed)
+  {
+    std::cout << name << '\t'
+	      << iterations << '\t'
+	      << static_cast<long long>(elapsed * 1000000) << '\t'
+	      << static_cast<long long>(elapsed * 1000000 / iterations)
+	      << std::endl;
+  }
+
+  // Compares packages by name, the way the default sort policy does.
+  struct pkg_name_lt
+  {
+    bool operator()(const pkgCache::PkgIterator &p1,
+		    const pkgCache::PkgIterator &p2) const
+    {
+      return strcmp(p1.Name(), p2.Name()) < 0;
+    }
+  };
+
+  void bench_parse(const std::vector<std::string> &patterns,
+		   int iterations)
+  {
+    for(std::vector<std::string>::const_iterator it = patterns.begin();
+	it != patterns.end(); ++it)
+      {
+	const double start = now();
+	for(int i = 0; i < iterations; ++i)
+	  parse(*it);
+	report("parse " + *it, iterations, now() - start);
+      }
+  }
+
+  void bench_search(const std::vector<std::string> &patterns,
+		    int iterations)
+  {
+    for(std::vector<std::string>::const_iterator it = patterns.begin();
+	it != patterns.end(); ++it)
+      {
+	const ref_ptr<pattern> p(parse(*it));
+	if(!p.valid())
+	  {
+	    _error->DumpErrors();
+	    continue;
+	  }
+
+	std::vector<std::pair<pkgCache::PkgIterator, ref_ptr<structural_match> > > matches;
+
+	// Every iteration gets a new search cache, as it would for
+	// a new search in the UI.
+	double start = now();
+	for(int i = 0; i < iterations; ++i)
+	  {
+	    matches.clear();
+	    search(p, search_cache::create(), matches,
+		   *apt_cache_file, *apt_package_records);
+	  }
+	report("search " + *it, iterations, now() - start);
+
+	// The same search repeated with one search cache, as a
+	// limit is reapplied when the package states change.
+	const ref_ptr<search_cache> info(search_cache::create());
+	start = now();
+	for(int i = 0; i < iterations; ++i)
+	  {
+	    matches.clear();
+	    search(p, info, matches,
+		   *apt_cache_file, *apt_package_records);
+	  }
+	report("search-cached " + *it, iterations, now() - start);
+      }
+  }
+
+  void bench_sort(int iterations)
+  {
+    std::vector<pkgCache::PkgIterator> packages;
+    for(pkgCache::PkgIterator pkg = (*apt_cache_file)->PkgBegin();
+	!pkg.end(); ++pkg)
+      packages.push_back(pkg);
+
+    std::vector<pkgCache::PkgIterator> order;
+    const int num_threads = aptcfg->FindI(PACKAGE "::Search::Threads", 1);
+
+    const double start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	order = packages;
+	aptitude::util::parallel_sort(order.begin(), order.end(),
+				      pkg_name_lt(), num_threads);
+      }
+    report("sort-by-name", iterations, now() - start);
+  }
+
+  void bench_find_pkg_state(int iterations)
+  {
+    aptitudeDepCache &cache(*apt_cache_file);
+
+    double start = now();
+    for(int i = 0; i < iterations; ++i)
+      for(pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg)
+	find_pkg_state(pkg, cache);
+    report("find-pkg-state", iterations, now() - start);
+  }
+
+  void bench_state_changes(int iterations)
+  {
+    aptitudeDepCache &cache(*apt_cache_file);
+
+    pkgCache::PkgIterator target = cache.PkgBegin();
+    while(!target.end() && target->CurrentVer == 0)
+      ++target;
+
+    if(target.end())
+      std::cerr << "No installed packages; skipping mark-keep." << std::endl;
+    else
+      {
+	// Keeping a package that's already kept changes nothing,
+	// but still runs a whole action group, including the
+	// mark-and-sweep pass.
+	const double start = now();
+	for(int i = 0; i < iterations; ++i)
+	  cache.mark_keep(target, false, false, NULL);
+	report("mark-keep", iterations, now() - start);
+      }
+
+    const double start = now();
+    for(int i = 0; i < iterations; ++i)
+      delete cache.snapshot_apt_state();
+    report("snapshot-apt-state", iterations, now() - start);
+  }
+
+  void usage(const char *progname)
+  {
+    std::cerr << "Usage: " << progname << " [options]" << std::endl
+	      << std::endl
+	      << " -r, --root DIR        Load the cache found under DIR." << std::endl
+	      << " -o KEY=VALUE          Set a configuration option." << std::endl
+	      << " -n, --iterations N    Repeat each operation N times (default 5)." << std::endl
+	      << " -p, --pattern PAT     Time PAT instead of the default patterns;" << std::endl
+	      << "                       can be given several times." << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *rootdir = getenv("APT_ROOT_DIR");
+  int iterations = 5;
+  std::vector<std::string> patterns;
+  std::vector<std::pair<std::string, std::string> > settings;
+
+  static const struct option long_options[] = {
+    { "root", required_argument, NULL, 'r' },
+    { "iterations", required_argument, NULL, 'n' },
+    { "pattern", required_argument, NULL, 'p' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "r:o:n:p:h", long_options, NULL)) != -1)
+    switch(opt)
+      {
+      case 'r':
+	rootdir = optarg;
+	break;
+
+      case 'o':
+	{
+	  const std::string s(optarg);
+	  const std::string::size_type eqloc = s.find('=');
+	  if(eqloc == std::string::npos || eqloc == 0)
+	    {
+	      std::cerr << "-o requires an argument of the form key=value, got "
+			<< optarg << std::endl;
+	      return 1;
+	    }
+
+	  settings.push_back(std::make_pair(std::string(s, 0, eqloc),
+					    std::string(s, eqloc + 1)));
+	}
+	break;
+
+      case 'n':
+	iterations = atoi(optarg);
+	if(iterations < 1)
+	  {
+	    std::cerr << "The number of iterations must be positive." << std::endl;
+	    return 1;
+	  }
+	break;
+
+      case 'p':
+	patterns.push_back(optarg);
+	break;
+
+      default:
+	usage(argv[0]);
+	return opt == 'h' ? 0 : 1;
+      }
+
+  if(patterns.empty())
+    patterns.assign(default_patterns,
+		    default_patterns + sizeof(default_patterns) / sizeof(default_patterns[0]));
+
+  apt_preinit(rootdir);
+  for(std::vector<std::pair<std::string, std::string> >::const_iterator
+	it = settings.begin(); it != settings.end(); ++it)
+    aptcfg->SetNoUser(it->first, it->second);
+
+  const double load_start = now();
+  {
+    OpProgress progress;
+    apt_init(&progress, false);
+  }
+  const double load_elapsed = now() - load_start;
+
+  if(_error->PendingError() || apt_cache_file == NULL)
+    {
+      _error->DumpErrors();
+      return 1;
+    }
+
+  std::cout << "# packages\t" << (*apt_cache_file)->Head().PackageCount << std::endl
+	    << "# versions\t" << (*apt_cache_file)->Head().VersionCount << std::endl
+	    << "# benchmark\titerations\ttotal_us\tper_iteration_us" << std::endl;
+
+  report("load-cache", 1, load_elapsed);
+  bench_parse(patterns, iterations * 100);
+  bench_search(patterns, iterations);
+  bench_sort(iterations);
+  bench_find_pkg_state(iterations);
+  bench_state_changes(iterations);
+
+  _error->DumpErrors();
+  return 0;
+}
@@ -0,0 +1,454 @@
+// bench_containers.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+// Times the containers at the core of the resolver on workloads
+// shaped like the resolver's own, and prints one tab-separated line
+// per benchmark in the same format as bench.cc.
+//
+// The workloads:
+//
+//   - imm::set and imm::map: building sets one element at a time
+//     while the previous versions stay alive (as each search step
+//     extends its parent's action set), then looking elements up.
+//
+//   - setset and dense_setset: many small sets (like the choice sets
+//     of promotions), queried for a subset of a much larger set (like
+//     the actions of a step).
+//
+//   - choice_set and promotion_set: the same, using real choices over
+//     a generated universe.
+//
+// No package cache is needed.  The same --seed always gives the same
+// workload.
+
+#include <generic/problemresolver/choice.h>
+#include <generic/problemresolver/choice_set.h>
+#include <generic/problemresolver/cost.h>
+#include <generic/problemresolver/dummy_universe.h>
+#include <generic/problemresolver/promotion_set.h>
+#include <generic/util/dense_setset.h>
+#include <generic/util/immset.h>
+#include <generic/util/setset.h>
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  typedef dummy_universe_ref::version version;
+  typedef generic_choice<dummy_universe_ref> choice;
+  typedef generic_choice_set<dummy_universe_ref> choice_set;
+  typedef generic_promotion_set<dummy_universe_ref> promotion_set;
+  typedef promotion_set::promotion promotion;
+
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  void report(const std::string &name, int iterations, double elapsed)
+  {
+    std::cout << name << '\t'
+	      << iterations << '\t'
+	      << static_cast<long long>(elapsed * 1000000) << '\t'
+	      << static_cast<long long>(elapsed * 1000000 / iterations)
+	      << std::endl;
+  }
+
+  /** \brief A random number in [0, n). */
+  int pick(int n)
+  {
+    return static_cast<int>(random() % n);
+  }
+
+  /** \brief Keeps the compiler from discarding a result. */
+  volatile long sink;
+
+  struct identity
+  {
+    int operator()(int a) const
+    {
+      return a;
+    }
+  };
+
+  void bench_imm_set(int size, int iterations)
+  {
+    std::vector<int> values;
+    for(int i = 0; i < size; ++i)
+      values.push_back(pick(size * 4));
+
+    imm::set<int> s;
+    double start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	std::vector<imm::set<int> > history;
+	s = imm::set<int>();
+	for(std::vector<int>::const_iterator it = values.begin();
+	    it != values.end(); ++it)
+	  {
+	    history.push_back(s);
+	    s.insert(*it);
+	  }
+      }
+    report("imm-set-insert", iterations, now() - start);
+
+    start = now();
+    long found = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(int j = 0; j < size * 4; ++j)
+	if(s.contains(j))
+	  ++found;
+    sink = found;
+    report("imm-set-contains", iterations, now() - start);
+
+    start = now();
+    long total = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(imm::set<int>::const_iterator it = s.begin(); it != s.end(); ++it)
+	total += *it;
+    sink = total;
+    report("imm-set-iterate", iterations, now() - start);
+  }
+
+  void bench_imm_map(int size, int iterations)
+  {
+    std::vector<int> keys;
+    for(int i = 0; i < size; ++i)
+      keys.push_back(pick(size * 4));
+
+    imm::map<int, int> m;
+    double start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	std::vector<imm::map<int, int> > history;
+	m = imm::map<int, int>();
+	for(std::vector<int>::const_iterator it = keys.begin();
+	    it != keys.end(); ++it)
+	  {
+	    history.push_back(m);
+	    m.put(*it, i);
+	  }
+      }
+    report("imm-map-put", iterations, now() - start);
+
+    start = now();
+    long total = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(int j = 0; j < size * 4; ++j)
+	total += m.get(j, 0);
+    sink = total;
+    report("imm-map-get", iterations, now() - start);
+  }
+
+  /** \brief Make num_sets random sets of two to five elements drawn
+   *  from [0, universe_size).
+   */
+  std::vector<imm::set<int> > make_small_sets(int num_sets, int universe_size)
+  {
+    std::vector<imm::set<int> > rval;
+    for(int i = 0; i < num_sets; ++i)
+      {
+	imm::set<int> s;
+	const int n = 2 + pick(4);
+	for(int j = 0; j < n; ++j)
+	  s.insert(pick(universe_size));
+	rval.push_back(s);
+      }
+
+    return rval;
+  }
+
+  /** \brief Make queries that each contain a tenth of
+   *  [0, universe_size).
+   */
+  std::vector<imm::set<int> > make_queries(int num_queries, int universe_size)
+  {
+    std::vector<imm::set<int> > rval;
+    for(int i = 0; i < num_queries; ++i)
+      {
+	imm::set<int> s;
+	for(int j = 0; j < universe_size / 10; ++j)
+	  s.insert(pick(universe_size));
+	rval.push_back(s);
+      }
+
+    return rval;
+  }
+
+  void bench_setsets(int size, int iterations)
+  {
+    const int universe_size = size;
+    const std::vector<imm::set<int> > sets = make_small_sets(size, universe_size);
+    const std::vector<imm::set<int> > queries = make_queries(100, universe_size);
+
+    setset<int> S;
+    double start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	S = setset<int>();
+	for(std::vector<imm::set<int> >::const_iterator it = sets.begin();
+	    it != sets.end(); ++it)
+	  S.insert(*it);
+      }
+    report("setset-insert", iterations, now() - start);
+
+    start = now();
+    long found = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<imm::set<int> >::const_iterator it = queries.begin();
+	  it != queries.end(); ++it)
+	if(S.find_subset(*it) != S.end())
+	  ++found;
+    sink = found;
+    report("setset-find-subset", iterations, now() - start);
+
+    dense_setset<int, identity> D(universe_size);
+    for(std::vector<imm::set<int> >::const_iterator it = sets.begin();
+	it != sets.end(); ++it)
+      D.insert(*it);
+
+    start = now();
+    found = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<imm::set<int> >::const_iterator it = queries.begin();
+	  it != queries.end(); ++it)
+	if(D.find_subset(*it) != D.end())
+	  ++found;
+    sink = found;
+    report("dense-setset-find-subset", iterations, now() - start);
+
+    start = now();
+    found = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<imm::set<int> >::const_iterator it = queries.begin();
+	  it != queries.end(); ++it)
+	if(D.find_subset_containing(*it, *it->begin()) != D.end())
+	  ++found;
+    sink = found;
+    report("dense-setset-find-subset-containing", iterations, now() - start);
+  }
+
+  /** \brief Build a universe of num_packages packages with three
+   *  versions each.
+   */
+  dummy_universe_ref make_universe(int num_packages)
+  {
+    std::ostringstream out;
+    out << "UNIVERSE [";
+    for(int i = 0; i < num_packages; ++i)
+      out << " PACKAGE p" << i << " < v1 v2 v3 > v1";
+    out << " ]";
+
+    std::istringstream in(out.str());
+    return parse_universe(in);
+  }
+
+  version random_version(const dummy_universe_ref &u, int num_packages)
+  {
+    std::ostringstream pkg_name, ver_name;
+    pkg_name << "p" << pick(num_packages);
+    ver_name << "v" << (1 + pick(3));
+    return u.find_package(pkg_name.str()).version_from_name(ver_name.str());
+  }
+
+  /** \brief Make the choices of a search step: installs of
+   *  num_choices versions of different packages.
+   */
+  choice_set make_step_choices(const dummy_universe_ref &u, int num_packages,
+			       int num_choices)
+  {
+    choice_set rval;
+    for(int i = 0; i < num_choices; ++i)
+      rval.insert_or_narrow(choice::make_install_version(random_version(u, num_packages), i));
+
+    return rval;
+  }
+
+  class null_callbacks : public promotion_set_callbacks<dummy_universe_ref>
+  {
+    void promotion_retracted(const promotion &)
+    {
+    }
+  };
+
+  void bench_choices(int size, int iterations)
+  {
+    const int num_packages = size;
+    const dummy_universe_ref u = make_universe(num_packages);
+
+    std::vector<choice> choices;
+    for(int i = 0; i < size; ++i)
+      choices.push_back(choice::make_install_version(random_version(u, num_packages), i));
+
+    choice_set cs;
+    double start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	std::vector<choice_set> history;
+	cs = choice_set();
+	for(std::vector<choice>::const_iterator it = choices.begin();
+	    it != choices.end(); ++it)
+	  {
+	    history.push_back(cs);
+	    cs.insert_or_narrow(*it);
+	  }
+      }
+    report("choice-set-insert", iterations, now() - start);
+
+    start = now();
+    long found = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<choice>::const_iterator it = choices.begin();
+	  it != choices.end(); ++it)
+	if(cs.has_contained_choice(*it))
+	  ++found;
+    sink = found;
+    report("choice-set-has-contained-choice", iterations, now() - start);
+
+    // Promotions are small sets of choices; the steps that are
+    // tested against them have many more.
+    std::vector<promotion> promotions;
+    for(int i = 0; i < size; ++i)
+      promotions.push_back(promotion(make_step_choices(u, num_packages, 2 + pick(3)),
+				     cost::make_advance_user_level(0, 1 + pick(100))));
+
+    // The containing query asks about one choice of each step, as the
+    // resolver does when it checks a newly added choice.
+    std::vector<choice_set> steps;
+    std::vector<choice> step_firsts;
+    for(int i = 0; i < 100; ++i)
+      {
+	steps.push_back(make_step_choices(u, num_packages, num_packages / 10));
+	step_firsts.push_back(*steps.back().begin());
+      }
+
+    null_callbacks callbacks;
+    start = now();
+    for(int i = 0; i < iterations; ++i)
+      {
+	promotion_set p(u, callbacks);
+	for(std::vector<promotion>::const_iterator it = promotions.begin();
+	    it != promotions.end(); ++it)
+	  p.insert(*it);
+      }
+    report("promotion-set-insert", iterations, now() - start);
+
+    promotion_set p(u, callbacks);
+    for(std::vector<promotion>::const_iterator it = promotions.begin();
+	it != promotions.end(); ++it)
+      p.insert(*it);
+
+    start = now();
+    long total = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<choice_set>::const_iterator it = steps.begin();
+	  it != steps.end(); ++it)
+	if(p.find_highest_promotion_cost(*it) != cost_limits::minimum_cost)
+	  ++total;
+    sink = total;
+    report("promotion-set-find-highest-cost", iterations, now() - start);
+
+    start = now();
+    total = 0;
+    for(int i = 0; i < iterations; ++i)
+      for(std::vector<choice_set>::const_iterator it = steps.begin();
+	  it != steps.end(); ++it)
+	if(p.find_highest_promotion_containing(*it, step_firsts[it - steps.begin()]).get_cost() != cost_limits::minimum_cost)
+	  ++total;
+    sink = total;
+    report("promotion-set-find-highest-containing", iterations, now() - start);
+  }
+
+  void usage(const char *progname)
+  {
+    std::cerr << "Usage: " << progname << " [options]" << std::endl
+	      << std::endl
+	      << " -n, --iterations N    Repeat each operation N times (default 5)." << std::endl
+	      << " -s, --size N          The number of elements, sets or packages in" << std::endl
+	      << "                       each workload (default 5000)." << std::endl
+	      << " --seed N              The random seed (default 0)." << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 5;
+  int size = 5000;
+  long seed = 0;
+
+  static const struct option long_options[] = {
+    { "iterations", required_argument, NULL, 'n' },
+    { "size", required_argument, NULL, 's' },
+    { "seed", required_argument, NULL, 'S' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "n:s:h", long_options, NULL)) != -1)
+    switch(opt)
+      {
+      case 'n':
+	iterations = atoi(optarg);
+	if(iterations < 1)
+	  {
+	    std::cerr << "The number of iterations must be positive." << std::endl;
+	    return 1;
+	  }
+	break;
+
+      case 's':
+	size = atoi(optarg);
+	if(size < 10)
+	  {
+	    std::cerr << "The size must be at least 10." << std::endl;
+	    return 1;
+	  }
+	break;
+
+      case 'S':
+	seed = atol(optarg);
+	break;
+
+      default:
+	usage(argv[0]);
+	return opt == 'h' ? 0 : 1;
+      }
+
+  srandom(seed);
+
+  std::cout << "# size\t" << size << std::endl
+	    << "# benchmark\titerations\ttotal_us\tper_iteration_us" << std::endl;
+
+  bench_imm_set(size, iterations);
+  bench_imm_map(size, iterations);
+  bench_setsets(size, iterations);
+  bench_choices(size, iterations);
+
+  return 0;
+}
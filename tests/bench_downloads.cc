@@ -0,0 +1,761 @@
+// bench_downloads.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+// Times the file cache and the download queue on a few hundred items
+// shaped like the ones the UI actually fetches: changelogs (a few to
+// a few dozen kilobytes of compressible text) and screenshots (PNG
+// files that are stored without compression).
+//
+// Each tier of the file cache (memory only, disk only, and both) is
+// filled past its capacity and then read back in a random order; the
+// latency of every put and get is recorded separately for puts that
+// fit, puts that have to evict something, hits, and misses.
+//
+// The download queue is then pointed at a small HTTP server started
+// on the loopback interface, which serves the same items.  Every item
+// is queued at once, and the time from queue_download() to the
+// success callback is recorded, first with an empty download cache
+// and then again once every item is cached and only needs to be
+// revalidated.
+//
+// Latencies are printed as one tab-separated line per benchmark, in
+// microseconds, so that runs can be compared mechanically.
+
+#include <aptitude.h>
+
+#include <generic/apt/apt.h>
+#include <generic/apt/download_queue.h>
+#include <generic/util/file_cache.h>
+#include <generic/util/temp.h>
+
+#include <apt-pkg/error.h>
+#include <apt-pkg/strutl.h>
+
+#include <cwidget/generic/threads/threads.h>
+#include <cwidget/generic/util/exception.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/ref.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using aptitude::util::file_cache;
+using boost::make_shared;
+using boost::shared_ptr;
+using cwidget::threads::condition;
+using cwidget::threads::mutex;
+using cwidget::threads::thread;
+
+namespace
+{
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  long long percentile(const std::vector<double> &sorted, int pct)
+  {
+    const std::vector<double>::size_type idx =
+      (sorted.size() - 1) * pct / 100;
+    return static_cast<long long>(sorted[idx] * 1000000);
+  }
+
+  void report(const std::string &name, std::vector<double> samples)
+  {
+    if(samples.empty())
+      return;
+
+    std::sort(samples.begin(), samples.end());
+    std::cout << name << '\t'
+	      << samples.size() << '\t'
+	      << percentile(samples, 50) << '\t'
+	      << percentile(samples, 90) << '\t'
+	      << percentile(samples, 99) << '\t'
+	      << static_cast<long long>(samples.back() * 1000000)
+	      << std::endl;
+  }
+
+  // One item that the benchmarks store and download.
+  struct fixture
+  {
+    std::string key;
+    std::string contents;
+    temp::name file;
+  };
+
+  const char * const changelog_words[] = {
+    "Fix", "crash", "when", "the", "package", "list", "is", "empty",
+    "Update", "translation", "New", "upstream", "release", "Closes:",
+    "Build-Depend", "on", "debhelper", "Install", "manpage", "into",
+    "correct", "directory", "Don't", "leak", "file", "descriptors",
+    "handle", "missing", "configuration", "gracefully", "Bump",
+    "Standards-Version", "policy", "compliance", "Remove", "obsolete"
+  };
+
+  // Generates text that looks (and compresses) roughly like a
+  // Debian changelog.
+  std::string make_changelog(std::string::size_type size)
+  {
+    const int num_words = sizeof(changelog_words) / sizeof(changelog_words[0]);
+    std::string rval;
+    int version = 1;
+
+    while(rval.size() < size)
+      {
+	char header[128];
+	snprintf(header, sizeof(header),
+		 "foo (1.%d-1) unstable; urgency=low\n\n", version++);
+	rval += header;
+
+	const int entries = 1 + rand() % 6;
+	for(int i = 0; i < entries; ++i)
+	  {
+	    rval += "  *";
+	    const int words = 4 + rand() % 16;
+	    for(int j = 0; j < words; ++j)
+	      {
+		rval += ' ';
+		rval += changelog_words[rand() % num_words];
+	      }
+	    rval += '\n';
+	  }
+
+	rval += "\n -- Some Maintainer <maint@example.org>  "
+	  "Mon, 01 Jan 2011 00:00:00 +0000\n\n";
+      }
+
+    rval.resize(size);
+    return rval;
+  }
+
+  // Generates a file with a PNG signature and incompressible
+  // contents, to stand in for a screenshot.
+  std::string make_screenshot(std::string::size_type size)
+  {
+    std::string rval("\x89PNG\r\n\x1a\n", 8);
+    while(rval.size() < size)
+      rval += static_cast<char>(rand() & 0xff);
+    return rval;
+  }
+
+  void make_fixtures(int count, std::vector<fixture> &out)
+  {
+    out.resize(count);
+    for(int i = 0; i < count; ++i)
+      {
+	fixture &f(out[i]);
+	char key[64];
+
+	// About a third of the items are screenshots, which are much
+	// larger than changelogs.
+	if(i % 3 == 2)
+	  {
+	    snprintf(key, sizeof(key), "screenshots/%d.png", i);
+	    f.contents = make_screenshot(40 * 1024 + rand() % (210 * 1024));
+	  }
+	else
+	  {
+	    snprintf(key, sizeof(key), "changelogs/%d/changelog", i);
+	    f.contents = make_changelog(4 * 1024 + rand() % (60 * 1024));
+	  }
+
+	f.key = key;
+	f.file = temp::name("fixture");
+	std::ofstream stream(f.file.get_name().c_str());
+	stream.write(f.contents.data(), f.contents.size());
+      }
+  }
+
+  void bench_cache(const std::string &tier,
+		   const std::vector<fixture> &fixtures,
+		   int memory_size, int disk_size)
+  {
+    const int capacity = std::max(memory_size, disk_size);
+    temp::name cache_name("cache");
+    shared_ptr<file_cache> cache;
+    try
+      {
+	cache = file_cache::create(cache_name.get_name(),
+				   memory_size, disk_size);
+      }
+    catch(cwidget::util::Exception &ex)
+      {
+	std::cerr << "Can't create the " << tier << " cache: "
+		  << ex.errmsg() << std::endl;
+	return;
+      }
+
+    // Puts are counted as evicting once the items stored so far
+    // exceed the cache's capacity.  This is approximate for the
+    // on-disk tier, which compresses the changelogs.
+    std::vector<double> put_times, evicting_put_times;
+    long long stored = 0;
+    for(std::vector<fixture>::const_iterator it = fixtures.begin();
+	it != fixtures.end(); ++it)
+      {
+	stored += it->contents.size();
+
+	const double start = now();
+	cache->putItem(it->key, it->file.get_name(), 0);
+	const double elapsed = now() - start;
+
+	if(stored > capacity)
+	  evicting_put_times.push_back(elapsed);
+	else
+	  put_times.push_back(elapsed);
+      }
+
+    std::vector<const fixture *> order;
+    for(std::vector<fixture>::const_iterator it = fixtures.begin();
+	it != fixtures.end(); ++it)
+      order.push_back(&*it);
+    std::random_shuffle(order.begin(), order.end());
+
+    std::vector<double> hit_times, miss_times, contents_times;
+    for(std::vector<const fixture *>::const_iterator it = order.begin();
+	it != order.end(); ++it)
+      {
+	time_t mtime;
+
+	double start = now();
+	const bool hit = cache->getItem((*it)->key, mtime).valid();
+	double elapsed = now() - start;
+	(hit ? hit_times : miss_times).push_back(elapsed);
+
+	if(hit)
+	  {
+	    start = now();
+	    cache->getItemContents((*it)->key, mtime);
+	    contents_times.push_back(now() - start);
+	  }
+      }
+
+    report(tier + " put", put_times);
+    report(tier + " put-evicting", evicting_put_times);
+    report(tier + " get-hit", hit_times);
+    report(tier + " get-miss", miss_times);
+    report(tier + " get-contents-hit", contents_times);
+  }
+
+  /** \brief A minimal HTTP/1.1 server that serves the fixtures from
+   *  memory on the loopback interface.
+   *
+   *  It understands just enough of the protocol for apt's http
+   *  method: persistent and pipelined connections, and
+   *  If-Modified-Since.
+   */
+  class fixture_server
+  {
+    std::map<std::string, const fixture *> files;
+    time_t mtime;
+    int listen_fd;
+    int port;
+
+    mutex threads_mutex;
+    shared_ptr<thread> accept_thread;
+    std::vector<shared_ptr<thread> > connection_threads;
+
+    class accept_bootstrap
+    {
+      fixture_server *server;
+
+    public:
+      accept_bootstrap(fixture_server *_server)
+	: server(_server)
+      {
+      }
+
+      void operator()() const
+      {
+	server->run_accept();
+      }
+    };
+
+    class connection_bootstrap
+    {
+      fixture_server *server;
+      int fd;
+
+    public:
+      connection_bootstrap(fixture_server *_server, int _fd)
+	: server(_server), fd(_fd)
+      {
+      }
+
+      void operator()() const
+      {
+	server->serve(fd);
+      }
+    };
+
+    static bool write_all(int fd, const std::string &data)
+    {
+      std::string::size_type written = 0;
+      while(written < data.size())
+	{
+	  const ssize_t n = send(fd, data.data() + written,
+				 data.size() - written, MSG_NOSIGNAL);
+	  if(n < 0 && errno == EINTR)
+	    continue;
+	  else if(n <= 0)
+	    return false;
+	  written += n;
+	}
+
+      return true;
+    }
+
+    std::string respond(const std::string &request, bool &close) const
+    {
+      std::string::size_type eol = request.find("\r\n");
+      const std::string request_line(request, 0, eol);
+
+      // "GET /path HTTP/1.1"
+      const std::string::size_type path_start = request_line.find(' ');
+      const std::string::size_type path_end =
+	request_line.find(' ', path_start + 1);
+      std::string path;
+      if(path_start != std::string::npos && path_end != std::string::npos)
+	path = std::string(request_line, path_start + 2,
+			   path_end - path_start - 2);
+
+      close = request_line.find("HTTP/1.0") != std::string::npos;
+      time_t if_modified_since = 0;
+      while(eol != std::string::npos && eol + 2 < request.size())
+	{
+	  const std::string::size_type start = eol + 2;
+	  eol = request.find("\r\n", start);
+	  const std::string header(request, start, eol - start);
+
+	  if(strncasecmp(header.c_str(), "If-Modified-Since: ", 19) == 0)
+	    {
+	      if(!RFC1123StrToTime(header.c_str() + 19, if_modified_since))
+		if_modified_since = 0;
+	    }
+	  else if(strcasecmp(header.c_str(), "Connection: close") == 0)
+	    close = true;
+	}
+
+      const std::map<std::string, const fixture *>::const_iterator found =
+	files.find(path);
+      const std::string last_modified =
+	"Last-Modified: " + TimeRFC1123(mtime) + "\r\n";
+
+      if(found == files.end())
+	return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      else if(if_modified_since >= mtime)
+	return "HTTP/1.1 304 Not Modified\r\n" + last_modified + "\r\n";
+      else
+	{
+	  char length[64];
+	  snprintf(length, sizeof(length), "Content-Length: %lu\r\n",
+		   static_cast<unsigned long>(found->second->contents.size()));
+	  return "HTTP/1.1 200 OK\r\n" + last_modified + length + "\r\n"
+	    + found->second->contents;
+	}
+    }
+
+    void serve(int fd)
+    {
+      std::string buffer;
+      char chunk[4096];
+      bool done = false;
+
+      while(!done)
+	{
+	  const std::string::size_type end = buffer.find("\r\n\r\n");
+	  if(end == std::string::npos)
+	    {
+	      const ssize_t n = read(fd, chunk, sizeof(chunk));
+	      if(n < 0 && errno == EINTR)
+		continue;
+	      else if(n <= 0)
+		break;
+
+	      buffer.append(chunk, n);
+	      continue;
+	    }
+
+	  const std::string request(buffer, 0, end + 2);
+	  buffer.erase(0, end + 4);
+
+	  bool close = false;
+	  const std::string response(respond(request, close));
+	  done = !write_all(fd, response) || close;
+	}
+
+      ::close(fd);
+    }
+
+    void run_accept()
+    {
+      while(true)
+	{
+	  const int fd = accept(listen_fd, NULL, NULL);
+	  if(fd < 0)
+	    {
+	      if(errno == EINTR)
+		continue;
+	      else
+		break;
+	    }
+
+	  mutex::lock l(threads_mutex);
+	  connection_threads.push_back(make_shared<thread>(connection_bootstrap(this, fd)));
+	}
+    }
+
+  public:
+    fixture_server(const std::vector<fixture> &fixtures)
+      : mtime(time(NULL) - 3600), listen_fd(-1), port(0)
+    {
+      for(std::vector<fixture>::const_iterator it = fixtures.begin();
+	  it != fixtures.end(); ++it)
+	files[it->key] = &*it;
+    }
+
+    /** \brief Start listening on an unused port.
+     *
+     *  \return \b false if the socket couldn't be set up; the
+     *  reason is pushed onto the global error stack.
+     */
+    bool start()
+    {
+      listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+      if(listen_fd < 0)
+	return _error->Errno("socket", "Can't create the HTTP server's socket");
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = 0;
+
+      socklen_t addr_len = sizeof(addr);
+      if(bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+	 listen(listen_fd, 64) < 0 ||
+	 getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len) < 0)
+	{
+	  _error->Errno("bind", "Can't listen on the loopback interface");
+	  ::close(listen_fd);
+	  listen_fd = -1;
+	  return false;
+	}
+
+      port = ntohs(addr.sin_port);
+      accept_thread = make_shared<thread>(accept_bootstrap(this));
+      return true;
+    }
+
+    /** \brief Stop accepting connections and wait for the open
+     *  connections to be closed by their clients.
+     */
+    void stop()
+    {
+      if(listen_fd < 0)
+	return;
+
+      // Wakes up accept() in the listening thread.
+      shutdown(listen_fd, SHUT_RDWR);
+      accept_thread->join();
+      ::close(listen_fd);
+      listen_fd = -1;
+
+      std::vector<shared_ptr<thread> > threads_copy;
+      {
+	mutex::lock l(threads_mutex);
+	threads_copy.swap(connection_threads);
+      }
+
+      for(std::vector<shared_ptr<thread> >::const_iterator it =
+	    threads_copy.begin(); it != threads_copy.end(); ++it)
+	(*it)->join();
+    }
+
+    std::string get_uri(const fixture &f) const
+    {
+      char base[64];
+      snprintf(base, sizeof(base), "http://127.0.0.1:%d/", port);
+      return base + f.key;
+    }
+  };
+
+  // Counts the downloads of one pass as they finish.
+  struct download_tracker
+  {
+    mutex m;
+    condition c;
+    std::size_t outstanding;
+    std::size_t failures;
+    std::string first_failure;
+    std::vector<double> latencies;
+
+    download_tracker()
+      : outstanding(0), failures(0)
+    {
+    }
+
+    void finish(double latency)
+    {
+      mutex::lock l(m);
+      latencies.push_back(latency);
+      --outstanding;
+      c.wake_all();
+    }
+
+    void fail(const std::string &msg)
+    {
+      mutex::lock l(m);
+      if(failures == 0)
+	first_failure = msg;
+      ++failures;
+      --outstanding;
+      c.wake_all();
+    }
+
+    void wait()
+    {
+      mutex::lock l(m);
+      while(outstanding > 0)
+	c.wait(l);
+    }
+  };
+
+  class bench_callbacks : public aptitude::download_callbacks
+  {
+    download_tracker &tracker;
+    double started;
+
+  public:
+    bench_callbacks(download_tracker &_tracker)
+      : tracker(_tracker), started(now())
+    {
+    }
+
+    void success(const temp::name &filename)
+    {
+      tracker.finish(now() - started);
+    }
+
+    void failure(const std::string &msg)
+    {
+      tracker.fail(msg);
+    }
+
+    void canceled()
+    {
+      tracker.fail("canceled");
+    }
+  };
+
+  // The benchmark has no main loop, so events from the download
+  // thread are handled as soon as they arrive.
+  void run_thunk(const sigc::slot<void> &thunk)
+  {
+    thunk();
+  }
+
+  void bench_download_pass(const std::string &name,
+			   const fixture_server &server,
+			   const std::vector<fixture> &fixtures)
+  {
+    download_tracker tracker;
+    std::vector<shared_ptr<aptitude::download_request> > requests;
+
+    tracker.outstanding = fixtures.size();
+    const double start = now();
+    for(std::vector<fixture>::const_iterator it = fixtures.begin();
+	it != fixtures.end(); ++it)
+      requests.push_back(aptitude::queue_download(server.get_uri(*it),
+						  it->key,
+						  make_shared<bench_callbacks>(boost::ref(tracker)),
+						  &run_thunk));
+    tracker.wait();
+    const double elapsed = now() - start;
+
+    report(name, tracker.latencies);
+    std::cout << "# " << name << " took "
+	      << static_cast<long long>(elapsed * 1000000) << " us" << std::endl;
+    if(tracker.failures > 0)
+      std::cerr << tracker.failures << " downloads failed in " << name
+		<< "; the first failure was: " << tracker.first_failure
+		<< std::endl;
+  }
+
+  void bench_downloads(const std::vector<fixture> &fixtures,
+		       int cache_size)
+  {
+    fixture_server server(fixtures);
+    if(!server.start())
+      {
+	_error->DumpErrors();
+	return;
+      }
+
+    // The download queue stores every finished item in the download
+    // cache, so it needs one even for the first pass.
+    temp::name cache_name("download-cache");
+    try
+      {
+	download_cache = file_cache::create(cache_name.get_name(),
+					    cache_size / 4, cache_size);
+      }
+    catch(cwidget::util::Exception &ex)
+      {
+	std::cerr << "Can't create the download cache: "
+		  << ex.errmsg() << std::endl;
+	server.stop();
+	return;
+      }
+
+    bench_download_pass("download-cold", server, fixtures);
+    bench_download_pass("download-revalidate", server, fixtures);
+
+    aptitude::shutdown_download_queue();
+    download_cache.reset();
+    server.stop();
+  }
+
+  void usage(const char *progname)
+  {
+    std::cerr << "Usage: " << progname << " [options]" << std::endl
+	      << std::endl
+	      << " -o KEY=VALUE          Set a configuration option." << std::endl
+	      << " -n, --items N         Use N items (default 300)." << std::endl
+	      << " --seed N              Seed the item generator with N." << std::endl
+	      << " --no-download         Only benchmark the file cache." << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int items = 300;
+  unsigned int seed = 1;
+  bool download = true;
+  std::vector<std::pair<std::string, std::string> > settings;
+
+  enum { OPTION_SEED = 256, OPTION_NO_DOWNLOAD };
+  static const struct option long_options[] = {
+    { "items", required_argument, NULL, 'n' },
+    { "seed", required_argument, NULL, OPTION_SEED },
+    { "no-download", no_argument, NULL, OPTION_NO_DOWNLOAD },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "o:n:h", long_options, NULL)) != -1)
+    switch(opt)
+      {
+      case 'o':
+	{
+	  const std::string s(optarg);
+	  const std::string::size_type eqloc = s.find('=');
+	  if(eqloc == std::string::npos || eqloc == 0)
+	    {
+	      std::cerr << "-o requires an argument of the form key=value, got "
+			<< optarg << std::endl;
+	      return 1;
+	    }
+
+	  settings.push_back(std::make_pair(std::string(s, 0, eqloc),
+					    std::string(s, eqloc + 1)));
+	}
+	break;
+
+      case 'n':
+	items = atoi(optarg);
+	if(items < 1)
+	  {
+	    std::cerr << "The number of items must be positive." << std::endl;
+	    return 1;
+	  }
+	break;
+
+      case OPTION_SEED:
+	seed = strtoul(optarg, NULL, 10);
+	break;
+
+      case OPTION_NO_DOWNLOAD:
+	download = false;
+	break;
+
+      default:
+	usage(argv[0]);
+	return opt == 'h' ? 0 : 1;
+      }
+
+  apt_preinit(NULL);
+  for(std::vector<std::pair<std::string, std::string> >::const_iterator
+	it = settings.begin(); it != settings.end(); ++it)
+    aptcfg->SetNoUser(it->first, it->second);
+
+  temp::initialize("bench_downloads");
+  srand(seed);
+
+  std::vector<fixture> fixtures;
+  make_fixtures(items, fixtures);
+
+  long long total_size = 0;
+  for(std::vector<fixture>::const_iterator it = fixtures.begin();
+      it != fixtures.end(); ++it)
+    total_size += it->contents.size();
+
+  // Size the caches so that only part of the items fit, as in a
+  // long session of browsing changelogs and screenshots.
+  const int cache_size = static_cast<int>(total_size / 4);
+
+  std::cout << "# items\t" << items << std::endl
+	    << "# total_bytes\t" << total_size << std::endl
+	    << "# cache_bytes\t" << cache_size << std::endl
+	    << "# benchmark\tcount\tp50_us\tp90_us\tp99_us\tmax_us" << std::endl;
+
+  bench_cache("memory", fixtures, cache_size, 0);
+  bench_cache("disk", fixtures, 0, cache_size);
+  bench_cache("tiered", fixtures, cache_size / 4, cache_size);
+
+  if(download)
+    bench_downloads(fixtures, cache_size);
+
+  fixtures.clear();
+  temp::shutdown();
+
+  _error->DumpErrors();
+  return 0;
+}
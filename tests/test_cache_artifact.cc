@@ -0,0 +1,138 @@
+// test_cache_artifact.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/cache_artifact.h>
+#include <generic/util/logging.h>
+#include <generic/util/temp.h>
+
+#include <sys/stat.h>
+
+#include <string>
+
+using aptitude::apt::cache_artifact_reader;
+using aptitude::apt::cache_artifact_writer;
+using aptitude::util::logging::Logger;
+using aptitude::util::logging::LoggerPtr;
+
+namespace
+{
+  class usingTemp
+  {
+  public:
+    usingTemp()
+    {
+      temp::initialize("testCacheArtifact");
+    }
+
+    ~usingTemp()
+    {
+      temp::shutdown();
+    }
+  };
+
+  bool exists(const std::string &s)
+  {
+    struct stat buf;
+
+    return stat(s.c_str(), &buf) == 0;
+  }
+
+  LoggerPtr getLogger()
+  {
+    return Logger::getLogger("test.cacheArtifact");
+  }
+
+  void write_artifact(const std::string &path,
+		      const std::string &fingerprint,
+		      const std::string &body)
+  {
+    cache_artifact_writer writer(path, "test artifact 1", fingerprint,
+				 "test artifact", getLogger());
+    BOOST_REQUIRE(writer.is_open());
+    writer.get_stream() << body << '\n';
+    BOOST_REQUIRE(writer.commit());
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(cacheArtifactRoundTrip, usingTemp)
+{
+  temp::name tn("artifact");
+  const std::string path = tn.get_name();
+
+  write_artifact(path, "fingerprint 1", "hello");
+  BOOST_CHECK(exists(path));
+  BOOST_CHECK(!exists(path + ".new"));
+
+  cache_artifact_reader reader(path, "test artifact 1", "fingerprint 1",
+			       "test artifact", getLogger());
+  BOOST_REQUIRE(reader.is_valid());
+
+  std::string body;
+  reader.get_stream() >> body;
+  BOOST_CHECK_EQUAL(body, "hello");
+}
+
+BOOST_FIXTURE_TEST_CASE(cacheArtifactStale, usingTemp)
+{
+  temp::name tn("artifact");
+  const std::string path = tn.get_name();
+
+  write_artifact(path, "fingerprint 1", "hello");
+
+  cache_artifact_reader stale(path, "test artifact 1", "fingerprint 2",
+			      "test artifact", getLogger());
+  BOOST_CHECK(!stale.is_valid());
+
+  cache_artifact_reader wrong_kind(path, "other artifact 1", "fingerprint 1",
+				   "test artifact", getLogger());
+  BOOST_CHECK(!wrong_kind.is_valid());
+
+  cache_artifact_reader missing(path + ".missing", "test artifact 1",
+				"fingerprint 1", "test artifact",
+				getLogger());
+  BOOST_CHECK(!missing.is_valid());
+}
+
+BOOST_FIXTURE_TEST_CASE(cacheArtifactAbandoned, usingTemp)
+{
+  temp::name tn("artifact");
+  const std::string path = tn.get_name();
+
+  write_artifact(path, "fingerprint 1", "hello");
+
+  // A writer that is never committed leaves the old file alone.
+  {
+    cache_artifact_writer writer(path, "test artifact 1", "fingerprint 2",
+				 "test artifact", getLogger());
+    BOOST_REQUIRE(writer.is_open());
+    writer.get_stream() << "goodbye\n";
+  }
+
+  BOOST_CHECK(!exists(path + ".new"));
+
+  cache_artifact_reader reader(path, "test artifact 1", "fingerprint 1",
+			       "test artifact", getLogger());
+  BOOST_REQUIRE(reader.is_valid());
+
+  std::string body;
+  reader.get_stream() >> body;
+  BOOST_CHECK_EQUAL(body, "hello");
+}
@@ -0,0 +1,181 @@
+// test_changelog_parse.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/changelog_parse.h>
+#include <generic/util/temp.h>
+
+#include <fstream>
+#include <string>
+
+using aptitude::apt::changelog;
+using aptitude::apt::changelog_entry;
+using aptitude::apt::changelog_index;
+using aptitude::apt::changelog_reader;
+using cwidget::util::ref_ptr;
+
+namespace
+{
+  class usingTemp
+  {
+  public:
+    usingTemp()
+    {
+      temp::initialize("testChangelogParse");
+    }
+
+    ~usingTemp()
+    {
+      temp::shutdown();
+    }
+  };
+
+  const char *entry1 =
+    "foo (1.2-1) unstable; urgency=low\n"
+    "\n"
+    "  * New upstream release.\n"
+    "    Closes: #123\n"
+    "\n"
+    "  * Another change.\n"
+    "\n"
+    " -- Jane Doe <jane@example.org>  Thu, 24 Sep 2009 18:47:12 +0200\n";
+
+  const char *entry2 =
+    "foo (1.1-1) experimental; urgency=medium\n"
+    "\n"
+    "  * Initial release.\n"
+    "\n"
+    " -- Jane Doe <jane@example.org>  Wed, 23 Sep 2009 18:47:12 +0200\n";
+
+  void write_file(const std::string &path, const std::string &contents)
+  {
+    std::ofstream out(path.c_str());
+    out << contents;
+    BOOST_REQUIRE(out);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(changelogReaderEntries, usingTemp)
+{
+  temp::name tn("changelog");
+  const std::string contents = std::string(entry1) + "\n" + entry2 + "\n";
+  write_file(tn.get_name(), contents);
+
+  changelog_reader reader(tn.get_name());
+  BOOST_REQUIRE(reader.is_open());
+
+  ref_ptr<changelog_entry> first = reader.next();
+  BOOST_REQUIRE(first.valid());
+  BOOST_CHECK_EQUAL(first->get_source(), "foo");
+  BOOST_CHECK_EQUAL(first->get_version(), "1.2-1");
+  BOOST_CHECK_EQUAL(first->get_distribution(), "unstable");
+  BOOST_CHECK_EQUAL(first->get_urgency(), "low");
+  BOOST_CHECK_EQUAL(first->get_maintainer(), "Jane Doe <jane@example.org>");
+  BOOST_CHECK_EQUAL(first->get_changes(),
+		    "foo (1.2-1) unstable; urgency=low\n"
+		    " .\n"
+		    "   * New upstream release.\n"
+		    "     Closes: #123\n"
+		    " .\n"
+		    "   * Another change.");
+  BOOST_CHECK_EQUAL(reader.get_entry_begin(), 0);
+  BOOST_CHECK_EQUAL(reader.get_entry_end(), (std::streamoff)std::string(entry1).size());
+
+  ref_ptr<changelog_entry> second = reader.next();
+  BOOST_REQUIRE(second.valid());
+  BOOST_CHECK_EQUAL(second->get_version(), "1.1-1");
+  BOOST_CHECK_EQUAL(second->get_urgency(), "medium");
+  BOOST_CHECK_EQUAL(reader.get_entry_begin(), (std::streamoff)std::string(entry1).size() + 1);
+
+  BOOST_CHECK(!reader.next().valid());
+}
+
+BOOST_FIXTURE_TEST_CASE(changelogReaderStopsAtTerminator, usingTemp)
+{
+  temp::name tn("changelog");
+  const std::string contents = std::string(entry1) + "\n"
+    + "Local variables:\n" + entry2;
+  write_file(tn.get_name(), contents);
+
+  changelog_reader reader(tn.get_name());
+  BOOST_REQUIRE(reader.is_open());
+
+  BOOST_CHECK(reader.next().valid());
+  BOOST_CHECK(!reader.next().valid());
+}
+
+BOOST_FIXTURE_TEST_CASE(changelogIndexRoundTrip, usingTemp)
+{
+  temp::name tn("changelog");
+  const std::string contents = std::string(entry1) + "\n" + entry2 + "\n";
+  write_file(tn.get_name(), contents);
+
+  changelog_index index;
+  BOOST_REQUIRE(index.build(tn.get_name()));
+  BOOST_REQUIRE_EQUAL(index.get_entries().size(), 2);
+
+  temp::name index_name("index");
+  BOOST_REQUIRE(index.save(index_name.get_name()));
+
+  changelog_index loaded;
+  BOOST_REQUIRE(loaded.load(index_name.get_name()));
+  BOOST_REQUIRE_EQUAL(loaded.get_entries().size(), 2);
+  BOOST_CHECK(loaded.matches(tn.get_name()));
+
+  for(int i = 0; i < 2; ++i)
+    {
+      const aptitude::apt::changelog_index_entry &expected = index.get_entries()[i];
+      const aptitude::apt::changelog_index_entry &actual = loaded.get_entries()[i];
+
+      BOOST_CHECK_EQUAL(actual.get_begin(), expected.get_begin());
+      BOOST_CHECK_EQUAL(actual.get_end(), expected.get_end());
+      BOOST_CHECK_EQUAL(actual.get_version(), expected.get_version());
+      BOOST_CHECK_EQUAL(actual.get_distribution(), expected.get_distribution());
+      BOOST_CHECK_EQUAL(actual.get_urgency(), expected.get_urgency());
+      BOOST_CHECK_EQUAL(actual.get_maintainer(), expected.get_maintainer());
+      BOOST_CHECK_EQUAL(actual.get_date(), expected.get_date());
+    }
+
+  BOOST_CHECK_EQUAL(loaded.get_entries()[1].get_version(), "1.1-1");
+  BOOST_CHECK_EQUAL(loaded.get_entries()[1].get_date(), "Wed, 23 Sep 2009 18:47:12 +0200");
+
+  ref_ptr<changelog> parsed = loaded.parse(tn.get_name(), "");
+  BOOST_REQUIRE(parsed.valid());
+  BOOST_REQUIRE_EQUAL(parsed->size(), 2);
+  BOOST_CHECK_EQUAL((*parsed->begin())->get_version(), "1.2-1");
+  BOOST_CHECK_EQUAL((*(parsed->begin() + 1))->get_changes(),
+		    "foo (1.1-1) experimental; urgency=medium\n"
+		    " .\n"
+		    "   * Initial release.");
+}
+
+BOOST_FIXTURE_TEST_CASE(changelogIndexStale, usingTemp)
+{
+  temp::name tn("changelog");
+  write_file(tn.get_name(), std::string(entry1) + "\n" + entry2);
+
+  changelog_index index;
+  BOOST_REQUIRE(index.build(tn.get_name()));
+
+  write_file(tn.get_name(), std::string(entry2));
+
+  BOOST_CHECK(!index.matches(tn.get_name()));
+  BOOST_CHECK(!index.parse(tn.get_name(), "").valid());
+}
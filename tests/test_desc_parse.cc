@@ -0,0 +1,124 @@
+// test_desc_parse.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/desc_parse.h>
+
+#include <string>
+#include <vector>
+
+using aptitude::description_element;
+using aptitude::description_element_ref;
+using aptitude::lazy_description;
+
+namespace
+{
+  const std::wstring sample_description =
+    L"short description\n"
+    L" First paragraph\n"
+    L" continues here.\n"
+    L" .\n"
+    L"  literal line\n"
+    L" .\n"
+    L"  * item one\n"
+    L"  * item two\n";
+
+  void check_paragraph(const description_element_ref &elt,
+		       const std::wstring &text)
+  {
+    BOOST_REQUIRE_EQUAL(elt->get_type(), description_element::paragraph);
+    BOOST_CHECK(elt->get_string() == text);
+  }
+
+  void check_bullet(const description_element_ref &elt,
+		    const std::wstring &text)
+  {
+    BOOST_REQUIRE_EQUAL(elt->get_type(), description_element::bullet_list);
+    BOOST_REQUIRE_EQUAL(elt->get_elements().size(), 1U);
+    check_paragraph(elt->get_elements()[0], text);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lazyDescriptionElements)
+{
+  lazy_description desc(sample_description, true);
+
+  const std::vector<description_element_ref> &elements(desc.get_elements());
+  BOOST_REQUIRE_EQUAL(elements.size(), 6U);
+
+  check_paragraph(elements[0], L"First paragraph continues here. ");
+  BOOST_CHECK_EQUAL(elements[1]->get_type(), description_element::blank_line);
+  BOOST_REQUIRE_EQUAL(elements[2]->get_type(), description_element::literal);
+  BOOST_CHECK(elements[2]->get_string() == L"literal line");
+  BOOST_CHECK_EQUAL(elements[3]->get_type(), description_element::blank_line);
+  check_bullet(elements[4], L"item one ");
+  check_bullet(elements[5], L"item two ");
+}
+
+BOOST_AUTO_TEST_CASE(lazyDescriptionWithoutBullets)
+{
+  lazy_description desc(sample_description, false);
+
+  const std::vector<description_element_ref> &elements(desc.get_elements());
+  BOOST_REQUIRE_EQUAL(elements.size(), 6U);
+
+  BOOST_REQUIRE_EQUAL(elements[4]->get_type(), description_element::literal);
+  BOOST_CHECK(elements[4]->get_string() == L"* item one");
+  BOOST_REQUIRE_EQUAL(elements[5]->get_type(), description_element::literal);
+  BOOST_CHECK(elements[5]->get_string() == L"* item two");
+}
+
+BOOST_AUTO_TEST_CASE(lazyDescriptionFirstLines)
+{
+  lazy_description desc(sample_description, true);
+
+  // The first paragraph covers the first two lines.
+  std::vector<description_element_ref> first;
+  desc.get_first_lines(2, first);
+  BOOST_REQUIRE_EQUAL(first.size(), 1U);
+  check_paragraph(first[0], L"First paragraph continues here. ");
+
+  std::vector<description_element_ref> more;
+  desc.get_first_lines(4, more);
+  BOOST_REQUIRE_EQUAL(more.size(), 3U);
+  BOOST_CHECK(more[0] == first[0]);
+  BOOST_CHECK_EQUAL(more[1]->get_type(), description_element::blank_line);
+  BOOST_CHECK_EQUAL(more[2]->get_type(), description_element::literal);
+
+  // Reading the beginning doesn't change the rest.
+  BOOST_CHECK_EQUAL(desc.get_elements().size(), 6U);
+
+  std::vector<description_element_ref> all;
+  desc.get_first_lines(100, all);
+  BOOST_CHECK_EQUAL(all.size(), 6U);
+}
+
+BOOST_AUTO_TEST_CASE(lazyDescriptionEmpty)
+{
+  lazy_description no_text;
+  BOOST_CHECK(no_text.get_elements().empty());
+
+  lazy_description short_only(L"short description only", true);
+  BOOST_CHECK(short_only.get_elements().empty());
+
+  std::vector<description_element_ref> first;
+  short_only.get_first_lines(1, first);
+  BOOST_CHECK(first.empty());
+}
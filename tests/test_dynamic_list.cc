@@ -285,6 +285,36 @@ namespace
     return out;
   }
 
+  /** \brief Records the calls to a list's range signals. */
+  class dynamic_list_range_signals
+  {
+  public:
+    typedef std::pair<std::vector<int>, std::size_t> range_call;
+
+  private:
+    std::vector<range_call> inserted_ranges, removed_ranges;
+
+    void inserted(const std::vector<int> &values, std::size_t position)
+    {
+      inserted_ranges.push_back(range_call(values, position));
+    }
+
+    void removed(const std::vector<int> &values, std::size_t position)
+    {
+      removed_ranges.push_back(range_call(values, position));
+    }
+
+  public:
+    void attach(dynamic_list<int> &list)
+    {
+      list.signal_inserted_range.connect(sigc::mem_fun(*this, &dynamic_list_range_signals::inserted));
+      list.signal_removed_range.connect(sigc::mem_fun(*this, &dynamic_list_range_signals::removed));
+    }
+
+    const std::vector<range_call> &get_inserted() const { return inserted_ranges; }
+    const std::vector<range_call> &get_removed() const { return removed_ranges; }
+  };
+
   struct list_test
   {
     boost::shared_ptr<dynamic_list_impl<int> > valuesPtr;
@@ -724,6 +754,71 @@ BOOST_FIXTURE_TEST_CASE(dynamicListMoveFrontToLast, list_test)
                                 signals.begin(), signals.end());
 }
 
+BOOST_FIXTURE_TEST_CASE(dynamicListInsertRange, list_test)
+{
+  dynamic_list_range_signals ranges;
+  ranges.attach(values);
+
+  std::vector<int> new_values;
+  new_values.push_back(7);
+  new_values.push_back(8);
+  values.insert_range(new_values, 1);
+
+  expected.insert(expected.begin() + 1, new_values.begin(), new_values.end());
+
+  std::vector<int> values_vector = as_vector();
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                values_vector.begin(), values_vector.end());
+
+  // Only the range signal is emitted.
+  BOOST_CHECK(signals.begin() == signals.end());
+
+  BOOST_REQUIRE_EQUAL(ranges.get_inserted().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_inserted()[0].second, 1U);
+  BOOST_CHECK_EQUAL_COLLECTIONS(new_values.begin(), new_values.end(),
+                                ranges.get_inserted()[0].first.begin(),
+                                ranges.get_inserted()[0].first.end());
+  BOOST_CHECK(ranges.get_removed().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicListInsertEmptyRange, list_test)
+{
+  dynamic_list_range_signals ranges;
+  ranges.attach(values);
+
+  values.insert_range(std::vector<int>(), 1);
+
+  std::vector<int> values_vector = as_vector();
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                values_vector.begin(), values_vector.end());
+
+  BOOST_CHECK(ranges.get_inserted().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicListRemoveRange, list_test)
+{
+  dynamic_list_range_signals ranges;
+  ranges.attach(values);
+
+  values.remove_range(1, 2);
+
+  std::vector<int> removed_values(expected.begin() + 1, expected.end());
+  expected.erase(expected.begin() + 1, expected.end());
+
+  std::vector<int> values_vector = as_vector();
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                values_vector.begin(), values_vector.end());
+
+  BOOST_CHECK(signals.begin() == signals.end());
+
+  BOOST_REQUIRE_EQUAL(ranges.get_removed().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_removed()[0].second, 1U);
+  BOOST_CHECK_EQUAL_COLLECTIONS(removed_values.begin(), removed_values.end(),
+                                ranges.get_removed()[0].first.begin(),
+                                ranges.get_removed()[0].first.end());
+  BOOST_CHECK(ranges.get_inserted().empty());
+}
+
 struct list_collection_test
 {
   boost::shared_ptr<writable_dynamic_list<int> > list1, list2, list3;
@@ -968,3 +1063,71 @@ BOOST_FIXTURE_TEST_CASE(dynamicListCollectionMoveInSublist, list_collection_test
   BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
                                 signals.begin(), signals.end());
 }
+
+BOOST_FIXTURE_TEST_CASE(dynamicListCollectionInsertRangeIntoSublist, list_collection_test)
+{
+  collection->add_list(list1);
+  collection->add_list(list2);
+
+  signals.clear();
+
+  dynamic_list_range_signals ranges;
+  ranges.attach(*collection);
+
+  // Now [1, 2, 3, 5]
+  std::vector<int> new_values;
+  new_values.push_back(8);
+  new_values.push_back(9);
+  list1->insert_range(new_values, 1); // Now [1, 8, 9, 2, 3, 5]
+  list1->insert(4, 5);                // Now [1, 8, 9, 2, 3, 5, 4]
+  list1->insert(7, 3);                // Now [1, 8, 9, 7, 2, 3, 5, 4]
+
+  expected.push_back(ins(4, 6));
+  expected.push_back(ins(7, 3));
+
+  const int expected_values_begin[] = { 1, 8, 9, 7, 2, 3, 5, 4 };
+  const int expected_values_size =
+    sizeof(expected_values_begin) / sizeof(expected_values_begin[0]);
+  const int * const expected_values_end =
+    expected_values_begin + expected_values_size;
+
+  std::vector<int> collection_vector = as_vector(*collection);
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected_values_begin, expected_values_end,
+                                collection_vector.begin(), collection_vector.end());
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                signals.begin(), signals.end());
+
+  BOOST_REQUIRE_EQUAL(ranges.get_inserted().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_inserted()[0].second, 1U);
+  BOOST_CHECK_EQUAL_COLLECTIONS(new_values.begin(), new_values.end(),
+                                ranges.get_inserted()[0].first.begin(),
+                                ranges.get_inserted()[0].first.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicListCollectionRemoveRangeFromSublist, list_collection_test)
+{
+  collection->add_list(list1);
+  collection->add_list(list2);
+  list1->insert(4, 3);
+
+  signals.clear();
+
+  // Now [1, 2, 3, 5, 4]; list1's cells aren't all adjacent, so its
+  // removals are forwarded one at a time.
+  list1->remove_range(1, 3); // Now [1, 5]
+  list1->remove(0);          // Now [5]
+
+  expected.push_back(rem(2, 1));
+  expected.push_back(rem(3, 1));
+  expected.push_back(rem(4, 2));
+  expected.push_back(rem(1, 0));
+
+  std::vector<int> collection_vector = as_vector(*collection);
+  BOOST_REQUIRE_EQUAL(collection_vector.size(), 1U);
+  BOOST_CHECK_EQUAL(collection_vector[0], 5);
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                signals.begin(), signals.end());
+}
@@ -28,6 +28,7 @@
 #include <boost/variant.hpp>
 #include <boost/weak_ptr.hpp>
 
+#include <algorithm>
 #include <vector>
 
 using aptitude::util::dynamic_set;
@@ -242,6 +243,36 @@ namespace
     return out;
   }
 
+  /** \brief Records the ranges passed to a set's range signals. */
+  class dynamic_set_range_signals
+  {
+    std::vector<std::vector<int> > inserted_ranges, removed_ranges;
+
+    void inserted(const std::vector<int> &values)
+    {
+      inserted_ranges.push_back(values);
+      std::sort(inserted_ranges.back().begin(), inserted_ranges.back().end());
+    }
+
+    void removed(const std::vector<int> &values)
+    {
+      removed_ranges.push_back(values);
+      std::sort(removed_ranges.back().begin(), removed_ranges.back().end());
+    }
+
+  public:
+    void attach(dynamic_set<int> &set)
+    {
+      set.connect_inserted_range(sigc::mem_fun(*this, &dynamic_set_range_signals::inserted));
+      set.connect_removed_range(sigc::mem_fun(*this, &dynamic_set_range_signals::removed));
+    }
+
+    /** \brief Get the values of each inserted range, sorted. */
+    const std::vector<std::vector<int> > &get_inserted() const { return inserted_ranges; }
+    /** \brief Get the values of each removed range, sorted. */
+    const std::vector<std::vector<int> > &get_removed() const { return removed_ranges; }
+  };
+
   struct set_test
   {
     shared_ptr<writable_dynamic_set<int> > valuesPtr;
@@ -522,6 +553,82 @@ BOOST_FIXTURE_TEST_CASE(dynamicSetRemoveTwice, set_test)
 }
 
 
+BOOST_FIXTURE_TEST_CASE(dynamicSetInsertRange, set_test)
+{
+  values.insert(2);
+  signals.clear();
+
+  dynamic_set_range_signals ranges;
+  ranges.attach(values);
+
+  std::vector<int> new_values;
+  new_values.push_back(1);
+  new_values.push_back(2);
+  new_values.push_back(3);
+  values.insert_range(new_values);
+
+  expected.push_back(1);
+  expected.push_back(2);
+  expected.push_back(3);
+
+  expected_signals.push_back(ins(1));
+  expected_signals.push_back(ins(3));
+
+  FINISH_SET_TEST();
+
+  BOOST_REQUIRE_EQUAL(ranges.get_inserted().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_inserted()[0].size(), 2U);
+  BOOST_CHECK(ranges.get_removed().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicSetInsertRangeAlreadyPresent, set_test)
+{
+  setup123();
+  signals.clear();
+
+  dynamic_set_range_signals ranges;
+  ranges.attach(values);
+
+  std::vector<int> new_values;
+  new_values.push_back(3);
+  new_values.push_back(1);
+  values.insert_range(new_values);
+
+  expected.push_back(1);
+  expected.push_back(2);
+  expected.push_back(3);
+
+  FINISH_SET_TEST();
+
+  BOOST_CHECK(ranges.get_inserted().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicSetRemoveRange, set_test)
+{
+  setup123();
+  signals.clear();
+
+  dynamic_set_range_signals ranges;
+  ranges.attach(values);
+
+  std::vector<int> old_values;
+  old_values.push_back(3);
+  old_values.push_back(9);
+  old_values.push_back(1);
+  values.remove_range(old_values);
+
+  expected.push_back(2);
+
+  expected_signals.push_back(rem(3));
+  expected_signals.push_back(rem(1));
+
+  FINISH_SET_TEST();
+
+  BOOST_REQUIRE_EQUAL(ranges.get_removed().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_removed()[0].size(), 2U);
+  BOOST_CHECK(ranges.get_inserted().empty());
+}
+
 
 struct set_union_test
 {
@@ -817,3 +924,90 @@ BOOST_FIXTURE_TEST_CASE(dynamicSetUnionRemoveAllCopies, set_union_test)
   FINISH_SET_TEST();
 }
 
+
+BOOST_FIXTURE_TEST_CASE(dynamicSetUnionInsertSetEmitsOneRange, set_union_test)
+{
+  set1->insert(1);
+  set1->insert(2);
+  set2->insert(2);
+  set2->insert(3);
+
+  dynamic_set_range_signals ranges;
+  ranges.attach(values);
+
+  addSets();
+
+  BOOST_REQUIRE_EQUAL(ranges.get_inserted().size(), 2U);
+
+  std::vector<int> first, second;
+  first.push_back(1);
+  first.push_back(2);
+  second.push_back(3);
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(first.begin(), first.end(),
+                                ranges.get_inserted()[0].begin(),
+                                ranges.get_inserted()[0].end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(second.begin(), second.end(),
+                                ranges.get_inserted()[1].begin(),
+                                ranges.get_inserted()[1].end());
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicSetUnionForwardsRanges, set_union_test)
+{
+  set1->insert(2);
+
+  addSets();
+  clear();
+
+  dynamic_set_range_signals ranges;
+  ranges.attach(values);
+
+  std::vector<int> new_values;
+  new_values.push_back(4);
+  new_values.push_back(5);
+  new_values.push_back(2);
+  set2->insert_range(new_values);
+
+  std::vector<int> old_values;
+  old_values.push_back(2);
+  old_values.push_back(4);
+  set2->remove_range(old_values);
+
+  expected.push_back(2);
+  expected.push_back(5);
+
+  expected_signals.push_back(ins(4));
+  expected_signals.push_back(ins(5));
+  expected_signals.push_back(rem(4));
+
+  FINISH_SET_TEST();
+
+  BOOST_REQUIRE_EQUAL(ranges.get_inserted().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_inserted()[0].size(), 2U);
+  BOOST_REQUIRE_EQUAL(ranges.get_removed().size(), 1U);
+  BOOST_CHECK_EQUAL(ranges.get_removed()[0].size(), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(dynamicSetUnionManyValues, set_union_test)
+{
+  std::vector<int> values1, values2;
+  for(int i = 0; i < 1000; ++i)
+    values1.push_back(i);
+  for(int i = 500; i < 1500; ++i)
+    values2.push_back(i);
+
+  set1->insert_range(values1);
+  set2->insert_range(values2);
+
+  addSets();
+  BOOST_CHECK_EQUAL(values.size(), 1500U);
+
+  values.remove_set(set1);
+  BOOST_CHECK_EQUAL(values.size(), 1000U);
+
+  clear();
+  for(int i = 500; i < 1500; ++i)
+    expected.push_back(i);
+
+  FINISH_SET_TEST();
+}
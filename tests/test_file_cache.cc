@@ -380,7 +380,196 @@ BOOST_FIXTURE_TEST_CASE(fileCacheDropLeastRecentlyUsedDisk, usingTemp)
   temp::name tn("cache");
 
   runDropLeastRecentlyUsedTest(boost::lambda::bind(&file_cache::create,
-						   boost::lambda::_1, 0, 1000));
+						   boost::lambda::_1, 0, 1000, 1));
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheDropInBatches, usingTemp)
+{
+  temp::name tn("cache");
+  temp::name infilename("infile");
+
+  {
+    std::ofstream infile(infilename.get_name().c_str());
+    const std::string block(100000, 'x');
+    infile.write(block.c_str(), block.size());
+  }
+
+  // Store the entries uncompressed so their sizes are known: twenty
+  // of them fill the cache exactly.
+  boost::shared_ptr<file_cache> cache(file_cache::create(tn.get_name(), 0, 2000000, 0));
+
+  for(int i = 0; i < 20; ++i)
+    cache->putItem((boost::format("key%d") % i).str(), infilename.get_name(), i);
+
+  for(int i = 0; i < 20; ++i)
+    BOOST_CHECK(cache->getItem((boost::format("key%d") % i).str()).valid());
+
+  // They were looked up in order, so key0 is the least recently used.
+  cache->putItem("key20", infilename.get_name(), 20);
+
+  // Enough old entries were dropped to leave some room...
+  for(int i = 0; i < 4; ++i)
+    BOOST_CHECK(!cache->getItem((boost::format("key%d") % i).str()).valid());
+  BOOST_CHECK(cache->getItem("key4").valid());
+
+  // ...so the next few inserts don't drop anything.
+  cache->putItem("key21", infilename.get_name(), 21);
+  cache->putItem("key22", infilename.get_name(), 22);
+
+  for(int i = 4; i <= 22; ++i)
+    BOOST_CHECK(cache->getItem((boost::format("key%d") % i).str()).valid());
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheCompressionLevels, usingTemp)
+{
+  // Level 0 stores everything raw; level 9 compresses everything
+  // that gets smaller.
+  const int levels[] = { 0, 9 };
+
+  for(std::size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i)
+    {
+      temp::name tn("cache");
+
+      boost::shared_ptr<file_cache> cache(file_cache::create(tn.get_name(), 333, 1000, levels[i]));
+
+      fileCacheTestInfo testInfo;
+      setupFileCacheTest(cache, testInfo);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheStoreAlreadyCompressed, usingTemp)
+{
+  temp::name tn("cache");
+  temp::name infilename("infile");
+
+  // Something that looks like a PNG image, followed by data that
+  // would compress very well if it weren't stored as it is.
+  std::string data("\x89PNG\r\n\x1a\n");
+  data.append(500, 'x');
+
+  {
+    std::ofstream infile(infilename.get_name().c_str());
+    infile.write(data.c_str(), data.size());
+  }
+
+  boost::shared_ptr<file_cache> cache(file_cache::create(tn.get_name(), 0, 1000, 9));
+  cache->putItem("image", infilename.get_name(), 100);
+
+  CHECK_CACHED_VALUE(cache, "image", data, 100);
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheSharedDatabase, usingTemp)
+{
+  temp::name tn("cache");
+
+  // Two caches on the same file: lookups in one should see what
+  // the other has stored, even though they read through their own
+  // connections.
+  boost::shared_ptr<file_cache> writer(file_cache::create(tn.get_name(), 0, 1000));
+  boost::shared_ptr<file_cache> reader(file_cache::create(tn.get_name(), 0, 1000));
+
+  BOOST_CHECK(exists(tn.get_name() + "-wal"));
+
+  fileCacheTestInfo testInfo;
+  setupFileCacheTest(writer, testInfo);
+
+  CHECK_CACHED_VALUE(reader, testInfo.key1, testInfo.infileData1, testInfo.time1);
+  CHECK_CACHED_VALUE(reader, testInfo.key2, testInfo.infileData2, testInfo.time2);
+  CHECK_CACHED_VALUE(reader, testInfo.key3, testInfo.infileData3, testInfo.time3);
+
+  writer->putItem(testInfo.key1, testInfo.infilename2.get_name(), testInfo.time2);
+  CHECK_CACHED_VALUE(reader, testInfo.key1, testInfo.infileData2, testInfo.time2);
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheMemoryContents, usingTemp)
+{
+  temp::name tn("cache");
+  fileCacheTestInfo testInfo;
+
+  {
+    boost::shared_ptr<file_cache> disk_only(file_cache::create(tn.get_name(), 0, 1000));
+    setupFileCacheTest(disk_only, testInfo);
+  }
+
+  // Opening the same database with an in-memory cache: the first
+  // lookup comes from the disk and copies the entry into memory, and
+  // later lookups share the in-memory copy.
+  boost::shared_ptr<file_cache> cache(file_cache::create(tn.get_name(), 1000, 1000));
+
+  time_t mtime1 = 0, mtime2 = 0;
+  boost::shared_ptr<const std::string> contents1 =
+    cache->getItemContents(testInfo.key2, mtime1);
+  boost::shared_ptr<const std::string> contents2 =
+    cache->getItemContents(testInfo.key2, mtime2);
+
+  BOOST_REQUIRE(contents1.get() != NULL);
+  BOOST_CHECK_EQUAL(contents1.get(), contents2.get());
+  BOOST_CHECK_EQUAL(mtime1, testInfo.time2);
+  BOOST_CHECK_EQUAL(mtime2, testInfo.time2);
+  BOOST_CHECK_EQUAL_COLLECTIONS(contents1->begin(), contents1->end(),
+				testInfo.infileData2.begin(), testInfo.infileData2.end());
+
+  temp::name name1 = cache->getItem(testInfo.key2);
+  temp::name name2 = cache->getItem(testInfo.key2);
+  BOOST_REQUIRE(name1.valid());
+  BOOST_CHECK_EQUAL(name1.get_name(), name2.get_name());
+
+  time_t mtime = 0;
+  BOOST_CHECK(cache->getItemContents("no such key", mtime).get() == NULL);
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheDiskContents, usingTemp)
+{
+  temp::name tn("cache");
+  fileCacheTestInfo testInfo;
+
+  // Without an in-memory cache, the contents are decompressed
+  // straight out of the database.
+  boost::shared_ptr<file_cache> cache(file_cache::create(tn.get_name(), 0, 1000, 9));
+  setupFileCacheTest(cache, testInfo);
+
+  time_t mtime = 0;
+  boost::shared_ptr<const std::string> contents =
+    cache->getItemContents(testInfo.key1, mtime);
+
+  BOOST_REQUIRE(contents.get() != NULL);
+  BOOST_CHECK_EQUAL(mtime, testInfo.time1);
+  BOOST_CHECK_EQUAL_COLLECTIONS(contents->begin(), contents->end(),
+				testInfo.infileData1.begin(), testInfo.infileData1.end());
+
+  BOOST_CHECK(cache->getItemContents("no such key", mtime).get() == NULL);
+}
+
+BOOST_FIXTURE_TEST_CASE(fileCacheSharedDirectory, usingTemp)
+{
+  temp::dir shared("shared");
+  temp::name tn1("cache");
+  temp::name tn2("cache");
+  fileCacheTestInfo testInfo;
+
+  // Two systems with their own on-disk caches and one shared
+  // directory: what one of them stores, the other can find.
+  boost::shared_ptr<file_cache> cache1(file_cache::create(tn1.get_name(), 0, 1000, 1,
+							  shared.get_name()));
+  boost::shared_ptr<file_cache> cache2(file_cache::create(tn2.get_name(), 0, 1000, 1,
+							  shared.get_name()));
+  setupFileCacheTest(cache1, testInfo);
+
+  CHECK_CACHED_VALUE(cache2, testInfo.key1, testInfo.infileData1, testInfo.time1);
+
+  time_t mtime = 0;
+  boost::shared_ptr<const std::string> contents =
+    cache2->getItemContents(testInfo.key2, mtime);
+  BOOST_REQUIRE(contents.get() != NULL);
+  BOOST_CHECK_EQUAL(mtime, testInfo.time2);
+  BOOST_CHECK_EQUAL_COLLECTIONS(contents->begin(), contents->end(),
+				testInfo.infileData2.begin(), testInfo.infileData2.end());
+
+  // Both hits were copied into the second system's own cache.
+  boost::shared_ptr<file_cache> local2(file_cache::create(tn2.get_name(), 0, 1000));
+  CHECK_CACHED_VALUE(local2, testInfo.key1, testInfo.infileData1, testInfo.time1);
+  CHECK_CACHED_VALUE(local2, testInfo.key2, testInfo.infileData2, testInfo.time2);
+  BOOST_CHECK(!local2->getItem(testInfo.key3).valid());
 }
 
 // The changelog that's expected to be in the upgrade test database.
@@ -0,0 +1,116 @@
+// test_history_index.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/history/history_index.h>
+#include <generic/util/temp.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using aptitude::history::append_index_entries;
+using aptitude::history::find_index_entries;
+using aptitude::history::find_last_index_entry;
+using aptitude::history::index_entry;
+
+namespace
+{
+  class usingTemp
+  {
+  public:
+    usingTemp()
+    {
+      temp::initialize("testHistoryIndex");
+    }
+
+    ~usingTemp()
+    {
+      temp::shutdown();
+    }
+  };
+}
+
+BOOST_FIXTURE_TEST_CASE(historyIndexQueries, usingTemp)
+{
+  temp::name tn("history-index");
+  const std::string filename = tn.get_name();
+
+  std::vector<index_entry> first;
+  first.push_back(index_entry(1000, 0, "install", "foo", "", "1.0"));
+  first.push_back(index_entry(1000, 0, "install-auto", "libfoo", "", "1.0"));
+
+  std::vector<index_entry> second;
+  second.push_back(index_entry(2000, 512, "upgrade", "foo", "1.0", "1.1"));
+  second.push_back(index_entry(2000, 512, "remove", "bar", "2.0", ""));
+
+  std::vector<index_entry> third;
+  third.push_back(index_entry(3000, 1024, "upgrade", "foo", "1.1", "1.2"));
+
+  BOOST_REQUIRE(append_index_entries(filename, first));
+  BOOST_REQUIRE(append_index_entries(filename, second));
+  BOOST_REQUIRE(append_index_entries(filename, third));
+
+  std::vector<index_entry> found;
+  BOOST_REQUIRE(find_index_entries(filename, "foo", "", found));
+  BOOST_REQUIRE_EQUAL(found.size(), 3U);
+  BOOST_CHECK(found[0] == first[0]);
+  BOOST_CHECK(found[1] == second[0]);
+  BOOST_CHECK(found[2] == third[0]);
+
+  found.clear();
+  BOOST_REQUIRE(find_index_entries(filename, "bar", "", found));
+  BOOST_REQUIRE_EQUAL(found.size(), 1U);
+  BOOST_CHECK_EQUAL(found[0].get_old_version(), "2.0");
+  BOOST_CHECK_EQUAL(found[0].get_new_version(), "");
+
+  index_entry last;
+  BOOST_REQUIRE(find_last_index_entry(filename, "foo", "upgrade", last));
+  BOOST_CHECK(last == third[0]);
+
+  BOOST_REQUIRE(find_last_index_entry(filename, "foo", "install", last));
+  BOOST_CHECK(last == first[0]);
+
+  BOOST_CHECK(!find_last_index_entry(filename, "libfoo", "upgrade", last));
+  BOOST_CHECK(!find_last_index_entry(filename, "baz", "", last));
+}
+
+BOOST_FIXTURE_TEST_CASE(historyIndexSkipsBadLines, usingTemp)
+{
+  temp::name tn("history-index");
+  const std::string filename = tn.get_name();
+
+  {
+    std::ofstream out(filename.c_str());
+    out << "garbage\tfoo\n"
+	<< "x\t0\tinstall\tfoo\t\t1.0\n"
+	<< "1000\t0\tinstall\tfoo\t\t1.0\n"
+	<< "2000\t0\tupgrade\tfoo\t1.0\n";
+    BOOST_REQUIRE(out);
+  }
+
+  std::vector<index_entry> found;
+  BOOST_REQUIRE(find_index_entries(filename, "foo", "", found));
+  BOOST_REQUIRE_EQUAL(found.size(), 1U);
+  BOOST_CHECK(found[0] == index_entry(1000, 0, "install", "foo", "", "1.0"));
+
+  found.clear();
+  BOOST_CHECK(!find_index_entries(filename + ".missing", "foo", "", found));
+}
@@ -286,6 +286,11 @@ class TestIncrementalExpression : public CppUnit::TestFixture
   CPPUNIT_TEST(testOrDoubletonLowerFirstNoEffect);
   CPPUNIT_TEST(testOrDoubletonLowerSecondNoEffect);
 
+  CPPUNIT_TEST(testBatchDefersPropagation);
+  CPPUNIT_TEST(testBatchNoNetChange);
+  CPPUNIT_TEST(testBatchNested);
+  CPPUNIT_TEST(testBatchPropagatesOncePerNode);
+
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -1003,6 +1008,108 @@ public:
 
     CPPUNIT_ASSERT_EQUAL(expected, e_wrap->get_calls());
   }
+
+  void testBatchDefersPropagation()
+  {
+    cw::util::ref_ptr<var_e<int> > v = var_e<int>::create(55555);
+    cw::util::ref_ptr<fake_container<int> > c = fake_container<int>::create(v);
+
+    std::vector<child_modified_call<int> > expected_calls;
+
+    {
+      expression_batch batch;
+
+      v->set_value(42);
+      v->set_value(10);
+
+      CPPUNIT_ASSERT_EQUAL(10, v->get_value());
+      CPPUNIT_ASSERT_EQUAL(expected_calls, c->get_calls());
+    }
+
+    expected_calls.push_back(child_modified_call<int>(v, 55555, 10));
+
+    CPPUNIT_ASSERT_EQUAL(expected_calls, c->get_calls());
+  }
+
+  void testBatchNoNetChange()
+  {
+    cw::util::ref_ptr<var_e<bool> > v = var_e<bool>::create(false);
+    cw::util::ref_ptr<expression<bool> > e = not_e::create(v);
+    cw::util::ref_ptr<fake_container<bool> > e_wrap =
+      fake_container<bool>::create(e);
+
+    {
+      expression_batch batch;
+
+      v->set_value(true);
+      v->set_value(false);
+    }
+
+    std::vector<child_modified_call<bool> > expected;
+
+    CPPUNIT_ASSERT_EQUAL(expected, e_wrap->get_calls());
+  }
+
+  void testBatchNested()
+  {
+    cw::util::ref_ptr<var_e<int> > v = var_e<int>::create(1);
+    cw::util::ref_ptr<fake_container<int> > c = fake_container<int>::create(v);
+
+    std::vector<child_modified_call<int> > expected_calls;
+
+    {
+      expression_batch outer;
+
+      {
+	expression_batch inner;
+
+	v->set_value(2);
+      }
+
+      // Only the outermost batch propagates changes.
+      CPPUNIT_ASSERT_EQUAL(expected_calls, c->get_calls());
+
+      v->set_value(3);
+    }
+
+    expected_calls.push_back(child_modified_call<int>(v, 1, 3));
+
+    CPPUNIT_ASSERT_EQUAL(expected_calls, c->get_calls());
+  }
+
+  // Check that each expression in a DAG is recomputed at most once
+  // per batch, even when it is reachable along paths of different
+  // lengths and its inputs change several times.
+  void testBatchPropagatesOncePerNode()
+  {
+    cw::util::ref_ptr<var_e<bool> >
+      v1 = var_e<bool>::create(false),
+      v2 = var_e<bool>::create(false);
+    cw::util::ref_ptr<or_e> o = getOrDoubleton(v1, v2);
+    cw::util::ref_ptr<and_e> a = and_e::create(o, v1);
+    cw::util::ref_ptr<fake_container<bool> >
+      o_wrap = fake_container<bool>::create(o),
+      a_wrap = fake_container<bool>::create(a);
+
+    {
+      expression_batch batch;
+
+      v1->set_value(true);
+      v2->set_value(true);
+      v1->set_value(false);
+      v1->set_value(true);
+    }
+
+    CPPUNIT_ASSERT(o->get_value());
+    CPPUNIT_ASSERT(a->get_value());
+
+    std::vector<child_modified_call<bool> > o_expected, a_expected;
+    o_expected.push_back(child_modified_call<bool>(o, false, true));
+    a_expected.push_back(child_modified_call<bool>(a, false, true));
+
+    CPPUNIT_ASSERT_EQUAL(o_expected, o_wrap->get_calls());
+    CPPUNIT_ASSERT_EQUAL(a_expected, a_wrap->get_calls());
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestIncrementalExpression);
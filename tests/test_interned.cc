@@ -0,0 +1,144 @@
+// test_interned.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <generic/util/interned.h>
+
+#include <string.h>
+
+#include <set>
+#include <string>
+
+class InternedTest : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(InternedTest);
+
+  CPPUNIT_TEST(testDefault);
+  CPPUNIT_TEST(testEquality);
+  CPPUNIT_TEST(testSets);
+  CPPUNIT_TEST(testMemcpy);
+  CPPUNIT_TEST(testPool);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void testDefault()
+  {
+    interned<std::string> s1, s2(std::string(""));
+
+    CPPUNIT_ASSERT(s1.empty());
+    CPPUNIT_ASSERT(s2.empty());
+    CPPUNIT_ASSERT(s1 == s2);
+    CPPUNIT_ASSERT_EQUAL(std::string(), s1.get());
+
+    interned<std::string> s3(std::string("1.0-1"));
+    CPPUNIT_ASSERT(!s3.empty());
+    CPPUNIT_ASSERT(s1 != s3);
+  }
+
+  void testEquality()
+  {
+    interned<std::string> s1(std::string("1.0-1"));
+    interned<std::string> s2(std::string("1.0-1"));
+    interned<std::string> s3(std::string("1.0-2"));
+
+    CPPUNIT_ASSERT(s1 == s2);
+    CPPUNIT_ASSERT(s1 != s3);
+    // Equal values share storage.
+    CPPUNIT_ASSERT_EQUAL(&s1.get(), &s2.get());
+    CPPUNIT_ASSERT_EQUAL(std::string("1.0-2"), s3.get());
+
+    s1 = s3;
+    CPPUNIT_ASSERT(s1 == s3);
+    CPPUNIT_ASSERT(s1 != s2);
+  }
+
+  void testSets()
+  {
+    std::set<int> a, b;
+    a.insert(1);
+    a.insert(2);
+    b.insert(2);
+    b.insert(1);
+
+    interned<std::set<int> > ia(a), ib(b), empty;
+    CPPUNIT_ASSERT(ia == ib);
+    CPPUNIT_ASSERT(ia != empty);
+    CPPUNIT_ASSERT(empty.get().empty());
+
+    b.erase(1);
+    ib = b;
+    CPPUNIT_ASSERT(ia != ib);
+    CPPUNIT_ASSERT_EQUAL((std::set<int>::size_type) 2, ia.get().size());
+    CPPUNIT_ASSERT_EQUAL((std::set<int>::size_type) 1, ib.get().size());
+  }
+
+  struct record
+  {
+    interned<std::string> name;
+    int n;
+  };
+
+  // Structures holding interned values are copied in bulk by the
+  // undo code; check that a raw copy gives back the same values.
+  void testMemcpy()
+  {
+    record src[2], dst[2];
+
+    src[0].name = std::string("abc");
+    src[0].n = 1;
+    src[1].n = 2;
+
+    memcpy(dst, src, sizeof(src));
+
+    CPPUNIT_ASSERT(dst[0].name == src[0].name);
+    CPPUNIT_ASSERT_EQUAL(std::string("abc"), dst[0].name.get());
+    CPPUNIT_ASSERT(dst[1].name.empty());
+    CPPUNIT_ASSERT_EQUAL(2, dst[1].n);
+  }
+
+  void testPool()
+  {
+    intern_pool<std::string> pool;
+
+    intern_pool<std::string>::handle s1(pool.intern(std::string("1.0-1")));
+    intern_pool<std::string>::handle s2(pool.intern(std::string("1.0-1")));
+    intern_pool<std::string>::handle s3(pool.intern(std::string("1.0-2")));
+
+    CPPUNIT_ASSERT(s1 == s2);
+    CPPUNIT_ASSERT(s1 != s3);
+    CPPUNIT_ASSERT_EQUAL(&s1.get(), &s2.get());
+    CPPUNIT_ASSERT_EQUAL(std::string("1.0-2"), s3.get());
+    CPPUNIT_ASSERT_EQUAL((std::size_t) 2, pool.size());
+
+    // Values in one pool are separate from the global pool and from
+    // other pools.
+    intern_pool<std::string> other_pool;
+    CPPUNIT_ASSERT(&other_pool.intern(std::string("1.0-1")).get() != &s1.get());
+    CPPUNIT_ASSERT(&interned<std::string>(std::string("1.0-1")).get() != &s1.get());
+
+    pool.clear();
+    CPPUNIT_ASSERT_EQUAL((std::size_t) 0, pool.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("1.0-2"),
+			 pool.intern(std::string("1.0-2")).get());
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InternedTest);
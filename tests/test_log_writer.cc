@@ -0,0 +1,180 @@
+/** \file test_log_writer.cc */
+
+
+// Copyright (C) 2011 Daniel Burrows
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; see the file COPYING.  If not, write to
+// the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+// Boston, MA 02111-1307, USA.
+
+// Local includes:
+#include <generic/util/log_writer.h>
+#include <generic/util/logging.h>
+#include <generic/util/temp.h>
+
+// System includes:
+#include <gtest/gtest.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+using aptitude::util::logging::FATAL_LEVEL;
+using aptitude::util::logging::INFO_LEVEL;
+using aptitude::util::logging::LogWriter;
+using aptitude::util::logging::LoggerPtr;
+using aptitude::util::logging::LoggingSystem;
+using aptitude::util::logging::TRACE_LEVEL;
+using aptitude::util::logging::createLogWriter;
+using aptitude::util::logging::createLoggingSystem;
+using boost::shared_ptr;
+using testing::Test;
+
+// Test of the log writer in src/generic/util/log_writer.{cc,h}.
+
+namespace
+{
+  struct LogWriterTest : public Test
+  {
+    shared_ptr<LoggingSystem> loggingSystem;
+    boost::scoped_ptr<temp::name> logName;
+
+    void SetUp()
+    {
+      temp::initialize("testLogWriter");
+      loggingSystem = createLoggingSystem();
+      logName.reset(new temp::name("log"));
+    }
+
+    void TearDown()
+    {
+      logName.reset();
+      temp::shutdown();
+    }
+
+    LoggerPtr getLogger(const std::string &category)
+    {
+      return loggingSystem->getLogger(category);
+    }
+
+    std::string getLogFile() const
+    {
+      return logName->get_name();
+    }
+
+    std::vector<std::string> readLines() const
+    {
+      std::vector<std::string> rval;
+      std::ifstream in(getLogFile().c_str());
+      std::string line;
+      while(std::getline(in, line))
+        rval.push_back(line);
+
+      return rval;
+    }
+
+    static bool endsWith(const std::string &s, const std::string &suffix)
+    {
+      return
+        s.size() >= suffix.size() &&
+        s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+  };
+}
+
+TEST_F(LogWriterTest, testWriteAndFlush)
+{
+  shared_ptr<LogWriter> writer = createLogWriter(getLogFile(), 16);
+  LoggerPtr logger = getLogger("test.writer");
+
+  writer->write("foo.cc", 10, INFO_LEVEL, logger, "first");
+  writer->write("bar.cc", 20, TRACE_LEVEL, logger, "second");
+  writer->flush();
+
+  std::vector<std::string> lines = readLines();
+  ASSERT_EQ(2U, lines.size());
+  EXPECT_TRUE(endsWith(lines[0], " foo.cc:10 INFO test.writer - first"))
+    << lines[0];
+  EXPECT_TRUE(endsWith(lines[1], " bar.cc:20 TRACE test.writer - second"))
+    << lines[1];
+  EXPECT_EQ(0UL, writer->getNumDropped());
+}
+
+TEST_F(LogWriterTest, testManyMessagesKeepTheirOrder)
+{
+  // Messages are either written in order or counted as dropped.
+  shared_ptr<LogWriter> writer = createLogWriter(getLogFile(), 4);
+  LoggerPtr logger = getLogger("test.writer");
+
+  const int numMessages = 1000;
+  for(int i = 0; i < numMessages; ++i)
+    {
+      std::ostringstream msg;
+      msg << i;
+      writer->write("foo.cc", i, INFO_LEVEL, logger, msg.str());
+    }
+  writer->stop();
+
+  std::vector<std::string> lines = readLines();
+  int numWritten = 0;
+  int last = -1;
+  for(std::vector<std::string>::const_iterator it = lines.begin();
+      it != lines.end(); ++it)
+    {
+      const std::string::size_type dash = it->rfind(" - ");
+      ASSERT_NE(std::string::npos, dash) << *it;
+      if(endsWith(*it, "dropped because the queue was full."))
+        continue;
+
+      const int n = atoi(it->c_str() + dash + 3);
+      EXPECT_LT(last, n);
+      last = n;
+      ++numWritten;
+    }
+
+  EXPECT_EQ((unsigned long)numMessages,
+            numWritten + writer->getNumDropped());
+}
+
+TEST_F(LogWriterTest, testFatalIsWrittenImmediately)
+{
+  shared_ptr<LogWriter> writer = createLogWriter(getLogFile(), 1);
+  LoggerPtr logger = getLogger("test.writer");
+
+  writer->write("foo.cc", 1, INFO_LEVEL, logger, "filler");
+  writer->write("foo.cc", 2, FATAL_LEVEL, logger, "doom");
+
+  std::vector<std::string> lines = readLines();
+  ASSERT_FALSE(lines.empty());
+  EXPECT_TRUE(endsWith(lines.back(), " foo.cc:2 FATAL test.writer - doom"))
+    << lines.back();
+  EXPECT_EQ(0UL, writer->getNumDropped());
+}
+
+TEST_F(LogWriterTest, testWriteAfterStopIsDropped)
+{
+  shared_ptr<LogWriter> writer = createLogWriter(getLogFile(), 16);
+  LoggerPtr logger = getLogger("test.writer");
+
+  writer->stop();
+  writer->write("foo.cc", 10, INFO_LEVEL, logger, "too late");
+  writer->flush();
+
+  EXPECT_TRUE(readLines().empty());
+  EXPECT_EQ(1UL, writer->getNumDropped());
+}
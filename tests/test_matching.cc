@@ -20,6 +20,8 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <generic/apt/matching/compare_patterns.h>
+#include <generic/apt/matching/description_index.h>
+#include <generic/apt/matching/match_profile.h>
 #include <generic/apt/matching/parse.h>
 #include <generic/apt/matching/pattern.h>
 #include <generic/apt/matching/serialize.h>
@@ -28,6 +30,8 @@
 
 #include <apt-pkg/error.h>
 
+#include <algorithm>
+
 using namespace aptitude::matching;
 using cwidget::util::ref_ptr;
 using cwidget::util::ssprintf;
@@ -820,6 +824,11 @@ class MatchingTest : public CppUnit::TestFixture
   CPPUNIT_TEST(testParseThenSerialize);
   CPPUNIT_TEST(testSerialize);
   CPPUNIT_TEST(testSerializationParse);
+  CPPUNIT_TEST(testBinarySerialization);
+  CPPUNIT_TEST(testHashPattern);
+  CPPUNIT_TEST(testRegexLiterals);
+  CPPUNIT_TEST(testInternPatterns);
+  CPPUNIT_TEST(testMatchProfile);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -999,6 +1008,157 @@ public:
 						      test.expected_pattern));
       }
   }
+
+  void testBinarySerialization()
+  {
+    for(int i = 0; i < num_test_patterns; ++i)
+      {
+	const pattern_test &test(test_patterns[i]);
+
+	std::string encoded;
+	serialize_pattern_binary(test.expected_pattern, encoded);
+
+	ref_ptr<pattern> decoded(deserialize_pattern_binary(encoded));
+	CPPUNIT_ASSERT(decoded.valid());
+
+	CPPUNIT_ASSERT_EQUAL_MESSAGE(ssprintf("Comparing %s and %s",
+					      serialize_pattern(decoded).c_str(),
+					      serialize_pattern(test.expected_pattern).c_str()),
+				     0,
+				     compare_patterns(decoded,
+						      test.expected_pattern));
+
+	// Every prefix of the encoding (and anything with extra
+	// bytes on the end) is rejected.
+	for(std::string::size_type len = 0; len < encoded.size(); ++len)
+	  CPPUNIT_ASSERT_THROW(deserialize_pattern_binary(std::string(encoded, 0, len)),
+			       MatchingException);
+
+	CPPUNIT_ASSERT_THROW(deserialize_pattern_binary(encoded + '\0'),
+			     MatchingException);
+      }
+  }
+
+  void testHashPattern()
+  {
+    for(int i = 0; i < num_test_patterns; ++i)
+      {
+	const pattern_test &test(test_patterns[i]);
+
+	ref_ptr<pattern> parsed(parse(test.input_pattern));
+	_error->DumpErrors();
+	CPPUNIT_ASSERT(parsed.valid());
+
+	CPPUNIT_ASSERT_EQUAL(hash_pattern(test.expected_pattern),
+			     hash_pattern(parsed));
+      }
+
+    CPPUNIT_ASSERT(hash_pattern(parse("?installed ?name(foo)")) !=
+		   hash_pattern(parse("?name(foo) ?installed")));
+    CPPUNIT_ASSERT(hash_pattern(parse("?name(foo)")) !=
+		   hash_pattern(parse("?description(foo)")));
+  }
+
+  static std::vector<std::string> literals(const std::string &regex)
+  {
+    std::vector<std::string> rval;
+    extract_regex_literals(regex, rval);
+    return rval;
+  }
+
+  void testRegexLiterals()
+  {
+    std::vector<std::string> expected;
+
+    CPPUNIT_ASSERT(literals("").empty());
+    CPPUNIT_ASSERT(literals("ab").empty());
+    CPPUNIT_ASSERT(literals("foo|bar").empty());
+
+    expected.push_back("foo bar");
+    CPPUNIT_ASSERT(expected == literals("Foo Bar"));
+
+    // Groups and bracket expressions are skipped; quantified
+    // characters end a literal and are dropped.
+    expected.clear();
+    expected.push_back("def");
+    CPPUNIT_ASSERT(expected == literals("(abc|xyz)def"));
+
+    expected.clear();
+    expected.push_back("lib");
+    expected.push_back("xyz");
+    CPPUNIT_ASSERT(expected == literals("lib[abc]xyz"));
+
+    expected.clear();
+    expected.push_back("colo");
+    expected.push_back("r editor");
+    CPPUNIT_ASSERT(expected == literals("colou?r editor"));
+
+    // Escaped punctuation is literal; escaped letters are not.
+    expected.clear();
+    expected.push_back(".net");
+    expected.push_back("foo");
+    CPPUNIT_ASSERT(expected == literals("\\.net\\wfoo"));
+  }
+
+  void testInternPatterns()
+  {
+    pattern_interner interner;
+
+    ref_ptr<pattern> p1(interner.intern(parse("?and(?installed, ?description(editor))")));
+    ref_ptr<pattern> p2(interner.intern(parse("?or(?automatic, ?description(editor))")));
+    ref_ptr<pattern> p3(interner.intern(parse("?and(?installed, ?description(editor))")));
+
+    CPPUNIT_ASSERT(p1.valid() && p2.valid() && p3.valid());
+    CPPUNIT_ASSERT(p1 == p3);
+    CPPUNIT_ASSERT(p1->get_and_patterns()[1] == p2->get_or_patterns()[1]);
+    CPPUNIT_ASSERT_EQUAL(0, compare_patterns(p2, parse("?or(?automatic, ?description(editor))")));
+  }
+
+  void testMatchProfile()
+  {
+    ref_ptr<pattern> p(parse("?and(?installed, ?description(editor))"));
+    CPPUNIT_ASSERT(p.valid());
+
+    const ref_ptr<pattern> &installed(p->get_and_patterns()[0]);
+    const ref_ptr<pattern> &description(p->get_and_patterns()[1]);
+
+    match_profile profile;
+    profile.add_evaluation(p, 2, true, 0.5);
+    profile.add_evaluation(p, 1, false, 0.25);
+    profile.add_evaluation(installed, 1, true, 0.125);
+    profile.add_memo_hit(installed, false);
+    profile.add_prefilter(description, "description index: 3 packages");
+
+    const match_profile::node_stats *and_stats = profile.find(p);
+    CPPUNIT_ASSERT(and_stats != NULL);
+    CPPUNIT_ASSERT_EQUAL(2UL, and_stats->evaluations);
+    CPPUNIT_ASSERT_EQUAL(3UL, and_stats->targets);
+    CPPUNIT_ASSERT_EQUAL(1UL, and_stats->matches);
+    CPPUNIT_ASSERT_EQUAL(0UL, and_stats->memo_hits);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.75, and_stats->seconds, 1e-9);
+
+    const match_profile::node_stats *installed_stats = profile.find(installed);
+    CPPUNIT_ASSERT(installed_stats != NULL);
+    CPPUNIT_ASSERT_EQUAL(2UL, installed_stats->evaluations);
+    CPPUNIT_ASSERT_EQUAL(1UL, installed_stats->matches);
+    CPPUNIT_ASSERT_EQUAL(1UL, installed_stats->memo_hits);
+
+    // Pre-filtering alone doesn't count as an evaluation.
+    const match_profile::node_stats *description_stats = profile.find(description);
+    CPPUNIT_ASSERT(description_stats != NULL);
+    CPPUNIT_ASSERT_EQUAL(0UL, description_stats->evaluations);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), description_stats->prefilters.size());
+
+    CPPUNIT_ASSERT(profile.find(parse("?installed")) == NULL);
+
+    // One header line, one line per node and one per pre-filter,
+    // with the sub-patterns indented below their parent.
+    const std::string report(profile.format(p));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(5),
+			 static_cast<std::size_t>(std::count(report.begin(), report.end(), '\n')));
+    CPPUNIT_ASSERT(report.find("\n  ?installed ") != std::string::npos);
+    CPPUNIT_ASSERT(report.find("[description index: 3 packages]") != std::string::npos);
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(MatchingTest);
@@ -0,0 +1,119 @@
+// test_memory_accounting.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/memory_accounting.h>
+
+#include <sigc++/functors/ptr_fun.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+using aptitude::util::collect_memory_usage;
+using aptitude::util::memory_account;
+using aptitude::util::memory_report;
+
+namespace
+{
+  void account_small(memory_report &report)
+  {
+    report.add("test small", 1000);
+  }
+
+  void account_large(memory_report &report)
+  {
+    report.add("test large", 10 * 1024 * 1024);
+  }
+
+  std::size_t get_bytes(const memory_report &report,
+			const std::string &subsystem)
+  {
+    for(memory_report::const_iterator it = report.begin();
+	it != report.end(); ++it)
+      if(it->first == subsystem)
+	return it->second.bytes;
+
+    return 0;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(memoryAccountsReportWhileAlive)
+{
+  {
+    memory_account a1(sigc::ptr_fun(&account_small));
+    memory_account a2(sigc::ptr_fun(&account_small));
+
+    memory_report report;
+    collect_memory_usage(report);
+
+    BOOST_CHECK_EQUAL(get_bytes(report, "test small"), 2000U);
+    for(memory_report::const_iterator it = report.begin();
+	it != report.end(); ++it)
+      if(it->first == "test small")
+	BOOST_CHECK_EQUAL(it->second.objects, 2UL);
+  }
+
+  memory_report report;
+  collect_memory_usage(report);
+  BOOST_CHECK_EQUAL(get_bytes(report, "test small"), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(memoryReportFormat)
+{
+  memory_account small(sigc::ptr_fun(&account_small));
+  memory_account large(sigc::ptr_fun(&account_large));
+
+  memory_report report;
+  collect_memory_usage(report);
+
+  BOOST_CHECK_EQUAL(report.get_total(), 1000U + 10 * 1024 * 1024);
+
+  const std::string text = report.format();
+  const std::string::size_type header = text.find("Subsystem");
+  const std::string::size_type large_pos = text.find("test large");
+  const std::string::size_type small_pos = text.find("test small");
+  const std::string::size_type total_pos = text.find("Total");
+
+  BOOST_REQUIRE(header != std::string::npos);
+  BOOST_REQUIRE(large_pos != std::string::npos);
+  BOOST_REQUIRE(small_pos != std::string::npos);
+  BOOST_REQUIRE(total_pos != std::string::npos);
+
+  // Largest first, with the total last.
+  BOOST_CHECK(header < large_pos);
+  BOOST_CHECK(large_pos < small_pos);
+  BOOST_CHECK(small_pos < total_pos);
+
+  // Sizes are rounded up to whole KiB.
+  BOOST_CHECK(text.find("10240 KiB") != std::string::npos);
+  BOOST_CHECK(text.find("    1 KiB") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(memoryContainerEstimates)
+{
+  std::vector<int> v;
+  v.reserve(100);
+  BOOST_CHECK_EQUAL(aptitude::util::vector_memory_usage(v), 100 * sizeof(int));
+
+  std::list<int> l(10, 0);
+  BOOST_CHECK_EQUAL(aptitude::util::node_memory_usage(l),
+		    10 * (sizeof(int) + 3 * sizeof(void *)));
+}
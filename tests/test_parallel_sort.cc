@@ -0,0 +1,75 @@
+// test_parallel_sort.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/parallel_sort.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <stdlib.h>
+
+using aptitude::util::parallel_sort;
+
+namespace
+{
+  std::vector<int> make_input(std::size_t size)
+  {
+    std::vector<int> rval;
+    srand(42);
+    for(std::size_t i = 0; i < size; ++i)
+      rval.push_back(rand() % 1000);
+
+    return rval;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parallelSortMatchesSort)
+{
+  const std::size_t sizes[] = { 0, 1, 2, 7, 100, 1001, 10000 };
+  const int thread_counts[] = { 1, 2, 3, 4, 7 };
+
+  for(std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    for(std::size_t j = 0; j < sizeof(thread_counts) / sizeof(thread_counts[0]); ++j)
+      {
+	std::vector<int> expected(make_input(sizes[i]));
+	std::vector<int> actual(expected);
+
+	std::sort(expected.begin(), expected.end());
+	parallel_sort(actual.begin(), actual.end(), std::less<int>(),
+		      thread_counts[j], 10);
+
+	BOOST_CHECK_MESSAGE(expected == actual,
+			    "size " << sizes[i] << ", "
+			    << thread_counts[j] << " threads");
+      }
+}
+
+BOOST_AUTO_TEST_CASE(parallelSortComparison)
+{
+  std::vector<int> values(make_input(5000));
+  std::vector<int> expected(values);
+
+  std::sort(expected.begin(), expected.end(), std::greater<int>());
+  parallel_sort(values.begin(), values.end(), std::greater<int>(), 4, 100);
+
+  BOOST_CHECK(expected == values);
+}
@@ -0,0 +1,76 @@
+// test_parse_dpkg_status.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/parse_dpkg_status.h>
+
+#include <string>
+
+using aptitude::apt::dpkg_status_message;
+using aptitude::apt::dpkg_status_parser;
+
+BOOST_AUTO_TEST_CASE(dpkgStatusParseMessages)
+{
+  dpkg_status_parser parser;
+
+  parser.process_input("pmstatus: foo: 25.5: Installing foo\n"
+		       "pmerror: bar: 50: subprocess failed\n"
+		       "pmconffile: /etc/baz.conf: 75: '/etc/baz.conf' '/etc/baz.conf.dpkg-new'\n");
+
+  BOOST_REQUIRE(parser.has_pending_message());
+  BOOST_CHECK_EQUAL(parser.pop_message(),
+		    dpkg_status_message::make_status(25.5, "foo", "Installing foo"));
+
+  BOOST_REQUIRE(parser.has_pending_message());
+  BOOST_CHECK_EQUAL(parser.pop_message(),
+		    dpkg_status_message::make_error(50, "bar", "subprocess failed"));
+
+  BOOST_REQUIRE(parser.has_pending_message());
+  BOOST_CHECK_EQUAL(parser.pop_message(),
+		    dpkg_status_message::make_conffile("/etc/baz.conf",
+						       "/etc/baz.conf.dpkg-new",
+						       75,
+						       "/etc/baz.conf"));
+
+  BOOST_CHECK(!parser.has_pending_message());
+}
+
+BOOST_AUTO_TEST_CASE(dpkgStatusParseSplitLine)
+{
+  dpkg_status_parser parser;
+
+  parser.process_input("pmstatus: foo: 1");
+  BOOST_CHECK(!parser.has_pending_message());
+
+  parser.process_input("0: Unpacking foo\npmstatus: b");
+  BOOST_REQUIRE(parser.has_pending_message());
+  BOOST_CHECK_EQUAL(parser.pop_message(),
+		    dpkg_status_message::make_status(10, "foo", "Unpacking foo"));
+  BOOST_CHECK(!parser.has_pending_message());
+
+  parser.process_input("ar: 20: Unpacking bar");
+  BOOST_CHECK(!parser.has_pending_message());
+
+  parser.process_input('\n');
+  BOOST_REQUIRE(parser.has_pending_message());
+  BOOST_CHECK_EQUAL(parser.pop_message(),
+		    dpkg_status_message::make_status(20, "bar", "Unpacking bar"));
+  BOOST_CHECK(!parser.has_pending_message());
+}
@@ -233,6 +233,8 @@ class ParsersTest : public CppUnit::TestFixture
   CPPUNIT_TEST(testConcatenateMany);
   CPPUNIT_TEST(testConcatenateSepBy);
   CPPUNIT_TEST(testConcatenateOptional);
+  CPPUNIT_TEST(testSliceSuccess);
+  CPPUNIT_TEST(testSliceFailure);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -1706,6 +1708,44 @@ public:
                      expected);
     }
   }
+
+  void testSliceSuccess()
+  {
+    std::string input = "abc3j2k3h 123";
+    std::string::const_iterator begin = input.begin(), end = input.end();
+
+    boost::iterator_range<std::string::const_iterator> result =
+      slice(many(alpha() + optional(digit()))).parse(begin, end);
+    CPPUNIT_ASSERT(result.begin() == input.begin());
+    CPPUNIT_ASSERT_EQUAL(std::string("abc3j2k3h"),
+                         std::string(result.begin(), result.end()));
+    CPPUNIT_ASSERT_EQUAL((iter_difftype)9, begin - input.begin());
+
+    // Discarded results are only recognized, but they still have to
+    // match.
+    result = slice(lexeme(ch(' ')) >> manyPlus(digit()) << eof()).parse(begin, end);
+    CPPUNIT_ASSERT_EQUAL(std::string(" 123"),
+                         std::string(result.begin(), result.end()));
+    CPPUNIT_ASSERT(begin == end);
+
+    // An empty match is an empty range at the current position.
+    result = slice(many(alpha())).parse(begin, end);
+    CPPUNIT_ASSERT(result.empty());
+    CPPUNIT_ASSERT(result.begin() == end);
+  }
+
+  void testSliceFailure()
+  {
+    std::string input = "ab,cd;";
+    std::string::const_iterator begin = input.begin(), end = input.end();
+
+    CPPUNIT_ASSERT_THROW(slice(manyPlus(digit())).parse(begin, end), ParseException);
+    CPPUNIT_ASSERT_EQUAL((iter_difftype)0, begin - input.begin());
+
+    CPPUNIT_ASSERT_THROW(slice(sepByPlus(ch(','), manyPlus(alpha())) << eof()).parse(begin, end),
+                         ParseException);
+    CPPUNIT_ASSERT_EQUAL((iter_difftype)5, begin - input.begin());
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ParsersTest);
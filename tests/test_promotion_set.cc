@@ -67,6 +67,7 @@ class Promotion_SetTest : public CppUnit::TestFixture
 
   CPPUNIT_TEST(testFindHighestPromotion);
   CPPUNIT_TEST(testErase);
+  CPPUNIT_TEST(testFindHighestPromotionCostUpperBound);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -763,6 +764,56 @@ public:
     CPPUNIT_ASSERT(promotion() == p.find_highest_promotion_containing(search2, make_install_version_from_dep_source(bv3, bv2d1)));
     CPPUNIT_ASSERT(promotion() == p.find_highest_promotion_containing(search2, make_install_version(cv2)));
   }
+
+  // Check that the cost of a set of choices combines all the
+  // promotions it contains, even when their costs are unrelated.
+  void testFindHighestPromotionCostUpperBound()
+  {
+    dummy_universe_ref u(parseUniverse(dummy_universe_1));
+    dummy_promotion_set_callbacks callbacks;
+    dummy_promotion_set p(u, callbacks);
+
+    package a(u.find_package("a"));
+    package b(u.find_package("b"));
+    package c(u.find_package("c"));
+
+    version av1(a.version_from_name("v1"));
+    version bv2(b.version_from_name("v2"));
+    version cv1(c.version_from_name("v1"));
+
+    choice_set p1_choices;
+    p1_choices.insert_or_narrow(make_install_version(av1));
+    promotion p1(p1_choices, make_cost(100));
+    p.insert(p1);
+
+    choice_set p2_choices;
+    p2_choices.insert_or_narrow(make_install_version(bv2));
+    promotion p2(p2_choices, make_cost(10, 50));
+    p.insert(p2);
+
+    CPPUNIT_ASSERT_EQUAL((unsigned int)2, p.size());
+
+    choice_set search1;
+    search1.insert_or_narrow(make_install_version(av1));
+    search1.insert_or_narrow(make_install_version(bv2));
+    CPPUNIT_ASSERT_EQUAL(make_cost(100, 50), p.find_highest_promotion_cost(search1));
+
+    choice_set search2;
+    search2.insert_or_narrow(make_install_version(av1));
+    search2.insert_or_narrow(make_install_version(cv1));
+    CPPUNIT_ASSERT_EQUAL(make_cost(100), p.find_highest_promotion_cost(search2));
+
+    // Erasing a promotion should drop it from the results.
+    for(dummy_promotion_set::iterator it = p.begin(); it != p.end(); ++it)
+      if(*it == p1)
+	{
+	  p.erase(it);
+	  break;
+	}
+
+    CPPUNIT_ASSERT_EQUAL(make_cost(10, 50), p.find_highest_promotion_cost(search1));
+    CPPUNIT_ASSERT(cost_limits::minimum_cost == p.find_highest_promotion_cost(search2));
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(Promotion_SetTest);
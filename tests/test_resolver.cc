@@ -198,6 +198,7 @@ class ResolverTest : public CppUnit::TestFixture
   CPPUNIT_TEST(testMandateDepSource);
   CPPUNIT_TEST(testHardenDependency);
   CPPUNIT_TEST(testApproveBreak);
+  CPPUNIT_TEST(testHintStepUpdates);
   CPPUNIT_TEST(testInitialSetExclusion);
   CPPUNIT_TEST(testSimpleResolution);
   CPPUNIT_TEST(testSimpleBreakSoftDep);
@@ -207,6 +208,7 @@ class ResolverTest : public CppUnit::TestFixture
   CPPUNIT_TEST(testJointScores);
   CPPUNIT_TEST(testDropSolutionSupersets);
   CPPUNIT_TEST(testBreakSoftDepCost);
+  CPPUNIT_TEST(testSolutionSameEffect);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -708,6 +710,43 @@ private:
     CPPUNIT_FAIL("Expected exactly one solution, got two.");
   }
 
+  // Check that a user hint only revisits steps that contain a choice
+  // it affects.
+  void testHintStepUpdates()
+  {
+    dummy_universe_ref u = parseUniverse(dummy_universe_4_not_soft);
+    dummy_resolver r(10, -300, -100, 100000, 50000,
+                     cost_limits::minimum_cost,
+                     50,
+		     imm::map<dummy_universe::package, dummy_universe::version>(),
+		     u);
+
+    package b = u.find_package("b");
+
+    // There are no steps yet, so nothing can be touched.
+    r.reject_version(b.version_from_name("v3"));
+    CPPUNIT_ASSERT_EQUAL((std::size_t)0, r.get_num_deferral_step_updates());
+
+    try
+      {
+	r.find_next_solution(1000, NULL);
+      }
+    catch(NoMoreSolutions)
+      {
+	CPPUNIT_FAIL("Expected at least one solution, got none.");
+      }
+
+    // b v2 solves the root's broken dependency, so rejecting it has
+    // to revisit at least the root.
+    r.reject_version(b.version_from_name("v2"));
+    CPPUNIT_ASSERT(r.get_num_deferral_step_updates() > 0);
+
+    // Rejecting it again changes nothing.
+    const std::size_t updates = r.get_num_deferral_step_updates();
+    r.reject_version(b.version_from_name("v2"));
+    CPPUNIT_ASSERT_EQUAL(updates, r.get_num_deferral_step_updates());
+  }
+
   // Test that excluding dependencies from the set to solve works.
   void testInitialSetExclusion()
   {
@@ -1599,6 +1638,47 @@ private:
       CPPUNIT_ASSERT_EQUAL(cost::make_add_to_user_level(0, 1), sols[1].get_cost());
     }
   }
+
+  // Check that solutions which install the same versions for
+  // different reasons are recognized as having the same effect.
+  void testSolutionSameEffect()
+  {
+    dummy_universe_ref u = parseUniverse(dummy_universe_1);
+
+    dummy_universe::dep_iterator di = u.deps_begin();
+    CPPUNIT_ASSERT(!di.end());
+    dep d1 = *di;
+    ++di;
+    CPPUNIT_ASSERT(!di.end());
+    dep d2 = *di;
+
+    resolver_initial_state<dummy_universe_ref> initial_state(imm::map<package, version>(), u.get_package_count());
+
+    const version av1 = u.find_package("a").version_from_name("v1");
+    const version av2 = u.find_package("a").version_from_name("v2");
+
+    choice_set av1_by_d1, av1_by_d2, av2_by_d1, av1_by_d1_break_d1;
+    av1_by_d1.insert_or_narrow(choice::make_install_version(av1, d1, 0));
+    av1_by_d2.insert_or_narrow(choice::make_install_version_from_dep_source(av1, d2, 0));
+    av2_by_d1.insert_or_narrow(choice::make_install_version(av2, d1, 0));
+    av1_by_d1_break_d1.insert_or_narrow(choice::make_install_version(av1, d1, 0));
+    av1_by_d1_break_d1.insert_or_narrow(choice::make_break_soft_dep(d1, 1));
+
+    const dummy_solution s1(av1_by_d1, initial_state, 0, cost());
+    const dummy_solution s2(av1_by_d2, initial_state, 0, cost());
+    const dummy_solution s3(av2_by_d1, initial_state, 0, cost());
+    const dummy_solution s4(av1_by_d1_break_d1, initial_state, 0, cost());
+
+    CPPUNIT_ASSERT(s1.get_choices() != s2.get_choices());
+    CPPUNIT_ASSERT_EQUAL(s1.get_effect_hash(), s2.get_effect_hash());
+    CPPUNIT_ASSERT(s1.has_same_effect(s2));
+    CPPUNIT_ASSERT(s2.has_same_effect(s1));
+
+    CPPUNIT_ASSERT(!s1.has_same_effect(s3));
+    CPPUNIT_ASSERT(!s1.has_same_effect(s4));
+    CPPUNIT_ASSERT(!s4.has_same_effect(s1));
+    CPPUNIT_ASSERT(s4.has_same_effect(s4));
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ResolverTest);
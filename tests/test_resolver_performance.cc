@@ -0,0 +1,207 @@
+// test_resolver_performance.cc                       -*-c++-*-
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+//
+// Checks that the resolver doesn't do much more work than it used to
+// on a few fixed problems.  The work is measured in steps and
+// promotion lookups rather than time, so the results don't depend on
+// the machine running the test.
+
+#include <generic/problemresolver/dummy_universe.h>
+#include <generic/problemresolver/problemresolver.h>
+#include <generic/problemresolver/cost_limits.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+  /** \brief The work it took to find the first solution of a
+   *  universe when the baseline was recorded.
+   *
+   *  The universes live in resolver_universes/ and were written by
+   *  tools/make-synthetic-archive --format=universe, with the options
+   *  given below.  When a change to the resolver legitimately
+   *  changes these numbers, the failure message gives the new ones.
+   */
+  struct baseline
+  {
+    /** \brief The file containing the universe. */
+    const char *universe;
+
+    std::size_t steps;
+    std::size_t promotions_added;
+    std::size_t promotion_lookups;
+  };
+
+  const baseline baselines[] =
+    {
+      // --packages=100 --seed=1
+      { "synthetic-100.txt", 271, 64, 2069 },
+      // --packages=80 --seed=1 --alternatives=0.3
+      { "alternatives-80.txt", 193, 59, 1576 },
+      // --packages=150 --seed=3 --provides=0.15 --multiarch=0.1
+      { "provides-multiarch-150.txt", 1498, 144, 11974 },
+    };
+
+  /** \brief Return \b true if a count is within the allowed margin
+   *  of its baseline.
+   *
+   *  Small changes in the order in which steps are visited move the
+   *  counts a little, so they are allowed to grow by a quarter (plus
+   *  a few steps for the smallest problems) before the test fails.
+   */
+  bool within_margin(std::size_t actual, std::size_t recorded)
+  {
+    return actual <= recorded + recorded / 4 + 10;
+  }
+}
+
+class ResolverPerformanceTest : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(ResolverPerformanceTest);
+
+  CPPUNIT_TEST(testFirstSolutionEffort);
+  CPPUNIT_TEST(testCompactionKeepsSolutions);
+
+  CPPUNIT_TEST_SUITE_END();
+
+  static dummy_universe_ref loadUniverse(const std::string &name)
+  {
+    const std::string filename = std::string(SRCDIR) + "/resolver_universes/" + name;
+    std::ifstream in(filename.c_str());
+    if(!in)
+      CPPUNIT_FAIL("Can't open " + filename);
+
+    return parse_universe(in);
+  }
+
+  /** \brief Create a resolver with the search parameters of the
+   *  TEST line that make-synthetic-archive writes.
+   */
+  static dummy_resolver *makeResolver(const dummy_universe_ref &u)
+  {
+    dummy_resolver *r = new dummy_resolver(10, 10, -100, 10000, 50,
+					   cost_limits::minimum_cost,
+					   0,
+					   imm::map<dummy_universe::package, dummy_universe::version>(),
+					   u);
+    r->set_debug(false);
+    return r;
+  }
+
+public:
+  void testFirstSolutionEffort()
+  {
+    for(std::size_t i = 0; i < sizeof(baselines) / sizeof(baselines[0]); ++i)
+      {
+	const baseline &b = baselines[i];
+	dummy_universe_ref u = loadUniverse(b.universe);
+
+	boost::scoped_ptr<dummy_resolver> resolver(makeResolver(u));
+	dummy_resolver &r(*resolver);
+
+	try
+	  {
+	    r.find_next_solution(100000, NULL);
+	  }
+	catch(NoMoreSolutions)
+	  {
+	    CPPUNIT_FAIL(std::string("No solution for ") + b.universe);
+	  }
+	catch(NoMoreTime)
+	  {
+	    CPPUNIT_FAIL(std::string("Ran out of steps on ") + b.universe);
+	  }
+
+	const search_statistics &statistics = r.get_statistics();
+	const std::size_t steps = statistics.get_steps_processed();
+	const std::size_t promotions_added = statistics.get_promotions_added();
+	const std::size_t promotion_lookups =
+	  statistics.get_phase_count(search_statistics::promotion_lookup);
+
+	std::ostringstream msg;
+	msg << b.universe << ": " << steps << " steps, "
+	    << promotions_added << " promotions added, "
+	    << promotion_lookups << " promotion lookups (recorded "
+	    << b.steps << ", " << b.promotions_added << ", "
+	    << b.promotion_lookups << ")";
+
+	CPPUNIT_ASSERT_MESSAGE(msg.str(), within_margin(steps, b.steps));
+	CPPUNIT_ASSERT_MESSAGE(msg.str(), within_margin(promotions_added, b.promotions_added));
+	CPPUNIT_ASSERT_MESSAGE(msg.str(), within_margin(promotion_lookups, b.promotion_lookups));
+      }
+  }
+
+  // Releasing dead steps as often as possible shouldn't change the
+  // solutions that are found, or the order they are found in.
+  void testCompactionKeepsSolutions()
+  {
+    std::size_t steps_released = 0;
+
+    for(std::size_t i = 0; i < sizeof(baselines) / sizeof(baselines[0]); ++i)
+      {
+	const baseline &b = baselines[i];
+	dummy_universe_ref u = loadUniverse(b.universe);
+
+	boost::scoped_ptr<dummy_resolver> plain(makeResolver(u));
+	boost::scoped_ptr<dummy_resolver> compacted(makeResolver(u));
+	compacted->set_compaction_threshold(1);
+
+	for(int n = 0; n < 5; ++n)
+	  {
+	    dummy_resolver::solution expected, actual;
+	    try
+	      {
+		expected = plain->find_next_solution(100000, NULL);
+	      }
+	    catch(NoMoreSolutions)
+	      {
+		break;
+	      }
+
+	    std::ostringstream msg;
+	    msg << b.universe << ": solution " << n << " should be "
+		<< expected.get_choices();
+
+	    try
+	      {
+		actual = compacted->find_next_solution(100000, NULL);
+	      }
+	    catch(NoMoreSolutions)
+	      {
+		CPPUNIT_FAIL(msg.str() + ", but there are no more solutions");
+	      }
+
+	    msg << ", got " << actual.get_choices();
+	    CPPUNIT_ASSERT_MESSAGE(msg.str(), expected.get_choices() == actual.get_choices());
+	    CPPUNIT_ASSERT_MESSAGE(msg.str(), expected.get_cost() == actual.get_cost());
+	  }
+
+	steps_released += compacted->get_statistics().get_steps_released();
+      }
+
+    CPPUNIT_ASSERT(steps_released > 0);
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ResolverPerformanceTest);
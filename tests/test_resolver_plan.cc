@@ -0,0 +1,118 @@
+// test_resolver_plan.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/apt/resolver_plan.h>
+#include <generic/util/temp.h>
+
+#include <fstream>
+#include <string>
+
+using aptitude::apt::resolver_plan;
+
+namespace
+{
+  class usingTemp
+  {
+  public:
+    usingTemp()
+    {
+      temp::initialize("testResolverPlan");
+    }
+
+    ~usingTemp()
+    {
+      temp::shutdown();
+    }
+  };
+}
+
+BOOST_FIXTURE_TEST_CASE(resolverPlanRoundTrip, usingTemp)
+{
+  temp::name tn("plan");
+  const std::string path = tn.get_name();
+
+  resolver_plan plan;
+  plan.add("libfoo1:amd64", "1.2-3", true);
+  plan.add("bar:amd64", "", true);
+  plan.add("baz:i386", "2:0.9~rc1-1", false);
+  BOOST_REQUIRE(plan.save(path, "fingerprint 1"));
+
+  resolver_plan loaded;
+  BOOST_REQUIRE(loaded.load(path, "fingerprint 1"));
+  BOOST_REQUIRE_EQUAL(loaded.get_entries().size(), 3U);
+
+  BOOST_CHECK_EQUAL(loaded.get_entries()[0].package, "libfoo1:amd64");
+  BOOST_CHECK_EQUAL(loaded.get_entries()[0].version, "1.2-3");
+  BOOST_CHECK(loaded.get_entries()[0].automatic);
+
+  // Removals are stored with an empty version.
+  BOOST_CHECK_EQUAL(loaded.get_entries()[1].package, "bar:amd64");
+  BOOST_CHECK_EQUAL(loaded.get_entries()[1].version, "");
+  BOOST_CHECK(loaded.get_entries()[1].automatic);
+
+  BOOST_CHECK_EQUAL(loaded.get_entries()[2].package, "baz:i386");
+  BOOST_CHECK_EQUAL(loaded.get_entries()[2].version, "2:0.9~rc1-1");
+  BOOST_CHECK(!loaded.get_entries()[2].automatic);
+}
+
+BOOST_FIXTURE_TEST_CASE(resolverPlanWrongFingerprint, usingTemp)
+{
+  temp::name tn("plan");
+  const std::string path = tn.get_name();
+
+  resolver_plan plan;
+  plan.add("libfoo1:amd64", "1.2-3", true);
+  BOOST_REQUIRE(plan.save(path, "fingerprint 1"));
+
+  resolver_plan loaded;
+  loaded.add("stale:amd64", "1", true);
+  BOOST_CHECK(!loaded.load(path, "fingerprint 2"));
+  BOOST_CHECK(loaded.get_entries().empty());
+
+  BOOST_CHECK(!loaded.load(path + ".missing", "fingerprint 1"));
+}
+
+BOOST_FIXTURE_TEST_CASE(resolverPlanDamaged, usingTemp)
+{
+  temp::name tn("plan");
+  const std::string path = tn.get_name();
+
+  {
+    std::ofstream out(path.c_str());
+    out << "aptitude resolver plan 1\n"
+	<< "fingerprint 1\n"
+	<< "A libfoo1:amd64 1.2-3\n"
+	<< "X bar:amd64 -\n";
+  }
+
+  resolver_plan loaded;
+  BOOST_CHECK(!loaded.load(path, "fingerprint 1"));
+  BOOST_CHECK(loaded.get_entries().empty());
+
+  {
+    std::ofstream out(path.c_str());
+    out << "aptitude resolver plan 1\n"
+	<< "fingerprint 1\n"
+	<< "A libfoo1:amd64\n";
+  }
+
+  BOOST_CHECK(!loaded.load(path, "fingerprint 1"));
+}
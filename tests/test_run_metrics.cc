@@ -0,0 +1,125 @@
+// test_run_metrics.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/run_metrics.h>
+#include <generic/util/temp.h>
+#include <generic/util/timings.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace util = aptitude::util;
+
+namespace
+{
+  class usingTemp
+  {
+  public:
+    usingTemp()
+    {
+      temp::initialize("testRunMetrics");
+    }
+
+    ~usingTemp()
+    {
+      temp::shutdown();
+    }
+  };
+
+  std::vector<std::string> split_fields(const std::string &line)
+  {
+    std::vector<std::string> rval;
+    std::string::size_type start = 0;
+    while(true)
+      {
+	const std::string::size_type tab = line.find('\t', start);
+	rval.push_back(std::string(line, start, tab == std::string::npos
+				   ? std::string::npos : tab - start));
+	if(tab == std::string::npos)
+	  return rval;
+	start = tab + 1;
+      }
+  }
+
+  std::vector<std::string> read_lines(const std::string &filename)
+  {
+    std::vector<std::string> rval;
+    std::ifstream in(filename.c_str());
+    std::string line;
+    while(std::getline(in, line))
+      rval.push_back(line);
+    return rval;
+  }
+
+  /** \return the value of the named field of a record. */
+  std::string get_field(const std::vector<std::string> &header,
+			const std::vector<std::string> &record,
+			const std::string &name)
+  {
+    for(std::vector<std::string>::size_type i = 0;
+	i < header.size() && i < record.size(); ++i)
+      if(header[i] == name)
+	return record[i];
+
+    return std::string();
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(runMetricsAppendRecords, usingTemp)
+{
+  temp::name tn("metrics");
+
+  {
+    util::phase_timer timer("dpkg");
+  }
+
+  util::record_resolver_search(10, true);
+  util::record_resolver_search(5, false);
+  util::record_download(2, 1000);
+  util::record_install(3, 1);
+
+  BOOST_REQUIRE(util::write_run_metrics(tn.get_name(), "install"));
+  BOOST_REQUIRE(util::write_run_metrics(tn.get_name(), ""));
+
+  const std::vector<std::string> lines(read_lines(tn.get_name()));
+  BOOST_REQUIRE_EQUAL(lines.size(), 3U);
+
+  const std::vector<std::string> header(split_fields(lines[0]));
+  BOOST_REQUIRE_EQUAL(header.size(), 18U);
+  BOOST_CHECK_EQUAL(header[0], "version");
+
+  const std::vector<std::string> first(split_fields(lines[1]));
+  BOOST_REQUIRE_EQUAL(first.size(), header.size());
+  BOOST_CHECK_EQUAL(get_field(header, first, "version"), "1");
+  BOOST_CHECK_EQUAL(get_field(header, first, "command"), "install");
+  BOOST_CHECK_EQUAL(get_field(header, first, "resolver_solutions"), "1");
+  BOOST_CHECK_EQUAL(get_field(header, first, "resolver_steps"), "15");
+  BOOST_CHECK_EQUAL(get_field(header, first, "download_items"), "2");
+  BOOST_CHECK_EQUAL(get_field(header, first, "download_bytes"), "1000");
+  BOOST_CHECK_EQUAL(get_field(header, first, "dpkg_runs"), "1");
+  BOOST_CHECK_EQUAL(get_field(header, first, "packages_installed"), "3");
+  BOOST_CHECK_EQUAL(get_field(header, first, "packages_removed"), "1");
+
+  const std::vector<std::string> second(split_fields(lines[2]));
+  BOOST_REQUIRE_EQUAL(second.size(), header.size());
+  BOOST_CHECK_EQUAL(get_field(header, second, "command"), "-");
+}
@@ -0,0 +1,100 @@
+// test_search_telemetry.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/problemresolver/search_telemetry.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+  std::string read_all(FILE *f)
+  {
+    std::string rval;
+    rewind(f);
+    char buf[1024];
+    size_t amt;
+    while((amt = fread(buf, 1, sizeof(buf), f)) > 0)
+      rval.append(buf, amt);
+
+    return rval;
+  }
+
+  std::vector<std::string> split(const std::string &s, char sep)
+  {
+    std::vector<std::string> rval;
+    std::string::size_type start = 0;
+    while(true)
+      {
+	const std::string::size_type end = s.find(sep, start);
+	rval.push_back(std::string(s, start, end == std::string::npos ? std::string::npos : end - start));
+	if(end == std::string::npos)
+	  return rval;
+	start = end + 1;
+      }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(searchTelemetryRecords)
+{
+  FILE *f = tmpfile();
+  BOOST_REQUIRE(f != NULL);
+
+  {
+    search_telemetry telemetry(fileno(f), false, 1000000);
+    BOOST_CHECK(!telemetry.due());
+
+    search_telemetry::record r;
+    r.event = "solution";
+    r.steps = 42;
+    r.open = 7;
+    r.current_cost = "(safety 1)";
+    telemetry.write(r);
+  }
+
+  const std::vector<std::string> lines = split(read_all(f), '\n');
+  fclose(f);
+
+  // The header, one record and the empty string after the last
+  // newline.
+  BOOST_REQUIRE_EQUAL(lines.size(), 3U);
+  BOOST_CHECK_EQUAL(lines[2], "");
+
+  const std::vector<std::string> header = split(lines[0], '\t');
+  const std::vector<std::string> fields = split(lines[1], '\t');
+  BOOST_REQUIRE_EQUAL(header.size(), fields.size());
+
+  BOOST_CHECK_EQUAL(header[0], "time");
+  BOOST_CHECK_EQUAL(fields[1], "solution");
+  BOOST_CHECK_EQUAL(fields[2], "42");
+  BOOST_CHECK_EQUAL(fields[4], "7");
+  BOOST_CHECK_EQUAL(fields[fields.size() - 2], "(safety 1)");
+  BOOST_CHECK_EQUAL(fields[fields.size() - 1], "-");
+}
+
+BOOST_AUTO_TEST_CASE(searchTelemetryOpenFd)
+{
+  BOOST_CHECK(search_telemetry::open("fd:", 1000).get() == NULL);
+  BOOST_CHECK(search_telemetry::open("fd:x", 1000).get() == NULL);
+  BOOST_CHECK(search_telemetry::open("/nonexistent/telemetry", 1000).get() == NULL);
+}
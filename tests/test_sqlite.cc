@@ -222,6 +222,62 @@ BOOST_FIXTURE_TEST_CASE(testGetCachedStatement, memory_db_fixture)
   }
 }
 
+BOOST_FIXTURE_TEST_CASE(testGetCachedStatementKeepsDuplicates, memory_db_fixture)
+{
+  // Two copies of the same statement are cached; checking one out
+  // shouldn't throw the other away.
+  db::statement_proxy p1(tmpdb->get_cached_statement("select 1"));
+  db::statement_proxy p2(tmpdb->get_cached_statement("select 1"));
+  statement * const stmt1(&*p1);
+  statement * const stmt2(&*p2);
+  BOOST_CHECK(stmt1 != stmt2);
+
+  p1.reset();
+  p2.reset();
+
+  db::statement_proxy p3(tmpdb->get_cached_statement("select 1"));
+  db::statement_proxy p4(tmpdb->get_cached_statement("select 1"));
+  BOOST_CHECK((&*p3 == stmt1 && &*p4 == stmt2) ||
+	      (&*p3 == stmt2 && &*p4 == stmt1));
+}
+
+BOOST_FIXTURE_TEST_CASE(testTransactionCommit, test_db_fixture)
+{
+  {
+    db::transaction t(*tmpdb);
+
+    db::statement_proxy insert(tmpdb->get_cached_statement("insert into test (A, B, C) values (?, 'batch', 0)"));
+    for(int i = 100; i < 110; ++i)
+      {
+	insert->reset();
+	insert->bind_int(1, i);
+	insert->exec();
+      }
+
+    t.commit();
+  }
+
+  boost::shared_ptr<statement> count =
+    statement::prepare(*tmpdb, "select count(*) from test where B = 'batch'");
+  statement::execution ex(*count);
+  BOOST_REQUIRE(ex.step());
+  BOOST_CHECK_EQUAL(count->get_int(0), 10);
+}
+
+BOOST_FIXTURE_TEST_CASE(testTransactionRollback, test_db_fixture)
+{
+  {
+    db::transaction t(*tmpdb);
+    statement::prepare(*tmpdb, "delete from test")->exec();
+  }
+
+  boost::shared_ptr<statement> count =
+    statement::prepare(*tmpdb, "select count(*) from test");
+  statement::execution ex(*count);
+  BOOST_REQUIRE(ex.step());
+  BOOST_CHECK_EQUAL(count->get_int(0), 3);
+}
+
 BOOST_FIXTURE_TEST_CASE(getCachedStatementFail, memory_db_fixture)
 {
   BOOST_REQUIRE_THROW(statement::prepare(*tmpdb, "select * from bar"),
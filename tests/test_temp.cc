@@ -51,6 +51,7 @@ class TempTest : public CppUnit::TestFixture
 
   CPPUNIT_TEST(testTempDir);
   CPPUNIT_TEST(testTempName);
+  CPPUNIT_TEST(testBaseDir);
   CPPUNIT_TEST(testShutdown);
   CPPUNIT_TEST(testShutdownOnExit);
 
@@ -130,6 +131,33 @@ public:
     CPPUNIT_ASSERT_EQUAL(ENOENT, errno);
   }
 
+  void testBaseDir()
+  {
+    char tmpl[] = "/tmp/aptitudeTestTempBaseXXXXXX";
+    if(mkdtemp(tmpl) == NULL)
+      CPPUNIT_FAIL(ssprintf("Can't create a base directory: %s",
+			    sstrerror(errno).c_str()));
+    const std::string base(tmpl);
+
+    temp::shutdown();
+    temp::initialize("test", base);
+
+    {
+      temp::name f("tmpf");
+      CPPUNIT_ASSERT_EQUAL(base + "/", std::string(f.get_name(), 0, base.size() + 1));
+    }
+
+    temp::shutdown();
+    CPPUNIT_ASSERT_EQUAL(0, rmdir(base.c_str()));
+
+    // A directory that doesn't exist is ignored.
+    temp::initialize("test", base);
+    {
+      temp::name f("tmpf");
+      CPPUNIT_ASSERT(f.get_name().compare(0, base.size(), base) != 0);
+    }
+  }
+
   void testTempName()
   {
     std::string fname;
@@ -0,0 +1,209 @@
+// test_thread_pool.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/thread_pool.h>
+
+#include <cwidget/generic/threads/threads.h>
+
+#include <vector>
+
+using aptitude::util::cancel_token;
+using aptitude::util::thread_pool;
+namespace threads = cwidget::threads;
+
+namespace
+{
+  /** \brief Records the order in which tasks ran. */
+  class recorder
+  {
+    threads::mutex m;
+    std::vector<int> order;
+
+  public:
+    void record(int n)
+    {
+      threads::mutex::lock l(m);
+      order.push_back(n);
+    }
+
+    std::vector<int> get_order()
+    {
+      threads::mutex::lock l(m);
+      return order;
+    }
+  };
+
+  class record_task
+  {
+    recorder *r;
+    int n;
+
+  public:
+    record_task(recorder *_r, int _n)
+      : r(_r), n(_n)
+    {
+    }
+
+    void operator()() const
+    {
+      r->record(n);
+    }
+  };
+
+  /** \brief Blocks the thread that runs it until it is opened. */
+  class gate
+  {
+    threads::mutex m;
+    threads::condition c;
+    bool open;
+
+  public:
+    gate()
+      : open(false)
+    {
+    }
+
+    void wait()
+    {
+      threads::mutex::lock l(m);
+      while(!open)
+	c.wait(l);
+    }
+
+    void release()
+    {
+      threads::mutex::lock l(m);
+      open = true;
+      c.wake_all();
+    }
+  };
+
+  class gate_task
+  {
+    gate *g;
+
+  public:
+    gate_task(gate *_g)
+      : g(_g)
+    {
+    }
+
+    void operator()() const
+    {
+      g->wait();
+    }
+  };
+}
+
+BOOST_AUTO_TEST_CASE(threadPoolRunsHigherPrioritiesFirst)
+{
+  recorder r;
+  gate g;
+
+  {
+    thread_pool pool(1);
+
+    // Keep the only worker busy until everything is queued.
+    pool.submit(gate_task(&g));
+    pool.submit(record_task(&r, 1), thread_pool::priority_low);
+    pool.submit(record_task(&r, 2), thread_pool::priority_normal);
+    pool.submit(record_task(&r, 3), thread_pool::priority_high);
+    pool.submit(record_task(&r, 4), thread_pool::priority_normal);
+    g.release();
+  }
+
+  std::vector<int> expected;
+  expected.push_back(3);
+  expected.push_back(2);
+  expected.push_back(4);
+  expected.push_back(1);
+
+  std::vector<int> actual(r.get_order());
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+				actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(threadPoolGroupOfOneRunsInOrder)
+{
+  recorder r;
+
+  {
+    thread_pool pool(4);
+    thread_pool::group_ptr serial(thread_pool::create_group(1));
+
+    for(int i = 0; i < 100; ++i)
+      pool.submit(record_task(&r, i), thread_pool::priority_normal, serial);
+  }
+
+  std::vector<int> actual(r.get_order());
+  BOOST_REQUIRE_EQUAL(actual.size(), 100U);
+  for(int i = 0; i < 100; ++i)
+    BOOST_CHECK_EQUAL(actual[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(threadPoolCanceledTasksAreDropped)
+{
+  recorder r;
+  gate g;
+
+  {
+    thread_pool pool(1);
+    cancel_token token;
+
+    pool.submit(gate_task(&g));
+    pool.submit(record_task(&r, 1), thread_pool::priority_normal,
+		thread_pool::group_ptr(), token);
+    pool.submit(record_task(&r, 2));
+    token.cancel();
+    g.release();
+  }
+
+  std::vector<int> actual(r.get_order());
+  BOOST_REQUIRE_EQUAL(actual.size(), 1U);
+  BOOST_CHECK_EQUAL(actual[0], 2);
+}
+
+BOOST_AUTO_TEST_CASE(threadPoolBatchWait)
+{
+  recorder r;
+  gate g;
+  thread_pool pool(1);
+
+  // The only worker is blocked, so waiting for the batch has to run
+  // its tasks in this thread.
+  pool.submit(gate_task(&g));
+
+  {
+    thread_pool::batch b(pool);
+    for(int i = 0; i < 10; ++i)
+      b.submit(record_task(&r, i));
+
+    b.wait(5);
+    std::vector<int> after_one(r.get_order());
+    BOOST_REQUIRE_EQUAL(after_one.size(), 1U);
+    BOOST_CHECK_EQUAL(after_one[0], 5);
+
+    b.wait();
+    BOOST_CHECK_EQUAL(r.get_order().size(), 10U);
+  }
+
+  g.release();
+}
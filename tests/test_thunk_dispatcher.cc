@@ -0,0 +1,133 @@
+// test_thunk_dispatcher.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/thunk_dispatcher.h>
+
+#include <sigc++/bind.h>
+#include <sigc++/functors/ptr_fun.h>
+
+#include <vector>
+
+using aptitude::util::thunk_dispatcher;
+
+namespace
+{
+  int num_wakeups;
+  std::vector<int> ran;
+
+  void count_wakeup()
+  {
+    ++num_wakeups;
+  }
+
+  void record(int n)
+  {
+    ran.push_back(n);
+  }
+
+  safe_slot0<void> make_record(int n)
+  {
+    return make_safe_slot(sigc::slot0<void>(sigc::bind(sigc::ptr_fun(&record), n)));
+  }
+
+  thunk_dispatcher *reentrant_dispatcher;
+
+  void post_another()
+  {
+    ran.push_back(0);
+    reentrant_dispatcher->post(make_record(99));
+  }
+
+  struct dispatcher_test
+  {
+    thunk_dispatcher dispatcher;
+
+    dispatcher_test()
+      : dispatcher(&count_wakeup)
+    {
+      num_wakeups = 0;
+      ran.clear();
+    }
+  };
+}
+
+BOOST_FIXTURE_TEST_CASE(thunkDispatcherWakesOncePerBatch, dispatcher_test)
+{
+  dispatcher.post(make_record(1));
+  dispatcher.post(make_record(2));
+  dispatcher.post(make_record(3));
+
+  BOOST_CHECK_EQUAL(num_wakeups, 1);
+  BOOST_CHECK(ran.empty());
+
+  dispatcher.run_pending();
+
+  BOOST_REQUIRE_EQUAL(ran.size(), 3U);
+  BOOST_CHECK_EQUAL(ran[0], 1);
+  BOOST_CHECK_EQUAL(ran[1], 2);
+  BOOST_CHECK_EQUAL(ran[2], 3);
+
+  dispatcher.post(make_record(4));
+  BOOST_CHECK_EQUAL(num_wakeups, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(thunkDispatcherKeyedKeepsLatest, dispatcher_test)
+{
+  int source1, source2;
+
+  dispatcher.post_keyed(&source1, make_record(1));
+  dispatcher.post_keyed(&source2, make_record(2));
+  dispatcher.post(make_record(3));
+  dispatcher.post_keyed(&source1, make_record(4));
+  dispatcher.post_keyed(&source1, make_record(5));
+
+  BOOST_CHECK_EQUAL(num_wakeups, 1);
+
+  dispatcher.run_pending();
+
+  BOOST_REQUIRE_EQUAL(ran.size(), 3U);
+  BOOST_CHECK_EQUAL(ran[0], 2);
+  BOOST_CHECK_EQUAL(ran[1], 3);
+  BOOST_CHECK_EQUAL(ran[2], 5);
+
+  // The key is forgotten once its thunk has run.
+  ran.clear();
+  dispatcher.post_keyed(&source1, make_record(6));
+  dispatcher.run_pending();
+  BOOST_REQUIRE_EQUAL(ran.size(), 1U);
+  BOOST_CHECK_EQUAL(ran[0], 6);
+}
+
+BOOST_FIXTURE_TEST_CASE(thunkDispatcherPostFromThunk, dispatcher_test)
+{
+  reentrant_dispatcher = &dispatcher;
+
+  dispatcher.post(make_safe_slot(sigc::slot0<void>(sigc::ptr_fun(&post_another))));
+  dispatcher.run_pending();
+
+  // The thunk posted by the first one waits for the next batch.
+  BOOST_REQUIRE_EQUAL(ran.size(), 1U);
+  BOOST_CHECK_EQUAL(num_wakeups, 2);
+
+  dispatcher.run_pending();
+  BOOST_REQUIRE_EQUAL(ran.size(), 2U);
+  BOOST_CHECK_EQUAL(ran[1], 99);
+}
@@ -0,0 +1,107 @@
+// test_timings.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/timings.h>
+
+#include <stdio.h>
+
+#include <string>
+
+using aptitude::util::phase_timer;
+using aptitude::util::print_timings;
+
+namespace
+{
+  std::string get_report()
+  {
+    FILE *f = tmpfile();
+    BOOST_REQUIRE(f != NULL);
+
+    print_timings(f);
+
+    std::string rval;
+    rewind(f);
+    char buf[1024];
+    size_t amt;
+    while((amt = fread(buf, 1, sizeof(buf), f)) > 0)
+      rval.append(buf, amt);
+    fclose(f);
+
+    return rval;
+  }
+
+  /** \brief Return the line of the report that names the given phase. */
+  std::string find_line(const std::string &report, const std::string &name)
+  {
+    const std::string::size_type start = report.find(" " + name + " ");
+    if(start == std::string::npos)
+      return std::string();
+
+    const std::string::size_type line_start = report.rfind('\n', start) + 1;
+    return std::string(report, line_start,
+		       report.find('\n', start) - line_start);
+  }
+
+  std::string::size_type indentation(const std::string &line)
+  {
+    return line.find_first_not_of(' ');
+  }
+}
+
+BOOST_AUTO_TEST_CASE(timingsNestAndAccumulate)
+{
+  for(int i = 0; i < 2; ++i)
+    {
+      phase_timer outer("test-outer");
+      phase_timer inner("test-inner");
+    }
+
+  {
+    phase_timer other("test-other");
+  }
+
+  const std::string report(get_report());
+
+  const std::string outer(find_line(report, "test-outer"));
+  const std::string inner(find_line(report, "test-inner"));
+  const std::string other(find_line(report, "test-other"));
+
+  BOOST_REQUIRE(!outer.empty());
+  BOOST_REQUIRE(!inner.empty());
+  BOOST_REQUIRE(!other.empty());
+
+  BOOST_CHECK(outer.find("(2 runs)") != std::string::npos);
+  BOOST_CHECK(inner.find("(2 runs)") != std::string::npos);
+  BOOST_CHECK(other.find("runs") == std::string::npos);
+
+  BOOST_CHECK_EQUAL(indentation(inner), indentation(outer) + 2);
+  BOOST_CHECK_EQUAL(indentation(other), indentation(outer));
+
+  BOOST_CHECK(report.find("Peak RSS:") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(timingsIncludeRunningPhases)
+{
+  phase_timer running("test-running");
+
+  const std::string line(find_line(get_report(), "test-running"));
+  BOOST_CHECK(!line.empty());
+}
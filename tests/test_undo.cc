@@ -0,0 +1,210 @@
+// test_undo.cc
+//
+//   Copyright (C) 2011 Daniel Burrows
+//
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the GNU General Public License as
+//   published by the Free Software Foundation; either version 2 of
+//   the License, or (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//   General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; see the file COPYING.  If not, write to
+//   the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+//   Boston, MA 02111-1307, USA.
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic/util/undo.h>
+
+#include <vector>
+
+namespace
+{
+  /** \brief An undoable action on a numbered "package" that records
+   *  when it's undone.
+   */
+  class record_undo : public undoable
+  {
+    int id;
+    int key;
+    std::size_t size;
+    std::vector<int> *log;
+
+  public:
+    record_undo(int _id, int _key, std::size_t _size, std::vector<int> *_log)
+      : id(_id), key(_key), size(_size), log(_log)
+    {
+    }
+
+    void undo()
+    {
+      log->push_back(id);
+    }
+
+    std::size_t memory_size() const
+    {
+      return size;
+    }
+
+    bool supersedes(const undoable &newer) const
+    {
+      const record_undo *other = dynamic_cast<const record_undo *>(&newer);
+      return other != NULL && other->key == key;
+    }
+  };
+
+  undo_group *make_group(int id, int key, std::size_t size,
+                         std::vector<int> *log)
+  {
+    undo_group *rval = new undo_group;
+    rval->add_item(new record_undo(id, key, size, log));
+    return rval;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(undoGroupUndoesNewestFirst)
+{
+  std::vector<int> log;
+
+  {
+    undo_group group;
+    group.add_item(new record_undo(1, 1, 10, &log));
+    group.add_item(new record_undo(2, 2, 10, &log));
+    group.add_item(new record_undo(3, 3, 10, &log));
+    group.undo();
+  }
+
+  BOOST_REQUIRE_EQUAL(log.size(), 3U);
+  BOOST_CHECK_EQUAL(log[0], 3);
+  BOOST_CHECK_EQUAL(log[1], 2);
+  BOOST_CHECK_EQUAL(log[2], 1);
+}
+
+BOOST_AUTO_TEST_CASE(undoGroupSupersedes)
+{
+  std::vector<int> log;
+
+  undo_group older;
+  older.add_item(new record_undo(1, 1, 10, &log));
+  older.add_item(new record_undo(2, 2, 10, &log));
+
+  undo_group covered;
+  covered.add_item(new record_undo(3, 2, 10, &log));
+
+  undo_group not_covered;
+  not_covered.add_item(new record_undo(4, 2, 10, &log));
+  not_covered.add_item(new record_undo(5, 7, 10, &log));
+
+  BOOST_CHECK(older.supersedes(covered));
+  BOOST_CHECK(!older.supersedes(not_covered));
+  BOOST_CHECK(older.supersedes(record_undo(6, 1, 10, &log)));
+}
+
+BOOST_AUTO_TEST_CASE(undoListCollapseKeepsOrder)
+{
+  std::vector<int> log;
+  undo_list undos;
+
+  undos.add_item(new record_undo(1, 1, 10, &log));
+  const unsigned int mark = undos.size();
+  undos.add_item(new record_undo(2, 2, 10, &log));
+  undos.add_item(new record_undo(3, 3, 10, &log));
+  undos.collapse_to(mark);
+
+  BOOST_CHECK_EQUAL(undos.size(), 2U);
+  BOOST_CHECK_EQUAL(undos.get_memory_used(), 30U);
+
+  undos.undo();
+  BOOST_REQUIRE_EQUAL(log.size(), 2U);
+  BOOST_CHECK_EQUAL(log[0], 3);
+  BOOST_CHECK_EQUAL(log[1], 2);
+  BOOST_CHECK_EQUAL(undos.get_memory_used(), 10U);
+}
+
+BOOST_AUTO_TEST_CASE(undoListMemoryLimitForgetsOldest)
+{
+  std::vector<int> log;
+  undo_list undos;
+  undos.set_memory_limit(1000);
+
+  for(int i = 0; i < 5; ++i)
+    undos.add_item(make_group(i, i, 300, &log));
+
+  BOOST_CHECK(undos.get_memory_used() <= 1000U);
+  BOOST_CHECK(undos.size() < 5U);
+
+  while(undos.size() > 0)
+    undos.undo();
+
+  // The newest actions are the ones that are left.
+  BOOST_REQUIRE(!log.empty());
+  BOOST_CHECK_EQUAL(log.front(), 4);
+  for(std::size_t i = 1; i < log.size(); ++i)
+    BOOST_CHECK_EQUAL(log[i], log[i - 1] - 1);
+  BOOST_CHECK_EQUAL(undos.get_memory_used(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(undoListMemoryLimitMergesSuperseded)
+{
+  std::vector<int> log;
+  undo_list undos;
+  undos.set_memory_limit(900);
+
+  // Two actions on package 1, then one on package 2.  The second
+  // action on package 1 is redundant once the first is kept.
+  undos.add_item(make_group(1, 1, 200, &log));
+  undos.add_item(make_group(2, 1, 200, &log));
+  undos.add_item(make_group(3, 2, 200, &log));
+  undos.add_item(make_group(4, 3, 200, &log));
+
+  BOOST_CHECK_EQUAL(undos.size(), 3U);
+
+  while(undos.size() > 0)
+    undos.undo();
+
+  BOOST_REQUIRE_EQUAL(log.size(), 3U);
+  BOOST_CHECK_EQUAL(log[0], 4);
+  BOOST_CHECK_EQUAL(log[1], 3);
+  BOOST_CHECK_EQUAL(log[2], 1);
+}
+
+BOOST_AUTO_TEST_CASE(undoListMemoryLimitKeepsNewest)
+{
+  std::vector<int> log;
+  undo_list undos;
+  undos.set_memory_limit(100);
+
+  undos.add_item(make_group(1, 1, 300, &log));
+  undos.add_item(make_group(2, 1, 300, &log));
+
+  // The newest item isn't merged away even though it's superseded.
+  BOOST_REQUIRE_EQUAL(undos.size(), 1U);
+  undos.undo();
+  BOOST_REQUIRE_EQUAL(log.size(), 1U);
+  BOOST_CHECK_EQUAL(log[0], 2);
+}
+
+BOOST_AUTO_TEST_CASE(undoListMaxItemsKeepsNewest)
+{
+  std::vector<int> log;
+  undo_list undos;
+  undos.set_max_items(2);
+
+  for(int i = 0; i < 4; ++i)
+    undos.add_item(make_group(i, i, 10, &log));
+
+  BOOST_REQUIRE_EQUAL(undos.size(), 2U);
+
+  undos.set_max_items(1);
+  BOOST_REQUIRE_EQUAL(undos.size(), 1U);
+
+  undos.undo();
+  BOOST_REQUIRE_EQUAL(log.size(), 1U);
+  BOOST_CHECK_EQUAL(log[0], 3);
+  BOOST_CHECK_EQUAL(undos.get_memory_used(), 0U);
+}